@@ -0,0 +1,88 @@
+#include <iostream>
+#include <string>
+#include <CaribouLite.hpp>
+#include <CaribouLiteCoro.hpp>
+#include <complex>
+#include <cmath>
+#include <future>
+
+#ifndef CARIBOULITE_HAS_COROUTINES
+  #error This example needs a C++20 compiler with coroutine support
+#endif
+
+// A minimal fire-and-forget coroutine type
+struct RxTask
+{
+    struct promise_type
+    {
+        RxTask get_return_object() { return {}; }
+        std::suspend_never initial_suspend() { return {}; }
+        std::suspend_never final_suspend() noexcept { return {}; }
+        void return_void() {}
+        void unhandled_exception() { std::terminate(); }
+    };
+};
+
+// Calculate the mean power in dBFS
+float Power(const std::complex<float>* signal, size_t num_of_samples)
+{
+    if (num_of_samples == 0)
+    {
+        return -200.0f;
+    }
+
+    float sum = 0.0f;
+    for (size_t i = 0; i < num_of_samples; ++i)
+    {
+        sum += std::norm(signal[i]);
+    }
+    return 10 * log10(sum / num_of_samples + 1e-20f);
+}
+
+// The coroutine - runs on the radio's reader thread between awaits
+RxTask receiveBlocks(CaribouLiteRxStream<std::complex<float>>& rx, int num_blocks, std::promise<void>& done)
+{
+    while (num_blocks--)
+    {
+        auto block = co_await rx.NextBlock(std::chrono::milliseconds(500));
+        if (block.status == CaribouLiteRxStream<std::complex<float>>::Status::Timeout)
+        {
+            std::cout << "Timeout waiting for samples" << std::endl;
+            continue;
+        }
+        if (!block) break;      // cancelled
+
+        std::cout << "Received " << std::dec << block.num_samples << " samples, Power: "
+                  << Power(block.samples, block.num_samples) << " dBFS" << std::endl;
+    }
+    std::cout << "Coroutine done, dropped blocks: " << rx.GetDroppedBlocks() << std::endl;
+    done.set_value();
+}
+
+// Main entry
+int main ()
+{
+    // get driver instance - use "CaribouLite&" rather than "CaribouLite" (ref)
+    CaribouLite &cl = CaribouLite::GetInstance();
+    CaribouLiteRadio *s1g = cl.GetRadioChannel(CaribouLiteRadio::RadioType::S1G);
+
+    s1g->SetFrequency(900000000);
+    s1g->SetRxGain(40);
+    s1g->SetAgc(false);
+
+    {
+        std::promise<void> done;
+        std::future<void> finished = done.get_future();
+        CaribouLiteRxStream<std::complex<float>> rx(s1g);
+        receiveBlocks(rx, 100, done);
+
+        // press enter to cancel the stream (if not already done)
+        getchar();
+        rx.Cancel();
+
+        // the coroutine uses "rx" until it returns - let it finish first
+        finished.wait();
+    }
+
+    return 0;
+}
@@ -22,6 +22,9 @@
 #include <thread>
 #include <memory>
 #include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <chrono>
 #include <functional>
 
 #if __cplusplus <= 199711L
@@ -47,6 +50,69 @@ private:
     cariboulite_lib_version_st _ver;
 };
 
+/**
+ * @brief A handler called by one thread while others replace it
+ *
+ * Each call runs on a copy taken under the lock, and Set() returns only once
+ * a call of a previous handler has finished - after Set(nullptr) the old
+ * handler is no longer running and won't be called again. A handler may
+ * replace itself (it isn't waited for then).
+ */
+template <typename... Args>
+class CaribouLiteGuardedHandler
+{
+public:
+    void Set(std::function<void(Args...)> fn)
+    {
+        std::unique_lock<std::mutex> lock(_mtx);
+        _fn = fn;
+        uint64_t gen = ++_gen;
+        if (_caller == std::this_thread::get_id()) return;
+        _cv.wait(lock, [this, gen]{return _calling_gen == 0 || _calling_gen >= gen;});
+    }
+
+    bool Call(Args... args)
+    {
+        std::function<void(Args...)> fn;
+        {
+            std::lock_guard<std::mutex> lock(_mtx);
+            if (!_fn) return false;
+            fn = _fn;
+            _calling_gen = _gen;
+            _caller = std::this_thread::get_id();
+        }
+        try
+        {
+            fn(args...);
+        }
+        catch (...)
+        {
+            Done();
+            throw;
+        }
+        Done();
+        return true;
+    }
+
+private:
+    void Done(void)
+    {
+        {
+            std::lock_guard<std::mutex> lock(_mtx);
+            _calling_gen = 0;
+            _caller = std::thread::id();
+        }
+        _cv.notify_all();
+    }
+
+    std::mutex _mtx;
+    std::condition_variable _cv;
+    std::function<void(Args...)> _fn;
+    uint64_t _gen = 1;
+    uint64_t _calling_gen = 0;          // the generation of the handler being called (0 = none)
+    std::thread::id _caller;
+};
+
 /**
  * @brief CaribouLite Frequency Range
  */
@@ -161,6 +227,11 @@ public:
     float GetEnergyDet(void);
     unsigned char GetTrueRandVal(void);
     
+    // Background sensor sampling - GetRssi / GetEnergyDet then read the cache
+    void StartSensorSampler(float rate_hz, size_t history_len = 1024);
+    void StopSensorSampler(void);
+    std::vector<cariboulite_radio_sensors_st> GetSensorHistory(size_t max_len = 1024);
+    
     // Frequency Control
     void SetFrequency(float freq_hz);
     float GetFrequency(void);
@@ -174,6 +245,8 @@ public:
     void StartReceiving(std::function<void(CaribouLiteRadio*, const std::complex<short>*, size_t)> on_data_ready, size_t samples_per_chunk = 0);
     void StartReceiving();
     void StartReceivingInternal(size_t samples_per_chunk);
+    void SetRxIdleHandler(std::function<void(CaribouLiteRadio*)> on_rx_idle);
+    void ClearRxDataHandlers(void);
     void StopReceiving(void);
     void StartTransmitting(void);
     void StartTransmittingLo(void);
@@ -191,6 +264,8 @@ public:
     // General
     size_t GetNativeMtuSample(void);
     std::string GetRadioName(void);
+    ApiType GetApiType(void);
+    float GetRxStartLatencyMs(void);
     void FlushBuffers(void);
     
 private:
@@ -198,14 +273,22 @@ private:
     const CaribouLite* _device;
     const RadioType _type;
     
-    // Rx information
-    bool _rx_thread_running;
-    bool _rx_is_active;
+    // Rx information - the reader thread is created on the first StartReceiving
+    // and parks on _rx_cv while the radio isn't receiving
+    std::atomic<bool> _rx_thread_running;
+    std::atomic<bool> _rx_is_active;
     std::thread *_rx_thread;
-    std::function<void(CaribouLiteRadio*, const std::complex<float>*, CaribouLiteMeta*, size_t)> _on_data_ready_fm;
-    std::function<void(CaribouLiteRadio*, const std::complex<float>*, size_t)> _on_data_ready_f;
-    std::function<void(CaribouLiteRadio*, const std::complex<short>*, CaribouLiteMeta*, size_t)> _on_data_ready_im;
-    std::function<void(CaribouLiteRadio*, const std::complex<short>*, size_t)> _on_data_ready_i;
+    std::mutex _rx_mtx;
+    std::condition_variable _rx_cv;
+    std::chrono::steady_clock::time_point _rx_start_time;
+    std::atomic<bool> _rx_first_block;
+    std::atomic<long> _rx_start_latency_us;
+    // replaced by the user while the reader calls them
+    CaribouLiteGuardedHandler<CaribouLiteRadio*, const std::complex<float>*, CaribouLiteMeta*, size_t> _on_data_ready_fm;
+    CaribouLiteGuardedHandler<CaribouLiteRadio*, const std::complex<float>*, size_t> _on_data_ready_f;
+    CaribouLiteGuardedHandler<CaribouLiteRadio*, const std::complex<short>*, CaribouLiteMeta*, size_t> _on_data_ready_im;
+    CaribouLiteGuardedHandler<CaribouLiteRadio*, const std::complex<short>*, size_t> _on_data_ready_i;
+    CaribouLiteGuardedHandler<CaribouLiteRadio*> _on_rx_idle;
     size_t _rx_samples_per_chunk;
     RxCbType _rxCallbackType;
     ApiType _api_type;
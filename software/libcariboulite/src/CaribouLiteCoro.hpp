@@ -0,0 +1,238 @@
+/**
+ * @file CaribouLiteCoro.hpp
+ * @date September 2023
+ * @brief C++20 awaitable Rx API
+ *
+ * An optional coroutine front-end for CaribouLiteRadio. Sample blocks are
+ * delivered by the radio's own reader thread (Async API type): the awaiting
+ * coroutine is resumed inline on that thread, so no handoff thread or queue
+ * is created. A block's data is valid until the coroutine awaits again, the
+ * same lifetime as the buffers passed to the StartReceiving callbacks.
+ *
+ *      CaribouLiteRxStream<std::complex<float>> rx(radio);
+ *      while (auto blk = co_await rx.NextBlock(std::chrono::milliseconds(100)))
+ *      {
+ *          process(blk.samples, blk.num_samples);
+ *      }
+ *
+ * The header compiles to nothing unless the compiler supports C++20
+ * coroutines (CARIBOULITE_HAS_COROUTINES is defined when it does).
+ */
+
+#ifndef __CARIBOULITE_CORO_HPP__
+#define __CARIBOULITE_CORO_HPP__
+
+#include <CaribouLite.hpp>
+
+#if defined(__has_include)
+  #if __has_include(<coroutine>) && (__cplusplus >= 202002L) && defined(__cpp_impl_coroutine)
+    #define CARIBOULITE_HAS_COROUTINES 1
+  #endif
+#endif
+
+#ifdef CARIBOULITE_HAS_COROUTINES
+
+#include <coroutine>
+#include <chrono>
+#include <atomic>
+#include <stdexcept>
+#include <type_traits>
+
+/**
+ * @brief Awaitable Rx sample stream over a CaribouLiteRadio
+ *
+ * T is either std::complex<float> (normalized samples) or std::complex<short>
+ * (native 13 bit samples). Only one coroutine may await a stream at a time.
+ * Blocks that arrive while no coroutine is waiting are dropped and counted.
+ */
+template <typename T>
+class CaribouLiteRxStream
+{
+    static_assert(std::is_same<T, std::complex<float>>::value || std::is_same<T, std::complex<short>>::value,
+                  "CaribouLiteRxStream supports std::complex<float> and std::complex<short> samples");
+
+public:
+    enum class Status
+    {
+        Ok = 0,
+        Timeout = 1,
+        Cancelled = 2,
+    };
+
+    struct Block
+    {
+        Status status;
+        const T* samples;
+        const CaribouLiteMeta* meta;
+        size_t num_samples;
+
+        explicit operator bool() const { return status == Status::Ok; }
+    };
+
+private:
+    typedef std::chrono::steady_clock Clock;
+
+    // shared with the reader thread callbacks so that a late callback never
+    // touches a destroyed stream
+    struct State
+    {
+        std::mutex mtx;
+        std::coroutine_handle<> waiter;
+        Block* result;
+        bool has_deadline;
+        Clock::time_point deadline;
+        std::atomic<bool> cancelled {false};
+        std::atomic<uint64_t> dropped {0};
+
+        // hand a result to the waiting coroutine (if any) and resume it on the calling thread
+        bool Complete(const Block& b, bool timeout_only)
+        {
+            std::coroutine_handle<> h;
+            {
+                std::lock_guard<std::mutex> lock(mtx);
+                if (!waiter) return false;
+                if (timeout_only && (!has_deadline || Clock::now() < deadline)) return true;
+                h = waiter;
+                *result = b;
+                waiter = nullptr;
+                result = nullptr;
+            }
+            h.resume();
+            return true;
+        }
+    };
+
+public:
+    class Awaiter
+    {
+    public:
+        Awaiter(std::shared_ptr<State> state, bool has_deadline, Clock::time_point deadline)
+            : _state(state), _has_deadline(has_deadline), _deadline(deadline),
+              _result{Status::Cancelled, nullptr, nullptr, 0} {}
+
+        bool await_ready() const noexcept { return _state->cancelled.load(); }
+
+        bool await_suspend(std::coroutine_handle<> h)
+        {
+            std::lock_guard<std::mutex> lock(_state->mtx);
+            if (_state->cancelled.load()) return false;
+            if (_state->waiter)
+            {
+                throw std::logic_error("CaribouLiteRxStream: another coroutine is already awaiting this stream");
+            }
+            _state->waiter = h;
+            _state->result = &_result;
+            _state->has_deadline = _has_deadline;
+            _state->deadline = _deadline;
+            return true;
+        }
+
+        Block await_resume() const noexcept { return _result; }
+
+    private:
+        std::shared_ptr<State> _state;
+        bool _has_deadline;
+        Clock::time_point _deadline;
+        Block _result;
+    };
+
+public:
+    /**
+     * @brief Start receiving on the radio and deliver the chunks to awaiting coroutines
+     *
+     * @param radio a radio created with the Async API type (owns the reader thread)
+     * @param samples_per_chunk chunk size (0 = native MTU)
+     */
+    CaribouLiteRxStream(CaribouLiteRadio* radio, size_t samples_per_chunk = 0)
+        : _radio(radio), _state(std::make_shared<State>())
+    {
+        if (_radio == nullptr)
+        {
+            throw std::invalid_argument("CaribouLiteRxStream: radio is null");
+        }
+        if (_radio->GetApiType() != CaribouLiteRadio::ApiType::Async)
+        {
+            throw std::invalid_argument("CaribouLiteRxStream: the radio must use the Async API type");
+        }
+
+        std::shared_ptr<State> state = _state;
+        std::function<void(CaribouLiteRadio*, const T*, CaribouLiteMeta*, size_t)> on_data =
+            [state](CaribouLiteRadio*, const T* samples, CaribouLiteMeta* meta, size_t num_samples)
+            {
+                std::shared_ptr<State> s = state;     // the resumed coroutine may drop the stream
+                Block b {Status::Ok, samples, meta, num_samples};
+                if (!s->Complete(b, false)) s->dropped++;
+            };
+        std::function<void(CaribouLiteRadio*)> on_idle =
+            [state](CaribouLiteRadio*)
+            {
+                std::shared_ptr<State> s = state;
+                Block b {Status::Timeout, nullptr, nullptr, 0};
+                s->Complete(b, true);
+            };
+
+        _radio->SetRxIdleHandler(on_idle);
+        _radio->StartReceiving(on_data, samples_per_chunk);
+    }
+
+    CaribouLiteRxStream(const CaribouLiteRxStream&) = delete;
+    CaribouLiteRxStream& operator=(const CaribouLiteRxStream&) = delete;
+
+    // a callback that is resuming the coroutine on the reader thread is
+    // waited for - the coroutine may still use the stream until then
+    ~CaribouLiteRxStream()
+    {
+        Cancel();
+        _radio->StopReceiving();
+        _radio->ClearRxDataHandlers();
+        _radio->SetRxIdleHandler(nullptr);
+    }
+
+    /**
+     * @brief Await the next sample block
+     *
+     * Completes with Status::Ok and the block, or with Status::Cancelled once
+     * Cancel() was called.
+     */
+    Awaiter NextBlock(void)
+    {
+        return Awaiter(_state, false, Clock::time_point());
+    }
+
+    /**
+     * @brief Await the next sample block with a timeout
+     *
+     * The timeout is checked by the reader thread between SMI reads, so its
+     * resolution is the SMI read timeout (a few milliseconds). A stream that
+     * was stopped (StopReceiving) does not time out.
+     */
+    template <typename Rep, typename Period>
+    Awaiter NextBlock(std::chrono::duration<Rep, Period> timeout)
+    {
+        return Awaiter(_state, true, Clock::now() + std::chrono::duration_cast<Clock::duration>(timeout));
+    }
+
+    /**
+     * @brief Cancel the stream
+     *
+     * A pending NextBlock completes with Status::Cancelled (resumed on the
+     * calling thread) and all later ones complete immediately.
+     */
+    void Cancel(void)
+    {
+        _state->cancelled = true;
+        Block b {Status::Cancelled, nullptr, nullptr, 0};
+        _state->Complete(b, false);
+    }
+
+    bool IsCancelled(void) { return _state->cancelled.load(); }
+    uint64_t GetDroppedBlocks(void) { return _state->dropped.load(); }
+
+private:
+    CaribouLiteRadio* _radio;
+    std::shared_ptr<State> _state;
+};
+
+#endif // CARIBOULITE_HAS_COROUTINES
+
+#endif // __CARIBOULITE_CORO_HPP__
@@ -11,28 +11,37 @@ void CaribouLiteRadio::CaribouLiteRxThread(CaribouLiteRadio* radio)
     
     //printf("Enterred Thread\n");
     
-    while (radio->_rx_thread_running)
+    while (true)
     {
-        if (!radio->_rx_is_active)
         {
-            std::this_thread::sleep_for(std::chrono::milliseconds(2));
-            continue;
+            // park until receiving is (re)started - no wakeups while idle
+            std::unique_lock<std::mutex> lock(radio->_rx_mtx);
+            radio->_rx_cv.wait(lock, [radio]{return !radio->_rx_thread_running || radio->_rx_is_active;});
+            if (!radio->_rx_thread_running) break;
         }
         
         int ret = cariboulite_radio_read_samples((cariboulite_radio_state_st*)radio->_radio, 
                                                  (cariboulite_sample_complex_int16*)rx_buffer, 
                                                  (cariboulite_sample_meta*)rx_meta_buffer, 
                                                  radio->_rx_samples_per_chunk);
-        if (ret < 0)
+        if (ret <= 0)
         {
             if (ret == -1)
             {
                 //printf("reader thread failed to read SMI!\n");
             }
-            ret = 0;
+            
+            // let the idle handler (e.g. awaitable timeouts) run between reads
+            radio->_on_rx_idle.Call(radio);
             continue;
         }
-        if (ret == 0) continue;
+        
+        // stream start latency - activation request to first delivered block
+        if (radio->_rx_first_block.exchange(false))
+        {
+            radio->_rx_start_latency_us = (long)std::chrono::duration_cast<std::chrono::microseconds>(
+                            std::chrono::steady_clock::now() - radio->_rx_start_time).count();
+        }
         
         // convert the buffer
         if (radio->_rxCallbackType == CaribouLiteRadio::RxCbType::FloatSync || radio->_rxCallbackType == CaribouLiteRadio::RxCbType::Float)
@@ -49,10 +58,10 @@ void CaribouLiteRadio::CaribouLiteRxThread(CaribouLiteRadio* radio)
         {
             switch(radio->_rxCallbackType)
             {
-            case (CaribouLiteRadio::RxCbType::FloatSync): if (radio->_on_data_ready_fm) radio->_on_data_ready_fm(radio, rx_copmlex_data, rx_meta_buffer, ret); break;
-            case (CaribouLiteRadio::RxCbType::Float): if (radio->_on_data_ready_f) radio->_on_data_ready_f(radio, rx_copmlex_data, ret); break;
-            case (CaribouLiteRadio::RxCbType::IntSync): if (radio->_on_data_ready_im) radio->_on_data_ready_im(radio, rx_buffer, rx_meta_buffer, ret); break;
-            case (CaribouLiteRadio::RxCbType::Int): if (radio->_on_data_ready_i) radio->_on_data_ready_i(radio, rx_buffer, ret); break;
+            case (CaribouLiteRadio::RxCbType::FloatSync): radio->_on_data_ready_fm.Call(radio, rx_copmlex_data, rx_meta_buffer, ret); break;
+            case (CaribouLiteRadio::RxCbType::Float): radio->_on_data_ready_f.Call(radio, rx_copmlex_data, ret); break;
+            case (CaribouLiteRadio::RxCbType::IntSync): radio->_on_data_ready_im.Call(radio, rx_buffer, rx_meta_buffer, ret); break;
+            case (CaribouLiteRadio::RxCbType::Int): radio->_on_data_ready_i.Call(radio, rx_buffer, ret); break;
             case (CaribouLiteRadio::RxCbType::None):
             default: break;
             }
@@ -100,7 +109,7 @@ int CaribouLiteRadio::ReadSamples(std::complex<short>* samples, size_t num_to_re
     if (!_rx_is_active || _read_samples == NULL || _read_metadata == NULL || num_to_read == 0)
     {
         printf("reading from closed stream: rx_active = %d, _read_samples_is_null=%d, _read_metadata_is_null=%d, num_to_read=%ld\n",
-            _rx_is_active, _read_samples==NULL, _read_metadata==NULL, num_to_read);
+            _rx_is_active.load(), _read_samples==NULL, _read_metadata==NULL, num_to_read);
         return 0;
     }        
     
@@ -176,18 +185,18 @@ CaribouLiteRadio::CaribouLiteRadio( const cariboulite_radio_state_st* radio,
             : _radio(radio), _device(parent), _type(type), _rxCallbackType(RxCbType::None), _api_type(api_type)
 {
     size_t mtu_size = GetNativeMtuSample();
-    if (_api_type == Async)
-    {
-        //printf("Creating Radio Type %d ASYNC\n", type);
-        _rx_thread_running = true;
-        _rx_thread = new std::thread(CaribouLiteRadio::CaribouLiteRxThread, this);
-    }
-    else
+    _rx_thread_running = false;
+    _rx_is_active = false;
+    _rx_thread = NULL;
+    _rx_first_block = false;
+    _rx_start_latency_us = -1;
+    _read_samples = NULL;
+    _read_metadata = NULL;
+    
+    // in async mode the reader thread is created on the first StartReceiving
+    if (_api_type == Sync)
     {
         //printf("Creating Radio Type %d SYNC\n", type);
-        _read_samples = NULL;
-        _read_metadata = NULL;
-        
         // allocate internal buffers
         _read_samples = new cariboulite_sample_complex_int16[mtu_size];       
         _read_metadata = new cariboulite_sample_meta[mtu_size];        
@@ -206,9 +215,17 @@ CaribouLiteRadio::~CaribouLiteRadio()
     
     if (_api_type == Async)
     {
-        _rx_thread_running = false;
-        _rx_thread->join();
-        if (_rx_thread) delete _rx_thread;
+        {
+            std::lock_guard<std::mutex> lock(_rx_mtx);
+            _rx_thread_running = false;
+        }
+        _rx_cv.notify_one();
+        if (_rx_thread)
+        {
+            _rx_thread->join();
+            delete _rx_thread;
+        }
+        _rx_thread = NULL;
     }
     else
     {
@@ -445,6 +462,11 @@ float CaribouLiteRadio::GetTxSampleRate()
 //==================================================================
 float CaribouLiteRadio::GetRssi()
 {
+    cariboulite_radio_sensors_st cached;
+    if (cariboulite_radio_get_cached_sensors((cariboulite_radio_state_st*)_radio, &cached) == 0)
+    {
+        return cached.rssi_dbm;
+    }
     float rssi = 0.0f;
     cariboulite_radio_get_rssi((cariboulite_radio_state_st*)_radio, &rssi);
     return rssi;
@@ -453,11 +475,40 @@ float CaribouLiteRadio::GetRssi()
 //==================================================================
 float CaribouLiteRadio::GetEnergyDet()
 {
+    cariboulite_radio_sensors_st cached;
+    if (cariboulite_radio_get_cached_sensors((cariboulite_radio_state_st*)_radio, &cached) == 0)
+    {
+        return cached.energy_dbm;
+    }
     float ed = 0.0f;
     cariboulite_radio_get_energy_det((cariboulite_radio_state_st*)_radio, &ed);
     return ed;
 }
 
+//==================================================================
+void CaribouLiteRadio::StartSensorSampler(float rate_hz, size_t history_len)
+{
+    if (cariboulite_radio_start_sensor_sampler((cariboulite_radio_state_st*)_radio, rate_hz, history_len) != 0)
+    {
+        throw std::runtime_error("Sensor sampler start failed");
+    }
+}
+
+//==================================================================
+void CaribouLiteRadio::StopSensorSampler(void)
+{
+    cariboulite_radio_stop_sensor_sampler((cariboulite_radio_state_st*)_radio);
+}
+
+//==================================================================
+std::vector<cariboulite_radio_sensors_st> CaribouLiteRadio::GetSensorHistory(size_t max_len)
+{
+    std::vector<cariboulite_radio_sensors_st> history(max_len);
+    int num = cariboulite_radio_get_sensors_history((cariboulite_radio_state_st*)_radio, history.data(), max_len);
+    history.resize(num > 0 ? num : 0);
+    return history;
+}
+
 //==================================================================
 unsigned char CaribouLiteRadio::GetTrueRandVal()
 {
@@ -536,8 +587,23 @@ void CaribouLiteRadio::StartReceivingInternal(size_t samples_per_chunk)
     CaribouLiteRadio* otherRadio = ((CaribouLite*)_device)->GetRadioChannel((_type==RadioType::S1G)?(RadioType::HiF):(RadioType::S1G));
     otherRadio->StopReceiving();
     
+    std::chrono::steady_clock::time_point start_time = std::chrono::steady_clock::now();
     cariboulite_radio_activate_channel((cariboulite_radio_state_st*)_radio, cariboulite_channel_dir_rx, true);
-    _rx_is_active = true;
+    
+    {
+        std::lock_guard<std::mutex> lock(_rx_mtx);
+        _rx_start_time = start_time;
+        _rx_first_block = true;
+        _rx_is_active = true;
+        
+        // lazily create the reader thread (async api only)
+        if (_api_type == Async && _rx_thread == NULL)
+        {
+            _rx_thread_running = true;
+            _rx_thread = new std::thread(CaribouLiteRadio::CaribouLiteRxThread, this);
+        }
+    }
+    _rx_cv.notify_one();
 }
 
 //==================================================================
@@ -548,7 +614,7 @@ void CaribouLiteRadio::StartReceiving(std::function<void(CaribouLiteRadio*, cons
         StartReceiving();
         return;
     }
-    _on_data_ready_fm = on_data_ready;
+    _on_data_ready_fm.Set(on_data_ready);
     _rxCallbackType = RxCbType::FloatSync;
     StartReceivingInternal(samples_per_chunk);
 }
@@ -561,7 +627,7 @@ void CaribouLiteRadio::StartReceiving(std::function<void(CaribouLiteRadio*, cons
         StartReceiving();
         return;
     }
-    _on_data_ready_f = on_data_ready;
+    _on_data_ready_f.Set(on_data_ready);
     _rxCallbackType = RxCbType::Float;
     StartReceivingInternal(samples_per_chunk);
 }
@@ -574,7 +640,7 @@ void CaribouLiteRadio::StartReceiving(std::function<void(CaribouLiteRadio*, cons
         StartReceiving();
         return;
     }
-    _on_data_ready_im = on_data_ready;
+    _on_data_ready_im.Set(on_data_ready);
     _rxCallbackType = RxCbType::IntSync;
     StartReceivingInternal(samples_per_chunk);
 }
@@ -587,7 +653,7 @@ void CaribouLiteRadio::StartReceiving(std::function<void(CaribouLiteRadio*, cons
         StartReceiving();
         return;
     }
-    _on_data_ready_i = on_data_ready;
+    _on_data_ready_i.Set(on_data_ready);
     _rxCallbackType = RxCbType::Int;
     StartReceivingInternal(samples_per_chunk);
 }
@@ -595,11 +661,31 @@ void CaribouLiteRadio::StartReceiving(std::function<void(CaribouLiteRadio*, cons
 //==================================================================
 void CaribouLiteRadio::StartReceiving()
 {
-    _on_data_ready_im = nullptr;
+    _on_data_ready_im.Set(nullptr);
     _rxCallbackType = RxCbType::None;
     StartReceivingInternal(0);
 }
 
+//==================================================================
+void CaribouLiteRadio::SetRxIdleHandler(std::function<void(CaribouLiteRadio*)> on_rx_idle)
+{
+    // waits out an idle call in progress - after SetRxIdleHandler(nullptr)
+    // the previous handler isn't running anymore
+    _on_rx_idle.Set(on_rx_idle);
+}
+
+//==================================================================
+void CaribouLiteRadio::ClearRxDataHandlers()
+{
+    // like SetRxIdleHandler(nullptr) - returns once a data callback in
+    // progress has returned, none is called afterwards
+    _rxCallbackType = RxCbType::None;
+    _on_data_ready_fm.Set(nullptr);
+    _on_data_ready_f.Set(nullptr);
+    _on_data_ready_im.Set(nullptr);
+    _on_data_ready_i.Set(nullptr);
+}
+
 //==================================================================
 void CaribouLiteRadio::StopReceiving()
 {
@@ -677,6 +763,19 @@ std::string CaribouLiteRadio::GetRadioName()
     return std::string(name);
 }
 
+//==================================================================
+float CaribouLiteRadio::GetRxStartLatencyMs()
+{
+    long lat = _rx_start_latency_us;
+    return (lat < 0) ? -1.0f : (lat / 1000.0f);
+}
+
+//==================================================================
+CaribouLiteRadio::ApiType CaribouLiteRadio::GetApiType()
+{
+    return _api_type;
+}
+
 //==================================================================
 void CaribouLiteRadio::FlushBuffers()
 {
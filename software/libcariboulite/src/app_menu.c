@@ -16,6 +16,7 @@ typedef enum
 	app_selection_modem_tx_cw,
 	app_selection_modem_rx_iq,
 	app_selection_synthesizer,
+	app_selection_bitbang_benchmark,
 	app_selection_quit = 99,
 } app_selection_en;
 
@@ -39,6 +40,7 @@ static void fpga_smi_fifo(sys_st *sys);
 static void modem_tx_cw(sys_st *sys);
 static void modem_rx_iq(sys_st *sys);
 static void synthesizer(sys_st *sys);
+static void bitbang_benchmark(sys_st *sys);
 
 //=================================================
 app_menu_item_st handles[] =
@@ -54,6 +56,7 @@ app_menu_item_st handles[] =
 	{app_selection_modem_tx_cw, modem_tx_cw, "Modem transmit CW signal",},
 	{app_selection_modem_rx_iq, modem_rx_iq, "Modem receive I/Q stream",},
     {app_selection_synthesizer, synthesizer, "Synthesizer 85-4200 MHz",},
+	{app_selection_bitbang_benchmark, bitbang_benchmark, "Bit-banged SPI benchmark",},
 };
 #define NUM_HANDLES 	(int)(sizeof(handles)/sizeof(app_menu_item_st))
 
@@ -666,7 +669,7 @@ static void synthesizer(sys_st *sys)
     caribou_fpga_set_io_ctrl_mode (&radio_hi->sys->fpga, 0, caribou_fpga_io_ctrl_rfm_tx_lowpass);
     cariboulite_radio_ext_ref (radio_hi->sys, cariboulite_ext_ref_32mhz);
     rffc507x_set_frequency(&radio_hi->sys->mixer, current_freq);
-    lock = cariboulite_radio_wait_mixer_lock(radio_hi, 10);
+    lock = cariboulite_radio_wait_mixer_lock(radio_hi, CARIBOULITE_PLL_LOCK_TIMEOUT_US);
     rffc507x_calibrate(&radio_hi->sys->mixer);
     
     while (1)
@@ -691,7 +694,7 @@ static void synthesizer(sys_st *sys)
                 else caribou_fpga_set_io_ctrl_mode (&radio_hi->sys->fpga, 0, caribou_fpga_io_ctrl_rfm_tx_hipass);
                 
                 double act_freq = rffc507x_set_frequency(&radio_hi->sys->mixer, current_freq);
-                lock = cariboulite_radio_wait_mixer_lock(radio_hi, 10);
+                lock = cariboulite_radio_wait_mixer_lock(radio_hi, CARIBOULITE_PLL_LOCK_TIMEOUT_US);
                 
 				if (active)
 				{
@@ -729,6 +732,36 @@ static void synthesizer(sys_st *sys)
 }
 
 
+//=================================================
+static void bitbang_benchmark(sys_st *sys)
+{
+	io_utils_bitbang_calib_st calib = {0};
+	uint32_t bits = 1000000;
+
+	io_utils_bitbang_get_calibration(&calib);
+	printf("    Delay loop: %.2f ns, GPIO write: %.2f ns\n", calib.loop_ns, calib.gpio_write_ns);
+
+	float rate = 0.0f;
+	if (sys->spi_dev.chips[sys->fpga.prog_dev.io_spi_handle].is_hard_spi)
+	{
+		printf("    ICE40 programming: SPI controller at %.3f MHz\n",
+				sys->spi_dev.chips[sys->fpga.prog_dev.io_spi_handle].clock / 1e6f);
+	}
+	else
+	{
+		rate = io_utils_spi_benchmark_bitbang(&sys->spi_dev, sys->fpga.prog_dev.io_spi_handle, bits);
+		printf("    ICE40 programming: %.3f Mbit/s (rated %.3f MHz)\n", rate / 1e6f,
+				sys->spi_dev.chips[sys->fpga.prog_dev.io_spi_handle].clock / 1e6f);
+	}
+
+	if (sys->board_info.numeric_product_id == system_type_cariboulite_full)
+	{
+		rate = io_utils_spi_benchmark_bitbang(&sys->spi_dev, sys->mixer.io_spi_handle, bits);
+		printf("    RFFC507X: %.3f Mbit/s (rated %.3f MHz)\n", rate / 1e6f,
+				sys->spi_dev.chips[sys->mixer.io_spi_handle].clock / 1e6f);
+	}
+}
+
 //=================================================
 int app_menu(sys_st* sys)
 {
@@ -17,80 +17,450 @@
 #include "at86rf215_radio.h"
 #include "at86rf215_regs.h"
 
+// shadow register states
+#define SHADOW_UNKNOWN          ( 0 )
+#define SHADOW_VALID            ( 1 )
+#define SHADOW_DIRTY            ( 2 )       // deferred, not yet written to the chip
+
+#define SHADOW_MAX_BRIDGE       ( 2 )       // clean registers rewritten to merge two dirty runs
+
 //===================================================================
-int at86rf215_write_buffer(at86rf215_st* dev, uint16_t addr, uint8_t *buffer, uint8_t size )
+// queue a register access into an SPI batch, submitting the batch first when it is full
+// (only used when the batch holds nothing but writes, whose RX data is not needed)
+static int at86rf215_batch_add(at86rf215_st* dev, io_utils_spi_batch_st* batch, uint16_t addr,
+                                const uint8_t *buffer, uint8_t size, bool write)
 {
     // a maximal possible chunk size - 256 + 2(addr)
     uint8_t chunk_tx[258] = {0};
-    uint8_t chunk_rx[258] = {0};
-    chunk_tx[0] = ((addr >> 8) & 0x3F) | 0x80;
+    chunk_tx[0] = ((addr >> 8) & 0x3F) | (write ? 0x80 : 0x00);
     chunk_tx[1] = addr & 0xFF;
-    memcpy(chunk_tx + 2, buffer, size);
+    if (write) memcpy(chunk_tx + 2, buffer, size);
+
+    int index = io_utils_spi_batch_add(batch, chunk_tx, size + 2);
+    if (index >= 0) return index;
+
+    dev->shadow_stats.spi_transactions++;
+    int ret = io_utils_spi_transmit_batch(dev->io_spi, batch);
+    io_utils_spi_batch_init(batch, dev->io_spi_handle);
+    if (ret < 0) return -1;
+    return io_utils_spi_batch_add(batch, chunk_tx, size + 2);
+}
+
+//===================================================================
+static int at86rf215_batch_submit(at86rf215_st* dev, io_utils_spi_batch_st* batch)
+{
+    if (batch->num_xfers == 0) return 0;
+    dev->shadow_stats.spi_transactions++;
+    return io_utils_spi_transmit_batch(dev->io_spi, batch);
+}
+
+//===================================================================
+// the shadow index of a register, -1 if it isn't shadowed
+static int at86rf215_shadow_index(uint16_t addr)
+{
+    uint16_t page = addr >> 8;
+    uint16_t offset = addr & 0xFF;
+    if (page >= AT86RF215_SHADOW_PAGES || offset >= AT86RF215_SHADOW_PAGE_SIZE) return -1;
+    return page * AT86RF215_SHADOW_PAGE_SIZE + offset;
+}
+
+//===================================================================
+// registers that the chip changes by itself (status, measurements, the
+// automatic TX calibration) or that are commands - never cached
+static bool at86rf215_reg_is_volatile(uint16_t addr)
+{
+    uint16_t offset = addr & 0xFF;
+    if ((addr >> 8) == 0)
+    {
+        switch (offset)
+        {
+            case 0x00: case 0x01: case 0x02: case 0x03:     // IRQS
+            case 0x05:                                      // RST
+            case 0x0A: case 0x0B: case 0x0C:                // IQIFC0..2 (status bits)
+                return true;
+            default: return false;
+        }
+    }
+
+    switch (offset)
+    {
+        case 0x01:                                          // AUXS (AVS status)
+        case 0x02:                                          // STATE
+        case 0x03:                                          // CMD
+        case 0x0B: case 0x0C:                               // AGCC / AGCS (freeze status, current gain)
+        case 0x0D:                                          // RSSI
+        case 0x0E: case 0x10:                               // EDC (single mode ends), EDV
+        case 0x11:                                          // RNDV
+        case 0x21:                                          // PLL (lock status)
+        case 0x25: case 0x26:                               // TXCI / TXCQ (re-calibrated by the chip)
+            return true;
+        default: return false;
+    }
+}
+
+//===================================================================
+// CNM latches the channel registers - it is rewritten whenever they are
+static bool at86rf215_reg_is_latch(uint16_t addr)
+{
+    return (addr >> 8) != 0 && (addr & 0xFF) == 0x08;
+}
+
+//===================================================================
+static bool at86rf215_shadow_cacheable(uint16_t addr, uint8_t size)
+{
+    for (int i = 0; i < size; i++)
+    {
+        uint16_t a = addr + i;
+        if (at86rf215_shadow_index(a) < 0 || at86rf215_reg_is_volatile(a)) return false;
+    }
+    return true;
+}
+
+//===================================================================
+// queue the deferred writes into "batch" - the caller submits it, possibly
+// with its own access appended so everything goes out in one syscall
+static int at86rf215_shadow_queue_dirty(at86rf215_st* dev, io_utils_spi_batch_st* batch)
+{
+    uint32_t bursts = 0;
+    if (dev->shadow_deferred == 0) return 0;
+
+    for (int page = 0; page < AT86RF215_SHADOW_PAGES; page++)
+    {
+        uint8_t* state = dev->shadow_state + page * AT86RF215_SHADOW_PAGE_SIZE;
+        int i = 0;
+        while (i < AT86RF215_SHADOW_PAGE_SIZE)
+        {
+            if (state[i] != SHADOW_DIRTY) { i++; continue; }
+
+            // extend the run over short gaps of known, non-volatile registers
+            int first = i, last = i;
+            for (int j = i + 1; j < AT86RF215_SHADOW_PAGE_SIZE; j++)
+            {
+                if (state[j] == SHADOW_DIRTY) { last = j; continue; }
+                uint16_t a = (page << 8) + j;
+                if (state[j] != SHADOW_VALID || at86rf215_reg_is_volatile(a) || j - last > SHADOW_MAX_BRIDGE) break;
+            }
+
+            uint16_t addr = (page << 8) + first;
+            int size = last - first + 1;
+            if (at86rf215_batch_add(dev, batch, addr, dev->shadow + page * AT86RF215_SHADOW_PAGE_SIZE + first, size, true) < 0)
+            {
+                ZF_LOGE("shadow flush of 0x%04X (%d bytes) failed", addr, size);
+                memset(dev->shadow_state, SHADOW_UNKNOWN, sizeof(dev->shadow_state));
+                dev->shadow_deferred = 0;
+                return -1;
+            }
+            memset(state + first, SHADOW_VALID, size);
+            bursts++;
+            i = last + 1;
+        }
+    }
+
+    if (dev->shadow_deferred > bursts) dev->shadow_stats.writes_combined += dev->shadow_deferred - bursts;
+    dev->shadow_deferred = 0;
+    return 0;
+}
+
+//===================================================================
+static int at86rf215_shadow_flush_locked(at86rf215_st* dev)
+{
+    io_utils_spi_batch_st batch;
+    io_utils_spi_batch_init(&batch, dev->io_spi_handle);
+    if (at86rf215_shadow_queue_dirty(dev, &batch) < 0) return -1;
+    if (at86rf215_batch_submit(dev, &batch) < 0)
+    {
+        ZF_LOGE("shadow flush failed");
+        memset(dev->shadow_state, SHADOW_UNKNOWN, sizeof(dev->shadow_state));
+        return -1;
+    }
+    return 0;
+}
 
-    return io_utils_spi_transmit(dev->io_spi, dev->io_spi_handle, chunk_tx, chunk_rx, size + 2, io_utils_spi_read_write);
+//===================================================================
+static int at86rf215_spi_write(at86rf215_st* dev, uint16_t addr, const uint8_t *buffer, uint8_t size)
+{
+    io_utils_spi_batch_st batch;
+    io_utils_spi_batch_init(&batch, dev->io_spi_handle);
+    if (at86rf215_batch_add(dev, &batch, addr, buffer, size, true) < 0) return -1;
+    return at86rf215_batch_submit(dev, &batch);
+}
+
+//===================================================================
+static int at86rf215_spi_read(at86rf215_st* dev, uint16_t addr, uint8_t *buffer, uint8_t size)
+{
+    io_utils_spi_batch_st batch;
+    io_utils_spi_batch_init(&batch, dev->io_spi_handle);
+    int index = at86rf215_batch_add(dev, &batch, addr, NULL, size, false);
+    if (index < 0 || at86rf215_batch_submit(dev, &batch) < 0) return -1;
+    memcpy(buffer, io_utils_spi_batch_rx(&batch, index) + 2, size);
+    return 0;
+}
+
+//===================================================================
+int at86rf215_write_buffer(at86rf215_st* dev, uint16_t addr, uint8_t *buffer, uint8_t size )
+{
+    if (!dev->shadow_enabled)
+    {
+        return at86rf215_spi_write(dev, addr, buffer, size);
+    }
+
+    int ret = 0;
+    pthread_mutex_lock(&dev->shadow_mtx);
+    if (at86rf215_shadow_cacheable(addr, size))
+    {
+        // only the span that changes is written (through the channel latch)
+        int idx = at86rf215_shadow_index(addr);
+        int first = -1, last = -1, latch = -1;
+        for (int i = 0; i < size; i++)
+        {
+            if (at86rf215_reg_is_latch(addr + i)) latch = i;
+            if (dev->shadow_state[idx + i] == SHADOW_UNKNOWN || dev->shadow[idx + i] != buffer[i])
+            {
+                if (first < 0) first = i;
+                last = i;
+            }
+        }
+
+        if (first < 0)
+        {
+            dev->shadow_stats.writes_skipped++;
+            pthread_mutex_unlock(&dev->shadow_mtx);
+            return 0;
+        }
+        if (latch > last) last = latch;
+        dev->shadow_stats.bytes_trimmed += size - (last - first + 1);
+
+        memcpy(dev->shadow + idx + first, buffer + first, last - first + 1);
+        if (dev->shadow_batch > 0)
+        {
+            memset(dev->shadow_state + idx + first, SHADOW_DIRTY, last - first + 1);
+            dev->shadow_deferred++;
+        }
+        else
+        {
+            ret = at86rf215_spi_write(dev, addr + first, buffer + first, last - first + 1);
+            memset(dev->shadow_state + idx + first, ret == 0 ? SHADOW_VALID : SHADOW_UNKNOWN, last - first + 1);
+        }
+        pthread_mutex_unlock(&dev->shadow_mtx);
+        return ret;
+    }
+
+    // commands and status registers keep their order relative to the deferred
+    // writes, which go out ahead of them in the same batch
+    io_utils_spi_batch_st batch;
+    io_utils_spi_batch_init(&batch, dev->io_spi_handle);
+    ret = at86rf215_shadow_queue_dirty(dev, &batch);
+    if (ret == 0 && at86rf215_batch_add(dev, &batch, addr, buffer, size, true) < 0) ret = -1;
+    if (ret == 0) ret = at86rf215_batch_submit(dev, &batch);
+    for (int i = 0; i < size; i++)
+    {
+        int idx = at86rf215_shadow_index(addr + i);
+        if (idx < 0) continue;
+        dev->shadow[idx] = buffer[i];
+        dev->shadow_state[idx] = (ret == 0 && !at86rf215_reg_is_volatile(addr + i)) ? SHADOW_VALID : SHADOW_UNKNOWN;
+    }
+
+    // a chip reset brings all the registers back to their defaults
+    if (addr == REG_RF_RST)
+    {
+        memset(dev->shadow_state, SHADOW_UNKNOWN, sizeof(dev->shadow_state));
+    }
+    pthread_mutex_unlock(&dev->shadow_mtx);
+    return ret;
 }
 
 //===================================================================
 int at86rf215_read_buffer(at86rf215_st* dev, uint16_t addr, uint8_t *buffer, uint8_t size)
 {
-    // a maximal possible chunk size - 256 + 2(addr)
-    uint8_t chunk_tx[258] = {0};
-    uint8_t chunk_rx[258] = {0};
-    chunk_tx[0] = (addr >> 8) & 0x3F;
-    chunk_tx[1] = addr & 0xFF;
+    if (!dev->shadow_enabled)
+    {
+        return at86rf215_spi_read(dev, addr, buffer, size);
+    }
 
-    int ret = io_utils_spi_transmit(dev->io_spi, dev->io_spi_handle, chunk_tx, chunk_rx, size + 2, io_utils_spi_read_write);
+    pthread_mutex_lock(&dev->shadow_mtx);
+    if (at86rf215_shadow_cacheable(addr, size))
+    {
+        int idx = at86rf215_shadow_index(addr);
+        bool known = true;
+        for (int i = 0; i < size && known; i++) known = dev->shadow_state[idx + i] != SHADOW_UNKNOWN;
+        if (known)
+        {
+            memcpy(buffer, dev->shadow + idx, size);
+            dev->shadow_stats.reads_cached++;
+            pthread_mutex_unlock(&dev->shadow_mtx);
+            return 0;
+        }
+    }
 
+    io_utils_spi_batch_st batch;
+    io_utils_spi_batch_init(&batch, dev->io_spi_handle);
+    int ret = at86rf215_shadow_queue_dirty(dev, &batch);
+    int index = (ret == 0) ? at86rf215_batch_add(dev, &batch, addr, NULL, size, false) : -1;
+    if (index < 0 || at86rf215_batch_submit(dev, &batch) < 0) ret = -1;
     if (ret == 0)
     {
-        memcpy(buffer, chunk_rx + 2, size);
+        memcpy(buffer, io_utils_spi_batch_rx(&batch, index) + 2, size);
+        for (int i = 0; i < size; i++)
+        {
+            int idx = at86rf215_shadow_index(addr + i);
+            if (idx < 0 || at86rf215_reg_is_volatile(addr + i)) continue;
+            dev->shadow[idx] = buffer[i];
+            dev->shadow_state[idx] = SHADOW_VALID;
+        }
     }
+    pthread_mutex_unlock(&dev->shadow_mtx);
     return ret;
 }
 
 //===================================================================
 int at86rf215_write_byte(at86rf215_st* dev, uint16_t addr, uint8_t val )
 {
-    uint8_t chunk_tx[3] = {0};
-    uint8_t chunk_rx[3] = {0};
-    chunk_tx[0] = ((addr >> 8) & 0x3F) | 0x80;
-    chunk_tx[1] = addr & 0xFF;
-    chunk_tx[2] = val;
-    return io_utils_spi_transmit(dev->io_spi, dev->io_spi_handle,
-            chunk_tx, chunk_rx, 3, io_utils_spi_read_write);
+    return at86rf215_write_buffer(dev, addr, &val, 1);
 }
 
 //===================================================================
 int at86rf215_read_byte(at86rf215_st* dev, uint16_t addr)
 {
-    uint8_t chunk_tx[3] = {0};
-    uint8_t chunk_rx[3] = {0};
-    
-    chunk_tx[0] = (addr >> 8) & 0x3F;
-    chunk_tx[1] = addr & 0xFF;
-    
-    /*printf("TX: ");
-    for (int i = 0; i < 3; i ++)
-        printf(" 0x%02X ", chunk_tx[i]);
-    printf("\n");*/
-    
-    int ret = io_utils_spi_transmit(dev->io_spi, dev->io_spi_handle, 
-            chunk_tx, chunk_rx, 3, io_utils_spi_read_write);
+    uint8_t val = 0;
+    int ret = at86rf215_read_buffer(dev, addr, &val, 1);
     if (ret < 0)
     {
         return ret;
     }
-    
-    /*printf("RX: ");
-    for (int i = 0; i < 3; i ++)
-        printf(" 0x%02X ", chunk_rx[i]);
-    printf("\n");*/
-    
-    return chunk_rx[2];
+    return val;
+}
+
+//===================================================================
+int at86rf215_read_regs(at86rf215_st* dev, const uint16_t *addrs, uint8_t *vals, int num)
+{
+    int index[IO_UTILS_SPI_BATCH_MAX_XFERS];
+    if (num > IO_UTILS_SPI_BATCH_MAX_XFERS)
+    {
+        ZF_LOGE("too many registers (%d) for one batch", num);
+        return -1;
+    }
+
+    if (dev->shadow_enabled) pthread_mutex_lock(&dev->shadow_mtx);
+    int ret = dev->shadow_enabled ? at86rf215_shadow_flush_locked(dev) : 0;
+
+    // the known registers come from the shadow, all the others in one batch
+    io_utils_spi_batch_st batch;
+    io_utils_spi_batch_init(&batch, dev->io_spi_handle);
+    for (int i = 0; i < num && ret == 0; i++)
+    {
+        int idx = at86rf215_shadow_index(addrs[i]);
+        index[i] = -1;
+        if (dev->shadow_enabled && idx >= 0 && !at86rf215_reg_is_volatile(addrs[i]) &&
+            dev->shadow_state[idx] != SHADOW_UNKNOWN)
+        {
+            vals[i] = dev->shadow[idx];
+            dev->shadow_stats.reads_cached++;
+            continue;
+        }
+        index[i] = at86rf215_batch_add(dev, &batch, addrs[i], NULL, 1, false);
+    }
+
+    if (ret == 0 && at86rf215_batch_submit(dev, &batch) < 0) ret = -1;
+    for (int i = 0; i < num && ret == 0; i++)
+    {
+        if (index[i] < 0) continue;
+        vals[i] = io_utils_spi_batch_rx(&batch, index[i])[2];
+
+        int idx = at86rf215_shadow_index(addrs[i]);
+        if (dev->shadow_enabled && idx >= 0 && !at86rf215_reg_is_volatile(addrs[i]))
+        {
+            dev->shadow[idx] = vals[i];
+            dev->shadow_state[idx] = SHADOW_VALID;
+        }
+    }
+
+    if (dev->shadow_enabled) pthread_mutex_unlock(&dev->shadow_mtx);
+    return ret;
+}
+
+//===================================================================
+void at86rf215_shadow_enable(at86rf215_st* dev, bool enable)
+{
+    if (dev->shadow_enabled == enable) return;
+    if (!enable)
+    {
+        pthread_mutex_lock(&dev->shadow_mtx);
+        at86rf215_shadow_flush_locked(dev);
+        dev->shadow_enabled = false;
+        memset(dev->shadow_state, SHADOW_UNKNOWN, sizeof(dev->shadow_state));
+        pthread_mutex_unlock(&dev->shadow_mtx);
+        return;
+    }
+    memset(dev->shadow_state, SHADOW_UNKNOWN, sizeof(dev->shadow_state));
+    dev->shadow_batch = 0;
+    dev->shadow_deferred = 0;
+    dev->shadow_enabled = true;
+}
+
+//===================================================================
+void at86rf215_shadow_begin(at86rf215_st* dev)
+{
+    if (!dev->shadow_enabled) return;
+    pthread_mutex_lock(&dev->shadow_mtx);
+    dev->shadow_batch++;
+    pthread_mutex_unlock(&dev->shadow_mtx);
+}
+
+//===================================================================
+int at86rf215_shadow_end(at86rf215_st* dev)
+{
+    int ret = 0;
+    if (!dev->shadow_enabled) return 0;
+    pthread_mutex_lock(&dev->shadow_mtx);
+    if (dev->shadow_batch > 0) dev->shadow_batch--;
+    if (dev->shadow_batch == 0) ret = at86rf215_shadow_flush_locked(dev);
+    pthread_mutex_unlock(&dev->shadow_mtx);
+    return ret;
+}
+
+//===================================================================
+int at86rf215_shadow_flush(at86rf215_st* dev)
+{
+    if (!dev->shadow_enabled) return 0;
+    pthread_mutex_lock(&dev->shadow_mtx);
+    int ret = at86rf215_shadow_flush_locked(dev);
+    pthread_mutex_unlock(&dev->shadow_mtx);
+    return ret;
+}
+
+//===================================================================
+void at86rf215_shadow_invalidate(at86rf215_st* dev)
+{
+    if (!dev->shadow_enabled) return;
+    pthread_mutex_lock(&dev->shadow_mtx);
+    at86rf215_shadow_flush_locked(dev);
+    memset(dev->shadow_state, SHADOW_UNKNOWN, sizeof(dev->shadow_state));
+    pthread_mutex_unlock(&dev->shadow_mtx);
+}
+
+//===================================================================
+// the chip lost its registers (reset) - the deferred writes are meant for
+// the old configuration and are dropped without reaching it
+static void at86rf215_shadow_discard(at86rf215_st* dev)
+{
+    if (!dev->shadow_enabled) return;
+    pthread_mutex_lock(&dev->shadow_mtx);
+    if (dev->shadow_deferred) ZF_LOGD("dropping %u deferred writes on reset", dev->shadow_deferred);
+    dev->shadow_deferred = 0;
+    memset(dev->shadow_state, SHADOW_UNKNOWN, sizeof(dev->shadow_state));
+    pthread_mutex_unlock(&dev->shadow_mtx);
+}
+
+//===================================================================
+void at86rf215_shadow_get_stats(at86rf215_st* dev, at86rf215_shadow_stats_st* stats, bool reset)
+{
+    if (dev->shadow_enabled) pthread_mutex_lock(&dev->shadow_mtx);
+    if (stats) *stats = dev->shadow_stats;
+    if (reset) memset(&dev->shadow_stats, 0, sizeof(dev->shadow_stats));
+    if (dev->shadow_enabled) pthread_mutex_unlock(&dev->shadow_mtx);
 }
 
 //===================================================================
-#define NUM_CAL_STEPS 5
 void swap(int *p,int *q) 
 {
    int t;  
@@ -121,13 +491,13 @@ int median(int a[], int n)
 //===================================================================
 int at86rf215_calibrate_device(at86rf215_st* dev, at86rf215_rf_channel_en ch, int* i_val, int* q_val)
 {
-    int cal_i[NUM_CAL_STEPS] = {0};
-    int cal_q[NUM_CAL_STEPS] = {0};
+    int cal_i[AT86RF215_NUM_CAL_STEPS] = {0};
+    int cal_q[AT86RF215_NUM_CAL_STEPS] = {0};
     bool override_flag = dev->override_cal;
     dev->override_cal = false;
     
     ZF_LOGD("Calibration of modem channel %d...", ch);
-    for (int i = 0; i < NUM_CAL_STEPS; i ++)
+    for (int i = 0; i < AT86RF215_NUM_CAL_STEPS; i ++)
     {
         at86rf215_radio_set_state(dev, ch, at86rf215_radio_state_cmd_trx_off);
         io_utils_usleep(2000);
@@ -140,8 +510,8 @@ int at86rf215_calibrate_device(at86rf215_st* dev, at86rf215_rf_channel_en ch, in
     }
 
     // medians
-    int cal_i_med = median(cal_i, NUM_CAL_STEPS);
-    int cal_q_med = median(cal_q, NUM_CAL_STEPS);
+    int cal_i_med = median(cal_i, AT86RF215_NUM_CAL_STEPS);
+    int cal_q_med = median(cal_q, AT86RF215_NUM_CAL_STEPS);
     ZF_LOGD("Calibration Results of the modem: I=%d, Q=%d", cal_i_med, cal_q_med);
     if (i_val) *i_val = cal_i_med;
     if (q_val) *q_val = cal_q_med;
@@ -159,6 +529,39 @@ int at86rf215_calibrate_device(at86rf215_st* dev, at86rf215_rf_channel_en ch, in
     return 0;
 }
 
+//===================================================================
+void at86rf215_calibration_sample(at86rf215_st* dev, at86rf215_rf_channel_en ch)
+{
+    int n = dev->cal_num_samples[ch];
+    if (n < 0) return;
+
+    // the transition to TXPREP has just run the chip's own calibration -
+    // read it before the preset results are written over it
+    at86rf215_radio_get_tx_iq_calibration(dev, ch, &dev->cal_samples_i[ch][n], &dev->cal_samples_q[ch][n]);
+    if (++n < AT86RF215_NUM_CAL_STEPS)
+    {
+        dev->cal_num_samples[ch] = n;
+        return;
+    }
+    dev->cal_num_samples[ch] = -1;
+
+    int *cal_i = ch == at86rf215_rf_channel_900mhz ? &dev->cal.low_ch_i : &dev->cal.hi_ch_i;
+    int *cal_q = ch == at86rf215_rf_channel_900mhz ? &dev->cal.low_ch_q : &dev->cal.hi_ch_q;
+    int i_med = median(dev->cal_samples_i[ch], AT86RF215_NUM_CAL_STEPS);
+    int q_med = median(dev->cal_samples_q[ch], AT86RF215_NUM_CAL_STEPS);
+    if (abs(i_med - *cal_i) > AT86RF215_CAL_REVALIDATE_TOL || abs(q_med - *cal_q) > AT86RF215_CAL_REVALIDATE_TOL)
+    {
+        ZF_LOGI("Modem channel %d calibration drifted: I=%d->%d, Q=%d->%d", ch, *cal_i, i_med, *cal_q, q_med);
+        *cal_i = i_med;
+        *cal_q = q_med;
+        dev->cal_updated = true;
+    }
+    else
+    {
+        ZF_LOGD("Modem channel %d calibration revalidated (I=%d, Q=%d)", ch, i_med, q_med);
+    }
+}
+
 //===================================================================
 int at86rf215_init(at86rf215_st* dev,
 					io_utils_spi_st* io_spi)
@@ -170,6 +573,8 @@ int at86rf215_init(at86rf215_st* dev,
 	}
 
 	dev->io_spi = io_spi;
+    dev->shadow_enabled = false;
+    pthread_mutex_init(&dev->shadow_mtx, NULL);
 
     ZF_LOGD("configuring reset and irq pins");
 	// Configure GPIO pins
@@ -184,35 +589,50 @@ int at86rf215_init(at86rf215_st* dev,
 	dev->io_spi_handle = io_utils_spi_add_chip(dev->io_spi, dev->cs_pin, 4000000, 0, 0,
                         						io_utils_spi_chip_type_modem,
                                                 &hard_dev_modem);
+    at86rf215_shadow_enable(dev, true);
 
    // Setup the interrupts after clearing the register one time
     at86rf215_irq_st irq = {0};
     at86rf215_get_irqs(dev, &irq, 0);
 
+    // Initialize events (before the handler may signal them)
+    event_node_init(&dev->events.lo_trx_ready_event);
+    event_node_init(&dev->events.lo_energy_measure_event);
+    event_node_init(&dev->events.hi_trx_ready_event);
+    event_node_init(&dev->events.hi_energy_measure_event);
+
 	dev->num_interrupts = 0;
+    dev->irq_events = true;
     if (io_utils_setup_interrupt(dev->irq_pin, at86rf215_interrupt_handler, dev) < 0)
     {
-        ZF_LOGE("interrupt registration for irq_pin (%d) failed", dev->irq_pin);
-        //io_utils_setup_gpio(dev->reset_pin, io_utils_dir_input, io_utils_pull_up);
+        // the state and lock waits fall back to polling the status registers
+        ZF_LOGW("interrupt registration for irq_pin (%d) failed, polling the modem instead", dev->irq_pin);
         io_utils_setup_gpio(dev->irq_pin, io_utils_dir_input, io_utils_pull_up);
-        io_utils_spi_remove_chip(dev->io_spi, dev->io_spi_handle);
-        return -1;
+        dev->irq_events = false;
     }
 
-    // Initialize events
-    event_node_init(&dev->events.lo_trx_ready_event);
-    event_node_init(&dev->events.lo_energy_measure_event);
-    event_node_init(&dev->events.hi_trx_ready_event);
-    event_node_init(&dev->events.hi_energy_measure_event);
-
 	// Get chip type
 	uint8_t pn = 0, vn = 0;
 	at86rf215_get_versions(dev, &pn, &vn);
 	ZF_LOGD("Modem identity: Version: %02X, Product: %02X", vn, pn);
 
-    // calibrate TXPREP
-    at86rf215_calibrate_device(dev, at86rf215_rf_channel_900mhz, &dev->cal.low_ch_i, &dev->cal.low_ch_q);
-    at86rf215_calibrate_device(dev, at86rf215_rf_channel_2400mhz, &dev->cal.hi_ch_i, &dev->cal.hi_ch_q);
+    // calibrate TXPREP - unless the caller has the results already, in which case
+    // they are revalidated from the first TXPREP transitions of each channel
+    dev->cal_updated = false;
+    if (dev->cal_preset)
+    {
+        ZF_LOGD("Using preset modem calibration: LOW I=%d Q=%d, HI I=%d Q=%d",
+                    dev->cal.low_ch_i, dev->cal.low_ch_q, dev->cal.hi_ch_i, dev->cal.hi_ch_q);
+        dev->cal_num_samples[at86rf215_rf_channel_900mhz] = 0;
+        dev->cal_num_samples[at86rf215_rf_channel_2400mhz] = 0;
+    }
+    else
+    {
+        at86rf215_calibrate_device(dev, at86rf215_rf_channel_900mhz, &dev->cal.low_ch_i, &dev->cal.low_ch_q);
+        at86rf215_calibrate_device(dev, at86rf215_rf_channel_2400mhz, &dev->cal.hi_ch_i, &dev->cal.hi_ch_q);
+        dev->cal_num_samples[at86rf215_rf_channel_900mhz] = -1;
+        dev->cal_num_samples[at86rf215_rf_channel_2400mhz] = -1;
+    }
     dev->override_cal = true;
     dev->initialized = 1;
 
@@ -237,6 +657,8 @@ int at86rf215_close(at86rf215_st* dev)
 
 	dev->initialized = 0;
 
+    if (dev->irq_events) io_utils_release_interrupt(dev->irq_pin);
+    dev->irq_events = false;
     event_node_close(&dev->events.lo_trx_ready_event);
     event_node_close(&dev->events.lo_energy_measure_event);
     event_node_close(&dev->events.hi_trx_ready_event);
@@ -246,6 +668,8 @@ int at86rf215_close(at86rf215_st* dev)
 	io_utils_setup_gpio(dev->irq_pin, io_utils_dir_input, io_utils_pull_up);
 
 	// Release the SPI device
+    at86rf215_shadow_enable(dev, false);
+    pthread_mutex_destroy(&dev->shadow_mtx);
     io_utils_spi_remove_chip(dev->io_spi, dev->io_spi_handle);
 
 	ZF_LOGD("device release completed");
@@ -258,6 +682,7 @@ void at86rf215_reset(at86rf215_st* dev)
 	io_utils_write_gpio(dev->reset_pin, 0);
     io_utils_usleep(300);
 	io_utils_write_gpio(dev->reset_pin, 1);
+    at86rf215_shadow_discard(dev);
 }
 
 //===================================================================
@@ -265,6 +690,7 @@ void at86rf215_chip_reset_with_spi(at86rf215_st* dev)
 {
     uint8_t val = 0x7;
 	at86rf215_write_byte(dev, REG_RF_RST, val);
+    at86rf215_shadow_discard(dev);
 }
 
 //===================================================================
@@ -478,6 +904,19 @@ void at86rf215_setup_iq_if(at86rf215_st* dev, at86rf215_iq_interface_config_st*
     at86rf215_write_buffer(dev, REG_RF_IQIFC0, data, 2);
 }
 
+//===================================================================
+void at86rf215_get_config_signature(at86rf215_st* dev, uint8_t* sig)
+{
+    uint8_t iqifc[2] = {0};
+    at86rf215_read_buffer(dev, REG_RF_IQIFC0, iqifc, 2);
+
+    sig[0] = at86rf215_read_byte(dev, REG_RF_CFG);
+    sig[1] = iqifc[0] & 0xBF;       // without SF
+    sig[2] = iqifc[1] & 0x7F;       // without FAILSF
+    sig[3] = at86rf215_read_byte(dev, REG_RF09_IRQM);
+    sig[4] = at86rf215_read_byte(dev, REG_RF24_IRQM);
+}
+
 //===================================================================
 double at86rf215_check_freq (at86rf215_st* dev, at86rf215_rf_channel_en ch, uint64_t freq_hz )
 {
@@ -562,6 +1001,9 @@ void at86rf215_setup_iq_radio_receive (at86rf215_st* dev, at86rf215_rf_channel_e
     // 1. Set TRXOFF mode
     at86rf215_radio_set_state(dev, radio, at86rf215_radio_state_cmd_trx_off);
 
+    // the configuration below is deferred and goes out in SPI batches together
+    // with the I/Q interface setup, the AGC and the final RX command
+    at86rf215_shadow_begin(dev);
 
     // 2. Enable all radio interrupts in 09,_24_IRQS
     at86rf215_radio_irq_st int_mask = {
@@ -636,6 +1078,7 @@ void at86rf215_setup_iq_radio_receive (at86rf215_st* dev, at86rf215_rf_channel_e
 
     // 8. Enable the radio receiver by writing command RX to the register RFn_CMD.
     at86rf215_radio_set_state(dev, radio, at86rf215_radio_state_cmd_rx);
+    at86rf215_shadow_end(dev);
 
     // 9. To prevent the AGC from switching its gain during reception, it is recommended to set AGCC.FRZC=1
     //    after reception of the preamble, the AGC has to be released after finishing reception by setting AGCC.FRZC=0.
@@ -39,12 +39,29 @@ void at86rf215_setup_iq_radio_dac_value_override_no_freq (at86rf215_st* dev,
 int64_t at86rf215_setup_channel ( at86rf215_st* dev, at86rf215_rf_channel_en ch, uint64_t freq_hz );
 double at86rf215_check_freq (at86rf215_st* dev, at86rf215_rf_channel_en ch, uint64_t freq_hz );
 
-// EVENTS
+// TX IQ CALIBRATION
+// median of AT86RF215_NUM_CAL_STEPS TXPREP calibrations - stored in dev->cal
+int at86rf215_calibrate_device(at86rf215_st* dev, at86rf215_rf_channel_en ch, int* i_val, int* q_val);
 
-void event_node_init(event_st* ev);
-void event_node_close(event_st* ev);
-void event_node_wait_ready(event_st* ev);
-void event_node_signal_ready(event_st* ev, int ready);
+// CONFIGURATION SIGNATURE
+// Registers that are only written by the initial setup (irq pin, IQ interface
+// and irq masks, without their status bits) - a chip reset reverts them, so a
+// signature that matches a previous session tells the configuration survived.
+#define AT86RF215_CONFIG_SIG_LEN    (5)
+void at86rf215_get_config_signature(at86rf215_st* dev, uint8_t* sig);
+
+// SHADOW REGISTERS
+// Reads of configuration (non-volatile) registers are served from the shadow,
+// writes that don't change a register are dropped. Between begin and end the
+// configuration writes are deferred and flushed as merged contiguous bursts
+// (in ascending address order). Status, command and calibration registers
+// always go to the chip and flush the deferred writes first.
+void at86rf215_shadow_enable(at86rf215_st* dev, bool enable);
+void at86rf215_shadow_begin(at86rf215_st* dev);
+int at86rf215_shadow_end(at86rf215_st* dev);
+int at86rf215_shadow_flush(at86rf215_st* dev);
+void at86rf215_shadow_invalidate(at86rf215_st* dev);
+void at86rf215_shadow_get_stats(at86rf215_st* dev, at86rf215_shadow_stats_st* stats, bool reset);
 
 #ifdef __cplusplus
 }
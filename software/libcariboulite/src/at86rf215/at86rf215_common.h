@@ -111,6 +111,9 @@ typedef struct
     int hi_ch_q;
 } at86rf215_cal_results_st;
 
+#define AT86RF215_NUM_CAL_STEPS         ( 5 )
+#define AT86RF215_CAL_REVALIDATE_TOL    ( 2 )       // [LSB] a revalidated median further away replaces the results
+
 
 typedef struct 
 {
@@ -127,6 +130,20 @@ typedef struct
     event_st hi_energy_measure_event;
 } at86rf215_events_st;
 
+// Shadow registers - the common, RF09 and RF24 register pages (0x0XX, 0x1XX, 0x2XX)
+#define AT86RF215_SHADOW_PAGES          ( 3 )
+#define AT86RF215_SHADOW_PAGE_SIZE      ( 0x40 )
+#define AT86RF215_SHADOW_SIZE           ( AT86RF215_SHADOW_PAGES * AT86RF215_SHADOW_PAGE_SIZE )
+
+typedef struct
+{
+    uint32_t spi_transactions;          // SPI submissions (syscalls) issued to the chip
+    uint32_t reads_cached;              // read transactions served from the shadow
+    uint32_t writes_skipped;            // write transactions that matched the shadow
+    uint32_t writes_combined;           // deferred write transactions merged into other bursts
+    uint32_t bytes_trimmed;             // unchanged bytes cut from the ends of write bursts
+} at86rf215_shadow_stats_st;
+
 typedef struct
 {
     // pinout
@@ -144,8 +161,23 @@ typedef struct
     int initialized;
     at86rf215_cal_results_st cal;
     bool override_cal;
+    bool cal_preset;                    // "cal" was loaded by the caller - at86rf215_init doesn't calibrate
+    bool cal_updated;                   // a revalidation changed "cal" (the caller may persist it)
+    int cal_num_samples[2];             // revalidation samples per channel (-1 = not revalidating)
+    int cal_samples_i[2][AT86RF215_NUM_CAL_STEPS];
+    int cal_samples_q[2][AT86RF215_NUM_CAL_STEPS];
     at86rf215_events_st events;
 	int num_interrupts;
+    bool irq_events;                    // the IRQ line delivers the events (otherwise the waits poll)
+
+    // shadow registers
+    bool shadow_enabled;
+    pthread_mutex_t shadow_mtx;
+    int shadow_batch;                   // nesting depth of deferred writing
+    uint32_t shadow_deferred;           // write transactions deferred since the last flush
+    uint8_t shadow[AT86RF215_SHADOW_SIZE];
+    uint8_t shadow_state[AT86RF215_SHADOW_SIZE];
+    at86rf215_shadow_stats_st shadow_stats;
 } at86rf215_st;
 
 
@@ -153,9 +185,24 @@ int at86rf215_write_buffer(at86rf215_st* dev, uint16_t addr, uint8_t *buffer, ui
 int at86rf215_read_buffer(at86rf215_st* dev, uint16_t addr, uint8_t *buffer, uint8_t size);
 int at86rf215_write_byte(at86rf215_st* dev, uint16_t addr, uint8_t val );
 int at86rf215_read_byte(at86rf215_st* dev, uint16_t addr);
+// collect the chip's own TX IQ calibration after a TXPREP transition to revalidate preset results
+void at86rf215_calibration_sample(at86rf215_st* dev, at86rf215_rf_channel_en ch);
+// scattered single registers read in one SPI batch (at most IO_UTILS_SPI_BATCH_MAX_XFERS)
+int at86rf215_read_regs(at86rf215_st* dev, const uint16_t *addrs, uint8_t *vals, int num);
 void at86rf215_interrupt_handler (int event, int level, uint32_t tick, void *data);
 int at86rf215_write_fifo(at86rf215_st* dev, uint8_t *buffer, uint8_t size );
 int at86rf215_read_fifo(at86rf215_st* dev, uint8_t *buffer, uint8_t size );
+
+// EVENTS
+
+void event_node_init(event_st* ev);
+void event_node_close(event_st* ev);
+void event_node_wait_ready(event_st* ev);
+// 0 = signaled, -1 = timed out
+int event_node_wait_ready_timeout(event_st* ev, int timeout_us);
+void event_node_reset(event_st* ev);
+void event_node_signal_ready(event_st* ev, int ready);
+
 void at86rf215_get_irqs(at86rf215_st* dev, at86rf215_irq_st* irq, int verbose);
 
 #ifdef __cplusplus
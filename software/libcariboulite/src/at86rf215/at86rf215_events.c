@@ -6,6 +6,8 @@
 #define ZF_LOG_TAG "AT86RF215_Events"
 
 #include <stdio.h>
+#include <time.h>
+#include <errno.h>
 #include "zf_log/zf_log.h"
 #include "at86rf215_common.h"
 #include <pthread.h>
@@ -13,8 +15,14 @@
 
 void event_node_init(event_st* ev)
 {
-    pthread_cond_init(&ev->ready_cond, NULL);
+    // the timed waits run on the monotonic clock
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&ev->ready_cond, &attr);
+    pthread_condattr_destroy(&attr);
     pthread_mutex_init(&ev->ready_mutex, NULL);
+    ev->ready = 0;
 }
 
 void event_node_close(event_st* ev)
@@ -34,6 +42,37 @@ void event_node_wait_ready(event_st* ev)
     pthread_mutex_unlock(&ev->ready_mutex);
 }
 
+int event_node_wait_ready_timeout(event_st* ev, int timeout_us)
+{
+    struct timespec deadline;
+    clock_gettime(CLOCK_MONOTONIC, &deadline);
+    deadline.tv_sec += timeout_us / 1000000;
+    deadline.tv_nsec += (long)(timeout_us % 1000000) * 1000L;
+    if (deadline.tv_nsec >= 1000000000L)
+    {
+        deadline.tv_sec++;
+        deadline.tv_nsec -= 1000000000L;
+    }
+
+    int ret = 0;
+    pthread_mutex_lock(&ev->ready_mutex);
+    while (!ev->ready && ret != ETIMEDOUT)
+    {
+        ret = pthread_cond_timedwait(&ev->ready_cond, &ev->ready_mutex, &deadline);
+    }
+    int ready = ev->ready;
+    ev->ready = 0;
+    pthread_mutex_unlock(&ev->ready_mutex);
+    return ready ? 0 : -1;
+}
+
+void event_node_reset(event_st* ev)
+{
+    pthread_mutex_lock(&ev->ready_mutex);
+    ev->ready = 0;
+    pthread_mutex_unlock(&ev->ready_mutex);
+}
+
 void event_node_signal_ready(event_st* ev, int ready)
 {
     pthread_mutex_lock(&ev->ready_mutex);
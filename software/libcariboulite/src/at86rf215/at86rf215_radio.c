@@ -10,6 +10,7 @@
 #include <string.h>
 #include <stdbool.h>
 #include <stdio.h>
+#include <time.h>
 #include "zf_log/zf_log.h"
 #include "io_utils/io_utils.h"
 #include "io_utils/io_utils_spi.h"
@@ -141,12 +142,74 @@ at86rf215_radio_state_cmd_en at86rf215_radio_get_state(at86rf215_st* dev, at86rf
     return state & 0x7;
 }
 
+//==================================================================================
+static event_st* at86rf215_radio_trx_ready_event(at86rf215_st* dev, at86rf215_rf_channel_en ch)
+{
+    return ch == at86rf215_rf_channel_900mhz ? &dev->events.lo_trx_ready_event : &dev->events.hi_trx_ready_event;
+}
+
+//==================================================================================
+static int64_t at86rf215_radio_time_us(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000LL + ts.tv_nsec / 1000;
+}
+
+//==================================================================================
+int at86rf215_radio_wait_trx_ready(at86rf215_st* dev, at86rf215_rf_channel_en ch,
+                                    at86rf215_radio_state_cmd_en state, int timeout_us)
+{
+    int64_t deadline = at86rf215_radio_time_us() + timeout_us;
+
+    // TXPREP (also on the way to RX) is announced by IRQS.TRXRDY - without the
+    // IRQ line (or for TX) the state register is polled every poll period
+    while (at86rf215_radio_get_state(dev, ch) != state)
+    {
+        int64_t left = deadline - at86rf215_radio_time_us();
+        if (left <= 0) return -1;
+        if (left > AT86RF215_STATE_POLL_US) left = AT86RF215_STATE_POLL_US;
+
+        if (dev->irq_events && state != at86rf215_radio_state_cmd_tx)
+        {
+            event_node_wait_ready_timeout(at86rf215_radio_trx_ready_event(dev, ch), (int)left);
+        }
+        else io_utils_usleep((int)left);
+    }
+    return 0;
+}
+
+//==================================================================================
+bool at86rf215_radio_wait_pll_lock(at86rf215_st* dev, at86rf215_rf_channel_en ch, int timeout_us)
+{
+    at86rf215_radio_pll_ctrl_st cfg = {0};
+    int64_t deadline = at86rf215_radio_time_us() + timeout_us;
+
+    while (1)
+    {
+        at86rf215_radio_get_pll_ctrl(dev, ch, &cfg);
+        if (cfg.pll_locked) return true;
+
+        int64_t left = deadline - at86rf215_radio_time_us();
+        if (left <= 0) return false;
+        if (left > AT86RF215_STATE_POLL_US) left = AT86RF215_STATE_POLL_US;
+
+        // a lock completes with TRXRDY
+        if (dev->irq_events) event_node_wait_ready_timeout(at86rf215_radio_trx_ready_event(dev, ch), (int)left);
+        else io_utils_usleep((int)left);
+    }
+}
+
 //==================================================================================
 void at86rf215_radio_set_state(at86rf215_st* dev, at86rf215_rf_channel_en ch, at86rf215_radio_state_cmd_en cmd)
 {
     // "RG_CMD" RFn_CMD – Transceiver Command
 
     uint16_t reg_address = AT86RF215_REG_ADDR(ch, CMD);
+    bool wait_ready = cmd == at86rf215_radio_state_cmd_tx_prep || cmd == at86rf215_radio_state_cmd_tx || cmd == at86rf215_radio_state_cmd_rx;
+
+    // a TRXRDY left over from an earlier transition must not end this wait
+    if (wait_ready) event_node_reset(at86rf215_radio_trx_ready_event(dev, ch));
     at86rf215_write_byte(dev, reg_address, cmd & 0x7);
 
     /*Errata #6:    State Machine Command RFn_CMD=TRXOFF may not be succeeded
@@ -163,14 +226,18 @@ void at86rf215_radio_set_state(at86rf215_st* dev, at86rf215_rf_channel_en ch, at
             at86rf215_write_byte(dev, reg_address, cmd & 0x7);
         }
     }
-    if (cmd == at86rf215_radio_state_cmd_tx_prep || cmd == at86rf215_radio_state_cmd_tx || cmd == at86rf215_radio_state_cmd_rx)
+    if (wait_ready)
     {
-        //if (ch == at86rf215_rf_channel_900mhz) event_node_wait_ready(&dev->events.lo_trx_ready_event);
-        //else if (ch == at86rf215_rf_channel_2400mhz) event_node_wait_ready(&dev->events.hi_trx_ready_event);
+        // returns as soon as the transceiver is ready (used to be a fixed 1 msec sleep)
+        if (at86rf215_radio_wait_trx_ready(dev, ch, cmd, AT86RF215_TRX_READY_TIMEOUT_US) != 0)
+        {
+            ZF_LOGW("RF%s didn't reach state %d within %d usec", ch == at86rf215_rf_channel_900mhz ? "09" : "24",
+                                                                cmd, AT86RF215_TRX_READY_TIMEOUT_US);
+        }
 
-        io_utils_usleep(1000);
         if (dev->override_cal)
         {
+            if (cmd == at86rf215_radio_state_cmd_tx_prep) at86rf215_calibration_sample(dev, ch);
             int i = ch == at86rf215_rf_channel_900mhz ? dev->cal.low_ch_i : dev->cal.hi_ch_i;
             int q = ch == at86rf215_rf_channel_900mhz ? dev->cal.low_ch_q : dev->cal.hi_ch_q;
             at86rf215_radio_set_tx_iq_calibration(dev, ch, i, q);
@@ -624,6 +691,29 @@ void at86rf215_radio_get_pll_ctrl(at86rf215_st* dev, at86rf215_rf_channel_en ch,
     cfg->pll_center_freq = (buf[1] >> 0) & 0x3F;
 }
 
+//==================================================================================
+void at86rf215_radio_get_sensors(at86rf215_st* dev, at86rf215_rf_channel_en ch,
+                                        at86rf215_radio_sensors_st* sensors)
+{
+    uint16_t addrs[5] =
+    {
+        AT86RF215_REG_ADDR(ch, STATE),
+        AT86RF215_REG_ADDR(ch, RSSI),
+        AT86RF215_REG_ADDR(ch, EDV),
+        AT86RF215_REG_ADDR(ch, AGCS),
+        AT86RF215_REG_ADDR(ch, PLL),
+    };
+    uint8_t vals[5] = {0};
+
+    at86rf215_read_regs(dev, addrs, vals, 5);
+
+    sensors->state = (at86rf215_radio_state_cmd_en)(vals[0] & 0x7);
+    sensors->rssi_dbm = (float)(*(int8_t*)(&vals[1]));
+    sensors->energy_detection_value = (float)(*(int8_t*)(&vals[2]));
+    sensors->agc_gain_control_word = vals[3] & 0x1F;
+    sensors->pll_locked = (vals[4] >> 1) & 0x1;
+}
+
 //==================================================================================
 void at86rf215_radio_set_tx_iq_calibration(at86rf215_st* dev, at86rf215_rf_channel_en ch,
                                                 int cal_i, int cal_q)
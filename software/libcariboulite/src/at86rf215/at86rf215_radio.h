@@ -76,6 +76,9 @@ typedef enum
 /** offset (in Hz) for CCF0 in 2.4 GHz mode */
 #define CCF0_24G_OFFSET          1500000U
 
+#define AT86RF215_TRX_READY_TIMEOUT_US      ( 1000 )    // state transitions take up to ~200 usec
+#define AT86RF215_STATE_POLL_US             ( 50 )      // re-check period while waiting for an event
+
 typedef enum
 {
     at86rf215_radio_rx_bw_BW160KHZ_IF250KHZ = 0x0,      // at86rf215_radio_rx_f_cut_0_25_half_fs
@@ -287,6 +290,15 @@ typedef struct
     int pll_locked;
 } at86rf215_radio_pll_ctrl_st;
 
+typedef struct
+{
+    at86rf215_radio_state_cmd_en state;
+    float rssi_dbm;                 // 127 = invalid
+    float energy_detection_value;   // 127 = invalid
+    int agc_gain_control_word;
+    int pll_locked;
+} at86rf215_radio_sensors_st;
+
 
 void at86rf215_radio_setup_interrupt_mask(at86rf215_st* dev, at86rf215_rf_channel_en ch,
                                             at86rf215_radio_irq_st* mask);
@@ -301,6 +313,14 @@ at86rf215_radio_state_cmd_en at86rf215_radio_get_state(at86rf215_st* dev, at86rf
 
 void at86rf215_radio_set_state(at86rf215_st* dev, at86rf215_rf_channel_en ch, at86rf215_radio_state_cmd_en cmd);
 
+// wait until the channel is in "state" - woken by the TRXRDY interrupt when the
+// IRQ line is available, polling the state otherwise (0 = reached, -1 = timeout)
+int at86rf215_radio_wait_trx_ready(at86rf215_st* dev, at86rf215_rf_channel_en ch,
+                                    at86rf215_radio_state_cmd_en state, int timeout_us);
+
+// wait for the channel's PLL lock indication, up to timeout_us
+bool at86rf215_radio_wait_pll_lock(at86rf215_st* dev, at86rf215_rf_channel_en ch, int timeout_us);
+
 double at86rf215_radio_get_frequency( /*IN*/ at86rf215_radio_channel_mode_en mode,
                                      /*IN*/ int channel_spacing_25khz_res,
                                      /*IN*/ double wanted_frequency_hz,
@@ -347,6 +367,10 @@ void at86rf215_radio_setup_pll_ctrl(at86rf215_st* dev, at86rf215_rf_channel_en c
 void at86rf215_radio_get_pll_ctrl(at86rf215_st* dev, at86rf215_rf_channel_en ch,
                                         at86rf215_radio_pll_ctrl_st* cfg);
 
+// the channel's status and measurement registers in one SPI transaction
+void at86rf215_radio_get_sensors(at86rf215_st* dev, at86rf215_rf_channel_en ch,
+                                        at86rf215_radio_sensors_st* sensors);
+
 void at86rf215_radio_set_tx_iq_calibration(at86rf215_st* dev, at86rf215_rf_channel_en ch,
                                                 int cal_i, int cal_q);
 
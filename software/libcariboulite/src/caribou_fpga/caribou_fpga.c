@@ -8,6 +8,10 @@
 
 #include <stdio.h>
 #include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include "io_utils/io_utils_fs.h"
 #include "caribou_fpga.h"
 
 //--------------------------------------------------------------
@@ -105,6 +109,35 @@ static int caribou_fpga_spi_transfer (caribou_fpga_st* dev, uint8_t *opcode, uin
     return !(ret == sizeof(rx_buf));
 }
 
+//--------------------------------------------------------------
+// several register accesses, each with its own chip-select cycle, in one SPI batch
+static int caribou_fpga_spi_transfer_batch (caribou_fpga_st* dev, const uint8_t *opcodes, uint8_t *data, int num)
+{
+    io_utils_spi_batch_st batch;
+    io_utils_spi_batch_init(&batch, dev->io_spi_handle);
+    for (int i = 0; i < num; i++)
+    {
+        uint8_t tx_buf[2] = {opcodes[i], data[i]};
+        if (io_utils_spi_batch_add(&batch, tx_buf, 2) < 0)
+        {
+            ZF_LOGE("too many transfers (%d) for one batch", num);
+            return -1;
+        }
+    }
+
+    if (io_utils_spi_transmit_batch(dev->io_spi, &batch) < 0)
+    {
+        ZF_LOGE("spi batch transfer failed");
+        return -1;
+    }
+
+    for (int i = 0; i < num; i++)
+    {
+        data[i] = io_utils_spi_batch_rx(&batch, i)[1];
+    }
+    return 0;
+}
+
 //--------------------------------------------------------------
 int caribou_fpga_init(caribou_fpga_st* dev, io_utils_spi_st* io_spi)
 {
@@ -171,21 +204,143 @@ int caribou_fpga_get_status(caribou_fpga_st* dev, caribou_fpga_status_en *stat)
 }
 
 //--------------------------------------------------------------
-int caribou_fpga_program_to_fpga(caribou_fpga_st* dev, unsigned char *buffer, size_t len, bool force_prog)
+// FNV-1a 64 of the bitstream, chained through "hash"
+#define CARIBOU_FPGA_IMAGE_HASH_SEED    0xCBF29CE484222325ULL
+static uint64_t caribou_fpga_image_hash(uint64_t hash, const uint8_t *data, size_t len)
+{
+    while (len--)
+    {
+        hash ^= *data++;
+        hash *= 0x100000001B3ULL;
+    }
+    return hash;
+}
+
+//--------------------------------------------------------------
+static int caribou_fpga_image_hash_file(char *filename, uint64_t *hash)
+{
+    FILE *f = fopen(filename, "rb");
+    if (f == NULL)
+    {
+        ZF_LOGE("open file %s failed", filename);
+        return -1;
+    }
+
+    uint8_t buf[4096];
+    size_t n = 0;
+    *hash = CARIBOU_FPGA_IMAGE_HASH_SEED;
+    while ((n = fread(buf, 1, sizeof(buf), f)) > 0) *hash = caribou_fpga_image_hash(*hash, buf, n);
+    fclose(f);
+    return 0;
+}
+
+//--------------------------------------------------------------
+static int caribou_fpga_image_record_read(uint64_t *hash, caribou_fpga_versions_st *vers)
+{
+    FILE *f = fopen(CARIBOU_FPGA_IMAGE_RECORD, "r");
+    if (f == NULL) return -1;
+
+    unsigned long long h = 0;
+    unsigned int v[5] = {0};
+    int n = fscanf(f, "%llx %x %x %x %x %x", &h, &v[0], &v[1], &v[2], &v[3], &v[4]);
+    fclose(f);
+    if (n != 6) return -1;
+
+    *hash = h;
+    vers->sys_ver = v[0];
+    vers->sys_manu_id = v[1];
+    vers->sys_ctrl_mod_ver = v[2];
+    vers->io_ctrl_mod_ver = v[3];
+    vers->smi_ctrl_mod_ver = v[4];
+    return 0;
+}
+
+//--------------------------------------------------------------
+static void caribou_fpga_image_record_write(uint64_t hash, const caribou_fpga_versions_st *vers)
+{
+    char buf[64];
+    int len = snprintf(buf, sizeof(buf), "%016llX %02X %02X %02X %02X %02X\n", (unsigned long long)hash, vers->sys_ver,
+                vers->sys_manu_id, vers->sys_ctrl_mod_ver, vers->io_ctrl_mod_ver, vers->smi_ctrl_mod_ver);
+    if (io_utils_write_file_atomic(CARIBOU_FPGA_IMAGE_DIR, CARIBOU_FPGA_IMAGE_RECORD, buf, len) != 0)
+    {
+        ZF_LOGW("can't update '%s' (%s) - the image will be loaded again", CARIBOU_FPGA_IMAGE_RECORD, strerror(errno));
+    }
+}
+
+//--------------------------------------------------------------
+// whether the operational FPGA runs the image "hash" - without a record (first
+// run, no access to it) it's taken as running it, as before there was one
+static bool caribou_fpga_image_loaded(caribou_fpga_st* dev, uint64_t hash)
+{
+    uint64_t rec_hash = 0;
+    caribou_fpga_versions_st rec_vers = {0};
+    if (caribou_fpga_image_record_read(&rec_hash, &rec_vers) != 0)
+    {
+        ZF_LOGD("no record of the loaded FPGA image - keeping it");
+        return true;
+    }
+
+    if (rec_hash != hash)
+    {
+        ZF_LOGI("FPGA runs another image (%016llX, loading %016llX)", (unsigned long long)rec_hash, (unsigned long long)hash);
+        return false;
+    }
+    if (memcmp(&rec_vers, &dev->versions, sizeof(caribou_fpga_versions_st)) != 0)
+    {
+        ZF_LOGI("FPGA versions don't match the record of image %016llX", (unsigned long long)hash);
+        return false;
+    }
+    return true;
+}
+
+//--------------------------------------------------------------
+// after programming - the versions read back from the new image are its record
+static int caribou_fpga_image_verify(caribou_fpga_st* dev, uint64_t hash)
+{
+    if (caribou_fpga_get_versions (dev, NULL) != 0 || dev->versions.sys_manu_id != CARIBOU_SDR_MANU_CODE)
+    {
+        ZF_LOGE("FPGA image %016llX not verified (manu. id %02X)", (unsigned long long)hash, dev->versions.sys_manu_id);
+        return -1;
+    }
+    caribou_fpga_image_record_write(hash, &dev->versions);
+    return 0;
+}
+
+//--------------------------------------------------------------
+static double caribou_fpga_time_ms(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e3 + ts.tv_nsec / 1e6;
+}
+
+//--------------------------------------------------------------
+// a raw bitstream when "bitstream_len" is 0, compressed by 'generate_bin_blob -z' otherwise
+static int caribou_fpga_program_image(caribou_fpga_st* dev, unsigned char *buffer, size_t len, size_t bitstream_len, bool force_prog)
 {
     int prog_retries = 3;
+	if (buffer == NULL || len == 0)
+	{
+		ZF_LOGE("buffer should be not NULL and len > 0");
+		return -1;
+	}
+
+	uint64_t hash = caribou_fpga_image_hash(CARIBOU_FPGA_IMAGE_HASH_SEED, buffer, len);
 	caribou_fpga_get_status(dev, NULL);
-	if (dev->status == caribou_fpga_status_not_programmed || force_prog)
+	if (dev->status == caribou_fpga_status_not_programmed || force_prog || !caribou_fpga_image_loaded(dev, hash))
 	{
-		if (buffer == NULL || len == 0)
-		{
-			ZF_LOGE("buffer should be not NULL and len > 0");
-        	return -1;
-		}
+		// an interrupted load leaves no record behind
+		unlink(CARIBOU_FPGA_IMAGE_RECORD);
+		double start_ms = caribou_fpga_time_ms();
 
+		// the image on the chip is unknown from here - only a configure that
+		// reports the FPGA operational may mark it programmed
+		dev->status = caribou_fpga_status_not_programmed;
         while (prog_retries--)
         {
-            if (caribou_prog_configure_from_buffer(&dev->prog_dev, buffer, len) != 0)
+            int res = bitstream_len ? caribou_prog_configure_from_compressed(&dev->prog_dev, buffer, len, bitstream_len) :
+                                      caribou_prog_configure_from_buffer(&dev->prog_dev, buffer, len);
+            if (res != 0)
             {
                 continue;
             }
@@ -199,25 +354,53 @@ int caribou_fpga_program_to_fpga(caribou_fpga_st* dev, unsigned char *buffer, si
                 break;
             }  
         }
-        if (prog_retries == 0)
+        if (dev->status != caribou_fpga_status_operational || caribou_fpga_image_verify(dev, hash) != 0)
         {
             ZF_LOGE("Programming failed");
             return -1;
-        }            
+        }
+		ZF_LOGI("FPGA programmed in %.1f ms (%zu byte image%s)", caribou_fpga_time_ms() - start_ms, len,
+					bitstream_len ? ", compressed" : "");
 	}
 	else
 	{
-		ZF_LOGI("FPGA already operational - not programming (use 'force_prog=true' to force update)");
+		ZF_LOGI("FPGA already runs image %016llX - not programming (use 'force_prog=true' to force update)",
+					(unsigned long long)hash);
 	}
 	return 0;
 }
 
+//--------------------------------------------------------------
+int caribou_fpga_program_to_fpga(caribou_fpga_st* dev, unsigned char *buffer, size_t len, bool force_prog)
+{
+	return caribou_fpga_program_image(dev, buffer, len, 0, force_prog);
+}
+
+//--------------------------------------------------------------
+int caribou_fpga_program_to_fpga_compressed(caribou_fpga_st* dev, unsigned char *blob, size_t len, size_t bitstream_len, bool force_prog)
+{
+	if (bitstream_len == 0)
+	{
+		ZF_LOGE("the bitstream length of a compressed image should be > 0");
+		return -1;
+	}
+	return caribou_fpga_program_image(dev, blob, len, bitstream_len, force_prog);
+}
+
 //--------------------------------------------------------------
 int caribou_fpga_program_to_fpga_from_file(caribou_fpga_st* dev, char *filename, bool force_prog)
 {
+	uint64_t hash = 0;
+	if (caribou_fpga_image_hash_file(filename, &hash) != 0)
+	{
+		ZF_LOGE("Programming failed");
+		return -1;
+	}
+
 	caribou_fpga_get_status(dev, NULL);
-	if (dev->status == caribou_fpga_status_not_programmed || force_prog)
+	if (dev->status == caribou_fpga_status_not_programmed || force_prog || !caribou_fpga_image_loaded(dev, hash))
 	{
+		unlink(CARIBOU_FPGA_IMAGE_RECORD);
 		if (caribou_prog_configure(&dev->prog_dev, filename) < 0)
 		{
 			ZF_LOGE("Programming failed");
@@ -228,7 +411,7 @@ int caribou_fpga_program_to_fpga_from_file(caribou_fpga_st* dev, char *filename,
 		io_utils_usleep(100000);
 
 		caribou_fpga_get_status(dev, NULL);
-		if (dev->status == caribou_fpga_status_not_programmed)
+		if (dev->status == caribou_fpga_status_not_programmed || caribou_fpga_image_verify(dev, hash) != 0)
 		{
 			ZF_LOGE("Programming failed");
 			return -1;
@@ -236,7 +419,8 @@ int caribou_fpga_program_to_fpga_from_file(caribou_fpga_st* dev, char *filename,
 	}
 	else
 	{
-		ZF_LOGI("FPGA already operational - not programming (use 'force_prog=true' to force update)");
+		ZF_LOGI("FPGA already runs image %016llX - not programming (use 'force_prog=true' to force update)",
+					(unsigned long long)hash);
 	}
 	return 0;
 }
@@ -308,24 +492,35 @@ int caribou_fpga_get_versions (caribou_fpga_st* dev, caribou_fpga_versions_st* v
         .mid = caribou_fpga_mid_sys_ctrl,
     };
 
-    uint8_t *poc = (uint8_t*)&oc;
+    uint8_t opcodes[5] = {0};
+    uint8_t values[5] = {0};
     CARIBOU_FPGA_CHECK_DEV(dev,"caribou_fpga_get_versions");
 
     oc.ioc = IOC_SYS_CTRL_SYS_VERSION;
-    caribou_fpga_spi_transfer (dev, poc, &dev->versions.sys_ver);
+    opcodes[0] = *(uint8_t*)&oc;
 
     oc.ioc = IOC_SYS_CTRL_MANU_ID;
-    caribou_fpga_spi_transfer (dev, poc, &dev->versions.sys_manu_id);
+    opcodes[1] = *(uint8_t*)&oc;
 
     oc.ioc = IOC_MOD_VER;
     oc.mid = caribou_fpga_mid_sys_ctrl;
-    caribou_fpga_spi_transfer (dev, poc, &dev->versions.sys_ctrl_mod_ver);
+    opcodes[2] = *(uint8_t*)&oc;
 
     oc.mid = caribou_fpga_mid_io_ctrl;
-    caribou_fpga_spi_transfer (dev, poc, &dev->versions.io_ctrl_mod_ver);
+    opcodes[3] = *(uint8_t*)&oc;
 
     oc.mid = caribou_fpga_mid_smi_ctrl;
-    caribou_fpga_spi_transfer (dev, poc, &dev->versions.smi_ctrl_mod_ver);
+    opcodes[4] = *(uint8_t*)&oc;
+
+    if (caribou_fpga_spi_transfer_batch (dev, opcodes, values, 5) != 0)
+    {
+        return -1;
+    }
+    dev->versions.sys_ver = values[0];
+    dev->versions.sys_manu_id = values[1];
+    dev->versions.sys_ctrl_mod_ver = values[2];
+    dev->versions.io_ctrl_mod_ver = values[3];
+    dev->versions.smi_ctrl_mod_ver = values[4];
 
 	//caribou_fpga_print_versions (dev);
 
@@ -16,6 +16,13 @@ extern "C" {
  */
 #define CARIBOU_SDR_MANU_CODE		0x1
 
+/**
+ * @brief The hash and versions of the last bitstream loaded to the FPGA - an
+ *        operational FPGA that matches both isn't programmed again
+ */
+#define CARIBOU_FPGA_IMAGE_DIR		"/var/lib/cariboulite"
+#define CARIBOU_FPGA_IMAGE_RECORD	CARIBOU_FPGA_IMAGE_DIR "/fpga_image"
+
 #pragma pack(1)
 /**
  * @brief Firmware versions and inner modules information
@@ -156,6 +163,7 @@ int caribou_fpga_hard_reset_keep(caribou_fpga_st* dev, bool reset);
 // programming
 int caribou_fpga_get_status(caribou_fpga_st* dev, caribou_fpga_status_en *stat);
 int caribou_fpga_program_to_fpga(caribou_fpga_st* dev, unsigned char *buffer, size_t len, bool force_prog);
+int caribou_fpga_program_to_fpga_compressed(caribou_fpga_st* dev, unsigned char *blob, size_t len, size_t bitstream_len, bool force_prog);
 int caribou_fpga_program_to_fpga_from_file(caribou_fpga_st* dev, char *filename, bool force_prog);
 
 // System Controller
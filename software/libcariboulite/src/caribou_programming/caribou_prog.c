@@ -9,12 +9,36 @@
 #include <stdlib.h>
 #include <string.h>
 #include <errno.h>
+#include <time.h>
 #include "zf_log/zf_log.h"
 #include "caribou_prog.h"
 
 
-#define LATTICE_ICE40_BUFSIZE 512
+#define LATTICE_ICE40_BUFSIZE (16*1024)
 #define LATTICE_ICE40_TO_COUNT 200
+#define LATTICE_ICE40_SPI_CLOCK 25000000	// the slave configuration interface's rated maximum
+
+// compressed bitstreams ('generate_bin_blob -z') - LZ4 style sequences whose offsets
+// stay below the transfer buffer, so it doubles as the decompression window
+#define LATTICE_ICE40_LZ_MIN_MATCH 4
+#define LATTICE_ICE40_LZ_MASK (LATTICE_ICE40_BUFSIZE - 1)
+
+//---------------------------------------------------------------------------
+static double caribou_prog_time_ms(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e3 + ts.tv_nsec / 1e6;
+}
+
+//---------------------------------------------------------------------------
+static void caribou_prog_report(caribou_prog_st *dev, int bytes, double start_ms)
+{
+	double ms = caribou_prog_time_ms() - start_ms;
+	ZF_LOGI("bitstream sent, %d bytes in %.1f ms (%.2f Mbit/s, %s SPI)", bytes, ms,
+				ms > 0 ? (bytes * 8.0) / (ms * 1e3) : 0.0,
+				dev->io_spi->chips[dev->io_spi_handle].is_hard_spi ? "hard" : "bit-banged");
+}
 
 //---------------------------------------------------------------------------
 /**
@@ -69,12 +93,15 @@ int caribou_prog_init(caribou_prog_st *dev, io_utils_spi_st* io_spi)
 	io_utils_setup_gpio(dev->cs_pin, io_utils_dir_output, io_utils_pull_up);
 	io_utils_setup_gpio(dev->reset_pin, io_utils_dir_output, io_utils_pull_up);
 
+	// the iCE40 slave configuration interface is rated to 25 MHz - on the SPI
+	// controller, with CS held here (the bit-banged fallback gets what it can)
+	io_utils_hard_spi_st hard_dev = {.spi_dev_id = dev->spi_dev, .spi_dev_channel = dev->spi_channel, };
 	dev->io_spi_handle = io_utils_spi_add_chip(	dev->io_spi, 
 												dev->cs_pin, 
-												2000000, 
+												LATTICE_ICE40_SPI_CLOCK, 
 												0, 
 												0,
-												io_utils_spi_chip_ice40_prog, NULL);
+												io_utils_spi_chip_ice40_prog, &hard_dev);
 
 	dev->initialized = 1;
 
@@ -232,7 +259,7 @@ int caribou_prog_configure_from_buffer(	caribou_prog_st *dev,
 										uint32_t buffer_size)
 {
 	int ct = 0;
-	int progress = 0;
+	double start_ms = 0.0;
 
 	if (dev == NULL)
 	{
@@ -259,27 +286,163 @@ int caribou_prog_configure_from_buffer(	caribou_prog_st *dev,
 	// Read file & send bitstream to FPGA via SPI with CS LOW
 	ZF_LOGI("Sending bitstream of size %d", buffer_size);
 	ct = 0;
+	start_ms = caribou_prog_time_ms();
 	io_utils_write_gpio_with_wait(dev->cs_pin, 0, 200);
 	while( ct < (int)(buffer_size) )
 	{
-		unsigned char dummybuf[LATTICE_ICE40_BUFSIZE];
 		char* readbuf = (char*)(buffer + ct);
 		int length = (buffer_size-ct)<LATTICE_ICE40_BUFSIZE ? buffer_size-ct : LATTICE_ICE40_BUFSIZE;
 
 		// Send bitstream
-		io_utils_spi_transmit(dev->io_spi, dev->io_spi_handle,
+		if (io_utils_spi_transmit(dev->io_spi, dev->io_spi_handle,
 								(unsigned char *)readbuf,
-								dummybuf,
+								NULL,
 								length,
-								io_utils_spi_write);
+								io_utils_spi_write) < 0)
+		{
+			io_utils_write_gpio_with_wait(dev->cs_pin, 1, 200);
+			ZF_LOGE("sending the bitstream failed at byte %d", ct);
+			return -1;
+		}
 		ct += length;
+	}
+	io_utils_write_gpio_with_wait(dev->cs_pin, 1, 200);
+	caribou_prog_report(dev, ct, start_ms);
+
+	// CONFIGURATION EPILOGUE
+	// ----------------------
+	if (caribou_prog_configure_finish(dev) != 0)
+	{
+		ZF_LOGE("Finishing the bitstream sending to fpga failed");
+		return -1;
+	}
+
+	ZF_LOGI("FPGA programming - Success!\n");
+
+	return 0;
+}
 
-		// progress
-		progress = (ct * 100) / buffer_size;
-		printf("[%2d%%]\r", progress); fflush(stdout);
+//---------------------------------------------------------------------------
+// a sequence length - the token's nibble, extended by bytes while they're 255
+static int caribou_prog_lz_length(const uint8_t *blob, uint32_t blob_size, uint32_t *pos, uint32_t len)
+{
+	uint8_t b = 255;
+	if (len != 15) return len;
+	while (b == 255)
+	{
+		if (*pos >= blob_size) return -1;
+		b = blob[(*pos)++];
+		len += b;
 	}
+	return len;
+}
+
+//---------------------------------------------------------------------------
+// decompress "blob" into the window and send it every time it fills up
+// returns the number of bitstream bytes sent, or -1
+static int caribou_prog_send_compressed(caribou_prog_st *dev, const uint8_t *blob, uint32_t blob_size)
+{
+	uint8_t window[LATTICE_ICE40_BUFSIZE];
+	uint32_t pos = 0;
+	uint32_t out = 0;
+
+	while (pos < blob_size)
+	{
+		uint8_t token = blob[pos++];
+
+		// literals
+		int lit = caribou_prog_lz_length(blob, blob_size, &pos, token >> 4);
+		if (lit < 0 || pos + lit > blob_size) break;
+		while (lit--)
+		{
+			window[out++ & LATTICE_ICE40_LZ_MASK] = blob[pos++];
+			if ((out & LATTICE_ICE40_LZ_MASK) == 0 &&
+				io_utils_spi_transmit(dev->io_spi, dev->io_spi_handle, window, NULL, LATTICE_ICE40_BUFSIZE, io_utils_spi_write) < 0) return -1;
+		}
+
+		// the last sequence has no match
+		if (pos == blob_size) break;
+
+		// match
+		if (pos + 2 > blob_size) break;
+		uint32_t offset = blob[pos] | (blob[pos + 1] << 8);
+		pos += 2;
+		int match = caribou_prog_lz_length(blob, blob_size, &pos, token & 0xF);
+		if (match < 0 || offset == 0 || offset >= LATTICE_ICE40_BUFSIZE || offset > out) break;
+		match += LATTICE_ICE40_LZ_MIN_MATCH;
+		while (match--)
+		{
+			window[out & LATTICE_ICE40_LZ_MASK] = window[(out - offset) & LATTICE_ICE40_LZ_MASK];
+			out++;
+			if ((out & LATTICE_ICE40_LZ_MASK) == 0 &&
+				io_utils_spi_transmit(dev->io_spi, dev->io_spi_handle, window, NULL, LATTICE_ICE40_BUFSIZE, io_utils_spi_write) < 0) return -1;
+		}
+	}
+
+	if (pos != blob_size)
+	{
+		ZF_LOGE("corrupted bitstream blob at byte %u of %u", pos, blob_size);
+		return -1;
+	}
+
+	// the rest of the window
+	if ((out & LATTICE_ICE40_LZ_MASK) &&
+		io_utils_spi_transmit(dev->io_spi, dev->io_spi_handle, window, NULL, out & LATTICE_ICE40_LZ_MASK, io_utils_spi_write) < 0) return -1;
+	return (int)out;
+}
+
+//---------------------------------------------------------------------------
+/**
+ * @brief starts programming sequence from a compressed memory buffer
+ * 
+ * @param dev device context
+ * @param blob the compressed bitstream ('generate_bin_blob -z')
+ * @param blob_size compressed length in bytes
+ * @param bitstream_size the bitstream length in bytes
+ * @return int success(0), error (-1)
+ */
+int caribou_prog_configure_from_compressed(	caribou_prog_st *dev, 
+											const uint8_t *blob, 
+											uint32_t blob_size,
+											uint32_t bitstream_size)
+{
+	int ct = 0;
+	double start_ms = 0.0;
+
+	if (dev == NULL)
+	{
+		ZF_LOGE("device pointer NULL");
+		return -1;
+	}
+
+	if (!dev->initialized)
+	{
+		ZF_LOGE("device not initialized");
+		return -1;
+	}
+
+	// CONFIGURATION PROLOG
+	// --------------------
+	if (caribou_prog_configure_prepare(	dev ) != 0)
+	{
+		ZF_LOGE("Preparation for bitstream sending to fpga failed");
+		return -1;
+	}
+
+	// CONFIGURATION
+	// -------------
+	// Decompress & send bitstream to FPGA via SPI with CS LOW
+	ZF_LOGI("Sending bitstream of size %u (compressed %u)", bitstream_size, blob_size);
+	start_ms = caribou_prog_time_ms();
+	io_utils_write_gpio_with_wait(dev->cs_pin, 0, 200);
+	ct = caribou_prog_send_compressed(dev, blob, blob_size);
 	io_utils_write_gpio_with_wait(dev->cs_pin, 1, 200);
-	ZF_LOGD("bitstream sent %d bytes", ct);
+	if (ct < 0 || ct != (int)bitstream_size)
+	{
+		ZF_LOGE("sending the bitstream failed (%d of %u bytes)", ct, bitstream_size);
+		return -1;
+	}
+	caribou_prog_report(dev, ct, start_ms);
 
 	// CONFIGURATION EPILOGUE
 	// ----------------------
@@ -308,10 +471,9 @@ int caribou_prog_configure(caribou_prog_st *dev, char *bitfilename)
 	FILE *fd = NULL;
 	int ct = 0;
 	int read;
-	unsigned char dummybuf[LATTICE_ICE40_BUFSIZE];
 	char readbuf[LATTICE_ICE40_BUFSIZE];
-	int progress = 0;
 	long file_length = 0;
+	double start_ms = 0.0;
 
 	if (dev == NULL)
 	{
@@ -345,6 +507,7 @@ int caribou_prog_configure(caribou_prog_st *dev, char *bitfilename)
 	if (caribou_prog_configure_prepare(	dev ) != 0)
 	{
 		ZF_LOGE("Preparation for bitstream sending to fpga failed");
+		fclose(fd);
 		return -1;
 	}
 
@@ -353,25 +516,28 @@ int caribou_prog_configure(caribou_prog_st *dev, char *bitfilename)
 	// Read file & send bitstream to FPGA via SPI with CS LOW
 	ZF_LOGI("Sending bitstream of size %ld", file_length);
 	ct = 0;
+	start_ms = caribou_prog_time_ms();
 	io_utils_write_gpio_with_wait(dev->cs_pin, 0, 200);
 	while( (read=fread(readbuf, sizeof(char), LATTICE_ICE40_BUFSIZE, fd)) > 0 )
 	{
 		// Send bitstream
-		io_utils_spi_transmit(dev->io_spi, dev->io_spi_handle,
+		if (io_utils_spi_transmit(dev->io_spi, dev->io_spi_handle,
 								(unsigned char *)readbuf,
-								dummybuf,
+								NULL,
 								read,
-								io_utils_spi_write);
+								io_utils_spi_write) < 0)
+		{
+			io_utils_write_gpio_with_wait(dev->cs_pin, 1, 200);
+			ZF_LOGE("sending the bitstream failed at byte %d", ct);
+			fclose(fd);
+			return -1;
+		}
 		ct += read;
-
-		// progress
-		progress = (ct * 100) / file_length;
-		printf("[%2d%%]\r", progress); fflush(stdout);
 	}
 	io_utils_write_gpio_with_wait(dev->cs_pin, 1, 200);
 	
 	// close file
-	ZF_LOGI("bitstream sent, closing file - sent %d bytes", ct);
+	caribou_prog_report(dev, ct, start_ms);
 	fclose(fd);
 
 	// CONFIGURATION EPILOGUE
@@ -18,6 +18,8 @@ typedef struct
 	int cs_pin;
 	int cdone_pin;
 	int reset_pin;
+	int spi_dev;			// the FPGA's spidev - the bitstream goes over the SPI controller
+	int spi_channel;		// when it takes SPI_NO_CS, bit-banged otherwise
 	int verbose;
 
 	io_utils_spi_st* io_spi;
@@ -33,6 +35,15 @@ int caribou_prog_configure_from_buffer(	caribou_prog_st *dev,
 										uint8_t *buffer, 
 										uint32_t buffer_size);
 
+/*
+ * Programming from a blob compressed by 'generate_bin_blob -z' - decompressed on the
+ * fly into the transfer buffer, "bitstream_size" is the size it expands to
+ */
+int caribou_prog_configure_from_compressed(	caribou_prog_st *dev, 
+											const uint8_t *blob, 
+											uint32_t blob_size,
+											uint32_t bitstream_size);
+
 /*
  * Hard reset pin toggling function
     Level: if -1 => a full reset (1=>0=>1) cycle is performed
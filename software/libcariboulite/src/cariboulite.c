@@ -92,6 +92,18 @@ int cariboulite_init(bool force_fpga_prog, cariboulite_log_level_en log_lvl)
     return 0;
 }
 
+//=============================================================================
+void cariboulite_force_modem_calibration(bool force)
+{
+    sys.force_modem_calibration = force;
+}
+
+//=============================================================================
+void cariboulite_warm_attach(bool enable)
+{
+    sys.warm_attach = enable;
+}
+
 //=============================================================================
 void cariboulite_close(void)
 {
@@ -90,6 +90,33 @@ bool cariboulite_detect_connected_board(cariboulite_version_en *hw_ver, char* na
  */
 int cariboulite_init(bool force_fpga_prog, cariboulite_log_level_en log_lvl);
 
+/**
+ * @brief Force the modem TX IQ calibration on the next init
+ *
+ * The modem calibration results are cached per board and temperature band
+ * (/var/lib/cariboulite/modem_cal) and reused by later sessions, where they are
+ * revalidated against the chip's own calibration while transmitting. Call
+ * this before cariboulite_init to ignore the cache and calibrate anyway.
+ *
+ * @param force true = recalibrate (the cache is refreshed with the results)
+ */
+void cariboulite_force_modem_calibration(bool force);
+
+/**
+ * @brief Attach to the hardware state of a previous session
+ *
+ * After a full initialization the library records the FPGA versions, the
+ * modem identity and a fingerprint of its configuration (/run/cariboulite).
+ * With warm attach enabled, the next cariboulite_init verifies these against
+ * the live hardware and adopts it - no chip resets and no modem calibration,
+ * bringing the init time from seconds down to milliseconds for short-lived
+ * processes. Any mismatch falls back to the full initialization. Call before
+ * cariboulite_init; forced FPGA programming or modem calibration disable it.
+ *
+ * @param enable true = try a warm attach on init
+ */
+void cariboulite_warm_attach(bool enable);
+
 /**
  * @brief Release resources
  *
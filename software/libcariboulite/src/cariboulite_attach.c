@@ -0,0 +1,63 @@
+#ifndef ZF_LOG_LEVEL
+    #define ZF_LOG_LEVEL ZF_LOG_VERBOSE
+#endif
+#define ZF_LOG_DEF_SRCLOC ZF_LOG_SRCLOC_LONG
+#define ZF_LOG_TAG "CARIBOULITE Attach"
+#include "zf_log/zf_log.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+
+#include "io_utils/io_utils_fs.h"
+#include "cariboulite_attach.h"
+
+//=======================================================================================
+uint32_t cariboulite_attach_hash(uint32_t hash, const void* data, size_t len)
+{
+    const uint8_t* p = (const uint8_t*)data;
+    while (len--)
+    {
+        hash ^= *p++;
+        hash *= 0x01000193;
+    }
+    return hash;
+}
+
+//=======================================================================================
+int cariboulite_attach_load(cariboulite_attach_state_st* state)
+{
+    FILE* f = fopen(CARIBOULITE_ATTACH_PATH, "rb");
+    if (f == NULL) return -1;
+
+    size_t n = fread(state, 1, sizeof(cariboulite_attach_state_st), f);
+    fclose(f);
+
+    if (n != sizeof(cariboulite_attach_state_st) || state->magic != CARIBOULITE_ATTACH_MAGIC)
+    {
+        ZF_LOGW("'%s' is not a valid attach record - ignoring it", CARIBOULITE_ATTACH_PATH);
+        return -1;
+    }
+    return 0;
+}
+
+//=======================================================================================
+int cariboulite_attach_store(const cariboulite_attach_state_st* state)
+{
+    if (io_utils_write_file_atomic(CARIBOULITE_ATTACH_DIR, CARIBOULITE_ATTACH_PATH, state, sizeof(cariboulite_attach_state_st)) != 0)
+    {
+        ZF_LOGW("can't update '%s' (%s) - the next start will be a cold one", CARIBOULITE_ATTACH_PATH, strerror(errno));
+        return -1;
+    }
+    return 0;
+}
+
+//=======================================================================================
+void cariboulite_attach_invalidate(void)
+{
+    if (unlink(CARIBOULITE_ATTACH_PATH) != 0 && errno != ENOENT)
+    {
+        ZF_LOGW("can't remove '%s' (%s)", CARIBOULITE_ATTACH_PATH, strerror(errno));
+    }
+}
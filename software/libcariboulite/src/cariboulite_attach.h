@@ -0,0 +1,48 @@
+#ifndef __CARIBOULITE_ATTACH_H__
+#define __CARIBOULITE_ATTACH_H__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <stddef.h>
+#include "caribou_fpga/caribou_fpga.h"
+#include "at86rf215/at86rf215.h"
+
+// The hardware state left by the last fully initialized session. A "warm
+// attach" adopts it (no chip resets, no modem calibration) once the live
+// FPGA versions, modem identity and configuration signature match it.
+// Kept on tmpfs - a reboot falls back to the full initialization.
+#define CARIBOULITE_ATTACH_DIR          "/run/cariboulite"
+#define CARIBOULITE_ATTACH_PATH         CARIBOULITE_ATTACH_DIR "/attach"
+#define CARIBOULITE_ATTACH_MAGIC        (0xCA1B0A77)
+#define CARIBOULITE_ATTACH_HASH_SEED    (0x811C9DC5)
+
+typedef struct
+{
+    uint32_t magic;
+    uint32_t fingerprint;                       // library, board, firmware and initial configuration
+    caribou_fpga_versions_st fpga_versions;
+    uint8_t modem_pn;
+    uint8_t modem_vn;
+    uint8_t modem_sig[AT86RF215_CONFIG_SIG_LEN];
+    at86rf215_cal_results_st modem_cal;
+    uint16_t mixer_id;                          // 0 on boards without a mixer
+} cariboulite_attach_state_st;
+
+// FNV-1a, chained through "hash" (start with CARIBOULITE_ATTACH_HASH_SEED)
+uint32_t cariboulite_attach_hash(uint32_t hash, const void* data, size_t len);
+
+// 0 = a record was loaded into "state", -1 = none
+int cariboulite_attach_load(cariboulite_attach_state_st* state);
+int cariboulite_attach_store(const cariboulite_attach_state_st* state);
+
+// forget the record - called before the hardware gets reset
+void cariboulite_attach_invalidate(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // __CARIBOULITE_ATTACH_H__
@@ -0,0 +1,130 @@
+#ifndef ZF_LOG_LEVEL
+    #define ZF_LOG_LEVEL ZF_LOG_VERBOSE
+#endif
+#define ZF_LOG_DEF_SRCLOC ZF_LOG_SRCLOC_LONG
+#define ZF_LOG_TAG "CARIBOULITE CalCache"
+#include "zf_log/zf_log.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "io_utils/io_utils_fs.h"
+#include "cariboulite_cal_cache.h"
+
+typedef struct
+{
+    uint32_t serial;
+    int temp_band;
+    at86rf215_cal_results_st cal;
+    long long timestamp;
+} cal_cache_entry_st;
+
+//=======================================================================================
+int cariboulite_cal_cache_temp_band(void)
+{
+    FILE* f = fopen(CARIBOULITE_CAL_TEMP_SENSOR_PATH, "r");
+    if (f == NULL) return CARIBOULITE_CAL_TEMP_UNKNOWN;
+
+    long milli_c = 0;
+    int n = fscanf(f, "%ld", &milli_c);
+    fclose(f);
+    if (n != 1) return CARIBOULITE_CAL_TEMP_UNKNOWN;
+
+    // floor, so that -5C and 5C don't share a band
+    long c = milli_c / 1000;
+    if (milli_c < 0 && (milli_c % 1000)) c--;
+    long band = c / CARIBOULITE_CAL_TEMP_BAND_C;
+    if (c < 0 && (c % CARIBOULITE_CAL_TEMP_BAND_C)) band--;
+    return (int)band;
+}
+
+//=======================================================================================
+static int cal_cache_read(cal_cache_entry_st* entries, int max_entries)
+{
+    FILE* f = fopen(CARIBOULITE_CAL_CACHE_PATH, "r");
+    if (f == NULL) return 0;
+
+    char line[128];
+    int num = 0;
+    while (num < max_entries && fgets(line, sizeof(line), f) != NULL)
+    {
+        cal_cache_entry_st* e = &entries[num];
+        if (sscanf(line, "%x %d %d %d %d %d %lld", &e->serial, &e->temp_band,
+                   &e->cal.low_ch_i, &e->cal.low_ch_q, &e->cal.hi_ch_i, &e->cal.hi_ch_q,
+                   &e->timestamp) == 7)
+        {
+            num++;
+        }
+    }
+    fclose(f);
+    return num;
+}
+
+//=======================================================================================
+int cariboulite_cal_cache_lookup(uint32_t serial, int temp_band, at86rf215_cal_results_st* cal)
+{
+    cal_cache_entry_st entries[CARIBOULITE_CAL_CACHE_MAX_ENTRIES];
+    int num = cal_cache_read(entries, CARIBOULITE_CAL_CACHE_MAX_ENTRIES);
+    long long now = (long long)time(NULL);
+
+    for (int i = 0; i < num; i++)
+    {
+        if (entries[i].serial != serial || entries[i].temp_band != temp_band) continue;
+
+        long long age = now - entries[i].timestamp;
+        if (age < 0 || age > CARIBOULITE_CAL_CACHE_MAX_AGE_SEC)
+        {
+            ZF_LOGD("cached modem calibration for band %d is stale (%lld sec)", temp_band, age);
+            return -1;
+        }
+
+        *cal = entries[i].cal;
+        ZF_LOGD("cached modem calibration (serial %08X, band %d): low %d,%d, hi %d,%d", serial, temp_band,
+                    cal->low_ch_i, cal->low_ch_q, cal->hi_ch_i, cal->hi_ch_q);
+        return 0;
+    }
+    return -1;
+}
+
+//=======================================================================================
+int cariboulite_cal_cache_store(uint32_t serial, int temp_band, const at86rf215_cal_results_st* cal)
+{
+    cal_cache_entry_st entries[CARIBOULITE_CAL_CACHE_MAX_ENTRIES];
+    int num = cal_cache_read(entries, CARIBOULITE_CAL_CACHE_MAX_ENTRIES);
+
+    // replace the same key, or the oldest entry when full
+    int slot = -1;
+    int oldest = 0;
+    for (int i = 0; i < num; i++)
+    {
+        if (entries[i].serial == serial && entries[i].temp_band == temp_band) { slot = i; break; }
+        if (entries[i].timestamp < entries[oldest].timestamp) oldest = i;
+    }
+    if (slot < 0) slot = (num < CARIBOULITE_CAL_CACHE_MAX_ENTRIES) ? num++ : oldest;
+
+    entries[slot].serial = serial;
+    entries[slot].temp_band = temp_band;
+    entries[slot].cal = *cal;
+    entries[slot].timestamp = (long long)time(NULL);
+
+    char buf[CARIBOULITE_CAL_CACHE_MAX_ENTRIES * 96];
+    size_t len = 0;
+    for (int i = 0; i < num; i++)
+    {
+        len += snprintf(buf + len, sizeof(buf) - len, "%08X %d %d %d %d %d %lld\n", entries[i].serial, entries[i].temp_band,
+                entries[i].cal.low_ch_i, entries[i].cal.low_ch_q, entries[i].cal.hi_ch_i, entries[i].cal.hi_ch_q,
+                entries[i].timestamp);
+    }
+
+    if (io_utils_write_file_atomic(CARIBOULITE_CAL_CACHE_DIR, CARIBOULITE_CAL_CACHE_PATH, buf, len) != 0)
+    {
+        ZF_LOGW("can't update '%s' (%s) - modem calibration not cached", CARIBOULITE_CAL_CACHE_PATH, strerror(errno));
+        return -1;
+    }
+
+    ZF_LOGD("modem calibration cached (serial %08X, band %d)", serial, temp_band);
+    return 0;
+}
@@ -0,0 +1,37 @@
+#ifndef __CARIBOULITE_CAL_CACHE_H__
+#define __CARIBOULITE_CAL_CACHE_H__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include "at86rf215/at86rf215_common.h"
+
+// The modem TX IQ calibration is stable for a given board within a temperature
+// band, so it is kept on disk and reused on the next start instead of running
+// the ~10 ms per channel calibration sequence again.
+// File format - one entry per line:
+//     <serial hex> <temp band> <low_i> <low_q> <hi_i> <hi_q> <unix time>
+#define CARIBOULITE_CAL_CACHE_DIR           "/var/lib/cariboulite"
+#define CARIBOULITE_CAL_CACHE_PATH          CARIBOULITE_CAL_CACHE_DIR "/modem_cal"
+#define CARIBOULITE_CAL_CACHE_MAX_ENTRIES   (16)
+#define CARIBOULITE_CAL_CACHE_MAX_AGE_SEC   (30 * 24 * 3600)
+#define CARIBOULITE_CAL_TEMP_BAND_C         (10)
+#define CARIBOULITE_CAL_TEMP_UNKNOWN        (-1000)
+#define CARIBOULITE_CAL_TEMP_SENSOR_PATH    "/sys/class/thermal/thermal_zone0/temp"
+
+// the current temperature band (CARIBOULITE_CAL_TEMP_UNKNOWN when no sensor)
+int cariboulite_cal_cache_temp_band(void);
+
+// 0 = a fresh entry was found and copied to "cal", -1 = none
+int cariboulite_cal_cache_lookup(uint32_t serial, int temp_band, at86rf215_cal_results_st* cal);
+
+// add / replace the entry of (serial, temp_band) - 0 = success, -1 = failed
+int cariboulite_cal_cache_store(uint32_t serial, int temp_band, const at86rf215_cal_results_st* cal);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // __CARIBOULITE_CAL_CACHE_H__
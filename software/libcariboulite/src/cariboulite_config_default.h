@@ -58,6 +58,8 @@ extern "C" {
 							.cs_pin = CARIBOULITE_FPGA_SS,				\
 							.cdone_pin = CARIBOULITE_FPGA_CDONE,		\
 							.reset_pin = CARIBOULITE_FPGA_CRESET,		\
+							.spi_dev = CARIBOULITE_SPI_DEV,				\
+							.spi_channel = CARIBOULITE_FPGA_SPI_CHANNEL,\
 						},												\
                         .initialized = 0,                               \
                     },                                                  \
@@ -17,2038 +17,898 @@ extern "C" {
 
 /*
  * Time tagging of the module through the 'struct tm' structure 
- *     Date: 2024-04-09
- *     Time: 13:13:50
+ *     Date: 2026-10-19
+ *     Time: 16:24:15
  */
 struct tm cariboulite_firmware_date_time = {
-   .tm_sec = 50,
-   .tm_min = 13,
-   .tm_hour = 13,
-   .tm_mday = 9,
-   .tm_mon = 3,   /* +1    */
-   .tm_year = 124,  /* +1900 */
+   .tm_sec = 15,
+   .tm_min = 24,
+   .tm_hour = 16,
+   .tm_mday = 19,
+   .tm_mon = 9,   /* +1    */
+   .tm_year = 126,  /* +1900 */
 };
 
 /*
- * Data blob of variable cariboulite_firmware:
- *     Size: 32220 bytes
+ * Data blob of variable cariboulite_firmware (compressed - LZ4 style sequences, 16 KB window):
+ *     Size: 13962 bytes (32220 bytes uncompressed)
  *     Original filename: ./top.bin
  */
+uint32_t cariboulite_firmware_raw_size = 32220;
 uint8_t cariboulite_firmware[] = {
-	0xFF, 0x00, 0x00, 0xFF, 0x7E, 0xAA, 0x99, 0x7E, 0x51, 0x00, 0x01, 0x05, 0x92, 0x00, 0x20, 0x62, 
-	0x01, 0x4B, 0x72, 0x00, 0x90, 0x82, 0x00, 0x00, 0x11, 0x00, 0x01, 0x01, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x10, 0x01, 0x60, 0x00, 0x00, 0x00, 0x00, 0x40, 
-	0x0F, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x02, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x70, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x08, 0x00, 0x00, 0x00, 0x00, 0x10, 0x00, 0x00, 0x00, 0x40, 
-	0x00, 0x00, 0x40, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x07, 
-	0x80, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x80, 0x00, 0x0C, 0x00, 0x00, 0x20, 0x01, 
-	0xE0, 0x01, 0x50, 0x00, 0x00, 0x80, 0x08, 0x00, 0x03, 0xC0, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x0F, 0x00, 0x00, 0xC0, 0x00, 0x00, 0x00, 0x02, 0x00, 0x36, 0x00, 0x00, 0x00, 0x00, 
-	0xF0, 0x40, 0xF8, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x04, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x10, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x40, 0x00, 0x00, 0x00, 0x00, 0x10, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x40, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x04, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x10, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x40, 0x00, 0x00, 0x00, 0x00, 
-	0x30, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xC0, 0x00, 0x00, 0x00, 0x00, 0x05, 0x03, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0xF0, 0x00, 0xD0, 0x00, 0x00, 0x00, 0x00, 0x00, 0x03, 0xC0, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x0F, 0x40, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x40, 0x08, 0x00, 0x05, 0x00, 0x00, 
-	0x01, 0x00, 0x0C, 0x00, 0x0C, 0x00, 0x00, 0x04, 0x00, 0x78, 0x00, 0x7C, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0xE0, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x08, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x40, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x01, 0x00, 0x36, 0x00, 0x18, 0x00, 0x00, 0x04, 0x00, 0xF0, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x40, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x80, 0x00, 0x00, 0x00, 0x00, 0x00, 0x02, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x08, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x0C, 0x18, 0x10, 0x00, 0x00, 0x08, 0x00, 0x80, 0x00, 0x00, 0x00, 0x00, 0x20, 0x00, 0x04, 0x02, 
-	0x00, 0x00, 0x00, 0x00, 0x16, 0x90, 0x00, 0x00, 0x00, 0x05, 0x40, 0x00, 0x80, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x34, 0x01, 0x49, 0xDB, 0x00, 0x00, 0x18, 0x50, 
-	0x05, 0x28, 0x00, 0x00, 0x00, 0x02, 0xC0, 0x08, 0x00, 0x00, 0x00, 0x00, 0x03, 0x02, 0x94, 0x80, 
-	0x00, 0x00, 0x02, 0x80, 0x00, 0x00, 0x20, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x20, 0x00, 0x07, 0x01, 0xDC, 0x04, 0x00, 0x80, 0x08, 0x00, 0x90, 0x40, 0xA0, 0x00, 0x00, 0x01, 
-	0xC1, 0x04, 0x00, 0x80, 0x00, 0x00, 0x00, 0x00, 0x10, 0x00, 0x00, 0x16, 0x00, 0x5A, 0x33, 0x80, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x08, 0x00, 0x00, 0x6C, 0x09, 0xC0, 0x00, 
-	0x20, 0x00, 0x50, 0x95, 0x3C, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x20, 0x20, 0x00, 0x00, 0x0F, 
-	0x00, 0x20, 0x05, 0x00, 0x00, 0x00, 0x02, 0x0C, 0xC0, 0x10, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x44, 0x00, 0x60, 0x7E, 0x0A, 0x54, 0x01, 0x00, 0x43, 0x8E, 0x80, 0x00, 0x00, 
-	0x02, 0x06, 0x00, 0x00, 0x04, 0x01, 0x00, 0x00, 0x0A, 0x00, 0x00, 0x18, 0x00, 0x00, 0x36, 0x68, 
-	0x08, 0x33, 0x80, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x08, 0x00, 0x00, 0x20, 
-	0xE0, 0x00, 0x00, 0x30, 0x02, 0x00, 0x09, 0x00, 0x00, 0x00, 0x04, 0x03, 0x40, 0x08, 0x20, 0x70, 
-	0x00, 0x01, 0x07, 0x00, 0x20, 0x04, 0x00, 0x01, 0x40, 0x00, 0xAC, 0xC0, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x03, 0x8F, 
-	0x80, 0x00, 0x00, 0x00, 0x00, 0x0C, 0x00, 0x04, 0x00, 0x00, 0x00, 0x00, 0x80, 0x00, 0x10, 0x40, 
-	0x00, 0x1E, 0x68, 0x09, 0x33, 0x80, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x91, 0xE7, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x04, 0x00, 0x00, 0x00, 0xD0, 0x07, 0x00, 0x20, 0x00, 0x00, 0x00, 0x00, 0x00, 0x8C, 0xC0, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xC0, 0x1E, 0xCC, 0x50, 0x00, 
-	0x01, 0x01, 0x00, 0x80, 0x00, 0x00, 0x02, 0x00, 0x1E, 0x00, 0x04, 0x04, 0x00, 0x08, 0x00, 0x03, 
-	0x8C, 0xD0, 0x00, 0x00, 0x00, 0x00, 0x08, 0x33, 0x80, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x02, 0x00, 0x28, 0xC5, 0x00, 0x00, 0x00, 0x08, 0x0D, 0x00, 0x00, 0x00, 
-	0x2C, 0x00, 0x20, 0x04, 0x20, 0x00, 0x08, 0x10, 0x00, 0x7C, 0xCC, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0xBC, 0xC0, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x02, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x98, 0x00, 0x00, 0x02, 0x00, 0x40, 0x00, 0x24, 0x00, 0x00, 
-	0x00, 0x1A, 0x70, 0x00, 0x10, 0x40, 0x00, 0x00, 0x00, 0xE8, 0x33, 0x80, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x2C, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x90, 0x0D, 
-	0x00, 0x00, 0x00, 0x14, 0x28, 0x0A, 0x00, 0x21, 0x00, 0x00, 0x00, 0x00, 0x80, 0x10, 0x00, 0x00, 
-	0x00, 0x02, 0x82, 0x0C, 0xC0, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x20, 0x08, 0x14, 0x00, 0x00, 0x00, 0x00, 0x80, 0x00, 0x00, 0x00, 0x00, 0x00, 0x10, 
-	0x24, 0x00, 0x00, 0x05, 0x9B, 0x58, 0x00, 0x10, 0x00, 0x00, 0x00, 0x00, 0x09, 0x33, 0x80, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xCA, 0x42, 0x00, 0x00, 
-	0x00, 0x00, 0x03, 0x00, 0x00, 0x00, 0x00, 0x00, 0x0F, 0x00, 0x00, 0x00, 0x00, 0x00, 0xA0, 0x00, 
-	0x10, 0x00, 0x00, 0x00, 0x00, 0x00, 0xEC, 0xC0, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0xC0, 0x00, 0x00, 0x4E, 0x08, 0x14, 0x07, 0x00, 0x07, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x02, 0x40, 0x00, 0x00, 0x01, 0x00, 0x08, 0x00, 0x80, 0x00, 0x10, 0x10, 0x00, 0x14, 0x01, 0x68, 
-	0x33, 0x80, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x20, 0x0B, 
-	0x81, 0x00, 0x70, 0x00, 0x70, 0x93, 0x00, 0x00, 0x00, 0x00, 0x60, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x50, 0x0B, 0x00, 0x20, 0x04, 0x00, 0x00, 0x00, 0x02, 0x0C, 0xC0, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x16, 0x00, 0x7E, 0x0A, 0x54, 0x00, 0x04, 0x00, 0x00, 0x80, 
-	0x00, 0x88, 0x01, 0x67, 0xB6, 0xAA, 0x00, 0x00, 0x00, 0x01, 0x98, 0x12, 0x52, 0x00, 0x08, 0x00, 
-	0x20, 0x29, 0xC8, 0x33, 0x80, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x04, 0x2A, 0x60, 0x00, 0x00, 0x00, 0x00, 0x70, 0x05, 0x20, 0x00, 0x00, 0x1C, 0x40, 0x78, 0x42, 
-	0x00, 0x40, 0x00, 0x01, 0xE7, 0x61, 0x68, 0x00, 0x00, 0x00, 0x44, 0x00, 0x0C, 0xC0, 0x44, 0x00, 
-	0x00, 0x08, 0x00, 0x00, 0x08, 0x02, 0x05, 0x00, 0x20, 0x00, 0x00, 0x55, 0xCA, 0x50, 0x02, 0x84, 
-	0x00, 0x00, 0xF8, 0x00, 0xE0, 0x00, 0x00, 0x20, 0x00, 0x04, 0x00, 0x80, 0x08, 0x19, 0x53, 0xA4, 
-	0x00, 0x0E, 0x00, 0x00, 0x01, 0xE8, 0x33, 0x00, 0x00, 0x00, 0x02, 0x00, 0x00, 0x00, 0x32, 0xD0, 
-	0x80, 0x18, 0x00, 0x00, 0x37, 0x70, 0xAA, 0x00, 0x00, 0x00, 0xF0, 0x0F, 0x28, 0x08, 0x00, 0x3C, 
-	0x01, 0x40, 0x08, 0x01, 0x20, 0x00, 0x91, 0x90, 0xEE, 0x40, 0x00, 0x80, 0x00, 0x00, 0x00, 0x0C, 
-	0xC0, 0x00, 0x00, 0x00, 0x10, 0x00, 0x00, 0x13, 0xFA, 0x81, 0x00, 0xC0, 0x01, 0x66, 0x16, 0x1A, 
-	0x50, 0x01, 0x01, 0x00, 0x1E, 0x80, 0x00, 0xC0, 0x00, 0x00, 0x60, 0x00, 0x04, 0x01, 0x00, 0x00, 
-	0x19, 0x06, 0x4C, 0xC0, 0x00, 0x00, 0x00, 0x66, 0x4B, 0x58, 0x00, 0x00, 0x00, 0x02, 0x00, 0x00, 
-	0x08, 0x04, 0x28, 0x00, 0x0C, 0x00, 0x34, 0x29, 0x4D, 0x99, 0x20, 0x30, 0x00, 0x11, 0x0D, 0x00, 
-	0x00, 0x00, 0x00, 0x21, 0xC0, 0x08, 0x00, 0x10, 0x00, 0x01, 0x90, 0x64, 0xCC, 0x00, 0x08, 0x00, 
-	0x02, 0x57, 0xE0, 0x00, 0x00, 0x00, 0x02, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x02, 
-	0x00, 0x05, 0x8A, 0x04, 0x00, 0x00, 0x03, 0x8E, 0x80, 0x00, 0x00, 0x03, 0x60, 0x40, 0x00, 0x24, 
-	0x00, 0x00, 0x50, 0x00, 0x78, 0x2F, 0x44, 0x00, 0x00, 0x16, 0x29, 0x40, 0x5A, 0x60, 0x40, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x04, 0x2C, 0x10, 0xA0, 0x00, 0x00, 0x00, 
-	0x78, 0x8D, 0x00, 0x00, 0x0C, 0x1C, 0x38, 0x09, 0x00, 0x00, 0x00, 0x02, 0x00, 0x00, 0x3E, 0xF4, 
-	0x60, 0x04, 0x00, 0x00, 0x02, 0x05, 0xA1, 0x14, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x21, 0xAA, 0x04, 0x00, 0x20, 0x00, 0x00, 0x00, 0x00, 0x0A, 0x04, 0x00, 
-	0x20, 0x00, 0x04, 0x00, 0x00, 0x00, 0x0A, 0x00, 0x59, 0x80, 0x00, 0x06, 0x06, 0x38, 0x01, 0x66, 
-	0x00, 0x00, 0x00, 0x20, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x02, 0x50, 0x50, 
-	0x00, 0x00, 0x00, 0x10, 0x03, 0x00, 0x00, 0x00, 0x00, 0x01, 0x40, 0x08, 0x00, 0x00, 0x00, 0x00, 
-	0x0D, 0x22, 0x64, 0x00, 0x00, 0x00, 0x20, 0x04, 0xB9, 0x90, 0x00, 0x00, 0x00, 0x00, 0x00, 0x58, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x06, 0x18, 0x14, 0x10, 0x00, 0x01, 0x00, 0xB8, 0x00, 
-	0x00, 0x00, 0x60, 0x00, 0x00, 0x24, 0x00, 0x00, 0x50, 0x18, 0x00, 0x00, 0x90, 0x00, 0x40, 0x06, 
-	0x05, 0xCE, 0x11, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x80, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x30, 0x2A, 0x81, 0x00, 0x00, 0x00, 0x10, 0x05, 0x00, 0x00, 0x00, 0x02, 0x00, 0x08, 0x00, 0x00, 
-	0x40, 0x3A, 0x00, 0x00, 0x34, 0x00, 0x00, 0x08, 0x00, 0x22, 0x2E, 0xC4, 0x40, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x02, 0x20, 0xAA, 0x04, 0x00, 0x00, 0x00, 
-	0x00, 0x80, 0x00, 0x00, 0x00, 0x60, 0x00, 0x00, 0x24, 0x00, 0x00, 0x01, 0x08, 0x7F, 0x03, 0x40, 
-	0x00, 0x00, 0x3C, 0x60, 0x01, 0x66, 0x61, 0x40, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x02, 0x40, 0x50, 0x00, 0x00, 0x00, 0x00, 0x0F, 0x00, 0x00, 0x00, 0x02, 0x00, 
-	0x0E, 0x00, 0x00, 0x80, 0x00, 0x09, 0xE0, 0x78, 0x34, 0x00, 0x00, 0xA2, 0xC4, 0x34, 0xD9, 0x92, 
-	0x08, 0x00, 0x00, 0x30, 0x00, 0x00, 0x10, 0x00, 0x00, 0x00, 0xC0, 0x00, 0x00, 0x4E, 0x9D, 0x10, 
-	0x01, 0x00, 0x03, 0x89, 0x80, 0x00, 0x40, 0x01, 0x40, 0x20, 0x00, 0x04, 0x01, 0x00, 0x09, 0x80, 
-	0x72, 0x84, 0x80, 0x04, 0x00, 0x14, 0x03, 0xCE, 0xA0, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x0D, 
-	0x00, 0x00, 0x00, 0x08, 0x00, 0x00, 0x20, 0x3B, 0xD1, 0x00, 0x90, 0x00, 0x00, 0xD3, 0x00, 0x00, 
-	0x00, 0x02, 0x00, 0xC0, 0x08, 0x00, 0x40, 0x00, 0x10, 0x00, 0xEC, 0x48, 0x00, 0x00, 0x00, 0x00, 
-	0x0E, 0x00, 0xA0, 0x00, 0x00, 0x00, 0x00, 0x00, 0x18, 0x05, 0x82, 0x05, 0x00, 0x00, 0x08, 0x02, 
-	0xA6, 0x0A, 0x54, 0x01, 0x0B, 0xA0, 0x00, 0x00, 0x40, 0x82, 0x00, 0x02, 0xC0, 0x00, 0x00, 0x02, 
-	0x13, 0x0F, 0x98, 0x37, 0x94, 0x00, 0x08, 0x00, 0x14, 0x02, 0xDA, 0x80, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x02, 0xE0, 0x40, 0x00, 0x00, 0x00, 0x3D, 0x40, 0x00, 0x00, 0x08, 0x04, 0x00, 
-	0x0D, 0x24, 0x00, 0x4C, 0x00, 0x24, 0x00, 0x00, 0x00, 0x00, 0x80, 0x11, 0xE9, 0xC0, 0x14, 0x00, 
-	0x00, 0x00, 0x02, 0xB7, 0xB0, 0x00, 0x00, 0x00, 0x00, 0x08, 0x00, 0x00, 0x00, 0x2B, 0x01, 0x00, 
-	0x20, 0x01, 0x40, 0x1F, 0xAA, 0x04, 0x80, 0x80, 0x00, 0x00, 0x70, 0x40, 0x24, 0x00, 0x00, 0x40, 
-	0x00, 0x00, 0x00, 0x80, 0x05, 0x99, 0x93, 0x04, 0x80, 0x02, 0x00, 0x26, 0x66, 0x0A, 0x55, 0x00, 
-	0x00, 0x00, 0x02, 0x00, 0x00, 0x00, 0x07, 0xB0, 0x00, 0x08, 0x00, 0x00, 0x00, 0x00, 0xA0, 0x01, 
-	0x21, 0x00, 0x00, 0xFB, 0x3C, 0x08, 0xA0, 0x00, 0x38, 0x00, 0x00, 0x00, 0x20, 0x00, 0x01, 0x99, 
-	0x78, 0x00, 0x80, 0x80, 0x00, 0x42, 0xAC, 0x0A, 0xA0, 0x00, 0x00, 0x00, 0x10, 0x00, 0x01, 0xE0, 
-	0x00, 0x00, 0x00, 0x42, 0x00, 0x00, 0x01, 0xDC, 0x04, 0x03, 0x00, 0x50, 0x1C, 0x80, 0x00, 0x40, 
-	0x11, 0xE6, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x18, 0xF2, 0x40, 0x80, 0x00, 0x00, 0x06, 0x6E, 
-	0x41, 0xA5, 0x00, 0x00, 0x00, 0x02, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x04, 0x40, 0x40, 0x00, 
-	0x0A, 0xC0, 0x00, 0x38, 0x00, 0x01, 0x07, 0x00, 0x0C, 0x06, 0x82, 0x40, 0x00, 0x00, 0x00, 0x00, 
-	0x80, 0x51, 0xA9, 0xFE, 0x84, 0x80, 0x00, 0x01, 0x63, 0x5C, 0xC1, 0x80, 0x00, 0x00, 0x02, 0x00, 
-	0x00, 0x18, 0x03, 0x03, 0x9C, 0x01, 0x00, 0x01, 0xC0, 0x01, 0xAC, 0x04, 0x00, 0x00, 0x07, 0x00, 
-	0x80, 0x00, 0x00, 0x03, 0xE0, 0x44, 0x00, 0x04, 0x04, 0x10, 0x01, 0x89, 0xDE, 0xF0, 0x00, 0x00, 
-	0x00, 0x14, 0x7F, 0xCD, 0x0E, 0x40, 0x00, 0x00, 0x00, 0x00, 0x0D, 0x00, 0xFA, 0x20, 0x40, 0x00, 
-	0x00, 0x03, 0x00, 0x09, 0xC0, 0x20, 0x08, 0x00, 0x70, 0x05, 0x00, 0x00, 0x00, 0x1C, 0x3C, 0x20, 
-	0x04, 0x00, 0x02, 0x80, 0x00, 0xCB, 0xB0, 0x00, 0x00, 0x00, 0x01, 0x42, 0x26, 0x80, 0xF0, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x17, 0x77, 0x88, 0x80, 0x00, 0x00, 0x00, 0x60, 0x18, 0x14, 0x00, 
-	0x08, 0x01, 0x0F, 0x00, 0x00, 0x08, 0x08, 0x00, 0x00, 0x00, 0x24, 0x00, 0x00, 0x01, 0x09, 0x97, 
-	0xA8, 0x40, 0x00, 0x00, 0x20, 0x28, 0x4A, 0x55, 0x00, 0x00, 0x00, 0x20, 0x00, 0x00, 0x0A, 0x0A, 
-	0xB8, 0x80, 0x00, 0x00, 0x00, 0x20, 0xCA, 0x42, 0x00, 0x0B, 0x00, 0x01, 0xDB, 0x00, 0x00, 0x81, 
-	0x40, 0x20, 0x0A, 0x00, 0x08, 0x00, 0x00, 0x00, 0xB9, 0x2C, 0x40, 0x00, 0x00, 0x00, 0x40, 0x00, 
-	0x05, 0x50, 0x00, 0x00, 0x00, 0x00, 0x00, 0x58, 0x05, 0x02, 0x05, 0x00, 0x00, 0x01, 0xC0, 0x0D, 
-	0xAA, 0x04, 0x00, 0x00, 0x03, 0x80, 0xF8, 0x00, 0x00, 0x00, 0x06, 0x8E, 0xD6, 0x90, 0x00, 0x00, 
-	0x05, 0x0A, 0xFB, 0xC8, 0x40, 0x00, 0x00, 0x04, 0x23, 0xD8, 0x10, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x0A, 0x20, 0x40, 0x00, 0x00, 0x24, 0x00, 0x20, 0xA0, 0x00, 0x08, 0x00, 0x18, 0x03, 
-	0x80, 0x00, 0x00, 0x04, 0x3C, 0x1D, 0x69, 0x00, 0x00, 0x00, 0x00, 0x01, 0x2D, 0x20, 0x00, 0x00, 
-	0x00, 0x64, 0x15, 0xF4, 0x00, 0x00, 0x00, 0x00, 0x00, 0x02, 0x80, 0x07, 0x3F, 0x14, 0x00, 0x00, 
-	0x00, 0x06, 0x21, 0xEA, 0x04, 0x00, 0x00, 0x91, 0x8E, 0x80, 0x00, 0x0A, 0x00, 0x00, 0x25, 0xF1, 
-	0x00, 0x00, 0x00, 0x21, 0x01, 0x52, 0xA8, 0x00, 0x00, 0xA0, 0x06, 0x6F, 0x5E, 0x02, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x01, 0x08, 0x07, 0xB1, 0x48, 0x00, 0x00, 0x00, 0x01, 0x40, 0x50, 0x00, 0x09, 
-	0x10, 0x08, 0x03, 0x00, 0x00, 0x0A, 0x00, 0x01, 0x79, 0xA1, 0x00, 0x00, 0x04, 0x58, 0xE7, 0x40, 
-	0x14, 0x00, 0x00, 0x04, 0x03, 0x56, 0x98, 0x00, 0x00, 0x00, 0x00, 0x30, 0x00, 0x10, 0x00, 0x00, 
-	0x00, 0x00, 0xC0, 0x02, 0x60, 0x16, 0xEA, 0x04, 0x01, 0x00, 0x07, 0x9A, 0x00, 0x00, 0x40, 0x00, 
-	0x00, 0x6E, 0x1A, 0x50, 0x00, 0x00, 0x1F, 0x08, 0x00, 0x00, 0x10, 0x04, 0x00, 0x06, 0x06, 0x61, 
-	0x81, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x80, 0x00, 0x00, 0x00, 0x08, 0x06, 0x04, 0x00, 0x10, 
-	0xA0, 0x00, 0xF8, 0x00, 0x00, 0x83, 0x00, 0x00, 0x0C, 0x00, 0x31, 0x6B, 0x99, 0x00, 0x00, 0x00, 
-	0x90, 0x93, 0x00, 0x20, 0x80, 0x00, 0x02, 0x62, 0x7C, 0xC1, 0x80, 0x00, 0x00, 0x80, 0x10, 0x00, 
-	0x00, 0x03, 0x6A, 0x81, 0x00, 0x40, 0x00, 0x00, 0x40, 0x08, 0x14, 0x00, 0x04, 0x09, 0x00, 0x00, 
-	0x40, 0xC4, 0x01, 0x60, 0x40, 0xC1, 0x04, 0x03, 0x00, 0x00, 0x00, 0x80, 0x39, 0xD0, 0x4C, 0x80, 
-	0x00, 0x01, 0xF8, 0xAA, 0x00, 0x00, 0x08, 0x00, 0x80, 0x00, 0x00, 0x04, 0x28, 0x00, 0x02, 0x06, 
-	0x14, 0x2E, 0x4B, 0x42, 0x00, 0x00, 0x00, 0xF8, 0x01, 0x30, 0x02, 0x04, 0x00, 0x34, 0x00, 0x00, 
-	0x00, 0x08, 0x01, 0x00, 0xE7, 0x2B, 0x6C, 0x00, 0x20, 0x14, 0x00, 0x01, 0x0A, 0xA0, 0x00, 0x00, 
-	0x80, 0x08, 0x00, 0x50, 0x03, 0x82, 0x05, 0x01, 0x20, 0x14, 0x06, 0x80, 0xEC, 0x50, 0x06, 0x84, 
-	0x00, 0x00, 0xD8, 0x00, 0xE0, 0x01, 0x67, 0x80, 0x00, 0x24, 0x03, 0x80, 0x08, 0x1B, 0x80, 0x79, 
-	0xD0, 0x02, 0x00, 0x26, 0x28, 0x00, 0x00, 0x00, 0x00, 0x08, 0x02, 0x00, 0x00, 0x80, 0x0B, 0x20, 
-	0x40, 0x08, 0x00, 0x94, 0x01, 0xCB, 0xCA, 0x00, 0x00, 0x00, 0x00, 0x0D, 0xB8, 0x08, 0x00, 0x00, 
-	0x40, 0x08, 0x00, 0x00, 0x60, 0x00, 0x10, 0xAF, 0x2B, 0x6C, 0x02, 0x80, 0x00, 0x64, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x80, 0x10, 0x00, 0x18, 0x08, 0x6F, 0x44, 0x00, 0x40, 0x42, 0x07, 0x16, 0xEA, 
-	0x00, 0x03, 0x00, 0x00, 0x00, 0x80, 0x00, 0xD0, 0x00, 0x00, 0x01, 0x81, 0x04, 0x01, 0x00, 0x03, 
-	0x9A, 0x06, 0x7C, 0xD8, 0x0C, 0x00, 0x04, 0x00, 0x1A, 0x10, 0x40, 0x00, 0x08, 0x02, 0x80, 0x00, 
-	0x00, 0xD7, 0x38, 0x88, 0x0A, 0x00, 0x14, 0x79, 0xD0, 0xF5, 0x00, 0xB0, 0x00, 0xF0, 0x0F, 0x00, 
-	0x02, 0x00, 0x00, 0x00, 0x00, 0x00, 0x20, 0x18, 0x00, 0xF8, 0x00, 0x63, 0xCC, 0x00, 0xE0, 0x00, 
-	0x00, 0x00, 0x00, 0x02, 0x00, 0x00, 0x82, 0x00, 0x00, 0x50, 0x80, 0x00, 0x00, 0x00, 0x00, 0x02, 
-	0x00, 0x1E, 0xEA, 0x30, 0x00, 0x00, 0x07, 0x1F, 0x00, 0x00, 0x00, 0x00, 0x47, 0x96, 0x00, 0x04, 
-	0x00, 0x10, 0x00, 0x0E, 0x38, 0x49, 0x10, 0x00, 0x00, 0x94, 0x00, 0x00, 0x00, 0x00, 0x00, 0x08, 
-	0x00, 0x80, 0x00, 0x0B, 0x00, 0x00, 0x00, 0x02, 0x00, 0x14, 0x00, 0x0A, 0xA3, 0x20, 0x00, 0x00, 
-	0x09, 0xF1, 0x00, 0x02, 0x00, 0x02, 0x00, 0x20, 0x04, 0x00, 0x08, 0x80, 0x50, 0xB0, 0xB8, 0x90, 
-	0x00, 0x20, 0x15, 0x62, 0xC0, 0x00, 0x00, 0x00, 0x00, 0x00, 0x04, 0x00, 0x58, 0x00, 0x32, 0x81, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x08, 0x14, 0x10, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x30, 0x60, 
-	0x00, 0x10, 0x24, 0x00, 0x31, 0x80, 0x00, 0xFA, 0xE9, 0x00, 0x00, 0x00, 0x04, 0x00, 0xC0, 0x00, 
-	0x40, 0x00, 0x00, 0x20, 0x80, 0x00, 0x80, 0x50, 0x14, 0x00, 0x02, 0x00, 0x00, 0x22, 0xC9, 0x42, 
-	0x20, 0x00, 0x02, 0x90, 0xE3, 0x00, 0x02, 0x0A, 0x02, 0x00, 0x0E, 0x00, 0x00, 0x0A, 0x80, 0x00, 
-	0x0D, 0x36, 0x00, 0x00, 0x20, 0x40, 0x02, 0x00, 0x00, 0x40, 0x80, 0x00, 0x00, 0x00, 0x00, 0x80, 
-	0x15, 0x82, 0x05, 0x00, 0x00, 0x00, 0x06, 0x06, 0xFA, 0x30, 0x00, 0x00, 0x00, 0x00, 0x78, 0x00, 
-	0x00, 0x02, 0x63, 0x80, 0x10, 0x24, 0x00, 0x00, 0x00, 0x0A, 0x98, 0x29, 0x50, 0x00, 0x00, 0x00, 
-	0x03, 0x59, 0x69, 0x00, 0x00, 0x00, 0x00, 0x80, 0x0B, 0x08, 0x03, 0x20, 0x40, 0x02, 0x00, 0x00, 
-	0x00, 0x09, 0xA3, 0x00, 0x40, 0x00, 0x70, 0x05, 0x00, 0x02, 0x00, 0x04, 0x00, 0x0D, 0x00, 0x00, 
-	0x08, 0x00, 0x01, 0x8D, 0x83, 0xFC, 0x01, 0x20, 0x00, 0x00, 0x04, 0xB5, 0xA0, 0x00, 0x00, 0x00, 
-	0x04, 0x00, 0x80, 0x07, 0x32, 0x81, 0x00, 0x00, 0xC2, 0x40, 0x41, 0xCB, 0x10, 0x00, 0x08, 0x00, 
-	0x0E, 0x00, 0x00, 0x00, 0x14, 0x00, 0x1F, 0x90, 0x50, 0x00, 0x00, 0x00, 0x00, 0xBF, 0x80, 0x40, 
-	0x00, 0x00, 0x00, 0x70, 0x00, 0x02, 0x40, 0x00, 0x00, 0x00, 0x80, 0x01, 0x00, 0x00, 0x28, 0x00, 
-	0x02, 0x00, 0x04, 0x30, 0x5E, 0x72, 0x00, 0x81, 0x00, 0x91, 0x0B, 0x00, 0x02, 0x40, 0x00, 0x02, 
-	0x7A, 0x06, 0x00, 0x08, 0x00, 0x00, 0x0B, 0xAC, 0x1C, 0x80, 0x20, 0xE0, 0x00, 0x00, 0xD0, 0x02, 
-	0x00, 0x00, 0x00, 0x30, 0x00, 0x00, 0x00, 0x06, 0x05, 0x00, 0xC0, 0x01, 0xC0, 0x04, 0x08, 0x14, 
-	0x01, 0x00, 0x03, 0x8E, 0x80, 0x00, 0x40, 0x01, 0x40, 0x2F, 0xB2, 0x40, 0x00, 0x00, 0x05, 0x01, 
-	0x00, 0x00, 0x00, 0x04, 0x00, 0x80, 0x01, 0x78, 0x55, 0x00, 0x00, 0x00, 0x00, 0x80, 0x00, 0x00, 
-	0x32, 0x10, 0x82, 0x02, 0x00, 0x00, 0x00, 0x2E, 0x81, 0x01, 0x30, 0x18, 0x98, 0x07, 0x00, 0x02, 
-	0x00, 0x02, 0x20, 0xC9, 0x14, 0x00, 0x08, 0x00, 0x18, 0x90, 0x00, 0x00, 0x00, 0x20, 0x14, 0x40, 
-	0x00, 0x05, 0x50, 0x00, 0x40, 0x80, 0x10, 0x00, 0x80, 0x17, 0x82, 0x95, 0x00, 0xC0, 0x40, 0x00, 
-	0x0C, 0x00, 0x06, 0x01, 0x11, 0x41, 0x08, 0x00, 0x00, 0xC0, 0x01, 0xC0, 0x40, 0xC1, 0x04, 0x01, 
-	0x01, 0x00, 0x0A, 0x10, 0x00, 0x10, 0x0C, 0x00, 0x80, 0x04, 0x00, 0x02, 0x40, 0x00, 0x08, 0x20, 
-	0x80, 0x01, 0x08, 0x78, 0x00, 0x00, 0x02, 0x00, 0x34, 0x00, 0x00, 0x04, 0x00, 0x0A, 0x83, 0x01, 
-	0xFF, 0x24, 0x02, 0x00, 0x14, 0x38, 0x10, 0x00, 0x00, 0x0A, 0x00, 0x00, 0x00, 0x80, 0x10, 0x00, 
-	0x20, 0x04, 0x02, 0x40, 0x90, 0x00, 0x00, 0x00, 0x80, 0x08, 0x00, 0x00, 0x08, 0x72, 0x81, 0x00, 
-	0xE0, 0x01, 0x62, 0x80, 0x00, 0x00, 0x00, 0x81, 0x80, 0x01, 0x58, 0x00, 0xE0, 0x02, 0x00, 0x00, 
-	0x00, 0x00, 0x02, 0x83, 0x80, 0x00, 0x00, 0x00, 0x00, 0x02, 0x00, 0x20, 0x00, 0xC0, 0x00, 0x40, 
-	0x08, 0x0B, 0x82, 0x00, 0x00, 0x00, 0xF0, 0x14, 0x00, 0x08, 0x00, 0x00, 0x40, 0x00, 0x00, 0x00, 
-	0x20, 0x00, 0x70, 0xA9, 0x30, 0x08, 0x00, 0x1C, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x80, 0x00, 0x40, 0x02, 0x00, 0x40, 0x00, 0x44, 0x80, 0x10, 0x00, 0x18, 0x07, 
-	0x82, 0x05, 0x00, 0xC2, 0x02, 0x02, 0xC0, 0x00, 0x00, 0x01, 0x00, 0x58, 0x0E, 0x80, 0x00, 0xC0, 
-	0x01, 0x60, 0x00, 0x00, 0x24, 0x00, 0x00, 0x00, 0x08, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x02, 0x48, 0x00, 0xC8, 0x02, 0x80, 0x00, 0x00, 0x0A, 0xA0, 0x40, 0x02, 0x40, 0x55, 0x74, 
-	0x00, 0x00, 0x00, 0x39, 0x20, 0xF0, 0x0F, 0x00, 0x02, 0x00, 0x00, 0x00, 0x09, 0x00, 0x00, 0x08, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x20, 0x00, 0x00, 0x00, 0xC0, 0x00, 0x00, 0x00, 0x83, 0x00, 
-	0x00, 0x50, 0x0D, 0x82, 0x95, 0x00, 0x00, 0x00, 0x00, 0x64, 0x1E, 0x70, 0x00, 0x00, 0x07, 0x1C, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x20, 0x00, 0x04, 0x80, 0x00, 0x00, 0x19, 0xDB, 0x00, 0x00, 0x10, 
-	0x00, 0x06, 0x00, 0x1E, 0x10, 0x48, 0x00, 0x08, 0x00, 0x80, 0x00, 0x00, 0xF0, 0x00, 0x00, 0x02, 
-	0x00, 0x04, 0x31, 0x48, 0x81, 0x00, 0x48, 0x00, 0x00, 0x0B, 0x00, 0x02, 0x00, 0x00, 0x00, 0xC0, 
-	0x08, 0x00, 0x08, 0x00, 0x00, 0xC3, 0x81, 0x40, 0x45, 0x20, 0x00, 0x20, 0x01, 0x00, 0x00, 0x80, 
-	0x00, 0x00, 0x00, 0x00, 0xF0, 0x07, 0xF2, 0x81, 0x00, 0x00, 0x01, 0x40, 0x15, 0xCB, 0x10, 0x00, 
-	0x10, 0x07, 0x0E, 0x80, 0x00, 0x00, 0x00, 0x07, 0x44, 0xEA, 0x10, 0x00, 0x00, 0x09, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x40, 0x06, 0x06, 0x00, 0x00, 0x40, 0x00, 0x00, 0x20, 0x80, 0x03, 0x80, 0x08, 
-	0x28, 0x00, 0x02, 0x00, 0x00, 0x00, 0x2E, 0xB1, 0x20, 0x0A, 0x90, 0x08, 0x0D, 0x00, 0x02, 0x00, 
-	0x00, 0x20, 0x4D, 0x01, 0x00, 0x08, 0x29, 0x10, 0x00, 0x00, 0x00, 0x00, 0x28, 0x10, 0x42, 0x94, 
-	0x00, 0x80, 0x00, 0x6C, 0x68, 0x00, 0x00, 0xB8, 0x01, 0x06, 0x05, 0x00, 0x00, 0x00, 0x60, 0x61, 
-	0xDD, 0x10, 0x00, 0x02, 0x00, 0x00, 0x18, 0x00, 0x00, 0x01, 0x40, 0x1D, 0x82, 0x00, 0x00, 0x00, 
-	0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x02, 0x00, 0x00, 0x40, 0x01, 0x80, 0x00, 0x80, 
-	0x01, 0x80, 0x03, 0xE0, 0x40, 0x02, 0x00, 0x02, 0x25, 0x59, 0xE2, 0x20, 0x08, 0x00, 0x90, 0x05, 
-	0x80, 0x02, 0x00, 0x02, 0x01, 0xC8, 0x34, 0x00, 0x08, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x20, 
-	0x00, 0x00, 0x3C, 0x00, 0x80, 0x80, 0x00, 0x04, 0x00, 0x00, 0x70, 0x07, 0x82, 0x05, 0x00, 0x00, 
-	0x00, 0xC0, 0x15, 0xBC, 0x50, 0x00, 0x00, 0x20, 0x1C, 0x80, 0x00, 0x00, 0x01, 0xC0, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x50, 0x00, 0xB6, 0xA8, 0x40, 0x00, 0x08, 0x00, 0x00, 0x0C, 0x10, 0x40, 0x08, 
-	0x02, 0x80, 0x80, 0x00, 0x00, 0x0A, 0x60, 0x40, 0x02, 0x00, 0x40, 0x00, 0x0E, 0xC5, 0x00, 0x08, 
-	0x28, 0x01, 0x03, 0x00, 0x02, 0x80, 0x06, 0x00, 0x00, 0x00, 0x00, 0x08, 0x03, 0x00, 0x07, 0x6C, 
-	0x80, 0x00, 0x20, 0x00, 0x00, 0x00, 0x00, 0x00, 0x08, 0x40, 0x00, 0x30, 0x00, 0x00, 0x03, 0x72, 
-	0xC4, 0x00, 0x40, 0x01, 0x40, 0x34, 0x1A, 0x50, 0x01, 0x00, 0x00, 0x0A, 0x00, 0x00, 0x40, 0x00, 
-	0x00, 0x14, 0x00, 0x04, 0x01, 0x00, 0x01, 0x00, 0x03, 0x04, 0x10, 0x00, 0x00, 0x00, 0x28, 0x18, 
-	0x10, 0x40, 0x00, 0x00, 0x00, 0x80, 0x00, 0x0D, 0x03, 0x2C, 0x42, 0x02, 0x00, 0x02, 0x03, 0x6A, 
-	0x99, 0x00, 0x98, 0x00, 0x00, 0x01, 0x00, 0x02, 0x00, 0x00, 0x00, 0x00, 0x04, 0x00, 0x08, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x20, 0x00, 0x02, 0x80, 0x00, 0x00, 0x08, 0x00, 0x00, 0x00, 0x00, 
-	0x01, 0x88, 0x7F, 0x44, 0x00, 0x00, 0x00, 0x06, 0x01, 0x9C, 0x04, 0x00, 0x2C, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x02, 0x02, 0x80, 0x03, 0xC6, 0x82, 0x00, 0x00, 0x1A, 0x9E, 0xCD, 0x00, 0x08, 0x80, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x0E, 0x52, 0xF8, 0x84, 0x00, 0x00, 
-	0x00, 0x38, 0x0A, 0xC0, 0x00, 0x80, 0x00, 0x00, 0xF9, 0x38, 0x00, 0x00, 0x04, 0x40, 0x08, 0x3C, 
-	0x28, 0x40, 0x00, 0x00, 0x01, 0x2C, 0x40, 0x00, 0x00, 0x01, 0x40, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x08, 0x00, 0x00, 0x05, 0x6F, 0x14, 0x00, 0x20, 0x00, 0xE6, 0x20, 0x08, 0x14, 0x82, 0x84, 
-	0x07, 0x00, 0xD0, 0x00, 0xA0, 0x02, 0x00, 0x00, 0x00, 0x00, 0x03, 0x88, 0x0B, 0x80, 0x07, 0x3D, 
-	0x50, 0x42, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x02, 0x00, 0x00, 0x00, 0x03, 0x71, 
-	0x40, 0x18, 0x00, 0x02, 0x00, 0x49, 0x42, 0x00, 0x00, 0x00, 0xF0, 0xFF, 0xB8, 0x00, 0x00, 0x0C, 
-	0x00, 0x00, 0x00, 0x00, 0x21, 0x30, 0xB0, 0x07, 0x43, 0xE8, 0x00, 0x80, 0xA0, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x11, 0x00, 0x50, 0x00, 0x77, 0x01, 0x01, 0x40, 0x00, 0x60, 0x46, 0x08, 
-	0x14, 0x03, 0x00, 0x00, 0x1E, 0x80, 0x00, 0xC0, 0x00, 0x06, 0x00, 0x00, 0x20, 0x03, 0x00, 0x00, 
-	0x1D, 0x30, 0x3F, 0xC8, 0x20, 0x0E, 0x20, 0x00, 0x00, 0x02, 0x48, 0x00, 0x00, 0x01, 0x08, 0x0D, 
-	0x0A, 0x03, 0x70, 0x00, 0x04, 0x00, 0x00, 0x28, 0x0D, 0x81, 0x00, 0x10, 0x20, 0x01, 0x0D, 0x00, 
-	0x04, 0x00, 0x14, 0x40, 0x0B, 0x00, 0x00, 0x30, 0x00, 0x01, 0xBB, 0x81, 0x68, 0x01, 0x00, 0x06, 
-	0x40, 0x00, 0x80, 0x00, 0x00, 0x00, 0x02, 0x00, 0x00, 0x10, 0xA8, 0x06, 0x05, 0x00, 0x00, 0x01, 
-	0x63, 0xE0, 0x18, 0x14, 0x00, 0x00, 0x00, 0x0E, 0x80, 0x00, 0x0A, 0x02, 0x40, 0x07, 0xB0, 0x20, 
-	0x00, 0x00, 0x00, 0x1C, 0x00, 0x79, 0xD0, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x10, 0xB3, 0x10, 0x80, 0x00, 0x00, 0x00, 0x20, 0x49, 0x42, 0x00, 0x00, 0x00, 
-	0x00, 0x03, 0x00, 0x00, 0x4E, 0x3C, 0x01, 0x4A, 0x52, 0x00, 0x00, 0x00, 0x90, 0x09, 0x3B, 0x6C, 
-	0x02, 0x10, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x0D, 0x22, 0x80, 
-	0x01, 0x04, 0x00, 0x00, 0x01, 0x8A, 0x04, 0x00, 0x08, 0x30, 0x01, 0x80, 0x00, 0x00, 0x00, 0x00, 
-	0x5E, 0x00, 0x04, 0x08, 0x00, 0x00, 0x1E, 0x00, 0x00, 0x00, 0x00, 0x01, 0x20, 0x00, 0x00, 0x00, 
-	0x40, 0x00, 0x00, 0x20, 0x00, 0x00, 0x00, 0x5C, 0x3D, 0x40, 0x00, 0x00, 0x00, 0x21, 0x40, 0x50, 
-	0x08, 0x01, 0x07, 0x00, 0xA3, 0x00, 0x00, 0x00, 0x00, 0x28, 0x20, 0x04, 0x29, 0x80, 0x00, 0x00, 
-	0x80, 0x00, 0x00, 0x00, 0x00, 0x01, 0x40, 0x0C, 0x00, 0x80, 0x08, 0x00, 0x00, 0x00, 0x00, 0x11, 
-	0x95, 0x86, 0x05, 0x00, 0x00, 0x00, 0x00, 0x20, 0xFD, 0x10, 0x00, 0x00, 0x0D, 0x80, 0xF0, 0x00, 
-	0x00, 0x04, 0x00, 0x1E, 0x00, 0x04, 0x08, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x48, 0x0B, 0x20, 0x40, 0x00, 0x00, 0x00, 
-	0x03, 0xDB, 0xE2, 0x20, 0x00, 0x00, 0x50, 0x01, 0x80, 0x00, 0x00, 0x80, 0x00, 0x00, 0x04, 0x29, 
-	0x00, 0x00, 0x00, 0x80, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x01, 0x72, 0x81, 0x00, 0x00, 0x00, 0x06, 0x26, 0x0A, 0x54, 0x00, 0x18, 0x09, 
-	0x0E, 0x80, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x08, 0x1E, 0xD6, 0x21, 0x40, 
-	0x00, 0x08, 0x00, 0x01, 0x40, 0x00, 0x40, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x08, 0x28, 0x02, 
-	0x00, 0x00, 0x00, 0x43, 0x40, 0x00, 0x00, 0x00, 0x00, 0x51, 0x09, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x10, 0x0D, 0xAD, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x40, 
-	0x80, 0x00, 0x00, 0x30, 0x00, 0x80, 0x08, 0x02, 0x05, 0x00, 0xC0, 0x00, 0x00, 0x60, 0x08, 0x14, 
-	0x01, 0x00, 0x50, 0x00, 0x80, 0x00, 0x40, 0x01, 0x40, 0x00, 0x00, 0x20, 0x00, 0x00, 0x08, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x02, 0x00, 0x03, 0x00, 
-	0x32, 0x90, 0x80, 0x08, 0x00, 0x00, 0x2C, 0x4B, 0x42, 0x00, 0x10, 0x02, 0x10, 0x87, 0x00, 0x00, 
-	0x00, 0x00, 0x28, 0x09, 0x00, 0x00, 0x00, 0x00, 0x90, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x10, 0x00, 0x00, 0x00, 0x00, 0x07, 0xEA, 0x81, 0x20, 0x82, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x51, 0x01, 0x00, 0x00, 0x00, 0x04, 0x07, 0xA0, 0x99, 0x00, 0x80, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x20, 0x00, 0x00, 0x00, 0x00, 0x00, 0x02, 0x40, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x08, 0x28, 0x00, 0x00, 0x40, 0x00, 0x00, 0x00, 0x00, 0x00, 0x02, 0x10, 0x08, 
-	0xCF, 0x38, 0x00, 0x0A, 0x80, 0x02, 0x5B, 0x60, 0x00, 0x00, 0x30, 0x00, 0x00, 0x30, 0x00, 0x08, 
-	0x00, 0x00, 0x00, 0x00, 0xB0, 0x03, 0x94, 0x00, 0x00, 0x08, 0x00, 0x80, 0x08, 0x02, 0x05, 0x00, 
-	0xE0, 0x00, 0x00, 0x0C, 0xAA, 0x52, 0x80, 0x80, 0x50, 0x01, 0xD8, 0x40, 0x28, 0x15, 0x46, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x3B, 0x0C, 0xE0, 0x0A, 0x00, 0x20, 0x00, 0x1A, 0x10, 0x60, 
-	0x40, 0x00, 0x02, 0x00, 0x07, 0x00, 0xF3, 0x90, 0x80, 0x08, 0x00, 0x00, 0x01, 0xE0, 0xA0, 0x29, 
-	0xA0, 0x02, 0x00, 0xC7, 0xB4, 0x18, 0x00, 0x94, 0x2C, 0x00, 0x00, 0x00, 0x00, 0x38, 0x00, 0x00, 
-	0x83, 0x30, 0x04, 0x00, 0x01, 0x40, 0x01, 0x00, 0x02, 0x18, 0x00, 0x00, 0x30, 0x00, 0x18, 0x00, 
-	0x00, 0x00, 0x00, 0xC0, 0x01, 0xE3, 0xA0, 0x00, 0x04, 0x01, 0x00, 0x00, 0x1E, 0x00, 0x00, 0xC0, 
-	0x00, 0x02, 0x95, 0x90, 0x60, 0x00, 0x00, 0x00, 0x00, 0x02, 0x0C, 0xE0, 0x0C, 0x00, 0x16, 0x6C, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0x00, 0x0D, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x69, 
-	0xC0, 0x08, 0x00, 0x90, 0x20, 0xF0, 0x0D, 0x00, 0x0C, 0x08, 0x00, 0x78, 0x28, 0x06, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x3F, 0x30, 0x00, 0x40, 0x00, 0x02, 0x80, 0x00, 0x00, 0x00, 0x00, 0x00, 0x02, 
-	0x00, 0x80, 0x10, 0x60, 0x3C, 0x00, 0x04, 0x00, 0xE0, 0x17, 0xFE, 0x40, 0x00, 0x02, 0x00, 0x1C, 
-	0x00, 0x00, 0x00, 0x00, 0x02, 0x80, 0x10, 0x26, 0x80, 0x00, 0x00, 0x00, 0x02, 0x0C, 0xE0, 0x01, 
-	0x00, 0x00, 0x68, 0x00, 0x00, 0x40, 0x40, 0x00, 0x00, 0x10, 0x01, 0x08, 0x00, 0x03, 0xC8, 0x10, 
-	0xA0, 0x04, 0x00, 0x1A, 0xE4, 0x20, 0x00, 0x00, 0x01, 0x05, 0x00, 0x00, 0x00, 0x34, 0x40, 0x0A, 
-	0x00, 0x30, 0x00, 0x00, 0x00, 0x00, 0x3B, 0x30, 0x00, 0x1A, 0x00, 0x00, 0x34, 0x00, 0x82, 0x9C, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x07, 0xEA, 0x81, 0x00, 0x00, 0x01, 0x40, 0x0E, 0x00, 0x04, 0x04, 
-	0x10, 0x07, 0x00, 0x80, 0x00, 0x00, 0x02, 0x00, 0x00, 0x00, 0x25, 0x14, 0x00, 0x0D, 0x80, 0x02, 
-	0x4C, 0xE0, 0x00, 0x00, 0x00, 0x04, 0x01, 0x02, 0x60, 0x40, 0x00, 0x00, 0x02, 0x00, 0x09, 0x0C, 
-	0x28, 0x00, 0x00, 0x02, 0x00, 0x24, 0x00, 0x04, 0x00, 0x00, 0x22, 0x00, 0x0F, 0x00, 0x00, 0x02, 
-	0x0C, 0x00, 0x0B, 0x00, 0x08, 0x80, 0x00, 0x90, 0x00, 0x33, 0x30, 0x00, 0x00, 0x00, 0x02, 0x40, 
-	0x80, 0x03, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x0B, 0x83, 0x9C, 0x00, 0x00, 0x01, 0x60, 0x14, 
-	0x00, 0x06, 0x00, 0x00, 0x00, 0x1B, 0x18, 0x00, 0x0A, 0x14, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x08, 0x01, 0x7A, 0x0C, 0xE0, 0x40, 0x00, 0x00, 0x00, 0x00, 0x00, 0x60, 0x00, 0x00, 0x00, 0x08, 
-	0x0F, 0x00, 0x52, 0x90, 0x80, 0x10, 0x00, 0x00, 0x00, 0x20, 0x04, 0x00, 0x00, 0x00, 0x00, 0xA3, 
-	0x80, 0x00, 0x40, 0x80, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x50, 0xA0, 0x03, 0x30, 0x00, 0x00, 
-	0x00, 0x00, 0x1C, 0x00, 0x83, 0x14, 0x00, 0x00, 0x00, 0x00, 0x00, 0x07, 0x86, 0x05, 0x00, 0x04, 
-	0x0B, 0x40, 0x0C, 0x00, 0x04, 0x00, 0x00, 0x53, 0x9C, 0x80, 0x00, 0x0A, 0x4C, 0x07, 0x80, 0x00, 
-	0x25, 0x00, 0x00, 0x28, 0x1A, 0x7A, 0x0C, 0xE0, 0x40, 0x40, 0x00, 0x00, 0x00, 0x02, 0x61, 0x00, 
-	0x80, 0x00, 0x00, 0x09, 0x00, 0x0B, 0xE0, 0x40, 0x00, 0x00, 0x2E, 0x00, 0x00, 0x04, 0x20, 0x01, 
-	0x08, 0x09, 0x0B, 0x00, 0x00, 0x00, 0x80, 0x00, 0x0C, 0x00, 0x29, 0x00, 0x04, 0x50, 0x00, 0x03, 
-	0x30, 0x00, 0x08, 0x03, 0x40, 0x00, 0xA0, 0x01, 0x8C, 0x00, 0x00, 0x30, 0x00, 0x01, 0xD5, 0x06, 
-	0x05, 0x00, 0x40, 0x01, 0x42, 0x20, 0xED, 0x11, 0x03, 0x20, 0x59, 0x1C, 0x00, 0x00, 0x42, 0x08, 
-	0x00, 0x20, 0x05, 0xA4, 0x04, 0x00, 0x09, 0x80, 0x02, 0x0C, 0xE0, 0x04, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x02, 0x00, 0x00, 0x1E, 0x03, 0xE0, 0x40, 0x00, 0x00, 0x00, 0x01, 0x4B, 
-	0xE2, 0x00, 0x31, 0x02, 0x50, 0x01, 0x00, 0x00, 0x40, 0x40, 0x02, 0x40, 0xA5, 0x29, 0x00, 0x00, 
-	0x98, 0x00, 0x33, 0x30, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x05, 0x82, 0x05, 0x20, 0x80, 0xC0, 0x00, 0x00, 0x00, 0x24, 0x00, 0x04, 0x00, 0x1E, 0x00, 
-	0x00, 0x00, 0x01, 0xE2, 0x86, 0x00, 0x08, 0x00, 0x00, 0x03, 0x9B, 0x02, 0x4C, 0xE2, 0x00, 0x20, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x0B, 0xA0, 0x40, 0x00, 0x00, 
-	0x00, 0x20, 0x0E, 0x00, 0x00, 0x40, 0x00, 0x00, 0x05, 0x2C, 0x00, 0x00, 0x02, 0x00, 0x20, 0x00, 
-	0x02, 0x00, 0x18, 0x00, 0xF0, 0x2B, 0x30, 0x14, 0x00, 0x00, 0x02, 0xC0, 0x00, 0x00, 0x00, 0x04, 
-	0x00, 0x08, 0x00, 0x00, 0x07, 0x02, 0x95, 0x00, 0xE0, 0x00, 0x00, 0x00, 0x00, 0x00, 0x02, 0x84, 
-	0x08, 0x01, 0x18, 0x00, 0x00, 0x00, 0x02, 0x80, 0x00, 0x08, 0x02, 0xA1, 0x95, 0x0A, 0x02, 0x4C, 
-	0xC0, 0x0A, 0x00, 0x00, 0x00, 0x0E, 0x33, 0x20, 0x00, 0x00, 0x02, 0x00, 0x00, 0x0A, 0xD0, 0x00, 
-	0x00, 0x08, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x70, 0xF5, 0xB4, 0x00, 0x00, 0x00, 
-	0x00, 0x08, 0x00, 0x00, 0x00, 0x3A, 0xF0, 0xA0, 0x33, 0x30, 0x84, 0x00, 0x00, 0x00, 0x00, 0xF3, 
-	0x30, 0x80, 0x30, 0x00, 0x10, 0x00, 0x50, 0x00, 0x6A, 0x81, 0x20, 0xC0, 0x14, 0x00, 0x00, 0x00, 
-	0x24, 0x83, 0x01, 0x0F, 0x9E, 0x80, 0x00, 0x00, 0x00, 0x07, 0x80, 0x83, 0x3A, 0x0D, 0x00, 0x08, 
-	0x0B, 0x06, 0x15, 0x40, 0x04, 0x00, 0x00, 0x2E, 0x00, 0xE7, 0x00, 0x02, 0x00, 0x02, 0x00, 0x00, 
-	0x08, 0x70, 0x14, 0x00, 0x00, 0x00, 0x00, 0x00, 0x0D, 0x00, 0x00, 0x30, 0x00, 0xF9, 0x8B, 0x00, 
-	0x00, 0x02, 0x00, 0x40, 0x0B, 0xCC, 0x00, 0x10, 0x00, 0x91, 0xA3, 0x42, 0xA8, 0x01, 0xC0, 0xE0, 
-	0x06, 0x14, 0xCD, 0xB2, 0x08, 0x00, 0x62, 0x00, 0x00, 0x80, 0xF9, 0xEA, 0x94, 0x80, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x28, 0x03, 0x80, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x93, 0x38, 
-	0x00, 0x10, 0x09, 0x80, 0x06, 0x04, 0x1A, 0x00, 0x02, 0x86, 0x02, 0x01, 0x66, 0x00, 0x00, 0x04, 
-	0x00, 0x00, 0x01, 0x08, 0xDC, 0x2A, 0x80, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0x00, 
-	0x08, 0x0D, 0x00, 0x00, 0x00, 0x14, 0x00, 0x0A, 0xCC, 0x09, 0x40, 0x00, 0x98, 0x00, 0x00, 0x01, 
-	0x82, 0x00, 0x00, 0x00, 0x1C, 0xC9, 0x90, 0x90, 0x00, 0x00, 0x00, 0x00, 0x01, 0xE3, 0x02, 0x05, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x38, 0x03, 0x9C, 0x00, 0x00, 0x04, 0x18, 0x00, 
-	0x04, 0x83, 0x38, 0x00, 0x00, 0x08, 0x01, 0x52, 0x45, 0x00, 0x40, 0x00, 0x80, 0x01, 0xC0, 0x00, 
-	0x01, 0x00, 0x00, 0x20, 0x00, 0x00, 0x10, 0x0B, 0xA0, 0x40, 0x00, 0x00, 0x00, 0x24, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x91, 0x03, 0x00, 0x00, 0xAB, 0x40, 0x00, 0x20, 0xCC, 0x01, 0x00, 0x00, 0x10, 
-	0x90, 0xF8, 0x50, 0x00, 0x00, 0x14, 0x40, 0x3E, 0x0F, 0xF0, 0x00, 0x00, 0x00, 0x00, 0x00, 0x38, 
-	0x05, 0xAF, 0x88, 0x80, 0x04, 0x95, 0x40, 0x00, 0x81, 0x04, 0x00, 0x00, 0x50, 0x00, 0x18, 0x00, 
-	0x00, 0x00, 0x00, 0x0E, 0x83, 0x3A, 0x00, 0x08, 0x03, 0x80, 0x18, 0x59, 0x80, 0x40, 0x08, 0x06, 
-	0x28, 0x40, 0x00, 0x40, 0x00, 0x00, 0x00, 0x03, 0x80, 0x80, 0x0A, 0xB8, 0x80, 0x00, 0x20, 0x80, 
-	0x00, 0x10, 0x00, 0x20, 0x00, 0x0A, 0x00, 0xE9, 0x00, 0x00, 0x00, 0x00, 0x20, 0x20, 0xCC, 0x00, 
-	0x01, 0x00, 0x08, 0x00, 0xA5, 0x98, 0x01, 0x08, 0x03, 0x64, 0x02, 0x00, 0x40, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x30, 0x03, 0x82, 0x05, 0x00, 0x00, 0x09, 0x40, 0x01, 0xC1, 0x04, 0x00, 0x00, 0x00, 
-	0x0E, 0x80, 0x00, 0x00, 0x00, 0x00, 0x1E, 0x83, 0x38, 0x00, 0x10, 0x00, 0x00, 0x5A, 0x83, 0x00, 
-	0x10, 0x00, 0x06, 0x66, 0xEA, 0xF0, 0x20, 0x00, 0x00, 0x00, 0x00, 0x00, 0x80, 0x03, 0xA0, 0x40, 
-	0x00, 0x01, 0x00, 0x00, 0x00, 0x00, 0x08, 0x00, 0x00, 0x01, 0x07, 0x00, 0x00, 0x00, 0x04, 0x00, 
-	0x20, 0xCC, 0x00, 0x80, 0x80, 0x00, 0x0D, 0x34, 0xF0, 0x00, 0x00, 0x00, 0x26, 0x5F, 0x0F, 0xA2, 
-	0x00, 0x00, 0x00, 0x30, 0x00, 0x00, 0x00, 0x04, 0xF0, 0x00, 0x40, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x01, 0x20, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x83, 0x38, 0x01, 0x00, 0x01, 0x00, 
-	0x98, 0x30, 0xC0, 0x0C, 0xA0, 0x34, 0x00, 0x0F, 0x33, 0x00, 0x00, 0x00, 0x00, 0x00, 0x09, 0x00, 
-	0x03, 0x8F, 0x00, 0x00, 0x0A, 0x00, 0x00, 0x00, 0x00, 0x00, 0x31, 0x00, 0x08, 0x03, 0x00, 0x00, 
-	0x00, 0x80, 0x20, 0x0E, 0xCC, 0x00, 0x80, 0x00, 0x08, 0x01, 0xA0, 0xF0, 0x00, 0x40, 0x02, 0x60, 
-	0x01, 0xE3, 0x30, 0x10, 0x00, 0x00, 0x11, 0x01, 0x01, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x08, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x04, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x08, 0x00, 0x00, 0x00, 0x20, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x07, 0x00, 0x03, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x04, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x10, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x40, 0x00, 0x00, 0x00, 0x08, 0x10, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x40, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x05, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x04, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x10, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xC0, 0x00, 0x00, 0x00, 0x00, 0x30, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x40, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x10, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x80, 0x00, 0x00, 0x02, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x04, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x40, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x04, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x10, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x08, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x80, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x80, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x06, 0x00, 0x00, 0x00, 0x00, 0x18, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x02, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x20, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x40, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x3C, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x03, 0x40, 0xA5, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x20, 0x05, 0xA0, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x03, 
-	0x00, 0x21, 0x21, 0x00, 0x00, 0x02, 0x7E, 0x9C, 0x30, 0x80, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0x00, 0x00, 0x18, 0x80, 0x00, 0x10, 0x00, 0x00, 0x00, 0x07, 
-	0x7A, 0xE2, 0x40, 0x80, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x40, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x18, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x03, 0xC0, 0x00, 0x00, 0x00, 0x00, 0x00, 0x3C, 0xAD, 0xB0, 0x80, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x04, 0x40, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0x80, 0x77, 
-	0x81, 0x40, 0x00, 0x00, 0x00, 0x02, 0x00, 0xE7, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x06, 0x80, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x80, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x09, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x2C, 0xB1, 0x50, 0x00, 0x00, 0x00, 0x00, 
-	0x01, 0x80, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0x90, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x0F, 0xBB, 0x14, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x0D, 0x42, 0x80, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x04, 0x00, 0x00, 0x00, 0x00, 0x04, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x02, 0x94, 0x00, 0x00, 0x00, 0x04, 0x68, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x30, 
-	0x41, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x10, 0x00, 0x00, 0xD0, 0x00, 
-	0x00, 0x00, 0x80, 0x01, 0x40, 0x00, 0x00, 0x00, 0x00, 0x00, 0x20, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x0C, 0x00, 0x00, 0x40, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x03, 0x00, 0x00, 0x09, 0x00, 0x00, 0x00, 0x04, 0x00, 0x20, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x40, 0x00, 0x03, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x20, 0x00, 
-	0x00, 0x03, 0x33, 0x9D, 0x40, 0x80, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x08, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x80, 0x00, 0x00, 0x00, 0x76, 0xD2, 0x52, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x28, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x20, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x0D, 0x7C, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x04, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x04, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x32, 0xC4, 
-	0x04, 0x00, 0x00, 0x00, 0x70, 0x00, 0x00, 0x00, 0x00, 0x18, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x30, 0x41, 0x24, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x10, 0x00, 0x40, 0x3C, 0x00, 0x00, 0x00, 0x00, 0x00, 0xE0, 
-	0x04, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x22, 0x00, 0x00, 0x40, 0x00, 0x00, 0x01, 
-	0x00, 0x08, 0x01, 0x02, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0x00, 0x08, 
-	0x00, 0x02, 0x83, 0xC0, 0x04, 0x00, 0x00, 0x00, 0x00, 0x02, 0x40, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x04, 0x00, 0x96, 0x01, 0xE0, 0x00, 0x40, 0x00, 0x00, 0x80, 0x03, 0x80, 0x01, 0x00, 0x40, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x8D, 0x78, 0x00, 0x00, 0x00, 0x02, 
-	0x42, 0x40, 0x9B, 0xD4, 0x80, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x08, 0x01, 0x00, 0x00, 0x00, 0x00, 0x20, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x01, 0x81, 0x13, 0xA0, 0x04, 0x00, 0x04, 0x20, 0x05, 0xC1, 0xBD, 0x41, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x30, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x05, 0x80, 0x01, 
-	0x00, 0x00, 0x00, 0x02, 0x80, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x89, 0xA5, 0x60, 
-	0x80, 0x00, 0xE0, 0x04, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x08, 0x00, 0x01, 0x00, 0x00, 0x00, 0x00, 0x01, 0x6D, 0xDB, 
-	0x48, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0x3A, 0xDF, 0x00, 0x00, 0x00, 0x00, 0x60, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x15, 0x80, 0x01, 0x00, 0x00, 0x00, 0x00, 0x1C, 0x08, 0x14, 0x00, 0x00, 0x02, 0x00, 0x00, 0x00, 
-	0x00, 0x38, 0xF0, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0xC0, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x02, 0xC0, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x0F, 0x00, 0x00, 0x00, 0x00, 
-	0x60, 0x00, 0x00, 0x00, 0x00, 0x30, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x28, 0x00, 0x00, 0x00, 0x09, 0x00, 0x00, 0x00, 0x03, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x01, 0xE4, 0xB9, 0x00, 0x00, 0x00, 0x00, 0x3D, 0x00, 0xA0, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x01, 0x40, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x0A, 0x02, 0x80, 0x00, 
-	0x00, 0x80, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x20, 0x00, 0x00, 0x18, 0x3A, 0xC9, 0x50, 
-	0x00, 0x00, 0x00, 0x00, 0x18, 0x05, 0x20, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x0E, 0x10, 0x40, 0x00, 0x00, 0x51, 0xC0, 0x00, 0x09, 0x20, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x10, 0x00, 0x08, 0x09, 0xA8, 0x0D, 0x00, 0x44, 0x00, 0x00, 0x03, 0x0F, 0x50, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x40, 0x00, 0x00, 0x02, 0x00, 0x40, 0x00, 0x00, 0x01, 0x10, 
-	0x00, 0x00, 0x00, 0x04, 0x00, 0x2E, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0x00, 0x05, 0x18, 
-	0xF2, 0x30, 0x10, 0x04, 0x00, 0x00, 0x00, 0xDC, 0xF5, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x04, 
-	0x00, 0x00, 0x01, 0xE0, 0x00, 0x40, 0x00, 0x00, 0x81, 0xC0, 0x60, 0x41, 0x20, 0x40, 0x03, 0xC0, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x20, 0x00, 0x01, 0xF1, 0xF9, 0x21, 0x00, 0x80, 0x00, 0x02, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x80, 0x00, 0x03, 0x40, 0xA0, 0x00, 0x02, 
-	0x00, 0x00, 0x00, 0x70, 0x02, 0x00, 0x08, 0x00, 0x00, 0x00, 0x0F, 0xCF, 0x20, 0x00, 0x00, 0x00, 
-	0x80, 0x00, 0x0B, 0x1E, 0xC8, 0x70, 0x02, 0x00, 0x00, 0x04, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x02, 0x00, 0x00, 0x04, 0x01, 0x02, 0x40, 0x08, 0x00, 0x18, 0x08, 0x00, 0x01, 0x21, 
-	0x20, 0x60, 0x00, 0x00, 0xAC, 0xF0, 0x00, 0x00, 0x00, 0x00, 0x00, 0x09, 0xE0, 0x2C, 0x00, 0x08, 
-	0x00, 0x00, 0x02, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x03, 0xE4, 
-	0xC9, 0x90, 0x00, 0x00, 0x00, 0x00, 0xD0, 0x02, 0x00, 0x00, 0x00, 0x00, 0x3C, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x05, 0x0B, 0x00, 0x40, 0x20, 0x00, 0x00, 0x00, 0x04, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x06, 0x00, 0x66, 0x40, 0x00, 0x00, 0x00, 0x08, 
-	0x00, 0x01, 0x00, 0x00, 0x60, 0x00, 0x40, 0x00, 0x00, 0x00, 0x00, 0x00, 0x08, 0x00, 0x00, 0xA0, 
-	0xF2, 0x00, 0x00, 0x20, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x80, 0x00, 0x00, 0x00, 0x00, 0x20, 
-	0x00, 0x00, 0x00, 0x00, 0x40, 0x04, 0x80, 0x00, 0x00, 0x00, 0x00, 0x00, 0x02, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0x00, 0x00, 0x0B, 0x3A, 0xE0, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0x40, 0x00, 0x40, 0x10, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x40, 0x08, 
-	0x00, 0x00, 0x0D, 0x3D, 0x28, 0x00, 0x20, 0x00, 0x00, 0x03, 0x0F, 0xA2, 0x00, 0x80, 0x00, 0x00, 
-	0x00, 0x00, 0x20, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x80, 0x00, 0x00, 0x03, 0xC0, 0x00, 0x02, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x02, 0x80, 0x00, 0x00, 0x00, 0x96, 0xE9, 0x40, 0x00, 
-	0x00, 0x00, 0x00, 0x7A, 0xFA, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x18, 0x80, 0x00, 0x09, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x30, 0x00, 0x08, 0x00, 0x00, 0xA9, 0xF0, 0x91, 0x00, 0x20, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x80, 0x00, 0x00, 0x00, 0x00, 0x20, 0x00, 0x00, 0x34, 0x00, 0x80, 0x08, 0x80, 0x01, 0x00, 0x03, 
-	0x40, 0x00, 0x02, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x03, 0x00, 0x00, 0x00, 0x01, 0x80, 0x3F, 
-	0xC9, 0x50, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x40, 0x00, 0x00, 0x80, 0x00, 0x00, 0x09, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x24, 0x02, 0x08, 0x00, 0x00, 0x00, 0xC0, 0x14, 0x20, 0x20, 0x00, 0x03, 0xC0, 
-	0x00, 0x00, 0x00, 0x80, 0x80, 0x00, 0x00, 0x00, 0x20, 0x00, 0x00, 0x34, 0xA9, 0x90, 0x00, 0x80, 
-	0x00, 0x00, 0xD2, 0x46, 0x00, 0x02, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x10, 0x00, 
-	0x00, 0x00, 0x7E, 0x81, 0x40, 0x20, 0x00, 0x06, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x02, 0x01, 0x66, 0x00, 0x00, 0x00, 0x00, 0x88, 0x00, 0x90, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x80, 0x08, 0x00, 0x50, 0x80, 0x00, 0x00, 0x00, 0x20, 
-	0x00, 0x02, 0xC0, 0x00, 0x00, 0x00, 0x80, 0x00, 0x00, 0x00, 0x00, 0x20, 0x00, 0x20, 0x01, 0x00, 
-	0x00, 0x00, 0x80, 0x00, 0x00, 0x00, 0x00, 0x00, 0x02, 0x00, 0x00, 0x00, 0x40, 0x08, 0x08, 0x00, 
-	0x08, 0x30, 0x00, 0x08, 0x19, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x68, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x0E, 0x70, 0x0A, 0x10, 0x40, 0x00, 0x00, 0x00, 0xE0, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x20, 0x00, 0x04, 0x00, 0x00, 0x80, 0x58, 0x00, 0x00, 0x0F, 0x20, 
-	0x90, 0x02, 0x60, 0x00, 0x00, 0x24, 0xD1, 0x80, 0x80, 0x80, 0x00, 0x00, 0x00, 0x00, 0x20, 0x00, 
-	0x26, 0x00, 0x80, 0x00, 0x03, 0x80, 0x03, 0x00, 0x3B, 0x88, 0x00, 0x02, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x08, 0x01, 0x00, 0x00, 0x0A, 0x90, 0x40, 0x00, 0x04, 0x00, 0x00, 0x02, 0xC0, 
-	0xBD, 0x40, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x14, 0x2C, 0x00, 0x02, 0x40, 0x10, 0x18, 
-	0x80, 0x89, 0x28, 0x20, 0x20, 0x00, 0xC0, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x80, 0x20, 0x00, 
-	0x50, 0x03, 0x02, 0x94, 0x00, 0x80, 0x00, 0x07, 0x65, 0x05, 0x02, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x04, 0x00, 0x00, 0x00, 0x00, 0x00, 0x05, 0x10, 0x90, 0x02, 0x80, 0x08, 0x00, 
-	0x02, 0x00, 0x00, 0x00, 0x00, 0x00, 0x08, 0x04, 0x80, 0x08, 0x00, 0x80, 0x16, 0x80, 0x02, 0x00, 
-	0x00, 0x2E, 0x1A, 0xA0, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x0A, 0x00, 0x00, 0x28, 0x00, 0x00, 
-	0x00, 0x28, 0x00, 0x80, 0xA8, 0x60, 0x14, 0x00, 0x20, 0x00, 0xE0, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x82, 0x08, 0x05, 0x00, 0xFF, 0x34, 0x00, 0x00, 0x34, 0x00, 0x03, 0x40, 0x00, 0x00, 0x00, 0x84, 
-	0x00, 0x00, 0x00, 0x00, 0x20, 0x03, 0x40, 0x02, 0x00, 0x40, 0x00, 0x81, 0x00, 0x1B, 0x00, 0x00, 
-	0x00, 0x02, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x28, 0x01, 0x00, 0x25, 0x8A, 0x96, 0xD0, 
-	0x00, 0x05, 0x20, 0x00, 0x04, 0x00, 0x00, 0x00, 0x10, 0x00, 0x00, 0x00, 0x00, 0x04, 0x00, 0x00, 
-	0x00, 0x60, 0x00, 0x40, 0x10, 0x00, 0x00, 0xA0, 0x00, 0x00, 0x00, 0x40, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x08, 0x00, 0x09, 0x09, 0x78, 0x3C, 0x00, 0x20, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x20, 0x00, 0x00, 0x00, 0x00, 0x40, 0x00, 0x80, 0x00, 
-	0x90, 0xBA, 0xB0, 0x00, 0x02, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0x00, 0x01, 
-	0x9C, 0x7F, 0x83, 0x40, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x40, 0x00, 0x40, 0x00, 0x00, 0x39, 0x8F, 0x7C, 0x0C, 0x00, 0x40, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x08, 0x00, 0x90, 0x00, 0x01, 0x68, 0x00, 0x24, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x20, 0x00, 0x00, 0x01, 0x00, 0x00, 
-	0x00, 0x81, 0x00, 0x00, 0x02, 0xC0, 0x00, 0x22, 0x00, 0x00, 0x00, 0x29, 0x99, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x08, 0x0C, 0x30, 0x16, 0x80, 0x00, 0x20, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x0A, 0x10, 0x40, 0x00, 0x00, 0x00, 0x80, 0x04, 0x09, 
-	0x00, 0x00, 0x00, 0x00, 0x06, 0x19, 0x90, 0x00, 0x10, 0x00, 0x08, 0x00, 0x90, 0x00, 0x00, 0x00, 
-	0x00, 0x20, 0x00, 0x00, 0x14, 0x00, 0x80, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x20, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x80, 0x00, 0x80, 0x04, 0x00, 0x00, 0x02, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x03, 0x00, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x02, 0x00, 0x00, 
-	0x40, 0x40, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x18, 
-	0x80, 0x78, 0x41, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x02, 0x08, 0x00, 0x00, 
-	0x80, 0x00, 0x00, 0x00, 0x24, 0x00, 0x03, 0x40, 0xB0, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x20, 0x00, 0x00, 0x00, 0x80, 0x00, 0x00, 0x80, 0x01, 0x90, 0x57, 0x04, 0x00, 0x02, 0x00, 0x00, 
-	0x21, 0x40, 0x08, 0x40, 0x40, 0x00, 0x10, 0x00, 0x01, 0x81, 0x00, 0x00, 0x00, 0x00, 0x20, 0x00, 
-	0x04, 0x00, 0x02, 0x40, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0x02, 0x40, 
-	0x00, 0x00, 0x18, 0xA3, 0x60, 0x20, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x04, 0x00, 0x00, 0x80, 
-	0x08, 0x00, 0x00, 0x83, 0x41, 0x40, 0x00, 0x20, 0x00, 0x40, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x20, 0x00, 0x42, 0x34, 0x00, 0x80, 0x08, 0x80, 0x01, 0x00, 0x30, 0x02, 0x00, 
-	0x02, 0x00, 0x02, 0x00, 0x00, 0x00, 0x00, 0x00, 0x08, 0x30, 0x00, 0x00, 0x1D, 0x03, 0x28, 0x00, 
-	0x00, 0x00, 0x20, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x20, 0x06, 
-	0x00, 0x00, 0x40, 0x00, 0x00, 0x81, 0xA8, 0x00, 0x01, 0x00, 0x00, 0x00, 0x60, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x80, 0x38, 0x00, 0x08, 0x03, 0xB4, 0x49, 0x00, 0x20, 0x00, 0x40, 0x00, 0x00, 0x00, 
-	0x08, 0x00, 0x00, 0x00, 0x00, 0x00, 0x20, 0x03, 0x42, 0x80, 0x00, 0x00, 0x08, 0x80, 0x00, 0x00, 
-	0x08, 0x01, 0x00, 0x06, 0x00, 0x02, 0x00, 0x0A, 0x00, 0x00, 0x00, 0x0F, 0x83, 0x10, 0x05, 0x00, 
-	0x9A, 0x21, 0x10, 0x00, 0x00, 0x20, 0x38, 0x0A, 0x10, 0x40, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x1A, 0x10, 0x48, 0x00, 0x00, 0x18, 0x03, 0x00, 0x01, 0x20, 0x40, 0x01, 0xE0, 
-	0x00, 0x10, 0x20, 0x00, 0x80, 0x81, 0xA2, 0x00, 0x00, 0x03, 0xAD, 0x21, 0x00, 0x80, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0x40, 0x14, 0x00, 0x80, 0x08, 
-	0x00, 0x00, 0x00, 0x02, 0x00, 0x00, 0x00, 0x00, 0x00, 0x28, 0x00, 0x00, 0x00, 0x00, 0x08, 0x04, 
-	0x80, 0x00, 0x1C, 0xDA, 0xC8, 0x70, 0x02, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x0A, 0x00, 0x00, 0x00, 0x00, 0x00, 0x40, 0x68, 0x00, 0x18, 0xE0, 0x04, 0x09, 0x00, 
-	0xA0, 0x00, 0x03, 0xC0, 0x00, 0x00, 0x00, 0x00, 0x82, 0x08, 0x00, 0x01, 0x00, 0x28, 0x00, 0x08, 
-	0x20, 0x00, 0x00, 0x00, 0xD0, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x20, 0x01, 0x40, 0x00, 
-	0x00, 0x00, 0x00, 0x80, 0x00, 0x00, 0x04, 0x00, 0x00, 0x22, 0x00, 0x00, 0x20, 0x0D, 0x00, 0x41, 
-	0x00, 0x08, 0x01, 0x00, 0x00, 0x0E, 0x00, 0x00, 0x20, 0x04, 0x00, 0x00, 0x00, 0x00, 0x02, 0x40, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x04, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x10, 0x00, 0x01, 0x80, 
-	0x20, 0x41, 0x00, 0x40, 0x00, 0x00, 0x40, 0x00, 0x24, 0x00, 0x00, 0x00, 0x00, 0x08, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0xC2, 0x35, 0x98, 0x00, 0x00, 0x88, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x05, 0xA0, 0x00, 0x20, 0x71, 0x08, 0x14, 0x2A, 0x80, 0x00, 0x00, 0x00, 0x38, 
-	0x0C, 0x00, 0x20, 0x00, 0x00, 0x00, 0x00, 0x05, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x20, 0x05, 
-	0x4F, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x04, 0x00, 0x00, 0x00, 0x60, 0x5A, 0x40, 0x10, 
-	0x04, 0x00, 0x18, 0x69, 0x55, 0x04, 0x00, 0x00, 0x00, 0x00, 0x00, 0x26, 0x00, 0x08, 0x00, 0x00, 
-	0x02, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x11, 0xC3, 0x25, 0xE1, 0x20, 0x00, 0x80, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x01, 0x60, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x32, 0xD1, 0x00, 0x00, 
-	0x0C, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0xA0, 0x84, 0x24, 0x4C, 0x33, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0x16, 0x78, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0xC9, 0x7C, 0x44, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x10, 0x00, 0x00, 0x80, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xC2, 0x00, 0xF8, 0x02, 0x00, 
-	0x80, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xD0, 0x00, 0x90, 0x00, 0x01, 0x0A, 0x50, 
-	0x02, 0x00, 0x00, 0x20, 0x00, 0x00, 0x0F, 0x00, 0x00, 0x03, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x20, 0x01, 0x6D, 0x80, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x02, 0x60, 0x40, 0x00, 0x00, 0x00, 0x00, 0x01, 0x04, 0x04, 0x00, 0x00, 0x00, 
-	0x10, 0x26, 0x80, 0x24, 0x02, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x20, 0x40, 0x04, 
-	0x00, 0x80, 0x00, 0x80, 0x40, 0x00, 0x00, 0x00, 0x00, 0x20, 0x00, 0x00, 0x00, 0x00, 0x00, 0x10, 
-	0x00, 0x00, 0x50, 0x02, 0x00, 0x00, 0x00, 0x00, 0x00, 0x40, 0x08, 0x28, 0x00, 0x00, 0x10, 0x00, 
-	0x47, 0x80, 0x00, 0x00, 0x00, 0x00, 0x00, 0x20, 0x62, 0x00, 0x00, 0x40, 0x00, 0x02, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x04, 0x20, 0x1A, 0x10, 0x40, 0x00, 0x80, 0x00, 0x08, 0x00, 0x01, 0x00, 0x00, 
-	0x00, 0x60, 0x00, 0x00, 0x04, 0x80, 0x00, 0x00, 0x00, 0x00, 0x01, 0x00, 0xB1, 0x08, 0x80, 0x00, 
-	0x00, 0x63, 0xD4, 0x00, 0x80, 0x00, 0x80, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xE3, 0x1D, 0x9B, 
-	0xE0, 0x00, 0x08, 0x0B, 0x18, 0xD0, 0x02, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x30, 0x00, 0x00, 0x0A, 0x58, 0x10, 0x80, 0x00, 0x20, 0x24, 0x7A, 0x00, 0x00, 0x40, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x80, 0x3E, 0x04, 0x58, 0xD7, 0x00, 0x01, 0x0A, 0x91, 0xC8, 0x00, 
-	0x01, 0x00, 0x00, 0xA0, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x41, 0x20, 0x00, 0x50, 0x07, 0x3A, 
-	0x64, 0x00, 0x00, 0x80, 0xC3, 0x07, 0xC2, 0x50, 0x04, 0x80, 0x00, 0x00, 0x00, 0x00, 0xC0, 0x00, 
-	0x00, 0x01, 0x05, 0x50, 0x03, 0x10, 0x01, 0x0A, 0x00, 0x01, 0x00, 0x10, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x02, 0x81, 0x00, 0x08, 0x00, 0x80, 0x19, 0x80, 0x00, 0x00, 0x14, 0x01, 0xDB, 
-	0x4A, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x0C, 0x00, 0x00, 0x00, 0xCC, 0x55, 0x40, 0x30, 0x00, 
-	0x00, 0x05, 0x80, 0x01, 0x00, 0x00, 0x00, 0x06, 0x80, 0x00, 0x00, 0x00, 0x00, 0x00, 0x60, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x80, 0x03, 0xC0, 0x17, 0x00, 0xA0, 0x04, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x80, 0x01, 0xC2, 0x84, 0xB6, 0x00, 0x00, 0x00, 0x00, 0x9A, 0x92, 0xC0, 0x00, 0x08, 0x00, 
-	0x14, 0x00, 0x10, 0x00, 0x00, 0x00, 0x00, 0x00, 0x80, 0x00, 0x00, 0x00, 0x00, 0x00, 0x02, 0x00, 
-	0x20, 0x29, 0x7C, 0xA0, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x02, 0x00, 0x20, 0x00, 0x0F, 0x90, 
-	0x00, 0x28, 0x02, 0x38, 0xA9, 0x02, 0x04, 0x00, 0x20, 0x02, 0x00, 0x00, 0xA1, 0x04, 0x00, 0x10, 
-	0x02, 0x00, 0x00, 0x00, 0x00, 0x00, 0x10, 0x02, 0x00, 0x03, 0xE2, 0xE4, 0xA2, 0x40, 0x00, 0x84, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x02, 0xE4, 0x14, 0x00, 0x80, 0x00, 0x00, 0x05, 0x80, 0x9F, 0x40, 
-	0x00, 0x00, 0x00, 0x04, 0x00, 0x40, 0x08, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x50, 0x00, 
-	0x12, 0x00, 0x00, 0x3E, 0x01, 0xDE, 0x20, 0x00, 0x10, 0xB0, 0x00, 0x00, 0x00, 0x00, 0x00, 0x34, 
-	0x2A, 0x00, 0x00, 0x40, 0x00, 0x00, 0x50, 0xEF, 0xA6, 0x00, 0x00, 0x00, 0x02, 0x00, 0x20, 0x00, 
-	0x04, 0x00, 0x23, 0x00, 0x00, 0x00, 0x70, 0x01, 0xA7, 0x00, 0x00, 0x00, 0xE2, 0x44, 0x15, 0xB2, 
-	0x10, 0x03, 0x00, 0x00, 0x0A, 0xF0, 0x00, 0x00, 0x08, 0x00, 0x35, 0x0A, 0xA0, 0x00, 0x01, 0x83, 
-	0x0E, 0x7F, 0xC1, 0x00, 0x00, 0x00, 0x00, 0x03, 0x70, 0x00, 0x20, 0x04, 0x80, 0x00, 0x00, 0x09, 
-	0x80, 0x97, 0x8C, 0x00, 0x00, 0x00, 0x26, 0x61, 0x6A, 0x33, 0x00, 0x30, 0x00, 0x78, 0x18, 0x00, 
-	0x04, 0x00, 0x40, 0x7A, 0x18, 0x55, 0x00, 0x10, 0x00, 0x98, 0x81, 0xEC, 0x04, 0x00, 0x40, 0x00, 
-	0x00, 0x25, 0x85, 0x00, 0x00, 0x00, 0x20, 0x00, 0x00, 0x00, 0x8D, 0xA3, 0x0C, 0x00, 0x00, 0x00, 
-	0x06, 0x67, 0xC8, 0x02, 0x00, 0x00, 0x00, 0x00, 0x90, 0x00, 0x00, 0x03, 0x44, 0x2C, 0x00, 0x82, 
-	0x88, 0x00, 0x01, 0x00, 0x16, 0x65, 0x80, 0x00, 0x00, 0x36, 0x00, 0x4C, 0x42, 0x00, 0x00, 0x00, 
-	0x40, 0x00, 0x01, 0x00, 0xD8, 0x0F, 0x00, 0x00, 0x00, 0x06, 0x60, 0x59, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x88, 0x00, 0x00, 0x00, 0x20, 0x20, 0x00, 0x00, 0x60, 0x80, 0x00, 0x71, 0xC0, 0x71, 0xA4, 
-	0x00, 0x00, 0xA1, 0x40, 0x2C, 0x10, 0x00, 0x00, 0x18, 0x00, 0x00, 0x00, 0x00, 0x81, 0x83, 0xC0, 
-	0x00, 0x00, 0x00, 0x44, 0x03, 0x05, 0x50, 0x00, 0x01, 0x00, 0x09, 0x90, 0x04, 0x00, 0x00, 0xC2, 
-	0x26, 0xEC, 0xC0, 0x00, 0x00, 0x00, 0x88, 0x3B, 0x30, 0xC0, 0x00, 0x80, 0x64, 0x01, 0x50, 0x05, 
-	0x00, 0x02, 0x40, 0x00, 0x00, 0x00, 0x19, 0x13, 0x83, 0xC0, 0x00, 0x02, 0x24, 0x69, 0x7E, 0x55, 
-	0x00, 0x00, 0x00, 0x00, 0x99, 0x00, 0x00, 0x0A, 0x20, 0x01, 0xDC, 0x00, 0x00, 0x00, 0x00, 0x11, 
-	0xC5, 0x04, 0xF0, 0x00, 0x08, 0x02, 0x00, 0x25, 0xA0, 0x00, 0x00, 0x02, 0x32, 0x00, 0x00, 0x50, 
-	0x99, 0x69, 0x04, 0x00, 0x00, 0x00, 0x20, 0x1C, 0xA5, 0x00, 0x00, 0x00, 0x01, 0x00, 0x30, 0x00, 
-	0x0E, 0x00, 0x02, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x10, 0x73, 0xFC, 0x04, 0x10, 0x00, 0x00, 
-	0x00, 0x40, 0xFA, 0x20, 0x00, 0x30, 0x40, 0x00, 0x08, 0x00, 0x86, 0xE0, 0x80, 0x01, 0x00, 0x04, 
-	0x03, 0x6B, 0x18, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x60, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x10, 0xA1, 0x6F, 0xC5, 0x80, 0x00, 0x60, 0x60, 0x01, 0xAF, 0x50, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0xA0, 0xB6, 0x00, 0x00, 0x00, 0x09, 0x60, 0x00, 0xFF, 0xC0, 0x88, 0x00, 0x01, 
-	0x80, 0x50, 0x00, 0x00, 0x00, 0x63, 0xA7, 0xA7, 0xA0, 0x00, 0x00, 0x0F, 0x00, 0xDF, 0x88, 0x80, 
-	0x00, 0x00, 0x14, 0x20, 0x00, 0x04, 0x00, 0x00, 0x00, 0x30, 0x00, 0x05, 0x0A, 0x3B, 0x60, 0x00, 
-	0x00, 0x00, 0x64, 0x78, 0x0E, 0xFC, 0x00, 0x00, 0x00, 0x78, 0x08, 0x00, 0x00, 0x00, 0x0E, 0x66, 
-	0x5D, 0xB8, 0x00, 0x00, 0x30, 0x10, 0x87, 0x76, 0x20, 0x00, 0x00, 0x00, 0x62, 0xCE, 0x00, 0x00, 
-	0x00, 0x08, 0x20, 0x10, 0x00, 0x00, 0xB5, 0xE6, 0x98, 0x00, 0x00, 0x01, 0x66, 0x82, 0x05, 0x50, 
-	0x03, 0x00, 0x10, 0x10, 0xF0, 0x00, 0xC0, 0x01, 0x42, 0x3C, 0xA3, 0x80, 0x00, 0x11, 0x03, 0x0E, 
-	0x76, 0x80, 0x80, 0x00, 0x00, 0x14, 0x00, 0xCA, 0x24, 0x00, 0x04, 0x80, 0x43, 0x00, 0x00, 0x00, 
-	0xDA, 0xD5, 0x80, 0x00, 0x01, 0x7E, 0x29, 0x4C, 0x55, 0x20, 0x51, 0x00, 0x01, 0xE0, 0x00, 0x04, 
-	0x00, 0x00, 0x76, 0x4B, 0x2C, 0x00, 0x02, 0x98, 0xD0, 0x89, 0xB4, 0x00, 0x00, 0x00, 0x00, 0x06, 
-	0xA0, 0x11, 0x80, 0x00, 0x08, 0x30, 0x20, 0x00, 0x00, 0xE0, 0x38, 0xF0, 0x00, 0x00, 0x03, 0x44, 
-	0x2C, 0xC7, 0x23, 0x08, 0x00, 0x07, 0x1F, 0xBA, 0x48, 0x0A, 0x04, 0x22, 0xB5, 0xD0, 0x00, 0x02, 
-	0x28, 0x4B, 0x0A, 0xF4, 0x15, 0x40, 0x00, 0x00, 0x04, 0x29, 0x6A, 0x42, 0x00, 0x00, 0x60, 0x40, 
-	0x80, 0x07, 0x00, 0x00, 0x4F, 0x12, 0x00, 0x00, 0x20, 0x2A, 0x19, 0xB1, 0x00, 0x68, 0x40, 0x01, 
-	0xCB, 0x80, 0x0A, 0x80, 0x9E, 0x28, 0x5A, 0x01, 0x00, 0x09, 0x02, 0xD8, 0x08, 0x2A, 0xA8, 0x00, 
-	0xA0, 0x02, 0x06, 0x96, 0x10, 0x00, 0x00, 0x02, 0x42, 0x00, 0x00, 0xF0, 0xA0, 0x83, 0x30, 0x10, 
-	0x00, 0x00, 0x02, 0xBC, 0xA9, 0x60, 0x00, 0x02, 0x09, 0x10, 0x52, 0x00, 0x00, 0x03, 0xC2, 0x80, 
-	0x00, 0xF0, 0x00, 0x00, 0x0B, 0x0D, 0x12, 0x8C, 0x00, 0x00, 0x00, 0x14, 0x2B, 0x5E, 0x3C, 0x01, 
-	0x00, 0x02, 0x80, 0x00, 0x05, 0x0A, 0x72, 0x0C, 0xC0, 0x00, 0x00, 0x00, 0x6C, 0x1E, 0x69, 0x00, 
-	0x00, 0x40, 0x01, 0xC8, 0x04, 0x00, 0x00, 0x34, 0x38, 0x18, 0x0F, 0x40, 0x40, 0x00, 0xD8, 0x1F, 
-	0xA8, 0x30, 0x00, 0x00, 0x00, 0x00, 0x1D, 0x81, 0xC4, 0x80, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x03, 0x30, 0x00, 0x00, 0x40, 0x00, 0x00, 0x00, 0x02, 0x07, 0x00, 0x00, 0x00, 0x10, 0x00, 0x08, 
-	0x00, 0x40, 0x00, 0x83, 0x30, 0x08, 0x01, 0x03, 0x0F, 0x00, 0x00, 0x00, 0x00, 0x0A, 0x00, 0x23, 
-	0x40, 0x08, 0x00, 0x00, 0x00, 0x00, 0x00, 0x05, 0x9A, 0x1A, 0x0C, 0xE0, 0x04, 0x00, 0x1C, 0x00, 
-	0x1E, 0x10, 0x50, 0x70, 0x00, 0x70, 0x00, 0x00, 0x04, 0x00, 0x00, 0x00, 0x19, 0x33, 0x00, 0x80, 
-	0x28, 0x00, 0xE0, 0x68, 0x41, 0x00, 0x40, 0x04, 0x00, 0x40, 0x00, 0x04, 0x00, 0x00, 0x00, 0x00, 
-	0x20, 0x00, 0x00, 0x33, 0x30, 0x00, 0x00, 0x00, 0x02, 0xDC, 0xA9, 0x90, 0x00, 0x00, 0x81, 0x00, 
-	0x30, 0x00, 0x00, 0x60, 0x02, 0x00, 0x93, 0x30, 0x10, 0x00, 0x20, 0x08, 0x98, 0x14, 0x00, 0x00, 
-	0x00, 0x04, 0x21, 0x40, 0xA5, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x1C, 0x02, 0x0C, 0xE0, 0x00, 
-	0x00, 0x0E, 0x04, 0xC0, 0xA5, 0x00, 0x00, 0x00, 0x00, 0x88, 0x00, 0x00, 0x00, 0x00, 0x20, 0x19, 
-	0x33, 0x00, 0x00, 0x01, 0x00, 0x11, 0xF8, 0x28, 0x00, 0x00, 0x00, 0x00, 0x7C, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x50, 0x00, 0x37, 0x30, 0x00, 0x04, 0x00, 0x40, 0x04, 0x00, 0x80, 0x0C, 
-	0x00, 0x0F, 0x00, 0x58, 0x00, 0x00, 0x60, 0x02, 0x36, 0x00, 0x50, 0x00, 0x00, 0x00, 0x10, 0x03, 
-	0xC0, 0x00, 0x00, 0x00, 0x04, 0x43, 0xDB, 0x5E, 0x20, 0x00, 0x00, 0x00, 0x00, 0x08, 0x00, 0x02, 
-	0x0C, 0xE0, 0x00, 0xA0, 0x20, 0x02, 0x00, 0x00, 0x40, 0x40, 0x00, 0x80, 0x03, 0x00, 0x00, 0x00, 
-	0x06, 0x73, 0x58, 0x50, 0x00, 0x00, 0x12, 0x01, 0x80, 0x00, 0x09, 0x00, 0x0A, 0x02, 0x02, 0x0D, 
-	0x85, 0xF0, 0x00, 0x00, 0x02, 0x00, 0x00, 0x50, 0x00, 0x3F, 0x30, 0x01, 0x10, 0x08, 0x22, 0x2C, 
-	0x00, 0x80, 0x0C, 0x00, 0x00, 0x0E, 0xD0, 0x00, 0x00, 0x00, 0x03, 0x41, 0x05, 0x50, 0x00, 0x10, 
-	0x01, 0x00, 0x02, 0x00, 0x08, 0x00, 0x00, 0x3C, 0x00, 0x3A, 0xA3, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x08, 0x1A, 0x02, 0x4C, 0xE0, 0x01, 0x01, 0x14, 0x04, 0x00, 0x00, 0x40, 0x40, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x05, 0xEE, 0x55, 0x60, 0x00, 0x80, 0x00, 0x00, 0x04, 0x09, 0x80, 0x00, 
-	0x02, 0x02, 0x8E, 0xDA, 0x34, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x83, 0x30, 0x00, 0x00, 
-	0xE0, 0x00, 0x00, 0x00, 0x42, 0x08, 0x00, 0x20, 0x08, 0x90, 0x00, 0x00, 0x00, 0xC2, 0x6E, 0xC0, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x04, 0x00, 0x00, 0x00, 0x40, 0x16, 0x01, 0x6F, 0x83, 0x00, 0x00, 
-	0x00, 0x20, 0x00, 0x00, 0x00, 0x72, 0x0C, 0xE0, 0x00, 0x00, 0x1E, 0x01, 0x60, 0x00, 0x68, 0x00, 
-	0x05, 0x58, 0x08, 0x00, 0x00, 0x00, 0x20, 0x2A, 0xEB, 0x0C, 0x20, 0x00, 0x00, 0x1C, 0x00, 0x78, 
-	0x41, 0x00, 0x02, 0x03, 0x46, 0x37, 0x94, 0x20, 0x00, 0x00, 0x00, 0x00, 0x00, 0x08, 0x00, 0x2B, 
-	0x30, 0x00, 0xC0, 0x00, 0x27, 0xC2, 0xCC, 0xC0, 0x03, 0x00, 0x05, 0x00, 0x90, 0x00, 0xC0, 0x00, 
-	0x20, 0x24, 0xB9, 0x90, 0x00, 0x12, 0xA0, 0x00, 0x04, 0x00, 0x00, 0x04, 0x00, 0x04, 0x2C, 0xCB, 
-	0x08, 0x00, 0x03, 0x00, 0x00, 0x00, 0x07, 0x00, 0x02, 0x0C, 0xE0, 0x04, 0x00, 0x16, 0x2D, 0x41, 
-	0x33, 0x00, 0x30, 0x08, 0xD9, 0xA0, 0x00, 0x0C, 0x00, 0x1E, 0x2A, 0x01, 0x66, 0x00, 0x82, 0x01, 
-	0x01, 0x80, 0x20, 0x41, 0x00, 0x40, 0x02, 0x00, 0x20, 0xB0, 0x40, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0xF0, 0x00, 0x03, 0x30, 0x00, 0x80, 0x08, 0x20, 0x3C, 0x0A, 0xA0, 0x02, 0x00, 0x05, 0x00, 0x72, 
-	0xC0, 0x00, 0x01, 0x42, 0x82, 0x0C, 0xC1, 0x04, 0x10, 0x0B, 0x00, 0x17, 0xC4, 0x80, 0x00, 0x00, 
-	0x34, 0x2E, 0x49, 0x99, 0x08, 0x00, 0x06, 0x80, 0x00, 0x08, 0x00, 0x7F, 0x0C, 0xE0, 0x02, 0x01, 
-	0x5E, 0x78, 0x4A, 0xA5, 0x00, 0x08, 0x00, 0x81, 0xA5, 0x04, 0x0A, 0x00, 0x14, 0x00, 0xC8, 0x33, 
-	0x00, 0x2B, 0x12, 0x80, 0xA3, 0x2D, 0xEC, 0x00, 0xA0, 0x04, 0x02, 0x80, 0x16, 0x60, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x30, 0x00, 0x08, 0x00, 0x01, 0xC0, 0x02, 0x00, 0x40, 0x00, 0x00, 
-	0x00, 0x89, 0x52, 0x00, 0x00, 0x00, 0x00, 0x00, 0x0C, 0xC1, 0x44, 0x00, 0x05, 0x8A, 0x18, 0x3F, 
-	0xC8, 0x40, 0x01, 0x40, 0x38, 0x10, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x40, 
-	0x20, 0x00, 0x00, 0x00, 0x00, 0x60, 0x00, 0x78, 0x40, 0x80, 0x10, 0x08, 0x04, 0x00, 0x00, 0x00, 
-	0x01, 0x68, 0x33, 0x88, 0x00, 0x00, 0xD0, 0xC3, 0x80, 0x00, 0x00, 0x00, 0x00, 0x06, 0xC0, 0xC1, 
-	0x04, 0x00, 0x00, 0x00, 0x11, 0x02, 0x01, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x0A, 0x00, 0x20, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x40, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x20, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x80, 0x00, 0x00, 0x00, 0x00, 0x20, 
-	0x00, 0x00, 0x40, 0x00, 0x2C, 0x00, 0x80, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x07, 0x80, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x80, 0x00, 0x00, 0x00, 0x00, 0x00, 0x02, 0x00, 0x00, 0x00, 0x33, 0x00, 
-	0x00, 0x00, 0x10, 0x00, 0x00, 0xF0, 0x00, 0x78, 0x00, 0x40, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x08, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x08, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0xF0, 0x00, 0x00, 0x00, 0x00, 0x00, 0x0E, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x40, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x20, 0x70, 0x00, 
-	0x80, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x20, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x02, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x08, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x07, 0x40, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x04, 0x00, 0x00, 0x00, 0x00, 0x00, 0x08, 
-	0x10, 0x00, 0x00, 0x00, 0x10, 0x0C, 0x00, 0x00, 0x00, 0x00, 0x00, 0x10, 0x30, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0xC0, 0x00, 0x00, 0x00, 0x00, 0x00, 0x03, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x10, 0x00, 0x3C, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x20, 
-	0x00, 0x00, 0x28, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x10, 0x00, 0x00, 0x00, 0x00, 0x3C, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x0B, 0xC0, 0x04, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0x80, 0x00, 0x00, 0x08, 
-	0x00, 0x00, 0x00, 0xA0, 0x00, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 0x08, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0xA0, 0x00, 0x60, 0x00, 0x80, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x1E, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x28, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x06, 0xC0, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x02, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x08, 0x00, 0x00, 0x08, 0x00, 0x02, 0x00, 0x00, 0x00, 0x00, 0x04, 0x00, 0x08, 0x00, 
-	0x00, 0x00, 0x02, 0x00, 0x00, 0x20, 0x00, 0x00, 0x00, 0x00, 0x34, 0x00, 0x80, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x0E, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x20, 0x00, 0x00, 0x00, 0x00, 0x08, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x20, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x04, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x04, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x40, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0x46, 0x00, 0x00, 0x00, 0x40, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x08, 0x1A, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x09, 0x79, 0x80, 0x00, 0x40, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x28, 0x0A, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x08, 0x00, 0x00, 
-	0x00, 0x00, 0x50, 0x00, 0x00, 0x04, 0x00, 0x07, 0x00, 0x00, 0x00, 0x00, 0xA0, 0x3F, 0xC1, 0xC0, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x0E, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x96, 0x80, 0xE8, 0x00, 0x00, 0x14, 0x01, 
-	0xCC, 0xF0, 0x14, 0x00, 0x00, 0x00, 0x09, 0x00, 0x00, 0x00, 0x00, 0x15, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x01, 0x68, 0x00, 0x50, 0x00, 0x00, 0x00, 0x83, 0x3B, 0x00, 0x22, 0xD4, 0x00, 0x00, 
-	0x00, 0x3C, 0x00, 0x00, 0x00, 0x84, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x08, 0x40, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x90, 0x00, 0x07, 0x80, 
-	0x00, 0x08, 0x01, 0xCC, 0x10, 0x00, 0x00, 0x00, 0x00, 0x08, 0x00, 0x08, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x08, 0x00, 0x02, 0x40, 0x00, 0x00, 0x00, 0xC0, 0x03, 0x3B, 0x00, 0x00, 
-	0x00, 0x00, 0x20, 0x08, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x02, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x82, 
-	0x06, 0x00, 0x00, 0x00, 0x00, 0x05, 0xCC, 0x16, 0x80, 0x28, 0x01, 0x00, 0x01, 0x9A, 0x1E, 0x00, 
-	0x00, 0x04, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x60, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x20, 0x00, 0x00, 0x00, 0x00, 0x03, 
-	0x30, 0x00, 0x04, 0x01, 0x20, 0x24, 0x19, 0xBC, 0x00, 0x00, 0x00, 0x80, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x02, 0x81, 0xCC, 0x90, 0x20, 0x00, 0x00, 0x00, 0x08, 
-	0x20, 0xC0, 0xD0, 0x00, 0x00, 0x00, 0x00, 0x20, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x03, 0x33, 0x01, 0x40, 0x00, 0x00, 0x01, 0x00, 0x02, 0x05, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x10, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x02, 0x81, 0xCC, 0x16, 0x16, 0x02, 
-	0x00, 0x00, 0x10, 0xF0, 0x00, 0x00, 0x18, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x03, 0x30, 0x00, 0x02, 0x50, 0x00, 0x00, 0x0F, 0x1C, 0x0D, 0x0A, 
-	0x40, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x40, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x18, 0x00, 0x00, 0x81, 0xCC, 
-	0x10, 0x16, 0x68, 0x00, 0x04, 0x01, 0x98, 0x00, 0x51, 0xA0, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x08, 0x00, 0x00, 0x03, 0x3F, 0x00, 0x00, 0x00, 0x00, 0x80, 0x26, 
-	0x5C, 0xD5, 0x8D, 0x08, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0x90, 0x00, 0x00, 0x00, 0x00, 
-	0x08, 0x81, 0xCC, 0x90, 0x00, 0x00, 0x00, 0x00, 0x00, 0xF4, 0xEE, 0x81, 0xA0, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x10, 0x00, 0x10, 0x00, 0x40, 0x00, 0x00, 0x00, 0x20, 0x43, 0x39, 0x00, 0x00, 0x01, 
-	0x20, 0x00, 0x0F, 0x5F, 0x05, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x01, 0x00, 0x01, 0xC4, 0x87, 0x98, 0x00, 0x04, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x40, 0x20, 
-	0x05, 0x00, 0x00, 0x00, 0x01, 0xCC, 0x17, 0xB4, 0x64, 0x00, 0x00, 0x00, 0x25, 0x6A, 0x00, 0x00, 
-	0x00, 0x40, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x1E, 0xE0, 0x78, 0xA0, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0x00, 0x03, 0x40, 0x50, 0x00, 0x00, 0x02, 0x43, 0x30, 
-	0x40, 0x42, 0x00, 0x00, 0x00, 0x02, 0x75, 0x0B, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x45, 0x00, 0x80, 0x04, 0xC0, 0x00, 0x00, 0x10, 0x00, 0x00, 0x00, 0x00, 0x40, 
-	0x00, 0x73, 0x16, 0x85, 0x9A, 0x00, 0x40, 0x04, 0xCC, 0x12, 0x00, 0x2A, 0x00, 0x50, 0x01, 0x9A, 
-	0x01, 0x00, 0x01, 0x41, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x02, 0x40, 0x00, 0x14, 
-	0x39, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xCC, 0x30, 0xD0, 0x00, 0x08, 
-	0x00, 0x43, 0x30, 0x40, 0x00, 0x10, 0x00, 0x20, 0x26, 0x4C, 0xE0, 0x00, 0x1C, 0x04, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xA0, 0x40, 0x90, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x73, 0x05, 0x80, 0x00, 0x00, 0x00, 0x02, 0x00, 0x02, 0x04, 0x00, 0x00, 
-	0x20, 0x02, 0xA9, 0xC0, 0x98, 0x00, 0x00, 0x80, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x02, 0x5E, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xCC, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x02, 0x00, 0x00, 0x20, 0x00, 0x03, 0x00, 0x15, 0x42, 0xE9, 0x80, 0x00, 
-	0x08, 0x00, 0x02, 0x00, 0x00, 0x00, 0x00, 0x07, 0x00, 0x00, 0x00, 0x09, 0x3E, 0x80, 0x01, 0x40, 
-	0x80, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x73, 0x05, 0x8D, 0x01, 0x00, 0x00, 0x02, 0x40, 0x00, 
-	0x14, 0x00, 0x00, 0x00, 0x02, 0xA8, 0xE1, 0x98, 0x00, 0x00, 0x00, 0x40, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x40, 0x00, 0x00, 0x00, 0x81, 0x59, 0x00, 0x8A, 0x10, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0xCC, 0x10, 0x50, 0xA0, 0x00, 0x00, 0x00, 0x07, 0x00, 0x00, 0x00, 0x00, 0x04, 0x15, 0x42, 
-	0xC9, 0x89, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x40, 0x00, 0x00, 0xA8, 0x04, 
-	0x88, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x20, 0x00, 0x73, 0x05, 0xA0, 0x00, 0x00, 0x00, 
-	0x02, 0x08, 0x18, 0x00, 0x00, 0x00, 0x02, 0x03, 0x31, 0x40, 0x00, 0x00, 0x00, 0x00, 0x00, 0x20, 
-	0x00, 0x00, 0x00, 0x00, 0x24, 0x00, 0x00, 0x00, 0x00, 0x29, 0x10, 0xE0, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x05, 0x00, 0x00, 0xCC, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x33, 0x36, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0xB6, 0xC0, 0xE0, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x73, 0x04, 0x00, 
-	0x00, 0x00, 0x00, 0x02, 0x00, 0x00, 0x00, 0x00, 0x05, 0x00, 0x18, 0x20, 0xE0, 0x81, 0x80, 0x08, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x03, 0x6D, 0xD0, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xCE, 0x40, 0x00, 0x00, 0x00, 0x00, 0x01, 0x00, 0x24, 
-	0x00, 0x00, 0x20, 0x80, 0x00, 0x02, 0x09, 0x19, 0x00, 0x40, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x16, 0xA1, 0xA1, 0x81, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x73, 0x05, 0x80, 0x00, 0x00, 0x00, 0x02, 0x00, 0x00, 0x00, 0x04, 0x00, 0x02, 0x08, 0x00, 0x1C, 
-	0x81, 0x80, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x04, 0x02, 0xF5, 0xCC, 
-	0x00, 0x80, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xCC, 0x10, 0x00, 0x00, 0x00, 0x00, 
-	0x01, 0x00, 0x20, 0x02, 0x40, 0x00, 0x00, 0x08, 0x00, 0x09, 0x10, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x25, 0xA0, 0x04, 0x00, 0x00, 0x22, 0x00, 0x00, 0x00, 0x00, 0x18, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x20, 0x73, 0x24, 0x00, 0x00, 0x00, 0x00, 0x02, 0x00, 0x06, 0xA0, 0x00, 0x01, 0x20, 
-	0x00, 0x3D, 0x7D, 0x00, 0x18, 0x00, 0x80, 0x00, 0x00, 0x00, 0xA5, 0x03, 0xFC, 0x00, 0x00, 0x30, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x02, 0x00, 0xCF, 0x40, 0x00, 
-	0x00, 0x00, 0x00, 0x02, 0x00, 0x40, 0x40, 0x00, 0x20, 0x00, 0x3C, 0x02, 0xB0, 0x09, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x02, 0x00, 0x33, 0x04, 0xE8, 0x0A, 0x00, 0x00, 0x00, 0x0C, 0x16, 0xA6, 
-	0x70, 0x00, 0x10, 0x00, 0x46, 0xEA, 0x80, 0x90, 0x00, 0x40, 0x00, 0x20, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x72, 0x00, 0x24, 0x00, 0x40, 0x80, 
-	0xCC, 0x10, 0xF0, 0x00, 0x00, 0x00, 0x00, 0x3F, 0xE3, 0xC6, 0xC0, 0x00, 0x00, 0x22, 0x2F, 0xB5, 
-	0x1D, 0x80, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x15, 0x08, 0x7C, 0x00, 0x40, 0x04, 0x00, 0x0F, 0x00, 0xC3, 0x8A, 0x00, 0x14, 0x00, 
-	0x00, 0x1F, 0x66, 0x64, 0x00, 0x70, 0x03, 0x30, 0xEF, 0x00, 0x00, 0x09, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xB6, 0xC0, 0x34, 
-	0x00, 0x10, 0x03, 0x0C, 0x5B, 0x50, 0xB0, 0x00, 0x00, 0x00, 0x1D, 0xB1, 0x46, 0x40, 0x01, 0x00, 
-	0x12, 0x0C, 0xA0, 0x0A, 0x00, 0x04, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x80, 
-	0x90, 0x20, 0x00, 0x00, 0x00, 0x00, 0x00, 0x04, 0x00, 0x00, 0x03, 0x00, 0x30, 0x17, 0xE5, 0x1C, 
-	0x00, 0x08, 0x00, 0x50, 0x3A, 0x24, 0x20, 0x00, 0x20, 0x08, 0x00, 0x0A, 0x51, 0x90, 0x00, 0xC0, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x03, 0x40, 0x00, 0x00, 0x00, 0x00, 
-	0x03, 0x40, 0x00, 0x00, 0x60, 0x00, 0x0D, 0xDB, 0x50, 0x00, 0x00, 0x80, 0x08, 0x0B, 0xB0, 0x42, 
-	0x80, 0x02, 0x00, 0x08, 0x01, 0x05, 0x08, 0x00, 0x0C, 0x02, 0x3A, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0x80, 0x00, 0x00, 0x00, 0x02, 0x00, 0x00, 0x00, 0x00, 0x03, 
-	0x2F, 0x98, 0x00, 0x00, 0x00, 0x00, 0x3C, 0x86, 0x76, 0x04, 0x00, 0x00, 0x00, 0x14, 0x4A, 0x78, 
-	0x11, 0x00, 0x00, 0x04, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x60, 0x00, 0x00, 0x00, 0x00, 0x0A, 
-	0x00, 0x00, 0x00, 0x03, 0xFC, 0x00, 0x00, 0x40, 0x00, 0x0E, 0x58, 0xF0, 0xA0, 0x00, 0x00, 0x0C, 
-	0x37, 0x22, 0x43, 0x40, 0x00, 0x00, 0x00, 0x02, 0xA0, 0x8D, 0x00, 0x40, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x07, 0xC2, 
-	0x00, 0x00, 0x25, 0x96, 0xA0, 0x19, 0x00, 0x00, 0x00, 0x30, 0x9A, 0xA0, 0x2C, 0x02, 0x00, 0x08, 
-	0x00, 0x1E, 0x18, 0x81, 0x10, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0xC0, 0x00, 0x03, 0x1C, 0x34, 0x00, 0x40, 0x02, 0x5B, 0x70, 0xD1, 0x91, 
-	0xC0, 0x00, 0x0C, 0x0F, 0xA2, 0xC6, 0x40, 0x00, 0x00, 0x08, 0x00, 0x00, 0x9F, 0x00, 0x40, 0x48, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x25, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x40, 0x00, 0x00, 
-	0x7D, 0xE0, 0x00, 0x00, 0x00, 0x1A, 0x4E, 0xC0, 0x01, 0x00, 0x00, 0x02, 0xE7, 0x86, 0x86, 0x6C, 
-	0x00, 0x00, 0x08, 0x21, 0xC0, 0xF0, 0x00, 0xC0, 0x00, 0xC0, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x0A, 0x00, 0x02, 0x03, 0xBC, 0x00, 0x00, 0x40, 0x01, 0xA4, 
-	0xE0, 0x10, 0x80, 0x00, 0x10, 0x0E, 0x75, 0x40, 0x22, 0x00, 0x00, 0x00, 0x00, 0x00, 0x07, 0x0E, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x01, 0xE2, 0x20, 0x00, 0x00, 0x90, 0x00, 0x08, 0x18, 0x00, 0x00, 0x02, 0xA5, 
-	0x03, 0x04, 0x79, 0x02, 0x00, 0x00, 0xFF, 0xC8, 0x79, 0x81, 0x40, 0x08, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x02, 0x80, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x03, 0xC6, 0x01, 0x00, 
-	0x40, 0x40, 0x01, 0x40, 0x90, 0x0A, 0x00, 0x00, 0x4F, 0xF0, 0x38, 0x06, 0x60, 0x10, 0x00, 0x06, 
-	0x86, 0x85, 0x10, 0x00, 0x00, 0x40, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x08, 0x00, 0x01, 0xE7, 0x07, 0x02, 0x80, 0x17, 0xC7, 0xE7, 0x00, 0x00, 
-	0x88, 0x00, 0x0F, 0x52, 0x84, 0x04, 0x50, 0x00, 0x02, 0x14, 0xDB, 0x80, 0x14, 0x08, 0x80, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x03, 
-	0x02, 0x70, 0x00, 0x66, 0x51, 0x7C, 0x10, 0xD8, 0x00, 0x14, 0x00, 0x0F, 0x00, 0xB8, 0x03, 0x00, 
-	0x00, 0x00, 0x02, 0x2D, 0xF9, 0x09, 0x81, 0x40, 0x00, 0x80, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x02, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x08, 0x00, 0x06, 0x00, 0x00, 0x80, 0x00, 0x33, 0x2E, 
-	0xC9, 0x98, 0x01, 0x48, 0x02, 0x00, 0x00, 0x00, 0x00, 0x00, 0x20, 0x00, 0xCC, 0xFE, 0x80, 0x04, 
-	0x00, 0x80, 0x08, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x40, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x01, 0x00, 0x33, 0x7C, 0x00, 0x20, 0x00, 0x02, 0x13, 0xD8, 0x10, 0xA0, 0x01, 0x00, 0x01, 0x00, 
-	0x2C, 0x00, 0x03, 0x04, 0x00, 0x00, 0x0F, 0xBF, 0x00, 0x00, 0x10, 0x00, 0x80, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x16, 0x00, 0x24, 0x00, 0x40, 0x85, 
-	0x00, 0x80, 0x00, 0x15, 0x9E, 0x00, 0x94, 0x02, 0x08, 0x78, 0x0E, 0x04, 0x00, 0x50, 0x02, 0x0F, 
-	0xEF, 0x39, 0xC4, 0x09, 0x48, 0x88, 0x00, 0x00, 0x00, 0x00, 0x00, 0x02, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x57, 0x00, 0x3C, 0x00, 0x00, 0x00, 0x40, 0x08, 0xF1, 0x00, 0x10, 
-	0x08, 0x00, 0x00, 0x00, 0x22, 0x00, 0x00, 0x00, 0x00, 0x46, 0x90, 0x80, 0x81, 0x40, 0x00, 0x80, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x80, 0x00, 0x00, 0x1E, 0x00, 0x00, 0x00, 0x05, 
-	0xC0, 0x51, 0x02, 0x01, 0xA1, 0x7F, 0xC5, 0x00, 0x40, 0x00, 0x12, 0x08, 0x18, 0x06, 0x00, 0x02, 
-	0x00, 0x0A, 0xA8, 0xCC, 0x38, 0x00, 0x80, 0x80, 0x08, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x40, 0x00, 0x40, 0x0A, 0x01, 0x00, 0xC1, 0x00, 0x03, 0x00, 0x3E, 0x02, 0x30, 0x01, 0x1D, 0xFE, 
-	0x50, 0x88, 0x01, 0x00, 0x00, 0x00, 0x80, 0x00, 0x00, 0x14, 0x00, 0x2A, 0x82, 0x00, 0x00, 0x80, 
-	0x58, 0x00, 0x83, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x03, 0x80, 0x00, 0x00, 0x09, 0x21, 0xC0, 0x18, 0x00, 0x00, 0x02, 0x40, 0x80, 
-	0x00, 0x00, 0x02, 0x00, 0x00, 0xF0, 0x0F, 0x10, 0x84, 0x00, 0x00, 0x08, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x40, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0x00, 0x03, 0xC0, 0x70, 0x00, 0x00, 
-	0x02, 0x06, 0x4A, 0x70, 0x00, 0x01, 0x00, 0x00, 0x07, 0x00, 0x00, 0x00, 0x44, 0x00, 0x30, 0xFD, 
-	0xA0, 0x0E, 0x80, 0x10, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0xE0, 0x42, 0x00, 0x00, 0x02, 0x86, 0x83, 0x81, 0x04, 0x00, 
-	0x02, 0x00, 0x00, 0x40, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x10, 0x80, 0x08, 0x00, 0x00, 0x20, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x40, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0x00, 0x03, 0xC2, 
-	0x3C, 0x00, 0x00, 0x00, 0x00, 0x09, 0x08, 0x90, 0x01, 0x00, 0x01, 0x00, 0x30, 0x00, 0x00, 0x04, 
-	0x00, 0x00, 0x00, 0x00, 0x08, 0x00, 0x10, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x10, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0x00, 0x6A, 0x07, 0x0C, 0x00, 0x00, 0x12, 0xC6, 0x91, 
-	0x9D, 0x00, 0x00, 0x02, 0x00, 0x00, 0x00, 0x66, 0x80, 0x00, 0x0A, 0xA9, 0x7A, 0x58, 0x0E, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x40, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 
-	0x00, 0x03, 0x5C, 0x61, 0x00, 0x00, 0x03, 0x4A, 0xEB, 0x01, 0x80, 0x01, 0x00, 0x01, 0x00, 0x3C, 
-	0x03, 0x90, 0x04, 0x00, 0x2A, 0x81, 0x00, 0x00, 0xA0, 0x10, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x08, 0x00, 0x00, 0x00, 0x00, 0x07, 0xC0, 0x00, 0x00, 0x00, 
-	0x00, 0x1C, 0x90, 0x19, 0x00, 0x02, 0x02, 0x40, 0x80, 0x20, 0x00, 0x60, 0x00, 0x00, 0x00, 0x00, 
-	0x91, 0xE0, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x40, 0x00, 0x00, 0x00, 
-	0x10, 0x00, 0x01, 0x00, 0x03, 0xDE, 0x00, 0x00, 0x00, 0x00, 0x04, 0xDA, 0x01, 0x80, 0x05, 0x00, 
-	0x00, 0x01, 0x02, 0x40, 0x00, 0x04, 0x00, 0x00, 0x00, 0x0B, 0x10, 0x00, 0x10, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0x90, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x05, 0xC0, 
-	0x00, 0x02, 0x00, 0x01, 0x54, 0x09, 0x0A, 0x00, 0x08, 0x02, 0x40, 0x80, 0x00, 0x64, 0x01, 0x00, 
-	0x00, 0x00, 0x00, 0x50, 0x01, 0x00, 0x80, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x40, 
-	0x10, 0x03, 0xC0, 0x00, 0x08, 0x01, 0x00, 0x02, 0x80, 0x00, 0x00, 0x20, 0x00, 0x28, 0x2B, 0x11, 
-	0x00, 0x01, 0x00, 0x00, 0x03, 0x00, 0x06, 0x40, 0x24, 0x00, 0x00, 0x00, 0x0F, 0x00, 0x00, 0x10, 
-	0x00, 0x80, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x02, 0x04, 0x16, 0x81, 0xC0, 0x00, 0x00, 0x08, 
-	0x08, 0x04, 0x07, 0x80, 0x02, 0x00, 0x40, 0x00, 0x00, 0x00, 0x00, 0x08, 0x00, 0x8F, 0x5B, 0x06, 
-	0x04, 0x00, 0x20, 0x09, 0x02, 0x00, 0xB8, 0x00, 0x80, 0x80, 0x08, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x40, 0x01, 0x68, 0x00, 0x00, 0x00, 0xC1, 0x00, 0xF3, 0x5C, 0x64, 0x00, 0x41, 0x00, 
-	0x03, 0x40, 0x50, 0x00, 0x01, 0x20, 0x02, 0xFB, 0x3E, 0x43, 0x40, 0x04, 0x00, 0x00, 0x0C, 0x0F, 
-	0x00, 0x21, 0x10, 0x00, 0x80, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x18, 0x7C, 0x07, 0x80, 0x04, 0x00, 0xF3, 0x14, 0xE0, 0x00, 0x00, 0x10, 0x00, 
-	0x00, 0x00, 0x2E, 0x00, 0x00, 0x40, 0x09, 0x68, 0x00, 0x01, 0xD0, 0x01, 0x40, 0x08, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x12, 0x80, 0x40, 
-	0x40, 0x10, 0x00, 0xCC, 0x20, 0x00, 0x00, 0x01, 0x40, 0x00, 0x00, 0x00, 0x63, 0x80, 0x04, 0x00, 
-	0x29, 0x40, 0xA7, 0x0D, 0x00, 0x00, 0x00, 0x80, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x80, 0x00, 0x00, 0x02, 0x00, 0x10, 0x02, 0x00, 0xB3, 0x04, 0xA9, 0x9E, 
-	0x14, 0x00, 0x02, 0x40, 0x80, 0x2E, 0x00, 0x00, 0x20, 0x09, 0x9A, 0x00, 0x00, 0x10, 0x00, 0x80, 
-	0x08, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x40, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0x00, 
-	0x02, 0x3C, 0x02, 0x00, 0x60, 0x00, 0xCC, 0x10, 0x11, 0x00, 0x01, 0x00, 0x00, 0x09, 0x02, 0x40, 
-	0x00, 0x06, 0x00, 0x26, 0x44, 0xF0, 0x0C, 0x00, 0x18, 0x00, 0x80, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x02, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x1D, 0x00, 0x00, 0x00, 0x03, 0xC0, 0x00, 0x00, 0xBC, 
-	0x14, 0x00, 0x1C, 0x00, 0x00, 0x00, 0xA1, 0xD8, 0x00, 0x2A, 0x80, 0x00, 0x09, 0x02, 0x00, 0x00, 
-	0x00, 0x48, 0x00, 0x08, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x40, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x09, 0x00, 0x02, 0x00, 0x7C, 0x00, 0x40, 0x03, 0xC0, 0x20, 0x01, 0x00, 0x01, 0x00, 0x05, 
-	0x29, 0x2F, 0x47, 0x80, 0x04, 0x00, 0x00, 0x04, 0x00, 0x00, 0x01, 0x50, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x04, 0x00, 0x28, 
-	0x10, 0x00, 0x00, 0x00, 0x07, 0x00, 0x14, 0x00, 0x00, 0x64, 0x1E, 0xE0, 0x6C, 0x00, 0x00, 0x08, 
-	0x00, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x40, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x01, 0x00, 0x02, 0x80, 0x01, 0x02, 0x40, 0x00, 0x00, 0x00, 0x00, 0x0A, 
-	0x01, 0x00, 0x06, 0x2D, 0xE9, 0x42, 0x40, 0x04, 0x00, 0x04, 0x00, 0x90, 0x00, 0x01, 0x10, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x08, 0x00, 0x00, 0x40, 
-	0x3A, 0x00, 0x42, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x05, 0x3B, 0x00, 0x2C, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x10, 0xC0, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x40, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0x00, 0x07, 0xBC, 0x34, 0x00, 0x40, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 0x24, 0x02, 0x00, 0x04, 0x00, 0x00, 0x00, 0x00, 0x0B, 
-	0x00, 0x10, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x81, 0x40, 0x00, 0x01, 0xE7, 0x80, 0x00, 0x00, 0x00, 0x00, 0x00, 0x18, 0x00, 0x00, 0x00, 0x01, 
-	0x30, 0x16, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x10, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x40, 0x00, 0x00, 0x00, 0x00, 0x04, 0x01, 0x00, 0x03, 0x82, 0x30, 0x00, 
-	0x40, 0x00, 0x00, 0x00, 0x00, 0x80, 0x15, 0x00, 0x00, 0x2B, 0x3C, 0x00, 0x00, 0x44, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x34, 0x10, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x0C, 0x00, 0x00, 0x01, 0xE7, 0x80, 0x03, 0x80, 0x2C, 0x44, 0x00, 0x00, 0x00, 
-	0x08, 0x00, 0x40, 0x80, 0x00, 0x00, 0x10, 0x20, 0x0A, 0xA9, 0xC0, 0x00, 0x00, 0x40, 0x80, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x40, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0x00, 0x02, 
-	0xC0, 0x00, 0x10, 0x60, 0x01, 0xCA, 0xEE, 0x00, 0x00, 0x01, 0xC0, 0x00, 0x03, 0x00, 0x00, 0x00, 
-	0x06, 0x00, 0x15, 0x42, 0x90, 0x00, 0x00, 0x10, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x08, 0x03, 0xC0, 0x00, 0x80, 0x80, 0x82, 0x0C, 
-	0x00, 0x08, 0x00, 0x04, 0x02, 0x00, 0x07, 0x00, 0x04, 0x00, 0x00, 0x08, 0x00, 0x00, 0x50, 0x01, 
-	0x00, 0x40, 0x00, 0x20, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x33, 0x6C, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 0x02, 0x00, 
-	0x41, 0x42, 0x00, 0x40, 0x00, 0x04, 0x00, 0xA0, 0x00, 0x00, 0x40, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x78, 0x00, 0x00, 0x85, 
-	0x02, 0x80, 0x00, 0xE0, 0x00, 0x00, 0x1C, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x50, 0x00, 0x00, 
-	0x00, 0x50, 0x04, 0x01, 0x08, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x76, 0x40, 0x00, 0x00, 0x00, 0x00, 0x80, 0x00, 0x00, 0x00, 0x00, 
-	0x40, 0x00, 0x00, 0x00, 0x03, 0xC0, 0x00, 0x00, 0x00, 0x00, 0x00, 0x0A, 0x20, 0x04, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x04, 
-	0x00, 0x20, 0x02, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x0C, 0x00, 0x0C, 0x38, 0x00, 0x70, 0x70, 
-	0x00, 0x08, 0x00, 0x01, 0x80, 0xA0, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x02, 0x80, 0x01, 0x00, 0x20, 0x00, 0x00, 0x00, 
-	0x90, 0x00, 0x00, 0x20, 0x80, 0xC1, 0x83, 0x44, 0x08, 0x00, 0x00, 0x04, 0x00, 0x81, 0x00, 0x00, 
-	0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x03, 0xC3, 0x80, 0x00, 0x00, 0x80, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0xC0, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x03, 0xEC, 0x00, 0x00, 0x00, 
-	0x20, 0x40, 0x0B, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0x40, 0x28, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x02, 0x00, 0x00, 0x00, 0x00, 0x80, 0x00, 0x10, 0x0A, 0x00, 0x00, 
-	0x00, 0x00, 0x06, 0x80, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0x00, 0x08, 0x00, 0x20, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x03, 0xFC, 
-	0x00, 0x50, 0x02, 0x00, 0x40, 0x0E, 0x00, 0x00, 0x00, 0x00, 0x0A, 0x50, 0x68, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x76, 0x07, 0xC0, 0x00, 0x00, 0x80, 0x00, 0x10, 
-	0x1A, 0x00, 0x00, 0x02, 0x08, 0x18, 0x06, 0x00, 0x00, 0x00, 0x08, 0x00, 0x00, 0x00, 0x00, 0x08, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x06, 0xFC, 0x38, 0x00, 0x00, 0x00, 0x40, 0x0C, 0x00, 0x00, 0x00, 0x10, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x04, 0x04, 0x00, 0xB0, 0x00, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x07, 0xE0, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x1A, 0x00, 0x00, 0x02, 0x00, 0x02, 0x80, 0x01, 0x10, 0x00, 0x08, 0x20, 0x60, 
-	0x00, 0x04, 0x00, 0x08, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x02, 0xDC, 0x3C, 0x70, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x10, 
-	0x02, 0x00, 0x40, 0x00, 0x20, 0x00, 0x00, 0x00, 0x02, 0x00, 0x00, 0x80, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x05, 0xC3, 
-	0x80, 0x03, 0x00, 0x90, 0x00, 0x00, 0x0A, 0x00, 0x08, 0x02, 0x08, 0x10, 0x00, 0x00, 0x00, 0x00, 
-	0x09, 0x00, 0x00, 0x00, 0x04, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x03, 0x00, 0x40, 0x10, 0x30, 0x40, 0x00, 0x40, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x80, 0x00, 0x00, 0x00, 0x00, 0x00, 0x24, 0x00, 0x00, 0xA0, 0x00, 
-	0x40, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x80, 0x00, 0x18, 0x01, 0x80, 0x00, 
-	0x08, 0x04, 0x00, 0x00, 0x10, 0x00, 0x90, 0x00, 0x08, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x0A, 0x00, 0x40, 0x00, 0x20, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x20, 0x40, 0x0B, 0x10, 0x80, 0x00, 0x00, 0x33, 0x40, 0x34, 0x02, 0x00, 0x00, 
-	0x00, 0x40, 0x70, 0xF0, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x28, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x0D, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x80, 0x00, 0x88, 
-	0x00, 0x00, 0x14, 0x08, 0x2C, 0x00, 0x40, 0x04, 0x00, 0x80, 0x00, 0x08, 0x01, 0x00, 0x10, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x50, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0x08, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x20, 0x80, 0x10, 0x10, 0x00, 0x01, 0x00, 0xF2, 0xAC, 0x35, 
-	0x40, 0x10, 0x00, 0x40, 0x0B, 0x70, 0xE0, 0x01, 0x40, 0x00, 0x00, 0x00, 0x02, 0x80, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x04, 0x44, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x90, 0x00, 0x01, 0x80, 0x00, 0x0C, 0x00, 0x00, 0x07, 0x80, 0x43, 0x00, 0x80, 0x01, 0xAD, 0x9F, 
-	0x00, 0x08, 0x02, 0x08, 0x50, 0x20, 0x00, 0x00, 0x00, 0x08, 0xF2, 0x00, 0x00, 0x00, 0x00, 0xC0, 
-	0xC0, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x20, 0x00, 0x40, 0x00, 0x00, 0x00, 0xC0, 
-	0x03, 0x40, 0x00, 0x00, 0x30, 0x00, 0x80, 0x10, 0xF1, 0xE0, 0x00, 0xC0, 0x00, 0x00, 0x81, 0x40, 
-	0x00, 0x00, 0x00, 0x0F, 0x14, 0x00, 0x00, 0x01, 0x0C, 0x00, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x02, 0x00, 0x00, 0x80, 0x00, 0xE1, 0x80, 0x00, 0x00, 0x00, 0x04, 0x00, 0x08, 0x00, 0x00, 0x80, 
-	0x01, 0x88, 0x01, 0x00, 0x00, 0x00, 0x08, 0x18, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x81, 0x40, 0x00, 0x40, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x20, 0x80, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x03, 0x00, 0x30, 0x00, 0x00, 0x00, 0x80, 0x00, 0xF0, 0xF0, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x10, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x60, 
-	0x50, 0x00, 0x90, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x08, 0x00, 0x20, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x80, 0x00, 0x00, 0x03, 0x3C, 0x35, 0x02, 0x00, 0x00, 0x02, 0x40, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x20, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0x00, 0x00, 
-	0x70, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x82, 0x14, 0x00, 0x00, 0x40, 0x00, 0x00, 
-	0x64, 0x07, 0x84, 0x00, 0x00, 0x90, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x04, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x20, 0x00, 0x20, 0x00, 0x0A, 0x00, 0x00, 0x07, 0x84, 0x20, 0x00, 0x00, 0x00, 0x01, 
-	0x40, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x80, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x10, 0x00, 0x00, 0x80, 0x00, 0xE3, 0x99, 
-	0x80, 0x00, 0x00, 0x03, 0xE0, 0x05, 0x00, 0x00, 0x80, 0x01, 0xA0, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x10, 0x00, 0x00, 0x00, 0x00, 0x78, 0x00, 0x14, 0x08, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x20, 0x80, 0x00, 0x00, 0xB4, 0x00, 0x00, 0x02, 0x1E, 0x00, 0x34, 
-	0x00, 0x00, 0x80, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x20, 0x80, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x82, 
-	0x06, 0x00, 0x00, 0x00, 0x00, 0x00, 0x02, 0x00, 0x48, 0x02, 0x00, 0x80, 0x01, 0x80, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x80, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x20, 0x00, 0x20, 0x00, 0x00, 0x00, 0x00, 0x03, 
-	0xDC, 0x2C, 0x10, 0x20, 0x00, 0x80, 0x10, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x1E, 0x00, 0x00, 0x00, 0x04, 0x00, 0x10, 0x80, 0x00, 0x82, 0x14, 
-	0x05, 0x00, 0x00, 0x00, 0x02, 0x40, 0x00, 0x16, 0x00, 0x00, 0x00, 0x04, 0x02, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x20, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0x01, 
-	0xC0, 0x00, 0xF3, 0x40, 0x02, 0xF0, 0x0A, 0x00, 0x00, 0x20, 0x00, 0xA0, 0x00, 0x08, 0x00, 0x05, 
-	0x03, 0x42, 0xC0, 0x00, 0x10, 0x00, 0x04, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x14, 0x08, 0x60, 0x00, 0x40, 0x85, 
-	0x04, 0x82, 0x16, 0x00, 0x00, 0x00, 0x15, 0x02, 0x5A, 0x03, 0x86, 0x68, 0x00, 0x50, 0x55, 0x40, 
-	0x0E, 0x01, 0xBC, 0x01, 0x40, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x04, 0x53, 0x80, 0x34, 0x00, 0x0A, 0x00, 0x00, 0x20, 0x50, 0xA0, 0xC0, 
-	0x00, 0x15, 0xA0, 0x00, 0x00, 0x00, 0x00, 0xE6, 0x28, 0x0D, 0x00, 0x08, 0x40, 0x00, 0x20, 0x38, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x07, 0x80, 0x01, 0x4C, 0x00, 0x05, 
-	0xE0, 0x01, 0x02, 0x00, 0x80, 0x00, 0x07, 0x0A, 0x00, 0x08, 0x02, 0x08, 0x70, 0x34, 0x70, 0x00, 
-	0x30, 0x0B, 0x30, 0x4E, 0x01, 0x80, 0x08, 0xC2, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0xE0, 0x08, 0x80, 0x03, 0x00, 0x00, 0x00, 0x32, 0x00, 0x40, 0x08, 
-	0x50, 0x01, 0xC0, 0xC1, 0x00, 0x00, 0x81, 0x64, 0x00, 0x02, 0x00, 0x4C, 0xD5, 0x00, 0x00, 0x0C, 
-	0x08, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x07, 0x80, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x50, 0x00, 0x00, 0x80, 0x00, 0x05, 0x0A, 0x2C, 0x00, 0x00, 0xA5, 0x06, 
-	0xC0, 0x2C, 0x02, 0x08, 0x0B, 0x31, 0xD8, 0x01, 0xC0, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x30, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x03, 0x40, 0x3E, 0x80, 0x02, 
-	0x00, 0x40, 0x09, 0x00, 0x00, 0x00, 0x00, 0x06, 0x69, 0x24, 0x06, 0x80, 0x00, 0x00, 0x4C, 0xCE, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x29, 0x40, 
-	0xB8, 0x00, 0x00, 0x00, 0x00, 0x03, 0xE7, 0x00, 0x00, 0x20, 0x90, 0x20, 0x00, 0x00, 0x00, 0x40, 
-	0x00, 0x35, 0x57, 0x20, 0x00, 0x60, 0x00, 0x19, 0x68, 0x01, 0x01, 0x85, 0x88, 0x00, 0x00, 0x34, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x10, 0x00, 0x0B, 0xF0, 0x00, 0x00, 0x00, 0x03, 0xAC, 
-	0x00, 0x30, 0x00, 0x00, 0x00, 0x40, 0x00, 0x00, 0x08, 0x00, 0x43, 0xFF, 0xA2, 0xC0, 0x00, 0x00, 
-	0x00, 0x29, 0x40, 0x81, 0x08, 0xA1, 0x40, 0x00, 0x00, 0x80, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x34, 0xE0, 0x40, 0x00, 0x81, 0x80, 0x00, 0xA0, 
-	0x00, 0x00, 0x00, 0x00, 0x81, 0x87, 0x40, 0x28, 0x30, 0x00, 0x00, 0x40, 0x6E, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x08, 0x07, 0x5E, 0x34, 0x00, 0x00, 0x00, 0x80, 0x00, 0x00, 0x01, 0x80, 0x10, 0x0C, 0x37, 0x20, 
-	0x03, 0xC0, 0x00, 0x00, 0x04, 0x3D, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0xAF, 0x60, 0x80, 0x00, 0x00, 0x00, 0x00, 0x05, 0xE7, 0x90, 0x00, 0x80, 
-	0x80, 0x00, 0x10, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x06, 0x29, 0x02, 0x00, 0x00, 0x00, 0x00, 
-	0x98, 0x00, 0x08, 0x08, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x40, 0x61, 0xCB, 
-	0x00, 0x0A, 0x00, 0x00, 0x03, 0xC2, 0x3A, 0x00, 0x00, 0x00, 0x40, 0x09, 0x00, 0x00, 0x10, 0x00, 
-	0x00, 0x00, 0x00, 0x44, 0x27, 0x10, 0x00, 0x00, 0x00, 0x01, 0x00, 0x00, 0x40, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x1E, 0x00, 0x00, 0x00, 0x01, 0xC7, 
-	0x80, 0x03, 0x80, 0x82, 0x16, 0x00, 0x00, 0x00, 0x00, 0x00, 0xAF, 0x12, 0xC0, 0x3C, 0x00, 0x30, 
-	0x01, 0x68, 0x0D, 0x00, 0x00, 0x00, 0x80, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 0x03, 0x00, 0x40, 0x00, 0x32, 0x00, 0x00, 0x00, 0x00, 
-	0x01, 0x80, 0x00, 0x00, 0x50, 0xE8, 0x07, 0x80, 0x03, 0x44, 0x00, 0x00, 0x80, 0x00, 0x80, 0x0C, 
-	0x00, 0x00, 0x11, 0x03, 0x01, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x20, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x80, 0x00, 0x00, 0x00, 0x00, 0x00, 0x02, 0x00, 0x00, 0x00, 0x00, 0x02, 
-	0x80, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x04, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x1E, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x08, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x20, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x22, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x20, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x08, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x08, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x30, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x10, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x03, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x30, 0x00, 0x00, 0x00, 0x00, 0x0C, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x0C, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x04, 0x00, 0x40, 
-	0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x80, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x60, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x80, 0x00, 
-	0x08, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x03, 0xC0, 
-	0x08, 0x00, 0x00, 0x00, 0x00, 0x02, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x08, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x20, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x80, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x80, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x04, 0x00, 0x00, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x80, 0x00, 0x00, 0x00, 0x00, 0x00, 0x0A, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x02, 0x10, 0x02, 0x80, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x50, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x20, 0x00, 0x00, 0x00, 0x00, 0x02, 0x00, 0x00, 0x00, 0x08, 0x00, 0x00, 
-	0x08, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x06, 0x00, 0x30, 
-	0x04, 0x20, 0x00, 0x04, 0x08, 0x28, 0x2C, 0x58, 0xA0, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x24, 0x08, 0x00, 0x00, 0x00, 0x00, 0x00, 0x81, 0x4C, 
-	0x1D, 0x81, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x10, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x20, 0x00, 0x00, 0x09, 0x0A, 0xCF, 0x00, 0xA0, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0xA0, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x80, 0xA0, 0x40, 0x15, 0x81, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x02, 0x10, 0x03, 0x00, 0x20, 0x00, 0x00, 0x48, 0x14, 0x20, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x20, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x81, 0x4C, 0xC1, 0x1A, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x09, 0xFA, 0xCF, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x04, 0xAF, 0x40, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x0C, 0x02, 0x00, 0x00, 0x00, 0x34, 0x00, 0x24, 
-	0x08, 0x14, 0x30, 0x00, 0x00, 0x00, 0xC0, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x38, 
-	0x00, 0x00, 0x80, 0x20, 0x87, 0x00, 0x00, 0x40, 0x02, 0x00, 0x81, 0x4E, 0xC0, 0x00, 0x00, 0x0C, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x0B, 0x00, 0x00, 0x02, 0x00, 0x90, 0x00, 
-	0x00, 0x00, 0x04, 0x09, 0x0A, 0xCE, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x01, 0x40, 0x24, 0x08, 0x00, 0xE0, 0x00, 0x05, 0x00, 0xA0, 0x40, 0x00, 
-	0x00, 0x00, 0x14, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x3C, 0x02, 0x80, 0x00, 0x00, 0x00, 0x02, 
-	0x20, 0x04, 0x2C, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x40, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x4B, 0xD4, 0x5D, 0x50, 0x00, 0x00, 0x00, 0x20, 0x00, 0x3A, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x40, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x08, 0x00, 0x00, 0x00, 0x10, 0x00, 0x00, 0x84, 0x00, 0xF0, 0x00, 
-	0x00, 0x00, 0x00, 0x41, 0x7B, 0x00, 0x00, 0x00, 0x02, 0x40, 0x00, 0x20, 0x00, 0x00, 0x00, 0x04, 
-	0x02, 0x80, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xC0, 
-	0x00, 0x00, 0x00, 0x80, 0x08, 0x08, 0x00, 0x00, 0x01, 0x80, 0x00, 0x80, 0x00, 0x07, 0xF1, 0x62, 
-	0x00, 0x00, 0x00, 0x82, 0x16, 0x00, 0x00, 0x00, 0x00, 0x80, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x08, 0x00, 0x04, 0x2B, 0xC3, 0xBF, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x07, 0x00, 0x00, 0x00, 0x00, 0x81, 0x93, 0x44, 0x28, 0x80, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0xAA, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x09, 0x69, 0xC9, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xB0, 0x00, 0x00, 0x08, 0x04, 
-	0x20, 0x00, 0x60, 0x50, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x4C, 0x00, 0x0C, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x08, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x04, 0x80, 0x2C, 0x00, 0x00, 0x00, 0x00, 0x00, 0x10, 0x03, 0xC0, 0x28, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x04, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x09, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x20, 0x00, 0x00, 0x06, 0xC0, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x02, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x0F, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x40, 0x00, 0x84, 0x00, 0xF1, 0x90, 0x00, 0x00, 0x00, 0x10, 0x03, 0x94, 0x00, 
-	0x00, 0x04, 0x00, 0x01, 0x40, 0x00, 0x01, 0xC0, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x80, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x02, 0x00, 0x08, 0x00, 
-	0x00, 0xD9, 0xA0, 0x00, 0x00, 0x20, 0x00, 0x06, 0x06, 0x87, 0x00, 0x00, 0x90, 0x20, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x29, 0x15, 0x00, 0x08, 0x00, 0x00, 0x00, 0x20, 
-	0x00, 0x00, 0x40, 0x00, 0x00, 0x00, 0x01, 0xC0, 0x00, 0x00, 0x00, 0x00, 0x00, 0x30, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x78, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x02, 0x93, 0x6A, 0x00, 0x90, 0x00, 0x00, 0x00, 0x00, 0x68, 0x06, 0x00, 0x00, 0x00, 0x10, 
-	0x00, 0x05, 0x0A, 0x00, 0x00, 0x0C, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x08, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x80, 0x00, 0x00, 0x00, 0x00, 
-	0x08, 0x00, 0x58, 0x32, 0x1C, 0x20, 0x00, 0x30, 0x00, 0x00, 0x00, 0x00, 0xA8, 0x08, 0xC4, 0xC0, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xC0, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x48, 0x20, 0x60, 0x50, 0x00, 0x00, 0x80, 0x0A, 0x5B, 0x70, 0x00, 0x00, 
-	0x03, 0x00, 0x00, 0x00, 0x07, 0x80, 0x01, 0x08, 0x80, 0x40, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x40, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0x80, 0x0C, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xD0, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x07, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x02, 
-	0x01, 0x40, 0x00, 0x00, 0x00, 0x00, 0x00, 0x09, 0x00, 0x00, 0x00, 0xE0, 0x01, 0x40, 0x24, 0x00, 
-	0x00, 0x00, 0x00, 0x05, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x14, 0x00, 0x02, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x80, 0x00, 0x00, 0x00, 0x00, 0x00, 0x08, 0x80, 
-	0x00, 0x09, 0x1C, 0xD5, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x04, 0x3C, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x04, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x78, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 0x62, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x20, 0x85, 0x02, 0x00, 0x40, 0x00, 0x80, 0x82, 0x14, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x08, 0x00, 0x0D, 0x00, 0x00, 0x00, 0x00, 0x0C, 0x77, 0x00, 0x28, 0x00, 
-	0x00, 0x01, 0xF1, 0x6B, 0x30, 0x00, 0x00, 0x04, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x20, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x80, 0x00, 0x00, 0x00, 0x00, 0x00, 0x08, 0x00, 0x08, 
-	0x80, 0x00, 0x00, 0x00, 0x64, 0xE7, 0x70, 0x00, 0x40, 0x00, 0x00, 0xAF, 0x04, 0x08, 0x00, 0x00, 
-	0x00, 0x80, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x0F, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x0C, 0x34, 0x0D, 0x00, 0x00, 0x00, 0x00, 0x56, 0x32, 
-	0x80, 0x28, 0x40, 0x00, 0x00, 0x00, 0x00, 0x10, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x50, 0x00, 
-	0x00, 0xC3, 0x60, 0x80, 0x00, 0x00, 0x00, 0x2A, 0x6F, 0x34, 0x06, 0x80, 0x50, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x0C, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x2E, 0x0D, 
-	0xB0, 0x00, 0xA0, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0x20, 0x75, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x8D, 0x73, 0x14, 0x28, 0x00, 0x00, 0x03, 0x6B, 0xF0, 0x00, 0x00, 0x00, 0x04, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x08, 0x01, 0xEB, 0x5B, 0x01, 0xE0, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x40, 0x00, 0x02, 0x06, 0x0A, 0x00, 0x00, 0x00, 0x08, 0x24, 0xE1, 0x83, 0x60, 0x00, 0x00, 
-	0x00, 0xB6, 0xA5, 0x80, 0x00, 0x00, 0x00, 0x00, 0x02, 0x00, 0x00, 0x00, 0x01, 0xC4, 0x00, 0x00, 
-	0x02, 0x2E, 0x16, 0xBB, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x40, 0x00, 0x04, 0x00, 0xA0, 
-	0x00, 0x00, 0x00, 0x00, 0xA5, 0x02, 0xC0, 0x28, 0x82, 0x00, 0x00, 0x00, 0x00, 0x00, 0xD0, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x20, 0x38, 0x60, 0x00, 0x01, 0xE8, 0x4A, 0x80, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x08, 0x00, 0x00, 0x00, 0x00, 0x00, 0x20, 0x20, 0xA7, 0xBC, 
-	0x02, 0xD0, 0x40, 0x00, 0x00, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 0x3C, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x1D, 0x25, 0xA5, 0x9B, 0x00, 0x00, 0x10, 0x67, 0x7B, 0x02, 0x40, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x50, 0x00, 0x00, 0x01, 0x80, 0x30, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x78, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0xE8, 0x6A, 0x51, 0xE0, 0x00, 0x00, 
-	0x2A, 0x73, 0xA1, 0x42, 0x80, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x0C, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x20, 0x00, 0x12, 0x00, 0x00, 0x00, 0x00, 0x1F, 0x00, 0x28, 0x00, 0x00, 0x00, 
-	0x28, 0x00, 0x00, 0x01, 0x27, 0xAB, 0x0D, 0x00, 0x08, 0x04, 0xE3, 0xD4, 0x00, 0x40, 0x00, 0x20, 
-	0x00, 0x00, 0x00, 0xD8, 0xA0, 0x14, 0xC4, 0x80, 0x00, 0x00, 0x00, 0x00, 0x16, 0x00, 0x02, 0x30, 
-	0x00, 0x00, 0x00, 0x11, 0xF0, 0x00, 0xC0, 0x00, 0x00, 0x01, 0x70, 0x00, 0x00, 0x03, 0x59, 0xF0, 
-	0x90, 0x00, 0x81, 0x2E, 0x3F, 0x70, 0x02, 0xA0, 0x02, 0x00, 0x00, 0x00, 0x0F, 0x00, 0x80, 0x88, 
-	0x98, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0x00, 0xA0, 0x7D, 0x00, 0x0E, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x3C, 0x0B, 0x8A, 0x00, 0x00, 0x08, 0x5F, 0x33, 0x80, 
-	0x2C, 0x00, 0x00, 0x00, 0x00, 0x00, 0x90, 0x00, 0x01, 0x00, 0x07, 0x00, 0x00, 0x00, 0x00, 0x1E, 
-	0x00, 0x00, 0x40, 0x2A, 0x04, 0x08, 0x00, 0x00, 0x01, 0x40, 0x00, 0x00, 0x00, 0x00, 0x00, 0x09, 
-	0x02, 0x00, 0xB8, 0x00, 0x01, 0x40, 0x68, 0xB5, 0x70, 0x00, 0x00, 0x05, 0x00, 0x00, 0x00, 0x08, 
-	0x00, 0x00, 0x10, 0x00, 0x02, 0x00, 0x20, 0xA0, 0x6C, 0x00, 0x00, 0x00, 0x00, 0x80, 0xC6, 0x0B, 
-	0x00, 0xBC, 0x00, 0x00, 0x00, 0x00, 0x20, 0x00, 0x00, 0x00, 0x02, 0x07, 0x0C, 0x20, 0x00, 0x04, 
-	0x47, 0x33, 0x3C, 0x2E, 0x00, 0x00, 0x03, 0xD4, 0xF9, 0xF0, 0xE0, 0x00, 0x04, 0x00, 0x01, 0x02, 
-	0x00, 0x36, 0x00, 0x00, 0x00, 0x00, 0x48, 0x0F, 0xC0, 0xF0, 0x04, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x10, 0x00, 0x08, 0x21, 0xC0, 0xD8, 0x14, 0x00, 0x00, 0x2E, 0x23, 0x3C, 0x00, 0x00, 0x00, 0x00, 
-	0xBD, 0xD6, 0xE8, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x04, 0x01, 
-	0x3E, 0x0E, 0x80, 0x00, 0x00, 0x18, 0x00, 0x00, 0x00, 0x00, 0x04, 0x05, 0x03, 0x16, 0x00, 0x00, 
-	0x00, 0x11, 0x00, 0x42, 0x72, 0xC0, 0x60, 0x00, 0x70, 0x03, 0xC5, 0xF0, 0x00, 0xA0, 0x01, 0x04, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0x02, 0x20, 0x0B, 0xD3, 0x41, 0x00, 0x00, 0x00, 0x80, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x33, 0xC0, 0x18, 0x00, 0x00, 0x08, 0x00, 0x08, 0x30, 0x03, 
-	0x80, 0x03, 0x00, 0xBC, 0x6C, 0xA5, 0x18, 0x00, 0x00, 0x80, 0x00, 0x00, 0x2A, 0x50, 0x71, 0xC0, 
-	0x00, 0x04, 0x00, 0x00, 0x00, 0x00, 0x10, 0x1C, 0x10, 0x00, 0x00, 0x00, 0x00, 0x44, 0x00, 0x00, 
-	0x0F, 0xA0, 0x00, 0x00, 0x10, 0x00, 0x0F, 0x07, 0xA4, 0x20, 0x00, 0x40, 0x02, 0xE1, 0x79, 0x08, 
-	0x84, 0x01, 0x00, 0x00, 0x00, 0x12, 0x00, 0x03, 0xE0, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x80, 0x00, 0x00, 0x00, 0x00, 0x00, 0x52, 0x00, 0x12, 0x01, 0x6A, 0x10, 0x00, 0x00, 0x00, 0x00, 
-	0xA7, 0x3A, 0x03, 0x40, 0x00, 0x00, 0x1E, 0xA6, 0x87, 0x80, 0x20, 0x00, 0x08, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x03, 0xC0, 0x04, 0x01, 0x09, 0x0C, 0x90, 0x00, 0x00, 0x10, 0x00, 0x00, 0x00, 0x00, 
-	0x14, 0x00, 0x01, 0x17, 0x01, 0x08, 0x18, 0x10, 0x00, 0xFD, 0x56, 0x80, 0x20, 0x00, 0x40, 0x03, 
-	0x1E, 0xDC, 0x00, 0xB0, 0x01, 0x04, 0x80, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x02, 
-	0x94, 0x0E, 0x00, 0x80, 0x00, 0x00, 0x00, 0x00, 0x00, 0x02, 0x00, 0x00, 0x11, 0xF8, 0x80, 0x00, 
-	0x00, 0x00, 0x2B, 0xD1, 0xB5, 0x66, 0x40, 0x20, 0x00, 0x10, 0xAD, 0xA1, 0x09, 0x00, 0x00, 0x00, 
-	0x02, 0x00, 0x00, 0x00, 0x03, 0xC0, 0x00, 0x04, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x90, 0x00, 
-	0x00, 0x00, 0x00, 0x04, 0x00, 0x08, 0x00, 0x00, 0x0E, 0x00, 0x10, 0x00, 0x09, 0x3E, 0x84, 0x20, 
-	0x45, 0x40, 0x00, 0x09, 0xCC, 0x10, 0xD0, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x20, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x80, 0x14, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x08, 0x00, 
+	0xFF, 0x0E, 0xFF, 0x00, 0x00, 0xFF, 0x7E, 0xAA, 0x99, 0x7E, 0x51, 0x00, 0x01, 0x05, 0x92, 0x00, 
+	0x20, 0x62, 0x01, 0x4B, 0x72, 0x00, 0x90, 0x82, 0x00, 0x00, 0x11, 0x00, 0x01, 0x01, 0x00, 0x01, 
+	0x00, 0x08, 0x30, 0x10, 0x01, 0x60, 0x07, 0x00, 0x2F, 0x40, 0x0F, 0x25, 0x00, 0x09, 0x02, 0x01, 
+	0x00, 0x12, 0x02, 0x07, 0x00, 0x1F, 0x70, 0x23, 0x00, 0x08, 0x11, 0x08, 0x53, 0x00, 0x00, 0x50, 
+	0x00, 0x01, 0x03, 0x00, 0x0F, 0x01, 0x00, 0x07, 0x2F, 0x07, 0x80, 0x1E, 0x00, 0x09, 0x08, 0x01, 
+	0x00, 0xFF, 0x02, 0x80, 0x00, 0x0C, 0x00, 0x00, 0x20, 0x01, 0xE0, 0x01, 0x50, 0x00, 0x00, 0x80, 
+	0x08, 0x00, 0x03, 0xC0, 0x29, 0x00, 0x05, 0x30, 0x0F, 0x00, 0x00, 0x1C, 0x00, 0x30, 0x02, 0x00, 
+	0x36, 0x0E, 0x00, 0x33, 0xF0, 0x40, 0xF8, 0x18, 0x00, 0x12, 0x04, 0x07, 0x00, 0x00, 0x96, 0x00, 
+	0x02, 0x99, 0x00, 0x0A, 0x0C, 0x00, 0x0F, 0x01, 0x00, 0x21, 0x0F, 0x53, 0x00, 0x00, 0x12, 0x30, 
+	0x0C, 0x00, 0x01, 0x9E, 0x00, 0x2F, 0x05, 0x03, 0x59, 0x00, 0x25, 0x08, 0x01, 0x00, 0x31, 0xF0, 
+	0x00, 0xD0, 0x08, 0x00, 0x03, 0xF2, 0x00, 0x1F, 0x0F, 0xAE, 0x00, 0x05, 0x90, 0x40, 0x08, 0x00, 
+	0x05, 0x00, 0x00, 0x01, 0x00, 0x0C, 0x29, 0x01, 0x5F, 0x04, 0x00, 0x78, 0x00, 0x7C, 0x59, 0x00, 
+	0x0C, 0x21, 0x01, 0xE0, 0x07, 0x00, 0x01, 0xAC, 0x01, 0x0F, 0x53, 0x00, 0x04, 0x02, 0x28, 0x00, 
+	0x40, 0x00, 0x36, 0x00, 0x18, 0x53, 0x00, 0x1F, 0xF0, 0x51, 0x00, 0x0C, 0x08, 0x33, 0x00, 0x0F, 
+	0x01, 0x00, 0x05, 0x02, 0xF0, 0x01, 0x03, 0x43, 0x02, 0x0F, 0x7B, 0x00, 0x00, 0x30, 0x0C, 0x18, 
+	0x10, 0x18, 0x00, 0x01, 0x27, 0x00, 0x31, 0x20, 0x00, 0x04, 0x29, 0x00, 0x20, 0x16, 0x90, 0x4D, 
+	0x01, 0x13, 0x40, 0x3C, 0x00, 0x02, 0x01, 0x00, 0xA0, 0x34, 0x01, 0x49, 0xDB, 0x00, 0x00, 0x18, 
+	0x50, 0x05, 0x28, 0x4F, 0x00, 0x11, 0xC0, 0x4A, 0x00, 0x80, 0x03, 0x02, 0x94, 0x80, 0x00, 0x00, 
+	0x02, 0x80, 0x3A, 0x00, 0x04, 0x01, 0x00, 0x60, 0x20, 0x00, 0x07, 0x01, 0xDC, 0x04, 0x32, 0x02, 
+	0x82, 0x90, 0x40, 0xA0, 0x00, 0x00, 0x01, 0xC1, 0x04, 0x47, 0x00, 0x76, 0x10, 0x00, 0x00, 0x16, 
+	0x00, 0x5A, 0x33, 0x53, 0x00, 0xC3, 0x08, 0x00, 0x00, 0x6C, 0x09, 0xC0, 0x00, 0x20, 0x00, 0x50, 
+	0x95, 0x3C, 0x3B, 0x00, 0x10, 0x20, 0x4D, 0x02, 0x20, 0x20, 0x05, 0x61, 0x00, 0x23, 0x0C, 0xC0, 
+	0xE5, 0x01, 0xD0, 0x00, 0x00, 0x00, 0x44, 0x00, 0x60, 0x7E, 0x0A, 0x54, 0x01, 0x00, 0x43, 0x8E, 
+	0x6E, 0x00, 0x90, 0x06, 0x00, 0x00, 0x04, 0x01, 0x00, 0x00, 0x0A, 0x00, 0x24, 0x01, 0x3A, 0x36, 
+	0x68, 0x08, 0x53, 0x00, 0x80, 0x20, 0xE0, 0x00, 0x00, 0x30, 0x02, 0x00, 0x09, 0x2D, 0x02, 0xFF, 
+	0x01, 0x03, 0x40, 0x08, 0x20, 0x70, 0x00, 0x01, 0x07, 0x00, 0x20, 0x04, 0x00, 0x01, 0x40, 0x00, 
+	0xAC, 0xC2, 0x02, 0x00, 0x21, 0x03, 0x8F, 0x3E, 0x00, 0x12, 0x0C, 0x5A, 0x02, 0x87, 0x80, 0x00, 
+	0x10, 0x40, 0x00, 0x1E, 0x68, 0x09, 0x53, 0x00, 0x05, 0x01, 0x00, 0x22, 0x91, 0xE7, 0x08, 0x00, 
+	0x00, 0x29, 0x00, 0x23, 0xD0, 0x07, 0xF1, 0x00, 0x19, 0x8C, 0x53, 0x00, 0x40, 0xC0, 0x1E, 0xCC, 
+	0x50, 0xF6, 0x03, 0x00, 0xA6, 0x00, 0xA1, 0x00, 0x1E, 0x00, 0x04, 0x04, 0x00, 0x08, 0x00, 0x03, 
+	0x8C, 0x4D, 0x02, 0x08, 0xA6, 0x00, 0x00, 0x1E, 0x00, 0x20, 0x28, 0xC5, 0x15, 0x00, 0xF1, 0x00, 
+	0x0D, 0x00, 0x00, 0x00, 0x2C, 0x00, 0x20, 0x04, 0x20, 0x00, 0x08, 0x10, 0x00, 0x7C, 0xCC, 0x1C, 
+	0x00, 0x18, 0xBC, 0x53, 0x00, 0x03, 0xB7, 0x01, 0x30, 0x00, 0x00, 0x98, 0x0C, 0x00, 0x80, 0x40, 
+	0x00, 0x24, 0x00, 0x00, 0x00, 0x1A, 0x70, 0xA6, 0x00, 0x39, 0x00, 0x00, 0xE8, 0x53, 0x00, 0x12, 
+	0x2C, 0x07, 0x00, 0x10, 0x90, 0x53, 0x00, 0x50, 0x14, 0x28, 0x0A, 0x00, 0x21, 0x0E, 0x00, 0x10, 
+	0x80, 0x44, 0x01, 0x3A, 0x02, 0x82, 0x0C, 0xF9, 0x00, 0x31, 0x20, 0x08, 0x14, 0x1D, 0x00, 0x01, 
+	0x0D, 0x00, 0x72, 0x10, 0x24, 0x00, 0x00, 0x05, 0x9B, 0x58, 0x53, 0x03, 0x0C, 0xF9, 0x00, 0x20, 
+	0xCA, 0x42, 0x06, 0x00, 0x02, 0x55, 0x03, 0x02, 0xA8, 0x04, 0x13, 0xA0, 0x7C, 0x03, 0x17, 0xEC, 
+	0x53, 0x00, 0x92, 0xC0, 0x00, 0x00, 0x4E, 0x08, 0x14, 0x07, 0x00, 0x07, 0xB3, 0x00, 0x10, 0x40, 
+	0x8E, 0x02, 0x00, 0x51, 0x02, 0x6A, 0x10, 0x10, 0x00, 0x14, 0x01, 0x68, 0x53, 0x00, 0x80, 0x20, 
+	0x0B, 0x81, 0x00, 0x70, 0x00, 0x70, 0x93, 0x0C, 0x00, 0x01, 0x00, 0x05, 0x30, 0x00, 0x50, 0x0B, 
+	0x9F, 0x01, 0x01, 0xF2, 0x01, 0x07, 0x28, 0x00, 0x50, 0x16, 0x00, 0x7E, 0x0A, 0x54, 0x6C, 0x01, 
+	0x70, 0x80, 0x00, 0x88, 0x01, 0x67, 0xB6, 0xAA, 0xE3, 0x02, 0x99, 0x98, 0x12, 0x52, 0x00, 0x08, 
+	0x00, 0x20, 0x29, 0xC8, 0x53, 0x00, 0x21, 0x04, 0x2A, 0x48, 0x00, 0xF1, 0x01, 0x70, 0x05, 0x20, 
+	0x00, 0x00, 0x1C, 0x40, 0x78, 0x42, 0x00, 0x40, 0x00, 0x01, 0xE7, 0x61, 0x68, 0x37, 0x02, 0x31, 
+	0x0C, 0xC0, 0x44, 0x15, 0x02, 0x30, 0x08, 0x02, 0x05, 0xB1, 0x01, 0xA1, 0x55, 0xCA, 0x50, 0x02, 
+	0x84, 0x00, 0x00, 0xF8, 0x00, 0xE0, 0xEB, 0x02, 0xD3, 0x00, 0x80, 0x08, 0x19, 0x53, 0xA4, 0x00, 
+	0x0E, 0x00, 0x00, 0x01, 0xE8, 0x33, 0x6D, 0x01, 0x80, 0x32, 0xD0, 0x80, 0x18, 0x00, 0x00, 0x37, 
+	0x70, 0x71, 0x00, 0xF2, 0x00, 0xF0, 0x0F, 0x28, 0x08, 0x00, 0x3C, 0x01, 0x40, 0x08, 0x01, 0x20, 
+	0x00, 0x91, 0x90, 0xEE, 0x0F, 0x03, 0x01, 0xA6, 0x00, 0xF0, 0x03, 0x10, 0x00, 0x00, 0x13, 0xFA, 
+	0x81, 0x00, 0xC0, 0x01, 0x66, 0x16, 0x1A, 0x50, 0x01, 0x01, 0x00, 0x1E, 0x80, 0x05, 0x01, 0x11, 
+	0x60, 0x98, 0x02, 0x30, 0x19, 0x06, 0x4C, 0x23, 0x00, 0x32, 0x66, 0x4B, 0x58, 0x53, 0x00, 0xE0, 
+	0x08, 0x04, 0x28, 0x00, 0x0C, 0x00, 0x34, 0x29, 0x4D, 0x99, 0x20, 0x30, 0x00, 0x11, 0x9F, 0x01, 
+	0xF0, 0x01, 0x00, 0x21, 0xC0, 0x08, 0x00, 0x10, 0x00, 0x01, 0x90, 0x64, 0xCC, 0x00, 0x08, 0x00, 
+	0x02, 0x57, 0x16, 0x04, 0x05, 0xE9, 0x01, 0x80, 0x02, 0x00, 0x05, 0x8A, 0x04, 0x00, 0x00, 0x03, 
+	0xEB, 0x02, 0x21, 0x03, 0x60, 0xF2, 0x01, 0xC7, 0x50, 0x00, 0x78, 0x2F, 0x44, 0x00, 0x00, 0x16, 
+	0x29, 0x40, 0x5A, 0x60, 0x8C, 0x04, 0xE0, 0x04, 0x2C, 0x10, 0xA0, 0x00, 0x00, 0x00, 0x78, 0x8D, 
+	0x00, 0x00, 0x0C, 0x1C, 0x38, 0xF1, 0x02, 0xC1, 0x02, 0x00, 0x00, 0x3E, 0xF4, 0x60, 0x04, 0x00, 
+	0x00, 0x02, 0x05, 0xA1, 0xE3, 0x01, 0x04, 0x01, 0x00, 0x32, 0x21, 0xAA, 0x04, 0xB1, 0x02, 0x10, 
+	0x0A, 0x08, 0x00, 0x00, 0x6E, 0x01, 0xA1, 0x0A, 0x00, 0x59, 0x80, 0x00, 0x06, 0x06, 0x38, 0x01, 
+	0x66, 0xB3, 0x03, 0x05, 0x7E, 0x00, 0x20, 0x50, 0x50, 0xDF, 0x00, 0x01, 0xF2, 0x01, 0x21, 0x01, 
+	0x40, 0xE4, 0x03, 0x30, 0x0D, 0x22, 0x64, 0x23, 0x00, 0x20, 0x04, 0xB9, 0x14, 0x04, 0x20, 0x00, 
+	0x00, 0xD6, 0x00, 0x00, 0x01, 0x00, 0x82, 0x06, 0x18, 0x14, 0x10, 0x00, 0x01, 0x00, 0xB8, 0xC8, 
+	0x01, 0x00, 0xA6, 0x00, 0xA2, 0x18, 0x00, 0x00, 0x90, 0x00, 0x40, 0x06, 0x05, 0xCE, 0x11, 0x22, 
+	0x00, 0x03, 0xA5, 0x01, 0x30, 0x30, 0x2A, 0x81, 0x53, 0x00, 0x01, 0xD5, 0x03, 0x00, 0x8C, 0x01, 
+	0x50, 0x40, 0x3A, 0x00, 0x00, 0x34, 0x96, 0x01, 0x39, 0x22, 0x2E, 0xC4, 0x5A, 0x05, 0x33, 0x02, 
+	0x20, 0xAA, 0x85, 0x03, 0x04, 0x53, 0x00, 0xC8, 0x01, 0x08, 0x7F, 0x03, 0x40, 0x00, 0x00, 0x3C, 
+	0x60, 0x01, 0x66, 0x61, 0x2B, 0x00, 0x20, 0x02, 0x40, 0xA6, 0x00, 0x01, 0x92, 0x02, 0x10, 0x02, 
+	0xBF, 0x01, 0xE1, 0x80, 0x00, 0x09, 0xE0, 0x78, 0x34, 0x00, 0x00, 0xA2, 0xC4, 0x34, 0xD9, 0x92, 
+	0x08, 0x13, 0x06, 0x00, 0xA6, 0x02, 0x00, 0x98, 0x02, 0xC0, 0x9D, 0x10, 0x01, 0x00, 0x03, 0x89, 
+	0x80, 0x00, 0x40, 0x01, 0x40, 0x20, 0x9F, 0x01, 0xA0, 0x09, 0x80, 0x72, 0x84, 0x80, 0x04, 0x00, 
+	0x14, 0x03, 0xCE, 0x3C, 0x01, 0x00, 0xDF, 0x00, 0x03, 0x37, 0x04, 0x71, 0x3B, 0xD1, 0x00, 0x90, 
+	0x00, 0x00, 0xD3, 0x53, 0x00, 0x90, 0xC0, 0x08, 0x00, 0x40, 0x00, 0x10, 0x00, 0xEC, 0x48, 0x21, 
+	0x00, 0x22, 0x0E, 0x00, 0x2A, 0x00, 0x40, 0x18, 0x05, 0x82, 0x05, 0x4A, 0x02, 0xF4, 0x0C, 0xA6, 
+	0x0A, 0x54, 0x01, 0x0B, 0xA0, 0x00, 0x00, 0x40, 0x82, 0x00, 0x02, 0xC0, 0x00, 0x00, 0x02, 0x13, 
+	0x0F, 0x98, 0x37, 0x94, 0x00, 0x08, 0x00, 0x14, 0x02, 0xDA, 0x97, 0x02, 0x20, 0x02, 0xE0, 0xAE, 
+	0x00, 0x20, 0x3D, 0x40, 0xFD, 0x01, 0x51, 0x00, 0x0D, 0x24, 0x00, 0x4C, 0xB8, 0x03, 0x50, 0x00, 
+	0x80, 0x11, 0xE9, 0xC0, 0x97, 0x01, 0x30, 0x02, 0xB7, 0xB0, 0x0F, 0x00, 0x00, 0x5E, 0x01, 0xF2, 
+	0x01, 0x2B, 0x01, 0x00, 0x20, 0x01, 0x40, 0x1F, 0xAA, 0x04, 0x80, 0x80, 0x00, 0x00, 0x70, 0x40, 
+	0x24, 0xCF, 0x05, 0xC3, 0x80, 0x05, 0x99, 0x93, 0x04, 0x80, 0x02, 0x00, 0x26, 0x66, 0x0A, 0x55, 
+	0x1C, 0x02, 0x22, 0x07, 0xB0, 0xBC, 0x05, 0xB1, 0xA0, 0x01, 0x21, 0x00, 0x00, 0xFB, 0x3C, 0x08, 
+	0xA0, 0x00, 0x38, 0xB9, 0x01, 0xA0, 0x01, 0x99, 0x78, 0x00, 0x80, 0x80, 0x00, 0x42, 0xAC, 0x0A, 
+	0xA6, 0x00, 0x12, 0x10, 0x63, 0x06, 0xF2, 0x00, 0x42, 0x00, 0x00, 0x01, 0xDC, 0x04, 0x03, 0x00, 
+	0x50, 0x1C, 0x80, 0x00, 0x40, 0x11, 0xE6, 0x95, 0x00, 0xA6, 0x18, 0xF2, 0x40, 0x80, 0x00, 0x00, 
+	0x06, 0x6E, 0x41, 0xA5, 0x6F, 0x02, 0x80, 0x04, 0x40, 0x40, 0x00, 0x0A, 0xC0, 0x00, 0x38, 0x24, 
+	0x05, 0x31, 0x0C, 0x06, 0x82, 0x64, 0x01, 0xB1, 0x80, 0x51, 0xA9, 0xFE, 0x84, 0x80, 0x00, 0x01, 
+	0x63, 0x5C, 0xC1, 0xC8, 0x04, 0xF0, 0x00, 0x00, 0x18, 0x03, 0x03, 0x9C, 0x01, 0x00, 0x01, 0xC0, 
+	0x01, 0xAC, 0x04, 0x00, 0x00, 0x07, 0x9F, 0x01, 0xA0, 0x03, 0xE0, 0x44, 0x00, 0x04, 0x04, 0x10, 
+	0x01, 0x89, 0xDE, 0xA1, 0x06, 0x41, 0x14, 0x7F, 0xCD, 0x0E, 0x3A, 0x00, 0x50, 0x0D, 0x00, 0xFA, 
+	0x20, 0x40, 0x2F, 0x04, 0x60, 0x09, 0xC0, 0x20, 0x08, 0x00, 0x70, 0xF2, 0x01, 0x40, 0x1C, 0x3C, 
+	0x20, 0x04, 0x20, 0x06, 0x10, 0xCB, 0xF2, 0x00, 0x43, 0x01, 0x42, 0x26, 0x80, 0xD2, 0x06, 0x31, 
+	0x17, 0x77, 0x88, 0xE7, 0x01, 0x90, 0x18, 0x14, 0x00, 0x08, 0x01, 0x0F, 0x00, 0x00, 0x08, 0xDD, 
+	0x00, 0x00, 0xF2, 0x01, 0x90, 0x09, 0x97, 0xA8, 0x40, 0x00, 0x00, 0x20, 0x28, 0x4A, 0xF9, 0x00, 
+	0x60, 0x20, 0x00, 0x00, 0x0A, 0x0A, 0xB8, 0x29, 0x00, 0xE1, 0x20, 0xCA, 0x42, 0x00, 0x0B, 0x00, 
+	0x01, 0xDB, 0x00, 0x00, 0x81, 0x40, 0x20, 0x0A, 0x0B, 0x01, 0x20, 0xB9, 0x2C, 0x75, 0x00, 0x31, 
+	0x40, 0x00, 0x05, 0x0C, 0x02, 0x40, 0x00, 0x58, 0x05, 0x02, 0x8D, 0x07, 0x20, 0xC0, 0x0D, 0x45, 
+	0x02, 0x20, 0x03, 0x80, 0x84, 0x08, 0xF4, 0x01, 0x06, 0x8E, 0xD6, 0x90, 0x00, 0x00, 0x05, 0x0A, 
+	0xFB, 0xC8, 0x40, 0x00, 0x00, 0x04, 0x23, 0xD8, 0x51, 0x06, 0x10, 0x0A, 0xA6, 0x00, 0xF1, 0x01, 
+	0x24, 0x00, 0x20, 0xA0, 0x00, 0x08, 0x00, 0x18, 0x03, 0x80, 0x00, 0x00, 0x04, 0x3C, 0x1D, 0x69, 
+	0xF2, 0x02, 0x10, 0x2D, 0x0A, 0x03, 0x32, 0x64, 0x15, 0xF4, 0xC6, 0x01, 0x30, 0x80, 0x07, 0x3F, 
+	0xAF, 0x01, 0x90, 0x06, 0x21, 0xEA, 0x04, 0x00, 0x00, 0x91, 0x8E, 0x80, 0x73, 0x06, 0x20, 0x25, 
+	0xF1, 0x4F, 0x03, 0x92, 0x01, 0x52, 0xA8, 0x00, 0x00, 0xA0, 0x06, 0x6F, 0x5E, 0x48, 0x01, 0x40, 
+	0x01, 0x08, 0x07, 0xB1, 0x2C, 0x02, 0x80, 0x01, 0x40, 0x50, 0x00, 0x09, 0x10, 0x08, 0x03, 0x5F, 
+	0x03, 0xA0, 0x01, 0x79, 0xA1, 0x00, 0x00, 0x04, 0x58, 0xE7, 0x40, 0x14, 0x89, 0x06, 0x21, 0x56, 
+	0x98, 0x0B, 0x03, 0x02, 0x3D, 0x05, 0xA1, 0xC0, 0x02, 0x60, 0x16, 0xEA, 0x04, 0x01, 0x00, 0x07, 
+	0x9A, 0xEF, 0x01, 0xF0, 0x00, 0x6E, 0x1A, 0x50, 0x00, 0x00, 0x1F, 0x08, 0x00, 0x00, 0x10, 0x04, 
+	0x00, 0x06, 0x06, 0x61, 0x2E, 0x03, 0x03, 0x06, 0x03, 0xB0, 0x08, 0x06, 0x04, 0x00, 0x10, 0xA0, 
+	0x00, 0xF8, 0x00, 0x00, 0x83, 0xA3, 0x06, 0x30, 0x31, 0x6B, 0x99, 0xE2, 0x05, 0x80, 0x93, 0x00, 
+	0x20, 0x80, 0x00, 0x02, 0x62, 0x7C, 0x9F, 0x01, 0x00, 0xE1, 0x05, 0x31, 0x03, 0x6A, 0x81, 0xF6, 
+	0x09, 0xE0, 0x08, 0x14, 0x00, 0x04, 0x09, 0x00, 0x00, 0x40, 0xC4, 0x01, 0x60, 0x40, 0xC1, 0x04, 
+	0xC3, 0x03, 0x93, 0x80, 0x39, 0xD0, 0x4C, 0x80, 0x00, 0x01, 0xF8, 0xAA, 0xE1, 0x07, 0x80, 0x04, 
+	0x28, 0x00, 0x02, 0x06, 0x14, 0x2E, 0x4B, 0xD6, 0x05, 0x50, 0xF8, 0x01, 0x30, 0x02, 0x04, 0x89, 
+	0x03, 0xC0, 0x00, 0x08, 0x01, 0x00, 0xE7, 0x2B, 0x6C, 0x00, 0x20, 0x14, 0x00, 0x01, 0x45, 0x02, 
+	0xF0, 0x15, 0x80, 0x08, 0x00, 0x50, 0x03, 0x82, 0x05, 0x01, 0x20, 0x14, 0x06, 0x80, 0xEC, 0x50, 
+	0x06, 0x84, 0x00, 0x00, 0xD8, 0x00, 0xE0, 0x01, 0x67, 0x80, 0x00, 0x24, 0x03, 0x80, 0x08, 0x1B, 
+	0x80, 0x79, 0xD0, 0x02, 0x00, 0x26, 0x03, 0x08, 0xF1, 0x00, 0x00, 0x08, 0x02, 0x00, 0x00, 0x80, 
+	0x0B, 0x20, 0x40, 0x08, 0x00, 0x94, 0x01, 0xCB, 0xCA, 0x01, 0x02, 0x10, 0xB8, 0xE0, 0x03, 0x10, 
+	0x08, 0xBF, 0x03, 0x70, 0x10, 0xAF, 0x2B, 0x6C, 0x02, 0x80, 0x00, 0x3B, 0x04, 0x01, 0xA6, 0x00, 
+	0xA1, 0x18, 0x08, 0x6F, 0x44, 0x00, 0x40, 0x42, 0x07, 0x16, 0xEA, 0x4F, 0x06, 0x10, 0x80, 0x63, 
+	0x09, 0xA0, 0x01, 0x81, 0x04, 0x01, 0x00, 0x03, 0x9A, 0x06, 0x7C, 0xD8, 0x7F, 0x07, 0x50, 0x1A, 
+	0x10, 0x40, 0x00, 0x08, 0x4B, 0x08, 0xE3, 0xD7, 0x38, 0x88, 0x0A, 0x00, 0x14, 0x79, 0xD0, 0xF5, 
+	0x00, 0xB0, 0x00, 0xF0, 0x0F, 0xAB, 0x02, 0x70, 0x20, 0x18, 0x00, 0xF8, 0x00, 0x63, 0xCC, 0xBA, 
+	0x05, 0x01, 0x95, 0x02, 0x41, 0x82, 0x00, 0x00, 0x50, 0x6F, 0x03, 0x90, 0x02, 0x00, 0x1E, 0xEA, 
+	0x30, 0x00, 0x00, 0x07, 0x1F, 0x0D, 0x00, 0xE1, 0x47, 0x96, 0x00, 0x04, 0x00, 0x10, 0x00, 0x0E, 
+	0x38, 0x49, 0x10, 0x00, 0x00, 0x94, 0x39, 0x00, 0x00, 0xF9, 0x00, 0x11, 0x0B, 0x28, 0x00, 0xD0, 
+	0x14, 0x00, 0x0A, 0xA3, 0x20, 0x00, 0x00, 0x09, 0xF1, 0x00, 0x02, 0x00, 0x02, 0x74, 0x06, 0xA2, 
+	0x08, 0x80, 0x50, 0xB0, 0xB8, 0x90, 0x00, 0x20, 0x15, 0x62, 0x7A, 0x06, 0x52, 0x04, 0x00, 0x58, 
+	0x00, 0x32, 0x7F, 0x01, 0x23, 0x08, 0x14, 0x2D, 0x02, 0x20, 0x30, 0x60, 0x22, 0x07, 0x51, 0x31, 
+	0x80, 0x00, 0xFA, 0xE9, 0x22, 0x00, 0x10, 0xC0, 0x6B, 0x01, 0x60, 0x20, 0x80, 0x00, 0x80, 0x50, 
+	0x14, 0x87, 0x00, 0xB1, 0x22, 0xC9, 0x42, 0x20, 0x00, 0x02, 0x90, 0xE3, 0x00, 0x02, 0x0A, 0x8A, 
+	0x04, 0xC0, 0x0A, 0x80, 0x00, 0x0D, 0x36, 0x00, 0x00, 0x20, 0x40, 0x02, 0x00, 0x00, 0x6F, 0x03, 
+	0x40, 0x00, 0x00, 0x80, 0x15, 0x37, 0x04, 0x41, 0x00, 0x06, 0x06, 0xFA, 0xA9, 0x0A, 0x60, 0x78, 
+	0x00, 0x00, 0x02, 0x63, 0x80, 0x75, 0x07, 0x40, 0x00, 0x0A, 0x98, 0x29, 0xBB, 0x02, 0x21, 0x03, 
+	0x59, 0x7C, 0x02, 0x41, 0x80, 0x0B, 0x08, 0x03, 0x37, 0x00, 0x50, 0x00, 0x09, 0xA3, 0x00, 0x40, 
+	0x3E, 0x03, 0x30, 0x02, 0x00, 0x04, 0x9E, 0x04, 0xC0, 0x08, 0x00, 0x01, 0x8D, 0x83, 0xFC, 0x01, 
+	0x20, 0x00, 0x00, 0x04, 0xB5, 0xE4, 0x03, 0x40, 0x04, 0x00, 0x80, 0x07, 0xA6, 0x00, 0x70, 0xC2, 
+	0x40, 0x41, 0xCB, 0x10, 0x00, 0x08, 0x76, 0x00, 0x51, 0x00, 0x14, 0x00, 0x1F, 0x90, 0x07, 0x03, 
+	0x20, 0xBF, 0x80, 0x15, 0x03, 0x11, 0x70, 0x85, 0x07, 0x60, 0x00, 0x80, 0x01, 0x00, 0x00, 0x28, 
+	0x47, 0x00, 0x80, 0x30, 0x5E, 0x72, 0x00, 0x81, 0x00, 0x91, 0x0B, 0x17, 0x00, 0x30, 0x02, 0x7A, 
+	0x06, 0x3F, 0x03, 0x40, 0x0B, 0xAC, 0x1C, 0x80, 0x2B, 0x09, 0x10, 0xD0, 0x72, 0x00, 0x00, 0x9A, 
+	0x00, 0xA1, 0x06, 0x05, 0x00, 0xC0, 0x01, 0xC0, 0x04, 0x08, 0x14, 0x01, 0x7C, 0x06, 0x90, 0x40, 
+	0x01, 0x40, 0x2F, 0xB2, 0x40, 0x00, 0x00, 0x05, 0x59, 0x0A, 0x50, 0x04, 0x00, 0x80, 0x01, 0x78, 
+	0x91, 0x03, 0x00, 0x45, 0x02, 0x30, 0x32, 0x10, 0x82, 0x34, 0x00, 0x70, 0x2E, 0x81, 0x01, 0x30, 
+	0x18, 0x98, 0x07, 0x4C, 0x01, 0x30, 0x20, 0xC9, 0x14, 0x4A, 0x03, 0x00, 0x20, 0x06, 0x21, 0x20, 
+	0x14, 0x91, 0x03, 0xF0, 0x05, 0x40, 0x80, 0x10, 0x00, 0x80, 0x17, 0x82, 0x95, 0x00, 0xC0, 0x40, 
+	0x00, 0x0C, 0x00, 0x06, 0x01, 0x11, 0x41, 0x08, 0x00, 0x5F, 0x00, 0xE0, 0x40, 0xC1, 0x04, 0x01, 
+	0x01, 0x00, 0x0A, 0x10, 0x00, 0x10, 0x0C, 0x00, 0x80, 0x04, 0x8F, 0x00, 0x50, 0x08, 0x20, 0x80, 
+	0x01, 0x08, 0x15, 0x01, 0x00, 0x8B, 0x02, 0xC1, 0x04, 0x00, 0x0A, 0x83, 0x01, 0xFF, 0x24, 0x02, 
+	0x00, 0x14, 0x38, 0x10, 0xE1, 0x09, 0x00, 0x3A, 0x02, 0x40, 0x20, 0x04, 0x02, 0x40, 0x5B, 0x00, 
+	0x10, 0x80, 0xC8, 0x07, 0x60, 0x72, 0x81, 0x00, 0xE0, 0x01, 0x62, 0x59, 0x01, 0x61, 0x81, 0x80, 
+	0x01, 0x58, 0x00, 0xE0, 0x1D, 0x02, 0x23, 0x02, 0x83, 0x0A, 0x02, 0x10, 0x20, 0x9F, 0x01, 0x30, 
+	0x08, 0x0B, 0x82, 0xBC, 0x07, 0x00, 0x93, 0x00, 0x01, 0x4D, 0x05, 0x83, 0x20, 0x00, 0x70, 0xA9, 
+	0x30, 0x08, 0x00, 0x1C, 0xFD, 0x03, 0x02, 0xC6, 0x00, 0x10, 0x40, 0x4D, 0x09, 0x10, 0x44, 0x98, 
+	0x02, 0x60, 0x07, 0x82, 0x05, 0x00, 0xC2, 0x02, 0xCA, 0x05, 0x70, 0x01, 0x00, 0x58, 0x0E, 0x80, 
+	0x00, 0xC0, 0x97, 0x0D, 0x00, 0x9F, 0x01, 0x05, 0x2B, 0x0B, 0x40, 0x02, 0x48, 0x00, 0xC8, 0x98, 
+	0x02, 0xC3, 0x0A, 0xA0, 0x40, 0x02, 0x40, 0x55, 0x74, 0x00, 0x00, 0x00, 0x39, 0x20, 0x98, 0x02, 
+	0x15, 0x09, 0x27, 0x00, 0x00, 0x39, 0x04, 0x00, 0x46, 0x02, 0x70, 0x83, 0x00, 0x00, 0x50, 0x0D, 
+	0x82, 0x95, 0x13, 0x00, 0x62, 0x64, 0x1E, 0x70, 0x00, 0x00, 0x07, 0x78, 0x00, 0x80, 0x20, 0x00, 
+	0x04, 0x80, 0x00, 0x00, 0x19, 0xDB, 0xA3, 0x05, 0x52, 0x06, 0x00, 0x1E, 0x10, 0x48, 0x91, 0x03, 
+	0x10, 0xF0, 0xB6, 0x00, 0x91, 0x04, 0x31, 0x48, 0x81, 0x00, 0x48, 0x00, 0x00, 0x0B, 0x53, 0x00, 
+	0x20, 0xC0, 0x08, 0x53, 0x00, 0x83, 0xC3, 0x81, 0x40, 0x45, 0x20, 0x00, 0x20, 0x01, 0x46, 0x07, 
+	0x40, 0xF0, 0x07, 0xF2, 0x81, 0x5F, 0x04, 0x70, 0x15, 0xCB, 0x10, 0x00, 0x10, 0x07, 0x0E, 0x14, 
+	0x00, 0x41, 0x07, 0x44, 0xEA, 0x10, 0x81, 0x00, 0x00, 0x05, 0x05, 0x21, 0x06, 0x06, 0xEC, 0x00, 
+	0x50, 0x20, 0x80, 0x03, 0x80, 0x08, 0xF2, 0x01, 0x90, 0x00, 0x00, 0x2E, 0xB1, 0x20, 0x0A, 0x90, 
+	0x08, 0x0D, 0x0C, 0x00, 0x61, 0x20, 0x4D, 0x01, 0x00, 0x08, 0x29, 0xD0, 0x02, 0xE0, 0x28, 0x10, 
+	0x42, 0x94, 0x00, 0x80, 0x00, 0x6C, 0x68, 0x00, 0x00, 0xB8, 0x01, 0x06, 0x98, 0x02, 0x41, 0x60, 
+	0x61, 0xDD, 0x10, 0xE5, 0x05, 0x00, 0x5F, 0x00, 0x10, 0x1D, 0x3A, 0x01, 0x04, 0x4A, 0x0C, 0x00, 
+	0xC2, 0x02, 0xF7, 0x0C, 0x01, 0x80, 0x00, 0x80, 0x01, 0x80, 0x03, 0xE0, 0x40, 0x02, 0x00, 0x02, 
+	0x25, 0x59, 0xE2, 0x20, 0x08, 0x00, 0x90, 0x05, 0x80, 0x02, 0x00, 0x02, 0x01, 0xC8, 0x34, 0xF9, 
+	0x00, 0x10, 0x3C, 0x82, 0x06, 0x40, 0x04, 0x00, 0x00, 0x70, 0x4C, 0x01, 0xB0, 0x00, 0x00, 0xC0, 
+	0x15, 0xBC, 0x50, 0x00, 0x00, 0x20, 0x1C, 0x80, 0x8F, 0x05, 0x01, 0x24, 0x00, 0x50, 0x50, 0x00, 
+	0xB6, 0xA8, 0x40, 0x31, 0x00, 0x50, 0x0C, 0x10, 0x40, 0x08, 0x02, 0xEB, 0x06, 0x21, 0x0A, 0x60, 
+	0x82, 0x01, 0xB1, 0x0E, 0xC5, 0x00, 0x08, 0x28, 0x01, 0x03, 0x00, 0x02, 0x80, 0x06, 0x76, 0x03, 
+	0x53, 0x03, 0x00, 0x07, 0x6C, 0x80, 0x8F, 0x08, 0x20, 0x08, 0x40, 0x98, 0x02, 0x30, 0x03, 0x72, 
+	0xC4, 0x8C, 0x02, 0x32, 0x34, 0x1A, 0x50, 0xF3, 0x0B, 0x10, 0x40, 0xED, 0x02, 0x70, 0x04, 0x01, 
+	0x00, 0x01, 0x00, 0x03, 0x04, 0xD3, 0x00, 0x21, 0x28, 0x18, 0x0C, 0x0B, 0xC0, 0x80, 0x00, 0x0D, 
+	0x03, 0x2C, 0x42, 0x02, 0x00, 0x02, 0x03, 0x6A, 0x99, 0x2C, 0x0B, 0x12, 0x01, 0x37, 0x04, 0x00, 
+	0x81, 0x0B, 0x03, 0xA6, 0x00, 0x00, 0xC2, 0x01, 0x01, 0x0D, 0x00, 0x40, 0x01, 0x88, 0x7F, 0x44, 
+	0xF0, 0x02, 0x33, 0x01, 0x9C, 0x04, 0x35, 0x0B, 0xD7, 0x02, 0x02, 0x80, 0x03, 0xC6, 0x82, 0x00, 
+	0x00, 0x1A, 0x9E, 0xCD, 0x00, 0x08, 0x5B, 0x0A, 0xA0, 0x0E, 0x52, 0xF8, 0x84, 0x00, 0x00, 0x00, 
+	0x38, 0x0A, 0xC0, 0x86, 0x01, 0x20, 0xF9, 0x38, 0x30, 0x07, 0x30, 0x08, 0x3C, 0x28, 0xE0, 0x0A, 
+	0x00, 0x7C, 0x06, 0x13, 0x01, 0x93, 0x08, 0xF1, 0x05, 0x08, 0x00, 0x00, 0x05, 0x6F, 0x14, 0x00, 
+	0x20, 0x00, 0xE6, 0x20, 0x08, 0x14, 0x82, 0x84, 0x07, 0x00, 0xD0, 0x00, 0xA0, 0x7E, 0x00, 0x71, 
+	0x03, 0x88, 0x0B, 0x80, 0x07, 0x3D, 0x50, 0x44, 0x0B, 0x03, 0x52, 0x01, 0x90, 0x00, 0x03, 0x71, 
+	0x40, 0x18, 0x00, 0x02, 0x00, 0x49, 0x15, 0x00, 0x30, 0xF0, 0xFF, 0xB8, 0xD7, 0x05, 0x00, 0x51, 
+	0x06, 0x73, 0x30, 0xB0, 0x07, 0x43, 0xE8, 0x00, 0x80, 0x94, 0x08, 0xF2, 0x01, 0x00, 0x11, 0x00, 
+	0x50, 0x00, 0x77, 0x01, 0x01, 0x40, 0x00, 0x60, 0x46, 0x08, 0x14, 0x03, 0x00, 0x60, 0x0A, 0xE1, 
+	0x06, 0x00, 0x00, 0x20, 0x03, 0x00, 0x00, 0x1D, 0x30, 0x3F, 0xC8, 0x20, 0x0E, 0x20, 0x98, 0x02, 
+	0x70, 0x00, 0x01, 0x08, 0x0D, 0x0A, 0x03, 0x70, 0x7D, 0x01, 0xE0, 0x28, 0x0D, 0x81, 0x00, 0x10, 
+	0x20, 0x01, 0x0D, 0x00, 0x04, 0x00, 0x14, 0x40, 0x0B, 0xD4, 0x03, 0x72, 0x01, 0xBB, 0x81, 0x68, 
+	0x01, 0x00, 0x06, 0xB7, 0x0A, 0x50, 0x02, 0x00, 0x00, 0x10, 0xA8, 0xF2, 0x01, 0x40, 0x01, 0x63, 
+	0xE0, 0x18, 0xD6, 0x06, 0x80, 0x0E, 0x80, 0x00, 0x0A, 0x02, 0x40, 0x07, 0xB0, 0x6D, 0x01, 0x48, 
+	0x1C, 0x00, 0x79, 0xD0, 0x41, 0x0E, 0x31, 0x10, 0xB3, 0x10, 0x75, 0x07, 0x01, 0xA6, 0x00, 0x00, 
+	0xB0, 0x05, 0x50, 0x4E, 0x3C, 0x01, 0x4A, 0x52, 0x7C, 0x06, 0x46, 0x09, 0x3B, 0x6C, 0x02, 0x98, 
+	0x0D, 0x00, 0x1D, 0x0A, 0xC1, 0x80, 0x01, 0x04, 0x00, 0x00, 0x01, 0x8A, 0x04, 0x00, 0x08, 0x30, 
+	0x01, 0x3C, 0x01, 0x71, 0x5E, 0x00, 0x04, 0x08, 0x00, 0x00, 0x1E, 0x6B, 0x01, 0x00, 0x5D, 0x00, 
+	0x00, 0x98, 0x02, 0x40, 0x00, 0x00, 0x00, 0x5C, 0x0F, 0x09, 0x91, 0x00, 0x21, 0x40, 0x50, 0x08, 
+	0x01, 0x07, 0x00, 0xA3, 0x8D, 0x02, 0x30, 0x20, 0x04, 0x29, 0xC3, 0x06, 0x01, 0x2A, 0x00, 0x21, 
+	0x40, 0x0C, 0xE1, 0x03, 0x50, 0x00, 0x00, 0x11, 0x95, 0x86, 0x45, 0x02, 0x70, 0x00, 0x20, 0xFD, 
+	0x10, 0x00, 0x00, 0x0D, 0x30, 0x08, 0x10, 0x04, 0x4B, 0x0D, 0x1E, 0x08, 0xE3, 0x0E, 0x20, 0x48, 
+	0x0B, 0xC8, 0x07, 0x80, 0x00, 0x03, 0xDB, 0xE2, 0x20, 0x00, 0x00, 0x50, 0x7D, 0x00, 0x00, 0xE3, 
+	0x06, 0x16, 0x29, 0x7A, 0x0A, 0x05, 0x01, 0x00, 0x20, 0x01, 0x72, 0xD6, 0x05, 0x71, 0x06, 0x26, 
+	0x0A, 0x54, 0x00, 0x18, 0x09, 0x3E, 0x03, 0x03, 0xBA, 0x01, 0x30, 0x1E, 0xD6, 0x21, 0x98, 0x02, 
+	0x24, 0x01, 0x40, 0x92, 0x10, 0x20, 0x08, 0x28, 0xA5, 0x01, 0x11, 0x43, 0x0E, 0x00, 0x12, 0x51, 
+	0x5D, 0x03, 0x02, 0x12, 0x01, 0x23, 0x0D, 0xAD, 0x0A, 0x00, 0x00, 0xD6, 0x05, 0x30, 0x30, 0x00, 
+	0x80, 0x52, 0x0C, 0x00, 0xF3, 0x0B, 0x00, 0x30, 0x05, 0x10, 0x50, 0x51, 0x04, 0x00, 0x0E, 0x02, 
+	0x1C, 0x20, 0x61, 0x0F, 0x60, 0x02, 0x00, 0x03, 0x00, 0x32, 0x90, 0xD9, 0x00, 0x81, 0x2C, 0x4B, 
+	0x42, 0x00, 0x10, 0x02, 0x10, 0x87, 0xF9, 0x00, 0x01, 0x59, 0x00, 0x02, 0x4F, 0x0B, 0x03, 0x5F, 
+	0x00, 0x00, 0x05, 0x00, 0x40, 0x07, 0xEA, 0x81, 0x20, 0x81, 0x03, 0x01, 0x7C, 0x00, 0x01, 0x77, 
+	0x05, 0x33, 0x07, 0xA0, 0x99, 0xCC, 0x00, 0x02, 0x13, 0x03, 0x01, 0xD6, 0x05, 0x01, 0xA6, 0x00, 
+	0x04, 0xF7, 0x0F, 0xB1, 0x02, 0x10, 0x08, 0xCF, 0x38, 0x00, 0x0A, 0x80, 0x02, 0x5B, 0x60, 0xC7, 
+	0x05, 0x12, 0x30, 0x81, 0x00, 0x31, 0xB0, 0x03, 0x94, 0xFA, 0x06, 0x00, 0xA6, 0x00, 0xF3, 0x00, 
+	0xE0, 0x00, 0x00, 0x0C, 0xAA, 0x52, 0x80, 0x80, 0x50, 0x01, 0xD8, 0x40, 0x28, 0x15, 0x46, 0x61, 
+	0x00, 0xF1, 0x02, 0x3B, 0x0C, 0xE0, 0x0A, 0x00, 0x20, 0x00, 0x1A, 0x10, 0x60, 0x40, 0x00, 0x02, 
+	0x00, 0x07, 0x00, 0xF3, 0xA6, 0x00, 0xC1, 0x01, 0xE0, 0xA0, 0x29, 0xA0, 0x02, 0x00, 0xC7, 0xB4, 
+	0x18, 0x00, 0x94, 0x1C, 0x03, 0x50, 0x38, 0x00, 0x00, 0x83, 0x30, 0x3D, 0x0F, 0x40, 0x01, 0x00, 
+	0x02, 0x18, 0x5F, 0x00, 0x10, 0x18, 0x16, 0x00, 0x41, 0xC0, 0x01, 0xE3, 0xA0, 0xEC, 0x0C, 0x10, 
+	0x1E, 0xF5, 0x04, 0x31, 0x02, 0x95, 0x90, 0x82, 0x0D, 0x71, 0x02, 0x0C, 0xE0, 0x0C, 0x00, 0x16, 
+	0x6C, 0x5F, 0x00, 0x11, 0x01, 0x58, 0x0B, 0x00, 0x01, 0x00, 0xE1, 0x69, 0xC0, 0x08, 0x00, 0x90, 
+	0x20, 0xF0, 0x0D, 0x00, 0x0C, 0x08, 0x00, 0x78, 0x28, 0xE7, 0x03, 0x51, 0x00, 0x3F, 0x30, 0x00, 
+	0x40, 0x91, 0x03, 0x01, 0x23, 0x01, 0xA0, 0x80, 0x10, 0x60, 0x3C, 0x00, 0x04, 0x00, 0xE0, 0x17, 
+	0xFE, 0x8B, 0x00, 0x01, 0x30, 0x05, 0x41, 0x02, 0x80, 0x10, 0x26, 0xB6, 0x02, 0xA0, 0x0C, 0xE0, 
+	0x01, 0x00, 0x00, 0x68, 0x00, 0x00, 0x40, 0x40, 0x31, 0x13, 0xE0, 0x08, 0x00, 0x03, 0xC8, 0x10, 
+	0xA0, 0x04, 0x00, 0x1A, 0xE4, 0x20, 0x00, 0x00, 0x01, 0x27, 0x02, 0x32, 0x34, 0x40, 0x0A, 0x01, 
+	0x12, 0x40, 0x3B, 0x30, 0x00, 0x1A, 0x58, 0x0C, 0x21, 0x82, 0x9C, 0x56, 0x00, 0x21, 0x07, 0xEA, 
+	0x30, 0x05, 0x10, 0x0E, 0xA7, 0x0A, 0x01, 0xB3, 0x0A, 0x00, 0xD7, 0x01, 0x70, 0x25, 0x14, 0x00, 
+	0x0D, 0x80, 0x02, 0x4C, 0x43, 0x08, 0x30, 0x04, 0x01, 0x02, 0x4B, 0x0D, 0x50, 0x02, 0x00, 0x09, 
+	0x0C, 0x28, 0x07, 0x00, 0x10, 0x24, 0x43, 0x03, 0x10, 0x22, 0x52, 0x0C, 0x40, 0x02, 0x0C, 0x00, 
+	0x0B, 0x06, 0x04, 0x30, 0x90, 0x00, 0x33, 0x59, 0x00, 0x33, 0x02, 0x40, 0x80, 0x54, 0x12, 0x80, 
+	0x0B, 0x83, 0x9C, 0x00, 0x00, 0x01, 0x60, 0x14, 0x88, 0x03, 0x53, 0x00, 0x1B, 0x18, 0x00, 0x0A, 
+	0x62, 0x0D, 0x41, 0x08, 0x01, 0x7A, 0x0C, 0xF0, 0x0B, 0x02, 0xD1, 0x0E, 0x51, 0x08, 0x0F, 0x00, 
+	0x52, 0x90, 0x78, 0x0F, 0x01, 0xD6, 0x0E, 0x33, 0x00, 0xA3, 0x80, 0x09, 0x08, 0x51, 0x00, 0x00, 
+	0x50, 0xA0, 0x03, 0xAC, 0x00, 0x32, 0x1C, 0x00, 0x83, 0x3C, 0x00, 0x71, 0x07, 0x86, 0x05, 0x00, 
+	0x04, 0x0B, 0x40, 0x7D, 0x10, 0xE0, 0x53, 0x9C, 0x80, 0x00, 0x0A, 0x4C, 0x07, 0x80, 0x00, 0x25, 
+	0x00, 0x00, 0x28, 0x1A, 0x53, 0x00, 0x00, 0x54, 0x00, 0x20, 0x02, 0x61, 0xBD, 0x00, 0x30, 0x09, 
+	0x00, 0x0B, 0x62, 0x00, 0x80, 0x2E, 0x00, 0x00, 0x04, 0x20, 0x01, 0x08, 0x09, 0xCF, 0x08, 0x00, 
+	0x9D, 0x13, 0xF1, 0x00, 0x29, 0x00, 0x04, 0x50, 0x00, 0x03, 0x30, 0x00, 0x08, 0x03, 0x40, 0x00, 
+	0xA0, 0x01, 0x8C, 0xF4, 0x03, 0xF3, 0x0E, 0xD5, 0x06, 0x05, 0x00, 0x40, 0x01, 0x42, 0x20, 0xED, 
+	0x11, 0x03, 0x20, 0x59, 0x1C, 0x00, 0x00, 0x42, 0x08, 0x00, 0x20, 0x05, 0xA4, 0x04, 0x00, 0x09, 
+	0x80, 0x02, 0x0C, 0xE0, 0x3E, 0x13, 0x01, 0x0E, 0x01, 0x21, 0x1E, 0x03, 0xB5, 0x00, 0x60, 0x01, 
+	0x4B, 0xE2, 0x00, 0x31, 0x02, 0x5D, 0x05, 0x60, 0x40, 0x40, 0x02, 0x40, 0xA5, 0x29, 0x6A, 0x10, 
+	0x01, 0xF9, 0x00, 0x06, 0x01, 0x00, 0x50, 0x05, 0x82, 0x05, 0x20, 0x80, 0xC9, 0x05, 0x00, 0x25, 
+	0x01, 0x00, 0xD8, 0x03, 0x30, 0x01, 0xE2, 0x86, 0x67, 0x02, 0x53, 0x03, 0x9B, 0x02, 0x4C, 0xE2, 
+	0x9A, 0x02, 0x02, 0x9C, 0x03, 0x21, 0x0B, 0xA0, 0x71, 0x07, 0x11, 0x0E, 0x9E, 0x02, 0x22, 0x05, 
+	0x2C, 0x93, 0x07, 0x80, 0x02, 0x00, 0x18, 0x00, 0xF0, 0x2B, 0x30, 0x14, 0x35, 0x12, 0x04, 0x93, 
+	0x05, 0x32, 0x07, 0x02, 0x95, 0xCA, 0x09, 0x50, 0x00, 0x02, 0x84, 0x08, 0x01, 0x54, 0x02, 0xB0, 
+	0x02, 0x80, 0x00, 0x08, 0x02, 0xA1, 0x95, 0x0A, 0x02, 0x4C, 0xC0, 0xF8, 0x07, 0x20, 0x0E, 0x33, 
+	0xE1, 0x04, 0x47, 0x00, 0x00, 0x0A, 0xD0, 0x53, 0x03, 0x31, 0x70, 0xF5, 0xB4, 0x71, 0x01, 0x80, 
+	0x00, 0x00, 0x00, 0x3A, 0xF0, 0xA0, 0x33, 0x30, 0x9D, 0x05, 0x40, 0x00, 0xF3, 0x30, 0x80, 0x57, 
+	0x0B, 0x51, 0x50, 0x00, 0x6A, 0x81, 0x20, 0x5E, 0x0D, 0x51, 0x24, 0x83, 0x01, 0x0F, 0x9E, 0x22, 
+	0x07, 0xB0, 0x80, 0x83, 0x3A, 0x0D, 0x00, 0x08, 0x0B, 0x06, 0x15, 0x40, 0x04, 0x3D, 0x01, 0x11, 
+	0xE7, 0xF8, 0x09, 0x32, 0x00, 0x08, 0x70, 0x7D, 0x01, 0x10, 0x0D, 0x30, 0x01, 0x21, 0xF9, 0x8B, 
+	0x58, 0x11, 0xF0, 0x09, 0x0B, 0xCC, 0x00, 0x10, 0x00, 0x91, 0xA3, 0x42, 0xA8, 0x01, 0xC0, 0xE0, 
+	0x06, 0x14, 0xCD, 0xB2, 0x08, 0x00, 0x62, 0x00, 0x00, 0x80, 0xF9, 0xEA, 0xDE, 0x12, 0x01, 0x01, 
+	0x00, 0x10, 0x28, 0x27, 0x0C, 0x00, 0x01, 0x00, 0xD0, 0x93, 0x38, 0x00, 0x10, 0x09, 0x80, 0x06, 
+	0x04, 0x1A, 0x00, 0x02, 0x86, 0x02, 0x3D, 0x0F, 0x00, 0xFE, 0x04, 0x34, 0x08, 0xDC, 0x2A, 0x29, 
+	0x00, 0x12, 0x01, 0xD5, 0x11, 0x61, 0x14, 0x00, 0x0A, 0xCC, 0x09, 0x40, 0x8A, 0x06, 0x00, 0xD3, 
+	0x03, 0x31, 0x1C, 0xC9, 0x90, 0xEF, 0x03, 0x20, 0x01, 0xE3, 0xA5, 0x0C, 0x02, 0x01, 0x00, 0xB0, 
+	0x38, 0x03, 0x9C, 0x00, 0x00, 0x04, 0x18, 0x00, 0x04, 0x83, 0x38, 0x45, 0x02, 0x80, 0x52, 0x45, 
+	0x00, 0x40, 0x00, 0x80, 0x01, 0xC0, 0x4B, 0x01, 0x42, 0x20, 0x00, 0x00, 0x10, 0x4C, 0x01, 0x01, 
+	0x38, 0x0E, 0xF2, 0x08, 0x00, 0x91, 0x03, 0x00, 0x00, 0xAB, 0x40, 0x00, 0x20, 0xCC, 0x01, 0x00, 
+	0x00, 0x10, 0x90, 0xF8, 0x50, 0x00, 0x00, 0x14, 0x40, 0x3E, 0x0F, 0x4B, 0x0D, 0xB0, 0x38, 0x05, 
+	0xAF, 0x88, 0x80, 0x04, 0x95, 0x40, 0x00, 0x81, 0x04, 0x69, 0x07, 0x01, 0xA0, 0x03, 0xE2, 0x0E, 
+	0x83, 0x3A, 0x00, 0x08, 0x03, 0x80, 0x18, 0x59, 0x80, 0x40, 0x08, 0x06, 0x28, 0xDD, 0x04, 0x30, 
+	0x03, 0x80, 0x80, 0x4B, 0x0D, 0x90, 0x20, 0x80, 0x00, 0x10, 0x00, 0x20, 0x00, 0x0A, 0x00, 0xCF, 
+	0x0A, 0x41, 0x00, 0x20, 0x20, 0xCC, 0xAC, 0x11, 0x60, 0xA5, 0x98, 0x01, 0x08, 0x03, 0x64, 0x92, 
+	0x07, 0x00, 0x01, 0x00, 0x20, 0x30, 0x03, 0xC8, 0x07, 0x20, 0x09, 0x40, 0xBB, 0x13, 0x01, 0x29, 
+	0x06, 0x60, 0x00, 0x00, 0x00, 0x1E, 0x83, 0x38, 0xA6, 0x04, 0x20, 0x5A, 0x83, 0xC1, 0x08, 0x32, 
+	0x66, 0xEA, 0xF0, 0xF7, 0x01, 0x42, 0x80, 0x03, 0xA0, 0x40, 0xFC, 0x01, 0x00, 0x3D, 0x04, 0x00, 
+	0x00, 0x12, 0x40, 0x04, 0x00, 0x20, 0xCC, 0x0F, 0x08, 0x20, 0x0D, 0x34, 0x9F, 0x00, 0x43, 0x26, 
+	0x5F, 0x0F, 0xA2, 0x60, 0x0A, 0x24, 0x04, 0xF0, 0xAA, 0x14, 0x00, 0xD6, 0x08, 0x01, 0x01, 0x00, 
+	0x20, 0x83, 0x38, 0xC8, 0x07, 0x80, 0x98, 0x30, 0xC0, 0x0C, 0xA0, 0x34, 0x00, 0x0F, 0x82, 0x11, 
+	0x00, 0xEB, 0x02, 0x22, 0x03, 0x8F, 0xFB, 0x09, 0x30, 0x00, 0x00, 0x31, 0x11, 0x08, 0xF7, 0x0A, 
+	0x00, 0x00, 0x80, 0x20, 0x0E, 0xCC, 0x00, 0x80, 0x00, 0x08, 0x01, 0xA0, 0xF0, 0x00, 0x40, 0x02, 
+	0x60, 0x01, 0xE3, 0x30, 0x10, 0x00, 0x00, 0x11, 0x01, 0x5E, 0x17, 0x0F, 0x51, 0x15, 0x08, 0x0F, 
+	0x01, 0x00, 0x1E, 0x03, 0x56, 0x00, 0x05, 0x2B, 0x03, 0x0F, 0x01, 0x00, 0x37, 0x00, 0xA6, 0x00, 
+	0x06, 0x6A, 0x11, 0x0F, 0x01, 0x00, 0x0A, 0x13, 0x07, 0x74, 0x13, 0x0F, 0x01, 0x00, 0x09, 0x0E, 
+	0x0B, 0x17, 0x19, 0x08, 0x5E, 0x17, 0x0F, 0x7D, 0x18, 0x08, 0x05, 0x84, 0x02, 0x0F, 0x53, 0x00, 
+	0x0A, 0x01, 0xBC, 0x09, 0x03, 0x0B, 0x04, 0x0F, 0x53, 0x00, 0x0E, 0x0F, 0x01, 0x00, 0x19, 0x08, 
+	0x41, 0x08, 0x0F, 0x01, 0x00, 0x07, 0x03, 0xB5, 0x05, 0x06, 0x01, 0x00, 0x0F, 0x93, 0x01, 0x29, 
+	0x02, 0xBA, 0x00, 0x0F, 0x77, 0x18, 0x06, 0x0A, 0xF9, 0x00, 0x02, 0x01, 0x00, 0x08, 0x55, 0x02, 
+	0x0F, 0x34, 0x19, 0x07, 0x06, 0x1A, 0x00, 0x01, 0xDB, 0x06, 0x01, 0x7F, 0x03, 0x0F, 0x01, 0x00, 
+	0xEF, 0x0A, 0xB9, 0x01, 0x08, 0x01, 0x00, 0x0C, 0x01, 0x03, 0x0F, 0x0A, 0x1A, 0x26, 0x08, 0x01, 
+	0x00, 0x03, 0x3F, 0x18, 0x0F, 0x01, 0x00, 0x8C, 0x20, 0x03, 0x40, 0x7A, 0x13, 0x0F, 0x01, 0x00, 
+	0x11, 0x24, 0x20, 0x05, 0x09, 0x0C, 0x0F, 0x01, 0x00, 0x3F, 0xAF, 0x03, 0x00, 0x21, 0x21, 0x00, 
+	0x00, 0x02, 0x7E, 0x9C, 0x30, 0x09, 0x1C, 0x09, 0x40, 0x01, 0x00, 0x00, 0x18, 0x2A, 0x06, 0x54, 
+	0x00, 0x00, 0x07, 0x7A, 0xE2, 0xC0, 0x08, 0x08, 0x01, 0x00, 0x0F, 0xB8, 0x01, 0x22, 0x0F, 0x1E, 
+	0x03, 0x17, 0x03, 0x7B, 0x1B, 0x3F, 0x3C, 0xAD, 0xB0, 0xA6, 0x00, 0x02, 0x14, 0x04, 0x7F, 0x00, 
+	0x41, 0x01, 0x80, 0x77, 0x81, 0x28, 0x09, 0x13, 0x00, 0x9E, 0x19, 0x0C, 0x01, 0x00, 0x15, 0x06, 
+	0x40, 0x00, 0x0F, 0xEF, 0x00, 0x06, 0x04, 0xE7, 0x0B, 0x21, 0x2C, 0xB1, 0x43, 0x11, 0x02, 0xC6, 
+	0x0C, 0x0F, 0x01, 0x00, 0x01, 0x13, 0x01, 0xB3, 0x0B, 0x23, 0x0F, 0xBB, 0xFB, 0x09, 0x2F, 0x0D, 
+	0x42, 0x2C, 0x00, 0x05, 0x01, 0x51, 0x04, 0x07, 0xB1, 0x04, 0x10, 0x02, 0x8D, 0x12, 0x10, 0x04, 
+	0x95, 0x18, 0x0C, 0x01, 0x00, 0x26, 0x30, 0x41, 0x0C, 0x00, 0x21, 0x10, 0x00, 0x7A, 0x1C, 0x13, 
+	0x80, 0x5A, 0x0E, 0x0D, 0x2D, 0x06, 0x14, 0x0C, 0x78, 0x01, 0x12, 0x03, 0xB6, 0x00, 0x03, 0xD5, 
+	0x17, 0x0F, 0x01, 0x00, 0x00, 0x14, 0x40, 0x41, 0x06, 0x6F, 0x20, 0x00, 0x00, 0x03, 0x33, 0x9D, 
+	0xC2, 0x01, 0x01, 0x02, 0x01, 0x00, 0x06, 0xE6, 0x04, 0x00, 0x23, 0x00, 0x20, 0x76, 0xD2, 0xE6, 
+	0x0D, 0x0B, 0x01, 0x00, 0x01, 0xED, 0x13, 0x0A, 0x8E, 0x00, 0x16, 0x0D, 0xEA, 0x1C, 0x0B, 0x96, 
+	0x05, 0x0C, 0xA5, 0x05, 0x20, 0x32, 0xC4, 0x12, 0x00, 0x01, 0xBA, 0x1E, 0x0B, 0xFE, 0x01, 0x22, 
+	0x30, 0x41, 0xDD, 0x08, 0x02, 0x01, 0x00, 0x32, 0x10, 0x00, 0x40, 0xC6, 0x03, 0x06, 0xA5, 0x0A, 
+	0x11, 0x22, 0xEE, 0x00, 0x46, 0x01, 0x00, 0x08, 0x01, 0x4F, 0x04, 0x00, 0xAD, 0x08, 0x31, 0x02, 
+	0x83, 0xC0, 0x24, 0x00, 0x03, 0x0E, 0x0D, 0x50, 0x04, 0x00, 0x96, 0x01, 0xE0, 0x2A, 0x00, 0x49, 
+	0x80, 0x03, 0x80, 0x01, 0x98, 0x02, 0x20, 0x8D, 0x78, 0x26, 0x00, 0x4C, 0x42, 0x40, 0x9B, 0xD4, 
+	0xFF, 0x00, 0x11, 0x08, 0x10, 0x06, 0x04, 0xD2, 0x00, 0xB5, 0x01, 0x81, 0x13, 0xA0, 0x04, 0x00, 
+	0x04, 0x20, 0x05, 0xC1, 0xBD, 0x8D, 0x01, 0x03, 0xF8, 0x06, 0x10, 0x05, 0x44, 0x13, 0x04, 0xAB, 
+	0x0C, 0x77, 0x00, 0x00, 0x00, 0x89, 0xA5, 0x60, 0x80, 0xA3, 0x00, 0x07, 0x52, 0x00, 0x02, 0x63, 
+	0x06, 0x31, 0x01, 0x6D, 0xDB, 0x35, 0x18, 0x40, 0x00, 0x01, 0x3A, 0xDF, 0x07, 0x00, 0x02, 0xE3, 
+	0x1A, 0x09, 0x01, 0x00, 0x11, 0x15, 0x53, 0x00, 0x20, 0x00, 0x1C, 0x85, 0x1B, 0x01, 0xD9, 0x00, 
+	0x1C, 0x38, 0xE6, 0x1D, 0x04, 0x08, 0x1B, 0x01, 0x30, 0x0B, 0x08, 0x01, 0x00, 0x01, 0x83, 0x1B, 
+	0x01, 0x53, 0x00, 0x08, 0xA2, 0x0B, 0x00, 0xA0, 0x01, 0x00, 0x0E, 0x02, 0x06, 0x33, 0x08, 0x30, 
+	0x01, 0xE4, 0xB9, 0x07, 0x00, 0x13, 0x3D, 0xBA, 0x18, 0x00, 0x0A, 0x0D, 0x02, 0x01, 0x07, 0x10, 
+	0x0A, 0xCA, 0x00, 0x04, 0xCD, 0x00, 0x61, 0x20, 0x00, 0x00, 0x18, 0x3A, 0xC9, 0xF4, 0x02, 0x10, 
+	0x18, 0x3D, 0x1B, 0x03, 0x01, 0x00, 0x10, 0x0E, 0x51, 0x11, 0x46, 0x51, 0xC0, 0x00, 0x09, 0x13, 
+	0x00, 0xC2, 0x10, 0x00, 0x08, 0x09, 0xA8, 0x0D, 0x00, 0x44, 0x00, 0x00, 0x03, 0x0F, 0x6E, 0x17, 
+	0x00, 0x68, 0x01, 0x01, 0x2F, 0x0A, 0x10, 0x01, 0x24, 0x04, 0x10, 0x04, 0x9B, 0x0C, 0x01, 0x68, 
+	0x00, 0x60, 0x00, 0x05, 0x18, 0xF2, 0x30, 0x10, 0x20, 0x01, 0x22, 0xDC, 0xF5, 0x13, 0x00, 0x00, 
+	0x20, 0x0B, 0x01, 0x9F, 0x01, 0x64, 0x81, 0xC0, 0x60, 0x41, 0x20, 0x40, 0x46, 0x20, 0x87, 0x20, 
+	0x00, 0x01, 0xF1, 0xF9, 0x21, 0x00, 0x80, 0x2B, 0x06, 0x51, 0x80, 0x00, 0x03, 0x40, 0xA0, 0x10, 
+	0x00, 0x11, 0x70, 0x29, 0x1A, 0x30, 0x00, 0x0F, 0xCF, 0x83, 0x00, 0x77, 0x80, 0x00, 0x0B, 0x1E, 
+	0xC8, 0x70, 0x02, 0x5B, 0x02, 0x00, 0x0C, 0x00, 0xF2, 0x00, 0x01, 0x02, 0x40, 0x08, 0x00, 0x18, 
+	0x08, 0x00, 0x01, 0x21, 0x20, 0x60, 0x00, 0x00, 0xAC, 0x43, 0x01, 0x30, 0x09, 0xE0, 0x2C, 0x39, 
+	0x00, 0x08, 0x7E, 0x06, 0x31, 0x03, 0xE4, 0xC9, 0xB6, 0x03, 0x01, 0xE8, 0x14, 0x05, 0x29, 0x06, 
+	0x40, 0x05, 0x0B, 0x00, 0x40, 0x5C, 0x00, 0x08, 0xC9, 0x01, 0x31, 0x06, 0x00, 0x66, 0x45, 0x09, 
+	0x00, 0xC9, 0x01, 0x13, 0x60, 0x48, 0x02, 0x55, 0x08, 0x00, 0x00, 0xA0, 0xF2, 0x29, 0x02, 0x03, 
+	0x23, 0x1F, 0x00, 0xFE, 0x00, 0x00, 0xCE, 0x13, 0x08, 0xE8, 0x06, 0x52, 0x01, 0x00, 0x00, 0x0B, 
+	0x3A, 0xD2, 0x0C, 0x07, 0x01, 0x00, 0x00, 0x58, 0x10, 0x0B, 0xED, 0x08, 0x00, 0x1E, 0x17, 0x31, 
+	0x0D, 0x3D, 0x28, 0x98, 0x03, 0x27, 0x0F, 0xA2, 0x53, 0x00, 0x01, 0x5F, 0x00, 0x25, 0x03, 0xC0, 
+	0x53, 0x00, 0x01, 0x74, 0x02, 0x21, 0x96, 0xE9, 0x88, 0x00, 0x2B, 0x7A, 0xFA, 0x59, 0x00, 0x25, 
+	0x18, 0x80, 0xB6, 0x04, 0x02, 0xF3, 0x0F, 0x3C, 0xA9, 0xF0, 0x91, 0xA6, 0x00, 0x80, 0x34, 0x00, 
+	0x80, 0x08, 0x80, 0x01, 0x00, 0x03, 0x55, 0x0F, 0x01, 0x01, 0x00, 0x00, 0x20, 0x02, 0x32, 0x01, 
+	0x80, 0x3F, 0xF2, 0x01, 0x0B, 0x96, 0x00, 0x01, 0x37, 0x00, 0x05, 0x53, 0x00, 0x20, 0x24, 0x02, 
+	0x7F, 0x01, 0x42, 0xC0, 0x14, 0x20, 0x20, 0x89, 0x05, 0x00, 0xB2, 0x13, 0x01, 0x53, 0x00, 0x20, 
+	0xA9, 0x90, 0x28, 0x00, 0x26, 0xD2, 0x46, 0xF9, 0x00, 0x00, 0xDF, 0x00, 0x42, 0x7E, 0x81, 0x40, 
+	0x20, 0xFF, 0x08, 0x04, 0x01, 0x00, 0x01, 0x1A, 0x0D, 0x37, 0x00, 0x00, 0x88, 0xE5, 0x10, 0x00, 
+	0x57, 0x18, 0x02, 0x47, 0x00, 0x01, 0xD7, 0x02, 0x03, 0xA6, 0x00, 0x01, 0x0C, 0x0C, 0x06, 0x4C, 
+	0x01, 0x92, 0x40, 0x08, 0x08, 0x00, 0x08, 0x30, 0x00, 0x08, 0x19, 0x34, 0x00, 0x07, 0x30, 0x05, 
+	0x31, 0x0E, 0x70, 0x0A, 0xE9, 0x13, 0x03, 0x64, 0x01, 0x01, 0xC5, 0x1C, 0x80, 0x80, 0x58, 0x00, 
+	0x00, 0x0F, 0x20, 0x90, 0x02, 0xB1, 0x15, 0x21, 0xD1, 0x80, 0xA5, 0x00, 0x40, 0x00, 0x20, 0x00, 
+	0x26, 0x49, 0x02, 0x55, 0x80, 0x03, 0x00, 0x3B, 0x88, 0xA6, 0x00, 0x00, 0xEF, 0x03, 0x30, 0x0A, 
+	0x90, 0x40, 0x34, 0x00, 0x34, 0x02, 0xC0, 0xBD, 0x23, 0x04, 0xB0, 0x14, 0x2C, 0x00, 0x02, 0x40, 
+	0x10, 0x18, 0x80, 0x89, 0x28, 0x20, 0x39, 0x16, 0x02, 0xA6, 0x00, 0x50, 0x20, 0x00, 0x50, 0x03, 
+	0x02, 0x24, 0x15, 0x35, 0x07, 0x65, 0x05, 0xE5, 0x00, 0x02, 0x27, 0x02, 0x63, 0x05, 0x10, 0x90, 
+	0x02, 0x80, 0x08, 0x55, 0x00, 0xD3, 0x08, 0x04, 0x80, 0x08, 0x00, 0x80, 0x16, 0x80, 0x02, 0x00, 
+	0x00, 0x2E, 0x1A, 0x67, 0x03, 0x12, 0x0A, 0x8C, 0x03, 0x50, 0x28, 0x00, 0x80, 0xA8, 0x60, 0x10, 
+	0x14, 0x02, 0xAC, 0x00, 0x60, 0x82, 0x08, 0x05, 0x00, 0xFF, 0x34, 0x90, 0x01, 0x00, 0xCC, 0x1C, 
+	0x11, 0x00, 0xB5, 0x0E, 0x21, 0x20, 0x03, 0xFF, 0x14, 0x31, 0x81, 0x00, 0x1B, 0x2D, 0x01, 0x02, 
+	0x3F, 0x00, 0x92, 0x28, 0x01, 0x00, 0x25, 0x8A, 0x96, 0xD0, 0x00, 0x05, 0xA2, 0x1D, 0x01, 0x39, 
+	0x02, 0x00, 0x09, 0x00, 0x11, 0x60, 0x45, 0x02, 0x00, 0x64, 0x00, 0x05, 0xDD, 0x04, 0x69, 0x08, 
+	0x00, 0x09, 0x09, 0x78, 0x3C, 0x93, 0x05, 0x02, 0x98, 0x02, 0x68, 0x00, 0x80, 0x00, 0x90, 0xBA, 
+	0xB0, 0x98, 0x02, 0x4D, 0x01, 0x9C, 0x7F, 0x83, 0xAD, 0x07, 0x01, 0x13, 0x0E, 0x48, 0x39, 0x8F, 
+	0x7C, 0x0C, 0x53, 0x00, 0x43, 0x90, 0x00, 0x01, 0x68, 0x71, 0x0E, 0x05, 0x53, 0x00, 0x00, 0x9B, 
+	0x00, 0x11, 0x81, 0x8A, 0x04, 0x50, 0x22, 0x00, 0x00, 0x00, 0x29, 0x80, 0x1A, 0x64, 0x00, 0x00, 
+	0x08, 0x0C, 0x30, 0x16, 0xA6, 0x15, 0x05, 0x01, 0x00, 0x02, 0x9F, 0x01, 0x10, 0x80, 0x82, 0x1A, 
+	0x50, 0x00, 0x00, 0x06, 0x19, 0x90, 0x35, 0x04, 0x02, 0xFF, 0x01, 0x10, 0x20, 0x0F, 0x0F, 0x03, 
+	0x75, 0x04, 0x05, 0xA4, 0x02, 0x10, 0x80, 0x8C, 0x01, 0x02, 0x0D, 0x00, 0x01, 0x98, 0x02, 0x03, 
+	0x46, 0x00, 0x00, 0x75, 0x16, 0x0A, 0xAE, 0x00, 0x36, 0x18, 0x80, 0x78, 0x22, 0x07, 0x00, 0x98, 
+	0x02, 0x00, 0x4A, 0x00, 0x41, 0x24, 0x00, 0x03, 0x40, 0x44, 0x1D, 0x03, 0x53, 0x00, 0x00, 0xD6, 
+	0x04, 0x40, 0x01, 0x90, 0x57, 0x04, 0x40, 0x00, 0x40, 0x21, 0x40, 0x08, 0x40, 0xBE, 0x1D, 0x11, 
+	0x01, 0xCA, 0x19, 0x00, 0x4C, 0x01, 0x04, 0x37, 0x13, 0x00, 0x68, 0x00, 0x00, 0x0C, 0x00, 0x33, 
+	0x18, 0xA3, 0x60, 0x88, 0x00, 0x00, 0x45, 0x02, 0x87, 0x08, 0x00, 0x00, 0x83, 0x41, 0x40, 0x00, 
+	0x20, 0x3B, 0x06, 0x33, 0x20, 0x00, 0x42, 0x3E, 0x03, 0x10, 0x30, 0x33, 0x10, 0x03, 0xF2, 0x01, 
+	0x50, 0x30, 0x00, 0x00, 0x1D, 0x03, 0xE1, 0x01, 0x09, 0x77, 0x01, 0x02, 0x7A, 0x17, 0x21, 0x81, 
+	0xA8, 0xC3, 0x00, 0x02, 0xEF, 0x05, 0x73, 0x80, 0x38, 0x00, 0x08, 0x03, 0xB4, 0x49, 0x53, 0x00, 
+	0x02, 0x62, 0x07, 0x20, 0x20, 0x03, 0x2C, 0x08, 0x00, 0x5E, 0x16, 0x61, 0x08, 0x01, 0x00, 0x06, 
+	0x00, 0x02, 0xE3, 0x0E, 0xC2, 0x0F, 0x83, 0x10, 0x05, 0x00, 0x9A, 0x21, 0x10, 0x00, 0x00, 0x20, 
+	0x38, 0x40, 0x01, 0x02, 0x01, 0x00, 0x30, 0x1A, 0x10, 0x48, 0x77, 0x1D, 0xF0, 0x02, 0x00, 0x01, 
+	0x20, 0x40, 0x01, 0xE0, 0x00, 0x10, 0x20, 0x00, 0x80, 0x81, 0xA2, 0x00, 0x00, 0x03, 0xAD, 0x30, 
+	0x05, 0x07, 0x01, 0x00, 0x32, 0x01, 0x40, 0x14, 0x35, 0x15, 0x02, 0xA1, 0x00, 0x02, 0x95, 0x1B, 
+	0x51, 0x04, 0x80, 0x00, 0x1C, 0xDA, 0x30, 0x05, 0x05, 0x01, 0x00, 0x02, 0x4E, 0x0F, 0x93, 0x40, 
+	0x68, 0x00, 0x18, 0xE0, 0x04, 0x09, 0x00, 0xA0, 0x5D, 0x09, 0x10, 0x82, 0xEA, 0x04, 0x30, 0x28, 
+	0x00, 0x08, 0xCE, 0x00, 0x02, 0xF0, 0x24, 0x00, 0xEE, 0x25, 0x02, 0x03, 0x1E, 0x01, 0x1A, 0x01, 
+	0x71, 0x22, 0x00, 0x00, 0x20, 0x0D, 0x00, 0x41, 0x3E, 0x03, 0x14, 0x0E, 0xCF, 0x12, 0x05, 0x75, 
+	0x07, 0x01, 0x01, 0x00, 0x62, 0x10, 0x00, 0x01, 0x80, 0x20, 0x41, 0x74, 0x26, 0x01, 0x3A, 0x02, 
+	0x04, 0x4F, 0x08, 0x30, 0xC2, 0x35, 0x98, 0xFF, 0x03, 0x03, 0x01, 0x00, 0x71, 0x05, 0xA0, 0x00, 
+	0x20, 0x71, 0x08, 0x14, 0x25, 0x11, 0x22, 0x38, 0x0C, 0x40, 0x01, 0x03, 0x84, 0x0E, 0x37, 0x20, 
+	0x05, 0x4F, 0x72, 0x0F, 0x92, 0x60, 0x5A, 0x40, 0x10, 0x04, 0x00, 0x18, 0x69, 0x55, 0x60, 0x00, 
+	0x17, 0x26, 0xCE, 0x05, 0x53, 0x11, 0xC3, 0x25, 0xE1, 0x20, 0x00, 0x01, 0x02, 0x3A, 0x27, 0x00, 
+	0x5E, 0x08, 0x13, 0xD1, 0x41, 0x17, 0x02, 0x17, 0x00, 0x01, 0x06, 0x00, 0x42, 0xA0, 0x84, 0x24, 
+	0x4C, 0x4C, 0x10, 0x40, 0x00, 0x00, 0x01, 0x16, 0x03, 0x08, 0x50, 0x00, 0x00, 0x00, 0xC9, 0x7C, 
+	0xF4, 0x17, 0x03, 0xB4, 0x00, 0x05, 0x46, 0x01, 0x46, 0xC2, 0x00, 0xF8, 0x02, 0x53, 0x01, 0x10, 
+	0xD0, 0x02, 0x03, 0x20, 0x0A, 0x50, 0x32, 0x19, 0x01, 0x6B, 0x07, 0x07, 0x83, 0x0F, 0x38, 0x20, 
+	0x01, 0x6D, 0x7A, 0x01, 0x01, 0x3C, 0x14, 0x41, 0x00, 0x00, 0x01, 0x04, 0xA8, 0x03, 0x35, 0x26, 
+	0x80, 0x24, 0x6E, 0x01, 0x20, 0x20, 0x40, 0xEE, 0x24, 0x01, 0x85, 0x1B, 0x03, 0x27, 0x02, 0x30, 
+	0x10, 0x00, 0x00, 0x53, 0x00, 0x01, 0xDD, 0x04, 0x10, 0x28, 0x0F, 0x00, 0x13, 0x47, 0xD2, 0x15, 
+	0x10, 0x62, 0x35, 0x01, 0x02, 0x1A, 0x00, 0x20, 0x04, 0x20, 0xFD, 0x1C, 0x13, 0x80, 0x45, 0x08, 
+	0x21, 0x60, 0x00, 0x2D, 0x1A, 0x00, 0xD0, 0x00, 0x10, 0xB1, 0x31, 0x02, 0x20, 0x63, 0xD4, 0x53, 
+	0x00, 0x02, 0x60, 0x00, 0x82, 0xE3, 0x1D, 0x9B, 0xE0, 0x00, 0x08, 0x0B, 0x18, 0xCF, 0x06, 0x02, 
+	0x01, 0x00, 0xB5, 0x30, 0x00, 0x00, 0x0A, 0x58, 0x10, 0x80, 0x00, 0x20, 0x24, 0x7A, 0x23, 0x04, 
+	0xA0, 0x80, 0x3E, 0x04, 0x58, 0xD7, 0x00, 0x01, 0x0A, 0x91, 0xC8, 0x53, 0x00, 0x03, 0xA0, 0x04, 
+	0xE2, 0x41, 0x20, 0x00, 0x50, 0x07, 0x3A, 0x64, 0x00, 0x00, 0x80, 0xC3, 0x07, 0xC2, 0x50, 0x64, 
+	0x00, 0x00, 0xF8, 0x1A, 0x85, 0x05, 0x50, 0x03, 0x10, 0x01, 0x0A, 0x00, 0x01, 0x00, 0x0F, 0x20, 
+	0x02, 0x81, 0x3D, 0x16, 0x82, 0x19, 0x80, 0x00, 0x00, 0x14, 0x01, 0xDB, 0x4A, 0x14, 0x00, 0x00, 
+	0x67, 0x01, 0x44, 0xCC, 0x55, 0x40, 0x30, 0x14, 0x09, 0x03, 0x59, 0x0B, 0x03, 0x8A, 0x01, 0x62, 
+	0x80, 0x03, 0xC0, 0x17, 0x00, 0xA0, 0xB6, 0x01, 0x50, 0x80, 0x01, 0xC2, 0x84, 0xB6, 0x09, 0x00, 
+	0x30, 0x9A, 0x92, 0xC0, 0x18, 0x21, 0x03, 0x57, 0x00, 0x04, 0xE6, 0x05, 0x33, 0x20, 0x29, 0x7C, 
+	0x90, 0x00, 0x00, 0x1E, 0x14, 0xF2, 0x03, 0x0F, 0x90, 0x00, 0x28, 0x02, 0x38, 0xA9, 0x02, 0x04, 
+	0x00, 0x20, 0x02, 0x00, 0x00, 0xA1, 0x04, 0x00, 0x10, 0xDA, 0x00, 0x82, 0x10, 0x02, 0x00, 0x03, 
+	0xE2, 0xE4, 0xA2, 0x40, 0x30, 0x05, 0x31, 0x00, 0x02, 0xE4, 0x43, 0x04, 0x30, 0x05, 0x80, 0x9F, 
+	0xE1, 0x00, 0x11, 0x04, 0x47, 0x07, 0x01, 0x01, 0x00, 0xB2, 0x50, 0x00, 0x12, 0x00, 0x00, 0x3E, 
+	0x01, 0xDE, 0x20, 0x00, 0x10, 0x11, 0x04, 0x21, 0x34, 0x2A, 0x05, 0x01, 0x33, 0x50, 0xEF, 0xA6, 
+	0x62, 0x00, 0x30, 0x04, 0x00, 0x23, 0x53, 0x08, 0x90, 0x01, 0xA7, 0x00, 0x00, 0x00, 0xE2, 0x44, 
+	0x15, 0xB2, 0xDD, 0x22, 0x20, 0x0A, 0xF0, 0xAB, 0x02, 0x90, 0x35, 0x0A, 0xA0, 0x00, 0x01, 0x83, 
+	0x0E, 0x7F, 0xC1, 0x38, 0x00, 0x40, 0x03, 0x70, 0x00, 0x20, 0x13, 0x01, 0x40, 0x09, 0x80, 0x97, 
+	0x8C, 0x7B, 0x02, 0x80, 0x61, 0x6A, 0x33, 0x00, 0x30, 0x00, 0x78, 0x18, 0x6D, 0x00, 0xA0, 0x7A, 
+	0x18, 0x55, 0x00, 0x10, 0x00, 0x98, 0x81, 0xEC, 0x04, 0x5B, 0x00, 0x23, 0x25, 0x85, 0xDD, 0x01, 
+	0x20, 0x8D, 0xA3, 0x15, 0x01, 0x31, 0x06, 0x67, 0xC8, 0xB3, 0x00, 0xF0, 0x05, 0x90, 0x00, 0x00, 
+	0x03, 0x44, 0x2C, 0x00, 0x82, 0x88, 0x00, 0x01, 0x00, 0x16, 0x65, 0x80, 0x00, 0x00, 0x36, 0x00, 
+	0x4C, 0x40, 0x19, 0x00, 0x21, 0x13, 0x10, 0xD8, 0xBA, 0x09, 0x31, 0x06, 0x60, 0x59, 0xA2, 0x00, 
+	0x00, 0x17, 0x03, 0x00, 0xEA, 0x26, 0xD3, 0x60, 0x80, 0x00, 0x71, 0xC0, 0x71, 0xA4, 0x00, 0x00, 
+	0xA1, 0x40, 0x2C, 0x10, 0x1F, 0x0B, 0x20, 0x81, 0x83, 0x9C, 0x03, 0xE1, 0x44, 0x03, 0x05, 0x50, 
+	0x00, 0x01, 0x00, 0x09, 0x90, 0x04, 0x00, 0x00, 0xC2, 0x26, 0x6B, 0x25, 0xA2, 0x88, 0x3B, 0x30, 
+	0xC0, 0x00, 0x80, 0x64, 0x01, 0x50, 0x05, 0x83, 0x03, 0x91, 0x19, 0x13, 0x83, 0xC0, 0x00, 0x02, 
+	0x24, 0x69, 0x7E, 0x97, 0x1D, 0x10, 0x99, 0xD5, 0x20, 0x20, 0x01, 0xDC, 0x0B, 0x00, 0x40, 0x11, 
+	0xC5, 0x04, 0xF0, 0x9B, 0x1F, 0xB0, 0x25, 0xA0, 0x00, 0x00, 0x02, 0x32, 0x00, 0x00, 0x50, 0x99, 
+	0x69, 0x97, 0x01, 0x20, 0x20, 0x1C, 0x7D, 0x0E, 0x54, 0x01, 0x00, 0x30, 0x00, 0x0E, 0x52, 0x03, 
+	0x31, 0x10, 0x73, 0xFC, 0x43, 0x1B, 0x50, 0x40, 0xFA, 0x20, 0x00, 0x30, 0x07, 0x19, 0x86, 0x86, 
+	0xE0, 0x80, 0x01, 0x00, 0x04, 0x03, 0x6B, 0xA9, 0x0B, 0x02, 0xDE, 0x01, 0xA3, 0x10, 0xA1, 0x6F, 
+	0xC5, 0x80, 0x00, 0x60, 0x60, 0x01, 0xAF, 0x3B, 0x08, 0x10, 0xA0, 0xDF, 0x01, 0x90, 0x09, 0x60, 
+	0x00, 0xFF, 0xC0, 0x88, 0x00, 0x01, 0x80, 0x15, 0x00, 0x40, 0x63, 0xA7, 0xA7, 0xA0, 0x35, 0x03, 
+	0x10, 0xDF, 0xD7, 0x21, 0x12, 0x14, 0xC1, 0x06, 0x50, 0x30, 0x00, 0x05, 0x0A, 0x3B, 0x42, 0x00, 
+	0x40, 0x64, 0x78, 0x0E, 0xFC, 0xFB, 0x1E, 0x00, 0xB4, 0x01, 0xA0, 0x0E, 0x66, 0x5D, 0xB8, 0x00, 
+	0x00, 0x30, 0x10, 0x87, 0x76, 0x42, 0x01, 0x20, 0x62, 0xCE, 0x34, 0x04, 0x60, 0x20, 0x10, 0x00, 
+	0x00, 0xB5, 0xE6, 0x2C, 0x15, 0xF0, 0x06, 0x66, 0x82, 0x05, 0x50, 0x03, 0x00, 0x10, 0x10, 0xF0, 
+	0x00, 0xC0, 0x01, 0x42, 0x3C, 0xA3, 0x80, 0x00, 0x11, 0x03, 0x0E, 0x76, 0xD9, 0x07, 0xF0, 0x07, 
+	0x14, 0x00, 0xCA, 0x24, 0x00, 0x04, 0x80, 0x43, 0x00, 0x00, 0x00, 0xDA, 0xD5, 0x80, 0x00, 0x01, 
+	0x7E, 0x29, 0x4C, 0x55, 0x20, 0x51, 0x5A, 0x0A, 0xB1, 0x04, 0x00, 0x00, 0x76, 0x4B, 0x2C, 0x00, 
+	0x02, 0x98, 0xD0, 0x89, 0x1E, 0x16, 0xB0, 0x06, 0xA0, 0x11, 0x80, 0x00, 0x08, 0x30, 0x20, 0x00, 
+	0x00, 0xE0, 0x59, 0x0B, 0xF0, 0x08, 0x03, 0x44, 0x2C, 0xC7, 0x23, 0x08, 0x00, 0x07, 0x1F, 0xBA, 
+	0x48, 0x0A, 0x04, 0x22, 0xB5, 0xD0, 0x00, 0x02, 0x28, 0x4B, 0x0A, 0xF4, 0x15, 0x11, 0x22, 0xF0, 
+	0x1D, 0x29, 0x6A, 0x42, 0x00, 0x00, 0x60, 0x40, 0x80, 0x07, 0x00, 0x00, 0x4F, 0x12, 0x00, 0x00, 
+	0x20, 0x2A, 0x19, 0xB1, 0x00, 0x68, 0x40, 0x01, 0xCB, 0x80, 0x0A, 0x80, 0x9E, 0x28, 0x5A, 0x01, 
+	0x00, 0x09, 0x02, 0xD8, 0x08, 0x2A, 0xA8, 0x00, 0xA0, 0x02, 0x06, 0x96, 0x10, 0x48, 0x0C, 0x50, 
+	0x00, 0x00, 0xF0, 0xA0, 0x83, 0x7C, 0x14, 0xE0, 0x02, 0xBC, 0xA9, 0x60, 0x00, 0x02, 0x09, 0x10, 
+	0x52, 0x00, 0x00, 0x03, 0xC2, 0x80, 0xC5, 0x1D, 0x30, 0x0B, 0x0D, 0x12, 0x35, 0x02, 0x50, 0x14, 
+	0x2B, 0x5E, 0x3C, 0x01, 0xBA, 0x09, 0x31, 0x05, 0x0A, 0x72, 0x28, 0x26, 0x30, 0x6C, 0x1E, 0x69, 
+	0x46, 0x1D, 0xE1, 0xC8, 0x04, 0x00, 0x00, 0x34, 0x38, 0x18, 0x0F, 0x40, 0x40, 0x00, 0xD8, 0x1F, 
+	0xA8, 0xBC, 0x0B, 0x33, 0x1D, 0x81, 0xC4, 0xD3, 0x03, 0x00, 0x14, 0x18, 0x01, 0xC3, 0x0E, 0x00, 
+	0x3F, 0x15, 0x00, 0x35, 0x07, 0x71, 0x40, 0x00, 0x83, 0x30, 0x08, 0x01, 0x03, 0xED, 0x0B, 0x33, 
+	0x0A, 0x00, 0x23, 0xEB, 0x02, 0x30, 0x05, 0x9A, 0x1A, 0xC1, 0x17, 0x60, 0x1C, 0x00, 0x1E, 0x10, 
+	0x50, 0x70, 0x51, 0x0D, 0x00, 0x63, 0x01, 0xB0, 0x19, 0x33, 0x00, 0x80, 0x28, 0x00, 0xE0, 0x68, 
+	0x41, 0x00, 0x40, 0x9B, 0x02, 0x01, 0x80, 0x03, 0x23, 0x20, 0x00, 0xBA, 0x18, 0x30, 0xDC, 0xA9, 
+	0x90, 0xBD, 0x07, 0xD0, 0x30, 0x00, 0x00, 0x60, 0x02, 0x00, 0x93, 0x30, 0x10, 0x00, 0x20, 0x08, 
+	0x98, 0xB9, 0x0E, 0x24, 0x04, 0x21, 0x89, 0x10, 0x91, 0x1C, 0x02, 0x0C, 0xE0, 0x00, 0x00, 0x0E, 
+	0x04, 0xC0, 0x10, 0x00, 0x01, 0xAF, 0x05, 0x30, 0x20, 0x19, 0x33, 0x27, 0x02, 0x21, 0x11, 0xF8, 
+	0x4E, 0x06, 0x04, 0xE7, 0x0D, 0x40, 0x50, 0x00, 0x37, 0x30, 0x09, 0x03, 0x60, 0x04, 0x00, 0x80, 
+	0x0C, 0x00, 0x0F, 0x04, 0x26, 0x42, 0x60, 0x02, 0x36, 0x00, 0x2B, 0x26, 0x01, 0xD5, 0x17, 0x31, 
+	0x43, 0xDB, 0x5E, 0xEF, 0x04, 0x10, 0x08, 0xB3, 0x19, 0x20, 0x00, 0xA0, 0xCC, 0x03, 0x31, 0x40, 
+	0x40, 0x00, 0x3B, 0x19, 0x80, 0x06, 0x73, 0x58, 0x50, 0x00, 0x00, 0x12, 0x01, 0xB3, 0x0A, 0x51, 
+	0x0A, 0x02, 0x02, 0x0D, 0x85, 0xF5, 0x1E, 0xA0, 0x00, 0x50, 0x00, 0x3F, 0x30, 0x01, 0x10, 0x08, 
+	0x22, 0x2C, 0x53, 0x00, 0x20, 0x00, 0x0E, 0x82, 0x06, 0x60, 0x03, 0x41, 0x05, 0x50, 0x00, 0x10, 
+	0xBB, 0x1D, 0x10, 0x08, 0xAB, 0x0B, 0x11, 0x3A, 0x26, 0x1C, 0xA7, 0x00, 0x08, 0x1A, 0x02, 0x4C, 
+	0xE0, 0x01, 0x01, 0x14, 0x04, 0x1B, 0x08, 0x41, 0x05, 0xEE, 0x55, 0x60, 0xA6, 0x06, 0x70, 0x09, 
+	0x80, 0x00, 0x02, 0x02, 0x8E, 0xDA, 0xC7, 0x22, 0x00, 0x01, 0x00, 0x22, 0x83, 0x30, 0x22, 0x0A, 
+	0x00, 0xF6, 0x18, 0x10, 0x08, 0x7D, 0x08, 0x24, 0xC2, 0x6E, 0xDB, 0x21, 0x73, 0x00, 0x00, 0x40, 
+	0x16, 0x01, 0x6F, 0x83, 0xBB, 0x03, 0x10, 0x72, 0xF9, 0x00, 0x81, 0x1E, 0x01, 0x60, 0x00, 0x68, 
+	0x00, 0x05, 0x58, 0x99, 0x15, 0x30, 0x2A, 0xEB, 0x0C, 0x41, 0x28, 0x93, 0x00, 0x78, 0x41, 0x00, 
+	0x02, 0x03, 0x46, 0x37, 0x94, 0x85, 0x1E, 0xF0, 0x0A, 0x00, 0x2B, 0x30, 0x00, 0xC0, 0x00, 0x27, 
+	0xC2, 0xCC, 0xC0, 0x03, 0x00, 0x05, 0x00, 0x90, 0x00, 0xC0, 0x00, 0x20, 0x24, 0xB9, 0x90, 0x00, 
+	0x12, 0xA0, 0x53, 0x00, 0x61, 0x04, 0x00, 0x04, 0x2C, 0xCB, 0x08, 0x29, 0x06, 0x10, 0x07, 0xF9, 
+	0x00, 0xF2, 0x06, 0x04, 0x00, 0x16, 0x2D, 0x41, 0x33, 0x00, 0x30, 0x08, 0xD9, 0xA0, 0x00, 0x0C, 
+	0x00, 0x1E, 0x2A, 0x01, 0x66, 0x00, 0x82, 0x01, 0x22, 0x07, 0x42, 0x02, 0x00, 0x20, 0xB0, 0xBE, 
+	0x00, 0x10, 0xF0, 0xF2, 0x01, 0xF0, 0x08, 0x80, 0x08, 0x20, 0x3C, 0x0A, 0xA0, 0x02, 0x00, 0x05, 
+	0x00, 0x72, 0xC0, 0x00, 0x01, 0x42, 0x82, 0x0C, 0xC1, 0x04, 0x10, 0x0B, 0x00, 0x17, 0x14, 0x02, 
+	0x50, 0x34, 0x2E, 0x49, 0x99, 0x08, 0x5F, 0x05, 0xF4, 0x15, 0x08, 0x00, 0x7F, 0x0C, 0xE0, 0x02, 
+	0x01, 0x5E, 0x78, 0x4A, 0xA5, 0x00, 0x08, 0x00, 0x81, 0xA5, 0x04, 0x0A, 0x00, 0x14, 0x00, 0xC8, 
+	0x33, 0x00, 0x2B, 0x12, 0x80, 0xA3, 0x2D, 0xEC, 0x00, 0xA0, 0x04, 0x02, 0x80, 0x16, 0x09, 0x07, 
+	0x00, 0x05, 0x0C, 0x22, 0x01, 0xC0, 0xC1, 0x17, 0x12, 0x89, 0xC4, 0x0F, 0xC0, 0x0C, 0xC1, 0x44, 
+	0x00, 0x05, 0x8A, 0x18, 0x3F, 0xC8, 0x40, 0x01, 0x40, 0x4F, 0x21, 0x03, 0x01, 0x00, 0x01, 0xF8, 
+	0x0C, 0x80, 0x00, 0x60, 0x00, 0x78, 0x40, 0x80, 0x10, 0x08, 0x17, 0x01, 0x81, 0x01, 0x68, 0x33, 
+	0x88, 0x00, 0x00, 0xD0, 0xC3, 0x8F, 0x02, 0x21, 0x06, 0xC0, 0xF4, 0x17, 0x2F, 0x11, 0x02, 0xBC, 
+	0x2E, 0x01, 0x00, 0x31, 0x1C, 0x02, 0x44, 0x00, 0x0E, 0x1C, 0x00, 0x09, 0x01, 0x00, 0x0F, 0x28, 
+	0x16, 0x0D, 0x0B, 0xAA, 0x0C, 0x3F, 0x40, 0x00, 0x2C, 0x62, 0x15, 0x08, 0x09, 0x01, 0x00, 0x0F, 
+	0xBE, 0x2E, 0x04, 0x06, 0x42, 0x0C, 0x00, 0xFA, 0x07, 0x10, 0x10, 0x65, 0x01, 0x18, 0x78, 0xDB, 
+	0x0A, 0x05, 0x01, 0x00, 0x06, 0x0B, 0x00, 0x12, 0x01, 0x33, 0x0E, 0x00, 0x3E, 0x23, 0x06, 0x01, 
+	0x00, 0x0D, 0xD9, 0x00, 0x26, 0x20, 0x70, 0x9A, 0x00, 0x09, 0xF1, 0x0A, 0x06, 0x80, 0x07, 0x03, 
+	0x53, 0x00, 0x1F, 0x07, 0x12, 0x13, 0x0E, 0x02, 0x1E, 0x07, 0x01, 0xA5, 0x17, 0x12, 0x10, 0xB5, 
+	0x08, 0x18, 0x10, 0xBC, 0x2E, 0x0F, 0xF3, 0x17, 0x10, 0x03, 0x01, 0x00, 0x18, 0x10, 0xF1, 0x14, 
+	0x15, 0x20, 0xA1, 0x11, 0x01, 0xE4, 0x01, 0x09, 0x0B, 0x15, 0x12, 0x0B, 0x29, 0x11, 0x05, 0x01, 
+	0x00, 0x00, 0xDB, 0x12, 0x00, 0xAF, 0x00, 0x00, 0x80, 0x07, 0x00, 0xA4, 0x01, 0x06, 0x0E, 0x01, 
+	0x21, 0xA0, 0x00, 0x50, 0x03, 0x0C, 0x01, 0x00, 0x01, 0xC6, 0x1F, 0x05, 0x61, 0x00, 0x02, 0x01, 
+	0x00, 0x16, 0x06, 0x96, 0x10, 0x06, 0x55, 0x2E, 0x03, 0x17, 0x0D, 0x02, 0x70, 0x21, 0x02, 0x42, 
+	0x09, 0x01, 0x82, 0x0E, 0x01, 0x20, 0x00, 0x03, 0x64, 0x01, 0x03, 0x21, 0x04, 0x06, 0x0C, 0x00, 
+	0x0C, 0x01, 0x00, 0x07, 0x37, 0x02, 0x08, 0xB8, 0x00, 0x0A, 0xC4, 0x00, 0x07, 0x67, 0x01, 0x10, 
+	0x01, 0xCD, 0x1E, 0x06, 0xE6, 0x01, 0x17, 0x1A, 0x42, 0x00, 0x38, 0x09, 0x79, 0x80, 0x2A, 0x00, 
+	0x12, 0x28, 0x03, 0x0B, 0x03, 0x7F, 0x00, 0x10, 0x50, 0x54, 0x00, 0x01, 0xAD, 0x2C, 0x3D, 0xA0, 
+	0x3F, 0xC1, 0x14, 0x2E, 0x05, 0x12, 0x02, 0x30, 0x96, 0x80, 0xE8, 0x01, 0x09, 0x20, 0xCC, 0xF0, 
+	0x35, 0x05, 0x01, 0xD7, 0x0C, 0x19, 0x15, 0x29, 0x00, 0x05, 0x6D, 0x00, 0x21, 0x01, 0x68, 0x0B, 
+	0x05, 0x53, 0x83, 0x3B, 0x00, 0x22, 0xD4, 0x83, 0x01, 0x02, 0xB6, 0x08, 0x05, 0x9B, 0x00, 0x04, 
+	0x8B, 0x00, 0x10, 0x90, 0xC1, 0x02, 0x31, 0x08, 0x01, 0xCC, 0xAB, 0x01, 0x01, 0xE9, 0x23, 0x0F, 
+	0x01, 0x00, 0x03, 0x12, 0x08, 0xE5, 0x07, 0x30, 0xC0, 0x03, 0x3B, 0x0E, 0x00, 0x13, 0x20, 0x28, 
+	0x00, 0x0F, 0x56, 0x17, 0x02, 0x11, 0x82, 0x79, 0x0F, 0xA7, 0x05, 0xCC, 0x16, 0x80, 0x28, 0x01, 
+	0x00, 0x01, 0x9A, 0x1E, 0x30, 0x01, 0x0C, 0x7D, 0x12, 0x01, 0x75, 0x01, 0x9F, 0x03, 0x30, 0x00, 
+	0x04, 0x01, 0x20, 0x24, 0x19, 0xBC, 0xD7, 0x18, 0x0A, 0x00, 0x04, 0x0A, 0x20, 0xCC, 0x90, 0x31, 
+	0x00, 0x31, 0x08, 0x20, 0xC0, 0x1E, 0x0C, 0x0F, 0xBA, 0x1A, 0x08, 0x20, 0x03, 0x33, 0x37, 0x0C, 
+	0x26, 0x01, 0x00, 0xDC, 0x1C, 0x0F, 0xE4, 0x19, 0x03, 0x50, 0x02, 0x81, 0xCC, 0x16, 0x16, 0x89, 
+	0x22, 0x1F, 0xF0, 0x0B, 0x16, 0x0E, 0xBF, 0x03, 0x30, 0x00, 0x02, 0x50, 0x00, 0x00, 0x0F, 0x1C, 
+	0x0D, 0x0A, 0xBD, 0x0E, 0x00, 0x04, 0x01, 0x00, 0xEF, 0x18, 0x00, 0x00, 0x81, 0xCC, 0x10, 0x16, 
+	0x68, 0x00, 0x04, 0x01, 0x98, 0x00, 0x51, 0x34, 0x17, 0x09, 0x00, 0xAF, 0x1E, 0x10, 0x3F, 0x09, 
+	0x00, 0x5F, 0x80, 0x26, 0x5C, 0xD5, 0x8D, 0x78, 0x01, 0x04, 0x02, 0xE0, 0x15, 0x32, 0x08, 0x81, 
+	0xCC, 0xB6, 0x10, 0x3F, 0xF4, 0xEE, 0x81, 0x53, 0x00, 0x03, 0x10, 0x10, 0xAE, 0x14, 0x00, 0x13, 
+	0x01, 0x21, 0x43, 0x39, 0xE4, 0x22, 0x28, 0x0F, 0x5F, 0x51, 0x1B, 0x64, 0x01, 0x00, 0x01, 0xC4, 
+	0x87, 0x98, 0x86, 0x01, 0x11, 0x40, 0xCE, 0x30, 0x40, 0x01, 0xCC, 0x17, 0xB4, 0x0B, 0x29, 0x2A, 
+	0x25, 0x6A, 0xC2, 0x02, 0x33, 0x1E, 0xE0, 0x78, 0x63, 0x00, 0x00, 0xA9, 0x11, 0x70, 0x50, 0x00, 
+	0x00, 0x02, 0x43, 0x30, 0x40, 0x35, 0x0A, 0x20, 0x02, 0x75, 0xE5, 0x1F, 0x04, 0x01, 0x00, 0x53, 
+	0x45, 0x00, 0x80, 0x04, 0xC0, 0x54, 0x01, 0xF5, 0x05, 0x40, 0x00, 0x73, 0x16, 0x85, 0x9A, 0x00, 
+	0x40, 0x04, 0xCC, 0x12, 0x00, 0x2A, 0x00, 0x50, 0x01, 0x9A, 0x01, 0x00, 0x01, 0x21, 0x0F, 0x40, 
+	0x02, 0x40, 0x00, 0x14, 0x94, 0x00, 0x03, 0x0F, 0x00, 0x80, 0xCC, 0x30, 0xD0, 0x00, 0x08, 0x00, 
+	0x43, 0x30, 0x0F, 0x0F, 0x67, 0x20, 0x26, 0x4C, 0xE0, 0x00, 0x1C, 0x4C, 0x03, 0x11, 0xA0, 0x56, 
+	0x27, 0x02, 0x01, 0x00, 0x22, 0x73, 0x05, 0x24, 0x24, 0x99, 0x02, 0x04, 0x00, 0x00, 0x20, 0x02, 
+	0xA9, 0xC0, 0x98, 0x1C, 0x02, 0x26, 0x02, 0x5E, 0x0C, 0x00, 0x02, 0xA4, 0x30, 0x01, 0xE2, 0x03, 
+	0x50, 0x03, 0x00, 0x15, 0x42, 0xE9, 0xA7, 0x06, 0x01, 0x98, 0x02, 0x00, 0x50, 0x03, 0x44, 0x09, 
+	0x3E, 0x80, 0x01, 0x6B, 0x16, 0x42, 0x73, 0x05, 0x8D, 0x01, 0x91, 0x00, 0x00, 0x30, 0x00, 0x20, 
+	0xA8, 0xE1, 0x01, 0x2B, 0x02, 0xFA, 0x00, 0x00, 0x06, 0x00, 0x44, 0x81, 0x59, 0x00, 0x8A, 0x23, 
+	0x02, 0x30, 0xCC, 0x10, 0x50, 0x05, 0x01, 0x01, 0x91, 0x03, 0x55, 0x04, 0x15, 0x42, 0xC9, 0x89, 
+	0x6D, 0x00, 0x54, 0x40, 0x00, 0x00, 0xA8, 0x04, 0x46, 0x0E, 0x31, 0x20, 0x00, 0x73, 0x17, 0x19, 
+	0x21, 0x02, 0x08, 0x30, 0x20, 0x27, 0x03, 0x31, 0x25, 0x17, 0x01, 0x7C, 0x0E, 0x22, 0x29, 0x10, 
+	0x71, 0x11, 0x14, 0x05, 0xA6, 0x00, 0x03, 0x01, 0x00, 0x11, 0x33, 0x97, 0x34, 0x06, 0x01, 0x00, 
+	0x26, 0xB6, 0xC0, 0xA9, 0x13, 0x12, 0x73, 0xD5, 0x0E, 0x02, 0x37, 0x00, 0x42, 0x18, 0x20, 0xE0, 
+	0x81, 0x85, 0x24, 0x02, 0x01, 0x00, 0x24, 0x03, 0x6D, 0x18, 0x0F, 0x42, 0x00, 0x00, 0x00, 0xCE, 
+	0xF3, 0x0D, 0x00, 0x6B, 0x00, 0x00, 0x7F, 0x2B, 0x28, 0x09, 0x19, 0xC8, 0x01, 0x33, 0x16, 0xA1, 
+	0xA1, 0xB7, 0x2B, 0x06, 0x4C, 0x01, 0x00, 0x89, 0x03, 0x57, 0x02, 0x08, 0x00, 0x1C, 0x81, 0x4A, 
+	0x01, 0x30, 0x04, 0x02, 0xF5, 0xCB, 0x1E, 0x03, 0x01, 0x00, 0x02, 0x07, 0x04, 0x30, 0x01, 0x00, 
+	0x20, 0xED, 0x03, 0x32, 0x08, 0x00, 0x09, 0x11, 0x01, 0x10, 0x25, 0x47, 0x0D, 0x00, 0x6E, 0x11, 
+	0x05, 0x24, 0x03, 0x21, 0x20, 0x73, 0xE0, 0x00, 0x40, 0x02, 0x00, 0x06, 0xA0, 0x6F, 0x02, 0x41, 
+	0x3D, 0x7D, 0x00, 0x18, 0x45, 0x00, 0x3A, 0xA5, 0x03, 0xFC, 0x0A, 0x16, 0x31, 0x02, 0x00, 0xCF, 
+	0x95, 0x00, 0x10, 0x02, 0x2A, 0x09, 0x57, 0x20, 0x00, 0x3C, 0x02, 0xB0, 0xC3, 0x24, 0x08, 0x01, 
+	0x00, 0x50, 0x02, 0x00, 0x33, 0x04, 0xE8, 0x14, 0x05, 0xC0, 0x0C, 0x16, 0xA6, 0x70, 0x00, 0x10, 
+	0x00, 0x46, 0xEA, 0x80, 0x90, 0x00, 0x33, 0x00, 0x09, 0x01, 0x00, 0x70, 0x72, 0x00, 0x24, 0x00, 
+	0x40, 0x80, 0xCC, 0xAF, 0x03, 0xCD, 0x00, 0x00, 0x3F, 0xE3, 0xC6, 0xC0, 0x00, 0x00, 0x22, 0x2F, 
+	0xB5, 0x1D, 0x36, 0x04, 0x30, 0x15, 0x08, 0x7C, 0x1B, 0x0A, 0x40, 0x0F, 0x00, 0xC3, 0x8A, 0xEE, 
+	0x01, 0x87, 0x1F, 0x66, 0x64, 0x00, 0x70, 0x03, 0x30, 0xEF, 0x51, 0x14, 0x05, 0x01, 0x00, 0x90, 
+	0xB6, 0xC0, 0x34, 0x00, 0x10, 0x03, 0x0C, 0x5B, 0x50, 0xAD, 0x0D, 0xA7, 0x1D, 0xB1, 0x46, 0x40, 
+	0x01, 0x00, 0x12, 0x0C, 0xA0, 0x0A, 0xE4, 0x05, 0x11, 0x80, 0x76, 0x04, 0x01, 0xC6, 0x04, 0xD0, 
+	0x03, 0x00, 0x30, 0x17, 0xE5, 0x1C, 0x00, 0x08, 0x00, 0x50, 0x3A, 0x24, 0x20, 0x06, 0x05, 0x20, 
+	0x0A, 0x51, 0x81, 0x09, 0x05, 0x01, 0x00, 0x01, 0x50, 0x13, 0x01, 0x06, 0x00, 0x41, 0x60, 0x00, 
+	0x0D, 0xDB, 0xA6, 0x36, 0xE6, 0x0B, 0xB0, 0x42, 0x80, 0x02, 0x00, 0x08, 0x01, 0x05, 0x08, 0x00, 
+	0x0C, 0x02, 0x3A, 0x2B, 0x00, 0x01, 0xD5, 0x19, 0x02, 0x95, 0x27, 0x11, 0x2F, 0x8B, 0x2D, 0x30, 
+	0x3C, 0x86, 0x76, 0x74, 0x00, 0x45, 0x14, 0x4A, 0x78, 0x11, 0x32, 0x05, 0x01, 0x30, 0x05, 0x00, 
+	0x16, 0x01, 0x00, 0x58, 0x01, 0xB1, 0x40, 0x00, 0x0E, 0x58, 0xF0, 0xA0, 0x00, 0x00, 0x0C, 0x37, 
+	0x22, 0x0F, 0x26, 0x3F, 0x02, 0xA0, 0x8D, 0xF8, 0x08, 0x01, 0x70, 0x07, 0xC2, 0x00, 0x00, 0x25, 
+	0x96, 0xA0, 0xB1, 0x14, 0x40, 0x30, 0x9A, 0xA0, 0x2C, 0xBB, 0x0A, 0x3C, 0x1E, 0x18, 0x81, 0xFE, 
+	0x04, 0xF1, 0x03, 0xC0, 0x00, 0x03, 0x1C, 0x34, 0x00, 0x40, 0x02, 0x5B, 0x70, 0xD1, 0x91, 0xC0, 
+	0x00, 0x0C, 0x0F, 0xA2, 0xC6, 0xF2, 0x01, 0x42, 0x00, 0x9F, 0x00, 0x40, 0x2F, 0x18, 0x00, 0xF6, 
+	0x23, 0x00, 0x01, 0x00, 0x40, 0x40, 0x00, 0x00, 0x7D, 0x9E, 0x02, 0x30, 0x1A, 0x4E, 0xC0, 0x3E, 
+	0x03, 0xC8, 0xE7, 0x86, 0x86, 0x6C, 0x00, 0x00, 0x08, 0x21, 0xC0, 0xF0, 0x00, 0xC0, 0xFA, 0x00, 
+	0x00, 0xA7, 0x00, 0x30, 0x02, 0x03, 0xBC, 0x5C, 0x0C, 0x91, 0xA4, 0xE0, 0x10, 0x80, 0x00, 0x10, 
+	0x0E, 0x75, 0x40, 0x33, 0x02, 0x2A, 0x00, 0x07, 0xD1, 0x08, 0x02, 0x01, 0x00, 0x10, 0x01, 0x22, 
+	0x27, 0x20, 0x90, 0x00, 0x39, 0x03, 0xC4, 0x02, 0xA5, 0x03, 0x04, 0x79, 0x02, 0x00, 0x00, 0xFF, 
+	0xC8, 0x79, 0x81, 0x45, 0x0F, 0x06, 0xDF, 0x18, 0xFD, 0x08, 0x03, 0xC6, 0x01, 0x00, 0x40, 0x40, 
+	0x01, 0x40, 0x90, 0x0A, 0x00, 0x00, 0x4F, 0xF0, 0x38, 0x06, 0x60, 0x10, 0x00, 0x06, 0x86, 0x85, 
+	0x10, 0x19, 0x09, 0xA0, 0x08, 0x00, 0x01, 0xE7, 0x07, 0x02, 0x80, 0x17, 0xC7, 0xE7, 0x37, 0x0C, 
+	0xB8, 0x0F, 0x52, 0x84, 0x04, 0x50, 0x00, 0x02, 0x14, 0xDB, 0x80, 0x14, 0x3F, 0x29, 0x03, 0x53, 
+	0x00, 0xE0, 0x02, 0x70, 0x00, 0x66, 0x51, 0x7C, 0x10, 0xD8, 0x00, 0x14, 0x00, 0x0F, 0x00, 0xB8, 
+	0xE5, 0x08, 0x55, 0x02, 0x2D, 0xF9, 0x09, 0x81, 0x5D, 0x36, 0x05, 0x45, 0x08, 0x10, 0x06, 0x75, 
+	0x04, 0x63, 0x33, 0x2E, 0xC9, 0x98, 0x01, 0x48, 0xF4, 0x2D, 0x41, 0x00, 0xCC, 0xFE, 0x80, 0x4A, 
+	0x36, 0x02, 0x01, 0x00, 0x04, 0x85, 0x20, 0x20, 0x33, 0x7C, 0x46, 0x16, 0x40, 0x13, 0xD8, 0x10, 
+	0xA0, 0x40, 0x22, 0x80, 0x2C, 0x00, 0x03, 0x04, 0x00, 0x00, 0x0F, 0xBF, 0x20, 0x05, 0x0A, 0x7E, 
+	0x00, 0x10, 0x16, 0xC0, 0x02, 0xF2, 0x07, 0x85, 0x00, 0x80, 0x00, 0x15, 0x9E, 0x00, 0x94, 0x02, 
+	0x08, 0x78, 0x0E, 0x04, 0x00, 0x50, 0x02, 0x0F, 0xEF, 0x39, 0xC4, 0x09, 0x48, 0x55, 0x04, 0x06, 
+	0x51, 0x07, 0x11, 0x57, 0xB6, 0x07, 0x50, 0x40, 0x08, 0xF1, 0x00, 0x10, 0x6E, 0x00, 0x01, 0x4C, 
+	0x01, 0x36, 0x46, 0x90, 0x80, 0xA6, 0x00, 0x01, 0x11, 0x05, 0x00, 0x0F, 0x09, 0xE1, 0x05, 0xC0, 
+	0x51, 0x02, 0x01, 0xA1, 0x7F, 0xC5, 0x00, 0x40, 0x00, 0x12, 0x08, 0x18, 0xCA, 0x13, 0x57, 0xA8, 
+	0xCC, 0x38, 0x00, 0x80, 0xA6, 0x00, 0xF3, 0x01, 0x40, 0x0A, 0x01, 0x00, 0xC1, 0x00, 0x03, 0x00, 
+	0x3E, 0x02, 0x30, 0x01, 0x1D, 0xFE, 0x50, 0x88, 0xE4, 0x16, 0x41, 0x14, 0x00, 0x2A, 0x82, 0xB5, 
+	0x16, 0x00, 0x85, 0x0C, 0x0A, 0x24, 0x01, 0x00, 0x78, 0x10, 0x20, 0x21, 0xC0, 0x9F, 0x01, 0x00, 
+	0x3F, 0x05, 0x10, 0x02, 0x7B, 0x34, 0x26, 0x10, 0x84, 0xA0, 0x09, 0x04, 0xF9, 0x00, 0x30, 0x03, 
+	0xC0, 0x70, 0x00, 0x37, 0x20, 0x4A, 0x70, 0xE2, 0x05, 0x00, 0x30, 0x05, 0x61, 0x44, 0x00, 0x30, 
+	0xFD, 0xA0, 0x0E, 0x6E, 0x26, 0x0A, 0x01, 0x00, 0x91, 0x01, 0xE0, 0x42, 0x00, 0x00, 0x02, 0x86, 
+	0x83, 0x81, 0x13, 0x15, 0x03, 0xBE, 0x01, 0x10, 0x10, 0xA4, 0x00, 0x09, 0xC3, 0x0B, 0x41, 0x01, 
+	0x00, 0x03, 0xC2, 0x32, 0x0A, 0x30, 0x09, 0x08, 0x90, 0x4C, 0x01, 0x13, 0x30, 0x0C, 0x03, 0x00, 
+	0x9F, 0x34, 0x03, 0x34, 0x00, 0x04, 0x51, 0x00, 0xA2, 0x00, 0x6A, 0x07, 0x0C, 0x00, 0x00, 0x12, 
+	0xC6, 0x91, 0x9D, 0x38, 0x01, 0x77, 0x66, 0x80, 0x00, 0x0A, 0xA9, 0x7A, 0x58, 0x6F, 0x02, 0x05, 
+	0x53, 0x00, 0x90, 0x5C, 0x61, 0x00, 0x00, 0x03, 0x4A, 0xEB, 0x01, 0x80, 0x53, 0x00, 0x50, 0x3C, 
+	0x03, 0x90, 0x04, 0x00, 0x03, 0x34, 0x1E, 0xA0, 0x5E, 0x21, 0x11, 0x07, 0xD3, 0x02, 0x92, 0x1C, 
+	0x90, 0x19, 0x00, 0x02, 0x02, 0x40, 0x80, 0x20, 0x81, 0x03, 0x17, 0x91, 0x47, 0x19, 0x00, 0x53, 
+	0x00, 0x00, 0x66, 0x34, 0x20, 0x03, 0xDE, 0x0E, 0x00, 0x40, 0x04, 0xDA, 0x01, 0x80, 0xC2, 0x2A, 
+	0x12, 0x02, 0xEA, 0x0E, 0x10, 0x0B, 0x88, 0x07, 0x05, 0xF1, 0x00, 0x03, 0xCD, 0x06, 0x10, 0x05, 
+	0x42, 0x19, 0x60, 0x01, 0x54, 0x09, 0x0A, 0x00, 0x08, 0x4C, 0x01, 0x11, 0x64, 0x0B, 0x07, 0x11, 
+	0x50, 0x93, 0x37, 0x03, 0x53, 0x00, 0x00, 0xB2, 0x0E, 0x11, 0x08, 0xA6, 0x0F, 0x60, 0x00, 0x20, 
+	0x00, 0x28, 0x2B, 0x11, 0x4C, 0x01, 0x30, 0x03, 0x00, 0x06, 0x7C, 0x33, 0x00, 0xF6, 0x13, 0x05, 
+	0x45, 0x02, 0x50, 0x02, 0x04, 0x16, 0x81, 0xC0, 0x9A, 0x32, 0x33, 0x04, 0x07, 0x80, 0x1A, 0x25, 
+	0xC8, 0x08, 0x00, 0x8F, 0x5B, 0x06, 0x04, 0x00, 0x20, 0x09, 0x02, 0x00, 0xB8, 0xF2, 0x01, 0x10, 
+	0x01, 0xA9, 0x18, 0x71, 0xC1, 0x00, 0xF3, 0x5C, 0x64, 0x00, 0x41, 0xC8, 0x07, 0x60, 0x01, 0x20, 
+	0x02, 0xFB, 0x3E, 0x43, 0x77, 0x26, 0x4C, 0x0C, 0x0F, 0x00, 0x21, 0x98, 0x02, 0xA2, 0x00, 0x18, 
+	0x7C, 0x07, 0x80, 0x04, 0x00, 0xF3, 0x14, 0xE0, 0x60, 0x01, 0x93, 0x2E, 0x00, 0x00, 0x40, 0x09, 
+	0x68, 0x00, 0x01, 0xD0, 0x72, 0x35, 0x07, 0x01, 0x00, 0x70, 0x12, 0x80, 0x40, 0x40, 0x10, 0x00, 
+	0xCC, 0x8A, 0x17, 0x00, 0x82, 0x00, 0x70, 0x63, 0x80, 0x04, 0x00, 0x29, 0x40, 0xA7, 0x62, 0x26, 
+	0x09, 0x53, 0x00, 0x01, 0x35, 0x02, 0x80, 0x10, 0x02, 0x00, 0xB3, 0x04, 0xA9, 0x9E, 0x14, 0x45, 
+	0x02, 0x61, 0x2E, 0x00, 0x00, 0x20, 0x09, 0x9A, 0xCE, 0x00, 0x0C, 0x45, 0x02, 0x81, 0x02, 0x3C, 
+	0x02, 0x00, 0x60, 0x00, 0xCC, 0x10, 0xF9, 0x00, 0xA3, 0x09, 0x02, 0x40, 0x00, 0x06, 0x00, 0x26, 
+	0x44, 0xF0, 0x0C, 0x54, 0x06, 0x05, 0x15, 0x03, 0x13, 0x1D, 0x86, 0x1F, 0x21, 0xBC, 0x14, 0x93, 
+	0x29, 0x70, 0xA1, 0xD8, 0x00, 0x2A, 0x80, 0x00, 0x09, 0x1D, 0x00, 0x00, 0xBC, 0x2E, 0x08, 0x53, 
+	0x00, 0xA0, 0x09, 0x00, 0x02, 0x00, 0x7C, 0x00, 0x40, 0x03, 0xC0, 0x20, 0xF0, 0x01, 0x40, 0x05, 
+	0x29, 0x2F, 0x47, 0xDD, 0x17, 0x00, 0xF8, 0x1B, 0x0E, 0x6A, 0x1A, 0x31, 0x04, 0x00, 0x28, 0x55, 
+	0x20, 0x00, 0x28, 0x06, 0x30, 0x64, 0x1E, 0xE0, 0xDD, 0x04, 0x0A, 0x2E, 0x0E, 0x05, 0xA6, 0x00, 
+	0x11, 0x80, 0xAB, 0x17, 0xD0, 0x00, 0x00, 0x0A, 0x01, 0x00, 0x06, 0x2D, 0xE9, 0x42, 0x40, 0x04, 
+	0x00, 0x04, 0xA0, 0x15, 0x0A, 0xEB, 0x02, 0x02, 0x4F, 0x36, 0x05, 0x61, 0x2D, 0x34, 0x00, 0x05, 
+	0x3B, 0x08, 0x39, 0x16, 0x10, 0x2E, 0x05, 0x04, 0x53, 0x00, 0x37, 0x07, 0xBC, 0x34, 0xC8, 0x24, 
+	0x10, 0x24, 0x5F, 0x31, 0x00, 0x46, 0x02, 0x0C, 0xAB, 0x0A, 0x10, 0x81, 0x40, 0x38, 0x02, 0x0B, 
+	0x01, 0x00, 0x81, 0x07, 0x33, 0x01, 0x30, 0x16, 0x52, 0x00, 0x0C, 0xA6, 0x00, 0x00, 0xBD, 0x32, 
+	0x10, 0x82, 0xCA, 0x2A, 0x01, 0xE6, 0x31, 0x40, 0x00, 0x00, 0x2B, 0x3C, 0x91, 0x03, 0x00, 0x01, 
+	0x00, 0x1B, 0x34, 0x53, 0x00, 0x20, 0x0C, 0x00, 0x53, 0x00, 0x30, 0x03, 0x80, 0x2C, 0x1F, 0x00, 
+	0x11, 0x08, 0x10, 0x2A, 0x54, 0x10, 0x20, 0x0A, 0xA9, 0xC0, 0x24, 0x32, 0x08, 0xA6, 0x00, 0x81, 
+	0x02, 0xC0, 0x00, 0x10, 0x60, 0x01, 0xCA, 0xEE, 0x3D, 0x2F, 0x01, 0x40, 0x11, 0x4F, 0x00, 0x15, 
+	0x42, 0x90, 0x51, 0x0B, 0x00, 0xA0, 0x08, 0x03, 0xC0, 0x00, 0x80, 0x80, 0x82, 0x0C, 0x00, 0x08, 
+	0xB5, 0x3B, 0x10, 0x07, 0xCE, 0x00, 0x11, 0x08, 0xEB, 0x02, 0x0D, 0xC8, 0x07, 0x12, 0x33, 0x94, 
+	0x2B, 0x01, 0xF7, 0x00, 0x30, 0x02, 0x00, 0x41, 0x22, 0x39, 0x10, 0x04, 0x04, 0x0E, 0x0E, 0xCF, 
+	0x06, 0x60, 0x78, 0x00, 0x00, 0x85, 0x02, 0x80, 0x43, 0x11, 0x03, 0x2F, 0x31, 0x00, 0xC2, 0x01, 
+	0x3D, 0x50, 0x04, 0x01, 0x31, 0x0B, 0x14, 0x76, 0x28, 0x18, 0x02, 0x46, 0x00, 0x03, 0xD6, 0x1D, 
+	0x12, 0x0A, 0x24, 0x18, 0x09, 0x01, 0x00, 0x02, 0xD9, 0x15, 0x00, 0x01, 0x00, 0x70, 0x0C, 0x00, 
+	0x0C, 0x38, 0x00, 0x70, 0x70, 0xF2, 0x01, 0x05, 0xE9, 0x2E, 0x07, 0x01, 0x00, 0x31, 0x02, 0x80, 
+	0x01, 0xB9, 0x00, 0x10, 0x90, 0x61, 0x09, 0x40, 0xC1, 0x83, 0x44, 0x08, 0x3C, 0x00, 0x01, 0x56, 
+	0x09, 0x0C, 0x4F, 0x10, 0x10, 0x03, 0xAC, 0x10, 0x06, 0x00, 0x03, 0x03, 0x1F, 0x00, 0x03, 0x6C, 
+	0x30, 0x09, 0x29, 0x00, 0x11, 0xEC, 0x93, 0x17, 0x03, 0x4B, 0x0B, 0x29, 0x01, 0x40, 0xC8, 0x0E, 
+	0x0A, 0x7D, 0x00, 0x00, 0x05, 0x00, 0x31, 0x80, 0x00, 0x10, 0x28, 0x0E, 0x05, 0x34, 0x22, 0x00, 
+	0x6E, 0x20, 0x0B, 0x4C, 0x01, 0x20, 0x03, 0xFC, 0xCF, 0x17, 0x11, 0x40, 0xF7, 0x04, 0x2F, 0x0A, 
+	0x50, 0xD1, 0x21, 0x01, 0x04, 0x01, 0x00, 0x10, 0x76, 0xDE, 0x04, 0x41, 0x80, 0x00, 0x10, 0x1A, 
+	0xB3, 0x0A, 0x00, 0xA6, 0x0D, 0x01, 0x46, 0x01, 0x0E, 0x7C, 0x0C, 0x20, 0x06, 0xFC, 0xCB, 0x37, 
+	0x10, 0x40, 0x13, 0x10, 0x03, 0xE5, 0x01, 0x4F, 0x04, 0x04, 0x00, 0xB0, 0x45, 0x11, 0x01, 0x13, 
+	0x07, 0x1B, 0x05, 0x00, 0x53, 0x00, 0x00, 0x30, 0x01, 0x56, 0x10, 0x00, 0x08, 0x20, 0x60, 0xE5, 
+	0x30, 0x06, 0x01, 0x00, 0x31, 0x02, 0xDC, 0x3C, 0x73, 0x21, 0x02, 0x49, 0x17, 0x02, 0x11, 0x02, 
+	0x00, 0xAE, 0x35, 0x0E, 0x53, 0x00, 0x40, 0x05, 0xC3, 0x80, 0x03, 0x73, 0x01, 0x00, 0x30, 0x05, 
+	0x02, 0x40, 0x28, 0x02, 0x59, 0x22, 0x0D, 0x01, 0x00, 0x55, 0x03, 0x00, 0x40, 0x10, 0x30, 0x28, 
+	0x2F, 0x02, 0x4A, 0x00, 0x10, 0x24, 0x39, 0x10, 0x06, 0x46, 0x02, 0x50, 0x80, 0x00, 0x18, 0x01, 
+	0x80, 0xF3, 0x38, 0x20, 0x00, 0x10, 0x6E, 0x08, 0x0A, 0x40, 0x00, 0x17, 0x0A, 0x98, 0x02, 0x30, 
+	0x20, 0x40, 0x0B, 0x61, 0x30, 0x31, 0x33, 0x40, 0x34, 0xF5, 0x1D, 0x13, 0x70, 0x01, 0x21, 0x03, 
+	0x9F, 0x01, 0x04, 0x3A, 0x2E, 0x02, 0x53, 0x00, 0x61, 0x88, 0x00, 0x00, 0x14, 0x08, 0x2C, 0x7B, 
+	0x14, 0x00, 0xB7, 0x05, 0x03, 0x22, 0x01, 0x02, 0x5A, 0x04, 0x07, 0x98, 0x02, 0x30, 0x20, 0x80, 
+	0x10, 0x29, 0x06, 0xA1, 0xF2, 0xAC, 0x35, 0x40, 0x10, 0x00, 0x40, 0x0B, 0x70, 0xE0, 0x30, 0x05, 
+	0x05, 0xDA, 0x08, 0x15, 0x04, 0xFF, 0x19, 0x00, 0x45, 0x04, 0x00, 0x3D, 0x2D, 0x90, 0x00, 0x07, 
+	0x80, 0x43, 0x00, 0x80, 0x01, 0xAD, 0x9F, 0xF9, 0x00, 0x11, 0x50, 0xEA, 0x0E, 0x10, 0xF2, 0x1F, 
+	0x00, 0x15, 0xC0, 0x47, 0x02, 0x02, 0xBF, 0x1B, 0x10, 0xC0, 0x60, 0x0A, 0x60, 0x30, 0x00, 0x80, 
+	0x10, 0xF1, 0xE0, 0x82, 0x09, 0x01, 0x6E, 0x24, 0x63, 0x0F, 0x14, 0x00, 0x00, 0x01, 0x0C, 0xA2, 
+	0x01, 0x01, 0x58, 0x01, 0x10, 0xE1, 0x69, 0x00, 0x01, 0x89, 0x01, 0x21, 0x80, 0x01, 0xF0, 0x07, 
+	0x01, 0xA5, 0x0C, 0x01, 0x01, 0x00, 0x15, 0x81, 0x35, 0x01, 0x01, 0x3A, 0x0C, 0x00, 0x01, 0x00, 
+	0x11, 0x03, 0xB6, 0x0B, 0x39, 0x80, 0x00, 0xF0, 0xFA, 0x21, 0x0F, 0x17, 0x29, 0x03, 0x28, 0x60, 
+	0x50, 0x2A, 0x30, 0x04, 0x15, 0x02, 0x0A, 0x98, 0x02, 0x00, 0x3A, 0x20, 0x36, 0x3C, 0x35, 0x02, 
+	0x21, 0x30, 0x05, 0xB0, 0x0F, 0x13, 0x01, 0x7C, 0x23, 0x00, 0x01, 0x00, 0x21, 0x82, 0x14, 0xAD, 
+	0x03, 0x3A, 0x64, 0x07, 0x84, 0x7D, 0x30, 0x04, 0x01, 0x00, 0x05, 0xF5, 0x01, 0x11, 0x20, 0x21, 
+	0x2C, 0x30, 0x00, 0x07, 0x84, 0x44, 0x00, 0x04, 0xE6, 0x32, 0x08, 0x6D, 0x00, 0x02, 0x01, 0x00, 
+	0x01, 0x49, 0x1B, 0x21, 0xE3, 0x99, 0x10, 0x3A, 0x10, 0x05, 0xF9, 0x00, 0x05, 0xD5, 0x03, 0x01, 
+	0xCA, 0x00, 0x38, 0x78, 0x00, 0x14, 0x9F, 0x01, 0x70, 0x00, 0x00, 0xB4, 0x00, 0x00, 0x02, 0x1E, 
+	0xE7, 0x35, 0x0D, 0x87, 0x02, 0x03, 0x17, 0x01, 0x01, 0x01, 0x00, 0x02, 0xD0, 0x10, 0x50, 0x00, 
+	0x02, 0x00, 0x48, 0x02, 0x7C, 0x34, 0x0C, 0x2B, 0x00, 0x06, 0x11, 0x00, 0x00, 0xA6, 0x00, 0x00, 
+	0x4C, 0x01, 0x20, 0xDC, 0x2C, 0x21, 0x1D, 0x0F, 0x54, 0x2A, 0x0C, 0x00, 0xBA, 0x09, 0x71, 0x04, 
+	0x00, 0x10, 0x80, 0x00, 0x82, 0x14, 0x89, 0x3C, 0x20, 0x40, 0x00, 0xD6, 0x05, 0x13, 0x04, 0x9A, 
+	0x04, 0x07, 0x4C, 0x01, 0x90, 0x01, 0x01, 0xC0, 0x00, 0xF3, 0x40, 0x02, 0xF0, 0x0A, 0x16, 0x00, 
+	0x00, 0x21, 0x3A, 0x6F, 0x05, 0x03, 0x42, 0xC0, 0x00, 0x10, 0x7D, 0x2A, 0x02, 0x80, 0x14, 0x08, 
+	0x60, 0x00, 0x40, 0x85, 0x04, 0x82, 0x4B, 0x00, 0xDD, 0x15, 0x02, 0x5A, 0x03, 0x86, 0x68, 0x00, 
+	0x50, 0x55, 0x40, 0x0E, 0x01, 0xBC, 0x34, 0x01, 0x40, 0x04, 0x53, 0x80, 0x34, 0x53, 0x01, 0x61, 
+	0x20, 0x50, 0xA0, 0xC0, 0x00, 0x15, 0x28, 0x01, 0x30, 0xE6, 0x28, 0x0D, 0x18, 0x12, 0x10, 0x20, 
+	0xFC, 0x03, 0x03, 0x01, 0x00, 0x80, 0x07, 0x80, 0x01, 0x4C, 0x00, 0x05, 0xE0, 0x01, 0x94, 0x1C, 
+	0x11, 0x07, 0x91, 0x03, 0xC9, 0x70, 0x34, 0x70, 0x00, 0x30, 0x0B, 0x30, 0x4E, 0x01, 0x80, 0x08, 
+	0xC2, 0x51, 0x00, 0x21, 0xE0, 0x08, 0x5C, 0x17, 0xF0, 0x03, 0x32, 0x00, 0x40, 0x08, 0x50, 0x01, 
+	0xC0, 0xC1, 0x00, 0x00, 0x81, 0x64, 0x00, 0x02, 0x00, 0x4C, 0xD5, 0x00, 0x67, 0x31, 0x07, 0x01, 
+	0x00, 0x03, 0x30, 0x15, 0x00, 0x1C, 0x0D, 0xF7, 0x00, 0x00, 0x05, 0x0A, 0x2C, 0x00, 0x00, 0xA5, 
+	0x06, 0xC0, 0x2C, 0x02, 0x08, 0x0B, 0x31, 0xD8, 0x2F, 0x05, 0x05, 0x43, 0x0E, 0x30, 0x03, 0x40, 
+	0x3E, 0xEB, 0x08, 0x02, 0xC3, 0x1F, 0x20, 0x69, 0x24, 0x08, 0x05, 0x10, 0x4C, 0xA2, 0x19, 0x07, 
+	0x01, 0x00, 0x20, 0x29, 0x40, 0xF2, 0x3D, 0x61, 0x00, 0x03, 0xE7, 0x00, 0x00, 0x20, 0xAA, 0x0D, 
+	0x40, 0x40, 0x00, 0x35, 0x57, 0xBA, 0x09, 0x61, 0x19, 0x68, 0x01, 0x01, 0x85, 0x88, 0xDB, 0x3D, 
+	0x01, 0x01, 0x00, 0x30, 0x10, 0x00, 0x0B, 0xDE, 0x02, 0x21, 0x03, 0xAC, 0x5F, 0x00, 0x01, 0xEF, 
+	0x0C, 0x30, 0x43, 0xFF, 0xA2, 0x75, 0x00, 0x52, 0x29, 0x40, 0x81, 0x08, 0xA1, 0x72, 0x22, 0x08, 
+	0x01, 0x00, 0x62, 0x34, 0xE0, 0x40, 0x00, 0x81, 0x80, 0xAC, 0x1C, 0x40, 0x81, 0x87, 0x40, 0x28, 
+	0x17, 0x19, 0x1A, 0x6E, 0x23, 0x00, 0x01, 0x01, 0x00, 0x30, 0x08, 0x07, 0x5E, 0x64, 0x00, 0x00, 
+	0x5E, 0x36, 0x50, 0x80, 0x10, 0x0C, 0x37, 0x20, 0x7C, 0x06, 0x2A, 0x04, 0x3D, 0x24, 0x00, 0x21, 
+	0xAF, 0x60, 0x5D, 0x00, 0x30, 0x05, 0xE7, 0x90, 0xBC, 0x22, 0x03, 0x1C, 0x02, 0x21, 0x06, 0x29, 
+	0xEF, 0x01, 0x12, 0x98, 0x6D, 0x3C, 0x02, 0x01, 0x00, 0x30, 0x40, 0x61, 0xCB, 0x98, 0x01, 0x20, 
+	0x03, 0xC2, 0x2C, 0x0E, 0x00, 0xF9, 0x00, 0x01, 0x2C, 0x00, 0x20, 0x44, 0x27, 0x07, 0x00, 0x00, 
+	0x14, 0x31, 0x09, 0x56, 0x00, 0x01, 0xFC, 0x30, 0x41, 0xC7, 0x80, 0x03, 0x80, 0xF2, 0x01, 0xAD, 
+	0x00, 0x00, 0xAF, 0x12, 0xC0, 0x3C, 0x00, 0x30, 0x01, 0x68, 0x8F, 0x09, 0x00, 0xA6, 0x03, 0x51, 
+	0x03, 0x00, 0x40, 0x00, 0x32, 0x0D, 0x00, 0x91, 0x80, 0x00, 0x00, 0x50, 0xE8, 0x07, 0x80, 0x03, 
+	0x44, 0xF8, 0x20, 0x5F, 0x0C, 0x00, 0x00, 0x11, 0x03, 0x5E, 0x17, 0x01, 0x0F, 0x01, 0x00, 0x42, 
+	0x08, 0x6A, 0x17, 0x02, 0xE5, 0x06, 0x06, 0xED, 0x0D, 0x0F, 0x01, 0x00, 0x0D, 0x0F, 0x70, 0x2D, 
+	0x02, 0x03, 0x12, 0x16, 0x0F, 0x01, 0x00, 0x2C, 0x0F, 0x06, 0x16, 0x00, 0x02, 0xBF, 0x0E, 0x0F, 
+	0x21, 0x2F, 0x0A, 0x0F, 0xE7, 0x2F, 0x0A, 0x03, 0x1D, 0x00, 0x08, 0x0F, 0x11, 0x09, 0x14, 0x04, 
+	0x0F, 0x5E, 0x17, 0x16, 0x0C, 0x01, 0x00, 0x01, 0x52, 0x00, 0x06, 0x65, 0x20, 0x06, 0x01, 0x00, 
+	0x0F, 0x14, 0x00, 0x01, 0x01, 0x21, 0x1E, 0x0D, 0xDD, 0x01, 0x0F, 0x73, 0x01, 0x10, 0x04, 0xAC, 
+	0x15, 0x00, 0x50, 0x13, 0x08, 0x01, 0x00, 0x21, 0x03, 0xC0, 0x10, 0x00, 0x06, 0x6A, 0x17, 0x00, 
+	0x01, 0x00, 0x09, 0xD6, 0x01, 0x0F, 0x01, 0x00, 0x0E, 0x0E, 0x27, 0x00, 0x01, 0xDA, 0x01, 0x08, 
+	0xA6, 0x00, 0x02, 0x23, 0x00, 0x04, 0x25, 0x17, 0x0F, 0x01, 0x00, 0x05, 0x24, 0x02, 0x10, 0x3D, 
+	0x02, 0x0F, 0x43, 0x26, 0x00, 0x09, 0x01, 0x00, 0x01, 0xA1, 0x00, 0x00, 0xB4, 0x00, 0x01, 0x1B, 
+	0x18, 0x0F, 0x01, 0x00, 0x08, 0xBF, 0x06, 0x00, 0x30, 0x04, 0x20, 0x00, 0x04, 0x08, 0x28, 0x2C, 
+	0x58, 0xF3, 0x2C, 0x0C, 0x12, 0x24, 0x48, 0x00, 0x35, 0x81, 0x4C, 0x1D, 0x6A, 0x13, 0x0F, 0x01, 
+	0x00, 0x00, 0x03, 0xF3, 0x01, 0x00, 0xE7, 0x3D, 0x25, 0x0A, 0xCF, 0xFF, 0x28, 0x0F, 0x01, 0x00, 
+	0x00, 0x06, 0xAD, 0x06, 0x4F, 0x80, 0xA0, 0x40, 0x15, 0x53, 0x00, 0x09, 0x01, 0xF9, 0x00, 0x10, 
+	0x03, 0x53, 0x00, 0x2F, 0x48, 0x14, 0xBF, 0x31, 0x0E, 0x03, 0x21, 0x00, 0x4F, 0x81, 0x4C, 0xC1, 
+	0x1A, 0x2B, 0x00, 0x0D, 0x01, 0x01, 0x00, 0x3F, 0x09, 0xFA, 0xCF, 0x28, 0x00, 0x12, 0x3F, 0x00, 
+	0x04, 0xAF, 0x60, 0x1A, 0x0D, 0x10, 0x0C, 0x70, 0x01, 0x50, 0x34, 0x00, 0x24, 0x08, 0x14, 0xB2, 
+	0x02, 0x0E, 0x0D, 0x0B, 0x03, 0x01, 0x00, 0x10, 0x38, 0xE5, 0x26, 0x20, 0x87, 0x00, 0x92, 0x1C, 
+	0x3F, 0x81, 0x4E, 0xC0, 0xC6, 0x02, 0x03, 0x02, 0x01, 0x00, 0x10, 0x0B, 0xC3, 0x01, 0x00, 0x29, 
+	0x08, 0x3B, 0x04, 0x09, 0x0A, 0x06, 0x06, 0x0C, 0x01, 0x00, 0x91, 0x01, 0x40, 0x24, 0x08, 0x00, 
+	0xE0, 0x00, 0x05, 0x00, 0xB5, 0x34, 0x03, 0x1E, 0x2D, 0x0C, 0x01, 0x00, 0x11, 0x3C, 0x3E, 0x02, 
+	0x33, 0x02, 0x20, 0x04, 0xA3, 0x0D, 0x0F, 0x48, 0x1C, 0x06, 0x30, 0x4B, 0xD4, 0x5D, 0x61, 0x02, 
+	0x27, 0x20, 0x00, 0xC1, 0x13, 0x0B, 0x2C, 0x00, 0x00, 0x0D, 0x02, 0x10, 0x10, 0x67, 0x19, 0x01, 
+	0x42, 0x09, 0x22, 0x41, 0x7B, 0xD4, 0x07, 0x01, 0xD3, 0x29, 0x0B, 0xE1, 0x04, 0x01, 0x6D, 0x28, 
+	0x00, 0xF2, 0x05, 0x00, 0xCC, 0x3C, 0x40, 0x00, 0x07, 0xF1, 0x62, 0x64, 0x08, 0x01, 0xC0, 0x05, 
+	0x03, 0x28, 0x00, 0x67, 0x08, 0x00, 0x04, 0x2B, 0xC3, 0xBF, 0x32, 0x00, 0x01, 0x89, 0x16, 0x42, 
+	0x81, 0x93, 0x44, 0x28, 0x21, 0x00, 0x17, 0xAA, 0x1B, 0x00, 0x38, 0x09, 0x69, 0xC9, 0x5C, 0x00, 
+	0x10, 0xB0, 0x70, 0x25, 0x10, 0x20, 0xA3, 0x09, 0x01, 0x01, 0x00, 0x1A, 0x4C, 0x4D, 0x01, 0x04, 
+	0xF9, 0x02, 0x22, 0x04, 0x80, 0xF1, 0x00, 0x35, 0x10, 0x03, 0xC0, 0x81, 0x0C, 0x0F, 0xCC, 0x32, 
+	0x03, 0x03, 0x30, 0x15, 0x1F, 0x20, 0x65, 0x1B, 0x01, 0x00, 0x01, 0x00, 0x01, 0x13, 0x20, 0x01, 
+	0x0C, 0x01, 0x30, 0x84, 0x00, 0xF1, 0x9A, 0x01, 0x10, 0x10, 0xE8, 0x39, 0x00, 0x9F, 0x39, 0x0C, 
+	0xFE, 0x0C, 0x05, 0x5C, 0x13, 0x50, 0x08, 0x00, 0x00, 0xD9, 0xA0, 0x53, 0x00, 0x53, 0x06, 0x06, 
+	0x87, 0x00, 0x00, 0x5C, 0x15, 0x0F, 0x01, 0x00, 0x02, 0x24, 0x29, 0x15, 0xA2, 0x34, 0x00, 0x6B, 
+	0x01, 0x03, 0x50, 0x00, 0x07, 0x4F, 0x05, 0x03, 0x4A, 0x25, 0x52, 0x00, 0x00, 0x02, 0x93, 0x6A, 
+	0x40, 0x0A, 0x10, 0x68, 0xAB, 0x09, 0x4D, 0x10, 0x00, 0x05, 0x0A, 0x46, 0x02, 0x03, 0xFB, 0x00, 
+	0x01, 0x86, 0x00, 0x62, 0x08, 0x00, 0x58, 0x32, 0x1C, 0x20, 0x4A, 0x00, 0x3B, 0xA8, 0x08, 0xC4, 
+	0x99, 0x02, 0x02, 0x0F, 0x00, 0x20, 0x48, 0x20, 0x44, 0x01, 0x42, 0x80, 0x0A, 0x5B, 0x70, 0xA9, 
+	0x05, 0x42, 0x07, 0x80, 0x01, 0x08, 0x45, 0x25, 0x04, 0x01, 0x00, 0x03, 0x0D, 0x00, 0x10, 0x01, 
+	0x40, 0x07, 0x00, 0x01, 0x00, 0x07, 0x9A, 0x17, 0x02, 0xB1, 0x01, 0x05, 0x9E, 0x00, 0x03, 0x7D, 
+	0x09, 0x00, 0x4C, 0x01, 0x21, 0xE0, 0x01, 0xD6, 0x11, 0x04, 0x6C, 0x26, 0x19, 0x14, 0x42, 0x1B, 
+	0x02, 0x23, 0x01, 0x62, 0x08, 0x80, 0x00, 0x09, 0x1C, 0xD5, 0x12, 0x00, 0x15, 0x04, 0x3D, 0x1D, 
+	0x09, 0x9F, 0x01, 0x02, 0xF9, 0x00, 0x00, 0x2F, 0x05, 0x00, 0x3C, 0x02, 0x40, 0x00, 0x00, 0x20, 
+	0x85, 0x53, 0x0D, 0x10, 0x80, 0x4F, 0x0B, 0x0F, 0x01, 0x00, 0x05, 0x12, 0x08, 0xC5, 0x0C, 0x20, 
+	0x0C, 0x77, 0xD4, 0x0C, 0x34, 0x01, 0xF1, 0x6B, 0x58, 0x13, 0x01, 0x3F, 0x00, 0x09, 0x7F, 0x00, 
+	0x02, 0x71, 0x3E, 0x30, 0x64, 0xE7, 0x70, 0xE2, 0x00, 0x10, 0xAF, 0xE7, 0x3C, 0x09, 0xB0, 0x05, 
+	0x04, 0xF2, 0x01, 0x41, 0x00, 0x00, 0x0C, 0x34, 0x53, 0x00, 0x30, 0x56, 0x32, 0x80, 0x81, 0x3E, 
+	0x0F, 0x45, 0x35, 0x06, 0x41, 0x50, 0x00, 0x00, 0xC3, 0xFD, 0x08, 0x41, 0x2A, 0x6F, 0x34, 0x06, 
+	0x9B, 0x23, 0x01, 0x3D, 0x00, 0x05, 0x20, 0x00, 0x34, 0x2E, 0x0D, 0xB0, 0x17, 0x05, 0x31, 0x01, 
+	0x20, 0x75, 0x08, 0x00, 0x80, 0x8D, 0x73, 0x14, 0x28, 0x00, 0x00, 0x03, 0x6B, 0x4B, 0x03, 0x05, 
+	0xA6, 0x00, 0x52, 0x08, 0x01, 0xEB, 0x5B, 0x01, 0x6F, 0x0E, 0x40, 0x40, 0x00, 0x02, 0x06, 0x1B, 
+	0x06, 0x40, 0x08, 0x24, 0xE1, 0x83, 0xA7, 0x06, 0x21, 0xB6, 0xA5, 0xA2, 0x00, 0x00, 0x4C, 0x01, 
+	0x83, 0x01, 0xC4, 0x00, 0x00, 0x02, 0x2E, 0x16, 0xBB, 0x35, 0x00, 0x03, 0x58, 0x10, 0x62, 0x00, 
+	0x00, 0xA5, 0x02, 0xC0, 0x28, 0xCB, 0x3C, 0x05, 0x5A, 0x28, 0x65, 0x38, 0x60, 0x00, 0x01, 0xE8, 
+	0x4A, 0xDC, 0x00, 0x03, 0x16, 0x29, 0x53, 0x20, 0xA7, 0xBC, 0x02, 0xD0, 0x5A, 0x19, 0x09, 0xBD, 
+	0x1E, 0x06, 0x9E, 0x06, 0x93, 0x1D, 0x25, 0xA5, 0x9B, 0x00, 0x00, 0x10, 0x67, 0x7B, 0xDD, 0x0C, 
+	0x10, 0x50, 0x06, 0x02, 0x0F, 0x98, 0x02, 0x01, 0xA6, 0x01, 0xE8, 0x6A, 0x51, 0xE0, 0x00, 0x00, 
+	0x2A, 0x73, 0xA1, 0x97, 0x31, 0x02, 0xF9, 0x00, 0x10, 0x20, 0x25, 0x26, 0x33, 0x00, 0x00, 0x1F, 
+	0x9F, 0x2B, 0xA3, 0x00, 0x01, 0x27, 0xAB, 0x0D, 0x00, 0x08, 0x04, 0xE3, 0xD4, 0x94, 0x0E, 0x32, 
+	0xD8, 0xA0, 0x14, 0x8E, 0x23, 0x30, 0x16, 0x00, 0x02, 0x5A, 0x00, 0x10, 0x11, 0x6F, 0x17, 0x20, 
+	0x00, 0x01, 0x8D, 0x02, 0x91, 0x59, 0xF0, 0x90, 0x00, 0x81, 0x2E, 0x3F, 0x70, 0x02, 0xD3, 0x3F, 
+	0x41, 0x0F, 0x00, 0x80, 0x88, 0x3F, 0x18, 0x01, 0xA2, 0x00, 0x27, 0xA0, 0x7D, 0x3F, 0x20, 0x83, 
+	0x3C, 0x0B, 0x8A, 0x00, 0x00, 0x08, 0x5F, 0x33, 0xED, 0x03, 0x10, 0x90, 0x71, 0x12, 0x00, 0x09, 
+	0x00, 0x51, 0x1E, 0x00, 0x00, 0x40, 0x2A, 0xBF, 0x3E, 0x03, 0x98, 0x02, 0x00, 0x3C, 0x14, 0x52, 
+	0x01, 0x40, 0x68, 0xB5, 0x70, 0x98, 0x02, 0x10, 0x08, 0xCB, 0x01, 0x41, 0x02, 0x00, 0x20, 0xA0, 
+	0xA5, 0x11, 0x40, 0x80, 0xC6, 0x0B, 0x00, 0x9A, 0x1D, 0x02, 0xB2, 0x0F, 0xF0, 0x00, 0x07, 0x0C, 
+	0x20, 0x00, 0x04, 0x47, 0x33, 0x3C, 0x2E, 0x00, 0x00, 0x03, 0xD4, 0xF9, 0xF0, 0xED, 0x24, 0x31, 
+	0x01, 0x02, 0x00, 0xCF, 0x1A, 0x42, 0x48, 0x0F, 0xC0, 0xF0, 0xAD, 0x01, 0x10, 0x10, 0x20, 0x18, 
+	0x61, 0xD8, 0x14, 0x00, 0x00, 0x2E, 0x23, 0x40, 0x01, 0x38, 0xBD, 0xD6, 0xE8, 0x49, 0x1F, 0x20, 
+	0x01, 0x3E, 0xC1, 0x39, 0x01, 0x8E, 0x0E, 0x30, 0x04, 0x05, 0x03, 0xF9, 0x04, 0xD0, 0x11, 0x00, 
+	0x42, 0x72, 0xC0, 0x60, 0x00, 0x70, 0x03, 0xC5, 0xF0, 0x00, 0xA0, 0xBE, 0x3F, 0x01, 0xCE, 0x00, 
+	0x40, 0x02, 0x20, 0x0B, 0xD3, 0x48, 0x1C, 0x03, 0x3B, 0x01, 0x10, 0x33, 0x8E, 0x16, 0x00, 0x8D, 
+	0x2D, 0x00, 0x4B, 0x2D, 0x41, 0xBC, 0x6C, 0xA5, 0x18, 0x1A, 0x00, 0x42, 0x2A, 0x50, 0x71, 0xC0, 
+	0x24, 0x02, 0x22, 0x10, 0x1C, 0x2A, 0x0B, 0x40, 0x00, 0x00, 0x0F, 0xA0, 0x84, 0x00, 0xB0, 0x0F, 
+	0x07, 0xA4, 0x20, 0x00, 0x40, 0x02, 0xE1, 0x79, 0x08, 0x84, 0x7E, 0x00, 0x34, 0x12, 0x00, 0x03, 
+	0xC7, 0x15, 0x02, 0x51, 0x00, 0x51, 0x52, 0x00, 0x12, 0x01, 0x6A, 0x33, 0x00, 0x20, 0xA7, 0x3A, 
+	0x52, 0x0F, 0x53, 0x1E, 0xA6, 0x87, 0x80, 0x20, 0x06, 0x02, 0x64, 0x03, 0xC0, 0x04, 0x01, 0x09, 
+	0x0C, 0xE4, 0x12, 0xF3, 0x06, 0x14, 0x00, 0x01, 0x17, 0x01, 0x08, 0x18, 0x10, 0x00, 0xFD, 0x56, 
+	0x80, 0x20, 0x00, 0x40, 0x03, 0x1E, 0xDC, 0x00, 0xB0, 0x01, 0x70, 0x2F, 0x00, 0x15, 0x01, 0x26, 
+	0x94, 0x0E, 0xCF, 0x0A, 0x20, 0x11, 0xF8, 0x0B, 0x00, 0xA0, 0x2B, 0xD1, 0xB5, 0x66, 0x40, 0x20, 
+	0x00, 0x10, 0xAD, 0xA1, 0xF5, 0x03, 0x00, 0xA8, 0x01, 0x13, 0x03, 0xA6, 0x00, 0x03, 0xE9, 0x0E, 
+	0x01, 0x99, 0x0F, 0xF3, 0x00, 0x0E, 0x00, 0x10, 0x00, 0x09, 0x3E, 0x84, 0x20, 0x45, 0x40, 0x00, 
+	0x09, 0xCC, 0x10, 0xD0, 0x24, 0x01, 0x04, 0x11, 0x05, 0x14, 0x80, 0xCE, 0x3D, 0xF6, 0x02, 0x00, 
 	0x08, 0x00, 0x11, 0x80, 0x00, 0x00, 0x53, 0xEA, 0x06, 0x28, 0x20, 0x60, 0x00, 0x6E, 0x18, 0x09, 
-	0x40, 0x00, 0x00, 0x80, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x04, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x10, 0x00, 0x00, 0x00, 0x20, 0x04, 0x00, 0x00, 0x02, 0x01, 0x0E, 0x00, 0x10, 0x00, 0xFC, 
-	0xFF, 0x34, 0x64, 0x00, 0x40, 0x00, 0x00, 0x00, 0x00, 0x80, 0x01, 0x00, 0x08, 0x20, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x08, 0x21, 0x60, 0x38, 0xEA, 0x00, 0x00, 0x05, 0x81, 0xED, 0x42, 0x80, 0x00, 0x00, 0x00, 
-	0x00, 0x01, 0x08, 0x00, 0x00, 0x00, 0xC0, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x26, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x18, 0x00, 0x00, 0x00, 0x00, 0x04, 0x02, 0x00, 0x0C, 0x0B, 0x0D, 0x00, 
-	0x18, 0x00, 0x07, 0x5F, 0x04, 0x64, 0x00, 0x60, 0x03, 0xF0, 0x49, 0x70, 0x00, 0x01, 0xC0, 0x0A, 
-	0x80, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0x30, 0x00, 0x00, 0x00, 0x50, 0x00, 0x00, 0x80, 0x00, 
-	0x00, 0x00, 0x10, 0x00, 0x09, 0x02, 0x00, 0x80, 0xF0, 0x80, 0x80, 0x00, 0x1B, 0xA0, 0x03, 0xC0, 
-	0x02, 0x00, 0x16, 0x36, 0xF9, 0x00, 0x00, 0x0C, 0x00, 0x80, 0x00, 0x00, 0x00, 0x00, 0x00, 0x20, 
-	0x01, 0x00, 0x00, 0x00, 0x00, 0x0F, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x02, 0x3F, 0x04, 
-	0x9F, 0x0F, 0x08, 0x00, 0x01, 0xFD, 0x92, 0x1C, 0x34, 0x00, 0x00, 0x02, 0x94, 0x3B, 0x59, 0xEA, 
-	0x00, 0x00, 0x08, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x20, 0x40, 0x00, 0x00, 0x00, 0x01, 0xF0, 
-	0x01, 0x40, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0x63, 0x78, 0x80, 0xA0, 0x01, 0x40, 0x2B, 0xD9, 
-	0xF1, 0xC2, 0xC0, 0x05, 0x00, 0x97, 0xD5, 0xE1, 0x99, 0x40, 0x14, 0x00, 0x82, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x04, 0x00, 0x00, 0x00, 0x07, 0x00, 0x00, 0x10, 0x00, 0x00, 0x00, 0x00, 0x94, 
-	0x80, 0x10, 0x94, 0xD9, 0x80, 0x00, 0x10, 0x00, 0x70, 0xD0, 0x16, 0x40, 0x00, 0x40, 0x01, 0x40, 
-	0x28, 0x58, 0xA0, 0x15, 0x00, 0x08, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x20, 0x00, 0x00, 
-	0x00, 0xF0, 0x00, 0x00, 0x80, 0x00, 0x00, 0x00, 0x00, 0x22, 0x02, 0x06, 0x01, 0x79, 0xC0, 0x00, 
-	0x80, 0x07, 0x09, 0xB0, 0xE2, 0x08, 0x02, 0x00, 0x16, 0x87, 0x87, 0x80, 0xA0, 0x88, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x54, 0x01, 0x02, 0x3E, 0x93, 0x0F, 0x10, 0x50, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x04, 0x00, 0x2C, 0x09, 0x0D, 0x00, 0x10, 0x04, 0x10, 0xDA, 0x0C, 0x00, 0x60, 
-	0x40, 0x02, 0x90, 0x6C, 0x00, 0x80, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x70, 0x02, 
-	0x00, 0x00, 0x12, 0xE1, 0x81, 0xA0, 0x00, 0x80, 0x00, 0x00, 0x00, 0x00, 0x00, 0x09, 0x02, 0x00, 
-	0x80, 0x10, 0x00, 0x00, 0x00, 0x0B, 0x63, 0x40, 0x00, 0x00, 0x00, 0x16, 0x1E, 0x15, 0x8E, 0x00, 
-	0x00, 0x80, 0x00, 0x01, 0x00, 0x00, 0x80, 0x20, 0x08, 0x04, 0x00, 0x80, 0x04, 0x00, 0x00, 0x00, 
-	0x10, 0x00, 0x00, 0x00, 0x28, 0x50, 0x41, 0x29, 0x5C, 0xB0, 0x90, 0x01, 0x50, 0x00, 0xA7, 0xD6, 
-	0xC0, 0x20, 0x80, 0x44, 0x02, 0x92, 0xDE, 0x00, 0x00, 0x01, 0x00, 0x40, 0x00, 0x02, 0x08, 0x30, 
-	0x1C, 0x00, 0x00, 0x02, 0x09, 0x02, 0x00, 0x00, 0x00, 0x14, 0x00, 0x00, 0x00, 0x01, 0x02, 0x00, 
-	0x00, 0x90, 0x0A, 0x59, 0xC0, 0x00, 0x00, 0x20, 0x3D, 0x78, 0x00, 0x10, 0x00, 0x00, 0x2F, 0x9F, 
-	0xD7, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x09, 0x00, 0x00, 0x00, 0x04, 0x00, 0x00, 0x00, 
-	0x01, 0x00, 0x00, 0x10, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x08, 0x01, 0x00, 0x08, 0x14, 0x10, 
-	0x00, 0x20, 0x1A, 0xC6, 0x01, 0x60, 0x40, 0x00, 0x00, 0x00, 0x10, 0xA0, 0x01, 0x00, 0x00, 0x00, 
-	0x02, 0x40, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x02, 0x00, 0x08, 0x00, 0x18, 0x10, 0x18, 0x00, 0x08, 0x00, 0x03, 0x65, 0x40, 0x08, 0x00, 
-	0x00, 0x00, 0x00, 0x01, 0x1B, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x04, 
-	0x00, 0x00, 0x00, 0x01, 0x00, 0x00, 0x10, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x04, 0x00, 
-	0x00, 0x00, 0x50, 0x00, 0xFC, 0xB2, 0x64, 0x42, 0x00, 0x40, 0x00, 0x00, 0x3C, 0x18, 0x80, 0x01, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x1E, 0x78, 0x00, 0x00, 0x00, 0x00, 0x00, 0xF1, 0xC0, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x09, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x05, 0x8F, 0x36, 
-	0x47, 0x00, 0x00, 0x00, 0x01, 0x4C, 0x83, 0x00, 0x1C, 0x00, 0x00, 0xA4, 0x09, 0x01, 0x00, 0x30, 
-	0x00, 0x01, 0x04, 0x00, 0x2C, 0x1E, 0xD0, 0x00, 0x00, 0x10, 0x00, 0x00, 0x00, 0x20, 0x00, 0x80, 
-	0x28, 0x24, 0xFF, 0x1C, 0x00, 0x90, 0x00, 0x5B, 0xBE, 0x24, 0x28, 0x00, 0x44, 0x00, 0x0B, 0x4A, 
-	0x90, 0x90, 0x01, 0x00, 0x08, 0x40, 0x02, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0xC2, 0xC0, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x81, 0x79, 0xD0, 0xB0, 0x94, 0x00, 
-	0x20, 0x3D, 0xAE, 0x63, 0xC0, 0x00, 0x00, 0x00, 0x34, 0xC8, 0x00, 0x00, 0x00, 0x0C, 0x80, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x07, 0x00, 0x10, 0x1E, 0xD0, 0x00, 0x00, 0x9C, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x01, 0x08, 0x01, 0x00, 0x8A, 0x00, 0x1C, 0x8C, 0x07, 0xF4, 0x02, 0x20, 0x00, 0x60, 
-	0x00, 0x03, 0xD9, 0x00, 0xF0, 0x01, 0xC4, 0x88, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x30, 
-	0x02, 0x17, 0xED, 0x70, 0x00, 0x04, 0x80, 0x00, 0x00, 0x00, 0x00, 0x00, 0x08, 0x00, 0x1A, 0x38, 
-	0x00, 0x00, 0xC0, 0x00, 0x7D, 0xB0, 0x62, 0x10, 0x02, 0x00, 0x02, 0x14, 0x81, 0x1F, 0x40, 0x48, 
-	0x80, 0x80, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0x00, 0x20, 0x88, 0x00, 0x00, 0x0F, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x80, 0x04, 0x00, 0xA7, 0x0F, 0x00, 0x00, 0x00, 0xBC, 0x98, 0x14, 
-	0x64, 0x00, 0x54, 0x00, 0x28, 0x00, 0x00, 0x80, 0x00, 0x00, 0x08, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x50, 0x08, 0x00, 0x08, 0x70, 0x10, 0x01, 0x40, 0x00, 0x00, 0x00, 0x00, 0x00, 0x08, 
-	0x00, 0x01, 0x00, 0x10, 0x01, 0x40, 0x2B, 0xC5, 0x6B, 0x63, 0xC0, 0x04, 0x80, 0x02, 0x86, 0x80, 
-	0x01, 0x00, 0x14, 0x00, 0x80, 0x01, 0x01, 0x00, 0x38, 0x00, 0x00, 0x04, 0x00, 0x00, 0x00, 0x00, 
-	0x09, 0x00, 0x10, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x3F, 0x0E, 0xB0, 0x8D, 0x00, 0x10, 0x00, 
-	0x5A, 0xD6, 0x3E, 0x78, 0x00, 0x40, 0x00, 0xF0, 0xCD, 0x59, 0xA0, 0x01, 0x04, 0x08, 0x00, 0x02, 
-	0x00, 0x00, 0x5E, 0x00, 0x00, 0x20, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x80, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x01, 0x63, 0xFF, 0x50, 0x10, 0x04, 0x80, 0x27, 0xE0, 0x63, 0x46, 0x40, 0x52, 0x00, 
-	0xAF, 0x61, 0xB7, 0x8A, 0x00, 0x08, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x07, 0x00, 0x40, 0x00, 0x00, 0x00, 0x00, 0x00, 0x04, 0x81, 0x01, 0x3D, 0x09, 0x89, 
-	0x00, 0x09, 0x00, 0x10, 0x02, 0x40, 0x24, 0x00, 0x06, 0x01, 0x08, 0xDD, 0x00, 0xD1, 0x54, 0x04, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x20, 0x00, 0x00, 0x00, 0x80, 0x08, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x04, 0x00, 0x13, 0xCA, 0x98, 0x10, 0x00, 0x80, 0x20, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x01, 0x80, 0x08, 0x00, 0x80, 0x80, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x0F, 0x1C, 0x00, 0x00, 0x00, 0x00, 0x00, 0x04, 0x40, 0x06, 
-	0x14, 0xB0, 0x90, 0x00, 0x02, 0x84, 0x01, 0x58, 0x00, 0x00, 0x00, 0x00, 0x42, 0x80, 0x00, 0x00, 
-	0xA0, 0x00, 0x00, 0x06, 0x00, 0x00, 0x00, 0x00, 0x00, 0x02, 0x80, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x90, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x18, 0x92, 0x01, 0x71, 0x80, 0x00, 0x20, 0x00, 
-	0x15, 0xF8, 0x00, 0x0F, 0x00, 0x22, 0x28, 0x1D, 0xE7, 0x01, 0x00, 0x00, 0x08, 0x00, 0x00, 0xA0, 
-	0x00, 0x03, 0xC0, 0x00, 0x10, 0x02, 0x30, 0x0E, 0xBF, 0x10, 0x00, 0x40, 0x00, 0x00, 0x00, 0x10, 
-	0x04, 0xA0, 0x02, 0x1D, 0x0B, 0x0F, 0x00, 0x00, 0x00, 0x00, 0x00, 0x14, 0x28, 0x00, 0x00, 0x00, 
-	0x02, 0xDC, 0x00, 0x04, 0x08, 0x04, 0x40, 0x00, 0x06, 0x08, 0x30, 0x00, 0x00, 0x00, 0x00, 0x0B, 
-	0x96, 0xF9, 0x01, 0xC1, 0x10, 0x00, 0x00, 0x00, 0x02, 0x81, 0x00, 0x10, 0x22, 0xDE, 0x80, 0x10, 
-	0x14, 0x00, 0x00, 0x00, 0x02, 0x00, 0x40, 0x00, 0x00, 0x20, 0x41, 0x80, 0x00, 0xA5, 0x40, 0x00, 
-	0x22, 0x00, 0x00, 0x00, 0x00, 0x03, 0x80, 0x00, 0x00, 0x00, 0x00, 0x0F, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x54, 0x00, 0x10, 0xB4, 0xA0, 0x09, 0x00, 0x00, 0x10, 0x20, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x10, 0x00, 0x08, 0x00, 0x00, 0x40, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x02, 0x00, 0x1A, 0x06, 
-	0x01, 0x00, 0x10, 0x00, 0x00, 0x20, 0x00, 0x20, 0x06, 0x80, 0x00, 0x00, 0x00, 0x00, 0x09, 0x18, 
-	0x01, 0x00, 0x00, 0x00, 0x08, 0x20, 0x00, 0x80, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x0B, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x10, 0x04, 0x81, 0x0C, 0x34, 0xA1, 0x08, 0x00, 0x00, 0x00, 0x00, 
-	0x90, 0x14, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xF0, 0x00, 0x00, 0x00, 0x00, 0x30, 0x06, 0x08, 
-	0x38, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x80, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x01, 0x42, 0xEB, 0xF1, 0xD0, 0x14, 0x01, 0x24, 0x08, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x80, 0x00, 0x08, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x23, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x08, 0x00, 0x00, 0x00, 0x00, 0x04, 0x00, 0x00, 0x00, 0x00, 0x80, 0x00, 
-	0x0C, 0x10, 0x00, 0x90, 0x14, 0x2C, 0x80, 0x28, 0x00, 0x40, 0x0F, 0xF0, 0x00, 0x54, 0x84, 0xC0, 
-	0x00, 0x00, 0x00, 0x00, 0x0C, 0x00, 0x01, 0x20, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0x80, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x79, 0x80, 0x00, 0xC0, 0x24, 0x08, 0x02, 0x02, 0x90, 
-	0x02, 0x01, 0x80, 0x00, 0x00, 0x08, 0x00, 0x88, 0x80, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x05, 0x0E, 0x00, 0x14, 0x00, 0x00, 0x00, 0x00, 0x00, 0x21, 0x28, 0x02, 
-	0x00, 0x0A, 0x5C, 0x80, 0x00, 0x00, 0x50, 0x36, 0x00, 0x00, 0x00, 0x00, 0x0B, 0x6B, 0x90, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x20, 0x50, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x01, 0x40, 0x00, 0x00, 0x00, 0x00, 0x08, 0x0A, 0x81, 0x7A, 0x00, 0x08, 0x11, 0x60, 0x24, 0x00, 
-	0x01, 0xC0, 0x00, 0x05, 0x00, 0x00, 0x2D, 0xE8, 0x00, 0x00, 0x14, 0x00, 0x02, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x2D, 0x9F, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x84, 
-	0x80, 0x0F, 0x2D, 0xE0, 0x00, 0x00, 0x00, 0x00, 0xCF, 0x3B, 0x5E, 0x40, 0x12, 0x00, 0x01, 0x49, 
-	0x69, 0x51, 0x00, 0x00, 0x04, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x22, 0x01, 
-	0xDF, 0x80, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x20, 0x00, 0x62, 0x1E, 0x00, 0x00, 0x00, 
-	0x00, 0x0A, 0x7D, 0x37, 0x42, 0x80, 0x40, 0x01, 0x1C, 0x94, 0x90, 0x18, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x10, 0x00, 0x00, 0x00, 0x00, 0x00, 0x10, 0x00, 0x0C, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x08, 0x00, 0x00, 0x00, 0x1C, 0x80, 0x00, 0x00, 0xD0, 0x00, 0x01, 0x00, 
-	0x00, 0x00, 0x03, 0xCB, 0x78, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x01, 0xC0, 0x00, 0xC0, 0x00, 0x00, 0x01, 0x02, 0x06, 0x08, 0x00, 0x08, 
-	0x00, 0x00, 0x04, 0x00, 0x24, 0x08, 0x00, 0x60, 0x18, 0x00, 0x00, 0x20, 0x36, 0xB3, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x01, 0x80, 0x00, 0x00, 0x00, 0x00, 0x00, 0x24, 0x08, 0x00, 0x00, 0x80, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x61, 0x04, 0x00, 0x80, 0x00, 0x00, 0x02, 0x04, 0x00, 0x30, 
-	0x00, 0x00, 0x00, 0x00, 0x10, 0x02, 0x40, 0x90, 0x00, 0x00, 0x00, 0x00, 0x00, 0x86, 0x08, 0x38, 
-	0x00, 0x00, 0x00, 0x00, 0x18, 0x00, 0x18, 0x70, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x0E, 
-	0x08, 0x00, 0x01, 0x00, 0x0A, 0x00, 0x08, 0x24, 0x08, 0x00, 0x00, 0x00, 0x00, 0x80, 0x90, 0x20, 
-	0x08, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x04, 0x00, 0x20, 0x00, 0x00, 0x00, 
-	0x01, 0x00, 0x40, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x02, 0x00, 0x00, 0x00, 0x00, 
-	0x10, 0x81, 0x90, 0x04, 0x20, 0x00, 0x00, 0x10, 0x04, 0x70, 0x08, 0x00, 0x08, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x38, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0xE0, 0x10, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x0E, 0x08, 0x21, 0x60, 0x00, 0x00, 0x00, 0x00, 0x08, 0x18, 0x28, 0x00, 0x28, 0x00, 
-	0x00, 0x00, 0x55, 0xE1, 0x80, 0x41, 0xC0, 0x00, 0x02, 0x00, 0x00, 0x00, 0x00, 0x00, 0x07, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x10, 0x00, 0x00, 0x00, 0x00, 0x08, 0x00, 0x00, 0x0C, 0x06, 0x07, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0xB0, 0x00, 0x20, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xEB, 0xC0, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0x80, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x10, 0xC1, 0x40, 0x80, 0x00, 0x00, 0x00, 0x24, 0x08, 0x00, 
-	0x40, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x10, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x81, 
-	0x08, 0x01, 0x0B, 0x00, 0x0C, 0x00, 0x84, 0x0A, 0x0B, 0x44, 0x20, 0x00, 0x00, 0x00, 0x06, 0x68, 
-	0x50, 0xA0, 0x00, 0x00, 0x20, 0x30, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x18, 0x00, 0x0A, 0x90, 0x80, 0x00, 0x20, 
-	0x00, 0x51, 0x80, 0x00, 0x44, 0x00, 0x00, 0x00, 0x94, 0x00, 0x1F, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x02, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x0C, 0x00, 0x00, 0x00, 
-	0x0F, 0x00, 0x24, 0x00, 0x02, 0x0B, 0x00, 0x01, 0x08, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x20, 
-	0x51, 0x00, 0xDF, 0x50, 0x00, 0x00, 0x80, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x20, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xC0, 0x00, 0x00, 0x01, 0x00, 0x04, 0x08, 0x21, 0x60, 0x91, 
-	0xA0, 0x00, 0xC0, 0x00, 0x00, 0x00, 0x06, 0x00, 0x02, 0x00, 0x00, 0x17, 0xDD, 0x8E, 0x80, 0x08, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0x00, 0x67, 0xC1, 0x10, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x01, 0x50, 0x84, 0x3E, 0x82, 0x85, 0x0D, 0x00, 0x82, 0x84, 0x10, 0x58, 0x04, 
-	0x01, 0x70, 0x0A, 0x40, 0x80, 0x00, 0xF0, 0xF0, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x04, 0xD0, 0x00, 0x02, 0xF9, 0xF1, 0xE0, 0x01, 0x40, 0x00, 0x00, 0x00, 0x00, 0x08, 0x13, 
-	0xFC, 0x6A, 0x80, 0x10, 0x15, 0x40, 0x01, 0x0F, 0xA3, 0x60, 0x20, 0x05, 0x00, 0x80, 0x01, 0x88, 
-	0x01, 0x00, 0x14, 0x00, 0x02, 0x00, 0x00, 0x00, 0x03, 0xC0, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x07, 0x00, 0x20, 0x00, 0x14, 0x00, 0x0E, 0x00, 0x00, 0x00, 
-	0x00, 0x30, 0x14, 0x20, 0x04, 0x00, 0x40, 0x07, 0xF0, 0x70, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x20, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x19, 0x02, 0x00, 0x01, 0xE0, 0x00, 0x00, 0x24, 0x00, 0x02, 0x00, 0x40, 0x20, 0x80, 
-	0x00, 0x7C, 0xAD, 0x1A, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x80, 
-	0x00, 0x0C, 0x00, 0x10, 0x03, 0x84, 0x39, 0x00, 0x20, 0x02, 0xC2, 0xD0, 0x00, 0x00, 0x00, 0xC0, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x20, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x80, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x70, 0x00, 0x00, 0x80, 0x20, 0x00, 0x02, 0x60, 
-	0x28, 0x02, 0x00, 0x2C, 0x2F, 0xA0, 0x00, 0x00, 0x08, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x01, 0x0E, 0x00, 0x00, 0x00, 0x00, 0x30, 0x00, 0x30, 0x00, 0x0C, 0x10, 0x03, 0xC0, 0x00, 
-	0xB0, 0x14, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x38, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x80, 0x00, 0x00, 0x00, 0x24, 
-	0x00, 0x01, 0x66, 0x43, 0x00, 0xC0, 0x90, 0x00, 0x01, 0x80, 0x40, 0x80, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x24, 0x84, 0x00, 0xF0, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x30, 0x5D, 0xF0, 0x18, 0x00, 0x00, 0x00, 0xAA, 0x07, 0xCE, 0x64, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x09, 0xB0, 0x04, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x58, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x04, 0x00, 0x01, 0x00, 0xFA, 0x01, 0x90, 
-	0x00, 0x00, 0x0A, 0x53, 0xFE, 0x47, 0x40, 0x00, 0x00, 0x00, 0x00, 0x03, 0x8A, 0x08, 0x00, 0x00, 
-	0x02, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x20, 0x00, 
-	0x00, 0x00, 0x10, 0x00, 0x00, 0x00, 0x02, 0x07, 0x00, 0x11, 0xC0, 0x00, 0x20, 0x04, 0x02, 0x36, 
-	0x80, 0x00, 0x40, 0x20, 0xDB, 0x00, 0xE0, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x60, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x02, 0x80, 0x00, 0x08, 0x20, 
-	0xC0, 0x70, 0x00, 0x08, 0x00, 0x20, 0x00, 0x70, 0x60, 0x50, 0x00, 0x00, 0x21, 0x4F, 0x80, 0x01, 
-	0x10, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x08, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x0C, 0x00, 0x90, 0x00, 0x00, 0x00, 0x00, 
-	0x08, 0x00, 0x20, 0x00, 0x00, 0x01, 0x7C, 0x10, 0x00, 0x0A, 0x00, 0x00, 0x00, 0x30, 0x00, 0x00, 
-	0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x01, 0x02, 0x00, 0x79, 0xE0, 0x00, 0x00, 0x20, 0x83, 0x80, 0x00, 0x68, 0x00, 0x00, 0x17, 
-	0xCF, 0xA5, 0x9C, 0x60, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x40, 0x08, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x3C, 0x00, 0x00, 0x00, 
-	0x08, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x30, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x82, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x0A, 0x00, 0x80, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x09, 0x02, 0x00, 0x00, 0x00, 0x00, 0xC0, 0x20, 0x83, 0x80, 0x00, 0x00, 
-	0x03, 0x00, 0x00, 0x00, 0x07, 0x80, 0x20, 0x08, 0x80, 0x00, 0x00, 0x03, 0xC3, 0x00, 0x00, 0x00, 
-	0x0D, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x80, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x20, 0x00, 0x00, 0x10, 0x03, 0x80, 0x3C, 0x00, 0x00, 0x00, 0x01, 0xC0, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x02, 0x3C, 0x00, 0x00, 0x00, 0x00, 0x50, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x01, 0x40, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0x40, 0x20, 0x00, 
-	0x04, 0x00, 0x40, 0x05, 0x00, 0x10, 0x00, 0x01, 0x80, 0x00, 0x14, 0x00, 0x40, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x07, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x88, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x28, 0x3B, 0x80, 0x00, 0x00, 0x00, 0x12, 0x94, 
-	0x0C, 0xF0, 0x0A, 0x00, 0x00, 0x06, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x01, 0x8B, 0x68, 0x00, 0x00, 0x00, 0x00, 0x16, 0x80, 0x00, 0x00, 0x40, 0x20, 0x00, 0x00, 
-	0x62, 0x00, 0x3F, 0x72, 0x00, 0x80, 0x11, 0x00, 0x82, 0x00, 0x00, 0x01, 0x03, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x82, 
-	0x00, 0x80, 0x01, 0x03, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x11, 0x01, 0x82, 0x00, 0x00, 0x01, 0x03, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x82, 
-	0x00, 0x80, 0x01, 0x03, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x11, 0x02, 0x82, 0x00, 0x00, 0x01, 0x03, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x82, 
-	0x00, 0x80, 0x01, 0x03, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x11, 0x03, 0x82, 0x00, 0x00, 0x01, 0x03, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x82, 
-	0x00, 0x80, 0x01, 0x03, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x22, 0x8B, 0x30, 0x01, 0x06, 0x00, 
+	0xAA, 0x0C, 0x07, 0x26, 0x38, 0x00, 0xE9, 0x12, 0x20, 0x02, 0x01, 0x53, 0x00, 0x43, 0xFC, 0xFF, 
+	0x34, 0x64, 0x04, 0x14, 0x12, 0x01, 0x4D, 0x2B, 0x0C, 0x01, 0x00, 0xA2, 0x08, 0x21, 0x60, 0x38, 
+	0xEA, 0x00, 0x00, 0x05, 0x81, 0xED, 0x98, 0x02, 0x01, 0xB6, 0x10, 0x03, 0x07, 0x05, 0x12, 0x26, 
+	0x07, 0x00, 0x02, 0x9F, 0x01, 0xF2, 0x07, 0x02, 0x00, 0x0C, 0x0B, 0x0D, 0x00, 0x18, 0x00, 0x07, 
+	0x5F, 0x04, 0x64, 0x00, 0x60, 0x03, 0xF0, 0x49, 0x70, 0x00, 0x01, 0xC0, 0x0A, 0x7D, 0x00, 0x10, 
+	0x01, 0x98, 0x02, 0x01, 0xC7, 0x0D, 0x00, 0x81, 0x00, 0xF0, 0x02, 0x09, 0x02, 0x00, 0x80, 0xF0, 
+	0x80, 0x80, 0x00, 0x1B, 0xA0, 0x03, 0xC0, 0x02, 0x00, 0x16, 0x36, 0xF9, 0xEA, 0x02, 0x02, 0x29, 
+	0x00, 0x02, 0x5E, 0x3B, 0x04, 0x38, 0x04, 0xC0, 0x02, 0x3F, 0x04, 0x9F, 0x0F, 0x08, 0x00, 0x01, 
+	0xFD, 0x92, 0x1C, 0x34, 0x3C, 0x01, 0x36, 0x3B, 0x59, 0xEA, 0x46, 0x0A, 0x01, 0xE8, 0x05, 0x13, 
+	0xF0, 0x98, 0x02, 0xF2, 0x06, 0x01, 0x63, 0x78, 0x80, 0xA0, 0x01, 0x40, 0x2B, 0xD9, 0xF1, 0xC2, 
+	0xC0, 0x05, 0x00, 0x97, 0xD5, 0xE1, 0x99, 0x40, 0x14, 0x00, 0xC4, 0x03, 0x01, 0xF9, 0x00, 0x13, 
+	0x07, 0x9F, 0x01, 0x50, 0x94, 0x80, 0x10, 0x94, 0xD9, 0x54, 0x0D, 0xB2, 0x70, 0xD0, 0x16, 0x40, 
+	0x00, 0x40, 0x01, 0x40, 0x28, 0x58, 0xA0, 0x3A, 0x06, 0x04, 0x4F, 0x01, 0x13, 0xF0, 0x31, 0x01, 
+	0xF5, 0x05, 0x22, 0x02, 0x06, 0x01, 0x79, 0xC0, 0x00, 0x80, 0x07, 0x09, 0xB0, 0xE2, 0x08, 0x02, 
+	0x00, 0x16, 0x87, 0x87, 0x80, 0xA0, 0x13, 0x2C, 0x72, 0x54, 0x01, 0x02, 0x3E, 0x93, 0x0F, 0x10, 
+	0xA1, 0x04, 0xF0, 0x02, 0x04, 0x00, 0x2C, 0x09, 0x0D, 0x00, 0x10, 0x04, 0x10, 0xDA, 0x0C, 0x00, 
+	0x60, 0x40, 0x02, 0x90, 0x6C, 0x4C, 0x01, 0x02, 0x01, 0x00, 0x00, 0xC9, 0x2C, 0x43, 0x12, 0xE1, 
+	0x81, 0xA0, 0xDE, 0x00, 0x00, 0xF9, 0x00, 0x00, 0x87, 0x00, 0x20, 0x0B, 0x63, 0xB6, 0x00, 0x40, 
+	0x16, 0x1E, 0x15, 0x8E, 0x6D, 0x00, 0x10, 0x01, 0xD4, 0x08, 0x21, 0x08, 0x04, 0x55, 0x2E, 0x01, 
+	0xA6, 0x00, 0xF0, 0x04, 0x28, 0x50, 0x41, 0x29, 0x5C, 0xB0, 0x90, 0x01, 0x50, 0x00, 0xA7, 0xD6, 
+	0xC0, 0x20, 0x80, 0x44, 0x02, 0x92, 0xDE, 0xB1, 0x03, 0x91, 0x40, 0x00, 0x02, 0x08, 0x30, 0x1C, 
+	0x00, 0x00, 0x02, 0xC8, 0x16, 0x00, 0xF2, 0x01, 0x00, 0x5B, 0x34, 0x90, 0x90, 0x0A, 0x59, 0xC0, 
+	0x00, 0x00, 0x20, 0x3D, 0x78, 0x3B, 0x00, 0x33, 0x2F, 0x9F, 0xD7, 0x7A, 0x00, 0x04, 0x08, 0x13, 
+	0x00, 0x74, 0x3D, 0x03, 0xC9, 0x01, 0xA1, 0x01, 0x00, 0x08, 0x14, 0x10, 0x00, 0x20, 0x1A, 0xC6, 
+	0x01, 0x01, 0x2C, 0x00, 0x80, 0x1A, 0x09, 0x74, 0x11, 0x03, 0x74, 0x01, 0xB2, 0x00, 0x08, 0x00, 
+	0x18, 0x10, 0x18, 0x00, 0x08, 0x00, 0x03, 0x65, 0xD1, 0x17, 0x10, 0x01, 0xE7, 0x2F, 0x03, 0x01, 
+	0x00, 0x0A, 0x53, 0x00, 0x01, 0x0F, 0x00, 0x50, 0x50, 0x00, 0xFC, 0xB2, 0x64, 0x96, 0x15, 0x34, 
+	0x00, 0x3C, 0x18, 0xF9, 0x00, 0x12, 0x1E, 0xD7, 0x04, 0x14, 0xF1, 0x2F, 0x07, 0x03, 0x1B, 0x08, 
+	0x40, 0x05, 0x8F, 0x36, 0x47, 0x41, 0x00, 0x20, 0x4C, 0x83, 0xA2, 0x15, 0x20, 0xA4, 0x09, 0xB3, 
+	0x19, 0x63, 0x01, 0x04, 0x00, 0x2C, 0x1E, 0xD0, 0x98, 0x02, 0xF3, 0x09, 0x00, 0x80, 0x28, 0x24, 
+	0xFF, 0x1C, 0x00, 0x90, 0x00, 0x5B, 0xBE, 0x24, 0x28, 0x00, 0x44, 0x00, 0x0B, 0x4A, 0x90, 0x90, 
+	0x01, 0x00, 0x08, 0x40, 0xFA, 0x06, 0x27, 0x01, 0xC2, 0x80, 0x07, 0xA0, 0x81, 0x79, 0xD0, 0xB0, 
+	0x94, 0x00, 0x20, 0x3D, 0xAE, 0x63, 0x15, 0x00, 0x20, 0x34, 0xC8, 0x30, 0x05, 0x03, 0xEB, 0x02, 
+	0x30, 0x07, 0x00, 0x10, 0x53, 0x00, 0x12, 0x9C, 0x35, 0x00, 0xA0, 0x08, 0x01, 0x00, 0x8A, 0x00, 
+	0x1C, 0x8C, 0x07, 0xF4, 0x02, 0xEA, 0x0F, 0x64, 0x03, 0xD9, 0x00, 0xF0, 0x01, 0xC4, 0xCA, 0x01, 
+	0x53, 0x30, 0x02, 0x17, 0xED, 0x70, 0xB1, 0x2C, 0x50, 0x00, 0x08, 0x00, 0x1A, 0x38, 0xDC, 0x02, 
+	0xC2, 0x7D, 0xB0, 0x62, 0x10, 0x02, 0x00, 0x02, 0x14, 0x81, 0x1F, 0x40, 0x48, 0x98, 0x31, 0x00, 
+	0xE7, 0x1E, 0x16, 0x88, 0x98, 0x02, 0x40, 0x80, 0x04, 0x00, 0xA7, 0x0C, 0x00, 0x60, 0xBC, 0x98, 
+	0x14, 0x64, 0x00, 0x54, 0x94, 0x05, 0x03, 0x9B, 0x24, 0x00, 0x01, 0x00, 0x63, 0x50, 0x08, 0x00, 
+	0x08, 0x70, 0x10, 0x98, 0x02, 0x00, 0x20, 0x18, 0xE0, 0x10, 0x01, 0x40, 0x2B, 0xC5, 0x6B, 0x63, 
+	0xC0, 0x04, 0x80, 0x02, 0x86, 0x80, 0x01, 0x4E, 0x30, 0x20, 0x01, 0x01, 0xC9, 0x0A, 0x01, 0x91, 
+	0x03, 0x14, 0x09, 0x4C, 0x01, 0xA0, 0x3F, 0x0E, 0xB0, 0x8D, 0x00, 0x10, 0x00, 0x5A, 0xD6, 0x3E, 
+	0xFC, 0x25, 0x61, 0xF0, 0xCD, 0x59, 0xA0, 0x01, 0x04, 0x9D, 0x20, 0x1B, 0x5E, 0x75, 0x07, 0xFA, 
+	0x03, 0x01, 0x63, 0xFF, 0x50, 0x10, 0x04, 0x80, 0x27, 0xE0, 0x63, 0x46, 0x40, 0x52, 0x00, 0xAF, 
+	0x61, 0xB7, 0x8A, 0xA5, 0x0C, 0x13, 0x07, 0x6E, 0x08, 0x60, 0x04, 0x81, 0x01, 0x3D, 0x09, 0x89, 
+	0x61, 0x00, 0xB9, 0x02, 0x40, 0x24, 0x00, 0x06, 0x01, 0x08, 0xDD, 0x00, 0xD1, 0x54, 0xC8, 0x07, 
+	0x04, 0x5D, 0x19, 0x60, 0x04, 0x00, 0x13, 0xCA, 0x98, 0x10, 0x3E, 0x32, 0x03, 0x67, 0x01, 0x00, 
+	0x1D, 0x32, 0x09, 0x88, 0x0A, 0x12, 0x0F, 0x51, 0x17, 0xB0, 0x04, 0x40, 0x06, 0x14, 0xB0, 0x90, 
+	0x00, 0x02, 0x84, 0x01, 0x58, 0x0F, 0x00, 0x00, 0x11, 0x04, 0x13, 0xA0, 0x3B, 0x3C, 0x04, 0x9A, 
+	0x0F, 0x04, 0x9B, 0x13, 0x40, 0x18, 0x92, 0x01, 0x71, 0x66, 0x31, 0xA2, 0x15, 0xF8, 0x00, 0x0F, 
+	0x00, 0x22, 0x28, 0x1D, 0xE7, 0x01, 0x90, 0x34, 0x00, 0xDD, 0x04, 0x52, 0x10, 0x02, 0x30, 0x0E, 
+	0xBF, 0x85, 0x22, 0x62, 0x10, 0x04, 0xA0, 0x02, 0x1D, 0x0B, 0x58, 0x01, 0x00, 0xC8, 0x07, 0xA0, 
+	0x00, 0x02, 0xDC, 0x00, 0x04, 0x08, 0x04, 0x40, 0x00, 0x06, 0xB1, 0x30, 0x70, 0x00, 0x00, 0x0B, 
+	0x96, 0xF9, 0x01, 0xC1, 0x22, 0x01, 0x81, 0x02, 0x81, 0x00, 0x10, 0x22, 0xDE, 0x80, 0x10, 0x90, 
+	0x21, 0x00, 0x3B, 0x00, 0x62, 0x20, 0x41, 0x80, 0x00, 0xA5, 0x40, 0x79, 0x0F, 0x00, 0x82, 0x1C, 
+	0x06, 0x9E, 0x01, 0x50, 0x54, 0x00, 0x10, 0xB4, 0xA0, 0x0D, 0x11, 0x05, 0xCF, 0x04, 0x00, 0x98, 
+	0x2A, 0x0F, 0xAF, 0x0B, 0x00, 0x41, 0x02, 0x00, 0x1A, 0x06, 0x94, 0x15, 0x32, 0x20, 0x00, 0x20, 
+	0x36, 0x17, 0x21, 0x09, 0x18, 0xFE, 0x14, 0x04, 0xAA, 0x2F, 0x00, 0x45, 0x0C, 0x01, 0x40, 0x00, 
+	0x51, 0x04, 0x81, 0x0C, 0x34, 0xA1, 0x2E, 0x01, 0x13, 0x90, 0x6A, 0x05, 0x01, 0xBA, 0x0B, 0x34, 
+	0x30, 0x06, 0x08, 0x01, 0x13, 0x05, 0x2F, 0x01, 0x73, 0x01, 0x42, 0xEB, 0xF1, 0xD0, 0x14, 0x01, 
+	0xF1, 0x0D, 0x02, 0x1B, 0x00, 0x04, 0x0C, 0x00, 0x00, 0xCB, 0x2D, 0x04, 0x3E, 0x08, 0x01, 0x8A, 
+	0x01, 0xF1, 0x02, 0x80, 0x00, 0x0C, 0x10, 0x00, 0x90, 0x14, 0x2C, 0x80, 0x28, 0x00, 0x40, 0x0F, 
+	0xF0, 0x00, 0x54, 0x84, 0xE0, 0x02, 0x10, 0x0C, 0x28, 0x21, 0x01, 0x4C, 0x00, 0x05, 0x56, 0x00, 
+	0xA2, 0x79, 0x80, 0x00, 0xC0, 0x24, 0x08, 0x02, 0x02, 0x90, 0x02, 0x06, 0x27, 0x00, 0xA9, 0x2C, 
+	0x05, 0x01, 0x00, 0x23, 0x05, 0x0E, 0xB5, 0x0C, 0x60, 0x21, 0x28, 0x02, 0x00, 0x0A, 0x5C, 0xB2, 
+	0x11, 0x01, 0x66, 0x07, 0x27, 0x0B, 0x6B, 0x29, 0x15, 0x13, 0x20, 0x75, 0x16, 0x02, 0x0B, 0x1C, 
+	0x80, 0x0A, 0x81, 0x7A, 0x00, 0x08, 0x11, 0x60, 0x24, 0x2A, 0x0B, 0x40, 0x05, 0x00, 0x00, 0x2D, 
+	0x2C, 0x26, 0x07, 0x60, 0x0A, 0x23, 0x2D, 0x9F, 0x09, 0x00, 0x41, 0x84, 0x80, 0x0F, 0x2D, 0x0B, 
+	0x07, 0xA8, 0xCF, 0x3B, 0x5E, 0x40, 0x12, 0x00, 0x01, 0x49, 0x69, 0x51, 0x60, 0x0A, 0x34, 0x22, 
+	0x01, 0xDF, 0x89, 0x00, 0x31, 0x20, 0x00, 0x62, 0x5E, 0x11, 0xA6, 0x0A, 0x7D, 0x37, 0x42, 0x80, 
+	0x40, 0x01, 0x1C, 0x94, 0x90, 0x25, 0x25, 0x02, 0xE3, 0x02, 0x14, 0x10, 0xC9, 0x09, 0x00, 0x00, 
+	0x01, 0x20, 0x1C, 0x80, 0x5E, 0x09, 0x01, 0x6B, 0x12, 0x15, 0xCB, 0x04, 0x09, 0x03, 0x01, 0x00, 
+	0x11, 0x01, 0x2E, 0x20, 0x31, 0x01, 0x02, 0x06, 0x64, 0x26, 0x10, 0x04, 0x3D, 0x0F, 0x72, 0x60, 
+	0x18, 0x00, 0x00, 0x20, 0x36, 0xB3, 0x1F, 0x00, 0x03, 0xBF, 0x17, 0x03, 0x4E, 0x33, 0x00, 0x01, 
+	0x00, 0x10, 0x61, 0x60, 0x17, 0x00, 0x00, 0x24, 0x01, 0x35, 0x02, 0x23, 0x10, 0x02, 0x1D, 0x24, 
+	0x12, 0x86, 0x9F, 0x01, 0x34, 0x18, 0x00, 0x18, 0x47, 0x16, 0x10, 0x0E, 0x91, 0x03, 0x32, 0x0A, 
+	0x00, 0x08, 0x9F, 0x01, 0x24, 0x80, 0x90, 0x9D, 0x26, 0x05, 0x8F, 0x3A, 0x07, 0x84, 0x39, 0x01, 
+	0x0F, 0x01, 0x50, 0x10, 0x81, 0x90, 0x04, 0x20, 0x02, 0x02, 0x16, 0x70, 0xF1, 0x26, 0x02, 0xF4, 
+	0x01, 0x22, 0x01, 0xE0, 0xD7, 0x00, 0x31, 0x0E, 0x08, 0x21, 0xFF, 0x10, 0x31, 0x08, 0x18, 0x28, 
+	0xA2, 0x09, 0x44, 0x55, 0xE1, 0x80, 0x41, 0x09, 0x37, 0x03, 0xDC, 0x0B, 0x03, 0x31, 0x27, 0x32, 
+	0x00, 0x0C, 0x06, 0x11, 0x00, 0x14, 0xB0, 0xD2, 0x03, 0x1B, 0xEB, 0x50, 0x0C, 0x04, 0xF1, 0x01, 
+	0x21, 0x10, 0xC1, 0x5B, 0x1B, 0x10, 0x24, 0x4F, 0x2D, 0x0B, 0x01, 0x00, 0x0A, 0x3A, 0x0B, 0xB0, 
+	0x81, 0x08, 0x01, 0x0B, 0x00, 0x0C, 0x00, 0x84, 0x0A, 0x0B, 0x44, 0x53, 0x00, 0x20, 0x06, 0x68, 
+	0x8D, 0x24, 0x18, 0x20, 0x47, 0x12, 0x04, 0x01, 0x00, 0x40, 0x18, 0x00, 0x0A, 0x90, 0x91, 0x03, 
+	0x21, 0x51, 0x80, 0xE7, 0x1B, 0x36, 0x94, 0x00, 0x1F, 0x1C, 0x00, 0x05, 0xE3, 0x1A, 0x00, 0x45, 
+	0x03, 0x45, 0x24, 0x00, 0x02, 0x0B, 0x9C, 0x18, 0x43, 0x20, 0x51, 0x00, 0xDF, 0xB8, 0x07, 0x02, 
+	0x10, 0x00, 0x02, 0x07, 0x00, 0x00, 0x9F, 0x01, 0x71, 0x00, 0x04, 0x08, 0x21, 0x60, 0x91, 0xA0, 
+	0x0C, 0x08, 0x00, 0x49, 0x20, 0x47, 0x00, 0x17, 0xDD, 0x8E, 0x80, 0x24, 0x31, 0x01, 0x00, 0x67, 
+	0xB9, 0x03, 0x00, 0x49, 0x1D, 0xF9, 0x00, 0x84, 0x3E, 0x82, 0x85, 0x0D, 0x00, 0x82, 0x84, 0x10, 
+	0x58, 0x04, 0x01, 0x70, 0x0A, 0x40, 0x3B, 0x18, 0x62, 0x04, 0xD0, 0x00, 0x02, 0xF9, 0xF1, 0xF1, 
+	0x18, 0xF2, 0x00, 0x00, 0x08, 0x13, 0xFC, 0x6A, 0x80, 0x10, 0x15, 0x40, 0x01, 0x0F, 0xA3, 0x60, 
+	0x20, 0x05, 0x8E, 0x18, 0x02, 0x98, 0x02, 0x04, 0x7A, 0x39, 0x02, 0x01, 0x00, 0x52, 0x07, 0x00, 
+	0x20, 0x00, 0x14, 0xBF, 0x0A, 0x85, 0x30, 0x14, 0x20, 0x04, 0x00, 0x40, 0x07, 0xF0, 0x29, 0x18, 
+	0x0C, 0xC5, 0x08, 0x20, 0x19, 0x02, 0x69, 0x2F, 0x00, 0xD7, 0x00, 0x7F, 0x00, 0x40, 0x20, 0x80, 
+	0x00, 0x7C, 0xAD, 0xDC, 0x10, 0x09, 0x00, 0x5C, 0x19, 0x80, 0x10, 0x03, 0x84, 0x39, 0x00, 0x20, 
+	0x02, 0xC2, 0xFD, 0x0B, 0x07, 0x4F, 0x19, 0x03, 0x20, 0x00, 0x03, 0x01, 0x00, 0x11, 0x70, 0x6E, 
+	0x37, 0x8B, 0x02, 0x60, 0x28, 0x02, 0x00, 0x2C, 0x2F, 0xA0, 0x28, 0x12, 0x08, 0x9D, 0x12, 0x12, 
+	0x01, 0xA6, 0x00, 0x40, 0x00, 0x30, 0x00, 0x0C, 0xBC, 0x1F, 0x14, 0xB0, 0x78, 0x0D, 0x07, 0x3A, 
+	0x17, 0x05, 0x7C, 0x00, 0x00, 0xA6, 0x00, 0x50, 0x01, 0x66, 0x43, 0x00, 0xC0, 0xE6, 0x19, 0x07, 
+	0xF6, 0x3C, 0x13, 0x24, 0x2A, 0x10, 0x01, 0x01, 0x00, 0x30, 0x30, 0x5D, 0xF0, 0x5A, 0x03, 0x30, 
+	0xAA, 0x07, 0xCE, 0x94, 0x27, 0x47, 0x00, 0x00, 0x09, 0xB0, 0xF0, 0x0D, 0x01, 0x98, 0x05, 0x01, 
+	0x01, 0x00, 0x50, 0x04, 0x00, 0x01, 0x00, 0xFA, 0x58, 0x20, 0x42, 0x0A, 0x53, 0xFE, 0x47, 0x6B, 
+	0x24, 0x1B, 0x8A, 0x5E, 0x3A, 0x02, 0xD6, 0x00, 0x01, 0x5E, 0x05, 0xE4, 0x07, 0x00, 0x11, 0xC0, 
+	0x00, 0x20, 0x04, 0x02, 0x36, 0x80, 0x00, 0x40, 0x20, 0xDB, 0xA8, 0x38, 0x0A, 0x85, 0x29, 0x20, 
+	0x02, 0x80, 0x4F, 0x29, 0x00, 0x02, 0x1D, 0x30, 0x20, 0x00, 0x70, 0xF2, 0x0E, 0x20, 0x21, 0x4F, 
+	0xC5, 0x1B, 0x03, 0x01, 0x00, 0x0C, 0x29, 0x13, 0x12, 0x0C, 0x0B, 0x06, 0x01, 0xEB, 0x19, 0x31, 
+	0x01, 0x7C, 0x10, 0x9F, 0x13, 0x01, 0x98, 0x02, 0x0B, 0x60, 0x14, 0xA0, 0x01, 0x02, 0x00, 0x79, 
+	0xE0, 0x00, 0x00, 0x20, 0x83, 0x80, 0x31, 0x39, 0x4C, 0x17, 0xCF, 0xA5, 0x9C, 0xF9, 0x29, 0x05, 
+	0x57, 0x20, 0x00, 0x21, 0x0C, 0x0A, 0x29, 0x15, 0x03, 0xE2, 0x09, 0x03, 0x01, 0x00, 0x16, 0x0A, 
+	0x67, 0x09, 0x00, 0xBB, 0x01, 0x00, 0x53, 0x00, 0x03, 0x90, 0x0F, 0x10, 0x20, 0xA8, 0x0E, 0x26, 
+	0x03, 0xC3, 0x9F, 0x1B, 0x07, 0x3F, 0x05, 0x00, 0xDE, 0x03, 0x20, 0x03, 0x80, 0x5C, 0x00, 0x04, 
+	0x86, 0x10, 0x11, 0x02, 0x8A, 0x0C, 0x08, 0x30, 0x05, 0x03, 0xAB, 0x00, 0x10, 0x40, 0x1B, 0x32, 
+	0x21, 0x40, 0x05, 0x39, 0x36, 0x28, 0x00, 0x14, 0x9C, 0x03, 0x04, 0xC5, 0x0F, 0x05, 0x22, 0x0A, 
+	0x20, 0x28, 0x3B, 0x63, 0x00, 0x30, 0x12, 0x94, 0x0C, 0x8C, 0x19, 0x09, 0x5E, 0x3A, 0x0B, 0x01, 
+	0x00, 0x21, 0x01, 0x8B, 0x87, 0x1D, 0x22, 0x16, 0x80, 0xDD, 0x2E, 0x70, 0x62, 0x00, 0x3F, 0x72, 
+	0x00, 0x80, 0x11, 0xDA, 0x00, 0x1F, 0x01, 0xF5, 0x15, 0x26, 0x0F, 0x01, 0x00, 0xFF, 0xFF, 0xFF, 
+	0xBA, 0x3F, 0x82, 0x00, 0x80, 0x07, 0x04, 0xFF, 0xFF, 0xFF, 0xF4, 0x2F, 0x11, 0x01, 0x10, 0x08, 
+	0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0x04, 0x1F, 0x02, 0x10, 0x08, 0xFF, 0xFF, 0xFF, 
+	0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0x04, 0x1F, 0x03, 0x10, 0x08, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 
+	0xFF, 0xFF, 0x03, 0x60, 0x22, 0x8B, 0x30, 0x01, 0x06, 0x00, 
 };
 
 #ifdef __cplusplus
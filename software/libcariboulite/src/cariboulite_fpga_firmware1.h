@@ -4,8 +4,8 @@
  * as needed and embed in the code library.
  */
 
-#ifndef __cariboulite_fpga_firmware_h__
-#define __cariboulite_fpga_firmware_h__
+#ifndef __cariboulite_fpga_firmware1_h__
+#define __cariboulite_fpga_firmware1_h__
 
 #ifdef __cplusplus
 extern "C" {
@@ -17,2042 +17,910 @@ extern "C" {
 
 /*
  * Time tagging of the module through the 'struct tm' structure 
- *     Date: 2023-07-03
- *     Time: 12:09:44
+ *     Date: 2026-10-19
+ *     Time: 16:24:15
  */
 struct tm cariboulite_firmware_date_time = {
-   .tm_sec = 44,
-   .tm_min = 9,
-   .tm_hour = 12,
-   .tm_mday = 3,
-   .tm_mon = 6,   /* +1    */
-   .tm_year = 123,  /* +1900 */
+   .tm_sec = 15,
+   .tm_min = 24,
+   .tm_hour = 16,
+   .tm_mday = 19,
+   .tm_mon = 9,   /* +1    */
+   .tm_year = 126,  /* +1900 */
 };
 
 /*
- * Data blob of variable cariboulite_firmware:
- *     Size: 32220 bytes
+ * Data blob of variable cariboulite_firmware (compressed - LZ4 style sequences, 16 KB window):
+ *     Size: 14089 bytes (32220 bytes uncompressed)
  *     Original filename: ./top.bin
  */
+uint32_t cariboulite_firmware_raw_size = 32220;
 uint8_t cariboulite_firmware[] = {
-	0xFF, 0x00, 0x00, 0xFF, 0x7E, 0xAA, 0x99, 0x7E, 0x51, 0x00, 0x01, 0x05, 0x92, 0x00, 0x20, 0x62, 
-	0x01, 0x4B, 0x72, 0x00, 0x90, 0x82, 0x00, 0x00, 0x11, 0x00, 0x01, 0x01, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x10, 0x00, 0xC0, 0x00, 0x00, 0x00, 0x00, 0x40, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x34, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x08, 0x00, 0x00, 0x00, 0x00, 0x10, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x40, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x05, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x0C, 0x00, 0x00, 0x20, 0x00, 
-	0x00, 0x02, 0x30, 0x00, 0x00, 0x80, 0x08, 0x00, 0x01, 0xC0, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x0D, 0x00, 0x00, 0xC0, 0x00, 0x00, 0x00, 0x00, 0x00, 0x36, 0x00, 0x00, 0x00, 0x00, 
-	0x50, 0x20, 0xF8, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x04, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x10, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x40, 0x00, 0x00, 0x00, 0x00, 0x10, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x40, 0x00, 0x00, 0x00, 0x00, 0x0D, 0x06, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x04, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x10, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x40, 0x00, 0x00, 0x00, 0x00, 
-	0x30, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xC0, 0x00, 0x00, 0x00, 0x00, 0x0B, 0x83, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x80, 0x00, 0x00, 0x00, 0x34, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xB0, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0xD0, 0x00, 0x00, 0x00, 0x00, 0x00, 0x03, 0xC0, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x0F, 0x80, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x40, 0x00, 0x00, 0x04, 0x00, 0x00, 
-	0x01, 0x00, 0x0E, 0x00, 0x3C, 0x00, 0x00, 0x04, 0x00, 0x38, 0x00, 0x54, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x08, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x40, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x04, 0x00, 0x50, 0x00, 0x10, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x50, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x40, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x80, 0x00, 0x00, 0x00, 0x00, 0x00, 0x02, 0x00, 0x1E, 0x00, 0x00, 0x00, 0x00, 0x08, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x0F, 0x87, 0x9C, 0x01, 0x00, 0x00, 0x40, 
-	0x14, 0xEE, 0x40, 0x00, 0x00, 0x20, 0x00, 0x80, 0x00, 0x80, 0x01, 0x40, 0x00, 0x00, 0x24, 0x02, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x08, 0x00, 0x24, 0x03, 0x40, 0x00, 0x00, 0x40, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x13, 0x50, 0x80, 0x00, 0x00, 0x02, 0x20, 0x3D, 0xE4, 0x00, 0x00, 0x18, 0x00, 
-	0xF3, 0x24, 0x00, 0x00, 0x02, 0x00, 0x0B, 0x00, 0x01, 0x00, 0x00, 0x00, 0x0F, 0x00, 0x20, 0x00, 
-	0x00, 0x02, 0xE2, 0xA4, 0x0F, 0xF0, 0x00, 0x00, 0x00, 0x38, 0x00, 0x00, 0x10, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x40, 0x00, 0x00, 0x03, 0x80, 0x07, 0x00, 0xD8, 0x41, 0xE0, 0x01, 0x42, 0x80, 
-	0x10, 0x24, 0x03, 0x80, 0x00, 0x00, 0x78, 0x50, 0x80, 0x12, 0x00, 0x00, 0x66, 0x00, 0x81, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x09, 0x08, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x28, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0xF0, 0x05, 0xA0, 0x00, 0x00, 0x02, 0x6C, 0x09, 0x00, 0x10, 0x00, 0x00, 0xB0, 0x0B, 
-	0xB8, 0x60, 0x00, 0x22, 0x01, 0xC3, 0xAC, 0xF4, 0x20, 0x00, 0x00, 0x00, 0x10, 0x00, 0x00, 0x08, 
-	0x2A, 0x81, 0x00, 0x00, 0x01, 0xE0, 0x40, 0x00, 0x00, 0x03, 0x00, 0x83, 0x80, 0x00, 0x00, 0x00, 
-	0x00, 0x02, 0x80, 0x00, 0x00, 0x01, 0x00, 0x40, 0x1E, 0x00, 0x00, 0x00, 0x00, 0x01, 0x3C, 0x01, 
-	0x58, 0x40, 0x40, 0x00, 0x00, 0x02, 0x00, 0x00, 0x09, 0x94, 0x14, 0x00, 0x00, 0x00, 0x02, 0x28, 
-	0x00, 0x00, 0x00, 0x30, 0x00, 0x00, 0xE5, 0x00, 0x00, 0x00, 0x00, 0x40, 0x00, 0x00, 0x00, 0x30, 
-	0x02, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x03, 0xC2, 0x83, 0xD4, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x03, 0x0F, 0x9A, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x06, 0x00, 0x04, 0x00, 0x03, 0x80, 0x00, 0x07, 0x04, 0x10, 0x00, 
-	0x00, 0x04, 0x03, 0x59, 0x0C, 0x00, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x0E, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xF0, 0x0D, 0x00, 0x00, 0x00, 0x00, 0x00, 0x20, 
-	0x04, 0x00, 0x40, 0x00, 0x00, 0x00, 0x40, 0x00, 0x04, 0x00, 0x00, 0x03, 0xBC, 0xBC, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x10, 0x2A, 0x81, 0x04, 0x00, 0x02, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x0E, 0x80, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x0A, 0x00, 
-	0x00, 0x00, 0x00, 0x01, 0x1E, 0x28, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x08, 0xB4, 
-	0x14, 0x00, 0x00, 0x00, 0x2C, 0x24, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xB1, 0x00, 0x00, 0x00, 
-	0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xA0, 0x02, 0x40, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x10, 0x00, 0x00, 0x00, 0x00, 0x14, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x08, 0x00, 0xB0, 0x02, 0x00, 0x00, 0x00, 0x00, 0x00, 0x26, 0x00, 0x00, 
-	0x55, 0x80, 0x00, 0x00, 0x00, 0x00, 0x00, 0x06, 0x38, 0x09, 0x5B, 0x60, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x0C, 0x00, 0x00, 0x00, 0x00, 0x00, 0x80, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xB0, 0x07, 
-	0x80, 0x00, 0x00, 0x00, 0x00, 0x08, 0x00, 0x00, 0x00, 0x02, 0x00, 0xA0, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x06, 0xAD, 0xCA, 0x70, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x0D, 0x02, 0x95, 0x00, 0x04, 
-	0x00, 0x00, 0x24, 0x08, 0x10, 0x04, 0x00, 0x00, 0x1E, 0x80, 0x00, 0x00, 0x00, 0x00, 0x06, 0x00, 
-	0x06, 0x00, 0x00, 0x00, 0x0D, 0x00, 0x00, 0x00, 0x00, 0x00, 0x20, 0x72, 0xCE, 0xDA, 0x00, 0x40, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0xB8, 0x00, 0x00, 0x00, 0x00, 0x34, 0x3A, 0x4A, 0xDB, 0x00, 0x00, 
-	0x00, 0x00, 0x0F, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x04, 0x00, 0x00, 0x00, 0x01, 0xA0, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x42, 0x2C, 0xFE, 0x20, 0x00, 0x00, 0x00, 0x30, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x04, 0xCA, 0x00, 0x01, 0x00, 0x00, 0x1C, 0x00, 0x00, 0x0A, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x01, 0x00, 0x20, 0x1C, 0x18, 0x56, 0x88, 0x00, 0x00, 0x00, 0x01, 0x60, 
-	0x24, 0x41, 0x00, 0x00, 0x00, 0x00, 0x0F, 0x00, 0x00, 0x00, 0x00, 0x00, 0x0E, 0x00, 0x01, 0xE0, 
-	0xFA, 0x00, 0x30, 0x00, 0x71, 0x0B, 0x00, 0x00, 0x40, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x05, 
-	0x50, 0x0F, 0x31, 0xF8, 0x00, 0x00, 0x00, 0x02, 0x44, 0xB0, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x80, 0x1B, 0x82, 0x95, 0x00, 0x00, 0x00, 0x00, 0x0F, 0x8E, 0x20, 0x00, 0x04, 0x00, 0x08, 0x80, 
-	0x00, 0x00, 0x01, 0xE0, 0x00, 0x00, 0x00, 0x02, 0x00, 0x00, 0x00, 0x00, 0x00, 0x90, 0x00, 0x4C, 
-	0x00, 0x68, 0x60, 0x00, 0x80, 0x00, 0x00, 0x00, 0x00, 0x01, 0x0E, 0xD8, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x2D, 0xE2, 0x00, 0x00, 0x00, 0x00, 0x01, 0x28, 0x00, 0x00, 0x02, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x34, 0x00, 0x81, 0x0A, 0x00, 0x00, 0x00, 0x00, 0x00, 0x20, 0x00, 
-	0x00, 0x38, 0x00, 0x00, 0x10, 0x00, 0x00, 0x00, 0xEA, 0x01, 0x42, 0xC0, 0x00, 0x00, 0x03, 0x84, 
-	0x00, 0x48, 0x30, 0x41, 0xE0, 0x00, 0x00, 0x16, 0x06, 0x64, 0x03, 0xA0, 0x01, 0x80, 0x07, 0x84, 
-	0x10, 0x00, 0x00, 0x16, 0x68, 0x1B, 0x33, 0xA0, 0x00, 0x00, 0x00, 0x00, 0x00, 0x08, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x02, 0x68, 0x00, 0x00, 0x00, 0x20, 0x00, 0x91, 0x09, 0x38, 0x08, 0x00, 0x00, 
-	0x00, 0x2B, 0x66, 0x00, 0x01, 0x38, 0x00, 0x00, 0x00, 0x00, 0x84, 0x00, 0x00, 0x00, 0x00, 0xBC, 
-	0xC0, 0x00, 0x00, 0x00, 0x10, 0x00, 0x00, 0x0F, 0x07, 0x9C, 0x00, 0x40, 0x00, 0x00, 0x27, 0xCA, 
-	0x50, 0x03, 0x00, 0x01, 0x00, 0x00, 0x00, 0xC0, 0x01, 0xE0, 0x00, 0x00, 0x00, 0x03, 0x00, 0x00, 
-	0x00, 0x07, 0x04, 0x10, 0x00, 0x80, 0x36, 0x05, 0x48, 0x33, 0x80, 0x00, 0x00, 0x02, 0x00, 0x00, 
-	0x00, 0x72, 0xE0, 0x40, 0x10, 0x00, 0x00, 0x02, 0x70, 0xAA, 0x00, 0x30, 0x00, 0x08, 0x07, 0x00, 
-	0x04, 0x00, 0x00, 0x3C, 0x00, 0x00, 0x00, 0x30, 0x02, 0x00, 0x00, 0x40, 0x00, 0x04, 0x00, 0x21, 
-	0x42, 0x80, 0x0C, 0xC0, 0x10, 0x00, 0x02, 0x00, 0x00, 0x01, 0x81, 0x86, 0x05, 0x00, 0x00, 0x00, 
-	0x60, 0x2C, 0x0A, 0x54, 0x00, 0x00, 0x27, 0x88, 0x00, 0x00, 0x00, 0x00, 0x43, 0x80, 0x00, 0x04, 
-	0x00, 0x00, 0x00, 0x01, 0x00, 0x00, 0x10, 0x00, 0x00, 0x16, 0x04, 0x08, 0x33, 0x80, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x0B, 0x60, 0x40, 0x10, 0x00, 0x00, 0x2E, 0x40, 0x00, 0x01, 0x00, 0x05, 
-	0x08, 0x83, 0x00, 0x00, 0x00, 0x00, 0x60, 0x40, 0x08, 0x00, 0x00, 0x00, 0x00, 0xFB, 0x00, 0x20, 
-	0x05, 0x00, 0xE0, 0x02, 0x80, 0x9C, 0xC0, 0x04, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x02, 0x00, 0x37, 0xCA, 0x50, 0x00, 0x00, 0x19, 0x00, 0x80, 0x00, 0x08, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x08, 0x00, 0x1B, 0x58, 0x00, 0x10, 0x00, 0x00, 0x00, 0x00, 0x68, 0x33, 
-	0x80, 0x00, 0x00, 0x20, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x2C, 0x2C, 0xF0, 0xAA, 
-	0x20, 0x00, 0x29, 0x90, 0x0D, 0x00, 0x00, 0x0A, 0x01, 0x38, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0xA0, 0x80, 0x10, 0x00, 0x00, 0x00, 0x00, 0x02, 0x0C, 0xC0, 0x04, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x80, 0x00, 0x00, 0x00, 0x00, 0x02, 0x02, 0x00, 0xDC, 0x04, 0x00, 0x00, 0x00, 0x00, 0xD8, 0x00, 
-	0x00, 0x00, 0x00, 0x20, 0x00, 0x04, 0x00, 0x00, 0x08, 0x1A, 0x00, 0x4F, 0x10, 0x00, 0x00, 0x00, 
-	0x01, 0x48, 0x33, 0x80, 0x40, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x24, 
-	0x00, 0x0B, 0xC0, 0x01, 0x00, 0x00, 0x70, 0x09, 0x02, 0x00, 0x00, 0x00, 0x03, 0x40, 0x08, 0x00, 
-	0x00, 0x00, 0x50, 0x00, 0x20, 0xF0, 0x80, 0x00, 0x00, 0x00, 0x00, 0x0C, 0xC0, 0x00, 0x00, 0x00, 
-	0x00, 0x10, 0x00, 0x00, 0x72, 0x81, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x10, 0x01, 
-	0x1C, 0x80, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x04, 0x00, 0x00, 0x05, 0x8E, 0x00, 0x00, 0x10, 
-	0x40, 0x01, 0x00, 0x60, 0x08, 0x33, 0x80, 0x40, 0x00, 0x00, 0x00, 0x05, 0x00, 0x14, 0x14, 0x00, 
-	0x00, 0x00, 0x34, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x09, 0x0F, 0x00, 0x00, 0x00, 0x00, 0x01, 
-	0x40, 0x08, 0x00, 0x00, 0x00, 0x01, 0x07, 0x00, 0x20, 0x02, 0x04, 0x00, 0x04, 0x00, 0xFC, 0xC0, 
-	0x00, 0x00, 0x00, 0x30, 0x00, 0x70, 0x01, 0x06, 0x05, 0x00, 0x40, 0x00, 0x00, 0x21, 0xAE, 0x20, 
-	0x07, 0x00, 0x00, 0x08, 0x80, 0x00, 0x40, 0x00, 0x00, 0x16, 0x00, 0x04, 0x01, 0x00, 0x05, 0x80, 
-	0x38, 0x00, 0x10, 0x00, 0x00, 0x00, 0x00, 0x08, 0x33, 0x80, 0x00, 0x00, 0x00, 0x00, 0x00, 0x80, 
-	0x0B, 0x60, 0x40, 0x08, 0x00, 0x00, 0x02, 0xCE, 0xD1, 0x00, 0x10, 0x00, 0x11, 0x0D, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x04, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x10, 0x84, 0x00, 0x00, 0x00, 
-	0x00, 0xBC, 0xC0, 0x04, 0x00, 0x00, 0x00, 0x00, 0x00, 0x10, 0x2A, 0x81, 0x00, 0x00, 0x04, 0x62, 
-	0xA0, 0x08, 0x14, 0x01, 0x00, 0x00, 0x0F, 0x80, 0x00, 0x80, 0x00, 0x00, 0x06, 0x00, 0x04, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x10, 0x08, 0x40, 0x00, 0x01, 0x68, 0x33, 0x80, 0x00, 0x00, 0x00, 
-	0x00, 0x07, 0x08, 0x14, 0x14, 0x00, 0x00, 0x00, 0x00, 0x01, 0x4C, 0x42, 0x00, 0x08, 0x00, 0x00, 
-	0xF1, 0x34, 0x00, 0x00, 0x00, 0x00, 0x00, 0x04, 0x20, 0x00, 0x00, 0x00, 0x07, 0x00, 0x20, 0x80, 
-	0x02, 0x00, 0x00, 0x00, 0x0C, 0xC0, 0x48, 0x00, 0x00, 0x38, 0x00, 0x00, 0x07, 0xB6, 0x8C, 0x01, 
-	0xE0, 0x00, 0x00, 0x16, 0xEA, 0x04, 0x03, 0x80, 0x08, 0x00, 0x78, 0x40, 0xE0, 0x11, 0xC0, 0x00, 
-	0x00, 0x00, 0x03, 0x80, 0x00, 0x00, 0x78, 0x00, 0x18, 0x06, 0x00, 0x00, 0x02, 0x08, 0x33, 0x20, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x0F, 0xA8, 0xC0, 0x00, 0x00, 0x00, 0x00, 0x00, 0xA0, 0x08, 
-	0x00, 0x00, 0xB0, 0x0B, 0xB2, 0x00, 0x00, 0x82, 0x00, 0x00, 0x00, 0x00, 0x20, 0x00, 0x50, 0x00, 
-	0x00, 0x10, 0x82, 0x80, 0x00, 0x03, 0xBC, 0x0C, 0xC0, 0x00, 0x00, 0x00, 0x10, 0x00, 0x00, 0xA0, 
-	0x2A, 0x81, 0x00, 0x50, 0x03, 0xC0, 0x00, 0x18, 0x14, 0x85, 0x00, 0x00, 0x00, 0x80, 0x00, 0x00, 
-	0x02, 0x00, 0x41, 0xC1, 0x06, 0x00, 0x00, 0x20, 0x00, 0x07, 0x84, 0x10, 0x0C, 0x00, 0x00, 0x00, 
-	0xE0, 0x00, 0x40, 0x00, 0x00, 0x02, 0x00, 0x00, 0x08, 0xD4, 0x14, 0x00, 0x00, 0x00, 0x04, 0x01, 
-	0x4A, 0x42, 0x00, 0x18, 0x00, 0x00, 0x07, 0x00, 0x00, 0x00, 0x2C, 0x24, 0x10, 0x00, 0x00, 0x02, 
-	0x00, 0x00, 0x00, 0x40, 0x00, 0x80, 0xC0, 0x00, 0x00, 0x02, 0x00, 0x40, 0x00, 0x00, 0x02, 0x00, 
-	0x00, 0x00, 0x01, 0x02, 0x95, 0x00, 0x00, 0x01, 0xC3, 0x97, 0xAA, 0x04, 0x00, 0x00, 0x17, 0x9C, 
-	0x00, 0x00, 0x08, 0x00, 0x00, 0x00, 0x00, 0x24, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x14, 0x00, 
-	0x00, 0x00, 0x28, 0x00, 0x02, 0x40, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xD8, 0x00, 0x02, 0x00, 
-	0x00, 0x00, 0x00, 0x10, 0xA0, 0x01, 0x08, 0x00, 0x79, 0x03, 0x00, 0x00, 0x00, 0x00, 0x00, 0x0A, 
-	0x00, 0x20, 0x80, 0x00, 0x00, 0x0B, 0x00, 0x20, 0x00, 0x00, 0x00, 0x42, 0x80, 0xF0, 0x00, 0x00, 
-	0x00, 0x00, 0x02, 0x80, 0x80, 0x15, 0x02, 0x95, 0x00, 0x00, 0x00, 0x00, 0x20, 0xAA, 0x04, 0x00, 
-	0x00, 0x0F, 0x0F, 0x00, 0x00, 0x00, 0x00, 0xE0, 0x54, 0x1C, 0x30, 0x00, 0x00, 0x00, 0x0A, 0x00, 
-	0x00, 0x90, 0x00, 0x00, 0x00, 0x00, 0x01, 0x18, 0x00, 0x00, 0x00, 0x20, 0x00, 0x01, 0x0E, 0x38, 
-	0x00, 0x00, 0x00, 0x00, 0x1C, 0x01, 0x40, 0x50, 0x08, 0x08, 0x00, 0x90, 0xCF, 0x00, 0x00, 0x00, 
-	0x02, 0x22, 0xED, 0x3C, 0x00, 0x00, 0x00, 0x00, 0xA0, 0x34, 0x00, 0x80, 0x00, 0xA0, 0x02, 0xAC, 
-	0x92, 0x40, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x06, 0x05, 0x04, 0x00, 0x02, 0x00, 0x01, 
-	0xAA, 0x04, 0x08, 0x00, 0x07, 0x00, 0xB0, 0x00, 0x00, 0x00, 0x02, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x0A, 0x80, 0x00, 0x10, 0x00, 0x0E, 0x80, 0x79, 0x61, 0x66, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0xD3, 0x90, 0x80, 0x00, 0x00, 0x04, 0x02, 0x40, 0x50, 0x00, 0x08, 0x00, 0x00, 0x05, 
-	0x02, 0x00, 0x00, 0x00, 0x20, 0x00, 0x00, 0x00, 0x00, 0x00, 0x50, 0x0B, 0x00, 0x20, 0x00, 0x00, 
-	0x04, 0x02, 0x42, 0xB6, 0x60, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x40, 0x04, 0x18, 0x14, 0x00, 0x00, 0x00, 0x1C, 0x80, 0x00, 0x00, 0x00, 0x00, 0x00, 0xC1, 
-	0x04, 0x00, 0x28, 0x05, 0x00, 0x80, 0x00, 0x18, 0x00, 0x00, 0x00, 0x22, 0x00, 0x00, 0x41, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x0A, 0x81, 0x00, 0x08, 
-	0x10, 0x01, 0x0D, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xC0, 0x00, 0x00, 0x03, 0x00, 
-	0x20, 0x00, 0x00, 0x00, 0x02, 0x3C, 0x00, 0x80, 0x00, 0x00, 0x00, 0x30, 0x00, 0x80, 0x80, 0x00, 
-	0x00, 0x00, 0x40, 0x00, 0x00, 0x17, 0xCA, 0x04, 0x01, 0x03, 0x03, 0x8A, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0x80, 0x18, 0x00, 0x10, 0x04, 0xA0, 0x00, 0x7C, 0x1C, 
-	0x10, 0x41, 0x00, 0x00, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 0x00, 0x08, 0x00, 0x00, 0x00, 0x00, 
-	0xA0, 0x00, 0x38, 0x00, 0x01, 0x09, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0xA0, 0x00, 0x10, 0x02, 0x04, 0x00, 0x07, 0x01, 0x00, 0x00, 0x00, 0x00, 0x80, 0x10, 0x00, 
-	0xD1, 0x81, 0x82, 0x95, 0x00, 0xC4, 0x08, 0x00, 0x00, 0x00, 0x26, 0x00, 0x04, 0x60, 0x00, 0x00, 
-	0x00, 0x4C, 0x06, 0x02, 0x80, 0x00, 0x00, 0x03, 0x02, 0x87, 0x1D, 0x90, 0x00, 0x00, 0x0C, 0x0C, 
-	0xB6, 0x00, 0x00, 0x66, 0x00, 0x00, 0x08, 0x00, 0x80, 0x01, 0x80, 0x30, 0x00, 0x00, 0x02, 0xA1, 
-	0x00, 0x00, 0x0A, 0x00, 0x00, 0x40, 0x17, 0x00, 0x93, 0x28, 0x02, 0x0A, 0x3C, 0x00, 0x00, 0x00, 
-	0x00, 0x08, 0x00, 0x08, 0xD1, 0x03, 0xFC, 0x00, 0x20, 0x12, 0x40, 0x34, 0x89, 0x90, 0x00, 0x00, 
-	0x80, 0x38, 0x00, 0x98, 0x01, 0x02, 0x94, 0x00, 0xE0, 0x00, 0x03, 0x81, 0xA1, 0x05, 0x07, 0x84, 
-	0x00, 0x00, 0x58, 0x41, 0xE0, 0x00, 0x00, 0x4C, 0x0A, 0x54, 0x01, 0x80, 0x08, 0x00, 0x32, 0x25, 
-	0x80, 0x0E, 0x00, 0x14, 0x01, 0xE0, 0x66, 0x40, 0x00, 0x08, 0x00, 0x00, 0x01, 0x00, 0x12, 0xE6, 
-	0x48, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x20, 0x00, 0x70, 0x05, 0xB4, 0x00, 0x00, 0x14, 
-	0x39, 0xE0, 0x00, 0x10, 0x20, 0x00, 0xB0, 0x00, 0x66, 0x58, 0x00, 0x00, 0x00, 0x00, 0x02, 0xA6, 
-	0x60, 0x00, 0x00, 0x80, 0x10, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0xC2, 0x81, 0xDB, 
-	0x10, 0x01, 0x00, 0x01, 0x1E, 0x80, 0x00, 0x42, 0x08, 0x00, 0x20, 0x06, 0x60, 0x03, 0x10, 0xA8, 
-	0x00, 0x06, 0x84, 0x10, 0x1C, 0x00, 0x0E, 0x78, 0x1C, 0x55, 0x40, 0x00, 0x08, 0x00, 0x80, 0x00, 
-	0x0E, 0x00, 0x00, 0x00, 0x02, 0x0A, 0x74, 0x03, 0x4F, 0x72, 0x00, 0x70, 0x08, 0x11, 0x83, 0x00, 
-	0x02, 0x47, 0x40, 0x02, 0x48, 0x99, 0x20, 0x18, 0x00, 0xF0, 0x00, 0x40, 0x00, 0x00, 0x60, 0x01, 
-	0x67, 0x1D, 0x0A, 0xA0, 0x00, 0x00, 0x82, 0x00, 0x00, 0x00, 0x03, 0x02, 0x05, 0x00, 0x00, 0x01, 
-	0xC7, 0x40, 0x00, 0x00, 0x00, 0x00, 0x07, 0x9C, 0x00, 0x00, 0x00, 0x00, 0xE7, 0x81, 0xAA, 0x06, 
-	0x04, 0x00, 0x07, 0x81, 0x00, 0x00, 0x00, 0x00, 0x00, 0x20, 0x70, 0x40, 0x00, 0x40, 0x00, 0x08, 
-	0x00, 0x80, 0x00, 0x00, 0x03, 0xE0, 0x40, 0x02, 0x00, 0x00, 0x74, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x9D, 0x00, 0x02, 0x00, 0x02, 0x21, 0xD0, 0x50, 0x00, 0x08, 0x00, 0xD8, 0xF0, 0x00, 0x00, 
-	0x00, 0x20, 0x02, 0xC4, 0x00, 0x00, 0x40, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0x02, 0x95, 
-	0x00, 0x00, 0x0C, 0x00, 0x00, 0x00, 0x00, 0x00, 0x28, 0x80, 0x1E, 0x00, 0x00, 0x00, 0x04, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x10, 0x28, 0x00, 0x58, 0x16, 0x88, 0x00, 0x00, 0x00, 0x00, 0x01, 0x02, 
-	0x40, 0x00, 0x00, 0x20, 0x80, 0x01, 0x00, 0x38, 0x00, 0x00, 0x02, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x10, 0x09, 0x00, 0x02, 0x0A, 0x40, 0x3C, 0x00, 0x00, 0x00, 0x0A, 0x80, 0x90, 
-	0xA0, 0x01, 0x68, 0x00, 0x28, 0x00, 0x02, 0x80, 0xC0, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 
-	0x88, 0x32, 0x81, 0x00, 0x00, 0x00, 0x60, 0x00, 0x10, 0x25, 0x04, 0x00, 0x00, 0x08, 0x58, 0x02, 
-	0x00, 0x01, 0xC0, 0x0F, 0x90, 0xC0, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x40, 0x00, 
-	0x21, 0x5A, 0x48, 0x00, 0x00, 0x00, 0x00, 0x81, 0x80, 0x00, 0xB0, 0x14, 0x08, 0x02, 0x00, 0x02, 
-	0x00, 0x09, 0x00, 0x00, 0x00, 0x00, 0x10, 0x0B, 0x00, 0x02, 0x00, 0x02, 0x22, 0x6B, 0x03, 0x20, 
-	0x08, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x22, 0x03, 0xC0, 0x05, 0xB2, 0x10, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x80, 0x02, 0x05, 0x00, 0x00, 0x00, 0x07, 0x34, 0x0E, 0x70, 0x00, 0x30, 0x50, 
-	0x00, 0x80, 0x00, 0x00, 0x0A, 0x00, 0x0F, 0xFE, 0x40, 0x00, 0x02, 0x80, 0x00, 0x50, 0x00, 0x10, 
-	0x00, 0x00, 0x04, 0x00, 0xFA, 0x55, 0x40, 0x00, 0x00, 0x00, 0x80, 0x00, 0x1A, 0xF3, 0x10, 0x80, 
-	0x02, 0x08, 0x00, 0x43, 0xCF, 0x81, 0x00, 0x00, 0x00, 0x00, 0x0F, 0x00, 0x02, 0x00, 0x1C, 0x00, 
-	0x1A, 0xE4, 0x00, 0x48, 0x00, 0x00, 0x00, 0x00, 0x10, 0x04, 0x20, 0x04, 0x00, 0x02, 0x05, 0x50, 
-	0x00, 0x00, 0x00, 0x10, 0x00, 0x00, 0x03, 0x62, 0x81, 0x00, 0x00, 0x00, 0x02, 0x37, 0xEA, 0x50, 
-	0x01, 0x00, 0x00, 0x08, 0x80, 0x00, 0x40, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0x00, 0x20, 0x00, 
-	0x06, 0x84, 0x10, 0x04, 0x00, 0x00, 0x20, 0x01, 0x02, 0x40, 0x00, 0x00, 0x02, 0x80, 0x00, 0x00, 
-	0x00, 0x28, 0x00, 0x02, 0x00, 0x00, 0x43, 0x70, 0x55, 0x00, 0x10, 0x00, 0x00, 0x0D, 0x00, 0x0A, 
-	0x00, 0x00, 0x20, 0x00, 0x00, 0x00, 0x08, 0x25, 0x00, 0x00, 0x00, 0x00, 0x01, 0x20, 0x00, 0x00, 
-	0x00, 0x80, 0x00, 0x00, 0x40, 0x80, 0x10, 0x00, 0x80, 0xA8, 0x02, 0x05, 0x00, 0x44, 0x08, 0x00, 
-	0x0E, 0x08, 0x14, 0x01, 0x50, 0x4F, 0x0F, 0x80, 0x00, 0xC8, 0x04, 0x00, 0x00, 0x00, 0x00, 0x03, 
-	0x00, 0x03, 0x80, 0x00, 0x00, 0x00, 0x0C, 0x00, 0x1C, 0x20, 0x60, 0x5A, 0x40, 0x00, 0x08, 0x20, 
-	0x80, 0x01, 0x08, 0x12, 0x50, 0x80, 0x02, 0x20, 0x00, 0x00, 0x0C, 0x81, 0x08, 0x0A, 0x82, 0xB0, 
-	0xE3, 0x2C, 0x02, 0x04, 0x00, 0x00, 0x00, 0x00, 0x00, 0x08, 0x02, 0x08, 0x00, 0x00, 0x00, 0x00, 
-	0x20, 0x00, 0x24, 0x02, 0x05, 0xA0, 0x00, 0x00, 0x80, 0x38, 0x00, 0x00, 0xB1, 0xA2, 0x81, 0x00, 
-	0xE0, 0x00, 0x03, 0x4E, 0x18, 0x14, 0x03, 0xC0, 0x2F, 0x00, 0x38, 0x40, 0xE0, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x01, 0x80, 0x08, 0x00, 0x00, 0x00, 0x00, 0x0E, 0x00, 0x00, 0x78, 0xED, 0x03, 0x00, 
-	0x08, 0x08, 0x00, 0x00, 0x0D, 0x08, 0x0C, 0x28, 0x00, 0x00, 0x00, 0x00, 0x74, 0x2C, 0x81, 0x00, 
-	0x00, 0x05, 0xF0, 0x09, 0xA0, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x20, 0x00, 0xB0, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x04, 0x04, 0x90, 0x20, 0x00, 0x48, 0x80, 0x10, 0x00, 0x00, 0x05, 
-	0xBE, 0x8C, 0x00, 0x40, 0x00, 0x00, 0x17, 0xCA, 0x04, 0x01, 0x40, 0x30, 0x1E, 0x00, 0x00, 0x00, 
-	0x60, 0x06, 0x80, 0x00, 0x00, 0x00, 0x02, 0x41, 0x00, 0x00, 0x00, 0x00, 0x04, 0x00, 0x00, 0x71, 
-	0xE0, 0x00, 0x00, 0x00, 0xC8, 0x02, 0x80, 0x0D, 0x0B, 0x0E, 0xE8, 0xC8, 0x02, 0x00, 0x34, 0x00, 
-	0x00, 0xA0, 0x00, 0x18, 0x18, 0x00, 0x01, 0x00, 0x02, 0x0A, 0x00, 0x40, 0x00, 0x00, 0x00, 0x08, 
-	0x82, 0x00, 0x00, 0x00, 0x00, 0x00, 0xE0, 0x80, 0x04, 0x00, 0x00, 0x40, 0x00, 0x00, 0x87, 0x00, 
-	0x00, 0x00, 0xA1, 0x06, 0x04, 0x00, 0x00, 0x02, 0x00, 0x3C, 0x0A, 0x56, 0x00, 0x00, 0x07, 0x9E, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x03, 0x80, 0x76, 0x88, 0x48, 0x00, 
-	0x00, 0x00, 0x04, 0x00, 0x99, 0x00, 0x01, 0x0A, 0x00, 0x80, 0x05, 0x1A, 0xF2, 0x79, 0xC0, 0x12, 
-	0x00, 0x04, 0x00, 0xC0, 0x00, 0x00, 0x08, 0x00, 0x00, 0x01, 0x00, 0x02, 0x00, 0x3C, 0x00, 0x00, 
-	0x00, 0x00, 0x08, 0x00, 0xB8, 0x01, 0x3A, 0x10, 0x00, 0x20, 0x00, 0x02, 0xA4, 0xE6, 0x60, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x80, 0x1D, 0xBA, 0x94, 0x04, 0x00, 0x02, 0x00, 0x0E, 0x18, 0x14, 0x00, 
-	0x00, 0x40, 0x00, 0x80, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x20, 0x00, 0x58, 
-	0x00, 0x00, 0x00, 0x20, 0xA0, 0x68, 0x00, 0x00, 0x00, 0x00, 0x00, 0x20, 0x82, 0x87, 0x0A, 0x14, 
-	0x2A, 0x80, 0x02, 0x00, 0x2C, 0x00, 0x09, 0x81, 0x00, 0x08, 0x02, 0x00, 0x0D, 0x00, 0x02, 0x08, 
-	0x04, 0x00, 0x00, 0x00, 0x00, 0x0A, 0x80, 0x00, 0x00, 0x00, 0x10, 0x00, 0x20, 0x10, 0x43, 0x80, 
-	0x00, 0x00, 0x00, 0x4C, 0x00, 0x00, 0x00, 0x00, 0x00, 0x33, 0x90, 0x01, 0x00, 0x01, 0xC0, 0x7C, 
-	0x0A, 0x54, 0x00, 0x00, 0x28, 0x0F, 0xD8, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x40, 
-	0x00, 0x00, 0x80, 0x16, 0x80, 0x00, 0x00, 0x20, 0x04, 0xFC, 0x2D, 0x00, 0x00, 0x80, 0x00, 0x80, 
-	0x00, 0x00, 0x57, 0xF6, 0x00, 0x02, 0x00, 0x00, 0x24, 0xE0, 0x00, 0x00, 0x08, 0x04, 0xB0, 0x97, 
-	0x00, 0x02, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x08, 0x00, 0x00, 0x05, 0x02, 0x94, 0x02, 0x20, 
-	0x02, 0xC3, 0x1D, 0x8B, 0x40, 0x00, 0x00, 0x04, 0x04, 0x10, 0x00, 0x00, 0x02, 0x05, 0x00, 0x02, 
-	0x00, 0x66, 0x21, 0xCA, 0x04, 0x08, 0x00, 0x73, 0x80, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x04, 0x04, 0x00, 0x15, 0x80, 0x77, 0x95, 0x50, 0x50, 0x0A, 0x20, 0x00, 0x00, 0x00, 0x00, 0x08, 
+	0xFF, 0x0E, 0xFF, 0x00, 0x00, 0xFF, 0x7E, 0xAA, 0x99, 0x7E, 0x51, 0x00, 0x01, 0x05, 0x92, 0x00, 
+	0x20, 0x62, 0x01, 0x4B, 0x72, 0x00, 0x90, 0x82, 0x00, 0x00, 0x11, 0x00, 0x01, 0x01, 0x00, 0x01, 
+	0x00, 0x08, 0x30, 0x10, 0x00, 0xC0, 0x07, 0x00, 0x1F, 0x40, 0x24, 0x00, 0x09, 0x03, 0x01, 0x00, 
+	0x1F, 0x34, 0x23, 0x00, 0x0F, 0x10, 0x08, 0x05, 0x00, 0x12, 0x10, 0x0C, 0x00, 0x0F, 0x53, 0x00, 
+	0x0A, 0x1F, 0x05, 0x4C, 0x00, 0x0F, 0x05, 0x01, 0x00, 0xE1, 0x0C, 0x00, 0x00, 0x20, 0x00, 0x00, 
+	0x02, 0x30, 0x00, 0x00, 0x80, 0x08, 0x00, 0x01, 0xAF, 0x00, 0x0F, 0x01, 0x00, 0x01, 0x22, 0x0D, 
+	0x00, 0xCB, 0x00, 0x20, 0x00, 0x36, 0x05, 0x00, 0x33, 0x50, 0x20, 0xF8, 0x18, 0x00, 0x12, 0x04, 
+	0x07, 0x00, 0x08, 0x96, 0x00, 0x08, 0x0C, 0x00, 0x2F, 0x0D, 0x06, 0x7C, 0x00, 0x09, 0x0F, 0x01, 
+	0x00, 0x03, 0x0F, 0x53, 0x00, 0x00, 0x12, 0x30, 0x0C, 0x00, 0x01, 0x82, 0x00, 0x2F, 0x0B, 0x83, 
+	0x3E, 0x00, 0x0A, 0x16, 0x80, 0x4C, 0x01, 0x1F, 0xB0, 0x29, 0x00, 0x0A, 0x11, 0xD0, 0x06, 0x00, 
+	0x12, 0x03, 0xD6, 0x00, 0x10, 0x0F, 0x37, 0x00, 0x0F, 0x01, 0x00, 0x01, 0x11, 0x40, 0x90, 0x00, 
+	0x50, 0x01, 0x00, 0x0E, 0x00, 0x3C, 0x0A, 0x00, 0x3F, 0x38, 0x00, 0x54, 0x55, 0x00, 0x0A, 0x05, 
+	0x01, 0x00, 0x01, 0xAC, 0x01, 0x0F, 0x53, 0x00, 0x06, 0x10, 0x00, 0x53, 0x00, 0x01, 0x01, 0x00, 
+	0x34, 0x04, 0x00, 0x50, 0xEA, 0x00, 0x0F, 0x01, 0x00, 0x00, 0x1F, 0x50, 0x33, 0x00, 0x01, 0x0F, 
+	0x01, 0x00, 0x00, 0x02, 0xBE, 0x00, 0x30, 0x02, 0x00, 0x1E, 0x07, 0x00, 0x08, 0x7B, 0x00, 0xA0, 
+	0x0F, 0x87, 0x9C, 0x01, 0x00, 0x00, 0x40, 0x14, 0xEE, 0x40, 0xE7, 0x01, 0x92, 0x80, 0x00, 0x80, 
+	0x01, 0x40, 0x00, 0x00, 0x24, 0x02, 0x1D, 0x00, 0x54, 0x08, 0x00, 0x24, 0x03, 0x40, 0x5D, 0x00, 
+	0xF0, 0x00, 0x13, 0x50, 0x80, 0x00, 0x00, 0x02, 0x20, 0x3D, 0xE4, 0x00, 0x00, 0x18, 0x00, 0xF3, 
+	0x24, 0x4E, 0x00, 0x11, 0x0B, 0x72, 0x00, 0x11, 0x0F, 0x20, 0x02, 0x88, 0xE2, 0xA4, 0x0F, 0xF0, 
+	0x00, 0x00, 0x00, 0x38, 0x98, 0x01, 0xF1, 0x0A, 0x03, 0x80, 0x07, 0x00, 0xD8, 0x41, 0xE0, 0x01, 
+	0x42, 0x80, 0x10, 0x24, 0x03, 0x80, 0x00, 0x00, 0x78, 0x50, 0x80, 0x12, 0x00, 0x00, 0x66, 0x00, 
+	0x81, 0x21, 0x00, 0x13, 0x09, 0x88, 0x00, 0x11, 0x28, 0x06, 0x00, 0x80, 0xF0, 0x05, 0xA0, 0x00, 
+	0x00, 0x02, 0x6C, 0x09, 0x3F, 0x00, 0xB2, 0xB0, 0x0B, 0xB8, 0x60, 0x00, 0x22, 0x01, 0xC3, 0xAC, 
+	0xF4, 0x20, 0xE8, 0x01, 0x70, 0x08, 0x2A, 0x81, 0x00, 0x00, 0x01, 0xE0, 0x53, 0x00, 0x21, 0x00, 
+	0x83, 0xCC, 0x00, 0x20, 0x02, 0x80, 0xEF, 0x00, 0x11, 0x40, 0xD0, 0x00, 0x60, 0x01, 0x3C, 0x01, 
+	0x58, 0x40, 0x40, 0x91, 0x00, 0x40, 0x00, 0x09, 0x94, 0x14, 0x1D, 0x00, 0x00, 0x53, 0x00, 0x44, 
+	0x30, 0x00, 0x00, 0xE5, 0x1B, 0x01, 0x22, 0x30, 0x02, 0x1B, 0x01, 0x4E, 0x03, 0xC2, 0x83, 0xD4, 
+	0x1D, 0x01, 0x31, 0x03, 0x0F, 0x9A, 0x08, 0x00, 0xF7, 0x01, 0x06, 0x00, 0x04, 0x00, 0x03, 0x80, 
+	0x00, 0x07, 0x04, 0x10, 0x00, 0x00, 0x04, 0x03, 0x59, 0x0C, 0x50, 0x01, 0x13, 0x0E, 0x08, 0x00, 
+	0x21, 0xF0, 0x0D, 0x07, 0x00, 0x21, 0x20, 0x04, 0x57, 0x00, 0x10, 0x40, 0xFB, 0x01, 0x33, 0x03, 
+	0xBC, 0xBC, 0x1D, 0x00, 0x40, 0x10, 0x2A, 0x81, 0x04, 0x85, 0x00, 0x02, 0x32, 0x00, 0x07, 0x31, 
+	0x02, 0x11, 0x0A, 0xA6, 0x00, 0x12, 0x1E, 0xE9, 0x00, 0x00, 0x58, 0x01, 0x10, 0xB4, 0xA6, 0x00, 
+	0x22, 0x2C, 0x24, 0x0E, 0x00, 0x1C, 0xB1, 0xBA, 0x01, 0x25, 0xA0, 0x02, 0xBD, 0x03, 0x01, 0x4C, 
+	0x01, 0x00, 0x2D, 0x00, 0x01, 0x8E, 0x01, 0x12, 0xB0, 0x5D, 0x00, 0x42, 0x26, 0x00, 0x00, 0x55, 
+	0x5E, 0x00, 0x51, 0x06, 0x38, 0x09, 0x5B, 0x60, 0x0A, 0x00, 0x11, 0x0C, 0x06, 0x00, 0x03, 0x74, 
+	0x00, 0x21, 0xB0, 0x07, 0x09, 0x00, 0x00, 0x60, 0x01, 0x32, 0x02, 0x00, 0xA0, 0x2A, 0x00, 0x32, 
+	0xAD, 0xCA, 0x70, 0x1D, 0x00, 0x30, 0x0D, 0x02, 0x95, 0xB7, 0x00, 0x71, 0x24, 0x08, 0x10, 0x04, 
+	0x00, 0x00, 0x1E, 0x29, 0x00, 0x20, 0x06, 0x00, 0x86, 0x03, 0x03, 0xDB, 0x00, 0x33, 0x72, 0xCE, 
+	0xDA, 0xF2, 0x01, 0x10, 0xB8, 0x05, 0x00, 0x40, 0x34, 0x3A, 0x4A, 0xDB, 0x08, 0x00, 0x12, 0x0F, 
+	0x3E, 0x00, 0x00, 0x7C, 0x03, 0x12, 0x01, 0x53, 0x00, 0x30, 0x42, 0x2C, 0xFE, 0x9F, 0x01, 0x03, 
+	0x7B, 0x03, 0x00, 0x1C, 0x00, 0x10, 0xCA, 0xC8, 0x00, 0x13, 0x1C, 0xF0, 0x00, 0x80, 0x00, 0x01, 
+	0x00, 0x20, 0x1C, 0x18, 0x56, 0x88, 0x0A, 0x00, 0x36, 0x60, 0x24, 0x41, 0x44, 0x00, 0xA5, 0x0E, 
+	0x00, 0x01, 0xE0, 0xFA, 0x00, 0x30, 0x00, 0x71, 0x0B, 0xA6, 0x04, 0x40, 0x05, 0x50, 0x0F, 0x31, 
+	0x31, 0x04, 0x23, 0x02, 0x44, 0x93, 0x03, 0x41, 0x80, 0x1B, 0x82, 0x95, 0x32, 0x00, 0x60, 0x8E, 
+	0x20, 0x00, 0x04, 0x00, 0x08, 0xED, 0x01, 0x11, 0xE0, 0xCE, 0x00, 0x00, 0x01, 0x00, 0x62, 0x90, 
+	0x00, 0x4C, 0x00, 0x68, 0x60, 0xED, 0x00, 0x32, 0x01, 0x0E, 0xD8, 0x32, 0x00, 0x21, 0x2D, 0xE2, 
+	0x0F, 0x00, 0x14, 0x28, 0x25, 0x00, 0x01, 0xE6, 0x03, 0x12, 0x81, 0x8A, 0x00, 0x15, 0x20, 0x98, 
+	0x02, 0xF2, 0x10, 0xEA, 0x01, 0x42, 0xC0, 0x00, 0x00, 0x03, 0x84, 0x00, 0x48, 0x30, 0x41, 0xE0, 
+	0x00, 0x00, 0x16, 0x06, 0x64, 0x03, 0xA0, 0x01, 0x80, 0x07, 0x84, 0x10, 0x00, 0x00, 0x16, 0x68, 
+	0x1B, 0x33, 0xD9, 0x00, 0x02, 0x98, 0x02, 0x21, 0x02, 0x68, 0x3A, 0x00, 0x30, 0x91, 0x09, 0x38, 
+	0x10, 0x00, 0x50, 0x2B, 0x66, 0x00, 0x01, 0x38, 0x17, 0x00, 0x10, 0x84, 0x05, 0x00, 0x10, 0xBC, 
+	0x15, 0x04, 0x60, 0x10, 0x00, 0x00, 0x0F, 0x07, 0x9C, 0xC3, 0x00, 0x41, 0x27, 0xCA, 0x50, 0x03, 
+	0xC3, 0x01, 0x11, 0xC0, 0xA6, 0x00, 0x31, 0x03, 0x00, 0x00, 0x45, 0x02, 0x50, 0x80, 0x36, 0x05, 
+	0x48, 0x33, 0x35, 0x03, 0xF0, 0x02, 0x00, 0x00, 0x00, 0x72, 0xE0, 0x40, 0x10, 0x00, 0x00, 0x02, 
+	0x70, 0xAA, 0x00, 0x30, 0x00, 0x08, 0x07, 0x47, 0x01, 0x11, 0x3C, 0x98, 0x02, 0x02, 0x45, 0x02, 
+	0x60, 0x21, 0x42, 0x80, 0x0C, 0xC0, 0x10, 0x29, 0x00, 0x30, 0x01, 0x81, 0x86, 0x9D, 0x05, 0x70, 
+	0x60, 0x2C, 0x0A, 0x54, 0x00, 0x00, 0x27, 0x3D, 0x01, 0x32, 0x00, 0x43, 0x80, 0x76, 0x01, 0x01, 
+	0x72, 0x00, 0x30, 0x16, 0x04, 0x08, 0x53, 0x00, 0x00, 0x01, 0x00, 0x20, 0x0B, 0x60, 0x53, 0x00, 
+	0x71, 0x2E, 0x40, 0x00, 0x01, 0x00, 0x05, 0x08, 0xF4, 0x04, 0x21, 0x60, 0x40, 0xBB, 0x00, 0xA3, 
+	0xFB, 0x00, 0x20, 0x05, 0x00, 0xE0, 0x02, 0x80, 0x9C, 0xC0, 0x2A, 0x05, 0x01, 0xCF, 0x00, 0x94, 
+	0x00, 0x37, 0xCA, 0x50, 0x00, 0x00, 0x19, 0x00, 0x80, 0x00, 0x04, 0x42, 0x08, 0x00, 0x1B, 0x58, 
+	0x61, 0x02, 0x10, 0x68, 0x53, 0x00, 0x00, 0xCC, 0x01, 0x01, 0x01, 0x00, 0xC2, 0x2C, 0x2C, 0xF0, 
+	0xAA, 0x20, 0x00, 0x29, 0x90, 0x0D, 0x00, 0x00, 0x0A, 0xF4, 0x00, 0x41, 0x00, 0x00, 0xA0, 0x80, 
+	0x29, 0x00, 0x23, 0x02, 0x0C, 0x53, 0x00, 0x02, 0x84, 0x03, 0x31, 0x02, 0x00, 0xDC, 0x0F, 0x00, 
+	0x01, 0x83, 0x01, 0x00, 0xA9, 0x01, 0x50, 0x00, 0x08, 0x1A, 0x00, 0x4F, 0x2A, 0x00, 0x47, 0x01, 
+	0x48, 0x33, 0x80, 0x82, 0x06, 0x90, 0x24, 0x00, 0x0B, 0xC0, 0x01, 0x00, 0x00, 0x70, 0x09, 0x0B, 
+	0x01, 0x11, 0x03, 0xA6, 0x00, 0x41, 0x50, 0x00, 0x20, 0xF0, 0x46, 0x00, 0x11, 0x0C, 0x61, 0x05, 
+	0x42, 0x10, 0x00, 0x00, 0x72, 0x17, 0x04, 0x00, 0x0D, 0x00, 0x23, 0x01, 0x1C, 0xE4, 0x00, 0xD2, 
+	0x04, 0x00, 0x00, 0x05, 0x8E, 0x00, 0x00, 0x10, 0x40, 0x01, 0x00, 0x60, 0x08, 0x53, 0x00, 0x30, 
+	0x05, 0x00, 0x14, 0x11, 0x03, 0x03, 0xC3, 0x05, 0x11, 0x09, 0x54, 0x02, 0x11, 0x01, 0x53, 0x00, 
+	0xA0, 0x01, 0x07, 0x00, 0x20, 0x02, 0x04, 0x00, 0x04, 0x00, 0xFC, 0x53, 0x00, 0x60, 0x30, 0x00, 
+	0x70, 0x01, 0x06, 0x05, 0x9F, 0x01, 0x50, 0x21, 0xAE, 0x20, 0x07, 0x00, 0x45, 0x02, 0xB2, 0x40, 
+	0x00, 0x00, 0x16, 0x00, 0x04, 0x01, 0x00, 0x05, 0x80, 0x38, 0xF9, 0x00, 0x04, 0x4C, 0x01, 0x21, 
+	0x80, 0x0B, 0x3B, 0x01, 0x72, 0x02, 0xCE, 0xD1, 0x00, 0x10, 0x00, 0x11, 0x09, 0x03, 0x05, 0x67, 
+	0x06, 0x03, 0xF2, 0x01, 0x02, 0x0F, 0x00, 0x10, 0x10, 0x8A, 0x04, 0x61, 0x04, 0x62, 0xA0, 0x08, 
+	0x14, 0x01, 0x15, 0x06, 0x12, 0x80, 0x37, 0x04, 0x02, 0x1C, 0x00, 0x41, 0x08, 0x40, 0x00, 0x01, 
+	0x4C, 0x01, 0x41, 0x00, 0x00, 0x07, 0x08, 0xA6, 0x00, 0x40, 0x00, 0x01, 0x4C, 0x42, 0x70, 0x01, 
+	0x12, 0xF1, 0xAF, 0x00, 0x10, 0x04, 0x65, 0x01, 0x40, 0x07, 0x00, 0x20, 0x80, 0x08, 0x01, 0x31, 
+	0x0C, 0xC0, 0x48, 0x98, 0x02, 0x30, 0x07, 0xB6, 0x8C, 0x37, 0x02, 0xB0, 0x16, 0xEA, 0x04, 0x03, 
+	0x80, 0x08, 0x00, 0x78, 0x40, 0xE0, 0x11, 0xBF, 0x00, 0x01, 0x30, 0x05, 0x83, 0x00, 0x18, 0x06, 
+	0x00, 0x00, 0x02, 0x08, 0x33, 0x9C, 0x01, 0x22, 0x0F, 0xA8, 0x8D, 0x06, 0x20, 0xA0, 0x08, 0x24, 
+	0x05, 0x42, 0xB2, 0x00, 0x00, 0x82, 0x79, 0x01, 0x91, 0x50, 0x00, 0x00, 0x10, 0x82, 0x80, 0x00, 
+	0x03, 0xBC, 0x4C, 0x01, 0xE2, 0x10, 0x00, 0x00, 0xA0, 0x2A, 0x81, 0x00, 0x50, 0x03, 0xC0, 0x00, 
+	0x18, 0x14, 0x85, 0xAD, 0x01, 0x50, 0x02, 0x00, 0x41, 0xC1, 0x06, 0x2B, 0x00, 0x30, 0x07, 0x84, 
+	0x10, 0x2B, 0x04, 0x10, 0xE0, 0x0C, 0x01, 0x50, 0x02, 0x00, 0x00, 0x08, 0xD4, 0xA6, 0x00, 0x60, 
+	0x04, 0x01, 0x4A, 0x42, 0x00, 0x18, 0x9A, 0x00, 0x00, 0x96, 0x04, 0x00, 0xA8, 0x02, 0x01, 0xDD, 
+	0x04, 0x20, 0x80, 0xC0, 0x0A, 0x00, 0x02, 0x29, 0x00, 0xF3, 0x00, 0x00, 0x01, 0x02, 0x95, 0x00, 
+	0x00, 0x01, 0xC3, 0x97, 0xAA, 0x04, 0x00, 0x00, 0x17, 0x9C, 0x25, 0x03, 0x03, 0xC2, 0x04, 0x00, 
+	0x44, 0x00, 0x24, 0x28, 0x00, 0xB6, 0x04, 0x12, 0xD8, 0x82, 0x03, 0x60, 0x10, 0xA0, 0x01, 0x08, 
+	0x00, 0x79, 0x0C, 0x03, 0x00, 0x11, 0x04, 0x51, 0x20, 0x80, 0x00, 0x00, 0x0B, 0x64, 0x02, 0x20, 
+	0x42, 0x80, 0x28, 0x06, 0x50, 0x00, 0x02, 0x80, 0x80, 0x15, 0x53, 0x00, 0x30, 0x00, 0x00, 0x20, 
+	0x53, 0x00, 0x11, 0x0F, 0xC8, 0x01, 0x30, 0xE0, 0x54, 0x1C, 0x4F, 0x04, 0x10, 0x0A, 0xE4, 0x03, 
+	0x00, 0x74, 0x00, 0x11, 0x18, 0xDF, 0x00, 0x21, 0x01, 0x0E, 0x86, 0x02, 0x90, 0x1C, 0x01, 0x40, 
+	0x50, 0x08, 0x08, 0x00, 0x90, 0xCF, 0x3E, 0x00, 0x20, 0x22, 0xED, 0x40, 0x03, 0xA4, 0x00, 0xA0, 
+	0x34, 0x00, 0x80, 0x00, 0xA0, 0x02, 0xAC, 0x92, 0x6D, 0x02, 0x20, 0x06, 0x05, 0x83, 0x05, 0x61, 
+	0x01, 0xAA, 0x04, 0x08, 0x00, 0x07, 0xE0, 0x07, 0x03, 0x0E, 0x04, 0xA3, 0x0A, 0x80, 0x00, 0x10, 
+	0x00, 0x0E, 0x80, 0x79, 0x61, 0x66, 0x29, 0x00, 0x90, 0xD3, 0x90, 0x80, 0x00, 0x00, 0x04, 0x02, 
+	0x40, 0x50, 0xCA, 0x00, 0x10, 0x05, 0x26, 0x00, 0x02, 0x65, 0x01, 0x11, 0x50, 0xA6, 0x00, 0x42, 
+	0x04, 0x02, 0x42, 0xB6, 0x59, 0x05, 0x03, 0x01, 0x00, 0x30, 0x40, 0x04, 0x18, 0xE6, 0x00, 0x03, 
+	0x98, 0x02, 0x70, 0xC1, 0x04, 0x00, 0x28, 0x05, 0x00, 0x80, 0x34, 0x01, 0x41, 0x00, 0x22, 0x00, 
+	0x00, 0xDD, 0x04, 0x05, 0x01, 0x00, 0x63, 0x0A, 0x81, 0x00, 0x08, 0x10, 0x01, 0x45, 0x02, 0x01, 
+	0x94, 0x08, 0x11, 0x03, 0x5C, 0x00, 0x21, 0x02, 0x3C, 0x37, 0x03, 0x30, 0x30, 0x00, 0x80, 0x07, 
+	0x00, 0xA6, 0x40, 0x00, 0x00, 0x17, 0xCA, 0x04, 0x01, 0x03, 0x03, 0x8A, 0x3A, 0x00, 0xB1, 0x01, 
+	0x80, 0x18, 0x00, 0x10, 0x04, 0xA0, 0x00, 0x7C, 0x1C, 0x10, 0x53, 0x00, 0x01, 0x16, 0x06, 0x01, 
+	0x69, 0x01, 0x67, 0xA0, 0x00, 0x38, 0x00, 0x01, 0x09, 0x65, 0x00, 0x71, 0xA0, 0x00, 0x10, 0x02, 
+	0x04, 0x00, 0x07, 0x22, 0x00, 0x90, 0x80, 0x10, 0x00, 0xD1, 0x81, 0x82, 0x95, 0x00, 0xC4, 0x2B, 
+	0x00, 0x30, 0x26, 0x00, 0x04, 0xB9, 0x00, 0x20, 0x4C, 0x06, 0x22, 0x07, 0xA0, 0x03, 0x02, 0x87, 
+	0x1D, 0x90, 0x00, 0x00, 0x0C, 0x0C, 0xB6, 0x77, 0x07, 0xB1, 0x00, 0x08, 0x00, 0x80, 0x01, 0x80, 
+	0x30, 0x00, 0x00, 0x02, 0xA1, 0x64, 0x01, 0x71, 0x40, 0x17, 0x00, 0x93, 0x28, 0x02, 0x0A, 0x49, 
+	0x01, 0xF0, 0x13, 0x08, 0x00, 0x08, 0xD1, 0x03, 0xFC, 0x00, 0x20, 0x12, 0x40, 0x34, 0x89, 0x90, 
+	0x00, 0x00, 0x80, 0x38, 0x00, 0x98, 0x01, 0x02, 0x94, 0x00, 0xE0, 0x00, 0x03, 0x81, 0xA1, 0x05, 
+	0x07, 0x84, 0x00, 0x00, 0x58, 0x30, 0x05, 0xF0, 0x02, 0x4C, 0x0A, 0x54, 0x01, 0x80, 0x08, 0x00, 
+	0x32, 0x25, 0x80, 0x0E, 0x00, 0x14, 0x01, 0xE0, 0x66, 0x40, 0x9E, 0x00, 0x53, 0x01, 0x00, 0x12, 
+	0xE6, 0x48, 0x97, 0x00, 0xF0, 0x03, 0x20, 0x00, 0x70, 0x05, 0xB4, 0x00, 0x00, 0x14, 0x39, 0xE0, 
+	0x00, 0x10, 0x20, 0x00, 0xB0, 0x00, 0x66, 0x58, 0x16, 0x00, 0x31, 0x02, 0xA6, 0x60, 0xA6, 0x00, 
+	0x03, 0xE6, 0x00, 0xF0, 0x0E, 0xC2, 0x81, 0xDB, 0x10, 0x01, 0x00, 0x01, 0x1E, 0x80, 0x00, 0x42, 
+	0x08, 0x00, 0x20, 0x06, 0x60, 0x03, 0x10, 0xA8, 0x00, 0x06, 0x84, 0x10, 0x1C, 0x00, 0x0E, 0x78, 
+	0x1C, 0x55, 0x53, 0x00, 0x11, 0x80, 0x70, 0x07, 0xF0, 0x07, 0x02, 0x0A, 0x74, 0x03, 0x4F, 0x72, 
+	0x00, 0x70, 0x08, 0x11, 0x83, 0x00, 0x02, 0x47, 0x40, 0x02, 0x48, 0x99, 0x20, 0x18, 0x00, 0xF0, 
+	0x39, 0x01, 0x62, 0x60, 0x01, 0x67, 0x1D, 0x0A, 0xA0, 0xFF, 0x02, 0x71, 0x03, 0x02, 0x05, 0x00, 
+	0x00, 0x01, 0xC7, 0x00, 0x02, 0x20, 0x07, 0x9C, 0x06, 0x00, 0x72, 0xE7, 0x81, 0xAA, 0x06, 0x04, 
+	0x00, 0x07, 0x4E, 0x04, 0x42, 0x20, 0x70, 0x40, 0x00, 0x53, 0x00, 0x82, 0x00, 0x03, 0xE0, 0x40, 
+	0x02, 0x00, 0x00, 0x74, 0x85, 0x00, 0x70, 0x9D, 0x00, 0x02, 0x00, 0x02, 0x21, 0xD0, 0xFE, 0x01, 
+	0x10, 0xD8, 0x90, 0x02, 0x35, 0x20, 0x02, 0xC4, 0x8E, 0x06, 0x01, 0xEB, 0x02, 0x02, 0x51, 0x07, 
+	0x20, 0x28, 0x80, 0x62, 0x08, 0x03, 0xFB, 0x03, 0x41, 0x28, 0x00, 0x58, 0x16, 0x92, 0x05, 0x10, 
+	0x01, 0xEB, 0x02, 0x30, 0x20, 0x80, 0x01, 0xBE, 0x03, 0x05, 0x6E, 0x06, 0x60, 0x10, 0x09, 0x00, 
+	0x02, 0x0A, 0x40, 0x4D, 0x01, 0x60, 0x0A, 0x80, 0x90, 0xA0, 0x01, 0x68, 0x12, 0x03, 0x00, 0x42, 
+	0x03, 0x01, 0x31, 0x00, 0x20, 0x88, 0x32, 0x8F, 0x00, 0x40, 0x60, 0x00, 0x10, 0x25, 0x25, 0x05, 
+	0x75, 0x58, 0x02, 0x00, 0x01, 0xC0, 0x0F, 0x90, 0x4C, 0x0B, 0x41, 0x40, 0x00, 0x21, 0x5A, 0x42, 
+	0x01, 0xA1, 0x81, 0x80, 0x00, 0xB0, 0x14, 0x08, 0x02, 0x00, 0x02, 0x00, 0xEC, 0x01, 0x20, 0x10, 
+	0x0B, 0xA6, 0x00, 0x43, 0x22, 0x6B, 0x03, 0x20, 0xB3, 0x05, 0x53, 0x22, 0x03, 0xC0, 0x05, 0xB2, 
+	0x48, 0x01, 0x10, 0x80, 0xF9, 0x00, 0x80, 0x00, 0x07, 0x34, 0x0E, 0x70, 0x00, 0x30, 0x50, 0xE0, 
+	0x00, 0x50, 0x0A, 0x00, 0x0F, 0xFE, 0x40, 0x19, 0x09, 0x01, 0x31, 0x0A, 0x40, 0x04, 0x00, 0xFA, 
+	0x55, 0xD0, 0x00, 0xB1, 0x80, 0x00, 0x1A, 0xF3, 0x10, 0x80, 0x02, 0x08, 0x00, 0x43, 0xCF, 0x12, 
+	0x01, 0x91, 0x0F, 0x00, 0x02, 0x00, 0x1C, 0x00, 0x1A, 0xE4, 0x00, 0x71, 0x00, 0x70, 0x10, 0x04, 
+	0x20, 0x04, 0x00, 0x02, 0x05, 0x47, 0x0A, 0x50, 0x10, 0x00, 0x00, 0x03, 0x62, 0x23, 0x00, 0x54, 
+	0x02, 0x37, 0xEA, 0x50, 0x01, 0x30, 0x05, 0x02, 0xC8, 0x07, 0x00, 0x9F, 0x01, 0x41, 0x04, 0x00, 
+	0x00, 0x20, 0xF9, 0x00, 0x00, 0x59, 0x02, 0x00, 0xDD, 0x00, 0x50, 0x00, 0x00, 0x43, 0x70, 0x55, 
+	0x37, 0x00, 0x10, 0x0D, 0x4D, 0x02, 0x00, 0xE2, 0x02, 0x21, 0x08, 0x25, 0x30, 0x00, 0x00, 0x0B, 
+	0x00, 0xF1, 0x0A, 0x80, 0x00, 0x00, 0x40, 0x80, 0x10, 0x00, 0x80, 0xA8, 0x02, 0x05, 0x00, 0x44, 
+	0x08, 0x00, 0x0E, 0x08, 0x14, 0x01, 0x50, 0x4F, 0x0F, 0x80, 0x00, 0xC8, 0x4C, 0x01, 0x11, 0x03, 
+	0xDF, 0x04, 0xF2, 0x0F, 0x00, 0x0C, 0x00, 0x1C, 0x20, 0x60, 0x5A, 0x40, 0x00, 0x08, 0x20, 0x80, 
+	0x01, 0x08, 0x12, 0x50, 0x80, 0x02, 0x20, 0x00, 0x00, 0x0C, 0x81, 0x08, 0x0A, 0x82, 0xB0, 0xE3, 
+	0x2C, 0x02, 0x75, 0x01, 0x21, 0x08, 0x02, 0xFB, 0x00, 0x40, 0x20, 0x00, 0x24, 0x02, 0x21, 0x0A, 
+	0x70, 0x80, 0x38, 0x00, 0x00, 0xB1, 0xA2, 0x81, 0x98, 0x02, 0x90, 0x4E, 0x18, 0x14, 0x03, 0xC0, 
+	0x2F, 0x00, 0x38, 0x40, 0x73, 0x07, 0x00, 0x3C, 0x03, 0x01, 0x29, 0x00, 0xE1, 0x0E, 0x00, 0x00, 
+	0x78, 0xED, 0x03, 0x00, 0x08, 0x08, 0x00, 0x00, 0x0D, 0x08, 0x0C, 0x72, 0x09, 0x82, 0x74, 0x2C, 
+	0x81, 0x00, 0x00, 0x05, 0xF0, 0x09, 0xDD, 0x07, 0x00, 0x4C, 0x00, 0x03, 0x65, 0x08, 0x60, 0x04, 
+	0x04, 0x90, 0x20, 0x00, 0x48, 0x98, 0x02, 0x34, 0x05, 0xBE, 0x8C, 0x91, 0x03, 0x20, 0x40, 0x30, 
+	0xF2, 0x01, 0x20, 0x60, 0x06, 0xA0, 0x00, 0x11, 0x02, 0x86, 0x03, 0x40, 0x04, 0x00, 0x00, 0x71, 
+	0x64, 0x00, 0x90, 0xC8, 0x02, 0x80, 0x0D, 0x0B, 0x0E, 0xE8, 0xC8, 0x02, 0x7C, 0x06, 0x91, 0xA0, 
+	0x00, 0x18, 0x18, 0x00, 0x01, 0x00, 0x02, 0x0A, 0x25, 0x01, 0x11, 0x08, 0x89, 0x05, 0x41, 0x00, 
+	0xE0, 0x80, 0x04, 0x45, 0x02, 0x70, 0x87, 0x00, 0x00, 0x00, 0xA1, 0x06, 0x04, 0x1D, 0x02, 0x74, 
+	0x3C, 0x0A, 0x56, 0x00, 0x00, 0x07, 0x9E, 0xEA, 0x01, 0x00, 0xD8, 0x05, 0x20, 0x76, 0x88, 0x7B, 
+	0x01, 0xF0, 0x01, 0x04, 0x00, 0x99, 0x00, 0x01, 0x0A, 0x00, 0x80, 0x05, 0x1A, 0xF2, 0x79, 0xC0, 
+	0x12, 0x00, 0x04, 0x28, 0x04, 0x01, 0x4D, 0x03, 0x11, 0x02, 0x1A, 0x08, 0xD2, 0x00, 0x08, 0x00, 
+	0xB8, 0x01, 0x3A, 0x10, 0x00, 0x20, 0x00, 0x02, 0xA4, 0xE6, 0x8A, 0x04, 0x40, 0x80, 0x1D, 0xBA, 
+	0x94, 0xDD, 0x04, 0x10, 0x0E, 0x8A, 0x04, 0x14, 0x40, 0xEC, 0x09, 0x01, 0xD1, 0x00, 0x00, 0x66, 
+	0x03, 0x20, 0x20, 0xA0, 0xB1, 0x08, 0xF1, 0x08, 0x00, 0x00, 0x20, 0x82, 0x87, 0x0A, 0x14, 0x2A, 
+	0x80, 0x02, 0x00, 0x2C, 0x00, 0x09, 0x81, 0x00, 0x08, 0x02, 0x00, 0x0D, 0x00, 0x02, 0x08, 0x4D, 
+	0x01, 0x10, 0x0A, 0x33, 0x00, 0x50, 0x10, 0x00, 0x20, 0x10, 0x43, 0x09, 0x00, 0x11, 0x4C, 0x2E, 
+	0x00, 0x70, 0x33, 0x90, 0x01, 0x00, 0x01, 0xC0, 0x7C, 0x6E, 0x08, 0x23, 0x28, 0x0F, 0x4B, 0x09, 
+	0x01, 0xC4, 0x00, 0x20, 0x80, 0x16, 0x14, 0x08, 0x30, 0x04, 0xFC, 0x2D, 0xCC, 0x01, 0x50, 0x80, 
+	0x00, 0x00, 0x57, 0xF6, 0xF2, 0x01, 0x84, 0x24, 0xE0, 0x00, 0x00, 0x08, 0x04, 0xB0, 0x97, 0xF7, 
+	0x02, 0x01, 0x3C, 0x05, 0x70, 0x94, 0x02, 0x20, 0x02, 0xC3, 0x1D, 0x8B, 0x0A, 0x0D, 0x00, 0x3B, 
+	0x0B, 0xC4, 0x02, 0x05, 0x00, 0x02, 0x00, 0x66, 0x21, 0xCA, 0x04, 0x08, 0x00, 0x73, 0xA5, 0x00, 
+	0xA1, 0x04, 0x04, 0x00, 0x15, 0x80, 0x77, 0x95, 0x50, 0x50, 0x0A, 0x66, 0x05, 0xF0, 0x02, 0x08, 
 	0x02, 0x80, 0x80, 0x00, 0x0F, 0x12, 0x50, 0x88, 0x02, 0x40, 0x00, 0x01, 0xC0, 0x50, 0x00, 0x09, 
-	0x00, 0x08, 0x07, 0x00, 0x02, 0x04, 0x00, 0x00, 0xC0, 0x08, 0x00, 0x48, 0x02, 0xF0, 0xE0, 0xC1, 
-	0x54, 0x82, 0x20, 0x02, 0x40, 0x00, 0x00, 0x00, 0x00, 0x40, 0x00, 0x30, 0x00, 0x00, 0x00, 0x32, 
-	0x8C, 0x00, 0x40, 0x00, 0x60, 0x1C, 0x1A, 0x50, 0x01, 0x00, 0x00, 0x00, 0x80, 0x00, 0x20, 0x00, 
-	0x02, 0x3E, 0xAA, 0x50, 0x01, 0x00, 0x00, 0x01, 0x56, 0x15, 0x40, 0x04, 0x00, 0x16, 0x01, 0xED, 
-	0xB1, 0x00, 0x00, 0x00, 0x00, 0x80, 0x00, 0x00, 0x92, 0xD4, 0xC0, 0x2A, 0x00, 0x00, 0x01, 0x49, 
-	0x99, 0x20, 0x18, 0x00, 0x70, 0x0B, 0x00, 0x02, 0x00, 0x00, 0x41, 0x70, 0xAA, 0x20, 0x08, 0x00, 
-	0x00, 0x80, 0x01, 0x54, 0x80, 0x22, 0x01, 0x40, 0x2D, 0xBB, 0x20, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x50, 0x03, 0xB2, 0x81, 0x00, 0x04, 0x01, 0x60, 0x06, 0x18, 0x14, 0x00, 0x04, 0x00, 0x00, 0x00, 
-	0x00, 0x80, 0x40, 0x07, 0x60, 0x00, 0x04, 0x02, 0x00, 0x27, 0x8B, 0x53, 0x68, 0x50, 0x10, 0x40, 
-	0x00, 0x3A, 0x00, 0x00, 0x40, 0x40, 0x20, 0x00, 0x00, 0x00, 0x80, 0x08, 0x28, 0x00, 0x00, 0x20, 
-	0x00, 0x00, 0x2B, 0x81, 0x00, 0x00, 0x00, 0x70, 0x03, 0x34, 0x00, 0x84, 0x00, 0x36, 0xC0, 0x08, 
-	0x00, 0x00, 0x05, 0x09, 0xAD, 0x65, 0xD8, 0x00, 0x02, 0x00, 0x04, 0x04, 0x00, 0x80, 0x08, 0x00, 
-	0x00, 0x38, 0x00, 0x00, 0x08, 0x6A, 0x81, 0x00, 0xE0, 0x01, 0x47, 0x20, 0x18, 0x14, 0x03, 0x84, 
-	0x48, 0x00, 0x58, 0x41, 0x60, 0x00, 0xE0, 0x40, 0x00, 0x24, 0x01, 0x80, 0x0F, 0x98, 0x5E, 0x71, 
-	0x50, 0x0E, 0x00, 0x20, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x0B, 0xB4, 0x14, 
-	0x00, 0x00, 0x00, 0x14, 0x41, 0xC9, 0x42, 0x00, 0x20, 0x00, 0xF0, 0x05, 0x34, 0x08, 0x00, 0x02, 
-	0x34, 0x09, 0x00, 0x20, 0x20, 0x00, 0x59, 0xAD, 0xFB, 0x24, 0x02, 0x80, 0x00, 0xC0, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x10, 0x00, 0x00, 0x07, 0x72, 0x81, 0x00, 0x40, 0x00, 0x60, 0x36, 0x1A, 
-	0x50, 0x03, 0x00, 0x81, 0x00, 0x80, 0x00, 0x40, 0x01, 0xE7, 0x01, 0xC1, 0x04, 0x03, 0x00, 0x00, 
-	0x18, 0x96, 0xFD, 0x50, 0x44, 0x08, 0x00, 0x78, 0x00, 0x00, 0x00, 0x00, 0x00, 0x02, 0x00, 0x00, 
-	0x00, 0x04, 0x28, 0x00, 0x08, 0x00, 0x00, 0x03, 0xEE, 0x99, 0x20, 0x30, 0x11, 0x90, 0x93, 0x00, 
-	0x04, 0x0A, 0x02, 0x40, 0x00, 0x00, 0x00, 0x10, 0x00, 0xD0, 0xB9, 0xE2, 0x04, 0x00, 0xC0, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x02, 0x00, 0x00, 0x01, 0xC0, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x06, 0x9E, 0xBD, 0x10, 0x00, 0x00, 0x07, 0x80, 0x00, 0x00, 0x00, 0x00, 0x07, 0x34, 0x0E, 0x70, 
-	0x04, 0x00, 0x08, 0x1A, 0xBE, 0x21, 0x40, 0x00, 0x00, 0x00, 0x02, 0xFC, 0xE6, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x28, 0x08, 0xD1, 0x20, 0x00, 0x00, 
-	0x90, 0x8D, 0x00, 0x00, 0x00, 0x00, 0x40, 0x4F, 0x42, 0x00, 0x00, 0x00, 0x30, 0xB1, 0x63, 0xA8, 
-	0x00, 0x00, 0x01, 0xC0, 0x0E, 0xCC, 0x20, 0x00, 0x00, 0x00, 0x00, 0x00, 0x18, 0x10, 0x72, 0x81, 
-	0x00, 0x00, 0x0A, 0x00, 0x01, 0x8A, 0x04, 0x00, 0x28, 0x50, 0x00, 0x00, 0x00, 0x08, 0x00, 0x00, 
-	0x00, 0x10, 0x24, 0x00, 0x00, 0x01, 0x08, 0x9B, 0x39, 0xD0, 0x20, 0x04, 0x14, 0x02, 0xC9, 0xA4, 
-	0x00, 0x00, 0x00, 0x20, 0x00, 0x00, 0x08, 0xB4, 0x14, 0x00, 0x00, 0x01, 0x44, 0x00, 0xD0, 0x50, 
-	0x01, 0x00, 0x00, 0x90, 0x95, 0x00, 0x00, 0x00, 0x00, 0x00, 0x09, 0x00, 0x00, 0x02, 0x01, 0x00, 
-	0xF9, 0xA6, 0x80, 0x00, 0x00, 0x10, 0x00, 0x3D, 0xDE, 0x60, 0x00, 0x00, 0x00, 0x00, 0x00, 0x80, 
-	0x88, 0x02, 0x05, 0x00, 0x00, 0x00, 0x00, 0x1E, 0x18, 0x14, 0x00, 0x00, 0x00, 0x48, 0x90, 0x08, 
-	0x00, 0x00, 0x60, 0x1C, 0x00, 0x04, 0x00, 0x28, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x14, 
-	0x04, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x07, 0x00, 0xB2, 0x10, 0x82, 0x20, 0x00, 0x00, 
-	0x00, 0x29, 0x81, 0x20, 0x00, 0x00, 0x91, 0x05, 0x00, 0x00, 0x00, 0x02, 0x38, 0x00, 0x04, 0x20, 
-	0x01, 0x00, 0xD0, 0x00, 0x00, 0x00, 0x00, 0x00, 0x03, 0x62, 0x40, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x80, 0x00, 0x04, 0xF0, 0x00, 0x00, 0x00, 0x00, 0x24, 0x18, 0x10, 0x00, 0x00, 0x10, 
-	0x1C, 0x80, 0x00, 0x0A, 0x00, 0x60, 0x40, 0x00, 0x04, 0x00, 0x10, 0xA0, 0x1A, 0x76, 0xF9, 0xD0, 
-	0x00, 0x40, 0x00, 0x01, 0x60, 0x00, 0x40, 0x00, 0x00, 0x00, 0x00, 0x01, 0x00, 0x03, 0x0F, 0x00, 
-	0x00, 0x00, 0x00, 0x01, 0xC8, 0xE7, 0x10, 0x00, 0x00, 0x00, 0x0F, 0x00, 0x00, 0x02, 0x42, 0x3B, 
-	0x40, 0x08, 0x00, 0x40, 0x00, 0x10, 0x0F, 0x3D, 0x40, 0x20, 0x08, 0x00, 0x00, 0x00, 0x00, 0x40, 
-	0x00, 0x00, 0x00, 0x30, 0x00, 0x00, 0x08, 0x62, 0x81, 0x00, 0xC0, 0x02, 0x46, 0x20, 0xAA, 0x04, 
-	0x01, 0x00, 0x00, 0x08, 0x80, 0x00, 0x40, 0x00, 0x00, 0x16, 0x00, 0x04, 0x00, 0x00, 0x08, 0x08, 
-	0x00, 0x00, 0x00, 0x04, 0x40, 0x00, 0x28, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0xB4, 0x14, 0x00, 0x00, 0x00, 0x06, 0x02, 0x40, 0x50, 0x00, 0x10, 0x00, 0x01, 0x0D, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x20, 0x04, 0x00, 0x00, 0x00, 0x50, 0x00, 0x00, 0x00, 0x00, 0x08, 0x00, 0x04, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x78, 0x10, 0x00, 0x00, 0x00, 0x00, 0x1D, 0x60, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0x00, 0x00, 0x88, 0x00, 0x00, 0x00, 0x00, 0x00, 0x02, 
-	0x00, 0x00, 0x1E, 0x80, 0x00, 0x10, 0x08, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x08, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0xF3, 0x3C, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0x0D, 0x00, 0x20, 0x00, 
-	0x00, 0x50, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x38, 0x00, 0x00, 0x00, 0x3B, 0x01, 0x00, 
-	0xE0, 0x00, 0x00, 0x4E, 0xCA, 0x50, 0x03, 0x80, 0x08, 0x0E, 0xB8, 0x40, 0x60, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x01, 0x80, 0x00, 0x00, 0x00, 0x00, 0x10, 0x0E, 0x0A, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x06, 0x30, 0x00, 0x00, 0x00, 0x00, 0x28, 0x40, 0xAA, 0x00, 
-	0x00, 0x00, 0x70, 0x0B, 0xB2, 0x08, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x20, 0x00, 0x70, 0x05, 
-	0x00, 0x20, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x10, 0x00, 0x00, 0xE0, 
-	0x02, 0x05, 0x00, 0x44, 0x00, 0x00, 0x60, 0x08, 0x14, 0x01, 0x00, 0x25, 0x9E, 0x80, 0x00, 0x40, 
-	0x20, 0x03, 0x80, 0x00, 0x00, 0x03, 0x00, 0x0F, 0x80, 0x03, 0x84, 0x10, 0x00, 0x00, 0x00, 0x04, 
-	0x0A, 0x10, 0x40, 0x00, 0x00, 0x02, 0x20, 0x00, 0x1E, 0xF2, 0xD0, 0x80, 0x00, 0x20, 0x00, 0x29, 
-	0x4D, 0x42, 0x00, 0x10, 0x00, 0x00, 0x05, 0x00, 0x0C, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x30, 
-	0x00, 0xF8, 0x00, 0x40, 0x00, 0x00, 0x02, 0x01, 0x42, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0xC0, 0x01, 0xAA, 0x04, 0x80, 0x08, 0x03, 0x80, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x1C, 0x9B, 0xA8, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x1E, 0x10, 0x48, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x03, 0xC0, 0x50, 0x00, 0x01, 0x00, 0x08, 0x03, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x01, 0x0B, 0x3B, 0x6C, 0x00, 0x00, 0x00, 0x02, 0x81, 0x00, 0x00, 0x08, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x17, 0x2B, 0xD4, 0x00, 0x00, 0x01, 0xC0, 0x40, 0xDC, 0x04, 0x00, 
-	0x00, 0x07, 0x00, 0x00, 0x00, 0x04, 0x00, 0x00, 0x20, 0x00, 0x04, 0x00, 0x00, 0x20, 0x01, 0x00, 
-	0x40, 0x90, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x0A, 0xBC, 
-	0x14, 0x00, 0x40, 0x00, 0x24, 0x2C, 0x0A, 0xC0, 0x08, 0x00, 0x00, 0xD0, 0x0D, 0x00, 0x00, 0x00, 
-	0x00, 0x02, 0xC0, 0x08, 0x00, 0x00, 0x04, 0x00, 0xE0, 0x34, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0x3A, 0x81, 0x00, 0x04, 0x02, 0x00, 0x4D, 
-	0xCA, 0x00, 0x00, 0x10, 0x03, 0x8E, 0xD0, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x08, 0x00, 0x00, 0x10, 0x00, 0x0E, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x0C, 0x28, 0x02, 0x00, 0x20, 0x04, 0x23, 0x50, 0xFA, 0x00, 0x02, 0x80, 0x08, 0xB7, 
-	0x02, 0x00, 0x00, 0x00, 0x38, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x89, 0x00, 0x20, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x06, 0x00, 0x00, 0x00, 0x01, 0xF0, 0x2A, 0x81, 0x00, 0x00, 
-	0x00, 0x06, 0x7E, 0x0A, 0x54, 0x00, 0x08, 0x20, 0x1C, 0x80, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x09, 0x8E, 0x00, 0x00, 0x10, 0x00, 0x00, 0x00, 0x00, 0x0A, 0x10, 0x40, 0x00, 
-	0x00, 0x00, 0x20, 0x00, 0x1E, 0xF4, 0x14, 0x00, 0x00, 0x00, 0x00, 0x21, 0x40, 0x00, 0x08, 0x01, 
-	0x00, 0x01, 0x07, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x90, 0xFB, 0x00, 
-	0x20, 0x00, 0x00, 0x04, 0x00, 0x01, 0x00, 0x00, 0x80, 0x00, 0x00, 0x30, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x40, 0x00, 0x00, 0x26, 0xEA, 0x00, 0x05, 0x03, 0x05, 0x00, 0x80, 0x00, 0x40, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 0x50, 0x00, 0x10, 0x00, 0x00, 0x00, 0x62, 0x00, 
-	0x00, 0x40, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x08, 0x00, 0x1C, 0x27, 0xF0, 
-	0xF5, 0x00, 0x10, 0x00, 0xD8, 0x09, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x10, 0x00, 0x00, 0x00, 0x00, 0x34, 0x00, 0x80, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x04, 0x02, 0x00, 0x00, 0x08, 0x00, 0x0E, 0x00, 0x05, 0x00, 0x24, 0x20, 0x00, 0x80, 
-	0x00, 0x00, 0x00, 0x00, 0x40, 0x00, 0x26, 0x84, 0x00, 0x18, 0x01, 0x30, 0x00, 0x20, 0x00, 0x06, 
-	0x00, 0x00, 0x00, 0x00, 0x40, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x03, 0x80, 0x00, 0x80, 0x01, 
-	0x00, 0x00, 0x00, 0x04, 0x01, 0xC0, 0x00, 0x00, 0x03, 0x34, 0x00, 0x00, 0x00, 0x38, 0x0F, 0x00, 
-	0x20, 0x40, 0x02, 0x50, 0xA0, 0x00, 0x00, 0x08, 0x00, 0x0B, 0xC0, 0x2C, 0x00, 0x80, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x02, 0x00, 0xE0, 0x00, 0x00, 0x00, 0x00, 0x00, 0x03, 0x84, 
-	0x08, 0x0E, 0x58, 0x00, 0xE0, 0x00, 0x00, 0x01, 0xE1, 0x06, 0x90, 0x00, 0x0D, 0x81, 0x03, 0xCC, 
-	0xE0, 0x0E, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x03, 0x80, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x20, 0x00, 0xB1, 0x07, 0x30, 0x18, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x20, 0xC0, 0x00, 0x50, 0xA0, 0x23, 0x30, 0x00, 0x80, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x20, 0x00, 0x00, 0x02, 0x00, 0x00, 0x20, 0xCE, 0x00, 0x40, 0x00, 0x02, 0x00, 0x00, 
-	0x00, 0x01, 0x00, 0x07, 0x0E, 0x00, 0x00, 0x40, 0x00, 0x00, 0x20, 0x00, 0x06, 0x80, 0x00, 0x05, 
-	0x80, 0x02, 0x4C, 0xE0, 0x04, 0x2A, 0x94, 0x70, 0x00, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 0x40, 
-	0x00, 0x03, 0xF3, 0x00, 0x1C, 0x00, 0x00, 0x40, 0x00, 0x00, 0x00, 0x71, 0x00, 0x09, 0x05, 0x00, 
-	0x04, 0x00, 0x00, 0x03, 0xC0, 0x08, 0x28, 0xC0, 0x00, 0x00, 0x00, 0x23, 0x30, 0x21, 0xC0, 0x04, 
-	0x26, 0x00, 0x00, 0x00, 0x00, 0x00, 0x02, 0x00, 0x00, 0x00, 0x03, 0x20, 0xCE, 0x00, 0x00, 0x02, 
-	0x03, 0x80, 0x00, 0x00, 0x00, 0x20, 0x13, 0x80, 0x80, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x12, 0x0C, 0xE0, 0x00, 0x01, 0x20, 0x00, 0x40, 0x00, 0x28, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x08, 0x33, 0x04, 0x00, 0x40, 0x3C, 0x40, 0x00, 0x00, 0x00, 0x01, 0x02, 
-	0x08, 0x99, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x03, 0x30, 
-	0x81, 0x00, 0x03, 0xC0, 0x34, 0xD1, 0x81, 0x04, 0x00, 0x00, 0x00, 0x00, 0x50, 0x00, 0x20, 0xCE, 
-	0x01, 0x00, 0x50, 0x00, 0x20, 0x00, 0x04, 0x00, 0x00, 0x05, 0x40, 0x80, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0xE1, 0x06, 0x04, 0x00, 0x25, 0x00, 0x02, 0x4C, 0xE0, 0x20, 0x00, 0x00, 0x71, 0x7E, 0xE5, 
-	0x00, 0x00, 0x02, 0xE0, 0x00, 0x05, 0x0A, 0x03, 0x33, 0x00, 0x00, 0x00, 0x80, 0x03, 0x40, 0x08, 
-	0x21, 0x80, 0x00, 0x00, 0x8B, 0x00, 0x00, 0x40, 0x00, 0x00, 0x10, 0x00, 0x28, 0x00, 0x21, 0x08, 
-	0x00, 0x27, 0x30, 0x00, 0x00, 0x20, 0x02, 0x3C, 0xEF, 0x32, 0x00, 0x00, 0x00, 0x00, 0x00, 0x5C, 
-	0x00, 0x20, 0xCE, 0x00, 0x00, 0x02, 0xF0, 0x01, 0xC1, 0x04, 0x10, 0x00, 0x08, 0x00, 0x78, 0x00, 
-	0x00, 0x02, 0x00, 0x1C, 0x00, 0x05, 0x04, 0x20, 0x00, 0x00, 0x52, 0x0C, 0xE0, 0x20, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x03, 0x33, 0x00, 0x00, 0x00, 0x2C, 
-	0x00, 0x00, 0x00, 0x20, 0xC0, 0x30, 0x50, 0xAF, 0x01, 0x00, 0x00, 0x14, 0x00, 0x00, 0x04, 0x08, 
-	0x81, 0x00, 0x00, 0xB0, 0x03, 0x30, 0x00, 0x00, 0x01, 0xC0, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x01, 0x00, 0x80, 0xA7, 0xA0, 0xCE, 0x00, 0x00, 0x00, 0x00, 0x1F, 0xBB, 0x10, 0x00, 0x00, 0x08, 
-	0x01, 0x80, 0x00, 0x04, 0x01, 0x66, 0xC0, 0x10, 0x24, 0x04, 0x00, 0x05, 0x00, 0x02, 0x4C, 0xE0, 
-	0x00, 0x01, 0x14, 0x28, 0x00, 0x00, 0x40, 0x00, 0x00, 0x00, 0x00, 0x05, 0x00, 0x00, 0x33, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x0E, 0xB1, 0x00, 0x00, 0x18, 0x50, 0xAF, 0x00, 0x00, 0x00, 0x00, 0x28, 
-	0x0C, 0x00, 0x29, 0x00, 0x00, 0x08, 0x00, 0x37, 0x30, 0x00, 0x08, 0x08, 0x00, 0x14, 0x00, 0x80, 
-	0x10, 0x00, 0x00, 0x00, 0x00, 0xD0, 0x00, 0x24, 0xCE, 0x00, 0x40, 0x02, 0x40, 0x00, 0x00, 0x00, 
-	0x01, 0x20, 0x01, 0x88, 0x80, 0x00, 0x40, 0x01, 0x66, 0x80, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x12, 0x0C, 0xE0, 0x0C, 0x00, 0x00, 0x00, 0x00, 0x00, 0x40, 0x00, 0x00, 0x00, 0x00, 0x05, 0x00, 
-	0x03, 0x33, 0x00, 0x10, 0x00, 0x0C, 0x00, 0x00, 0x00, 0x00, 0x11, 0x00, 0x08, 0x0D, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x83, 0x30, 0x00, 0x40, 0x01, 0x40, 
-	0x2C, 0x00, 0x88, 0x00, 0x00, 0x00, 0x11, 0x01, 0x01, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x08, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x04, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x40, 0x00, 0x00, 0x00, 0x08, 0x00, 0x00, 0x00, 0x10, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x02, 0x00, 0x00, 0x04, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x10, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x10, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x40, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x10, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xC0, 0x00, 0x00, 0x00, 0x00, 0x30, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x40, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x80, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x10, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x05, 0x80, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x80, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x0C, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x10, 0x00, 0x01, 0x01, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x01, 0x80, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0x00, 0x00, 0x18, 0x00, 0x00, 0x40, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x08, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x04, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x10, 0x00, 0x00, 0x00, 0x10, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xD0, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x60, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x40, 0x00, 0x00, 0x80, 0x00, 
-	0x00, 0x00, 0x80, 0x00, 0x00, 0x00, 0x00, 0x00, 0x06, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x40, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x20, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x10, 
-	0x02, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x84, 0x60, 0x00, 0x00, 0x00, 0x00, 0x30, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x40, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x07, 0x80, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xF0, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x14, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x18, 0x0F, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xA0, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x02, 0x80, 0xB3, 0xC0, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x42, 0xC0, 0xA5, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x01, 0x3C, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x03, 0xA0, 0x05, 0xA0, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x1C, 0xB3, 0x30, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x08, 0x00, 0x03, 0x4C, 0x42, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x28, 0x08, 0xCC, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x20, 0x08, 0x10, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x40, 
-	0x02, 0xFC, 0xC0, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x34, 0x01, 0xD8, 0x33, 0x80, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x20, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0xE0, 0x00, 0x80, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x0B, 
-	0xA6, 0x95, 0x82, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x0E, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 0xD8, 0x1F, 0x94, 0x14, 0x00, 0x06, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x10, 
-	0x00, 0x00, 0x80, 0x00, 0x00, 0x00, 0x40, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x24, 0x0F, 0xA2, 0x04, 0x00, 0x00, 0x80, 0x00, 
-	0x00, 0x00, 0x00, 0x14, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x01, 0x40, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x06, 0x60, 0xD8, 0x30, 0x40, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x01, 0x80, 0x00, 0x00, 0x00, 0x00, 0x08, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x04, 0x0E, 0x9C, 0x14, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x02, 0xC0, 0x08, 0x40, 0x00, 0x00, 0x00, 0x00, 0x00, 0x18, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x06, 0x63, 0xCD, 0x42, 0x40, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x04, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xF0, 0x00, 0x00, 0x00, 0x00, 0x00, 0x46, 0x0D, 
-	0xE4, 0x30, 0x0C, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x03, 0x01, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x28, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x20, 0x64, 0x18, 0x83, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x08, 0x10, 0x60, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x01, 0xE2, 0x40, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x36, 0x98, 0x14, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x0F, 0xF2, 0xF9, 0xC0, 0x00, 0x00, 0x00, 0x00, 0xD8, 0x7F, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x0A, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0xCD, 0x02, 0x40, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x18, 0x07, 
-	0x6C, 0x00, 0x00, 0x00, 0x00, 0x14, 0xC3, 0xE0, 0x00, 0x00, 0x00, 0x10, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x40, 0x00, 0x22, 0xCF, 0xFA, 0xC0, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x03, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x0C, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x03, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x0C, 0x01, 0x14, 0x00, 0xF8, 
-	0x7C, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x30, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x40, 0x01, 0xC7, 0x80, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x02, 0x00, 0x00, 0x00, 0x00, 0x00, 0x10, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x0C, 0x1F, 0xD0, 0x10, 0x08, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x03, 0x80, 0x00, 0x00, 0x00, 0x00, 0x00, 0x0E, 0x00, 
-	0x00, 0x6C, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x0E, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x38, 0x00, 0x00, 0x07, 0xE4, 0x01, 0x00, 0xE0, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x04, 0x00, 0x00, 0x26, 0xE0, 0x00, 0x00, 0x04, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x04, 0x00, 0xD0, 0x00, 0x00, 0x00, 0x00, 0x80, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x0A, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x62, 0x41, 0x81, 0x20, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x70, 0x00, 0x02, 0x68, 0x40, 0x28, 0x70, 0x00, 0x00, 0x00, 0x00, 0x00, 0xC0, 0xE0, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x03, 0x02, 0x94, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x04, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0x00, 0x00, 
-	0x00, 0xB0, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x38, 0x00, 0x00, 0x00, 
-	0x04, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x04, 0x00, 0x00, 0x00, 0x00, 0x00, 0x40, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x0E, 0x08, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x18, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x08, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x15, 0x00, 0x01, 
-	0x00, 0x00, 0x01, 0x60, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x08, 0x00, 0x00, 0x10, 
-	0x00, 0x00, 0x00, 0x04, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x02, 0x00, 0x40, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x02, 0x58, 0xBD, 
-	0x00, 0x80, 0x00, 0x00, 0x00, 0x01, 0x98, 0x30, 0x00, 0x00, 0x00, 0x00, 0x00, 0x28, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x40, 0x00, 0x40, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0x40, 0x1D, 0x8F, 0xE4, 0x00, 0x00, 0x02, 0x00, 0x00, 0x90, 
-	0xE0, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x28, 0x70, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x40, 0x00, 0x00, 0x40, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x14, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x08, 0x01, 0x00, 0x00, 0x00, 0x00, 0x01, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x01, 0x3E, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x20, 0x60, 0x00, 0x40, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x02, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x0B, 0xA5, 0x09, 0x80, 0x00, 0x00, 0x00, 0x00, 0x05, 0xA0, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x40, 0x00, 0xD3, 0x30, 0x00, 0x00, 0x00, 0x00, 0xF0, 0x3D, 0x46, 
-	0x60, 0x00, 0x00, 0x28, 0xDB, 0xBD, 0x80, 0x80, 0x00, 0x20, 0x00, 0x00, 0x00, 0xF0, 0x40, 0x10, 
-	0x00, 0x00, 0x16, 0x01, 0x60, 0x5A, 0x48, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x1E, 0x00, 
-	0x0C, 0x33, 0x40, 0x00, 0x00, 0x58, 0x01, 0x2A, 0x80, 0x05, 0x00, 0x00, 0x42, 0xAD, 0x9F, 0xE4, 
-	0x00, 0x00, 0x00, 0x10, 0x00, 0x00, 0x00, 0x00, 0x10, 0x00, 0x00, 0x00, 0x00, 0x07, 0x93, 0xC0, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xC0, 0x00, 0x04, 0x00, 0xA0, 0x00, 0x00, 0x00, 0x00, 0x8A, 
-	0x00, 0x00, 0x00, 0x0C, 0x00, 0x04, 0x60, 0x00, 0x00, 0x00, 0x00, 0x00, 0x03, 0x00, 0x00, 0x00, 
-	0x38, 0x00, 0x00, 0x04, 0x00, 0x00, 0x00, 0xE8, 0x1C, 0x48, 0x00, 0x38, 0x00, 0x00, 0x00, 0x04, 
-	0x00, 0x00, 0x78, 0x01, 0x02, 0x40, 0x00, 0x00, 0x50, 0x10, 0x00, 0x00, 0x00, 0x40, 0x00, 0x07, 
-	0x80, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0x03, 0xA7, 0x2C, 0x01, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x20, 0x14, 0xD9, 0x90, 0x02, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x08, 0x00, 0x24, 0x24, 0x00, 0x00, 0x00, 0x00, 0x00, 0x03, 
-	0x80, 0x00, 0x0A, 0xF3, 0x70, 0xC0, 0x0E, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x0E, 0x00, 0x1E, 0x02, 0x00, 0x66, 0x40, 0x38, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0xE0, 0x02, 0x00, 0x40, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x03, 0x42, 0x80, 0x00, 0x00, 0x00, 0x28, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x03, 0xC0, 
-	0x00, 0x00, 0x00, 0x00, 0x0F, 0x00, 0x02, 0x80, 0x00, 0x00, 0x00, 0x00, 0x43, 0x6A, 0x20, 0x08, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x6C, 0x00, 0x00, 0x00, 
-	0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x04, 0x00, 0x00, 0x00, 0x00, 0x00, 0x80, 0x00, 
-	0x04, 0x09, 0x00, 0x00, 0x01, 0x42, 0xB4, 0xB0, 0x00, 0x04, 0x00, 0x00, 0x08, 0x00, 0x00, 0x00, 
-	0x80, 0x10, 0x80, 0x20, 0x00, 0x40, 0x25, 0x93, 0xE4, 0x94, 0x80, 0x00, 0x00, 0x00, 0x00, 0x20, 
-	0x00, 0x00, 0x14, 0x00, 0x80, 0x80, 0x80, 0x00, 0x00, 0x50, 0x02, 0x02, 0x02, 0x00, 0x04, 0x00, 
-	0x2E, 0xDB, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x10, 0x00, 0x10, 0x04, 0x00, 0x20, 0x00, 
-	0x0F, 0x3D, 0x50, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x40, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 0x00, 0x06, 0x1D, 0xB0, 0x00, 0x00, 0x00, 0x08, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x20, 0xA0, 0x00, 0x02, 0x0F, 0xA2, 0x08, 0x80, 0x00, 0x00, 
-	0x00, 0x00, 0x20, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x80, 0x00, 0x80, 0x00, 0x00, 0x00, 0x02, 
-	0x00, 0x00, 0x23, 0x5B, 0x7F, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x61, 0x78, 0xFA, 0x00, 0x80, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x05, 0x50, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x07, 0xE6, 0xE5, 0xB0, 0x00, 
-	0x10, 0x00, 0x08, 0x00, 0x70, 0x00, 0x80, 0x10, 0x00, 0x20, 0x02, 0x40, 0x00, 0x00, 0x00, 0x00, 
-	0x82, 0x80, 0x00, 0x00, 0x00, 0x20, 0x00, 0x20, 0x01, 0x00, 0x00, 0x00, 0x80, 0x00, 0x00, 0x04, 
-	0x00, 0x02, 0x02, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x03, 0x00, 0x00, 0x00, 0x08, 0x1C, 0x50, 
-	0x00, 0x10, 0x10, 0x00, 0x20, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x1E, 0x00, 0x1A, 0x10, 0x60, 0x00, 0x38, 0x00, 0x00, 0x28, 0x41, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x20, 0x02, 0x08, 0x00, 0x00, 0x00, 0x24, 0x00, 0x80, 0x20, 0x00, 0x00, 0x16, 
-	0xC4, 0x20, 0x00, 0x90, 0x00, 0x00, 0x00, 0x00, 0x28, 0x00, 0x00, 0x02, 0x00, 0x40, 0x00, 0x88, 
-	0x00, 0x00, 0x10, 0x02, 0x00, 0x22, 0x20, 0x80, 0x00, 0x00, 0x00, 0x00, 0x01, 0x40, 0x10, 0x08, 
-	0x00, 0x00, 0x00, 0x40, 0x90, 0x00, 0x00, 0x00, 0x02, 0x61, 0xC3, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x40, 0x00, 0x00, 0x40, 0x00, 0x40, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0x00, 0x00, 
-	0x15, 0x60, 0x00, 0x00, 0x00, 0x00, 0x10, 0x80, 0x08, 0x00, 0x00, 0x0B, 0x01, 0x68, 0x80, 0x20, 
-	0x00, 0x02, 0x25, 0x90, 0x26, 0x04, 0x83, 0x00, 0x00, 0x00, 0x00, 0x20, 0x03, 0x40, 0x00, 0xC0, 
-	0x00, 0x08, 0x80, 0x05, 0x0B, 0x02, 0x80, 0x00, 0x02, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x08, 0x30, 0x00, 0x00, 0x00, 0xB8, 0x00, 0x00, 0x00, 0x00, 0x04, 0x00, 0x0F, 0x01, 0x48, 0x40, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x78, 0x01, 0x02, 0x40, 0x00, 0x00, 0x80, 0x00, 0x04, 
-	0x09, 0x20, 0x00, 0x01, 0x42, 0x80, 0x00, 0x00, 0x00, 0x00, 0xC0, 0x08, 0x28, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x60, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x80, 0x00, 0x00, 0x00, 0x00, 0x20, 0xA0, 
-	0x40, 0x00, 0x00, 0x00, 0x00, 0xA0, 0x0D, 0x10, 0x08, 0x01, 0x02, 0x2E, 0x00, 0x00, 0x00, 0x20, 
-	0x04, 0x00, 0x00, 0x0F, 0x00, 0x00, 0x00, 0x0A, 0x00, 0x00, 0x00, 0x04, 0x00, 0x00, 0x00, 0x1E, 
-	0x10, 0x00, 0x00, 0x04, 0x00, 0x00, 0x00, 0x00, 0x00, 0x20, 0x00, 0x00, 0x00, 0x00, 0x01, 0x00, 
-	0x01, 0xE1, 0x00, 0x01, 0x00, 0xC0, 0x00, 0x03, 0x86, 0x00, 0x04, 0x00, 0x00, 0x80, 0x20, 0x00, 
-	0x00, 0xA0, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x28, 0x00, 0x00, 0x00, 
-	0x00, 0x80, 0x00, 0x00, 0x00, 0x00, 0x00, 0x02, 0x00, 0x00, 0x00, 0x02, 0xC0, 0x00, 0x08, 0x00, 
-	0x02, 0x74, 0x5C, 0xBF, 0x00, 0x00, 0x08, 0x03, 0x80, 0x05, 0x00, 0x00, 0x00, 0x00, 0x0E, 0x00, 
-	0x1C, 0x60, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x0E, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x38, 0x00, 0x00, 0x00, 0x04, 0x09, 0x20, 0xE0, 0x01, 0xE6, 0x76, 0xA7, 0xA0, 0x00, 0x04, 
-	0x82, 0x08, 0x00, 0x00, 0xA0, 0x00, 0x10, 0x80, 0x20, 0x00, 0x02, 0x00, 0x00, 0x00, 0x00, 0x84, 
-	0x00, 0x00, 0x00, 0x00, 0x20, 0x00, 0x04, 0x00, 0x00, 0x40, 0x00, 0x80, 0x01, 0x10, 0x03, 0x80, 
-	0x00, 0x02, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x08, 0x01, 0x08, 0x00, 0x00, 0x18, 0x00, 
-	0x10, 0x04, 0x00, 0x00, 0x6C, 0x00, 0x00, 0x00, 0x10, 0x00, 0x00, 0x00, 0x00, 0x04, 0x00, 0x00, 
-	0x29, 0x60, 0x00, 0x40, 0x10, 0x00, 0x80, 0xE0, 0x00, 0x09, 0x00, 0x40, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x08, 0x00, 0x10, 0x01, 0x2A, 0x64, 0x00, 0x20, 0x00, 0x20, 0x00, 0x00, 
-	0x40, 0x80, 0x00, 0x00, 0x00, 0x00, 0x00, 0x20, 0x00, 0x00, 0x00, 0xE0, 0x00, 0x00, 0x80, 0x00, 
-	0x00, 0x00, 0x01, 0x00, 0x02, 0x08, 0x34, 0x00, 0x09, 0x00, 0x40, 0x00, 0x00, 0x01, 0x00, 0x08, 
-	0x1A, 0x00, 0x19, 0x80, 0x00, 0x00, 0x0E, 0x00, 0x60, 0x00, 0x40, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x02, 0x41, 0x10, 0x00, 0x00, 0x05, 0x00, 0x01, 0x00, 0x40, 0x00, 
-	0x00, 0x00, 0x10, 0x24, 0x00, 0x00, 0x00, 0x08, 0x00, 0x08, 0x00, 0x2D, 0x98, 0x00, 0x20, 0x00, 
-	0x40, 0x00, 0xE0, 0x00, 0x80, 0x00, 0x00, 0x00, 0x00, 0x00, 0x20, 0x01, 0x40, 0x00, 0xB0, 0x00, 
-	0x00, 0x88, 0x00, 0x0B, 0x10, 0x02, 0x00, 0x02, 0x00, 0x00, 0x20, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x01, 0x80, 0x50, 0x59, 0x90, 0x00, 0x2C, 0x3C, 0x00, 0x00, 0x02, 0x40, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x20, 0x00, 0x01, 0x02, 0x60, 0x01, 0x00, 0x00, 0x10, 0x00, 0x01, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x10, 0x00, 0x08, 0x00, 0x50, 0x01, 0x00, 0x20, 
-	0x20, 0x20, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x20, 0x00, 0x00, 
-	0x2C, 0x00, 0x81, 0x00, 0x80, 0x00, 0x00, 0x03, 0xCC, 0xC0, 0x02, 0x00, 0x14, 0x01, 0x40, 0x08, 
-	0x40, 0x03, 0x00, 0x00, 0x00, 0x08, 0x0A, 0x00, 0x00, 0x18, 0x20, 0x00, 0x00, 0x20, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x40, 0x00, 0x00, 0x00, 
-	0x00, 0x30, 0xCD, 0x00, 0x00, 0x02, 0x00, 0x20, 0x00, 0x04, 0x00, 0x00, 0x02, 0x08, 0x20, 0x90, 
-	0x07, 0xF2, 0x94, 0x00, 0x20, 0x02, 0xE0, 0x14, 0xB9, 0x90, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x20, 0x00, 0x00, 0x04, 0x00, 0x81, 0x00, 0x80, 0x0D, 0x0A, 0x08, 0x01, 0x00, 0x02, 0x00, 0x00, 
-	0x00, 0x00, 0x04, 0x00, 0x00, 0x00, 0x10, 0x00, 0x08, 0x0A, 0x3B, 0x29, 0xC0, 0x00, 0x00, 0x26, 
-	0x02, 0x00, 0x66, 0x00, 0x40, 0x08, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x68, 0x00, 0x00, 0x40, 
-	0x40, 0x00, 0x80, 0x93, 0x00, 0x01, 0x00, 0x00, 0x00, 0x00, 0x1E, 0x00, 0x00, 0x00, 0x00, 0x80, 
-	0x08, 0x00, 0xF0, 0x00, 0x24, 0x00, 0x00, 0x20, 0x03, 0xE3, 0x14, 0x96, 0x60, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x20, 0x01, 0x60, 0x00, 0xA0, 0x00, 0x00, 0x80, 0x07, 0x80, 0x90, 0x02, 0x00, 
-	0x02, 0x00, 0x1C, 0x3B, 0x4F, 0x40, 0x00, 0x00, 0x08, 0x30, 0x00, 0x00, 0x08, 0x00, 0x40, 0x90, 
-	0x00, 0x00, 0x0E, 0x04, 0x00, 0x99, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x14, 0x28, 
-	0x01, 0x02, 0x60, 0x00, 0x30, 0x38, 0x00, 0x00, 0x01, 0x00, 0x00, 0x02, 0x00, 0x27, 0xC0, 0x00, 
-	0x00, 0x00, 0xC0, 0x38, 0x02, 0x50, 0x00, 0x40, 0x00, 0x00, 0x20, 0x0A, 0xC4, 0x03, 0x88, 0x00, 
-	0x00, 0x00, 0x80, 0x00, 0x00, 0x00, 0x20, 0x01, 0xE0, 0x15, 0x00, 0xF0, 0x01, 0x80, 0x00, 0x0D, 
-	0x04, 0x00, 0x00, 0x0E, 0x00, 0x00, 0x00, 0x10, 0x00, 0x00, 0x00, 0x0A, 0x81, 0x00, 0x00, 0x0E, 
-	0x02, 0x04, 0x10, 0x00, 0x01, 0x20, 0x70, 0xFA, 0x80, 0x08, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x0E, 0x01, 0x58, 0xF0, 0x00, 0x30, 0x00, 0x70, 0x10, 0x28, 0x41, 0x00, 0x40, 0x00, 0x06, 
-	0x00, 0x81, 0x00, 0x00, 0x80, 0x80, 0x80, 0x00, 0x08, 0x01, 0x39, 0x08, 0x20, 0x00, 0x01, 0xC0, 
-	0x1C, 0x90, 0x80, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x04, 0x00, 0x00, 0x00, 0x02, 
-	0x00, 0x00, 0x0C, 0x54, 0x2A, 0x80, 0x08, 0x01, 0x24, 0x40, 0x00, 0x00, 0x00, 0x00, 0x08, 0x0B, 
-	0x80, 0x03, 0x98, 0x80, 0x60, 0x40, 0x0E, 0x00, 0x20, 0x69, 0xED, 0x01, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x0E, 0x00, 0x00, 0x28, 0x00, 0x00, 0x00, 0x38, 0x08, 0x70, 0x18, 0x61, 0x55, 0x00, 
-	0xE0, 0x02, 0x07, 0x80, 0x00, 0x00, 0x00, 0x00, 0x82, 0x08, 0x00, 0x00, 0x03, 0x7E, 0x90, 0x00, 
-	0x20, 0x08, 0xC3, 0x40, 0x98, 0x20, 0x00, 0x00, 0x20, 0x00, 0x00, 0x00, 0x20, 0x01, 0x60, 0x00, 
-	0xA6, 0x60, 0x00, 0x80, 0x03, 0x10, 0x50, 0x2A, 0x80, 0x02, 0x00, 0x00, 0x40, 0x00, 0x00, 0x00, 
-	0x00, 0x08, 0x01, 0x00, 0x05, 0x0A, 0xDA, 0x7F, 0x00, 0x04, 0x00, 0x20, 0x2C, 0xDA, 0x82, 0x00, 
-	0x00, 0x01, 0x00, 0x00, 0x00, 0x04, 0x00, 0x0E, 0x00, 0x41, 0x66, 0x08, 0x10, 0x00, 0x81, 0xC8, 
-	0x61, 0x55, 0x00, 0x40, 0x00, 0x06, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x09, 
-	0x65, 0x00, 0x00, 0x80, 0x02, 0x42, 0x40, 0x05, 0x50, 0x00, 0x80, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x01, 0x40, 0x02, 0x00, 0x40, 0x00, 0x00, 0x47, 0x80, 0xBF, 0xA4, 0x00, 0x00, 0x01, 0x14, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x06, 0x60, 0x00, 0x04, 0x00, 0x24, 0x05, 
-	0xEE, 0x55, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x29, 0x40, 0x00, 0x40, 0x10, 
-	0x02, 0x18, 0x07, 0x2C, 0x24, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x10, 0x83, 0x60, 0x84, 0x00, 0x00, 0x03, 0x42, 0x1C, 0xA0, 0x00, 0x00, 0x80, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x02, 0x80, 0x00, 0x40, 0x00, 0x00, 0x00, 0x1B, 0x00, 0x00, 0x18, 0x00, 
-	0x40, 0x14, 0x7D, 0xD9, 0x7A, 0x00, 0x00, 0x00, 0x00, 0x00, 0x08, 0x00, 0xF3, 0xD2, 0x00, 0x00, 
-	0x00, 0x04, 0x04, 0x6E, 0xC0, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xC0, 
-	0x00, 0x60, 0x00, 0x38, 0x01, 0x80, 0x60, 0x41, 0x00, 0x02, 0x43, 0xE6, 0x4E, 0xCD, 0xB0, 0x00, 
-	0x10, 0x00, 0x00, 0x20, 0x10, 0x95, 0x00, 0x20, 0x20, 0x00, 0x00, 0x24, 0x0C, 0x05, 0x50, 0x04, 
-	0x80, 0x00, 0x00, 0x00, 0x00, 0x0A, 0x00, 0x02, 0x80, 0xE0, 0x00, 0x10, 0x00, 0x00, 0x09, 0x9B, 
-	0xC0, 0x00, 0x00, 0x00, 0x14, 0x01, 0xDC, 0x40, 0x08, 0x02, 0x00, 0x00, 0x00, 0x08, 0x08, 0x00, 
-	0x00, 0x10, 0x00, 0x00, 0x06, 0x60, 0x1E, 0xAA, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x40, 
-	0x14, 0x00, 0x01, 0x02, 0x40, 0x00, 0x00, 0x01, 0xD3, 0xF8, 0x80, 0x00, 0x00, 0x03, 0x60, 0x2F, 
-	0x80, 0x00, 0x00, 0x20, 0x02, 0x00, 0x00, 0x00, 0x0D, 0x24, 0x60, 0x00, 0x00, 0x07, 0x62, 0x4C, 
-	0x84, 0x20, 0x00, 0x80, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x40, 0x00, 0x00, 
-	0x00, 0x08, 0x02, 0xC0, 0x18, 0x00, 0x00, 0x80, 0x00, 0x00, 0x00, 0x00, 0x01, 0x40, 0x10, 0x00, 
-	0x00, 0x00, 0x10, 0x20, 0x40, 0x00, 0x80, 0x26, 0x04, 0x00, 0x81, 0x60, 0x00, 0x30, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x14, 0x01, 0x40, 0x00, 0x40, 0x00, 0x04, 0x01, 0xA0, 0x04, 0x09, 0x00, 0x00, 
-	0x04, 0x43, 0x80, 0x00, 0x00, 0x00, 0x00, 0x00, 0x40, 0x00, 0x50, 0x90, 0x29, 0x98, 0x00, 0x00, 
-	0xC0, 0x06, 0xEC, 0xF9, 0x90, 0x04, 0x80, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xF0, 
-	0x01, 0x00, 0x00, 0x00, 0x00, 0x97, 0x52, 0x00, 0x00, 0x00, 0x00, 0x00, 0x0A, 0x00, 0x00, 0x00, 
-	0x00, 0x30, 0x00, 0x05, 0x08, 0x58, 0x59, 0x80, 0x00, 0x00, 0x14, 0x2A, 0x01, 0x66, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x02, 0x40, 0x00, 0x00, 0x01, 0xE9, 0x2C, 
-	0x84, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x24, 0x00, 0x00, 0x00, 0x21, 0x00, 0x51, 0x0B, 0xEB, 
-	0x0C, 0x20, 0x00, 0x00, 0x20, 0x34, 0x9C, 0x80, 0x00, 0x80, 0x00, 0x00, 0x00, 0x00, 0x04, 0x01, 
-	0x40, 0x00, 0x00, 0x00, 0x01, 0x00, 0x0B, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0x2C, 0x3B, 0xD8, 
-	0x00, 0x00, 0x00, 0x00, 0x01, 0x00, 0x0D, 0x9E, 0xDF, 0x10, 0xD2, 0x04, 0x00, 0x54, 0x03, 0xFC, 
-	0x8C, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x28, 0x1C, 0x10, 0x40, 0x70, 0x00, 
-	0x81, 0xC0, 0x00, 0x00, 0x00, 0x00, 0x0A, 0x00, 0x1C, 0xB8, 0x00, 0x00, 0x00, 0x3C, 0x00, 0x00, 
-	0xB9, 0x91, 0x03, 0x30, 0x00, 0x00, 0x04, 0x02, 0xB5, 0x0A, 0xA0, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x01, 0x00, 0x00, 0x02, 0x00, 0x00, 0x80, 0x02, 0x80, 0x18, 0x08, 0x06, 
-	0x14, 0x24, 0x00, 0x00, 0x00, 0x00, 0x00, 0x0B, 0x80, 0x0D, 0x19, 0x82, 0x0C, 0xC0, 0x0E, 0x00, 
-	0x86, 0x06, 0x0C, 0x55, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x0E, 0x00, 0x00, 0x00, 0x1E, 0x10, 
-	0x40, 0xB8, 0x00, 0x71, 0x80, 0x00, 0x09, 0x00, 0xE0, 0x00, 0x00, 0x40, 0x00, 0x00, 0x00, 0x00, 
-	0x02, 0x00, 0x00, 0x00, 0xA0, 0x2F, 0x30, 0x12, 0x00, 0x01, 0xC6, 0xA7, 0xA0, 0x00, 0x00, 0x86, 
-	0x80, 0x00, 0x00, 0x00, 0x04, 0x00, 0x00, 0x00, 0xD0, 0x00, 0x00, 0x00, 0x03, 0x80, 0x00, 0x01, 
-	0x18, 0x00, 0x2B, 0x00, 0x3C, 0x10, 0x00, 0x00, 0x40, 0x00, 0x00, 0x00, 0x05, 0x1E, 0x02, 0x4C, 
-	0xE0, 0x00, 0x00, 0x00, 0x2B, 0xC9, 0x80, 0x00, 0x10, 0x00, 0x00, 0x00, 0x00, 0x00, 0x80, 0x00, 
-	0x00, 0x01, 0x02, 0x40, 0x00, 0x00, 0xF1, 0x81, 0x00, 0x01, 0x00, 0x04, 0x08, 0x00, 0x40, 0xE1, 
-	0x04, 0x00, 0x23, 0x6C, 0x00, 0x00, 0x00, 0x00, 0x2B, 0x30, 0x00, 0x00, 0x00, 0xC7, 0x6E, 0xAC, 
-	0x00, 0x01, 0x00, 0x00, 0x00, 0xB0, 0x00, 0x00, 0x00, 0x04, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x10, 0x9F, 0x40, 0x00, 0x00, 0x00, 0x14, 0x00, 0x0F, 0x00, 0x00, 0x05, 0x52, 0xC0, 0x00, 0x00, 
-	0x00, 0x02, 0x0C, 0xE0, 0x14, 0x00, 0x20, 0x65, 0xFB, 0x0C, 0x00, 0x30, 0x00, 0x00, 0x00, 0x00, 
-	0x04, 0x00, 0x00, 0x20, 0x00, 0x00, 0x00, 0x10, 0x0C, 0x01, 0xCB, 0x3F, 0x30, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x26, 0x04, 0x00, 0x40, 0x00, 0x00, 0x00, 0x00, 0x03, 0x30, 0x00, 0x04, 0x00, 
-	0x64, 0x17, 0xF3, 0x00, 0x00, 0x00, 0x20, 0x80, 0x50, 0x00, 0x00, 0x00, 0xC4, 0x3E, 0xEC, 0x80, 
-	0x00, 0x00, 0x89, 0x0A, 0x00, 0x00, 0x00, 0x00, 0x08, 0x1C, 0x61, 0xC0, 0x08, 0x00, 0x80, 0x07, 
-	0x80, 0x00, 0x00, 0x00, 0x12, 0x0C, 0xE0, 0x00, 0x20, 0x2E, 0x61, 0xEC, 0x0C, 0x00, 0x00, 0x04, 
-	0x71, 0xC8, 0x00, 0x00, 0x00, 0x26, 0x22, 0xDA, 0x8C, 0x00, 0x00, 0x00, 0x80, 0xE0, 0x00, 0x00, 
-	0x00, 0x00, 0x11, 0x63, 0x80, 0x00, 0x04, 0x00, 0x3C, 0x00, 0x00, 0x05, 0x00, 0x00, 0x03, 0x30, 
-	0x00, 0x00, 0x00, 0x44, 0x06, 0x96, 0x00, 0x00, 0x00, 0x0B, 0x00, 0x38, 0x01, 0x00, 0x00, 0x04, 
-	0x1D, 0xD6, 0x60, 0x00, 0x00, 0x20, 0x10, 0x34, 0x00, 0x00, 0x00, 0x40, 0x04, 0x24, 0x00, 0x00, 
-	0x00, 0x03, 0xC0, 0x00, 0x00, 0x00, 0x00, 0x12, 0x0C, 0xE0, 0x00, 0x00, 0x00, 0x29, 0xF8, 0x09, 
-	0x00, 0x00, 0x00, 0xBD, 0xC1, 0x00, 0x00, 0x00, 0x00, 0x21, 0xDE, 0x09, 0x00, 0x00, 0x38, 0x01, 
-	0x83, 0x60, 0x14, 0x00, 0x0A, 0x01, 0xC0, 0x00, 0x00, 0x00, 0x00, 0x03, 0x02, 0x00, 0x00, 0x10, 
-	0x00, 0x27, 0x30, 0x80, 0x00, 0x02, 0x40, 0x0C, 0xB0, 0x60, 0x10, 0x00, 0x00, 0x8E, 0x50, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x11, 0x0E, 0x00, 0x00, 0x00, 0x00, 0x04, 0xA6, 
-	0x03, 0x5F, 0x22, 0x00, 0x00, 0x10, 0x00, 0x00, 0x00, 0x00, 0x02, 0x0C, 0xE0, 0x00, 0x00, 0x24, 
-	0x72, 0x6F, 0x60, 0x00, 0x00, 0x00, 0x39, 0xB0, 0x00, 0x00, 0x00, 0x04, 0x20, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x98, 0x00, 0x00, 0x00, 0x00, 0x00, 0x02, 0x60, 0x2F, 0x88, 0x80, 0x00, 0x00, 0x6C, 
-	0x00, 0x00, 0x00, 0x90, 0x83, 0x30, 0x80, 0x00, 0x01, 0x66, 0xA4, 0xA8, 0x20, 0x04, 0x00, 0x00, 
-	0x80, 0xB0, 0x00, 0x00, 0x00, 0xC0, 0x00, 0x80, 0x00, 0x00, 0x02, 0x00, 0x80, 0x5F, 0x88, 0x80, 
-	0x00, 0x40, 0x00, 0x00, 0x0A, 0x00, 0x00, 0x40, 0x02, 0xF0, 0x00, 0x00, 0x01, 0x52, 0x0C, 0xE0, 
-	0x00, 0x00, 0x0E, 0x2F, 0xCC, 0x28, 0x00, 0x00, 0x00, 0x18, 0x08, 0x00, 0x00, 0x00, 0x20, 0x00, 
-	0x00, 0x02, 0x68, 0x00, 0x00, 0x51, 0x85, 0x7A, 0x20, 0x00, 0x02, 0x00, 0x02, 0x80, 0x00, 0x24, 
-	0x00, 0x0C, 0x00, 0x00, 0x00, 0x11, 0x00, 0x33, 0x30, 0x83, 0x00, 0x41, 0xC3, 0xC3, 0x05, 0x50, 
-	0x03, 0x10, 0x00, 0x10, 0xB0, 0x00, 0x40, 0x00, 0x04, 0x02, 0xA6, 0x60, 0x00, 0x00, 0x07, 0x0A, 
-	0x00, 0x00, 0x00, 0x04, 0x00, 0x04, 0x43, 0x4C, 0x82, 0x00, 0x04, 0xC0, 0x00, 0x00, 0x00, 0x18, 
-	0x02, 0x0C, 0xE0, 0x00, 0x00, 0x0E, 0x05, 0x6A, 0x55, 0x00, 0x30, 0x80, 0x11, 0x80, 0x00, 0x04, 
-	0x40, 0x14, 0x60, 0xE0, 0x66, 0x00, 0x00, 0x00, 0xB8, 0xB0, 0x00, 0x00, 0x00, 0x40, 0xD0, 0x02, 
-	0x8C, 0xE2, 0x80, 0x00, 0x00, 0x00, 0x00, 0x00, 0x08, 0x90, 0x63, 0x30, 0x01, 0x00, 0x01, 0x42, 
-	0xED, 0xEE, 0x22, 0x12, 0x00, 0x00, 0x0D, 0x3A, 0x00, 0x80, 0x00, 0x00, 0x02, 0xC6, 0x60, 0x02, 
-	0x08, 0x00, 0x09, 0xFA, 0x30, 0x20, 0x28, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x01, 0x81, 0x06, 0x4C, 0xE0, 0x0E, 0x00, 0x34, 0x3A, 0x59, 0xA1, 0x40, 0x38, 0x40, 0x00, 
-	0x19, 0x80, 0x2E, 0x00, 0x00, 0x01, 0xC0, 0x66, 0x00, 0x38, 0x10, 0x18, 0xB5, 0xEF, 0x95, 0x01, 
-	0xE0, 0x00, 0x07, 0x80, 0x00, 0x00, 0x00, 0x10, 0x02, 0x00, 0x00, 0x98, 0x90, 0x80, 0x00, 0x08, 
-	0x00, 0x03, 0x60, 0x00, 0x0C, 0xC0, 0x00, 0x00, 0x00, 0x8C, 0x72, 0xC0, 0x00, 0x00, 0x23, 0xF4, 
-	0x00, 0x80, 0x00, 0x00, 0x57, 0x00, 0x5E, 0x20, 0x80, 0x00, 0x01, 0x02, 0x26, 0xCC, 0x00, 0x01, 
-	0x00, 0x00, 0x00, 0x00, 0x09, 0x81, 0x58, 0x00, 0x20, 0x00, 0x00, 0x14, 0x68, 0xD8, 0x33, 0x00, 
-	0x00, 0x40, 0x18, 0x10, 0x00, 0x00, 0x00, 0x06, 0x00, 0x00, 0x00, 0x40, 0x00, 0x02, 0x81, 0xC1, 
-	0x28, 0xA0, 0x00, 0x00, 0x00, 0x60, 0x25, 0xF8, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x10, 0x00, 
-	0x34, 0x00, 0x00, 0x00, 0x03, 0x62, 0xFC, 0x0A, 0xA0, 0x01, 0x00, 0x09, 0x80, 0xB0, 0x00, 0x00, 
-	0x00, 0x00, 0x16, 0x0F, 0xF0, 0x04, 0x00, 0x40, 0x08, 0x07, 0x8C, 0xC0, 0x00, 0x00, 0x80, 0x40, 
-	0x30, 0x55, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x0E, 0x00, 0x00, 0x90, 0x04, 0x00, 0x14, 0x02, 
-	0x1E, 0x55, 0x40, 0x50, 0x00, 0x98, 0x08, 0x00, 0x04, 0x00, 0x00, 0x03, 0x40, 0x00, 0x00, 0x12, 
-	0x02, 0x10, 0x80, 0x68, 0xCC, 0x04, 0x40, 0x04, 0x06, 0x0F, 0xE5, 0x50, 0x10, 0x00, 0x38, 0x00, 
-	0x00, 0x00, 0xD0, 0x2C, 0x00, 0x01, 0x00, 0x00, 0x04, 0x24, 0x0A, 0x50, 0x0C, 0x00, 0x00, 0x00, 
-	0x70, 0x00, 0x00, 0x00, 0x00, 0x01, 0x00, 0x00, 0x80, 0x00, 0x01, 0x10, 0xFF, 0x80, 0x08, 0x60, 
-	0x00, 0x00, 0x02, 0x6C, 0x3C, 0x00, 0x00, 0x00, 0x40, 0x00, 0x00, 0x01, 0x00, 0x40, 0x90, 0x00, 
-	0x04, 0x00, 0x2A, 0x00, 0x5A, 0x40, 0xC0, 0x00, 0x01, 0xE8, 0x00, 0x00, 0x00, 0x00, 0x70, 0x1A, 
-	0x10, 0x41, 0x00, 0x38, 0x80, 0xAF, 0xE4, 0x40, 0x05, 0x00, 0x80, 0x07, 0x86, 0x0C, 0x30, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x81, 0xE1, 0x80, 0x01, 0x00, 0x00, 0x00, 0x00, 0xC0, 0x00, 0x18, 
-	0x00, 0x00, 0x1F, 0x78, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x80, 0x00, 0x20, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x26, 0x24, 0xEB, 0x84, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0x1F, 
-	0x42, 0x40, 0x00, 0x00, 0x00, 0x00, 0x00, 0x02, 0x40, 0x00, 0x00, 0x01, 0xCD, 0x80, 0x00, 0x08, 
-	0x00, 0x00, 0x0C, 0x10, 0x60, 0x40, 0x05, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x02, 0x62, 0x75, 
-	0xD2, 0x10, 0x10, 0x00, 0x02, 0x02, 0x80, 0x70, 0xE0, 0xA3, 0x90, 0x00, 0x00, 0x00, 0x20, 0x14, 
-	0x89, 0x90, 0x00, 0x00, 0x09, 0x00, 0x50, 0x00, 0x00, 0x01, 0x40, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x16, 0x80, 0x10, 0x20, 0x1C, 0x40, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x10, 
-	0x00, 0x1C, 0x77, 0xF9, 0x08, 0x00, 0x00, 0x14, 0x00, 0x00, 0x66, 0x00, 0x00, 0x00, 0x80, 0x00, 
-	0x00, 0x00, 0x00, 0x20, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x05, 0x81, 0x69, 0x00, 0x00, 
-	0x00, 0x02, 0x00, 0x00, 0x00, 0x00, 0x10, 0x00, 0x00, 0x00, 0x50, 0x0D, 0xA4, 0xF0, 0x00, 0x00, 
-	0x00, 0x00, 0x01, 0x00, 0x02, 0x00, 0x03, 0x80, 0x0A, 0x50, 0x00, 0x00, 0x02, 0x42, 0x40, 0x00, 
-	0x40, 0x00, 0x02, 0x81, 0x00, 0x02, 0x26, 0x40, 0x00, 0x00, 0x00, 0x38, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x20, 0x00, 0x00, 0x1E, 0x18, 0x70, 0xC0, 0x00, 0x00, 0x00, 0x00, 0x0E, 0x10, 0x48, 0x40, 
-	0x00, 0x59, 0xD0, 0x00, 0x00, 0x01, 0x74, 0x05, 0x60, 0x00, 0x00, 0x00, 0x00, 0xD8, 0xA5, 0x02, 
-	0x64, 0x00, 0x00, 0x00, 0x00, 0x40, 0x00, 0x00, 0x00, 0x30, 0x00, 0x00, 0x10, 0x00, 0x80, 0x34, 
-	0x00, 0x04, 0x40, 0x00, 0x20, 0x00, 0x00, 0x42, 0x0F, 0x00, 0x05, 0x00, 0x90, 0x00, 0xC0, 0x00, 
-	0x26, 0x41, 0x05, 0x50, 0x04, 0x20, 0x00, 0x00, 0x00, 0x00, 0x00, 0x0C, 0x00, 0x40, 0x00, 0x00, 
-	0x00, 0x00, 0x02, 0x00, 0x00, 0x00, 0x00, 0x01, 0x00, 0x00, 0x90, 0x04, 0x00, 0x1C, 0x01, 0xE0, 
-	0x00, 0x40, 0x30, 0x00, 0xD8, 0x00, 0x00, 0x0C, 0x00, 0x06, 0x64, 0x7A, 0x55, 0x00, 0x40, 0x00, 
-	0x58, 0x00, 0x00, 0x00, 0x00, 0xC0, 0x88, 0x02, 0x80, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0xB0, 0xA5, 0x03, 0xFC, 0x00, 0x00, 0x00, 0x02, 0x00, 0xF0, 0x00, 0x0C, 0x03, 0x0F, 0x00, 0x9A, 
-	0xC0, 0x80, 0x10, 0x20, 0x00, 0x83, 0xC0, 0x80, 0x90, 0x00, 0x00, 0x08, 0x33, 0x08, 0x08, 0x00, 
-	0x00, 0x7A, 0xC0, 0x08, 0x40, 0x00, 0x60, 0x03, 0x83, 0x85, 0x0A, 0xB0, 0x00, 0x00, 0x0E, 0x00, 
-	0x00, 0x04, 0x01, 0x02, 0x48, 0x3C, 0x00, 0x00, 0x03, 0x84, 0x1E, 0x00, 0x86, 0x00, 0x00, 0x3C, 
-	0x69, 0x0A, 0x00, 0x00, 0xE7, 0x20, 0xCC, 0x00, 0xE0, 0x00, 0x07, 0x80, 0x00, 0x04, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x3F, 0x30, 0x10, 0x00, 0x03, 0x43, 0x5C, 0x00, 0x80, 0x00, 0x12, 
-	0x00, 0x0A, 0x32, 0x80, 0x00, 0x00, 0x00, 0x16, 0x0F, 0xF0, 0x08, 0x00, 0x27, 0x00, 0x02, 0xB3, 
-	0x09, 0x00, 0x00, 0x5C, 0x3E, 0x58, 0x10, 0x20, 0x40, 0x00, 0x00, 0x00, 0x01, 0x80, 0x02, 0x4C, 
-	0xC0, 0x00, 0x04, 0x00, 0x06, 0x00, 0x00, 0x50, 0x42, 0x00, 0x01, 0xB0, 0x04, 0x00, 0xA0, 0x06, 
-	0x01, 0x40, 0x00, 0x00, 0x00, 0x04, 0xD0, 0x00, 0x24, 0xCE, 0x00, 0x00, 0x00, 0x00, 0x21, 0xC2, 
-	0x00, 0x04, 0x00, 0x00, 0x11, 0x02, 0x01, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x20, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x40, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x02, 0xC0, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x28, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x20, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x80, 0x00, 0x00, 0x00, 0x00, 0x20, 
-	0x00, 0x00, 0x60, 0x00, 0x00, 0x00, 0x80, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x04, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x28, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x38, 0x00, 0x00, 0x28, 0x00, 
-	0x01, 0x00, 0x10, 0x00, 0x00, 0x80, 0x00, 0x78, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x08, 0x00, 0x00, 0x40, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x03, 0xF0, 0x00, 0xC0, 0x00, 0x00, 0x00, 0x0C, 0x00, 
-	0x03, 0x40, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xC0, 0x00, 0x30, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x04, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x28, 0x00, 0x00, 
-	0x80, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x20, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x02, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x08, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x04, 0x00, 0x00, 0x00, 0x00, 0x00, 0x40, 
-	0x10, 0x00, 0x00, 0x00, 0x00, 0x0C, 0x0A, 0x00, 0x00, 0x00, 0x00, 0x00, 0x30, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0xC0, 0x00, 0x00, 0x00, 0x00, 0x00, 0x03, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x10, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x40, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x3C, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x3C, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x0A, 0xC0, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 0x08, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0xC0, 0x00, 0x00, 0x08, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0xBC, 0x00, 0x78, 0x00, 0x80, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x78, 0x00, 0x00, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0x80, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x08, 0x00, 0x02, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x08, 0x00, 0x00, 0x00, 0xA0, 0x02, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x08, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x20, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x80, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x0A, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x20, 0x00, 0x00, 0x00, 0x00, 0x08, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x20, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x04, 0x00, 0x40, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x04, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x40, 
-	0x00, 0x00, 0x00, 0x04, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x96, 0x81, 0x80, 0x00, 0x00, 0x04, 
-	0x00, 0x00, 0x00, 0x28, 0x00, 0x00, 0x80, 0x00, 0x10, 0x1B, 0x40, 0x00, 0x01, 0x00, 0x06, 0x00, 
-	0x00, 0x00, 0x00, 0x01, 0x54, 0xEC, 0x00, 0x0A, 0x00, 0x40, 0x00, 0x00, 0x00, 0x00, 0x10, 0x1C, 
-	0x28, 0x00, 0x00, 0x01, 0x68, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x08, 0x00, 0x00, 
-	0x40, 0x09, 0xF0, 0x90, 0x00, 0x04, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x80, 0x15, 0x40, 0x00, 
-	0x00, 0xA0, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x04, 0x00, 0x00, 0x00, 0x00, 
-	0x1C, 0x00, 0x14, 0x00, 0x00, 0x00, 0x00, 0x20, 0x00, 0x99, 0xA1, 0x8D, 0x9B, 0x00, 0x1C, 0x05, 
-	0xCC, 0x5B, 0x00, 0x28, 0x00, 0x00, 0x01, 0x55, 0xEC, 0x80, 0x10, 0x03, 0xC0, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x38, 0x00, 0x40, 0x00, 0x00, 0x00, 0x01, 0x00, 0x01, 0x40, 0x00, 0x00, 0x00, 
-	0x05, 0x00, 0x21, 0x98, 0x50, 0x50, 0xA0, 0x00, 0x41, 0x03, 0x30, 0x43, 0x44, 0x10, 0x00, 0x80, 
-	0x15, 0x41, 0x0F, 0x09, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x02, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x40, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x80, 0x00, 0x88, 0x00, 
-	0x00, 0x08, 0x05, 0xCC, 0x17, 0x00, 0x00, 0x00, 0x00, 0x00, 0x05, 0xED, 0xD8, 0x0A, 0x02, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x20, 0x00, 0x00, 0x00, 0x00, 0x08, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x02, 0x00, 0x80, 0x00, 0x50, 0x00, 0x00, 0x81, 0x03, 0x30, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x37, 0x97, 0x00, 0x00, 0x00, 0x00, 0x02, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x0E, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x90, 
-	0x00, 0x00, 0x01, 0x00, 0x00, 0x01, 0xCC, 0x16, 0x00, 0x28, 0x00, 0x00, 0x08, 0x00, 0x1E, 0x00, 
-	0x00, 0x14, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x60, 0x00, 0x00, 0x00, 0x00, 0x01, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0xC0, 0x00, 0xB0, 0x00, 0x08, 0x83, 
-	0x30, 0x40, 0x04, 0x00, 0x00, 0x02, 0x08, 0x01, 0x00, 0x00, 0x00, 0x80, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x80, 0x00, 0xD6, 0x00, 0x00, 0x00, 0x00, 0x01, 0xCC, 0x90, 0x20, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x79, 0xA0, 0x00, 0x00, 0x00, 0x20, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x0C, 0x40, 0x00, 0x00, 
-	0x00, 0x28, 0x83, 0x3B, 0x01, 0x40, 0x00, 0x00, 0x00, 0x00, 0x00, 0x05, 0x00, 0x18, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x20, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x90, 0x00, 0x00, 0x00, 0x00, 0x02, 0x01, 0xCC, 0x17, 0xB6, 0x68, 
-	0x30, 0x00, 0x18, 0x00, 0x0E, 0x00, 0xA0, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x03, 
-	0x40, 0x00, 0x00, 0x00, 0x28, 0x03, 0x30, 0x41, 0x40, 0x00, 0x50, 0x00, 0x08, 0x01, 0x00, 0x00, 
-	0x0C, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x1E, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x90, 0x20, 0x00, 0x00, 0x00, 0x82, 0x01, 0xCC, 
-	0x13, 0x80, 0x04, 0x40, 0x08, 0x08, 0x00, 0x0A, 0x50, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x40, 0x00, 0xB0, 0x04, 0x00, 0x03, 0x30, 0x00, 0x02, 0x80, 0x00, 0x00, 0x08, 
-	0x01, 0x00, 0x0C, 0x00, 0x00, 0x00, 0x00, 0x00, 0x20, 0x87, 0x80, 0x03, 0x80, 0x02, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x08, 0x00, 0x00, 0x00, 0x10, 0x00, 0x00, 0x90, 0x20, 0x00, 0x00, 0x40, 
-	0x08, 0x01, 0xCC, 0x90, 0x04, 0x00, 0x02, 0x04, 0x10, 0x14, 0x60, 0xD0, 0x80, 0x00, 0x00, 0x00, 
-	0x00, 0x80, 0x00, 0x00, 0x00, 0x00, 0x00, 0x20, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xC0, 0x00, 
-	0x00, 0x02, 0x80, 0x00, 0x00, 0x02, 0x40, 0x00, 0x02, 0x00, 0x00, 0x03, 0x3B, 0x00, 0x20, 0x00, 
-	0x50, 0x01, 0x02, 0x80, 0xE3, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x20, 0x00, 0x38, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x1D, 0x08, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x40, 0x00, 
-	0xA5, 0x00, 0x00, 0x00, 0x01, 0xCC, 0x12, 0x06, 0x04, 0x00, 0x00, 0x00, 0xF0, 0x0A, 0x00, 0x10, 
-	0x88, 0x00, 0x00, 0x00, 0x08, 0x20, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x90, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0x00, 0x00, 0x10, 0x50, 0xA0, 0x00, 0x02, 0x03, 0x30, 
-	0x41, 0x62, 0x00, 0x00, 0x00, 0x30, 0xC5, 0xB5, 0x0E, 0x00, 0x40, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x07, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x10, 0x00, 0x00, 0x00, 0x28, 0x00, 
-	0x01, 0x73, 0x05, 0xAD, 0x00, 0x01, 0x00, 0x00, 0xCC, 0x90, 0x00, 0x60, 0x00, 0x70, 0x0A, 0x15, 
-	0xE8, 0x98, 0x10, 0x01, 0xC0, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x10, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 0x01, 0x00, 0x08, 0x00, 0xCC, 0x20, 0x50, 0x00, 0x00, 
-	0x00, 0x83, 0x35, 0x00, 0x00, 0x20, 0x01, 0xA4, 0x22, 0xCF, 0xF9, 0x8E, 0x00, 0x04, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x90, 0x00, 0x07, 0x0E, 0x00, 0x8C, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x73, 0x24, 0x00, 0x00, 0x00, 0x00, 0x00, 0x66, 0x00, 0x14, 0x00, 0x00, 
-	0x30, 0x00, 0x00, 0x00, 0xD8, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x08, 0x00, 0x01, 0x40, 0x09, 0x00, 0x00, 0xC0, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xCE, 0x40, 
-	0x50, 0x00, 0x00, 0x00, 0x89, 0x9D, 0x24, 0x00, 0x00, 0x03, 0x00, 0x00, 0x00, 0x05, 0x0F, 0x00, 
-	0x00, 0x00, 0x02, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x73, 0x24, 0x00, 0x0A, 0x00, 0x00, 0x02, 0x00, 0x00, 
-	0x14, 0x04, 0x00, 0x00, 0x00, 0x02, 0x6D, 0x59, 0xE0, 0x98, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0xCF, 0x40, 0x50, 0x00, 0x00, 0x00, 0x01, 0x00, 0x38, 0x03, 0x80, 0x20, 0x00, 0x14, 0x9D, 
-	0xD0, 0x0E, 0x01, 0x40, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x90, 0x00, 
-	0x00, 0x00, 0x00, 0x40, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x73, 0x04, 0xE0, 0x00, 0x00, 0x40, 
-	0x00, 0x66, 0x00, 0x40, 0x02, 0x80, 0x08, 0x01, 0x05, 0x7C, 0x81, 0x90, 0x00, 0x00, 0x00, 0x20, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x50, 0x00, 0x00, 0x03, 0x40, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x02, 0x00, 0xCC, 0x10, 0x00, 0x00, 0x00, 0x00, 0x89, 0x91, 0x2C, 0x00, 0x00, 0x00, 
-	0x00, 0x10, 0x4C, 0x09, 0x18, 0x34, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x80, 0x80, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x20, 0x80, 0x73, 0x04, 0x80, 
-	0x00, 0x00, 0x00, 0x02, 0x3C, 0x80, 0x00, 0x28, 0x20, 0x04, 0x08, 0x00, 0x1E, 0x58, 0xA0, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x40, 0x08, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x05, 0x00, 0x00, 0xCC, 0x00, 0x00, 0x01, 0x00, 0x20, 0x03, 0xC1, 0x00, 
-	0x00, 0x03, 0x00, 0x20, 0x08, 0x00, 0x00, 0x90, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x40, 0x00, 0x00, 0x00, 0x00, 0x05, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x73, 0x05, 0x88, 0x00, 0x00, 0x00, 0x02, 0x40, 0x00, 0x04, 0x04, 0x00, 0x00, 0x00, 0x00, 0x19, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x24, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x20, 0xCC, 0x10, 0xB0, 0x00, 0x00, 0x00, 
-	0x00, 0x0D, 0x00, 0x02, 0x40, 0x00, 0x02, 0x3F, 0xC1, 0x95, 0x0B, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x02, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x73, 0x04, 0x00, 0x00, 0x00, 0x00, 0x02, 0x00, 0x00, 0x40, 0x01, 0x00, 0x28, 
-	0x00, 0x49, 0x7A, 0x10, 0x80, 0x00, 0x80, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x20, 0xCE, 0x40, 0x00, 
-	0x00, 0x40, 0x00, 0x01, 0x00, 0x30, 0x00, 0x08, 0x00, 0x00, 0x12, 0x16, 0xE0, 0x1B, 0x00, 0x00, 
-	0x00, 0x78, 0x00, 0x10, 0x08, 0x00, 0x00, 0x00, 0x00, 0x00, 0x80, 0x00, 0x10, 0x00, 0x00, 0x00, 
-	0x08, 0x00, 0x00, 0x00, 0x02, 0x00, 0x33, 0x04, 0x05, 0x00, 0x00, 0x04, 0x00, 0x12, 0xD2, 0x6E, 
-	0x6C, 0x00, 0x00, 0x01, 0x9A, 0x1C, 0x01, 0x80, 0x00, 0x00, 0x00, 0x20, 0x40, 0x00, 0xD0, 0x00, 
-	0x38, 0x00, 0x08, 0x60, 0x40, 0x08, 0x00, 0xB0, 0x00, 0x00, 0x53, 0xC4, 0x00, 0x00, 0x40, 0x80, 
-	0xCD, 0xC0, 0x50, 0x00, 0x00, 0x00, 0x04, 0x89, 0xAB, 0xE2, 0x00, 0x00, 0x00, 0x19, 0x8C, 0x0B, 
-	0x10, 0x00, 0x00, 0x00, 0x00, 0x00, 0x10, 0x08, 0x00, 0x00, 0x40, 0x04, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x1C, 0x00, 0x7A, 0x00, 0x00, 0x07, 0x00, 0xA1, 0x6F, 0x80, 0x0E, 0x01, 0x1C, 0x00, 
-	0x33, 0xF7, 0x7C, 0x3C, 0x00, 0x70, 0x01, 0x08, 0x1D, 0x00, 0xA0, 0x01, 0xC0, 0x00, 0x00, 0x00, 
-	0x00, 0x70, 0x00, 0x34, 0x00, 0x40, 0x00, 0x00, 0x00, 0x00, 0xA0, 0x00, 0x42, 0x57, 0x9C, 0x3C, 
-	0x00, 0x02, 0x06, 0x2D, 0xDF, 0xD1, 0xE1, 0x00, 0x00, 0x02, 0x17, 0xE4, 0x62, 0x80, 0x01, 0x00, 
-	0x09, 0x15, 0xD0, 0x10, 0x00, 0x04, 0x00, 0x00, 0x00, 0x2C, 0xC1, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x80, 0x00, 0x00, 0x00, 0x00, 0x0C, 0x00, 0x00, 0x00, 0x04, 0x03, 0x00, 0x19, 0xA1, 0x83, 0x8F, 
-	0x40, 0x00, 0x00, 0x01, 0x12, 0xF6, 0x74, 0x00, 0x00, 0x02, 0x06, 0x01, 0x00, 0xA4, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x33, 0xB0, 0x00, 0x00, 0x00, 0x00, 0x20, 0x40, 0x08, 0x00, 0x00, 0x00, 0xC0, 
-	0x02, 0x40, 0x34, 0x00, 0x68, 0x01, 0x99, 0x40, 0xD0, 0x88, 0x10, 0x00, 0x00, 0x01, 0xAC, 0xC7, 
-	0xC0, 0x00, 0x01, 0x10, 0xBC, 0xE0, 0x08, 0x38, 0x00, 0x00, 0x02, 0x00, 0x04, 0x28, 0x60, 0x60, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x05, 0xC2, 0x10, 0x00, 0x00, 0x19, 
-	0x80, 0x05, 0x0A, 0x00, 0x00, 0x02, 0x00, 0x00, 0x46, 0x21, 0x00, 0x00, 0x09, 0x00, 0x00, 0x02, 
-	0x00, 0x14, 0x00, 0x00, 0x00, 0x00, 0x42, 0x50, 0x00, 0x2C, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x03, 0x80, 0x42, 0x80, 0x40, 0x22, 0x65, 0xCC, 0x00, 0xA0, 0x40, 0x20, 0x01, 
-	0x00, 0x2F, 0xC2, 0x80, 0x00, 0x04, 0x00, 0x1C, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x2C, 
-	0xC8, 0x7A, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x04, 0x00, 0x00, 
-	0x00, 0x00, 0x1A, 0x45, 0xA0, 0x19, 0x01, 0x40, 0x00, 0x84, 0x73, 0x5C, 0x04, 0x15, 0x00, 0x09, 
-	0x00, 0x00, 0x78, 0x01, 0x80, 0x00, 0x00, 0x00, 0x00, 0x33, 0xD0, 0x04, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x03, 0x1C, 0x00, 0x00, 0x40, 0x01, 0xA4, 0xE0, 0x01, 0xE0, 
-	0x00, 0x00, 0x02, 0x13, 0x7C, 0x03, 0xC0, 0x20, 0x01, 0x00, 0x24, 0x00, 0x8B, 0x00, 0x80, 0x40, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x20, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x40, 
-	0x64, 0x42, 0x40, 0x00, 0x00, 0x2A, 0x94, 0xA0, 0x00, 0x80, 0x00, 0x00, 0x03, 0xF2, 0xF4, 0x68, 
-	0x00, 0x00, 0x00, 0x27, 0x40, 0x51, 0x90, 0x00, 0x00, 0x80, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x07, 0x00, 0x30, 0x00, 0x40, 0x02, 0xA8, 
-	0x20, 0x00, 0xF4, 0xC0, 0x01, 0x00, 0x0B, 0x22, 0x60, 0x07, 0x00, 0x00, 0x01, 0xBC, 0x81, 0x19, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x07, 0x80, 
-	0x80, 0x00, 0x00, 0x04, 0xC0, 0x40, 0x00, 0x80, 0x05, 0x35, 0xF0, 0x1F, 0xA0, 0x00, 0x02, 0x00, 
-	0x00, 0x16, 0x60, 0x00, 0x00, 0x00, 0x30, 0x7A, 0x18, 0x80, 0x04, 0x08, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x02, 0xC0, 0x30, 0x01, 
-	0x40, 0x01, 0x07, 0x58, 0x10, 0x98, 0x00, 0x00, 0x01, 0x00, 0x24, 0x03, 0xC0, 0x00, 0x01, 0x00, 
-	0x0D, 0xE0, 0x8F, 0x08, 0xC0, 0x40, 0x00, 0x00, 0x25, 0xA0, 0x68, 0x00, 0x40, 0x02, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x05, 0xC0, 0x00, 0x02, 0x01, 0x24, 0x1E, 0x85, 0x01, 0x00, 
-	0x08, 0x00, 0x33, 0x9A, 0xC4, 0x00, 0x00, 0x00, 0x01, 0x04, 0xEE, 0x10, 0xA0, 0x14, 0x00, 0x00, 
-	0x00, 0x00, 0x5A, 0x04, 0x00, 0x20, 0x00, 0x20, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x03, 
-	0x40, 0x30, 0x00, 0x60, 0x00, 0x27, 0x79, 0xD8, 0xE0, 0x00, 0x00, 0x00, 0x03, 0x68, 0x22, 0x40, 
-	0x00, 0x00, 0x10, 0x6D, 0x05, 0x10, 0x00, 0x00, 0x00, 0x80, 0x00, 0x00, 0x00, 0x01, 0x60, 0x00, 
-	0x02, 0x00, 0x80, 0x00, 0x85, 0x0A, 0xA0, 0x48, 0x00, 0x00, 0x00, 0x00, 0x80, 0x00, 0x00, 0x00, 
-	0x00, 0x01, 0x18, 0x08, 0x00, 0x33, 0xDF, 0x00, 0x01, 0x70, 0x20, 0x00, 0x00, 0x0C, 0x18, 0x00, 
-	0x8C, 0xC0, 0x08, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x40, 0x00, 0x80, 0x10, 0xD9, 0x04, 
-	0x09, 0x00, 0x53, 0x40, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x70, 0xC0, 0x01, 0x00, 0x00, 0x09, 
-	0x2C, 0x00, 0x00, 0x04, 0x00, 0x08, 0x01, 0x00, 0x00, 0x00, 0xD0, 0x00, 0x80, 0x00, 0x24, 0x00, 
-	0x00, 0x00, 0x00, 0x07, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x14, 0x08, 0x70, 0x07, 0xE0, 0x87, 
-	0x00, 0x00, 0x00, 0x08, 0x01, 0x00, 0x1C, 0x00, 0x82, 0xFA, 0xC0, 0x20, 0x00, 0x70, 0x10, 0x07, 
-	0xDF, 0xD0, 0x18, 0x01, 0x48, 0x08, 0x00, 0x8C, 0x00, 0x90, 0x00, 0x00, 0x00, 0x10, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x01, 0x48, 0x37, 0x9C, 0x79, 0x00, 0x10, 0x00, 0x00, 0x00, 0x30, 0xE0, 0x00, 
-	0x41, 0x02, 0x8B, 0x22, 0xC4, 0x00, 0x01, 0x00, 0x00, 0x16, 0xFB, 0x0E, 0x00, 0x14, 0x00, 0x80, 
-	0x00, 0x00, 0x00, 0x00, 0xE7, 0x00, 0x03, 0x00, 0x80, 0x00, 0x01, 0x88, 0x00, 0x08, 0x00, 0x05, 
-	0xE7, 0x80, 0x02, 0x00, 0x33, 0x0C, 0x09, 0x01, 0x04, 0x08, 0x02, 0x00, 0x07, 0x94, 0x20, 0x00, 
-	0x00, 0x08, 0x06, 0xE1, 0x78, 0x00, 0x00, 0x00, 0x08, 0x00, 0x00, 0x00, 0x00, 0x14, 0x00, 0x00, 
-	0x62, 0x00, 0x40, 0x09, 0x08, 0x00, 0x01, 0xC0, 0x03, 0x00, 0x40, 0x00, 0x30, 0x03, 0x31, 0xE0, 
-	0xF0, 0xA0, 0x11, 0x88, 0x02, 0x00, 0x00, 0x20, 0x03, 0x04, 0x04, 0x00, 0xBE, 0x87, 0x80, 0x00, 
-	0x10, 0x00, 0x83, 0x00, 0x20, 0x00, 0x29, 0x47, 0x10, 0x00, 0x00, 0x80, 0x01, 0xA0, 0x0A, 0x00, 
-	0x00, 0x00, 0x06, 0x03, 0x80, 0x00, 0x00, 0x04, 0xB4, 0x98, 0x1C, 0x00, 0x00, 0x02, 0x08, 0x30, 
-	0x00, 0x02, 0x00, 0x08, 0x01, 0x98, 0x0C, 0x00, 0xB4, 0x08, 0x00, 0x08, 0x00, 0x80, 0x20, 0x04, 
-	0x00, 0x6A, 0x50, 0x40, 0x00, 0x80, 0x00, 0x01, 0xB0, 0x01, 0x00, 0x02, 0xDC, 0x24, 0x00, 0x00, 
-	0x42, 0x13, 0xEA, 0xF1, 0xA0, 0x01, 0x00, 0x00, 0x00, 0x80, 0x03, 0x90, 0x04, 0x00, 0x19, 0x8C, 
-	0x00, 0x09, 0x00, 0x10, 0x00, 0x00, 0x00, 0x00, 0x55, 0xAE, 0x00, 0x00, 0x00, 0x80, 0x80, 0x00, 
-	0x80, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x1C, 0xB6, 0xE1, 0x00, 0x40, 0x00, 
-	0x02, 0x08, 0x70, 0x06, 0x00, 0x70, 0x00, 0x00, 0x25, 0xCC, 0x19, 0x94, 0x00, 0x00, 0x00, 0x20, 
-	0x10, 0x00, 0x06, 0xCC, 0x00, 0x00, 0x40, 0x00, 0x80, 0x00, 0x00, 0x00, 0x01, 0x00, 0x03, 0xBC, 
-	0x00, 0x30, 0x08, 0x01, 0xC9, 0x60, 0x00, 0x08, 0x01, 0x01, 0x00, 0x00, 0x81, 0x40, 0x28, 0x04, 
-	0x00, 0x02, 0x74, 0x07, 0x99, 0x0C, 0x10, 0x00, 0x00, 0x08, 0x60, 0x85, 0x80, 0x00, 0x08, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x20, 0x00, 0x10, 0x64, 0x02, 0x40, 0x00, 0x00, 0x80, 0x01, 0x80, 
-	0x00, 0x00, 0x00, 0x02, 0x00, 0x07, 0x8E, 0x78, 0x00, 0x00, 0x00, 0x32, 0xEC, 0x10, 0x10, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0x00, 0x40, 0x00, 0x00, 0x00, 0x00, 0x04, 0x01, 
-	0x00, 0x02, 0x04, 0x38, 0x00, 0x00, 0x40, 0x80, 0x10, 0x00, 0x00, 0x01, 0x08, 0x02, 0x00, 0x40, 
-	0x06, 0x40, 0x04, 0x00, 0x00, 0x25, 0x90, 0x08, 0x0C, 0x10, 0x00, 0x00, 0x00, 0x0A, 0x5D, 0x68, 
-	0x00, 0x00, 0x00, 0x00, 0x82, 0x16, 0x00, 0x08, 0x00, 0x00, 0x00, 0x04, 0x07, 0xC0, 0x00, 0x00, 
-	0x01, 0x54, 0xB0, 0x1C, 0x01, 0x40, 0x02, 0x08, 0x30, 0x00, 0x01, 0x02, 0x00, 0x00, 0x00, 0x0E, 
-	0xD0, 0xC0, 0x00, 0x00, 0x00, 0x00, 0x80, 0x7B, 0xDA, 0x80, 0x00, 0x00, 0x48, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x01, 0x00, 0x02, 0x40, 0x38, 0xD0, 0x00, 0x00, 0x00, 0x18, 0x00, 0x90, 0x01, 0x00, 
-	0x00, 0x00, 0x83, 0xC0, 0x0B, 0x04, 0x00, 0x08, 0x01, 0x09, 0x8B, 0x00, 0x10, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x20, 0x3C, 0x14, 0x00, 0x00, 0x00, 0x00, 0x00, 0x04, 0x00, 
-	0x00, 0x02, 0x00, 0x00, 0x00, 0x08, 0x00, 0x00, 0x08, 0x02, 0x00, 0x07, 0x14, 0x28, 0x00, 0x00, 
-	0x02, 0x12, 0x7A, 0x70, 0xA0, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x40, 
-	0x03, 0xC0, 0x00, 0x00, 0x00, 0x01, 0x00, 0x02, 0x80, 0x00, 0x30, 0x30, 0x00, 0x00, 0x00, 0x90, 
-	0x00, 0x01, 0x01, 0x02, 0x00, 0x00, 0x02, 0x80, 0x04, 0x00, 0x08, 0x5E, 0xB1, 0x19, 0x08, 0x10, 
-	0x00, 0x80, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x02, 0x00, 0x00, 0x00, 0x09, 0x80, 0xA0, 0x48, 
-	0x08, 0x04, 0x00, 0x00, 0x12, 0x00, 0x00, 0x00, 0x08, 0x1E, 0x01, 0x4C, 0x00, 0x00, 0x00, 0x00, 
-	0x38, 0x12, 0x38, 0x08, 0x20, 0xE0, 0x80, 0x10, 0x02, 0xC0, 0x08, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x40, 0x00, 0x00, 0x00, 0x10, 0x04, 0x09, 0x00, 0xB3, 0xDC, 0x00, 0x00, 0x40, 0x00, 
-	0x00, 0x00, 0x51, 0x00, 0x1D, 0x00, 0x00, 0x00, 0x00, 0x04, 0x00, 0x04, 0x00, 0x00, 0x00, 0x0F, 
-	0x0B, 0x00, 0x50, 0x00, 0x80, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x80, 0x00, 0x00, 
-	0x00, 0x00, 0x14, 0x00, 0x6C, 0x03, 0x90, 0x07, 0x85, 0x2F, 0x60, 0x18, 0x1F, 0x40, 0x1E, 0x02, 
-	0x45, 0x1F, 0x94, 0x3E, 0x00, 0x60, 0x08, 0x00, 0x08, 0x79, 0xC0, 0x03, 0x80, 0x08, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x02, 0x00, 0x00, 0x00, 0x40, 0x09, 0x00, 0x00, 0x01, 0x00, 0xF2, 0x3C, 0x78, 
-	0x00, 0x02, 0x11, 0xF9, 0x48, 0x70, 0xE2, 0x00, 0x00, 0x08, 0xF7, 0x20, 0x22, 0x90, 0x01, 0x00, 
-	0x08, 0x01, 0x00, 0x10, 0x00, 0x04, 0x00, 0x80, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x82, 0x16, 0x00, 0x00, 0xA0, 0x4C, 0x00, 0x05, 0xE0, 0x00, 0x22, 0x00, 0x80, 0x00, 0x00, 0x00, 
-	0x00, 0x08, 0x00, 0x08, 0x50, 0x36, 0x38, 0x70, 0x20, 0x00, 0xFD, 0x40, 0x70, 0x10, 0x02, 0xC0, 
-	0x08, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x40, 0x00, 0x00, 0x00, 0x00, 0x04, 0x09, 0xC0, 
-	0x03, 0xAE, 0x02, 0x70, 0x60, 0x20, 0x40, 0x0C, 0x00, 0xC0, 0x01, 0x80, 0x00, 0x00, 0x81, 0x64, 
-	0x00, 0x47, 0x45, 0x0F, 0xC4, 0x00, 0x0A, 0x01, 0x1C, 0x00, 0x80, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x90, 0x20, 0x00, 0x01, 0x00, 0x00, 0x00, 0x00, 0x07, 0x80, 0x00, 0x00, 0x00, 
-	0x00, 0x08, 0x01, 0x00, 0x00, 0x00, 0xFF, 0x07, 0xDC, 0x00, 0x00, 0x00, 0x08, 0x21, 0x60, 0x70, 
-	0x00, 0x00, 0x00, 0x08, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x40, 0x00, 0x01, 0xC0, 0x00, 
-	0x80, 0x01, 0x00, 0x03, 0x80, 0x00, 0x00, 0x40, 0x00, 0x00, 0x00, 0x30, 0xB0, 0x01, 0x01, 0x00, 
-	0x00, 0x70, 0x00, 0x00, 0x04, 0x00, 0x00, 0x02, 0x00, 0x80, 0x00, 0x10, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x82, 0x0C, 0x00, 0x18, 0x00, 0x00, 0x00, 0x04, 0x03, 0x88, 
-	0x40, 0x00, 0x80, 0x00, 0x80, 0x01, 0x00, 0x80, 0x02, 0x0A, 0x3A, 0x00, 0x04, 0x00, 0x00, 0x00, 
-	0x14, 0xDF, 0x01, 0x84, 0x10, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x40, 0x00, 
-	0x00, 0x00, 0x00, 0x80, 0x01, 0x00, 0x02, 0x5C, 0x00, 0x07, 0x40, 0x00, 0x80, 0x00, 0x00, 0xC1, 
-	0x05, 0x01, 0x00, 0xA0, 0x80, 0x02, 0x40, 0x04, 0x00, 0x36, 0xF4, 0xF7, 0x00, 0x80, 0x90, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x80, 0x00, 0x10, 0x18, 0x00, 0x00, 0x10, 
-	0x2A, 0x00, 0x02, 0x00, 0x00, 0x33, 0x2E, 0x08, 0x01, 0x00, 0x02, 0x02, 0x85, 0x3E, 0xFC, 0x20, 
-	0x10, 0x00, 0x09, 0x02, 0x00, 0x01, 0xC0, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x40, 0x00, 0x40, 0x0F, 0x00, 0x00, 0x01, 0x00, 0x07, 0x3C, 0x00, 0x00, 0x40, 0x03, 0x33, 
-	0x40, 0x70, 0x90, 0x01, 0x00, 0x06, 0xE1, 0xE6, 0x40, 0x00, 0x04, 0x00, 0x00, 0x24, 0x00, 0x10, 
-	0x00, 0x10, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x80, 0x00, 0x03, 0x80, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x20, 0x00, 0x00, 0x29, 0xF5, 0xF0, 0x00, 0x00, 0x00, 0x06, 0x45, 
-	0x7E, 0x00, 0x06, 0x05, 0x00, 0x28, 0x00, 0x18, 0x30, 0x0A, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x40, 0x40, 0x40, 0x09, 0x08, 0x00, 0x01, 0x00, 0x03, 0x44, 0x30, 0x00, 
-	0x40, 0x00, 0x98, 0x5D, 0x00, 0x00, 0x01, 0x00, 0x08, 0xF3, 0xA8, 0x03, 0x90, 0x24, 0x00, 0x08, 
-	0x00, 0x00, 0x00, 0x20, 0x10, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x80, 
-	0x00, 0x18, 0x01, 0x00, 0x00, 0x00, 0x01, 0x67, 0x80, 0x22, 0x00, 0x82, 0x06, 0x00, 0x00, 0x08, 
-	0x08, 0x00, 0x00, 0x00, 0x24, 0x78, 0x00, 0x00, 0x08, 0x00, 0x0C, 0x10, 0x10, 0x08, 0x80, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x40, 0x40, 0x40, 0x0C, 0x10, 0xB0, 0x01, 0x00, 0x02, 
-	0xC2, 0x40, 0x05, 0x60, 0x00, 0x00, 0x20, 0x70, 0x00, 0x01, 0x00, 0x00, 0x00, 0x01, 0x44, 0x00, 
-	0x04, 0x01, 0x08, 0x01, 0x00, 0x8E, 0x1D, 0x50, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x20, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x40, 0x80, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x18, 0x04, 0x12, 0x00, 0x00, 0x2E, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x81, 
-	0x50, 0x00, 0x00, 0x20, 0x00, 0x00, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x52, 0xE4, 0x38, 0x00, 0x00, 0x00, 0x00, 0x00, 0x70, 0x00, 0x04, 0x10, 0x01, 0x00, 
-	0x38, 0xC0, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x10, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x80, 0x00, 0xA0, 0x01, 0x00, 0x1C, 0x00, 0x66, 0x02, 0x50, 0x87, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x80, 0x1A, 0x00, 0x42, 0x06, 0x20, 0x04, 0x00, 0x70, 0x00, 0x00, 
-	0x00, 0x01, 0xE4, 0x01, 0xC8, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x08, 0x20, 0x80, 
-	0x00, 0x00, 0xD0, 0x00, 0x40, 0x76, 0xAC, 0x78, 0x00, 0x10, 0x00, 0x00, 0x00, 0x00, 0x04, 0x00, 
-	0x40, 0xC4, 0x2D, 0x40, 0x43, 0x40, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0xA0, 0x04, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x90, 0x20, 0x07, 0x88, 0x00, 0x08, 0x00, 0x07, 
-	0xE7, 0x80, 0x02, 0x00, 0x00, 0x00, 0x07, 0x18, 0x14, 0x88, 0x02, 0x40, 0x00, 0x00, 0x00, 0x60, 
-	0x00, 0x40, 0x01, 0x7D, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x60, 0x01, 0xC0, 0x08, 0x01, 0x40, 0xC0, 0x02, 0x3E, 0x40, 0x00, 0x20, 0x00, 0x00, 0x00, 
-	0x09, 0x00, 0x04, 0xD1, 0x00, 0x09, 0x00, 0x40, 0x00, 0x00, 0x80, 0x14, 0x03, 0xB0, 0x00, 0x00, 
-	0x00, 0x00, 0x03, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x07, 0xC0, 0x00, 0x00, 0x82, 0x1C, 0x00, 0x00, 0x00, 0x00, 0x10, 0x96, 0x7E, 
-	0x84, 0x00, 0x20, 0x00, 0x00, 0x00, 0x00, 0xF8, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x02, 0xC0, 0x3C, 0x00, 0x00, 
-	0x20, 0x00, 0x00, 0x00, 0x01, 0xC0, 0x00, 0x09, 0x69, 0xC0, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x0B, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x01, 0x00, 0x00, 0x04, 0x00, 0x00, 0x00, 0x00, 0x80, 0x00, 0x00, 0x1A, 0x14, 0x02, 
-	0x02, 0x40, 0x80, 0x20, 0x02, 0xD0, 0x0C, 0x11, 0x7C, 0x69, 0x00, 0x00, 0x00, 0x00, 0x00, 0x20, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0xC8, 0x00, 0x03, 0x00, 
-	0x00, 0xB5, 0x00, 0x00, 0x40, 0x09, 0x00, 0x00, 0x10, 0x10, 0x00, 0x01, 0x02, 0xC3, 0xF8, 0x00, 
-	0x02, 0x29, 0x40, 0xF0, 0x00, 0x00, 0x80, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x81, 0x82, 0x06, 0x00, 0x00, 0x00, 0x00, 0x10, 0x25, 0xC0, 0x00, 0x20, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x1A, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x02, 0x1E, 0x3C, 0x04, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x2F, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x04, 0x00, 0x40, 0x40, 0x00, 
-	0x90, 0x00, 0x00, 0x0A, 0x00, 0x00, 0x02, 0x08, 0x50, 0x00, 0x20, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x08, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x03, 0x40, 0x38, 0x72, 0x00, 0x00, 0x01, 0x40, 0x00, 0x00, 0x10, 0x00, 
-	0x00, 0x00, 0x80, 0x00, 0x03, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x08, 0x00, 0x00, 0x00, 0x04, 0x00, 
-	0x00, 0x02, 0x01, 0x90, 0x00, 0x00, 0x00, 0x00, 0x08, 0x00, 0x8F, 0xB3, 0x7E, 0x04, 0x05, 0x00, 
-	0x08, 0x00, 0x1A, 0x30, 0x00, 0x00, 0x80, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x03, 0x40, 0x02, 0x02, 0x30, 0x00, 0x00, 0xC0, 0x00, 
-	0x00, 0x00, 0x00, 0x08, 0xAF, 0xB9, 0x42, 0x80, 0x20, 0x00, 0x08, 0x01, 0x00, 0x80, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x08, 0x00, 0x03, 0x80, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x28, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x04, 0x00, 0x40, 0x00, 0x20, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x53, 0xDC, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x80, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x08, 0x62, 0x00, 0x00, 0x07, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x1C, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x70, 0x00, 0x00, 0x01, 0x00, 0x00, 0x01, 0xC8, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x37, 0xBC, 0x3C, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x40, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0x00, 
-	0x04, 0x00, 0xC0, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0xC0, 0x3C, 0x12, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0xC0, 0x00, 0xC0, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x03, 0x42, 0x03, 0x03, 0x30, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x10, 0x00, 0x08, 0x00, 0x03, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x20, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x04, 0x03, 0x90, 0x00, 0x00, 0x00, 
-	0x00, 0x07, 0x1A, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x03, 0x80, 0x42, 0x80, 0x00, 0x00, 0x00, 0x00, 0x09, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x20, 0x20, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x06, 0x00, 0x00, 
-	0x00, 0x01, 0x00, 0x1F, 0xF0, 0x00, 0x10, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x08, 
-	0x00, 0x00, 0x80, 0x04, 0x00, 0x00, 0x00, 0x20, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x03, 0xEC, 0x00, 0x00, 0x0A, 0x00, 0x40, 0xDB, 0x00, 0xE0, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x04, 0x04, 0x00, 0xAB, 0x00, 0x80, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x70, 0x47, 0x80, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x05, 0x00, 0x00, 0x00, 0x00, 0x00, 0xA0, 0x14, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x20, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x02, 0x02, 0x00, 0x78, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x02, 0x20, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x80, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x01, 0x60, 0x60, 0x00, 0x00, 0x80, 0x00, 0x10, 0x00, 0x40, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x02, 0x08, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x02, 0x42, 0x30, 0x00, 
-	0x04, 0x00, 0x40, 0x0A, 0x00, 0x08, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x20, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x40, 0x00, 0x05, 0xE0, 0x40, 0x02, 0x00, 0x00, 0x00, 0x08, 0x01, 0x20, 
-	0x08, 0x82, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x80, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x03, 
-	0x40, 0x2C, 0x00, 0x20, 0x00, 0x00, 0x00, 0xB0, 0xD4, 0x00, 0x21, 0x01, 0x00, 0x20, 0x00, 0x05, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x78, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x90, 0x00, 0x00, 0x00, 0x80, 0x00, 0x08, 0x06, 0x02, 0x05, 0x80, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x62, 0x82, 0x10, 0x00, 0x00, 0x00, 0x80, 0x00, 
-	0x10, 0x00, 0x00, 0x20, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x03, 0xC0, 0x00, 0x04, 
-	0x00, 0x00, 0x93, 0x3C, 0x38, 0x00, 0x80, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x02, 0xD0, 0x10, 0x00, 0x00, 0x00, 0x0F, 0x00, 0x2C, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x02, 0x0C, 0x2E, 0x00, 0x00, 0x04, 0x1C, 0x00, 0x68, 0x00, 0x00, 0xA7, 
-	0x00, 0x08, 0x0F, 0xC8, 0x01, 0x00, 0x1C, 0x00, 0x00, 0x1E, 0x00, 0x00, 0x00, 0x68, 0x01, 0x68, 
-	0x00, 0x98, 0x10, 0x15, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x10, 0xC1, 
-	0x40, 0x00, 0x00, 0x00, 0x41, 0xF3, 0x8C, 0x00, 0x00, 0x10, 0x40, 0x81, 0xD0, 0x50, 0xF0, 0x00, 
-	0x60, 0x0A, 0x00, 0xAB, 0x42, 0xC6, 0x01, 0x00, 0x29, 0x40, 0xB7, 0x8C, 0x0C, 0x94, 0x20, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x90, 0x00, 0x00, 0x00, 0x80, 0x00, 0x00, 0x00, 
-	0x03, 0x80, 0x02, 0x00, 0x3F, 0x1F, 0xE0, 0x0E, 0x00, 0x0C, 0x04, 0x08, 0x7B, 0x00, 0x01, 0x50, 
-	0x08, 0x00, 0x60, 0x01, 0xF0, 0xE1, 0x80, 0x80, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0xC0, 0x00, 0x04, 0x00, 0x00, 0x03, 0x80, 0x40, 0x30, 0x20, 0x01, 0xF1, 0x5E, 
-	0x00, 0x00, 0x00, 0xC0, 0x00, 0x8B, 0x00, 0x02, 0xE2, 0x00, 0x80, 0x09, 0x24, 0x9D, 0x10, 0xB9, 
-	0x0C, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x20, 0x00, 0x80, 0x00, 0xC0, 0x00, 0x00, 
-	0x00, 0x00, 0x04, 0x07, 0x80, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x14, 0x7A, 0x80, 0x00, 0x11, 0x68, 0x01, 0x00, 0x00, 0x14, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x30, 0x00, 0x00, 0x80, 0x10, 0x00, 0x80, 0x00, 0x00, 0x03, 0x00, 0x40, 0x41, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x04, 0x10, 0x00, 0x02, 0x29, 0x40, 
-	0x99, 0x08, 0x00, 0x80, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x08, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0x20, 0x3F, 0xC0, 0x00, 0x14, 0x00, 
-	0x00, 0x00, 0x02, 0x00, 0x68, 0x60, 0x00, 0x08, 0x15, 0x7A, 0x00, 0x0A, 0x00, 0x00, 0x00, 0x2C, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x10, 0x80, 0x00, 0x00, 0x03, 0x00, 
-	0x3C, 0x70, 0x00, 0x01, 0x42, 0x7A, 0x00, 0x02, 0x00, 0x00, 0x05, 0xA0, 0x3B, 0x40, 0x28, 0x00, 
-	0x20, 0x01, 0x41, 0x00, 0x00, 0x40, 0x00, 0x00, 0x00, 0x40, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x01, 0xE0, 0x00, 0x10, 0x2D, 0xC3, 0x84, 0x00, 0x00, 0x00, 0x00, 0x01, 
-	0x80, 0x00, 0x00, 0x06, 0x5A, 0x07, 0x96, 0x00, 0x80, 0x02, 0x0B, 0x9E, 0x1F, 0x00, 0xA0, 0x14, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xE4, 0x00, 
-	0x00, 0x03, 0x42, 0x7D, 0x00, 0x00, 0x00, 0x00, 0x00, 0xD8, 0xB0, 0x00, 0x19, 0x85, 0xA0, 0x00, 
-	0x00, 0x00, 0x10, 0x00, 0x30, 0xCD, 0xB0, 0x00, 0x00, 0x80, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0x80, 0x01, 0x40, 0x00, 0x00, 0x07, 0xC0, 0x00, 0x00, 
-	0x90, 0x00, 0x07, 0x98, 0x00, 0x00, 0x00, 0x5A, 0x57, 0x40, 0x20, 0x03, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x08, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x08, 0x00, 0x02, 0x04, 0x78, 0x04, 0x00, 0x10, 0x01, 0xC0, 0x08, 0xB0, 0x00, 0x00, 
-	0x00, 0xA0, 0x68, 0x00, 0x00, 0x70, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x10, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x02, 
-	0x85, 0x03, 0x01, 0x2B, 0xCF, 0xC8, 0x00, 0x00, 0x88, 0x04, 0xC2, 0xDA, 0x40, 0x64, 0x35, 0x20, 
-	0x00, 0x00, 0x00, 0x10, 0x00, 0x00, 0x80, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x02, 0x00, 0x40, 0x00, 0x34, 0x02, 0xBC, 0x20, 0xB0, 
-	0x80, 0x14, 0x80, 0x0C, 0x07, 0xB4, 0x02, 0x00, 0x20, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x08, 
-	0x00, 0x00, 0x11, 0x03, 0x01, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x20, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x80, 0x00, 0x00, 0x00, 0x00, 0x00, 0x02, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x40, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x20, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x08, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x20, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x80, 0x00, 0x00, 0x00, 0x00, 0x00, 0x28, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x08, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x08, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x30, 0x04, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x10, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x03, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x02, 0x80, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x10, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x30, 0x00, 0x00, 0x00, 0x00, 0x08, 0x00, 0x0A, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x04, 0x00, 0x00, 0x00, 0x08, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x02, 0x00, 0x00, 0x00, 0x04, 0x00, 0x80, 
-	0x00, 0x10, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0xC0, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0x00, 0x80, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x08, 0x00, 0x00, 0x00, 0x00, 0x02, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x08, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x20, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x80, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x40, 0x00, 0x00, 0x00, 0x00, 0x04, 
-	0x00, 0x20, 0x00, 0x08, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x04, 0x00, 0x00, 0x00, 0x00, 0x01, 0x00, 0x00, 0x04, 0x00, 0x20, 0x00, 0x00, 
-	0x00, 0x00, 0x06, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x02, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x47, 0x3B, 0x40, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x20, 0x22, 0xE5, 0xB0, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x10, 0xCA, 0x58, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x6C, 0xAB, 0x30, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x05, 0x80, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x24, 0x00, 0x00, 0x41, 0x7C, 0x49, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x40, 0x00, 
-	0x20, 0xA2, 0xD4, 0x80, 0x18, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x02, 0x64, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x66, 0x40, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0x1C, 0x69, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x83, 0x81, 0x42, 0x80, 0x00, 0x00, 0x8B, 0x94, 0x80, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x30, 
-	0x00, 0x00, 0x00, 0x09, 0x00, 0x00, 0xC0, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x60, 0x00, 0x02, 0x00, 0x00, 0x00, 0x01, 0x98, 0x00, 0x0C, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x10, 0x00, 0x3C, 0xC8, 0x00, 0xB0, 0x00, 0x40, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x07, 0x00, 0x02, 0xE6, 0x80, 
-	0x00, 0x00, 0x1C, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xA0, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x05, 0x0A, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x05, 0x2F, 0x7D, 0xAF, 0x80, 
-	0x00, 0x00, 0x00, 0x00, 0xF0, 0x34, 0x00, 0x00, 0x00, 0x18, 0x03, 0x40, 0x00, 0x00, 0x00, 0x04, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x0A, 0x96, 0x08, 0x50, 0x00, 0x00, 0x00, 0x24, 0x00, 0x02, 0x00, 
-	0x00, 0x20, 0x00, 0x90, 0x00, 0x00, 0x00, 0x00, 0x08, 0x88, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x2F, 
-	0x14, 0xCF, 0x0D, 0x00, 0x00, 0x00, 0x00, 0x00, 0x0E, 0x2D, 0x00, 0x00, 0x00, 0x00, 0x00, 0x10, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x03, 0xFA, 0x6E, 0x00, 0x10, 0x00, 0x00, 0x20, 
-	0x83, 0x01, 0xE0, 0x48, 0x00, 0x00, 0x00, 0x00, 0x08, 0x00, 0x1C, 0x00, 0x0C, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x01, 0x26, 0xFE, 0xA7, 0x00, 0x00, 0x00, 0x00, 0x20, 0x04, 0x0C, 0x00, 0x00, 0x00, 0x03, 
-	0xD8, 0xD8, 0x00, 0x00, 0x00, 0x04, 0x80, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x0A, 0x9E, 0xC9, 0x80, 0x00, 
-	0x08, 0x00, 0x20, 0x00, 0x20, 0x00, 0x00, 0x00, 0x00, 0x3E, 0x86, 0xB0, 0x00, 0x00, 0x00, 0x00, 
-	0x02, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x10, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x3F, 0x6E, 0xFF, 0x0F, 0x00, 0x00, 0x00, 0x20, 0x04, 0x00, 0x30, 
-	0x00, 0x00, 0x02, 0x80, 0x20, 0x10, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x02, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x03, 0xE0, 
-	0x6F, 0x00, 0x00, 0x00, 0x00, 0x20, 0x00, 0x78, 0x02, 0x00, 0x00, 0x01, 0x28, 0x1C, 0x80, 0x08, 
-	0x00, 0x00, 0x00, 0x70, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x05, 0x16, 0x3E, 0xB5, 0x0A, 0x00, 0x00, 0x00, 0x20, 
-	0x04, 0x00, 0x30, 0x00, 0x00, 0x10, 0x90, 0x4F, 0x00, 0x00, 0x00, 0x00, 0x07, 0xF0, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x09, 0x92, 0xC9, 0x80, 0x90, 0x00, 0x00, 0x20, 0x00, 0x70, 0x00, 0x40, 0x00, 0x00, 0x06, 
-	0x20, 0x00, 0x08, 0x00, 0x00, 0x0C, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x02, 0x6F, 0xC5, 0x8A, 0x00, 
-	0x4C, 0x00, 0x20, 0x00, 0x00, 0x00, 0x00, 0x30, 0x08, 0x02, 0xC0, 0x18, 0x00, 0x00, 0x84, 0x80, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x3F, 0xEE, 0xF0, 0x10, 0x08, 0x80, 0x20, 0x00, 0x68, 0x00, 0x00, 
-	0x03, 0x00, 0x90, 0x00, 0x05, 0x1C, 0x00, 0x08, 0x80, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x84, 0x16, 0xB5, 
-	0xF0, 0x80, 0x00, 0x04, 0x00, 0x00, 0x70, 0x00, 0x00, 0x00, 0x10, 0x18, 0x00, 0x00, 0x00, 0xE0, 
-	0x00, 0x40, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x09, 0x08, 0x09, 0x39, 0x80, 0x01, 0xC0, 0x24, 0x00, 
-	0x00, 0x00, 0x00, 0x07, 0x00, 0x82, 0x14, 0x00, 0x1B, 0x00, 0x1C, 0x00, 0x02, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x80, 
-	0x00, 0x09, 0x2C, 0xC1, 0x08, 0x00, 0x00, 0x00, 0x10, 0x03, 0x2C, 0x00, 0x00, 0x00, 0x18, 0x01, 
-	0x40, 0x71, 0x00, 0x00, 0x04, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x62, 0x00, 0x80, 0x10, 0x00, 
-	0x00, 0x20, 0x00, 0x02, 0x00, 0x00, 0x00, 0x00, 0x90, 0x20, 0x08, 0x0A, 0x00, 0x00, 0x00, 0x40, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x2F, 0x54, 0xA0, 0x18, 0x00, 0x0C, 0x00, 0x0A, 0x0A, 0x80, 0x00, 0x00, 
-	0x30, 0x00, 0x00, 0x00, 0x08, 0x00, 0x00, 0x04, 0x02, 0x80, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x80, 0x00, 0x00, 0x00, 0x00, 0x00, 0x03, 0xE9, 0x49, 
-	0x01, 0x90, 0x00, 0xC0, 0x00, 0x53, 0x84, 0x66, 0x00, 0x03, 0x00, 0x00, 0x00, 0x01, 0x80, 0x00, 
-	0x00, 0x80, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x02, 0x1F, 0x84, 0xD0, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x10, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x02, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xB0, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x02, 0xF4, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x80, 0x00, 0x00, 0x00, 0x00, 0x00, 0x60, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x0F, 0x00, 0x00, 0x00, 0x0C, 0x3C, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x0B, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x04, 0x3D, 0x65, 0xE9, 0x00, 0x00, 0x40, 
-	0x00, 0x00, 0x0E, 0xC4, 0x00, 0x00, 0x00, 0x00, 0x28, 0x30, 0x10, 0x00, 0x00, 0x04, 0x40, 0x40, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x0B, 0xEE, 0x7D, 0x80, 0x00, 0x00, 0x00, 0x05, 0x01, 0xF0, 0x00, 0x00, 0x00, 
-	0x00, 0x02, 0x97, 0xE5, 0x80, 0x00, 0x00, 0x00, 0x02, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x02, 0x80, 0x86, 0xD0, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x3F, 0x9C, 0x80, 
-	0x0E, 0x40, 0x01, 0x00, 0x3F, 0xD7, 0x64, 0x24, 0x05, 0x00, 0x10, 0x80, 0x10, 0x10, 0x04, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x08, 0x01, 0x7B, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x03, 0xE1, 0x78, 0x00, 0x12, 0x80, 0x00, 0x2B, 0xF1, 0xAA, 
-	0x00, 0x40, 0x20, 0x00, 0x80, 0x00, 0xC9, 0x00, 0x20, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x0B, 0x0E, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x3F, 0x36, 0x9D, 0x08, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x38, 0x80, 0x00, 0x02, 0xE3, 0xFD, 
-	0x08, 0x00, 0x00, 0x00, 0x00, 0x30, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x80, 0x10, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x4B, 0xF7, 0x6D, 0x18, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x1E, 0x8E, 0xD5, 0x08, 0x00, 0x00, 0x0C, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x20, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x0C, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x8D, 0x14, 0x0C, 0x00, 0x00, 0x30, 0x24, 0x80, 0x00, 0x20, 
-	0x00, 0x40, 0x0A, 0x00, 0x00, 0x00, 0xC4, 0xC0, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x05, 0x00, 
-	0x00, 0x00, 0x00, 0x10, 0x00, 0x00, 0x80, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x78, 
-	0xB0, 0x00, 0x80, 0x04, 0x00, 0x03, 0x60, 0x00, 0x02, 0x00, 0x80, 0x00, 0x11, 0x08, 0x00, 0x0C, 
-	0x80, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x8B, 0x00, 0x04, 0x00, 0x05, 0x0C, 0x2C, 
-	0x00, 0x00, 0x10, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x40, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0xC0, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x38, 0xA0, 0x01, 0xE0, 0x00, 0x57, 0xBA, 0x06, 0x80, 0x07, 0x00, 0x82, 0x14, 0x00, 
-	0x00, 0x00, 0x1C, 0x00, 0x02, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x0F, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x0C, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x3C, 0x02, 0x80, 0x00, 0x00, 0x03, 0x40, 0x00, 0x00, 0x14, 0x04, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x70, 0x00, 0x00, 0x00, 0x00, 0x00, 0x10, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x10, 0x00, 0x00, 
-	0x90, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x14, 0x00, 
-	0x89, 0x6E, 0x9F, 0x00, 0x00, 0x30, 0x00, 0x00, 0x00, 0x00, 0x04, 0x00, 0x08, 0x00, 0x00, 0x80, 
-	0x00, 0x10, 0x00, 0xB8, 0x97, 0x14, 0x02, 0x00, 0x40, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0x04, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x08, 0x93, 0x4F, 0x00, 0x00, 0x00, 0x80, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x08, 0x00, 0x18, 0x50, 0x00, 0x00, 0x00, 0x07, 0xA7, 0x62, 0x00, 
-	0x10, 0x00, 0x00, 0x00, 0x00, 0x01, 0x1A, 0x00, 0x00, 0x80, 0x3C, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x04, 0x00, 0x00, 0x00, 0x00, 0x10, 0x00, 0x10, 0x00, 0x00, 0x00, 0x00, 0x04, 0x00, 0x04, 
-	0x00, 0xB1, 0x00, 0x01, 0x50, 0x00, 0x20, 0x04, 0x14, 0x00, 0x00, 0x40, 0x00, 0x80, 0x10, 0x00, 
-	0x80, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 
-	0xA0, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x08, 0x00, 0x01, 0x80, 0x80, 0x08, 0x00, 0x20, 
-	0x00, 0x32, 0x02, 0x00, 0x00, 0x00, 0x00, 0x00, 0x81, 0x80, 0x00, 0x00, 0x08, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x04, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x10, 0x00, 0x00, 0x00, 0x00, 
-	0x04, 0x00, 0x04, 0x00, 0x97, 0x00, 0x00, 0x10, 0x00, 0x00, 0x02, 0x64, 0x00, 0x00, 0x40, 0x00, 
-	0x00, 0x00, 0x00, 0x80, 0x1D, 0x04, 0xC0, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x18, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x08, 0x00, 0x00, 0x18, 0x0E, 
-	0x00, 0x00, 0x05, 0x03, 0x28, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0xC0, 0x00, 
-	0x02, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x04, 0x00, 0x00, 0x00, 0x00, 0x00, 0x40, 0x30, 0x00, 
-	0x00, 0x00, 0x00, 0x04, 0x00, 0x2E, 0x3D, 0xD7, 0x00, 0x01, 0x11, 0x04, 0x42, 0xD3, 0x54, 0x20, 
-	0x00, 0x40, 0x00, 0x01, 0xC0, 0xF0, 0x00, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x0A, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0xEB, 
-	0x4E, 0x00, 0x00, 0x00, 0x00, 0x88, 0x10, 0x02, 0x46, 0x00, 0x00, 0x00, 0x10, 0x20, 0x00, 0x00, 
-	0xA0, 0x00, 0x00, 0x80, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x04, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x10, 0x00, 0x00, 0x00, 0x00, 0x04, 0x00, 0x2E, 0x2F, 0xF0, 0x0C, 0x00, 0x10, 0x00, 0x00, 
-	0xD0, 0x02, 0x00, 0x00, 0x40, 0x00, 0x01, 0x6A, 0x00, 0xA0, 0x01, 0x00, 0x08, 0x20, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x01, 0xEA, 0xFE, 0x78, 0x10, 0x00, 0x00, 0x24, 0x00, 0x01, 0x40, 0x00, 0x00, 0x00, 0x01, 
-	0x1E, 0x90, 0x00, 0x08, 0x00, 0x00, 0x80, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x04, 0x00, 0x2C, 
-	0x5F, 0xB0, 0x00, 0x00, 0x18, 0x00, 0x00, 0x00, 0x00, 0x04, 0x00, 0x20, 0x5C, 0x00, 0x88, 0x00, 
-	0x1C, 0x00, 0x00, 0x10, 0x1C, 0x00, 0x20, 0x60, 0x00, 0x00, 0x00, 0x00, 0xE0, 0x09, 0x80, 0x08, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x03, 0xC8, 0x7E, 0x50, 0x00, 0x00, 0x80, 0x00, 
-	0x00, 0x00, 0x40, 0x00, 0x02, 0x04, 0x1A, 0x58, 0x10, 0x00, 0x80, 0x24, 0x00, 0x01, 0x67, 0x00, 
-	0x02, 0x00, 0x82, 0x1C, 0x00, 0x00, 0x01, 0x0C, 0x00, 0x80, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x29, 0x40, 0xD0, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x04, 0x00, 
-	0x90, 0x0F, 0x80, 0x04, 0x00, 0x10, 0x02, 0x0C, 0x00, 0x00, 0x10, 0x00, 0x80, 0x00, 0x00, 0x08, 
-	0x14, 0x40, 0x08, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0x68, 0x01, 0x78, 0x00, 
-	0x01, 0xC0, 0x00, 0x00, 0x00, 0x00, 0x00, 0x08, 0x00, 0x01, 0x38, 0x10, 0x01, 0xC0, 0x20, 0x00, 
-	0x02, 0x00, 0x00, 0x07, 0x00, 0x80, 0x01, 0xC0, 0x00, 0x00, 0x1C, 0x00, 0x82, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x04, 0x00, 0x00, 0x00, 0x01, 0x00, 0x00, 0x10, 0x00, 0x00, 0x00, 0x28, 0x84, 
-	0x00, 0x08, 0x00, 0x00, 0x80, 0x08, 0x10, 0x00, 0xB8, 0xBE, 0xF4, 0x36, 0x80, 0x40, 0x10, 0x00, 
-	0x1F, 0x08, 0xD2, 0x01, 0x00, 0x08, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x20, 0x00, 0x00, 
-	0x00, 0x80, 0x00, 0x00, 0x80, 0x00, 0x00, 0x00, 0x00, 0x20, 0x08, 0x00, 0x08, 0x39, 0xE0, 0x00, 
-	0x80, 0x07, 0xAF, 0xBD, 0x47, 0xD0, 0x02, 0x00, 0x29, 0x40, 0x81, 0x81, 0x40, 0x28, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x04, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x10, 0x00, 0x00, 
-	0x00, 0x00, 0x10, 0x00, 0x00, 0x00, 0x00, 0x80, 0x00, 0x18, 0x00, 0xFC, 0xBE, 0x44, 0x40, 0x00, 
-	0x70, 0x00, 0x02, 0x40, 0x00, 0xE0, 0x01, 0x80, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x80, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x50, 0x00, 0x80, 0xC0, 0x05, 0x81, 0x72, 0x06, 0x00, 0x02, 0x00, 0x10, 0x00, 0x00, 0x00, 0x00, 
-	0x08, 0x80, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x04, 0x00, 0x81, 0x2F, 0xFD, 0x00, 0x00, 
-	0x10, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x10, 0x00, 0x74, 0xDE, 
-	0x80, 0x00, 0x05, 0x44, 0x10, 0x6A, 0x60, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x08, 0x31, 0xC8, 0x99, 0x80, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x07, 0xA1, 0x31, 0xC2, 0x00, 0x20, 0x00, 0x06, 0xB7, 
-	0xE1, 0x80, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x04, 0x00, 0x29, 0x40, 
-	0xA1, 0x00, 0x00, 0x10, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x3F, 0xC1, 0x99, 0x0E, 0x00, 0x10, 
-	0x00, 0x5E, 0x5B, 0x1C, 0x28, 0x00, 0x48, 0x10, 0x28, 0x30, 0x90, 0x00, 0x01, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0x68, 0x01, 0x80, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x49, 0x68, 0x1E, 0x80, 0x90, 0x00, 0x00, 0x05, 0xF5, 0xFC, 0x62, 0x00, 0x00, 
-	0x00, 0x02, 0x9D, 0xC8, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x0C, 
-	0x00, 0x89, 0x1F, 0xF1, 0x00, 0x00, 0x10, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x07, 
-	0x00, 0x00, 0x10, 0x80, 0xA5, 0x0E, 0x40, 0x00, 0x00, 0x42, 0x00, 0x40, 0x08, 0x00, 0x00, 0x01, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x08, 0x10, 0x4E, 0x80, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x80, 0x00, 0x00, 0x20, 0x00, 0x55, 0xE4, 
-	0x60, 0x00, 0x00, 0x00, 0x80, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x80, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x04, 0x24, 0x00, 0x15, 0x9B, 0x08, 0x00, 0x10, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x0D, 0xA0, 0x0F, 0x00, 0x12, 0x80, 0x40, 0xD4, 0x14, 0x40, 0x00, 0x40, 0x00, 0x09, 0x4B, 
-	0x10, 0xA0, 0x01, 0x00, 0x08, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x12, 0x06, 0x1D, 
-	0x81, 0x90, 0x00, 0x00, 0x00, 0x00, 0x00, 0x02, 0x00, 0x00, 0x62, 0x1D, 0x00, 0x10, 0x00, 0x00, 
-	0x04, 0x07, 0x68, 0x47, 0x00, 0x00, 0x80, 0x00, 0x76, 0x00, 0x0E, 0x00, 0x00, 0x00, 0x80, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x04, 0x00, 0x33, 0x01, 0xD0, 0x10, 0x01, 0x18, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x18, 0x00, 0xFC, 0x18, 0x06, 0x30, 0x00, 0x70, 
-	0x00, 0x00, 0x00, 0x10, 0x00, 0x15, 0xC0, 0x08, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0xCC, 0x5B, 0x00, 0xA0, 0x00, 0x80, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0xC1, 0x2F, 0xC3, 0x81, 0x43, 0xC0, 0x03, 0x00, 0x00, 0x00, 0x03, 0x80, 0x00, 0x08, 
-	0x80, 0x80, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x0C, 0xF4, 0x00, 0x80, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x20, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x04, 0x10, 0xFC, 0xF0, 0x14, 
-	0x00, 0x00, 0x10, 0x00, 0x00, 0x00, 0x70, 0xF0, 0x00, 0x40, 0x08, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x07, 0x33, 0x5A, 0x50, 0x00, 0x01, 0xC0, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x03, 0x01, 0xC0, 0x2F, 0xCB, 0x83, 0xC6, 0x00, 0x07, 0x00, 0x00, 0x00, 0x08, 
-	0x01, 0x00, 0x1C, 0x00, 0x80, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x04, 0x10, 0x00, 0x14, 0x0D, 
-	0x80, 0x0C, 0x10, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x80, 0x00, 0x10, 0x80, 
-	0x0A, 0x08, 0x34, 0x2C, 0x00, 0x40, 0x00, 0x00, 0x00, 0x08, 0xC0, 0x01, 0x00, 0x08, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x20, 0x04, 0x00, 0x00, 0x70, 0x00, 0x00, 0x80, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x50, 0x00, 0x00, 0x80, 0x00, 0xA1, 0xE1, 0xC0, 0x00, 0x02, 0x00, 
-	0x00, 0x00, 0x01, 0x81, 0x1C, 0x08, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x04, 0x00, 0xB0, 0x00, 0x00, 0x0C, 0x00, 0x00, 0x00, 0x00, 0x04, 0x00, 0x00, 0x55, 0xC0, 0x10, 
-	0x00, 0x80, 0x00, 0x00, 0x00, 0x00, 0x00, 0x70, 0x00, 0x13, 0x90, 0xE8, 0x00, 0xB4, 0x08, 0xC0, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x18, 0x00, 0x01, 0x00, 0x00, 0x00, 0x80, 
-	0x00, 0x00, 0x01, 0x00, 0x00, 0x10, 0x1D, 0x79, 0x01, 0x80, 0x04, 0xB8, 0x20, 0x81, 0x80, 0x00, 
-	0x00, 0x30, 0x00, 0x36, 0x04, 0x00, 0x08, 0x81, 0x0C, 0x80, 0x00, 0x08, 0x80, 0x0D, 0x00, 0x00, 
-	0x00, 0x00, 0x01, 0x00, 0x04, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x03, 0x04, 0x00, 0x00, 
-	0x00, 0x00, 0x0E, 0x04, 0x00, 0x04, 0x50, 0x0E, 0x80, 0x00, 0x05, 0x00, 0x00, 0x04, 0x6C, 0x00, 
-	0x04, 0x50, 0x00, 0x00, 0x00, 0x02, 0x40, 0x80, 0x00, 0x00, 0x00, 0x00, 0x09, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0xF1, 0x40, 0x00, 0x00, 
-	0x05, 0x64, 0x00, 0x00, 0x00, 0x80, 0x00, 0x2D, 0x93, 0x80, 0x00, 0x80, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x02, 0x08, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x04, 0x00, 0x38, 0x34, 0xC0, 0x00, 0x00, 0x00, 0x04, 0x10, 0x03, 0x40, 0x00, 0x00, 0x00, 0x02, 
-	0x80, 0x0A, 0x00, 0x80, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x08, 
-	0x00, 0x1A, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x42, 0x01, 0x69, 0x00, 0x81, 
-	0x00, 0x28, 0x20, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x14, 0x14, 0x00, 0x01, 0x00, 0x00, 0x00, 
-	0x02, 0x00, 0x00, 0x00, 0x03, 0xC0, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x0D, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x04, 0x04, 0x00, 0x9D, 0x00, 0x00, 0x00, 0x00, 0x0C, 0x10, 0x02, 0x0C, 0x00, 
-	0x00, 0x00, 0x10, 0x00, 0x20, 0x91, 0xC0, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x20, 0x00, 
-	0x00, 0x00, 0x18, 0x21, 0x40, 0x00, 0x10, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x04, 0x00, 0x0B, 
-	0xC8, 0x00, 0x00, 0xC0, 0x18, 0x20, 0x00, 0x00, 0x40, 0x00, 0x00, 0x20, 0x82, 0x04, 0x09, 0x09, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x02, 0x08, 0x01, 0x05, 0x00, 
-	0x00, 0x40, 0x00, 0x00, 0x00, 0x10, 0x04, 0x20, 0x80, 0x00, 0xAF, 0x0F, 0x00, 0x00, 0x88, 0x00, 
-	0x08, 0x00, 0x34, 0x70, 0x08, 0x23, 0xCF, 0x60, 0xF0, 0xE0, 0x00, 0x00, 0x00, 0x30, 0x00, 0x00, 
-	0x00, 0x0E, 0x00, 0x00, 0x00, 0x08, 0x00, 0x08, 0x50, 0xE0, 0x00, 0x00, 0x00, 0x00, 0x00, 0x60, 
-	0x00, 0x0A, 0x94, 0x0F, 0x00, 0x90, 0x10, 0x30, 0x60, 0x85, 0x01, 0xE6, 0xC0, 0x00, 0x80, 0x3C, 
-	0xDC, 0x00, 0x1F, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x02, 0x02, 0x04, 
-	0x00, 0x80, 0x8F, 0x0C, 0x0C, 0x00, 0x00, 0x00, 0x00, 0x24, 0x00, 0x00, 0x00, 0x0F, 0x8F, 0x04, 
-	0x48, 0x8C, 0x00, 0x90, 0x14, 0x00, 0x00, 0x20, 0x11, 0x68, 0xE9, 0x31, 0x90, 0x00, 0xC0, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x30, 0x08, 0x00, 0x01, 0x18, 0x00, 0x00, 0x80, 0x00, 
-	0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 0x00, 0xF0, 0x01, 0x48, 0xA0, 0x24, 0x00, 0x00, 0xE0, 0x00, 
-	0x03, 0x00, 0x12, 0x97, 0xBF, 0x19, 0x00, 0x08, 0x80, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x01, 0x00, 0x08, 0x00, 0x00, 0x0D, 0x80, 0x04, 0x00, 0x00, 0x00, 0x00, 0x00, 0x02, 0x81, 0x42, 
-	0x07, 0x0E, 0x00, 0x06, 0x04, 0x20, 0x04, 0x00, 0x39, 0x80, 0x10, 0x00, 0x00, 0x00, 0x30, 0xB1, 
-	0xC0, 0x40, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x70, 0x28, 0x00, 0x0C, 0x00, 0x10, 
-	0x01, 0xC0, 0x00, 0x00, 0x00, 0x40, 0x00, 0x08, 0x15, 0x4E, 0x80, 0x10, 0x01, 0xD0, 0x60, 0x00, 
-	0x69, 0x40, 0x28, 0x07, 0x00, 0x00, 0x00, 0x07, 0x8A, 0x00, 0x1C, 0x00, 0x02, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x02, 0x08, 0x01, 0x05, 0x0A, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x84, 
-	0x00, 0x1D, 0x06, 0x0F, 0x8E, 0xA0, 0x00, 0x80, 0x20, 0x00, 0x2C, 0x38, 0x00, 0x00, 0x00, 0x0E, 
-	0xDA, 0xD9, 0x00, 0x50, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x08, 0x00, 
-	0x08, 0x50, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x20, 0x01, 0xD3, 0x7C, 0x50, 0x14, 0x00, 
-	0x10, 0x20, 0x00, 0x6A, 0x00, 0x00, 0x00, 0x00, 0x30, 0x1F, 0x9F, 0x1E, 0x00, 0x80, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x03, 0x00, 0x04, 0x00, 0xE0, 0x0A, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x04, 0x28, 0x02, 0xB0, 0x0F, 0x00, 0x01, 0x80, 0x20, 0x04, 0x00, 0x3C, 0x20, 
-	0x00, 0x13, 0xCC, 0x4A, 0x00, 0xA0, 0x08, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x20, 0x08, 0x00, 0x01, 0x00, 0x10, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x11, 0x41, 0x40, 
-	0x00, 0x00, 0xC0, 0xA0, 0x60, 0x00, 0x20, 0x00, 0x00, 0x00, 0x00, 0xBD, 0xF6, 0xC0, 0x1B, 0x00, 
-	0x40, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x20, 0x00, 0x00, 0x00, 0x00, 0x02, 0x00, 0x80, 0x20, 
-	0x00, 0x00, 0x00, 0x00, 0x28, 0x00, 0x01, 0x81, 0x40, 0x00, 0x00, 0x00, 0x00, 0x00, 0xFC, 0x33, 
-	0xC0, 0x40, 0x00, 0x00, 0x00, 0x00, 0x00, 0x08, 0x81, 0x40, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x1E, 0x00, 0x00, 0x00, 0x08, 0x21, 0x40, 0x78, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x08, 0x15, 0xE8, 0x30, 0x00, 0x00, 0x00, 0x05, 0x87, 0xA8, 0x66, 0x00, 0x00, 0x00, 0x02, 0x0E, 
-	0x07, 0x1D, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x02, 0x40, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x04, 0x00, 0x20, 0x02, 0x16, 0x01, 0x00, 0x00, 0x20, 
-	0x00, 0x20, 0x00, 0x00, 0x24, 0x00, 0x08, 0x00, 0x31, 0xE0, 0x50, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x20, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x40, 0x08, 0x10, 0x20, 0x4A, 0x00, 0x00, 0x00, 0x20, 0x20, 0x00, 0x68, 0x06, 0x40, 0x00, 
-	0xA0, 0x03, 0x34, 0x08, 0x1A, 0x00, 0x00, 0x00, 0x02, 0x00, 0x00, 0x3F, 0x83, 0xC0, 0x10, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x03, 0x88, 0x00, 0x08, 0x02, 0x24, 0x05, 0x00, 0x02, 0x9F, 0xCD, 0x71, 0x81, 0x88, 
-	0x00, 0x00, 0x00, 0x02, 0x03, 0x58, 0x00, 0x02, 0x80, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x50, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x08, 0x00, 0x60, 0x85, 0x80, 
-	0x60, 0x47, 0x20, 0x02, 0xBF, 0xDD, 0x9D, 0x9F, 0x94, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x83, 
-	0xC0, 0x00, 0x00, 0x00, 0x00, 0x02, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x02, 0x00, 0x00, 
-	0x00, 0x00, 0x05, 0x0A, 0x01, 0x02, 0x00, 0x00, 0xB3, 0x2C, 0x60, 0x00, 0x00, 0x02, 0x2C, 0xED, 
-	0x90, 0x90, 0x00, 0x00, 0x00, 0x30, 0x00, 0x08, 0x38, 0x20, 0x78, 0x00, 0x00, 0x08, 0x20, 0x60, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x08, 0x01, 
-	0x44, 0x07, 0x76, 0x07, 0x06, 0x00, 0x01, 0xA1, 0x4C, 0xCF, 0x0B, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x02, 0x00, 0x04, 0x00, 0x8F, 0x0C, 0x00, 0x0C, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x46, 0xDB, 0x8A, 0x00, 0x0F, 0x10, 0x00, 0x00, 0x04, 0x20, 0x00, 0x30, 
-	0x00, 0x14, 0x28, 0x00, 0xE0, 0x00, 0x80, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x28, 0x00, 0x30, 
-	0x08, 0x00, 0x00, 0x80, 0x00, 0x00, 0xC0, 0x00, 0x00, 0x00, 0x00, 0x08, 0x02, 0x85, 0x7B, 0xB9, 
-	0xB0, 0x00, 0xC0, 0x60, 0x85, 0x81, 0x40, 0x00, 0x02, 0x00, 0x00, 0x17, 0xA7, 0x01, 0x0C, 0x08, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x05, 0x00, 0x00, 0x00, 0x0F, 0x00, 0x00, 0x04, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xC5, 0x08, 0x00, 0xD0, 0x00, 
-	0x00, 0x80, 0x10, 0x02, 0x94, 0x19, 0x01, 0xA4, 0x01, 0x40, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x40, 0x00, 0x00, 0x00, 0x80, 0x00, 0x01, 0xC0, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x70, 0x00, 0x11, 0xC0, 0x24, 0x00, 0x00, 0xE0, 0x10, 0x07, 0x00, 0x97, 0xCD, 0xB5, 
-	0x18, 0x20, 0x14, 0x00, 0x02, 0x00, 0x00, 0x00, 0x00, 0x00, 0x07, 0x00, 0x00, 0x08, 0x00, 0x00, 
-	0x09, 0x1D, 0x00, 0x00, 0x00, 0x00, 0x08, 0x00, 0x02, 0xBD, 0x41, 0x05, 0x0B, 0x00, 0x81, 0x08, 
-	0x20, 0x04, 0x1C, 0x02, 0x80, 0x06, 0x13, 0x3D, 0xE8, 0xF0, 0x94, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x08, 0x00, 0x0A, 0x00, 0x10, 0x00, 0x00, 0x00, 0x00, 0x01, 
-	0x00, 0x00, 0x0B, 0xD5, 0xF8, 0x80, 0xE0, 0x10, 0x00, 0x20, 0x00, 0x60, 0x00, 0x00, 0x00, 0x00, 
-	0x39, 0xE4, 0x9D, 0x0B, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x03, 0x40, 0x00, 0x02, 0x04, 
-	0x19, 0x84, 0xE0, 0x0C, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x41, 0x28, 0x01, 0x00, 0x10, 
-	0x00, 0x0C, 0x00, 0x01, 0xDC, 0x00, 0x02, 0x82, 0x00, 0x02, 0xE3, 0x4D, 0x19, 0x80, 0x00, 0xC0, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x20, 0x00, 0x00, 0x20, 0x0A, 0x94, 0x1F, 0x00, 0x90, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x12, 0x81, 0xEE, 0x00, 0x80, 0x00, 0xB0, 0x00, 0x1B, 0x78, 0x40, 
-	0x10, 0x12, 0x00, 0x1E, 0x8C, 0x81, 0x9E, 0x04, 0x0C, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x28, 0x00, 0x00, 0x17, 0x8E, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x17, 0x70, 0x01, 0x29, 
-	0x40, 0xD0, 0x80, 0x00, 0x00, 0x00, 0x5F, 0x0A, 0xB4, 0x20, 0x50, 0x04, 0x00, 0x03, 0x5A, 0x00, 
-	0xA0, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x38, 0x00, 0x00, 0x01, 0x78, 0xC8, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x02, 0x81, 0x08, 0x09, 0x68, 0x01, 0x70, 0x00, 0x00, 0x00, 0x20, 
-	0x55, 0x30, 0x00, 0x40, 0x00, 0x20, 0x20, 0x41, 0xC5, 0x99, 0x00, 0x00, 0x00, 0x00, 0x00, 0x0F, 
-	0x00, 0x83, 0xC0, 0x00, 0x00, 0x01, 0x29, 0x55, 0x80, 0x0E, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x0C, 0x01, 0x00, 0xA0, 0x00, 0x04, 0x00, 0x92, 0x00, 0x00, 0x00, 0x00, 0x01, 
-	0xD2, 0xFA, 0x58, 0xA0, 0x00, 0x00, 0x00, 0x00, 0x00, 0xF0, 0x38, 0x00, 0x00, 0x00, 0x00, 0x11, 
-	0xF8, 0x0A, 0x00, 0x10, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0x00, 0x00, 0x80, 0x0A, 
-	0x80, 0x00, 0x00, 0x81, 0xE9, 0x40, 0x11, 0x00, 0x00, 0x1E, 0x9F, 0xAF, 0x0B, 0x00, 0x00, 0x00, 
-	0x02, 0x00, 0x00, 0x00, 0x03, 0xC0, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x0E, 0x8C, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x50, 0x01, 0x4C, 0xEC, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x34, 0x00, 
-	0x00, 0x00, 0x00, 0x14, 0x20, 0x00, 0x90, 0xC8, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x20, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x18, 0x14, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x1B, 0x33, 
-	0x6C, 0x81, 0x81, 0x00, 0x00, 0x20, 0x83, 0x00, 0x06, 0x00, 0x00, 0x00, 0x81, 0x57, 0xE5, 0x01, 
-	0x04, 0x00, 0x04, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x08, 0x15, 0xA0, 0x0F, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x08, 0x00, 0x00, 0x00, 0x04, 
-	0x7E, 0x5C, 0x40, 0x00, 0x08, 0x42, 0x07, 0x4E, 0x90, 0x01, 0xC0, 0x00, 0x00, 0x30, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x02, 0xEA, 0x00, 0x10, 0x10, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x01, 0xF0, 0x00, 0x00, 0x00, 0x01, 0xFE, 0x02, 0x80, 0x00, 0x81, 0x90, 
-	0xA0, 0x17, 0x00, 0x0C, 0x00, 0x20, 0x40, 0x00, 0x00, 0x00, 0x00, 0x04, 0x00, 0x03, 0x00, 0x00, 
-	0x00, 0x00, 0x0A, 0x00, 0x08, 0x00, 0x00, 0x00, 0x10, 0x00, 0x82, 0x4C, 0xEC, 0x00, 0x00, 0x14, 
-	0x08, 0x00, 0x00, 0x00, 0x0C, 0x00, 0x00, 0x20, 0x02, 0x06, 0xDC, 0x71, 0x80, 0x00, 0xC2, 0x06, 
-	0x00, 0x00, 0x00, 0x00, 0x1E, 0x38, 0x00, 0x20, 0x00, 0x00, 0x00, 0x50, 0x00, 0x00, 0x80, 0x00, 
-	0x00, 0x02, 0x00, 0x00, 0x1B, 0x30, 0x4C, 0x01, 0x80, 0x10, 0x80, 0x00, 0x00, 0x02, 0x42, 0x80, 
-	0x02, 0x01, 0x09, 0x7D, 0xF7, 0x0F, 0x01, 0x8C, 0x80, 0x00, 0x00, 0x02, 0x00, 0x42, 0x43, 0x40, 
-	0x05, 0x22, 0x16, 0x80, 0x90, 0x00, 0x00, 0x04, 0x00, 0x00, 0x00, 0x00, 0x20, 0xC6, 0x28, 0x14, 
-	0x00, 0x00, 0x00, 0x04, 0x00, 0x04, 0xFC, 0x1E, 0x28, 0x10, 0x18, 0x00, 0x63, 0x4E, 0x00, 0x80, 
-	0x08, 0x40, 0x00, 0x00, 0x00, 0x00, 0x06, 0x20, 0x04, 0x00, 0x50, 0x03, 0xFC, 0x09, 0x78, 0x00, 
-	0x01, 0xC0, 0x00, 0x00, 0x00, 0x00, 0x0A, 0x55, 0x42, 0x0A, 0x00, 0x00, 0x01, 0xC0, 0x00, 0x47, 
-	0xAA, 0x60, 0x40, 0x07, 0x00, 0x89, 0x20, 0x10, 0x01, 0x18, 0x5C, 0x00, 0x00, 0x00, 0x0C, 0xB5, 
-	0xB4, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x07, 0x0E, 0x00, 0x00, 0x00, 0x00, 0x00, 0x08, 0xA8, 
-	0x10, 0x00, 0x2C, 0x0F, 0x00, 0x00, 0x00, 0x00, 0x20, 0x04, 0x24, 0x00, 0x05, 0x00, 0x00, 0x40, 
-	0x6E, 0x00, 0x80, 0x00, 0x00, 0x00, 0x00, 0x02, 0xC7, 0x78, 0x00, 0x00, 0x60, 0x00, 0x00, 0x00, 
-	0x00, 0x80, 0xB0, 0x00, 0x00, 0x00, 0x00, 0x01, 0x05, 0x00, 0x04, 0x02, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x60, 0x00, 0x73, 0x66, 0x80, 0x20, 0x00, 0x00, 0x25, 0xC1, 0x81, 0x10, 0x00, 0x00, 0x00, 
-	0x62, 0x00, 0x3F, 0x72, 0x00, 0x80, 0x11, 0x00, 0x82, 0x00, 0x00, 0x01, 0x03, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x82, 
-	0x00, 0x80, 0x01, 0x03, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x11, 0x01, 0x82, 0x00, 0x00, 0x01, 0x03, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x82, 
-	0x00, 0x80, 0x01, 0x03, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x11, 0x02, 0x82, 0x00, 0x00, 0x01, 0x03, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x82, 
-	0x00, 0x80, 0x01, 0x03, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x11, 0x03, 0x82, 0x00, 0x00, 0x01, 0x03, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x82, 
-	0x00, 0x80, 0x01, 0x03, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x22, 0x98, 0xD0, 0x01, 0x06, 0x00, 
+	0x14, 0x09, 0x00, 0xF2, 0x01, 0xB2, 0xC0, 0x08, 0x00, 0x48, 0x02, 0xF0, 0xE0, 0xC1, 0x54, 0x82, 
+	0x20, 0x4F, 0x06, 0x11, 0x40, 0x60, 0x0A, 0x10, 0x32, 0x9F, 0x01, 0x30, 0x60, 0x1C, 0x1A, 0x98, 
+	0x02, 0x20, 0x00, 0x80, 0x15, 0x01, 0x20, 0x3E, 0xAA, 0x0C, 0x00, 0x90, 0x01, 0x56, 0x15, 0x40, 
+	0x04, 0x00, 0x16, 0x01, 0xED, 0x44, 0x0B, 0x00, 0xA6, 0x00, 0x80, 0x92, 0xD4, 0xC0, 0x2A, 0x00, 
+	0x00, 0x01, 0x49, 0x2B, 0x04, 0x10, 0x70, 0x3E, 0x03, 0x40, 0x00, 0x41, 0x70, 0xAA, 0x3E, 0x03, 
+	0x93, 0x80, 0x01, 0x54, 0x80, 0x22, 0x01, 0x40, 0x2D, 0xBB, 0xE6, 0x05, 0xA2, 0x03, 0xB2, 0x81, 
+	0x00, 0x04, 0x01, 0x60, 0x06, 0x18, 0x14, 0xDE, 0x03, 0xF1, 0x06, 0x80, 0x40, 0x07, 0x60, 0x00, 
+	0x04, 0x02, 0x00, 0x27, 0x8B, 0x53, 0x68, 0x50, 0x10, 0x40, 0x00, 0x3A, 0x00, 0x00, 0x40, 0x40, 
+	0xC9, 0x02, 0x21, 0x08, 0x28, 0xDD, 0x02, 0x10, 0x2B, 0x1B, 0x03, 0x80, 0x70, 0x03, 0x34, 0x00, 
+	0x84, 0x00, 0x36, 0xC0, 0xF7, 0x00, 0x30, 0x09, 0xAD, 0x65, 0xEA, 0x06, 0x20, 0x04, 0x04, 0x18, 
+	0x0F, 0x00, 0x0A, 0x04, 0xF6, 0x0F, 0x08, 0x6A, 0x81, 0x00, 0xE0, 0x01, 0x47, 0x20, 0x18, 0x14, 
+	0x03, 0x84, 0x48, 0x00, 0x58, 0x41, 0x60, 0x00, 0xE0, 0x40, 0x00, 0x24, 0x01, 0x80, 0x0F, 0x98, 
+	0x5E, 0x71, 0x50, 0x0E, 0x60, 0x09, 0x21, 0x00, 0x0B, 0xFF, 0x0B, 0xF3, 0x0A, 0x14, 0x41, 0xC9, 
+	0x42, 0x00, 0x20, 0x00, 0xF0, 0x05, 0x34, 0x08, 0x00, 0x02, 0x34, 0x09, 0x00, 0x20, 0x20, 0x00, 
+	0x59, 0xAD, 0xFB, 0x24, 0x02, 0x80, 0x48, 0x0F, 0x00, 0x5A, 0x03, 0x30, 0x07, 0x72, 0x81, 0xF9, 
+	0x00, 0xF1, 0x0B, 0x36, 0x1A, 0x50, 0x03, 0x00, 0x81, 0x00, 0x80, 0x00, 0x40, 0x01, 0xE7, 0x01, 
+	0xC1, 0x04, 0x03, 0x00, 0x00, 0x18, 0x96, 0xFD, 0x50, 0x44, 0x08, 0x00, 0x78, 0x29, 0x00, 0x00, 
+	0x8C, 0x01, 0x20, 0x04, 0x28, 0x8C, 0x01, 0xB1, 0x03, 0xEE, 0x99, 0x20, 0x30, 0x11, 0x90, 0x93, 
+	0x00, 0x04, 0x0A, 0x3F, 0x01, 0x51, 0x10, 0x00, 0xD0, 0xB9, 0xE2, 0x5B, 0x02, 0x04, 0x29, 0x00, 
+	0x03, 0xC1, 0x0F, 0x30, 0x06, 0x9E, 0xBD, 0x5F, 0x00, 0x02, 0xAB, 0x08, 0x90, 0x34, 0x0E, 0x70, 
+	0x04, 0x00, 0x08, 0x1A, 0xBE, 0x21, 0x33, 0x00, 0x36, 0x02, 0xFC, 0xE6, 0xAD, 0x02, 0x00, 0xE9, 
+	0x03, 0x71, 0x08, 0xD1, 0x20, 0x00, 0x00, 0x90, 0x8D, 0x8D, 0x01, 0x20, 0x4F, 0x42, 0xC1, 0x06, 
+	0x30, 0xB1, 0x63, 0xA8, 0x49, 0x00, 0x22, 0x0E, 0xCC, 0xD3, 0x00, 0x20, 0x18, 0x10, 0xBA, 0x09, 
+	0x70, 0x0A, 0x00, 0x01, 0x8A, 0x04, 0x00, 0x28, 0x4A, 0x04, 0x00, 0x89, 0x03, 0xF2, 0x00, 0x10, 
+	0x24, 0x00, 0x00, 0x01, 0x08, 0x9B, 0x39, 0xD0, 0x20, 0x04, 0x14, 0x02, 0xC9, 0xA4, 0x5F, 0x07, 
+	0x01, 0xF8, 0x0C, 0x40, 0x01, 0x44, 0x00, 0xD0, 0xBC, 0x01, 0x11, 0x90, 0xFD, 0x07, 0x00, 0xE9, 
+	0x04, 0x60, 0x02, 0x01, 0x00, 0xF9, 0xA6, 0x80, 0xAE, 0x00, 0x23, 0x3D, 0xDE, 0xEB, 0x02, 0x11, 
+	0x88, 0xDD, 0x04, 0x21, 0x00, 0x1E, 0x75, 0x07, 0x93, 0x48, 0x90, 0x08, 0x00, 0x00, 0x60, 0x1C, 
+	0x00, 0x04, 0x2B, 0x0E, 0x34, 0x00, 0x00, 0x14, 0xD9, 0x0A, 0x50, 0x07, 0x00, 0xB2, 0x10, 0x82, 
+	0x87, 0x00, 0x60, 0x29, 0x81, 0x20, 0x00, 0x00, 0x91, 0x35, 0x00, 0x64, 0x02, 0x38, 0x00, 0x04, 
+	0x20, 0x01, 0xBE, 0x0F, 0x14, 0x62, 0x19, 0x08, 0x31, 0x80, 0x00, 0x04, 0x78, 0x08, 0xC0, 0x24, 
+	0x18, 0x10, 0x00, 0x00, 0x10, 0x1C, 0x80, 0x00, 0x0A, 0x00, 0x60, 0x7B, 0x0B, 0xB2, 0x10, 0xA0, 
+	0x1A, 0x76, 0xF9, 0xD0, 0x00, 0x40, 0x00, 0x01, 0x60, 0xF0, 0x04, 0x32, 0x01, 0x00, 0x03, 0x54, 
+	0x0A, 0x20, 0xC8, 0xE7, 0x6A, 0x05, 0xF2, 0x00, 0x0F, 0x00, 0x00, 0x02, 0x42, 0x3B, 0x40, 0x08, 
+	0x00, 0x40, 0x00, 0x10, 0x0F, 0x3D, 0x40, 0x8A, 0x05, 0x01, 0x54, 0x0E, 0xC5, 0x00, 0x00, 0x08, 
+	0x62, 0x81, 0x00, 0xC0, 0x02, 0x46, 0x20, 0xAA, 0x04, 0x30, 0x05, 0x11, 0x16, 0x06, 0x0B, 0x00, 
+	0x25, 0x00, 0x25, 0x04, 0x40, 0xAF, 0x00, 0x21, 0x00, 0x00, 0xF2, 0x01, 0x10, 0x06, 0x6E, 0x08, 
+	0x23, 0x10, 0x00, 0x1B, 0x08, 0x10, 0x20, 0xC4, 0x00, 0x01, 0xC0, 0x0F, 0x14, 0x08, 0x41, 0x0A, 
+	0x31, 0x00, 0x00, 0x78, 0xDD, 0x05, 0x13, 0x1D, 0x7B, 0x08, 0x31, 0x01, 0x00, 0x00, 0x70, 0x06, 
+	0x00, 0xB9, 0x01, 0x48, 0x1E, 0x80, 0x00, 0x10, 0xB9, 0x0F, 0x0A, 0x40, 0x10, 0x11, 0xF3, 0x34, 
+	0x04, 0x02, 0x35, 0x00, 0x10, 0x0D, 0x6B, 0x01, 0x04, 0x19, 0x10, 0x00, 0x3A, 0x09, 0xF2, 0x00, 
+	0x3B, 0x01, 0x00, 0xE0, 0x00, 0x00, 0x4E, 0xCA, 0x50, 0x03, 0x80, 0x08, 0x0E, 0xB8, 0x40, 0x5D, 
+	0x00, 0x11, 0x01, 0xFC, 0x01, 0x22, 0x10, 0x0E, 0x22, 0x0D, 0x02, 0x01, 0x00, 0x11, 0x06, 0xCC, 
+	0x0D, 0x30, 0x28, 0x40, 0xAA, 0xEB, 0x02, 0x23, 0x0B, 0xB2, 0x63, 0x00, 0x00, 0xD4, 0x07, 0x07, 
+	0xBE, 0x02, 0x00, 0x98, 0x02, 0x10, 0xE0, 0xD6, 0x05, 0x30, 0x00, 0x00, 0x60, 0x06, 0x0B, 0x60, 
+	0x25, 0x9E, 0x80, 0x00, 0x40, 0x20, 0xD0, 0x05, 0x50, 0x03, 0x00, 0x0F, 0x80, 0x03, 0x4B, 0x0D, 
+	0x40, 0x00, 0x04, 0x0A, 0x10, 0x29, 0x06, 0x50, 0x20, 0x00, 0x1E, 0xF2, 0xD0, 0xAF, 0x03, 0x30, 
+	0x29, 0x4D, 0x42, 0x37, 0x00, 0x13, 0x05, 0x56, 0x07, 0x41, 0x00, 0x30, 0x00, 0xF8, 0x58, 0x0A, 
+	0x10, 0x01, 0x50, 0x02, 0x07, 0x01, 0x00, 0x71, 0x01, 0xC0, 0x01, 0xAA, 0x04, 0x80, 0x08, 0x1D, 
+	0x06, 0x04, 0x01, 0x00, 0x31, 0x1C, 0x9B, 0xA8, 0x08, 0x00, 0x24, 0x1E, 0x10, 0x65, 0x08, 0x01, 
+	0x01, 0x00, 0x72, 0x03, 0xC0, 0x50, 0x00, 0x01, 0x00, 0x08, 0x60, 0x0A, 0x02, 0x3D, 0x00, 0x30, 
+	0x0B, 0x3B, 0x6C, 0x2C, 0x01, 0x14, 0x81, 0x1D, 0x01, 0x30, 0x17, 0x2B, 0xD4, 0x53, 0x00, 0x10, 
+	0x40, 0xA5, 0x0C, 0x00, 0xDB, 0x0A, 0x00, 0xC2, 0x06, 0x01, 0x05, 0x00, 0x31, 0x01, 0x00, 0x40, 
+	0x60, 0x0A, 0x04, 0x01, 0x00, 0x90, 0x0A, 0xBC, 0x14, 0x00, 0x40, 0x00, 0x24, 0x2C, 0x0A, 0xD9, 
+	0x03, 0x11, 0xD0, 0x9F, 0x01, 0x10, 0x02, 0x0B, 0x00, 0x3B, 0x04, 0x00, 0xE0, 0x76, 0x13, 0x30, 
+	0x01, 0x3A, 0x81, 0x26, 0x04, 0x72, 0x4D, 0xCA, 0x00, 0x00, 0x10, 0x03, 0x8E, 0x64, 0x02, 0x01, 
+	0x01, 0x00, 0x10, 0x08, 0x18, 0x01, 0x04, 0x26, 0x10, 0x00, 0x01, 0x00, 0xE0, 0x0C, 0x28, 0x02, 
+	0x00, 0x20, 0x04, 0x23, 0x50, 0xFA, 0x00, 0x02, 0x80, 0x08, 0xB7, 0xA3, 0x03, 0x03, 0x4B, 0x0D, 
+	0x16, 0x89, 0x4C, 0x01, 0x00, 0x76, 0x0F, 0x20, 0x01, 0xF0, 0x52, 0x0C, 0x84, 0x00, 0x06, 0x7E, 
+	0x0A, 0x54, 0x00, 0x08, 0x20, 0xF8, 0x0C, 0x00, 0x19, 0x03, 0x00, 0xF8, 0x0C, 0x01, 0x9E, 0x00, 
+	0x00, 0x4C, 0x01, 0x51, 0x00, 0x20, 0x00, 0x1E, 0xF4, 0x52, 0x0C, 0x50, 0x21, 0x40, 0x00, 0x08, 
+	0x01, 0xEC, 0x0C, 0x05, 0x01, 0x00, 0x21, 0x90, 0xFB, 0xB3, 0x0A, 0x00, 0x2F, 0x02, 0x15, 0x80, 
+	0x90, 0x0F, 0x80, 0x40, 0x00, 0x00, 0x26, 0xEA, 0x00, 0x05, 0x03, 0xA7, 0x0A, 0x06, 0x1E, 0x12, 
+	0x02, 0x4C, 0x12, 0x18, 0x62, 0x1F, 0x14, 0xA8, 0x08, 0x00, 0x1C, 0x27, 0xF0, 0xF5, 0x00, 0x10, 
+	0x00, 0xD8, 0x60, 0x0A, 0x03, 0x7C, 0x00, 0x00, 0x5F, 0x0B, 0x02, 0x01, 0x00, 0x10, 0x04, 0x2E, 
+	0x0C, 0x60, 0x00, 0x0E, 0x00, 0x05, 0x00, 0x24, 0x28, 0x12, 0x01, 0x62, 0x00, 0x60, 0x26, 0x84, 
+	0x00, 0x18, 0x01, 0x30, 0x1F, 0x08, 0x01, 0x10, 0x00, 0x03, 0x64, 0x11, 0x00, 0x45, 0x12, 0x01, 
+	0x55, 0x0C, 0x00, 0xFA, 0x0A, 0x00, 0x40, 0x01, 0x80, 0x38, 0x0F, 0x00, 0x20, 0x40, 0x02, 0x50, 
+	0xA0, 0x41, 0x00, 0x36, 0x0B, 0xC0, 0x2C, 0xBA, 0x06, 0x10, 0x02, 0x98, 0x02, 0x00, 0x33, 0x00, 
+	0x40, 0x84, 0x08, 0x0E, 0x58, 0x0C, 0x00, 0xA8, 0x01, 0xE1, 0x06, 0x90, 0x00, 0x0D, 0x81, 0x03, 
+	0xCC, 0xE0, 0x4B, 0x01, 0x02, 0x2D, 0x08, 0x01, 0x01, 0x00, 0x50, 0x20, 0x00, 0xB1, 0x07, 0x30, 
+	0x76, 0x0B, 0x94, 0x00, 0x00, 0x20, 0xC0, 0x00, 0x50, 0xA0, 0x23, 0x30, 0x4E, 0x00, 0x00, 0x84, 
+	0x12, 0x62, 0x00, 0x00, 0x20, 0xCE, 0x00, 0x40, 0xAF, 0x0C, 0x31, 0x00, 0x07, 0x0E, 0xE6, 0x00, 
+	0xD0, 0x20, 0x00, 0x06, 0x80, 0x00, 0x05, 0x80, 0x02, 0x4C, 0xE0, 0x04, 0x2A, 0x94, 0x03, 0x11, 
+	0x00, 0x9C, 0x00, 0x40, 0x40, 0x00, 0x03, 0xF3, 0xA9, 0x10, 0x00, 0x06, 0x01, 0x41, 0x71, 0x00, 
+	0x09, 0x05, 0xC8, 0x11, 0x30, 0xC0, 0x08, 0x28, 0x1D, 0x05, 0x63, 0x23, 0x30, 0x21, 0xC0, 0x04, 
+	0x26, 0xA0, 0x00, 0x81, 0x00, 0x00, 0x03, 0x20, 0xCE, 0x00, 0x00, 0x02, 0x82, 0x00, 0x21, 0x20, 
+	0x13, 0xBA, 0x0B, 0x04, 0x01, 0x00, 0x30, 0x12, 0x0C, 0xE0, 0xEC, 0x08, 0x05, 0xE7, 0x03, 0x60, 
+	0x08, 0x33, 0x04, 0x00, 0x40, 0x3C, 0x53, 0x00, 0x49, 0x01, 0x02, 0x08, 0x99, 0xC0, 0x00, 0x81, 
+	0x30, 0x81, 0x00, 0x03, 0xC0, 0x34, 0xD1, 0x81, 0xE8, 0x03, 0x50, 0x50, 0x00, 0x20, 0xCE, 0x01, 
+	0x06, 0x00, 0x01, 0xDE, 0x0E, 0x12, 0x40, 0x53, 0x00, 0xF0, 0x09, 0xE1, 0x06, 0x04, 0x00, 0x25, 
+	0x00, 0x02, 0x4C, 0xE0, 0x20, 0x00, 0x00, 0x71, 0x7E, 0xE5, 0x00, 0x00, 0x02, 0xE0, 0x00, 0x05, 
+	0x0A, 0x03, 0x33, 0xBA, 0x04, 0x81, 0x03, 0x40, 0x08, 0x21, 0x80, 0x00, 0x00, 0x8B, 0xB0, 0x00, 
+	0x90, 0x10, 0x00, 0x28, 0x00, 0x21, 0x08, 0x00, 0x27, 0x30, 0xB4, 0x0A, 0x31, 0x3C, 0xEF, 0x32, 
+	0x3E, 0x00, 0x10, 0x5C, 0xF9, 0x00, 0x81, 0x00, 0x02, 0xF0, 0x01, 0xC1, 0x04, 0x10, 0x00, 0x17, 
+	0x06, 0x00, 0xE5, 0x09, 0x10, 0x05, 0x6F, 0x0E, 0x20, 0x52, 0x0C, 0x53, 0x00, 0x07, 0x8C, 0x00, 
+	0x00, 0x53, 0x00, 0x11, 0x2C, 0x40, 0x01, 0x41, 0x30, 0x50, 0xAF, 0x01, 0xBD, 0x0D, 0x85, 0x04, 
+	0x08, 0x81, 0x00, 0x00, 0xB0, 0x03, 0x30, 0x1F, 0x06, 0x70, 0x00, 0x01, 0x00, 0x80, 0xA7, 0xA0, 
+	0xCE, 0x0A, 0x00, 0x20, 0x1F, 0xBB, 0x80, 0x13, 0xC0, 0x01, 0x80, 0x00, 0x04, 0x01, 0x66, 0xC0, 
+	0x10, 0x24, 0x04, 0x00, 0x05, 0xA6, 0x00, 0x43, 0x00, 0x01, 0x14, 0x28, 0x45, 0x02, 0x30, 0x05, 
+	0x00, 0x00, 0x53, 0x00, 0x90, 0x00, 0x00, 0x0E, 0xB1, 0x00, 0x00, 0x18, 0x50, 0xAF, 0x0B, 0x00, 
+	0x40, 0x28, 0x0C, 0x00, 0x29, 0xEE, 0x01, 0x20, 0x37, 0x30, 0x0C, 0x05, 0x13, 0x14, 0xFC, 0x0B, 
+	0x61, 0xD0, 0x00, 0x24, 0xCE, 0x00, 0x40, 0x99, 0x06, 0x40, 0x01, 0x20, 0x01, 0x88, 0xCF, 0x06, 
+	0x13, 0x66, 0x51, 0x01, 0x32, 0x12, 0x0C, 0xE0, 0x1B, 0x04, 0x03, 0x53, 0x00, 0x42, 0x03, 0x33, 
+	0x00, 0x10, 0x2D, 0x04, 0x35, 0x11, 0x00, 0x08, 0x4B, 0x0D, 0x00, 0x01, 0x00, 0x71, 0x83, 0x30, 
+	0x00, 0x40, 0x01, 0x40, 0x2C, 0x19, 0x05, 0x27, 0x11, 0x01, 0x5E, 0x17, 0x0F, 0x51, 0x15, 0x08, 
+	0x0F, 0x01, 0x00, 0x1E, 0x05, 0x7C, 0x15, 0x0F, 0x01, 0x00, 0x3A, 0x01, 0x2A, 0x0A, 0x06, 0xB9, 
+	0x16, 0x0F, 0x01, 0x00, 0x0F, 0x0F, 0x3B, 0x18, 0x0A, 0x01, 0x9F, 0x02, 0x0A, 0x0B, 0x17, 0x08, 
+	0x0C, 0x00, 0x0F, 0x12, 0x16, 0x0D, 0x0F, 0x01, 0x00, 0x0D, 0x03, 0x47, 0x00, 0x01, 0x10, 0x02, 
+	0x06, 0x53, 0x04, 0x0F, 0x53, 0x00, 0x0E, 0x0F, 0x27, 0x17, 0x05, 0x0D, 0x01, 0x00, 0x0F, 0x05, 
+	0x01, 0x08, 0x16, 0x05, 0x45, 0x00, 0x0D, 0x4F, 0x00, 0x03, 0x41, 0x06, 0x0A, 0x4A, 0x00, 0x0E, 
+	0x64, 0x19, 0x02, 0xDE, 0x06, 0x0C, 0x15, 0x00, 0x00, 0xBA, 0x16, 0x0C, 0x19, 0x19, 0x06, 0x37, 
+	0x02, 0x07, 0x4C, 0x01, 0x03, 0x9D, 0x00, 0x07, 0xE0, 0x05, 0x0A, 0x01, 0x00, 0x08, 0x1B, 0x10, 
+	0x00, 0x2C, 0x0B, 0x05, 0xAA, 0x00, 0x0F, 0xCE, 0x18, 0x02, 0x0F, 0xDE, 0x19, 0x11, 0x01, 0x01, 
+	0x00, 0x09, 0xA9, 0x03, 0x0F, 0x01, 0x00, 0x09, 0x15, 0x10, 0x76, 0x0E, 0x0F, 0x01, 0x00, 0x0D, 
+	0x11, 0x84, 0xAB, 0x00, 0x06, 0xA4, 0x15, 0x0F, 0x01, 0x00, 0x21, 0x0F, 0xC0, 0x00, 0x16, 0x02, 
+	0x50, 0x0A, 0x09, 0x01, 0x00, 0x01, 0x74, 0x09, 0x0D, 0x01, 0x00, 0x03, 0xD2, 0x16, 0x07, 0x01, 
+	0x00, 0x13, 0x18, 0x60, 0x16, 0x0B, 0x01, 0x00, 0x04, 0xB4, 0x0D, 0x05, 0x01, 0x00, 0x3F, 0x02, 
+	0x80, 0xB3, 0x83, 0x1A, 0x04, 0x3A, 0x42, 0xC0, 0xA5, 0x11, 0x00, 0x16, 0x01, 0x14, 0x09, 0x09, 
+	0x01, 0x00, 0x20, 0x03, 0xA0, 0x4A, 0x0E, 0x07, 0x01, 0x00, 0x2F, 0x1C, 0xB3, 0x20, 0x01, 0x02, 
+	0x4A, 0x08, 0x00, 0x03, 0x4C, 0xA0, 0x08, 0x3F, 0x28, 0x08, 0xCC, 0x53, 0x00, 0x03, 0x39, 0x00, 
+	0x20, 0x08, 0xD0, 0x02, 0x21, 0x40, 0x02, 0x83, 0x14, 0x0F, 0x01, 0x00, 0x0F, 0x34, 0x34, 0x01, 
+	0xD8, 0xCF, 0x15, 0x0F, 0x01, 0x00, 0x10, 0x0F, 0x20, 0x02, 0x13, 0x2F, 0x01, 0xE0, 0x86, 0x03, 
+	0x0E, 0x32, 0x0B, 0xA6, 0x95, 0xB2, 0x0E, 0x0C, 0x01, 0x00, 0x09, 0x77, 0x07, 0x00, 0x56, 0x03, 
+	0x4E, 0xD8, 0x1F, 0x94, 0x14, 0xD6, 0x02, 0x12, 0x10, 0xF0, 0x02, 0x0E, 0x19, 0x02, 0x43, 0x24, 
+	0x0F, 0xA2, 0x04, 0x0C, 0x03, 0x09, 0xE4, 0x01, 0x00, 0x56, 0x1A, 0x09, 0x01, 0x00, 0x4B, 0x06, 
+	0x60, 0xD8, 0x30, 0x14, 0x00, 0x02, 0xB4, 0x03, 0x0D, 0xC7, 0x05, 0x3E, 0x04, 0x0E, 0x9C, 0x2F, 
+	0x02, 0x01, 0x01, 0x00, 0x32, 0x02, 0xC0, 0x08, 0x43, 0x00, 0x02, 0x11, 0x08, 0x4F, 0x06, 0x63, 
+	0xCD, 0x42, 0xAB, 0x02, 0x06, 0x03, 0xDD, 0x03, 0x02, 0x8F, 0x02, 0x44, 0x46, 0x0D, 0xE4, 0x30, 
+	0x49, 0x04, 0x19, 0x03, 0x3C, 0x04, 0x06, 0xB2, 0x0B, 0x01, 0x01, 0x00, 0x37, 0x20, 0x64, 0x18, 
+	0x4D, 0x1C, 0x25, 0x08, 0x10, 0xF8, 0x03, 0x2C, 0x01, 0xE2, 0x6A, 0x00, 0x2C, 0x36, 0x98, 0xA6, 
+	0x00, 0x31, 0x0F, 0xF2, 0xF9, 0x05, 0x02, 0x22, 0xD8, 0x7F, 0x10, 0x00, 0x03, 0x6A, 0x0B, 0x26, 
+	0x01, 0xCD, 0xDF, 0x19, 0x03, 0x01, 0x00, 0x20, 0x18, 0x07, 0xB9, 0x0A, 0x30, 0x00, 0x14, 0xC3, 
+	0x0F, 0x09, 0x05, 0xC0, 0x05, 0x39, 0x22, 0xCF, 0xFA, 0x45, 0x02, 0x03, 0xEB, 0x0A, 0x05, 0x02, 
+	0x05, 0x04, 0x10, 0x00, 0x59, 0x01, 0x14, 0x00, 0xF8, 0x7C, 0x50, 0x00, 0x04, 0xB0, 0x05, 0x2B, 
+	0x01, 0xC7, 0x09, 0x02, 0x02, 0x37, 0x04, 0x09, 0xAB, 0x02, 0x36, 0x0C, 0x1F, 0xD0, 0x58, 0x0C, 
+	0x03, 0x69, 0x09, 0x31, 0x0E, 0x00, 0x00, 0x91, 0x00, 0x03, 0x0C, 0x00, 0x00, 0x01, 0x00, 0x00, 
+	0xA8, 0x16, 0x11, 0xE4, 0x48, 0x0C, 0x09, 0x01, 0x00, 0x55, 0x04, 0x00, 0x00, 0x26, 0xE0, 0x5E, 
+	0x01, 0x12, 0x04, 0x32, 0x05, 0x0C, 0x7E, 0x02, 0x03, 0xF9, 0x00, 0x20, 0x62, 0x41, 0xA4, 0x0D, 
+	0x02, 0x01, 0x00, 0x62, 0x70, 0x00, 0x02, 0x68, 0x40, 0x28, 0x92, 0x1A, 0x16, 0xC0, 0x55, 0x00, 
+	0x3B, 0x03, 0x02, 0x94, 0x3C, 0x00, 0x0A, 0x6C, 0x00, 0x02, 0x01, 0x00, 0x00, 0xB2, 0x01, 0x07, 
+	0xBB, 0x1D, 0x00, 0x58, 0x0B, 0x04, 0x1C, 0x00, 0x02, 0x08, 0x00, 0x0F, 0xB1, 0x04, 0x12, 0x2A, 
+	0x0E, 0x08, 0x36, 0x06, 0x02, 0x45, 0x02, 0x02, 0x01, 0x00, 0x0A, 0x85, 0x02, 0x10, 0x15, 0x72, 
+	0x00, 0x15, 0x01, 0xFC, 0x01, 0x01, 0xEB, 0x0B, 0x0B, 0x1D, 0x08, 0x01, 0x27, 0x17, 0x05, 0x0D, 
+	0x00, 0x21, 0x58, 0xBD, 0x04, 0x01, 0x22, 0x01, 0x98, 0x89, 0x01, 0x09, 0x55, 0x02, 0x00, 0x8F, 
+	0x14, 0x03, 0x01, 0x00, 0x51, 0x01, 0x40, 0x1D, 0x8F, 0xE4, 0x95, 0x01, 0x17, 0x90, 0x58, 0x01, 
+	0x03, 0x16, 0x01, 0x05, 0x78, 0x1D, 0x00, 0x01, 0x00, 0x05, 0x5B, 0x02, 0x02, 0xB4, 0x00, 0x02, 
+	0xB9, 0x00, 0x22, 0x01, 0x3E, 0x14, 0x00, 0x13, 0x20, 0xB9, 0x0E, 0x02, 0x88, 0x00, 0x05, 0x01, 
+	0x00, 0x31, 0x0B, 0xA5, 0x09, 0x89, 0x01, 0x06, 0xED, 0x04, 0x31, 0x40, 0x00, 0xD3, 0x91, 0x00, 
+	0xA0, 0xF0, 0x3D, 0x46, 0x60, 0x00, 0x00, 0x28, 0xDB, 0xBD, 0x80, 0x9C, 0x0D, 0x30, 0x00, 0x00, 
+	0xF0, 0x48, 0x1A, 0x32, 0x16, 0x01, 0x60, 0x84, 0x14, 0x00, 0x6B, 0x0D, 0xF4, 0x02, 0x00, 0x0C, 
+	0x33, 0x40, 0x00, 0x00, 0x58, 0x01, 0x2A, 0x80, 0x05, 0x00, 0x00, 0x42, 0xAD, 0x9F, 0xE4, 0x36, 
+	0x02, 0x01, 0x05, 0x00, 0x23, 0x07, 0x93, 0x98, 0x02, 0x32, 0xC0, 0x00, 0x04, 0xA2, 0x05, 0x00, 
+	0xC4, 0x16, 0x12, 0x0C, 0x79, 0x16, 0x02, 0x98, 0x02, 0x12, 0x38, 0x20, 0x01, 0x34, 0xE8, 0x1C, 
+	0x48, 0x9F, 0x01, 0x11, 0x78, 0x3C, 0x14, 0x10, 0x50, 0x41, 0x00, 0x16, 0x40, 0x29, 0x06, 0x4B, 
+	0x01, 0x03, 0xA7, 0x2C, 0xBD, 0x07, 0x46, 0x20, 0x14, 0xD9, 0x90, 0x80, 0x1E, 0x02, 0x62, 0x18, 
+	0x78, 0x03, 0x80, 0x00, 0x0A, 0xF3, 0x70, 0xC0, 0x9E, 0x04, 0x73, 0x0E, 0x00, 0x1E, 0x02, 0x00, 
+	0x66, 0x40, 0x55, 0x0D, 0x19, 0xE0, 0x81, 0x01, 0x00, 0x32, 0x00, 0x12, 0x42, 0xA6, 0x14, 0x02, 
+	0x0D, 0x00, 0x01, 0xB0, 0x00, 0x12, 0x0F, 0xBA, 0x14, 0x34, 0x00, 0x43, 0x6A, 0x4F, 0x15, 0x02, 
+	0x01, 0x00, 0x00, 0xEB, 0x02, 0x04, 0x84, 0x00, 0x04, 0xDE, 0x1A, 0x81, 0x04, 0x09, 0x00, 0x00, 
+	0x01, 0x42, 0xB4, 0xB0, 0xCE, 0x0F, 0x01, 0x63, 0x17, 0x81, 0x80, 0x20, 0x00, 0x40, 0x25, 0x93, 
+	0xE4, 0x94, 0x43, 0x00, 0x10, 0x20, 0x93, 0x01, 0x10, 0x80, 0x0E, 0x0C, 0x93, 0x50, 0x02, 0x02, 
+	0x02, 0x00, 0x04, 0x00, 0x2E, 0xDB, 0x42, 0x00, 0x94, 0x10, 0x00, 0x10, 0x04, 0x00, 0x20, 0x00, 
+	0x0F, 0x3D, 0x81, 0x0F, 0x00, 0x01, 0x00, 0x07, 0x39, 0x09, 0x20, 0x06, 0x1D, 0xBA, 0x02, 0x04, 
+	0x5A, 0x0F, 0x50, 0xA0, 0x00, 0x02, 0x0F, 0xA2, 0xDE, 0x1C, 0x05, 0xDC, 0x05, 0x01, 0x6C, 0x13, 
+	0x00, 0xC7, 0x01, 0x23, 0x23, 0x5B, 0x37, 0x04, 0x03, 0x01, 0x00, 0x3A, 0x61, 0x78, 0xFA, 0x59, 
+	0x03, 0x01, 0xB5, 0x15, 0x00, 0x8E, 0x01, 0x40, 0xE6, 0xE5, 0xB0, 0x00, 0xF6, 0x0B, 0x10, 0x70, 
+	0x67, 0x0B, 0x03, 0x37, 0x13, 0x11, 0x82, 0xB0, 0x0C, 0x00, 0xEA, 0x0E, 0x01, 0x8F, 0x03, 0x10, 
+	0x04, 0xAC, 0x1B, 0x01, 0x01, 0x00, 0x00, 0x9D, 0x01, 0x50, 0x08, 0x1C, 0x50, 0x00, 0x10, 0x5B, 
+	0x14, 0x06, 0x01, 0x00, 0x50, 0x1E, 0x00, 0x1A, 0x10, 0x60, 0xAB, 0x01, 0x15, 0x28, 0xCC, 0x18, 
+	0x11, 0x20, 0x7A, 0x15, 0x92, 0x24, 0x00, 0x80, 0x20, 0x00, 0x00, 0x16, 0xC4, 0x20, 0x92, 0x19, 
+	0x01, 0x5F, 0x1D, 0x10, 0x40, 0x7D, 0x0B, 0x40, 0x10, 0x02, 0x00, 0x22, 0xD5, 0x19, 0x00, 0xC7, 
+	0x02, 0x01, 0x41, 0x04, 0x01, 0x53, 0x0F, 0x36, 0x02, 0x61, 0xC3, 0xF4, 0x00, 0x04, 0xEB, 0x02, 
+	0x41, 0x01, 0x00, 0x00, 0x15, 0x1B, 0x02, 0x10, 0x10, 0x2A, 0x13, 0xB1, 0x0B, 0x01, 0x68, 0x80, 
+	0x20, 0x00, 0x02, 0x25, 0x90, 0x26, 0x04, 0x5C, 0x05, 0xC5, 0x20, 0x03, 0x40, 0x00, 0xC0, 0x00, 
+	0x08, 0x80, 0x05, 0x0B, 0x02, 0x80, 0xC0, 0x02, 0x10, 0x08, 0xA9, 0x02, 0x01, 0x80, 0x1E, 0x54, 
+	0x04, 0x00, 0x0F, 0x01, 0x48, 0xDC, 0x01, 0x02, 0x45, 0x02, 0x00, 0x9F, 0x01, 0x31, 0x20, 0x00, 
+	0x01, 0xE2, 0x01, 0x20, 0x00, 0xC0, 0xA0, 0x13, 0x06, 0x93, 0x09, 0x02, 0x4C, 0x01, 0x11, 0xA0, 
+	0x31, 0x00, 0x73, 0xA0, 0x0D, 0x10, 0x08, 0x01, 0x02, 0x2E, 0x6C, 0x11, 0x00, 0x61, 0x08, 0x00, 
+	0x8A, 0x04, 0x00, 0xE3, 0x01, 0x11, 0x1E, 0x21, 0x17, 0x01, 0x2B, 0x00, 0x02, 0xA1, 0x00, 0x90, 
+	0x01, 0xE1, 0x00, 0x01, 0x00, 0xC0, 0x00, 0x03, 0x86, 0x17, 0x00, 0x00, 0xF2, 0x00, 0x07, 0x22, 
+	0x08, 0x01, 0x60, 0x00, 0x02, 0x7B, 0x01, 0x00, 0x9F, 0x00, 0xD0, 0x02, 0xC0, 0x00, 0x08, 0x00, 
+	0x02, 0x74, 0x5C, 0xBF, 0x00, 0x00, 0x08, 0x03, 0x20, 0x03, 0x00, 0x8C, 0x02, 0x15, 0x1C, 0x1E, 
+	0x04, 0x06, 0x30, 0x05, 0x00, 0xA6, 0x00, 0xA1, 0xE0, 0x01, 0xE6, 0x76, 0xA7, 0xA0, 0x00, 0x04, 
+	0x82, 0x08, 0xB3, 0x19, 0x00, 0xF9, 0x00, 0x00, 0x1E, 0x00, 0x01, 0x53, 0x1C, 0x01, 0x00, 0x0E, 
+	0x67, 0x40, 0x00, 0x80, 0x01, 0x10, 0x03, 0xF9, 0x00, 0x20, 0x01, 0x08, 0x8B, 0x04, 0x00, 0x6E, 
+	0x17, 0x00, 0x98, 0x02, 0x01, 0x70, 0x03, 0xD6, 0x04, 0x00, 0x00, 0x29, 0x60, 0x00, 0x40, 0x10, 
+	0x00, 0x80, 0xE0, 0x00, 0x09, 0xE8, 0x02, 0x60, 0x08, 0x00, 0x10, 0x01, 0x2A, 0x64, 0xE6, 0x01, 
+	0x00, 0x6C, 0x17, 0x05, 0xCE, 0x00, 0x12, 0xE0, 0xAD, 0x00, 0x52, 0x01, 0x00, 0x02, 0x08, 0x34, 
+	0x2F, 0x00, 0x10, 0x01, 0x97, 0x1D, 0x20, 0x19, 0x80, 0x9C, 0x00, 0x07, 0x2B, 0x04, 0x00, 0xDF, 
+	0x16, 0x01, 0x94, 0x11, 0x11, 0x01, 0x14, 0x00, 0x00, 0xB1, 0x13, 0x00, 0x06, 0x1A, 0x40, 0x00, 
+	0x2D, 0x98, 0x00, 0xD5, 0x0E, 0x04, 0x45, 0x08, 0x30, 0x20, 0x01, 0x40, 0x6D, 0x05, 0x40, 0x88, 
+	0x00, 0x0B, 0x10, 0x98, 0x18, 0x05, 0x36, 0x02, 0x95, 0x01, 0x80, 0x50, 0x59, 0x90, 0x00, 0x2C, 
+	0x3C, 0x00, 0xF8, 0x1B, 0x00, 0xAA, 0x1B, 0x21, 0x02, 0x60, 0xA7, 0x1E, 0x05, 0xD3, 0x03, 0x00, 
+	0x98, 0x02, 0x58, 0x50, 0x01, 0x00, 0x20, 0x20, 0x6D, 0x02, 0x10, 0x20, 0x81, 0x0E, 0x00, 0xCF, 
+	0x14, 0xB1, 0x00, 0x03, 0xCC, 0xC0, 0x02, 0x00, 0x14, 0x01, 0x40, 0x08, 0x40, 0x98, 0x02, 0x5D, 
+	0x0A, 0x00, 0x00, 0x18, 0x20, 0xE7, 0x08, 0x02, 0xE1, 0x23, 0x10, 0xCD, 0x7E, 0x01, 0x01, 0x33, 
+	0x01, 0xD3, 0x02, 0x08, 0x20, 0x90, 0x07, 0xF2, 0x94, 0x00, 0x20, 0x02, 0xE0, 0x14, 0xB9, 0xC8, 
+	0x11, 0x01, 0x00, 0x11, 0x60, 0x81, 0x00, 0x80, 0x0D, 0x0A, 0x08, 0x42, 0x17, 0x03, 0xE7, 0x01, 
+	0xE2, 0x10, 0x00, 0x08, 0x0A, 0x3B, 0x29, 0xC0, 0x00, 0x00, 0x26, 0x02, 0x00, 0x66, 0x00, 0x1D, 
+	0x1F, 0x30, 0x00, 0x00, 0x68, 0xDB, 0x15, 0x32, 0x00, 0x80, 0x93, 0xA6, 0x00, 0x01, 0x42, 0x22, 
+	0x40, 0x80, 0x08, 0x00, 0xF0, 0xCD, 0x1C, 0x53, 0x20, 0x03, 0xE3, 0x14, 0x96, 0xCB, 0x01, 0x30, 
+	0x20, 0x01, 0x60, 0x06, 0x02, 0x40, 0x80, 0x07, 0x80, 0x90, 0xF9, 0x00, 0x42, 0x1C, 0x3B, 0x4F, 
+	0x40, 0x98, 0x02, 0x11, 0x08, 0xEB, 0x02, 0x10, 0x0E, 0xC1, 0x17, 0x03, 0x01, 0x00, 0x81, 0x14, 
+	0x28, 0x01, 0x02, 0x60, 0x00, 0x30, 0x38, 0xEB, 0x02, 0x30, 0x02, 0x00, 0x27, 0x6F, 0x04, 0x41, 
+	0xC0, 0x38, 0x02, 0x50, 0x80, 0x10, 0x30, 0x0A, 0xC4, 0x03, 0xAC, 0x0E, 0x01, 0x91, 0x03, 0xA2, 
+	0x01, 0xE0, 0x15, 0x00, 0xF0, 0x01, 0x80, 0x00, 0x0D, 0x04, 0x29, 0x02, 0x00, 0xDF, 0x01, 0xD2, 
+	0x0A, 0x81, 0x00, 0x00, 0x0E, 0x02, 0x04, 0x10, 0x00, 0x01, 0x20, 0x70, 0xFA, 0xC5, 0x18, 0x00, 
+	0x47, 0x02, 0x30, 0x01, 0x58, 0xF0, 0xC3, 0x1E, 0x70, 0x10, 0x28, 0x41, 0x00, 0x40, 0x00, 0x06, 
+	0x33, 0x23, 0x00, 0x70, 0x04, 0x90, 0x08, 0x01, 0x39, 0x08, 0x20, 0x00, 0x01, 0xC0, 0x1C, 0xBE, 
+	0x1C, 0x02, 0x01, 0x00, 0x00, 0xE9, 0x00, 0xA1, 0x02, 0x00, 0x00, 0x0C, 0x54, 0x2A, 0x80, 0x08, 
+	0x01, 0x24, 0x2D, 0x01, 0xD3, 0x08, 0x0B, 0x80, 0x03, 0x98, 0x80, 0x60, 0x40, 0x0E, 0x00, 0x20, 
+	0x69, 0xED, 0x8C, 0x01, 0x12, 0x0E, 0xC9, 0x02, 0x92, 0x38, 0x08, 0x70, 0x18, 0x61, 0x55, 0x00, 
+	0xE0, 0x02, 0x83, 0x05, 0x00, 0x98, 0x02, 0x93, 0x03, 0x7E, 0x90, 0x00, 0x20, 0x08, 0xC3, 0x40, 
+	0x98, 0x7B, 0x01, 0x00, 0xF9, 0x00, 0x70, 0xA6, 0x60, 0x00, 0x80, 0x03, 0x10, 0x50, 0x47, 0x18, 
+	0x02, 0x80, 0x01, 0xE2, 0x08, 0x01, 0x00, 0x05, 0x0A, 0xDA, 0x7F, 0x00, 0x04, 0x00, 0x20, 0x2C, 
+	0xDA, 0x82, 0xCD, 0x04, 0xD1, 0x04, 0x00, 0x0E, 0x00, 0x41, 0x66, 0x08, 0x10, 0x00, 0x81, 0xC8, 
+	0x61, 0x55, 0xA6, 0x00, 0x04, 0x01, 0x00, 0x20, 0x09, 0x65, 0xA0, 0x1A, 0x31, 0x42, 0x40, 0x05, 
+	0x99, 0x1A, 0x01, 0x24, 0x04, 0x01, 0xA1, 0x05, 0x77, 0x47, 0x80, 0xBF, 0xA4, 0x00, 0x00, 0x01, 
+	0x2A, 0x09, 0x95, 0x06, 0x60, 0x00, 0x04, 0x00, 0x24, 0x05, 0xEE, 0x55, 0x12, 0x00, 0x84, 0x29, 
+	0x40, 0x00, 0x40, 0x10, 0x02, 0x18, 0x07, 0x1F, 0x23, 0x02, 0x01, 0x00, 0x40, 0x10, 0x83, 0x60, 
+	0x84, 0xD6, 0x05, 0x10, 0x1C, 0x93, 0x01, 0x02, 0x13, 0x00, 0x12, 0x02, 0xD9, 0x12, 0x10, 0x1B, 
+	0x30, 0x03, 0x51, 0x40, 0x14, 0x7D, 0xD9, 0x7A, 0x16, 0x00, 0x41, 0x08, 0x00, 0xF3, 0xD2, 0x71, 
+	0x18, 0x17, 0x6E, 0x3D, 0x09, 0xF0, 0x00, 0xC0, 0x00, 0x60, 0x00, 0x38, 0x01, 0x80, 0x60, 0x41, 
+	0x00, 0x02, 0x43, 0xE6, 0x4E, 0xCD, 0x30, 0x05, 0x40, 0x00, 0x20, 0x10, 0x95, 0x74, 0x17, 0x61, 
+	0x00, 0x24, 0x0C, 0x05, 0x50, 0x04, 0x53, 0x00, 0x50, 0x0A, 0x00, 0x02, 0x80, 0xE0, 0x1B, 0x00, 
+	0x20, 0x09, 0x9B, 0x3C, 0x00, 0x50, 0x14, 0x01, 0xDC, 0x40, 0x08, 0x4C, 0x02, 0x00, 0xCF, 0x15, 
+	0x10, 0x10, 0xAB, 0x00, 0x10, 0x1E, 0x19, 0x15, 0x00, 0x01, 0x00, 0x22, 0x40, 0x14, 0x04, 0x1C, 
+	0x30, 0x01, 0xD3, 0xF8, 0xC6, 0x02, 0x20, 0x60, 0x2F, 0x2C, 0x19, 0x00, 0x2B, 0x00, 0x93, 0x0D, 
+	0x24, 0x60, 0x00, 0x00, 0x07, 0x62, 0x4C, 0x84, 0x24, 0x13, 0x02, 0x2E, 0x00, 0x01, 0xF2, 0x18, 
+	0x23, 0xC0, 0x18, 0xBA, 0x00, 0x10, 0x01, 0x6F, 0x07, 0xB3, 0x00, 0x10, 0x20, 0x40, 0x00, 0x80, 
+	0x26, 0x04, 0x00, 0x81, 0x60, 0xAF, 0x09, 0x20, 0x14, 0x01, 0x30, 0x05, 0x30, 0x04, 0x01, 0xA0, 
+	0x7C, 0x06, 0x11, 0x04, 0xA3, 0x19, 0x00, 0x3B, 0x00, 0xB2, 0x50, 0x90, 0x29, 0x98, 0x00, 0x00, 
+	0xC0, 0x06, 0xEC, 0xF9, 0x90, 0xA6, 0x00, 0x00, 0x01, 0x00, 0x11, 0xF0, 0xD5, 0x01, 0x21, 0x97, 
+	0x52, 0x0D, 0x00, 0x01, 0x5F, 0x09, 0xC4, 0x30, 0x00, 0x05, 0x08, 0x58, 0x59, 0x80, 0x00, 0x00, 
+	0x14, 0x2A, 0x01, 0xE3, 0x1E, 0x01, 0x25, 0x01, 0x00, 0xA6, 0x00, 0x21, 0xE9, 0x2C, 0x71, 0x04, 
+	0x02, 0xB0, 0x1F, 0x60, 0x21, 0x00, 0x51, 0x0B, 0xEB, 0x0C, 0xEC, 0x01, 0x22, 0x34, 0x9C, 0x6E, 
+	0x06, 0x21, 0x00, 0x04, 0x9F, 0x0B, 0x31, 0x01, 0x00, 0x0B, 0x25, 0x00, 0x31, 0x01, 0x2C, 0x3B, 
+	0x09, 0x1A, 0xD5, 0x01, 0x00, 0x0D, 0x9E, 0xDF, 0x10, 0xD2, 0x04, 0x00, 0x54, 0x03, 0xFC, 0x8C, 
+	0x51, 0x00, 0x71, 0x28, 0x1C, 0x10, 0x40, 0x70, 0x00, 0x81, 0x5D, 0x01, 0x30, 0x0A, 0x00, 0x1C, 
+	0xA4, 0x05, 0x50, 0x3C, 0x00, 0x00, 0xB9, 0x91, 0x3E, 0x12, 0x30, 0x04, 0x02, 0xB5, 0x97, 0x1D, 
+	0x03, 0x01, 0x00, 0x01, 0x0C, 0x03, 0x82, 0x00, 0x80, 0x02, 0x80, 0x18, 0x08, 0x06, 0x14, 0xCD, 
+	0x01, 0xC3, 0x0B, 0x80, 0x0D, 0x19, 0x82, 0x0C, 0xC0, 0x0E, 0x00, 0x86, 0x06, 0x0C, 0xF2, 0x01, 
+	0x00, 0x07, 0x03, 0x90, 0x1E, 0x10, 0x40, 0xB8, 0x00, 0x71, 0x80, 0x00, 0x09, 0xBD, 0x04, 0x01, 
+	0x6F, 0x02, 0x00, 0x4C, 0x01, 0xC0, 0xA0, 0x2F, 0x30, 0x12, 0x00, 0x01, 0xC6, 0xA7, 0xA0, 0x00, 
+	0x00, 0x86, 0xA7, 0x00, 0x00, 0xE9, 0x02, 0x00, 0x60, 0x0A, 0x20, 0x03, 0x80, 0x19, 0x20, 0x42, 
+	0x2B, 0x00, 0x3C, 0x10, 0x2D, 0x00, 0x20, 0x05, 0x1E, 0x91, 0x12, 0x40, 0x00, 0x00, 0x2B, 0xC9, 
+	0xE4, 0x1F, 0x00, 0x01, 0x00, 0x00, 0x2F, 0x24, 0x00, 0xF9, 0x00, 0xD1, 0xF1, 0x81, 0x00, 0x01, 
+	0x00, 0x04, 0x08, 0x00, 0x40, 0xE1, 0x04, 0x00, 0x23, 0xD2, 0x0A, 0x10, 0x2B, 0x6C, 0x01, 0x35, 
+	0xC7, 0x6E, 0xAC, 0x44, 0x0A, 0x04, 0xF5, 0x0F, 0x10, 0x9F, 0x4A, 0x00, 0x10, 0x14, 0x25, 0x06, 
+	0x20, 0x05, 0x52, 0xDC, 0x00, 0x92, 0x02, 0x0C, 0xE0, 0x14, 0x00, 0x20, 0x65, 0xFB, 0x0C, 0x9E, 
+	0x01, 0x01, 0x3B, 0x16, 0x73, 0x00, 0x00, 0x10, 0x0C, 0x01, 0xCB, 0x3F, 0x5E, 0x0B, 0x12, 0x26, 
+	0x04, 0x26, 0x90, 0x00, 0x03, 0x30, 0x00, 0x04, 0x00, 0x64, 0x17, 0xF3, 0x3A, 0x03, 0x10, 0x80, 
+	0x94, 0x07, 0x71, 0xC4, 0x3E, 0xEC, 0x80, 0x00, 0x00, 0x89, 0x97, 0x01, 0x50, 0x08, 0x1C, 0x61, 
+	0xC0, 0x08, 0x44, 0x04, 0x03, 0x30, 0x14, 0xA0, 0x20, 0x2E, 0x61, 0xEC, 0x0C, 0x00, 0x00, 0x04, 
+	0x71, 0xC8, 0x42, 0x00, 0x20, 0x22, 0xDA, 0x58, 0x01, 0x11, 0x80, 0xFD, 0x09, 0x20, 0x11, 0x63, 
+	0xE7, 0x23, 0x11, 0x3C, 0x50, 0x13, 0x00, 0x4C, 0x01, 0x40, 0x00, 0x44, 0x06, 0x96, 0x32, 0x01, 
+	0x90, 0x00, 0x38, 0x01, 0x00, 0x00, 0x04, 0x1D, 0xD6, 0x60, 0xB2, 0x02, 0x00, 0x4E, 0x15, 0x20, 
+	0x40, 0x04, 0x4C, 0x01, 0x02, 0xD3, 0x08, 0x00, 0x53, 0x00, 0x40, 0x00, 0x00, 0x29, 0xF8, 0xBA, 
+	0x15, 0x20, 0xBD, 0xC1, 0x12, 0x00, 0xC2, 0x21, 0xDE, 0x09, 0x00, 0x00, 0x38, 0x01, 0x83, 0x60, 
+	0x14, 0x00, 0x0A, 0xCD, 0x13, 0x20, 0x03, 0x02, 0xBE, 0x02, 0xD6, 0x27, 0x30, 0x80, 0x00, 0x02, 
+	0x40, 0x0C, 0xB0, 0x60, 0x10, 0x00, 0x00, 0x8E, 0x9C, 0x08, 0x11, 0x11, 0xAF, 0x06, 0x53, 0x04, 
+	0xA6, 0x03, 0x5F, 0x22, 0x6D, 0x06, 0x10, 0x02, 0x53, 0x00, 0x30, 0x24, 0x72, 0x6F, 0x06, 0x05, 
+	0x11, 0x39, 0x22, 0x01, 0x02, 0x8F, 0x05, 0x12, 0x98, 0x4F, 0x02, 0x42, 0x60, 0x2F, 0x88, 0x80, 
+	0x9B, 0x06, 0x90, 0x90, 0x83, 0x30, 0x80, 0x00, 0x01, 0x66, 0xA4, 0xA8, 0x5D, 0x07, 0x10, 0x80, 
+	0x2A, 0x00, 0x12, 0xC0, 0x6A, 0x22, 0x20, 0x80, 0x5F, 0xDB, 0x13, 0x02, 0x62, 0x20, 0x60, 0x02, 
+	0xF0, 0x00, 0x00, 0x01, 0x52, 0x53, 0x00, 0x30, 0x0E, 0x2F, 0xCC, 0x80, 0x04, 0x10, 0x18, 0xE1, 
+	0x04, 0x00, 0xAC, 0x15, 0x60, 0x68, 0x00, 0x00, 0x51, 0x85, 0x7A, 0x10, 0x07, 0x41, 0x02, 0x80, 
+	0x00, 0x24, 0xD6, 0x0C, 0xF0, 0x01, 0x11, 0x00, 0x33, 0x30, 0x83, 0x00, 0x41, 0xC3, 0xC3, 0x05, 
+	0x50, 0x03, 0x10, 0x00, 0x10, 0xB0, 0x0F, 0x03, 0x01, 0x3B, 0x20, 0x12, 0x07, 0xB8, 0x07, 0x60, 
+	0x04, 0x43, 0x4C, 0x82, 0x00, 0x04, 0xD5, 0x00, 0x11, 0x18, 0xA6, 0x00, 0xF0, 0x00, 0x0E, 0x05, 
+	0x6A, 0x55, 0x00, 0x30, 0x80, 0x11, 0x80, 0x00, 0x04, 0x40, 0x14, 0x60, 0xE0, 0xF7, 0x02, 0x10, 
+	0xB8, 0x88, 0x00, 0x52, 0x40, 0xD0, 0x02, 0x8C, 0xE2, 0x2C, 0x03, 0xF1, 0x01, 0x08, 0x90, 0x63, 
+	0x30, 0x01, 0x00, 0x01, 0x42, 0xED, 0xEE, 0x22, 0x12, 0x00, 0x00, 0x0D, 0x3A, 0xA2, 0x00, 0x97, 
+	0xC6, 0x60, 0x02, 0x08, 0x00, 0x09, 0xFA, 0x30, 0x20, 0x99, 0x0B, 0xF0, 0x03, 0x01, 0x81, 0x06, 
+	0x4C, 0xE0, 0x0E, 0x00, 0x34, 0x3A, 0x59, 0xA1, 0x40, 0x38, 0x40, 0x00, 0x19, 0x80, 0x2E, 0x0D, 
+	0x15, 0xA2, 0x66, 0x00, 0x38, 0x10, 0x18, 0xB5, 0xEF, 0x95, 0x01, 0xE0, 0xB3, 0x0A, 0x00, 0x78, 
+	0x11, 0x20, 0x98, 0x90, 0x42, 0x25, 0x22, 0x03, 0x60, 0xB9, 0x24, 0x71, 0x8C, 0x72, 0xC0, 0x00, 
+	0x00, 0x23, 0xF4, 0x22, 0x1D, 0x92, 0x00, 0x5E, 0x20, 0x80, 0x00, 0x01, 0x02, 0x26, 0xCC, 0x5A, 
+	0x06, 0x31, 0x09, 0x81, 0x58, 0x29, 0x0A, 0x60, 0x68, 0xD8, 0x33, 0x00, 0x00, 0x40, 0x77, 0x1A, 
+	0x01, 0x22, 0x05, 0x60, 0x40, 0x00, 0x02, 0x81, 0xC1, 0x28, 0x27, 0x03, 0x23, 0x60, 0x25, 0x25, 
+	0x2B, 0x11, 0x10, 0xCE, 0x24, 0x81, 0x03, 0x62, 0xFC, 0x0A, 0xA0, 0x01, 0x00, 0x09, 0x4C, 0x01, 
+	0xB0, 0x00, 0x16, 0x0F, 0xF0, 0x04, 0x00, 0x40, 0x08, 0x07, 0x8C, 0xC0, 0x9D, 0x1C, 0x16, 0x30, 
+	0x2E, 0x03, 0xB1, 0x90, 0x04, 0x00, 0x14, 0x02, 0x1E, 0x55, 0x40, 0x50, 0x00, 0x98, 0x39, 0x1A, 
+	0x00, 0xA2, 0x29, 0xE1, 0x12, 0x02, 0x10, 0x80, 0x68, 0xCC, 0x04, 0x40, 0x04, 0x06, 0x0F, 0xE5, 
+	0x50, 0x10, 0x7D, 0x08, 0x20, 0xD0, 0x2C, 0x86, 0x00, 0x40, 0x04, 0x24, 0x0A, 0x50, 0x5B, 0x01, 
+	0x01, 0x54, 0x0C, 0x01, 0x20, 0x18, 0x60, 0x01, 0x10, 0xFF, 0x80, 0x08, 0x60, 0x6B, 0x29, 0x00, 
+	0x1F, 0x11, 0x01, 0x1E, 0x08, 0xD0, 0x40, 0x90, 0x00, 0x04, 0x00, 0x2A, 0x00, 0x5A, 0x40, 0xC0, 
+	0x00, 0x01, 0xE8, 0x29, 0x00, 0xF3, 0x01, 0x70, 0x1A, 0x10, 0x41, 0x00, 0x38, 0x80, 0xAF, 0xE4, 
+	0x40, 0x05, 0x00, 0x80, 0x07, 0x86, 0x0C, 0xF2, 0x02, 0x21, 0x81, 0xE1, 0xD9, 0x17, 0x20, 0x00, 
+	0xC0, 0x2C, 0x0D, 0x23, 0x1F, 0x78, 0x59, 0x06, 0x02, 0x44, 0x0C, 0x00, 0xCF, 0x02, 0x23, 0x24, 
+	0xEB, 0x67, 0x04, 0x23, 0x01, 0x1F, 0x89, 0x0F, 0x01, 0x7E, 0x04, 0x11, 0xCD, 0x72, 0x26, 0x43, 
+	0x0C, 0x10, 0x60, 0x40, 0x77, 0x2C, 0xD0, 0x02, 0x62, 0x75, 0xD2, 0x10, 0x10, 0x00, 0x02, 0x02, 
+	0x80, 0x70, 0xE0, 0xA3, 0xC1, 0x07, 0x20, 0x20, 0x14, 0x74, 0x22, 0x10, 0x09, 0xB5, 0x1A, 0x06, 
+	0x29, 0x10, 0x53, 0x16, 0x80, 0x10, 0x20, 0x1C, 0x0E, 0x00, 0x61, 0x10, 0x00, 0x1C, 0x77, 0xF9, 
+	0x08, 0x08, 0x0D, 0x00, 0xE6, 0x01, 0x08, 0x31, 0x0B, 0x44, 0x00, 0x05, 0x81, 0x69, 0xF9, 0x0C, 
+	0x00, 0x63, 0x01, 0x31, 0x50, 0x0D, 0xA4, 0xE5, 0x0F, 0x00, 0x07, 0x08, 0x40, 0x03, 0x80, 0x0A, 
+	0x50, 0xBF, 0x1B, 0x00, 0x59, 0x05, 0x50, 0x02, 0x81, 0x00, 0x02, 0x26, 0x4F, 0x00, 0x02, 0x32, 
+	0x0C, 0x10, 0x20, 0x5D, 0x1C, 0x11, 0x70, 0x21, 0x03, 0xC1, 0x0E, 0x10, 0x48, 0x40, 0x00, 0x59, 
+	0xD0, 0x00, 0x00, 0x01, 0x74, 0x05, 0xFC, 0x07, 0x40, 0xD8, 0xA5, 0x02, 0x64, 0x08, 0x00, 0x03, 
+	0xE6, 0x1B, 0x40, 0x10, 0x00, 0x80, 0x34, 0xCE, 0x1B, 0xF3, 0x01, 0x20, 0x00, 0x00, 0x42, 0x0F, 
+	0x00, 0x05, 0x00, 0x90, 0x00, 0xC0, 0x00, 0x26, 0x41, 0x05, 0x50, 0x19, 0x03, 0x16, 0x0C, 0xB2, 
+	0x04, 0x00, 0x62, 0x01, 0x90, 0x90, 0x04, 0x00, 0x1C, 0x01, 0xE0, 0x00, 0x40, 0x30, 0x16, 0x27, 
+	0x50, 0x0C, 0x00, 0x06, 0x64, 0x7A, 0x1B, 0x07, 0x01, 0x07, 0x23, 0x22, 0xC0, 0x88, 0x81, 0x0C, 
+	0x00, 0x7B, 0x04, 0x31, 0xA5, 0x03, 0xFC, 0x35, 0x00, 0xF0, 0x01, 0xF0, 0x00, 0x0C, 0x03, 0x0F, 
+	0x00, 0x9A, 0xC0, 0x80, 0x10, 0x20, 0x00, 0x83, 0xC0, 0x80, 0x90, 0x47, 0x18, 0x00, 0x70, 0x06, 
+	0x10, 0x7A, 0xDC, 0x10, 0x61, 0x60, 0x03, 0x83, 0x85, 0x0A, 0xB0, 0xF6, 0x01, 0x50, 0x04, 0x01, 
+	0x02, 0x48, 0x3C, 0x2A, 0x19, 0xE1, 0x1E, 0x00, 0x86, 0x00, 0x00, 0x3C, 0x69, 0x0A, 0x00, 0x00, 
+	0xE7, 0x20, 0xCC, 0x00, 0x98, 0x02, 0x04, 0x8A, 0x0E, 0xE0, 0x3F, 0x30, 0x10, 0x00, 0x03, 0x43, 
+	0x5C, 0x00, 0x80, 0x00, 0x12, 0x00, 0x0A, 0x32, 0x6B, 0x00, 0xF0, 0x00, 0x16, 0x0F, 0xF0, 0x08, 
+	0x00, 0x27, 0x00, 0x02, 0xB3, 0x09, 0x00, 0x00, 0x5C, 0x3E, 0x58, 0x74, 0x06, 0x00, 0xBA, 0x09, 
+	0x20, 0x02, 0x4C, 0xBA, 0x0D, 0xC1, 0x06, 0x00, 0x00, 0x50, 0x42, 0x00, 0x01, 0xB0, 0x04, 0x00, 
+	0xA0, 0x06, 0x77, 0x01, 0x11, 0x04, 0xA1, 0x17, 0x00, 0x45, 0x04, 0x10, 0xC2, 0x54, 0x00, 0x2F, 
+	0x11, 0x02, 0xBC, 0x2E, 0x03, 0x0F, 0x86, 0x12, 0x00, 0x0F, 0x71, 0x0F, 0x08, 0x19, 0x02, 0xC4, 
+	0x10, 0x07, 0x72, 0x03, 0x05, 0xF1, 0x0C, 0x02, 0x0C, 0x00, 0x00, 0x7A, 0x01, 0x07, 0xE0, 0x0C, 
+	0x0F, 0x7B, 0x17, 0x17, 0x0B, 0xB3, 0x11, 0x01, 0xC5, 0x0C, 0x22, 0x00, 0x01, 0xA3, 0x12, 0x02, 
+	0x20, 0x1F, 0x01, 0x01, 0x00, 0x1F, 0x08, 0xA6, 0x00, 0x01, 0x21, 0x03, 0xF0, 0xE1, 0x16, 0x11, 
+	0x0C, 0x45, 0x03, 0x04, 0x01, 0x00, 0x15, 0xC0, 0x2F, 0x15, 0x03, 0x85, 0x00, 0x17, 0x28, 0x9A, 
+	0x00, 0x09, 0xFD, 0x00, 0x06, 0x6E, 0x0F, 0x0F, 0x7D, 0x18, 0x16, 0x03, 0xA1, 0x10, 0x01, 0x6B, 
+	0x05, 0x12, 0x0C, 0x19, 0x11, 0x08, 0xBC, 0x2E, 0x04, 0xD5, 0x11, 0x0B, 0x01, 0x00, 0x08, 0x88, 
+	0x01, 0x0F, 0xE0, 0x2F, 0x04, 0x08, 0xED, 0x14, 0x09, 0xF9, 0x14, 0x1B, 0x0A, 0x8A, 0x14, 0x00, 
+	0x4C, 0x00, 0x04, 0xAF, 0x00, 0x00, 0x22, 0x06, 0x06, 0xBB, 0x00, 0x3B, 0xBC, 0x00, 0x78, 0xBC, 
+	0x11, 0x01, 0x40, 0x01, 0x0E, 0x05, 0x02, 0x07, 0x5E, 0x17, 0x17, 0x08, 0x0A, 0x22, 0x27, 0x00, 
+	0xA0, 0x0C, 0x00, 0x0B, 0xE2, 0x01, 0x04, 0x05, 0x12, 0x02, 0xFF, 0x21, 0x09, 0x20, 0x00, 0x0F, 
+	0x01, 0x00, 0x06, 0x03, 0x61, 0x07, 0x03, 0x0C, 0x00, 0x08, 0x01, 0x00, 0x01, 0xAE, 0x02, 0x02, 
+	0x0B, 0x00, 0x21, 0x96, 0x81, 0xE0, 0x0E, 0x03, 0xA6, 0x01, 0x20, 0x10, 0x1B, 0x0F, 0x2B, 0x01, 
+	0x89, 0x0A, 0x42, 0x01, 0x54, 0xEC, 0x00, 0x9E, 0x23, 0x72, 0x00, 0x10, 0x1C, 0x28, 0x00, 0x00, 
+	0x01, 0x1F, 0x23, 0x03, 0x0B, 0x02, 0x20, 0x09, 0xF0, 0xF5, 0x04, 0x01, 0x01, 0x00, 0x38, 0x80, 
+	0x15, 0x40, 0xF0, 0x0D, 0x01, 0x16, 0x00, 0x12, 0x1C, 0x73, 0x11, 0xB0, 0x20, 0x00, 0x99, 0xA1, 
+	0x8D, 0x9B, 0x00, 0x1C, 0x05, 0xCC, 0x5B, 0x60, 0x00, 0x53, 0x01, 0x55, 0xEC, 0x80, 0x10, 0x11, 
+	0x30, 0x21, 0x00, 0x38, 0x5C, 0x00, 0x12, 0x01, 0xB2, 0x04, 0xF7, 0x04, 0x05, 0x00, 0x21, 0x98, 
+	0x50, 0x50, 0xA0, 0x00, 0x41, 0x03, 0x30, 0x43, 0x44, 0x10, 0x00, 0x80, 0x15, 0x41, 0x0F, 0x4E, 
+	0x1D, 0x02, 0x17, 0x01, 0x04, 0xCD, 0x00, 0x10, 0x80, 0x3F, 0x0F, 0x41, 0x08, 0x05, 0xCC, 0x17, 
+	0x0E, 0x00, 0x46, 0x05, 0xED, 0xD8, 0x0A, 0x48, 0x02, 0x08, 0x1F, 0x01, 0x20, 0x02, 0x00, 0xCB, 
+	0x25, 0x21, 0x00, 0x81, 0x0E, 0x08, 0x56, 0x00, 0x00, 0x00, 0x37, 0x97, 0x4C, 0x00, 0x02, 0x01, 
+	0x00, 0x05, 0x10, 0x11, 0x11, 0x90, 0xA6, 0x01, 0x30, 0x01, 0xCC, 0x16, 0xA6, 0x00, 0x10, 0x08, 
+	0xD4, 0x0C, 0x05, 0x63, 0x0B, 0x01, 0xD2, 0x04, 0x06, 0xC3, 0x01, 0x91, 0x01, 0xC0, 0x00, 0xB0, 
+	0x00, 0x08, 0x83, 0x30, 0x40, 0x49, 0x0D, 0x03, 0x1F, 0x10, 0x0F, 0x01, 0x00, 0x00, 0x31, 0x80, 
+	0x00, 0xD6, 0x2F, 0x00, 0x23, 0xCC, 0x90, 0xA6, 0x01, 0x10, 0x79, 0x22, 0x01, 0x0F, 0xB2, 0x01, 
+	0x02, 0x10, 0x0C, 0xD9, 0x00, 0x33, 0x28, 0x83, 0x3B, 0xBB, 0x05, 0x16, 0x05, 0x4A, 0x13, 0x0B, 
+	0x2F, 0x00, 0x01, 0xAC, 0x0D, 0xBE, 0x02, 0x01, 0xCC, 0x17, 0xB6, 0x68, 0x30, 0x00, 0x18, 0x00, 
+	0x0E, 0xDE, 0x17, 0x04, 0x01, 0x00, 0x01, 0x8F, 0x03, 0x71, 0x28, 0x03, 0x30, 0x41, 0x40, 0x00, 
+	0x50, 0xF4, 0x12, 0x0B, 0xF7, 0x19, 0x01, 0xB5, 0x0D, 0x01, 0x53, 0x00, 0x00, 0x63, 0x00, 0xA0, 
+	0x82, 0x01, 0xCC, 0x13, 0x80, 0x04, 0x40, 0x08, 0x08, 0x00, 0xEF, 0x05, 0x0F, 0x01, 0x00, 0x05, 
+	0x40, 0x40, 0x00, 0xB0, 0x04, 0x5A, 0x09, 0x00, 0x84, 0x05, 0x23, 0x08, 0x01, 0x52, 0x00, 0x41, 
+	0x20, 0x87, 0x80, 0x03, 0x8D, 0x2B, 0x06, 0x9B, 0x1B, 0x00, 0x53, 0x00, 0xD1, 0x40, 0x08, 0x01, 
+	0xCC, 0x90, 0x04, 0x00, 0x02, 0x04, 0x10, 0x14, 0x60, 0xD0, 0x21, 0x01, 0x06, 0x60, 0x0F, 0x02, 
+	0xAB, 0x03, 0x00, 0x46, 0x00, 0x11, 0x02, 0x6B, 0x1E, 0x20, 0x03, 0x3B, 0x82, 0x2B, 0x42, 0x01, 
+	0x02, 0x80, 0xE3, 0x1D, 0x00, 0x14, 0x20, 0xE9, 0x1F, 0x24, 0x00, 0x1D, 0x5B, 0x03, 0x20, 0x40, 
+	0x00, 0x9B, 0x18, 0x30, 0x01, 0xCC, 0x12, 0x14, 0x26, 0x50, 0x00, 0xF0, 0x0A, 0x00, 0x10, 0x12, 
+	0x0E, 0x16, 0x08, 0x1F, 0x01, 0x03, 0xC6, 0x0E, 0x00, 0x3C, 0x0F, 0x80, 0x50, 0xA0, 0x00, 0x02, 
+	0x03, 0x30, 0x41, 0x62, 0x19, 0x04, 0x36, 0xC5, 0xB5, 0x0E, 0x03, 0x03, 0x03, 0xF1, 0x1F, 0x00, 
+	0xFF, 0x03, 0x60, 0x28, 0x00, 0x01, 0x73, 0x05, 0xAD, 0x2F, 0x00, 0xB6, 0xCC, 0x90, 0x00, 0x60, 
+	0x00, 0x70, 0x0A, 0x15, 0xE8, 0x98, 0x10, 0x9B, 0x33, 0x02, 0x22, 0x04, 0x00, 0xDC, 0x01, 0x60, 
+	0x01, 0x00, 0x08, 0x00, 0xCC, 0x20, 0x15, 0x01, 0x20, 0x83, 0x35, 0xD9, 0x0D, 0x58, 0xA4, 0x22, 
+	0xCF, 0xF9, 0x8E, 0x4C, 0x03, 0x10, 0x90, 0x27, 0x1F, 0x03, 0xDD, 0x0B, 0x12, 0x73, 0xA4, 0x0B, 
+	0x10, 0x66, 0x3C, 0x02, 0x00, 0x73, 0x02, 0x05, 0x0E, 0x26, 0x01, 0x1C, 0x01, 0x34, 0x01, 0x40, 
+	0x09, 0xA4, 0x04, 0x30, 0x00, 0xCE, 0x40, 0x53, 0x00, 0x32, 0x89, 0x9D, 0x24, 0xB0, 0x04, 0x10, 
+	0x05, 0x5B, 0x11, 0x0F, 0x92, 0x1A, 0x02, 0x20, 0x73, 0x24, 0xF8, 0x03, 0x13, 0x02, 0xB1, 0x23, 
+	0x42, 0x02, 0x6D, 0x59, 0xE0, 0x47, 0x0A, 0x0E, 0x01, 0x00, 0x11, 0xCF, 0x53, 0x00, 0xB8, 0x01, 
+	0x00, 0x38, 0x03, 0x80, 0x20, 0x00, 0x14, 0x9D, 0xD0, 0x0E, 0x32, 0x18, 0x01, 0x1F, 0x01, 0x03, 
+	0x10, 0x00, 0x21, 0x73, 0x04, 0x24, 0x0C, 0xA1, 0x66, 0x00, 0x40, 0x02, 0x80, 0x08, 0x01, 0x05, 
+	0x7C, 0x81, 0x41, 0x08, 0x01, 0x1B, 0x00, 0x13, 0x50, 0x39, 0x02, 0x01, 0x01, 0x00, 0x31, 0x02, 
+	0x00, 0xCC, 0x08, 0x01, 0x20, 0x89, 0x91, 0xED, 0x1E, 0x57, 0x00, 0x10, 0x4C, 0x09, 0x18, 0xCC, 
+	0x21, 0x07, 0xC9, 0x1F, 0x31, 0x20, 0x80, 0x73, 0x59, 0x0D, 0xB9, 0x02, 0x3C, 0x80, 0x00, 0x28, 
+	0x20, 0x04, 0x08, 0x00, 0x1E, 0x58, 0x98, 0x02, 0x04, 0x37, 0x10, 0x00, 0x99, 0x0B, 0x11, 0xCC, 
+	0x0E, 0x29, 0x21, 0x03, 0xC1, 0xD3, 0x2B, 0x15, 0x08, 0xB8, 0x01, 0x06, 0xB8, 0x1E, 0x04, 0x01, 
+	0x00, 0x20, 0x73, 0x05, 0xE2, 0x01, 0x20, 0x02, 0x40, 0x1F, 0x26, 0x10, 0x00, 0x76, 0x2F, 0x05, 
+	0x01, 0x00, 0x09, 0xD6, 0x0E, 0x51, 0x00, 0x00, 0x20, 0xCC, 0x10, 0xEF, 0x09, 0x11, 0x0D, 0x4E, 
+	0x02, 0x32, 0x3F, 0xC1, 0x95, 0x84, 0x0D, 0x01, 0x01, 0x00, 0x0A, 0x53, 0x01, 0x11, 0x73, 0x4A, 
+	0x00, 0x00, 0x90, 0x0F, 0x73, 0x01, 0x00, 0x28, 0x00, 0x49, 0x7A, 0x10, 0xBD, 0x0D, 0x0D, 0x01, 
+	0x00, 0x21, 0x20, 0xCE, 0x7C, 0x13, 0x10, 0x01, 0x6A, 0x30, 0x61, 0x00, 0x00, 0x12, 0x16, 0xE0, 
+	0x1B, 0xCA, 0x05, 0x03, 0xE6, 0x17, 0x02, 0x24, 0x0D, 0x02, 0x1B, 0x32, 0x30, 0x33, 0x04, 0x05, 
+	0xF0, 0x04, 0x91, 0x12, 0xD2, 0x6E, 0x6C, 0x00, 0x00, 0x01, 0x9A, 0x1C, 0xD8, 0x05, 0x80, 0x20, 
+	0x40, 0x00, 0xD0, 0x00, 0x38, 0x00, 0x08, 0x12, 0x2F, 0x40, 0xB0, 0x00, 0x00, 0x53, 0x18, 0x2B, 
+	0x30, 0x80, 0xCD, 0xC0, 0x9F, 0x01, 0x30, 0x04, 0x89, 0xAB, 0x66, 0x31, 0x32, 0x19, 0x8C, 0x0B, 
+	0x63, 0x02, 0x00, 0x53, 0x00, 0x00, 0x49, 0x04, 0x00, 0x01, 0x00, 0x30, 0x1C, 0x00, 0x7A, 0xA4, 
+	0x02, 0xF2, 0x03, 0xA1, 0x6F, 0x80, 0x0E, 0x01, 0x1C, 0x00, 0x33, 0xF7, 0x7C, 0x3C, 0x00, 0x70, 
+	0x01, 0x08, 0x1D, 0x00, 0xA0, 0x98, 0x02, 0x32, 0x70, 0x00, 0x34, 0x24, 0x01, 0xF1, 0x0B, 0xA0, 
+	0x00, 0x42, 0x57, 0x9C, 0x3C, 0x00, 0x02, 0x06, 0x2D, 0xDF, 0xD1, 0xE1, 0x00, 0x00, 0x02, 0x17, 
+	0xE4, 0x62, 0x80, 0x01, 0x00, 0x09, 0x15, 0xD0, 0x10, 0x98, 0x02, 0x11, 0x2C, 0xC6, 0x0C, 0x02, 
+	0xDA, 0x00, 0x00, 0xA3, 0x03, 0x70, 0x04, 0x03, 0x00, 0x19, 0xA1, 0x83, 0x8F, 0x48, 0x0A, 0x90, 
+	0x12, 0xF6, 0x74, 0x00, 0x00, 0x02, 0x06, 0x01, 0x00, 0x4E, 0x26, 0x31, 0x00, 0x00, 0x33, 0x38, 
+	0x01, 0x11, 0x20, 0x9F, 0x01, 0xF1, 0x09, 0xC0, 0x02, 0x40, 0x34, 0x00, 0x68, 0x01, 0x99, 0x40, 
+	0xD0, 0x88, 0x10, 0x00, 0x00, 0x01, 0xAC, 0xC7, 0xC0, 0x00, 0x01, 0x10, 0xBC, 0xE0, 0x08, 0xA0, 
+	0x2B, 0x37, 0x04, 0x28, 0x60, 0xB0, 0x1D, 0x82, 0x05, 0xC2, 0x10, 0x00, 0x00, 0x19, 0x80, 0x05, 
+	0x98, 0x02, 0x22, 0x46, 0x21, 0x82, 0x26, 0x02, 0x30, 0x05, 0x21, 0x42, 0x50, 0x1A, 0x21, 0x02, 
+	0x01, 0x00, 0xF0, 0x01, 0x03, 0x80, 0x42, 0x80, 0x40, 0x22, 0x65, 0xCC, 0x00, 0xA0, 0x40, 0x20, 
+	0x01, 0x00, 0x2F, 0xC2, 0x68, 0x09, 0x13, 0x1C, 0x49, 0x05, 0x22, 0x2C, 0xC8, 0x6D, 0x10, 0x02, 
+	0x01, 0x00, 0x01, 0x02, 0x01, 0xC0, 0x1A, 0x45, 0xA0, 0x19, 0x01, 0x40, 0x00, 0x84, 0x73, 0x5C, 
+	0x04, 0x15, 0x53, 0x00, 0x12, 0x78, 0x25, 0x07, 0x27, 0x33, 0xD0, 0x6E, 0x03, 0x10, 0x03, 0x73, 
+	0x22, 0x30, 0x01, 0xA4, 0xE0, 0xEF, 0x2F, 0xC5, 0x02, 0x13, 0x7C, 0x03, 0xC0, 0x20, 0x01, 0x00, 
+	0x24, 0x00, 0x8B, 0x00, 0x2B, 0x31, 0x04, 0x12, 0x04, 0x20, 0x40, 0x64, 0x41, 0x0B, 0x31, 0x2A, 
+	0x94, 0xA0, 0x25, 0x13, 0x20, 0xF2, 0xF4, 0xBB, 0x06, 0x30, 0x27, 0x40, 0x51, 0x99, 0x2D, 0x07, 
+	0x78, 0x00, 0x00, 0x01, 0x00, 0xF7, 0x07, 0x07, 0x00, 0x30, 0x00, 0x40, 0x02, 0xA8, 0x20, 0x00, 
+	0xF4, 0xC0, 0x01, 0x00, 0x0B, 0x22, 0x60, 0x07, 0x00, 0x00, 0x01, 0xBC, 0x81, 0x70, 0x02, 0x01, 
+	0x25, 0x00, 0x00, 0xEF, 0x02, 0xA0, 0x04, 0xC0, 0x40, 0x00, 0x80, 0x05, 0x35, 0xF0, 0x1F, 0xA0, 
+	0xF9, 0x00, 0x10, 0x16, 0x13, 0x01, 0x5D, 0x30, 0x7A, 0x18, 0x80, 0x04, 0xBB, 0x08, 0xA0, 0x02, 
+	0xC0, 0x30, 0x01, 0x40, 0x01, 0x07, 0x58, 0x10, 0x98, 0xEE, 0x02, 0x30, 0x24, 0x03, 0xC0, 0x0A, 
+	0x10, 0xB0, 0xE0, 0x8F, 0x08, 0xC0, 0x40, 0x00, 0x00, 0x25, 0xA0, 0x68, 0x00, 0x46, 0x2D, 0x02, 
+	0x01, 0x00, 0x80, 0x05, 0xC0, 0x00, 0x02, 0x01, 0x24, 0x1E, 0x85, 0x67, 0x04, 0x30, 0x33, 0x9A, 
+	0xC4, 0xC1, 0x03, 0x41, 0x04, 0xEE, 0x10, 0xA0, 0x4C, 0x01, 0x10, 0x5A, 0x07, 0x17, 0x04, 0xD0, 
+	0x00, 0x91, 0x03, 0x40, 0x30, 0x00, 0x60, 0x00, 0x27, 0x79, 0xD8, 0x1F, 0x33, 0x20, 0x68, 0x22, 
+	0xC8, 0x22, 0x20, 0x6D, 0x05, 0x45, 0x02, 0x01, 0xAB, 0x14, 0x11, 0x60, 0xEC, 0x06, 0x31, 0x85, 
+	0x0A, 0xA0, 0x81, 0x18, 0x02, 0x25, 0x11, 0x80, 0x18, 0x08, 0x00, 0x33, 0xDF, 0x00, 0x01, 0x70, 
+	0x13, 0x2C, 0x30, 0x18, 0x00, 0x8C, 0x8F, 0x25, 0x02, 0x1B, 0x01, 0x83, 0x00, 0x80, 0x10, 0xD9, 
+	0x04, 0x09, 0x00, 0x53, 0x34, 0x01, 0x10, 0x70, 0x59, 0x32, 0x20, 0x09, 0x2C, 0x86, 0x01, 0x01, 
+	0xCF, 0x06, 0x20, 0xD0, 0x00, 0x4F, 0x0E, 0x06, 0x30, 0x05, 0x50, 0x14, 0x08, 0x70, 0x07, 0xE0, 
+	0x91, 0x2B, 0xF1, 0x06, 0x08, 0x01, 0x00, 0x1C, 0x00, 0x82, 0xFA, 0xC0, 0x20, 0x00, 0x70, 0x10, 
+	0x07, 0xDF, 0xD0, 0x18, 0x01, 0x48, 0x08, 0x00, 0x8C, 0xC2, 0x03, 0x03, 0x30, 0x05, 0x41, 0x48, 
+	0x37, 0x9C, 0x79, 0x0C, 0x00, 0x80, 0x30, 0xE0, 0x00, 0x41, 0x02, 0x8B, 0x22, 0xC4, 0x43, 0x05, 
+	0x30, 0x16, 0xFB, 0x0E, 0xEB, 0x17, 0x00, 0x21, 0x00, 0x30, 0xE7, 0x00, 0x03, 0x40, 0x0D, 0xF0, 
+	0x04, 0x88, 0x00, 0x08, 0x00, 0x05, 0xE7, 0x80, 0x02, 0x00, 0x33, 0x0C, 0x09, 0x01, 0x04, 0x08, 
+	0x02, 0x00, 0x07, 0x94, 0xDB, 0x28, 0x20, 0x06, 0xE1, 0x2D, 0x09, 0x01, 0xA6, 0x00, 0x10, 0x14, 
+	0x62, 0x25, 0x20, 0x40, 0x09, 0x2E, 0x39, 0x10, 0x03, 0xC1, 0x2A, 0x70, 0x03, 0x31, 0xE0, 0xF0, 
+	0xA0, 0x11, 0x88, 0x3D, 0x15, 0x60, 0x03, 0x04, 0x04, 0x00, 0xBE, 0x87, 0x84, 0x03, 0x10, 0x83, 
+	0x17, 0x27, 0x10, 0x47, 0xA6, 0x0A, 0x20, 0x01, 0xA0, 0x1C, 0x09, 0x10, 0x06, 0x7C, 0x1B, 0x40, 
+	0x04, 0xB4, 0x98, 0x1C, 0x98, 0x07, 0xA0, 0x30, 0x00, 0x02, 0x00, 0x08, 0x01, 0x98, 0x0C, 0x00, 
+	0xB4, 0x92, 0x15, 0x60, 0x80, 0x20, 0x04, 0x00, 0x6A, 0x50, 0xF2, 0x2B, 0xE1, 0x01, 0xB0, 0x01, 
+	0x00, 0x02, 0xDC, 0x24, 0x00, 0x00, 0x42, 0x13, 0xEA, 0xF1, 0xA0, 0xBE, 0x07, 0x71, 0x03, 0x90, 
+	0x04, 0x00, 0x19, 0x8C, 0x00, 0x38, 0x37, 0x42, 0x00, 0x00, 0x55, 0xAE, 0xDD, 0x04, 0x06, 0x27, 
+	0x02, 0x30, 0x1C, 0xB6, 0xE1, 0xFE, 0x0C, 0x30, 0x08, 0x70, 0x06, 0x05, 0x0E, 0x30, 0x25, 0xCC, 
+	0x19, 0x62, 0x1B, 0x54, 0x20, 0x10, 0x00, 0x06, 0xCC, 0x45, 0x2C, 0xC0, 0x01, 0x00, 0x03, 0xBC, 
+	0x00, 0x30, 0x08, 0x01, 0xC9, 0x60, 0x00, 0x08, 0xF2, 0x0B, 0xA0, 0x81, 0x40, 0x28, 0x04, 0x00, 
+	0x02, 0x74, 0x07, 0x99, 0x0C, 0xFA, 0x23, 0x25, 0x60, 0x85, 0x31, 0x34, 0x41, 0x20, 0x00, 0x10, 
+	0x64, 0x80, 0x17, 0x01, 0xDB, 0x02, 0x40, 0x02, 0x00, 0x07, 0x8E, 0xF3, 0x00, 0x35, 0x32, 0xEC, 
+	0x10, 0x51, 0x1C, 0x02, 0x4B, 0x16, 0x00, 0x63, 0x33, 0x32, 0x02, 0x04, 0x38, 0x02, 0x2E, 0x70, 
+	0x00, 0x01, 0x08, 0x02, 0x00, 0x40, 0x06, 0x27, 0x04, 0x30, 0x25, 0x90, 0x08, 0x53, 0x00, 0x31, 
+	0x00, 0x0A, 0x5D, 0x8B, 0x09, 0x21, 0x82, 0x16, 0x59, 0x00, 0x30, 0x04, 0x07, 0xC0, 0xAD, 0x09, 
+	0x40, 0xB0, 0x1C, 0x01, 0x40, 0xF9, 0x00, 0x10, 0x01, 0x5E, 0x02, 0x21, 0x0E, 0xD0, 0x35, 0x04, 
+	0x52, 0x80, 0x7B, 0xDA, 0x80, 0x00, 0xA9, 0x2E, 0x00, 0xD0, 0x0D, 0x20, 0x40, 0x38, 0xFF, 0x11, 
+	0x30, 0x18, 0x00, 0x90, 0xF9, 0x00, 0x30, 0x83, 0xC0, 0x0B, 0xF2, 0x01, 0x27, 0x09, 0x8B, 0xCF, 
+	0x1C, 0x22, 0x20, 0x3C, 0xF7, 0x08, 0x01, 0x7A, 0x2D, 0x01, 0x8D, 0x01, 0x00, 0x9F, 0x01, 0x00, 
+	0xAA, 0x24, 0x47, 0x02, 0x12, 0x7A, 0x70, 0xD6, 0x05, 0x11, 0x40, 0xC5, 0x09, 0x10, 0x01, 0xC6, 
+	0x07, 0x10, 0x30, 0xEB, 0x06, 0x30, 0x90, 0x00, 0x01, 0x78, 0x00, 0xA5, 0x02, 0x80, 0x04, 0x00, 
+	0x08, 0x5E, 0xB1, 0x19, 0x08, 0x10, 0x64, 0x14, 0x00, 0xC8, 0x0F, 0x30, 0x80, 0xA0, 0x48, 0x41, 
+	0x2D, 0x10, 0x12, 0x53, 0x00, 0x21, 0x1E, 0x01, 0x38, 0x2D, 0x81, 0x38, 0x12, 0x38, 0x08, 0x20, 
+	0xE0, 0x80, 0x10, 0x27, 0x28, 0x03, 0x98, 0x02, 0x00, 0x4E, 0x2F, 0x42, 0x09, 0x00, 0xB3, 0xDC, 
+	0x0C, 0x00, 0x32, 0x51, 0x00, 0x1D, 0x8B, 0x00, 0x00, 0x00, 0x04, 0x34, 0x0F, 0x0B, 0x00, 0x0A, 
+	0x15, 0x04, 0xE1, 0x02, 0xF0, 0x0A, 0x14, 0x00, 0x6C, 0x03, 0x90, 0x07, 0x85, 0x2F, 0x60, 0x18, 
+	0x1F, 0x40, 0x1E, 0x02, 0x45, 0x1F, 0x94, 0x3E, 0x00, 0x60, 0x08, 0x00, 0x08, 0x79, 0xC0, 0x05, 
+	0x34, 0x04, 0x7B, 0x00, 0x00, 0x74, 0x07, 0xF0, 0x05, 0x01, 0x00, 0xF2, 0x3C, 0x78, 0x00, 0x02, 
+	0x11, 0xF9, 0x48, 0x70, 0xE2, 0x00, 0x00, 0x08, 0xF7, 0x20, 0x22, 0x90, 0x01, 0xCD, 0x02, 0x00, 
+	0x30, 0x05, 0x05, 0x53, 0x00, 0xB2, 0x82, 0x16, 0x00, 0x00, 0xA0, 0x4C, 0x00, 0x05, 0xE0, 0x00, 
+	0x22, 0x15, 0x00, 0xCB, 0x08, 0x00, 0x08, 0x50, 0x36, 0x38, 0x70, 0x20, 0x00, 0xFD, 0x40, 0x70, 
+	0xA6, 0x00, 0xE0, 0x00, 0x04, 0x09, 0xC0, 0x03, 0xAE, 0x02, 0x70, 0x60, 0x20, 0x40, 0x0C, 0x00, 
+	0xC0, 0xCC, 0x01, 0xB6, 0x81, 0x64, 0x00, 0x47, 0x45, 0x0F, 0xC4, 0x00, 0x0A, 0x01, 0x1C, 0x53, 
+	0x00, 0x22, 0x90, 0x20, 0x37, 0x0A, 0x03, 0x4C, 0x38, 0x00, 0x0C, 0x00, 0x30, 0xFF, 0x07, 0xDC, 
+	0x0B, 0x00, 0x20, 0x21, 0x60, 0x4F, 0x10, 0x06, 0x53, 0x00, 0x20, 0x01, 0xC0, 0xF2, 0x27, 0x00, 
+	0xC0, 0x02, 0x01, 0x32, 0x0F, 0x10, 0xB0, 0x45, 0x02, 0x13, 0x70, 0x86, 0x01, 0x04, 0x93, 0x13, 
+	0x02, 0xA6, 0x00, 0x11, 0x0C, 0x1C, 0x0A, 0x30, 0x04, 0x03, 0x88, 0x7A, 0x02, 0x71, 0x80, 0x01, 
+	0x00, 0x80, 0x02, 0x0A, 0x3A, 0x21, 0x01, 0x31, 0x14, 0xDF, 0x01, 0x39, 0x2A, 0x07, 0xA6, 0x00, 
+	0x71, 0x80, 0x01, 0x00, 0x02, 0x5C, 0x00, 0x07, 0xA4, 0x02, 0xE0, 0xC1, 0x05, 0x01, 0x00, 0xA0, 
+	0x80, 0x02, 0x40, 0x04, 0x00, 0x36, 0xF4, 0xF7, 0x00, 0x26, 0x0F, 0x06, 0x4C, 0x01, 0x20, 0x10, 
+	0x18, 0x96, 0x35, 0x00, 0x2F, 0x01, 0x20, 0x33, 0x2E, 0xFD, 0x17, 0x80, 0x02, 0x85, 0x3E, 0xFC, 
+	0x20, 0x10, 0x00, 0x09, 0x64, 0x31, 0x06, 0x28, 0x00, 0x41, 0x40, 0x00, 0x40, 0x0F, 0x16, 0x28, 
+	0x10, 0x3C, 0xFE, 0x01, 0x91, 0x33, 0x40, 0x70, 0x90, 0x01, 0x00, 0x06, 0xE1, 0xE6, 0xC2, 0x39, 
+	0x10, 0x24, 0xB6, 0x1B, 0x08, 0x53, 0x00, 0x03, 0x07, 0x1F, 0x50, 0x20, 0x00, 0x00, 0x29, 0xF5, 
+	0x4D, 0x10, 0xB7, 0x06, 0x45, 0x7E, 0x00, 0x06, 0x05, 0x00, 0x28, 0x00, 0x18, 0x30, 0x2F, 0x2B, 
+	0x21, 0x40, 0x40, 0xE4, 0x03, 0x91, 0x00, 0x03, 0x44, 0x30, 0x00, 0x40, 0x00, 0x98, 0x5D, 0x6F, 
+	0x09, 0x51, 0xF3, 0xA8, 0x03, 0x90, 0x24, 0x1C, 0x01, 0x19, 0x20, 0x53, 0x00, 0x11, 0x18, 0x8F, 
+	0x09, 0x63, 0x67, 0x80, 0x22, 0x00, 0x82, 0x06, 0x21, 0x2C, 0x20, 0x24, 0x78, 0x45, 0x01, 0x32, 
+	0x0C, 0x10, 0x10, 0x01, 0x1C, 0x03, 0x53, 0x00, 0x20, 0x0C, 0x10, 0xE4, 0x03, 0x20, 0xC2, 0x40, 
+	0x8B, 0x10, 0x22, 0x20, 0x70, 0xC6, 0x09, 0x94, 0x44, 0x00, 0x04, 0x01, 0x08, 0x01, 0x00, 0x8E, 
+	0x1D, 0xDF, 0x0A, 0x08, 0x59, 0x0B, 0x03, 0xFB, 0x19, 0x50, 0x18, 0x04, 0x12, 0x00, 0x00, 0xEC, 
+	0x1A, 0x00, 0x01, 0x00, 0x25, 0x81, 0x50, 0xDA, 0x1A, 0x04, 0x01, 0x00, 0x22, 0x52, 0xE4, 0x97, 
+	0x0A, 0x76, 0x70, 0x00, 0x04, 0x10, 0x01, 0x00, 0x38, 0x64, 0x2E, 0x08, 0xA6, 0x00, 0x10, 0xA0, 
+	0x24, 0x05, 0x30, 0x66, 0x02, 0x50, 0x30, 0x05, 0x91, 0x00, 0x00, 0x80, 0x1A, 0x00, 0x42, 0x06, 
+	0x20, 0x04, 0x3D, 0x12, 0x30, 0x01, 0xE4, 0x01, 0xB3, 0x14, 0x01, 0x01, 0x00, 0x10, 0x08, 0xF8, 
+	0x1B, 0x64, 0xD0, 0x00, 0x40, 0x76, 0xAC, 0x78, 0xA1, 0x1A, 0x53, 0x40, 0xC4, 0x2D, 0x40, 0x43, 
+	0x01, 0x2A, 0x18, 0xA0, 0x60, 0x0A, 0x20, 0x20, 0x07, 0x30, 0x05, 0x10, 0x07, 0x30, 0x05, 0x50, 
+	0x00, 0x00, 0x07, 0x18, 0x14, 0xF2, 0x2F, 0x00, 0x95, 0x0C, 0x38, 0x40, 0x01, 0x7D, 0x7B, 0x00, 
+	0xA1, 0x00, 0x60, 0x01, 0xC0, 0x08, 0x01, 0x40, 0xC0, 0x02, 0x3E, 0x68, 0x11, 0x52, 0x00, 0x09, 
+	0x00, 0x04, 0xD1, 0xBD, 0x1A, 0x31, 0x80, 0x14, 0x03, 0xE9, 0x07, 0x0D, 0x19, 0x0F, 0x00, 0x37, 
+	0x04, 0x21, 0x82, 0x1C, 0xC5, 0x00, 0x32, 0x96, 0x7E, 0x84, 0xEF, 0x00, 0x04, 0x75, 0x3E, 0x08, 
+	0xFA, 0x00, 0x32, 0x02, 0xC0, 0x3C, 0x0D, 0x01, 0x53, 0x01, 0xC0, 0x00, 0x09, 0x69, 0xF8, 0x00, 
+	0x07, 0x66, 0x09, 0x06, 0x30, 0x00, 0x02, 0x09, 0x30, 0xE0, 0x00, 0x00, 0x1A, 0x14, 0x02, 0x02, 
+	0x40, 0x80, 0x20, 0x02, 0xD0, 0x0C, 0x11, 0x7C, 0x5C, 0x12, 0x0A, 0x70, 0x01, 0x20, 0x01, 0xC8, 
+	0x8C, 0x00, 0x12, 0xB5, 0x9D, 0x03, 0xC8, 0x10, 0x10, 0x00, 0x01, 0x02, 0xC3, 0xF8, 0x00, 0x02, 
+	0x29, 0x40, 0xF0, 0x9D, 0x07, 0x10, 0x81, 0xE6, 0x01, 0x5A, 0x00, 0x00, 0x10, 0x25, 0xC0, 0x3C, 
+	0x00, 0x01, 0x06, 0x00, 0x1D, 0x1A, 0x7D, 0x00, 0x59, 0x00, 0x00, 0x02, 0x1E, 0x3C, 0xE3, 0x0E, 
+	0x1F, 0x2F, 0x24, 0x00, 0x00, 0x02, 0x01, 0x00, 0x10, 0x04, 0xBE, 0x1A, 0x11, 0x90, 0x51, 0x0F, 
+	0x20, 0x02, 0x08, 0x46, 0x2A, 0x03, 0x01, 0x00, 0x0D, 0xC8, 0x07, 0x42, 0x03, 0x40, 0x38, 0x72, 
+	0x51, 0x13, 0x02, 0x69, 0x07, 0x0F, 0x5B, 0x10, 0x03, 0x01, 0x83, 0x05, 0x00, 0x97, 0x0D, 0x01, 
+	0x55, 0x03, 0xB0, 0x08, 0x00, 0x8F, 0xB3, 0x7E, 0x04, 0x05, 0x00, 0x08, 0x00, 0x1A, 0xF1, 0x3F, 
+	0x0E, 0x53, 0x00, 0x33, 0x02, 0x02, 0x30, 0x07, 0x0C, 0x60, 0x08, 0xAF, 0xB9, 0x42, 0x80, 0x20, 
+	0x19, 0x04, 0x0F, 0x87, 0x0A, 0x00, 0x17, 0x08, 0xB4, 0x2B, 0x00, 0x01, 0x00, 0x03, 0xA5, 0x11, 
+	0x00, 0xD2, 0x0F, 0x0B, 0x15, 0x0E, 0x10, 0x53, 0x53, 0x04, 0x0E, 0x01, 0x00, 0x0E, 0x54, 0x00, 
+	0x25, 0x08, 0x62, 0xD4, 0x07, 0x01, 0xF6, 0x01, 0x01, 0x64, 0x04, 0x00, 0xF6, 0x0E, 0x04, 0x98, 
+	0x02, 0x05, 0xF2, 0x01, 0x25, 0x37, 0xBC, 0x01, 0x11, 0x04, 0x81, 0x1E, 0x06, 0x04, 0x31, 0x09, 
+	0x01, 0x00, 0x30, 0x01, 0xC0, 0x3C, 0xD6, 0x05, 0x0C, 0x15, 0x00, 0x0E, 0x2D, 0x00, 0x34, 0x03, 
+	0x42, 0x03, 0x87, 0x0F, 0x07, 0x01, 0x00, 0x00, 0xDE, 0x1C, 0x03, 0x56, 0x01, 0x05, 0xD6, 0x00, 
+	0x21, 0x04, 0x03, 0x49, 0x01, 0x13, 0x07, 0xE5, 0x01, 0x0F, 0x43, 0x13, 0x03, 0x01, 0x53, 0x00, 
+	0x12, 0x80, 0xC1, 0x1E, 0x04, 0x28, 0x10, 0x09, 0x23, 0x1D, 0x09, 0x01, 0x00, 0x01, 0x27, 0x2E, 
+	0x36, 0x00, 0x1F, 0xF0, 0xAE, 0x03, 0x00, 0xD1, 0x32, 0x00, 0x2F, 0x02, 0x0B, 0x33, 0x00, 0x20, 
+	0x03, 0xEC, 0x17, 0x02, 0x26, 0x40, 0xDB, 0xA7, 0x23, 0x4F, 0x04, 0x04, 0x00, 0xAB, 0xA0, 0x01, 
+	0x01, 0x2A, 0x70, 0x47, 0x15, 0x00, 0x02, 0xBA, 0x0C, 0x02, 0xBA, 0x09, 0x00, 0x01, 0x00, 0x04, 
+	0x59, 0x00, 0x28, 0x02, 0x02, 0x44, 0x13, 0x00, 0x11, 0x00, 0x09, 0xD5, 0x11, 0x08, 0x01, 0x00, 
+	0x10, 0x01, 0x66, 0x0B, 0x00, 0xEF, 0x05, 0x0A, 0x9A, 0x12, 0x02, 0xC0, 0x35, 0x09, 0x12, 0x00, 
+	0x10, 0x42, 0x32, 0x19, 0x2C, 0x40, 0x0A, 0xB2, 0x02, 0x0C, 0x00, 0x01, 0x31, 0x40, 0x00, 0x05, 
+	0xB2, 0x37, 0x43, 0x00, 0x08, 0x01, 0x20, 0x61, 0x35, 0x03, 0x01, 0x00, 0x0F, 0x98, 0x02, 0x00, 
+	0x11, 0x2C, 0x3F, 0x00, 0x40, 0xB0, 0xD4, 0x00, 0x21, 0xAF, 0x36, 0x06, 0x89, 0x0D, 0x05, 0xBE, 
+	0x00, 0x00, 0x96, 0x01, 0x57, 0x80, 0x00, 0x08, 0x06, 0x02, 0x5E, 0x2A, 0x42, 0x00, 0x00, 0x62, 
+	0x82, 0x1C, 0x03, 0x00, 0x10, 0x1C, 0x05, 0x4D, 0x00, 0x00, 0x1D, 0x15, 0x48, 0x00, 0x93, 0x3C, 
+	0x38, 0x68, 0x00, 0x22, 0x02, 0xD0, 0x0D, 0x32, 0x06, 0x20, 0x0C, 0x80, 0x00, 0x02, 0x0C, 0x2E, 
+	0x00, 0x00, 0x04, 0x1C, 0x50, 0x1E, 0x50, 0xA7, 0x00, 0x08, 0x0F, 0xC8, 0x3C, 0x05, 0x01, 0x9A, 
+	0x10, 0x76, 0x68, 0x01, 0x68, 0x00, 0x98, 0x10, 0x15, 0x2A, 0x00, 0x20, 0x10, 0xC1, 0x14, 0x01, 
+	0x30, 0x41, 0xF3, 0x8C, 0xCA, 0x3C, 0xF0, 0x03, 0x81, 0xD0, 0x50, 0xF0, 0x00, 0x60, 0x0A, 0x00, 
+	0xAB, 0x42, 0xC6, 0x01, 0x00, 0x29, 0x40, 0xB7, 0x8C, 0x0C, 0x40, 0x0A, 0x09, 0xA6, 0x00, 0x00, 
+	0x1D, 0x02, 0xF9, 0x05, 0x02, 0x00, 0x3F, 0x1F, 0xE0, 0x0E, 0x00, 0x0C, 0x04, 0x08, 0x7B, 0x00, 
+	0x01, 0x50, 0x08, 0x00, 0x60, 0x01, 0xF0, 0xE1, 0x7F, 0x2E, 0x01, 0xA6, 0x00, 0x81, 0x03, 0x80, 
+	0x40, 0x30, 0x20, 0x01, 0xF1, 0x5E, 0x10, 0x00, 0xB5, 0x8B, 0x00, 0x02, 0xE2, 0x00, 0x80, 0x09, 
+	0x24, 0x9D, 0x10, 0xB9, 0x30, 0x11, 0x00, 0x88, 0x1C, 0x01, 0xCE, 0x02, 0x19, 0x04, 0x9D, 0x29, 
+	0x62, 0x14, 0x7A, 0x80, 0x00, 0x11, 0x68, 0xFE, 0x2D, 0x02, 0x01, 0x00, 0x00, 0xEF, 0x03, 0x01, 
+	0xF7, 0x08, 0x38, 0x03, 0x00, 0x40, 0xD0, 0x3A, 0x20, 0x04, 0x10, 0xDD, 0x04, 0x11, 0x99, 0x42, 
+	0x39, 0x06, 0x01, 0x00, 0x05, 0xBB, 0x01, 0x41, 0x01, 0x20, 0x3F, 0xC0, 0x45, 0x00, 0x10, 0x02, 
+	0x93, 0x3F, 0x31, 0x08, 0x15, 0x7A, 0xE9, 0x13, 0x07, 0x26, 0x01, 0x11, 0x10, 0x53, 0x00, 0x60, 
+	0x3C, 0x70, 0x00, 0x01, 0x42, 0x7A, 0xA5, 0x07, 0x92, 0x05, 0xA0, 0x3B, 0x40, 0x28, 0x00, 0x20, 
+	0x01, 0x41, 0x9D, 0x03, 0x07, 0x2D, 0x02, 0x61, 0x01, 0xE0, 0x00, 0x10, 0x2D, 0xC3, 0x43, 0x18, 
+	0x00, 0x95, 0x08, 0xA7, 0x06, 0x5A, 0x07, 0x96, 0x00, 0x80, 0x02, 0x0B, 0x9E, 0x1F, 0x98, 0x02, 
+	0x02, 0x01, 0x00, 0x10, 0xE4, 0x91, 0x03, 0x02, 0x40, 0x06, 0x50, 0xD8, 0xB0, 0x00, 0x19, 0x85, 
+	0xDA, 0x09, 0x5B, 0x10, 0x00, 0x30, 0xCD, 0xB0, 0x1B, 0x02, 0x20, 0x01, 0x80, 0xFE, 0x04, 0x00, 
+	0x29, 0x06, 0x30, 0x90, 0x00, 0x07, 0x7A, 0x10, 0x44, 0x5A, 0x57, 0x40, 0x20, 0x07, 0x05, 0x0B, 
+	0x7E, 0x02, 0xB0, 0x08, 0x00, 0x02, 0x04, 0x78, 0x04, 0x00, 0x10, 0x01, 0xC0, 0x08, 0x70, 0x06, 
+	0x00, 0x4D, 0x37, 0x02, 0x89, 0x25, 0x06, 0xCA, 0x00, 0x06, 0x0B, 0x00, 0xF1, 0x01, 0x02, 0x85, 
+	0x03, 0x01, 0x2B, 0xCF, 0xC8, 0x00, 0x00, 0x88, 0x04, 0xC2, 0xDA, 0x40, 0x64, 0x35, 0x1C, 0x1C, 
+	0x0F, 0x98, 0x02, 0x00, 0x00, 0xF5, 0x1E, 0xB0, 0x34, 0x02, 0xBC, 0x20, 0xB0, 0x80, 0x14, 0x80, 
+	0x0C, 0x07, 0xB4, 0xC1, 0x20, 0x04, 0x7C, 0x00, 0x2F, 0x11, 0x03, 0x1B, 0x04, 0x07, 0x0F, 0x01, 
+	0x00, 0x3C, 0x09, 0xB3, 0x03, 0x0F, 0x3A, 0x2C, 0x16, 0x0F, 0x01, 0x00, 0x1D, 0x0F, 0x04, 0x18, 
+	0x08, 0x0A, 0x01, 0x00, 0x04, 0xEE, 0x02, 0x09, 0x06, 0x16, 0x02, 0x9D, 0x00, 0x04, 0x4A, 0x31, 
+	0x0F, 0x4B, 0x00, 0x15, 0x0C, 0x01, 0x00, 0x03, 0x39, 0x00, 0x17, 0x30, 0x4B, 0x07, 0x09, 0xE2, 
+	0x08, 0x0D, 0x03, 0x07, 0x05, 0x91, 0x19, 0x0F, 0x2F, 0x00, 0x02, 0x06, 0x01, 0x00, 0x01, 0xFC, 
+	0x05, 0x14, 0x08, 0xC5, 0x16, 0x07, 0x01, 0x00, 0x00, 0x6A, 0x00, 0x08, 0xAF, 0x00, 0x01, 0x8C, 
+	0x37, 0x00, 0x51, 0x04, 0x0D, 0xDD, 0x01, 0x0F, 0x11, 0x2C, 0x13, 0x01, 0xEB, 0x05, 0x0F, 0xFD, 
+	0x06, 0x00, 0x00, 0x05, 0x00, 0x0F, 0x5E, 0x17, 0x08, 0x0F, 0x01, 0x00, 0x07, 0x02, 0xF2, 0x0B, 
+	0x2D, 0x00, 0x20, 0x55, 0x01, 0x01, 0x24, 0x01, 0x01, 0xF6, 0x08, 0x01, 0x4A, 0x00, 0x04, 0xBD, 
+	0x21, 0x0F, 0x20, 0x02, 0x0E, 0x2F, 0x47, 0x3B, 0xEA, 0x01, 0x13, 0x37, 0x20, 0x22, 0xE5, 0xA5, 
+	0x29, 0x0F, 0x01, 0x00, 0x09, 0x21, 0x10, 0xCA, 0x1F, 0x1B, 0x0F, 0x01, 0x00, 0x10, 0x23, 0x6C, 
+	0xAB, 0x85, 0x07, 0x09, 0xC5, 0x05, 0x0F, 0x01, 0x00, 0x04, 0x6F, 0x24, 0x00, 0x00, 0x41, 0x7C, 
+	0x49, 0x65, 0x03, 0x11, 0x68, 0x40, 0x00, 0x20, 0xA2, 0xD4, 0x80, 0x01, 0x2A, 0x0F, 0x01, 0x00, 
+	0x03, 0x02, 0x17, 0x1C, 0x0F, 0x01, 0x00, 0x11, 0x1F, 0x66, 0x0E, 0x03, 0x16, 0x00, 0x85, 0x01, 
+	0x12, 0x1C, 0x66, 0x0A, 0x0F, 0x01, 0x00, 0x09, 0x20, 0x83, 0x81, 0x2E, 0x08, 0x12, 0x8B, 0x7F, 
+	0x28, 0x0F, 0x01, 0x00, 0x0E, 0x00, 0x26, 0x01, 0x06, 0xAF, 0x15, 0x0F, 0x01, 0x00, 0x06, 0x00, 
+	0x78, 0x11, 0x00, 0xA7, 0x2A, 0x0F, 0x56, 0x31, 0x01, 0x0C, 0x01, 0x00, 0x50, 0x10, 0x00, 0x3C, 
+	0xC8, 0x00, 0x93, 0x1F, 0x0F, 0x01, 0x00, 0x0D, 0x55, 0x07, 0x00, 0x02, 0xE6, 0x80, 0xA4, 0x09, 
+	0x0F, 0x01, 0x00, 0x0E, 0x0F, 0x04, 0x18, 0x06, 0x0B, 0x01, 0x00, 0x00, 0xB1, 0x13, 0x0F, 0x19, 
+	0x00, 0x03, 0x31, 0x2F, 0x7D, 0xAF, 0x16, 0x01, 0x10, 0xF0, 0xE0, 0x15, 0x11, 0x18, 0x02, 0x16, 
+	0x0F, 0x3E, 0x1C, 0x03, 0x30, 0x0A, 0x96, 0x08, 0x41, 0x0D, 0x12, 0x24, 0xC7, 0x26, 0x02, 0xF0, 
+	0x0A, 0x02, 0x60, 0x39, 0x0C, 0x01, 0x00, 0x32, 0x2F, 0x14, 0xCF, 0x75, 0x34, 0x21, 0x0E, 0x2D, 
+	0x07, 0x00, 0x0F, 0xAD, 0x32, 0x06, 0x31, 0x03, 0xFA, 0x6E, 0x3C, 0x08, 0x31, 0x83, 0x01, 0xE0, 
+	0xA7, 0x10, 0x3F, 0x08, 0x00, 0x1C, 0x4D, 0x01, 0x03, 0x40, 0x01, 0x26, 0xFE, 0xA7, 0x08, 0x00, 
+	0x20, 0x20, 0x04, 0x1F, 0x00, 0x20, 0x03, 0xD8, 0x5D, 0x17, 0x06, 0xD0, 0x23, 0x08, 0x01, 0x00, 
+	0x30, 0x0A, 0x9E, 0xC9, 0x72, 0x11, 0x03, 0x3D, 0x13, 0x21, 0x3E, 0x86, 0x45, 0x03, 0x03, 0x96, 
+	0x03, 0x0A, 0x88, 0x00, 0x30, 0x3F, 0x6E, 0xFF, 0x7A, 0x17, 0x20, 0x20, 0x04, 0xF0, 0x01, 0x28, 
+	0x02, 0x80, 0x71, 0x0E, 0x0A, 0xC6, 0x03, 0x31, 0x03, 0xE0, 0x6F, 0x7C, 0x00, 0x20, 0x00, 0x78, 
+	0x02, 0x3C, 0x21, 0x28, 0x1C, 0x62, 0x10, 0x0B, 0xDE, 0x06, 0x01, 0x01, 0x00, 0x40, 0x05, 0x16, 
+	0x3E, 0xB5, 0x68, 0x01, 0x02, 0x53, 0x00, 0x30, 0x10, 0x90, 0x4F, 0x15, 0x00, 0x1F, 0x07, 0xC4, 
+	0x31, 0x01, 0x30, 0x09, 0x92, 0xC9, 0x87, 0x0F, 0x30, 0x20, 0x00, 0x70, 0x13, 0x02, 0x11, 0x06, 
+	0x5F, 0x04, 0x0F, 0x46, 0x02, 0x03, 0x62, 0x02, 0x6F, 0xC5, 0x8A, 0x00, 0x4C, 0xCE, 0x00, 0x12, 
+	0x30, 0x07, 0x25, 0x1F, 0x84, 0xC6, 0x02, 0x03, 0x70, 0x3F, 0xEE, 0xF0, 0x10, 0x08, 0x80, 0x20, 
+	0x51, 0x09, 0x60, 0x03, 0x00, 0x90, 0x00, 0x05, 0x1C, 0x54, 0x3B, 0x0F, 0x01, 0x00, 0x00, 0x41, 
+	0x84, 0x16, 0xB5, 0xF0, 0xF6, 0x1E, 0x00, 0xC3, 0x00, 0x00, 0xFF, 0x0F, 0x2F, 0x00, 0xE0, 0x98, 
+	0x02, 0x04, 0x73, 0x09, 0x08, 0x09, 0x39, 0x80, 0x01, 0xC0, 0x10, 0x14, 0x6F, 0x82, 0x14, 0x00, 
+	0x1B, 0x00, 0x1C, 0xE2, 0x04, 0x01, 0x51, 0x80, 0x00, 0x09, 0x2C, 0xC1, 0x00, 0x1A, 0x10, 0x03, 
+	0xBB, 0x08, 0x4F, 0x18, 0x01, 0x40, 0x71, 0x83, 0x1E, 0x06, 0x11, 0x62, 0xCE, 0x36, 0x03, 0xC9, 
+	0x29, 0x20, 0x90, 0x20, 0xB5, 0x28, 0x0F, 0x7E, 0x00, 0x03, 0x80, 0x2F, 0x54, 0xA0, 0x18, 0x00, 
+	0x0C, 0x00, 0x0A, 0x77, 0x3F, 0x00, 0x91, 0x03, 0x00, 0x51, 0x3A, 0x0B, 0x70, 0x06, 0x02, 0x0E, 
+	0x00, 0x40, 0x03, 0xE9, 0x49, 0x01, 0x55, 0x20, 0x31, 0x53, 0x84, 0x66, 0xA2, 0x06, 0x00, 0xFE, 
+	0x08, 0x05, 0x28, 0x00, 0x39, 0x02, 0x1F, 0x84, 0x87, 0x34, 0x02, 0xE5, 0x01, 0x03, 0xC4, 0x00, 
+	0x09, 0x61, 0x05, 0x2A, 0x02, 0xF4, 0xEC, 0x04, 0x02, 0x43, 0x00, 0x02, 0xFB, 0x16, 0x00, 0x28, 
+	0x02, 0x17, 0x0C, 0x17, 0x1E, 0x05, 0x00, 0x0F, 0x41, 0x04, 0x3D, 0x65, 0xE9, 0xC0, 0x00, 0x10, 
+	0x0E, 0xBF, 0x15, 0x30, 0x00, 0x28, 0x30, 0x1A, 0x2B, 0x1F, 0x40, 0xD0, 0x00, 0x01, 0x30, 0x0B, 
+	0xEE, 0x7D, 0x52, 0x00, 0x21, 0x05, 0x01, 0x0F, 0x02, 0x32, 0x02, 0x97, 0xE5, 0x05, 0x14, 0x03, 
+	0x7C, 0x00, 0x26, 0x80, 0x86, 0xA6, 0x00, 0xF0, 0x01, 0x3F, 0x9C, 0x80, 0x0E, 0x40, 0x01, 0x00, 
+	0x3F, 0xD7, 0x64, 0x24, 0x05, 0x00, 0x10, 0x80, 0x10, 0xCD, 0x2A, 0x05, 0x01, 0x00, 0x35, 0x08, 
+	0x01, 0x7B, 0x0C, 0x00, 0xC0, 0x03, 0xE1, 0x78, 0x00, 0x12, 0x80, 0x00, 0x2B, 0xF1, 0xAA, 0x00, 
+	0x40, 0xA9, 0x0A, 0x1B, 0xC9, 0x04, 0x0C, 0x15, 0x0B, 0xE1, 0x1C, 0x33, 0x3F, 0x36, 0x9D, 0xC0, 
+	0x06, 0x61, 0x38, 0x80, 0x00, 0x02, 0xE3, 0xFD, 0x0D, 0x00, 0x07, 0x91, 0x0D, 0x02, 0x61, 0x38, 
+	0x67, 0x00, 0x00, 0x00, 0x4B, 0xF7, 0x6D, 0xC8, 0x05, 0x37, 0x1E, 0x8E, 0xD5, 0x98, 0x02, 0x03, 
+	0x5D, 0x00, 0x06, 0xA7, 0x02, 0x70, 0x8D, 0x14, 0x0C, 0x00, 0x00, 0x30, 0x24, 0xC2, 0x22, 0x10, 
+	0x40, 0xC7, 0x01, 0x13, 0xC4, 0x31, 0x05, 0x01, 0x3F, 0x0C, 0x08, 0xD0, 0x09, 0x20, 0x78, 0xB0, 
+	0x70, 0x0D, 0x12, 0x03, 0xA8, 0x16, 0x4F, 0x11, 0x08, 0x00, 0x0C, 0x87, 0x05, 0x06, 0x7F, 0x8B, 
+	0x00, 0x04, 0x00, 0x05, 0x0C, 0x2C, 0xA7, 0x1F, 0x05, 0x06, 0x93, 0x12, 0x91, 0x38, 0xA0, 0x01, 
+	0xE0, 0x00, 0x57, 0xBA, 0x06, 0x80, 0x98, 0x02, 0x00, 0x30, 0x05, 0x08, 0x98, 0x02, 0x17, 0x0F, 
+	0xCB, 0x01, 0x02, 0xB0, 0x00, 0x10, 0x3C, 0x3B, 0x02, 0x00, 0xDD, 0x04, 0x05, 0xFC, 0x3E, 0x08, 
+	0x01, 0x00, 0x02, 0xCD, 0x03, 0x03, 0x74, 0x00, 0x00, 0xC5, 0x1C, 0x09, 0x1E, 0x00, 0x53, 0x14, 
+	0x00, 0x89, 0x6E, 0x9F, 0x30, 0x01, 0x11, 0x04, 0x3D, 0x0E, 0x64, 0x00, 0x10, 0x00, 0xB8, 0x97, 
+	0x14, 0x35, 0x2F, 0x16, 0x01, 0x53, 0x00, 0x20, 0x08, 0x93, 0xF4, 0x03, 0x02, 0xDF, 0x00, 0x30, 
+	0x08, 0x00, 0x18, 0x30, 0x05, 0x32, 0x07, 0xA7, 0x62, 0x5A, 0x00, 0x53, 0x01, 0x1A, 0x00, 0x00, 
+	0x80, 0x45, 0x02, 0x01, 0x32, 0x00, 0x03, 0x37, 0x13, 0x00, 0xE4, 0x14, 0x82, 0xB1, 0x00, 0x01, 
+	0x50, 0x00, 0x20, 0x04, 0x14, 0xA1, 0x17, 0x02, 0x02, 0x3C, 0x06, 0x01, 0x00, 0x14, 0x01, 0xE6, 
+	0x05, 0x50, 0x08, 0x00, 0x01, 0x80, 0x80, 0xDD, 0x04, 0x12, 0x32, 0xEE, 0x00, 0x00, 0xBD, 0x1F, 
+	0x04, 0x99, 0x08, 0x08, 0xCC, 0x38, 0x00, 0x53, 0x00, 0x11, 0x97, 0x0C, 0x00, 0x00, 0x74, 0x07, 
+	0x02, 0x10, 0x14, 0x11, 0x1D, 0xFB, 0x25, 0x04, 0x01, 0x00, 0x05, 0xE6, 0x01, 0x00, 0x30, 0x2D, 
+	0x55, 0x0E, 0x00, 0x00, 0x05, 0x03, 0x09, 0x22, 0x24, 0x01, 0xC0, 0x4C, 0x01, 0x03, 0x6E, 0x21, 
+	0x03, 0xF9, 0x00, 0xA0, 0x2E, 0x3D, 0xD7, 0x00, 0x01, 0x11, 0x04, 0x42, 0xD3, 0x54, 0xE1, 0x2C, 
+	0x3C, 0x01, 0xC0, 0xF0, 0xDB, 0x20, 0x04, 0x63, 0x06, 0x30, 0x01, 0xEB, 0x4E, 0x07, 0x00, 0x41, 
+	0x88, 0x10, 0x02, 0x46, 0xAA, 0x29, 0x01, 0xA6, 0x06, 0x03, 0xF3, 0x01, 0x0A, 0xA6, 0x00, 0x40, 
+	0x2E, 0x2F, 0xF0, 0x0C, 0x0C, 0x00, 0x11, 0xD0, 0x28, 0x2B, 0x20, 0x01, 0x6A, 0x42, 0x13, 0x07, 
+	0xD8, 0x1D, 0x06, 0x95, 0x10, 0x30, 0x01, 0xEA, 0xFE, 0xDC, 0x3F, 0x12, 0x24, 0x2F, 0x20, 0x32, 
+	0x01, 0x1E, 0x90, 0x87, 0x01, 0x03, 0x53, 0x00, 0x33, 0x2C, 0x5F, 0xB0, 0xD2, 0x00, 0x60, 0x04, 
+	0x00, 0x20, 0x5C, 0x00, 0x88, 0x3E, 0x07, 0x20, 0x10, 0x1C, 0xDA, 0x31, 0x00, 0xDD, 0x04, 0x15, 
+	0x09, 0x16, 0x2C, 0x54, 0x00, 0x03, 0xC8, 0x7E, 0x50, 0x7C, 0x35, 0xD1, 0x02, 0x04, 0x1A, 0x58, 
+	0x10, 0x00, 0x80, 0x24, 0x00, 0x01, 0x67, 0x00, 0x02, 0x0B, 0x13, 0x26, 0x01, 0x0C, 0xB3, 0x02, 
+	0x26, 0x29, 0x40, 0x91, 0x03, 0xA1, 0x04, 0x00, 0x90, 0x0F, 0x80, 0x04, 0x00, 0x10, 0x02, 0x0C, 
+	0xCE, 0x24, 0x45, 0x00, 0x00, 0x08, 0x14, 0xD6, 0x1C, 0x54, 0x00, 0x01, 0x68, 0x01, 0x78, 0x98, 
+	0x02, 0x71, 0x08, 0x00, 0x01, 0x38, 0x10, 0x01, 0xC0, 0xDD, 0x04, 0x30, 0x07, 0x00, 0x80, 0x16, 
+	0x00, 0x23, 0x1C, 0x00, 0x7B, 0x0F, 0x00, 0xF9, 0x00, 0x01, 0xDD, 0x2D, 0x41, 0x00, 0x00, 0x28, 
+	0x84, 0xBE, 0x00, 0xE0, 0x08, 0x10, 0x00, 0xB8, 0xBE, 0xF4, 0x36, 0x80, 0x40, 0x10, 0x00, 0x1F, 
+	0x08, 0xD2, 0x05, 0x1A, 0x02, 0x01, 0x00, 0x00, 0x00, 0x01, 0x04, 0xC3, 0x04, 0xF5, 0x05, 0x20, 
+	0x08, 0x00, 0x08, 0x39, 0xE0, 0x00, 0x80, 0x07, 0xAF, 0xBD, 0x47, 0xD0, 0x02, 0x00, 0x29, 0x40, 
+	0x81, 0x81, 0x40, 0xA9, 0x01, 0x08, 0x4C, 0x01, 0x01, 0x05, 0x00, 0x80, 0x80, 0x00, 0x18, 0x00, 
+	0xFC, 0xBE, 0x44, 0x40, 0x20, 0x34, 0x3D, 0x40, 0x00, 0xE0, 0xC6, 0x39, 0x05, 0x10, 0x00, 0xA2, 
+	0x50, 0x00, 0x80, 0xC0, 0x05, 0x81, 0x72, 0x06, 0x00, 0x02, 0x39, 0x00, 0x05, 0x29, 0x06, 0x5C, 
+	0x04, 0x00, 0x81, 0x2F, 0xFD, 0x11, 0x3B, 0x99, 0x74, 0xDE, 0x80, 0x00, 0x05, 0x44, 0x10, 0x6A, 
+	0x60, 0xCD, 0x22, 0x4B, 0x08, 0x31, 0xC8, 0x99, 0x61, 0x00, 0x40, 0x07, 0xA1, 0x31, 0xC2, 0x32, 
+	0x3E, 0x27, 0xB7, 0xE1, 0x19, 0x00, 0x55, 0x04, 0x00, 0x29, 0x40, 0xA1, 0x53, 0x00, 0xF8, 0x02, 
+	0x3F, 0xC1, 0x99, 0x0E, 0x00, 0x10, 0x00, 0x5E, 0x5B, 0x1C, 0x28, 0x00, 0x48, 0x10, 0x28, 0x30, 
+	0x90, 0x53, 0x00, 0x26, 0x01, 0x68, 0xB3, 0x00, 0x30, 0x49, 0x68, 0x1E, 0x22, 0x07, 0x30, 0x05, 
+	0xF5, 0xFC, 0xCC, 0x1F, 0x25, 0x02, 0x9D, 0x3F, 0x15, 0x01, 0xD3, 0x03, 0x37, 0x89, 0x1F, 0xF1, 
+	0xA6, 0x00, 0x10, 0x07, 0x28, 0x0F, 0x61, 0xA5, 0x0E, 0x40, 0x00, 0x00, 0x42, 0x70, 0x1E, 0x08, 
+	0xA6, 0x00, 0x28, 0x10, 0x4E, 0xA5, 0x00, 0x00, 0x69, 0x2C, 0x37, 0x00, 0x55, 0xE4, 0x2E, 0x25, 
+	0x04, 0x45, 0x02, 0x55, 0x24, 0x00, 0x15, 0x9B, 0x08, 0x53, 0x00, 0x90, 0x0D, 0xA0, 0x0F, 0x00, 
+	0x12, 0x80, 0x40, 0xD4, 0x14, 0xFC, 0x26, 0x30, 0x09, 0x4B, 0x10, 0x98, 0x02, 0x04, 0x44, 0x00, 
+	0x31, 0x12, 0x06, 0x1D, 0x36, 0x1F, 0x01, 0xBF, 0x05, 0x20, 0x62, 0x1D, 0x34, 0x00, 0x40, 0x04, 
+	0x07, 0x68, 0x47, 0x4B, 0x00, 0x11, 0x76, 0x54, 0x22, 0x05, 0x98, 0x02, 0x58, 0x33, 0x01, 0xD0, 
+	0x10, 0x01, 0x18, 0x0B, 0x62, 0x18, 0x00, 0xFC, 0x18, 0x06, 0x30, 0x79, 0x07, 0x25, 0x00, 0x15, 
+	0x57, 0x18, 0x51, 0x00, 0x00, 0xCC, 0x5B, 0x00, 0xAD, 0x1C, 0x05, 0x01, 0x00, 0x60, 0xC1, 0x2F, 
+	0xC3, 0x81, 0x43, 0xC0, 0xCF, 0x06, 0x46, 0x03, 0x80, 0x00, 0x08, 0xBA, 0x10, 0x11, 0x0C, 0x2C, 
+	0x29, 0x07, 0x07, 0x0E, 0x52, 0x04, 0x10, 0xFC, 0xF0, 0x14, 0x0C, 0x01, 0x26, 0x70, 0xF0, 0x6E, 
+	0x1F, 0x51, 0x00, 0x07, 0x33, 0x5A, 0x50, 0x98, 0x02, 0x03, 0x0D, 0x01, 0x71, 0x03, 0x01, 0xC0, 
+	0x2F, 0xCB, 0x83, 0xC6, 0x04, 0x14, 0x01, 0xCC, 0x1B, 0x04, 0xA6, 0x00, 0x51, 0x10, 0x00, 0x14, 
+	0x0D, 0x80, 0x59, 0x1A, 0x02, 0x01, 0x00, 0x82, 0x80, 0x00, 0x10, 0x80, 0x0A, 0x08, 0x34, 0x2C, 
+	0x78, 0x2D, 0x17, 0xC0, 0x98, 0x02, 0x02, 0x33, 0x08, 0x07, 0x45, 0x02, 0x52, 0x00, 0x80, 0x00, 
+	0xA1, 0xE1, 0x2E, 0x04, 0x37, 0x01, 0x81, 0x1C, 0x22, 0x0D, 0x10, 0x04, 0x5B, 0x07, 0x01, 0x79, 
+	0x05, 0x54, 0x04, 0x00, 0x00, 0x55, 0xC0, 0x10, 0x1A, 0x86, 0x70, 0x00, 0x13, 0x90, 0xE8, 0x00, 
+	0xB4, 0x08, 0x89, 0x04, 0x11, 0x18, 0x9F, 0x00, 0x00, 0x71, 0x2C, 0xA0, 0x00, 0x00, 0x10, 0x1D, 
+	0x79, 0x01, 0x80, 0x04, 0xB8, 0x20, 0xD5, 0x04, 0x80, 0x30, 0x00, 0x36, 0x04, 0x00, 0x08, 0x81, 
+	0x0C, 0xFC, 0x00, 0x01, 0x4B, 0x0A, 0x00, 0x84, 0x14, 0x03, 0xC9, 0x00, 0x01, 0x09, 0x00, 0x70, 
+	0x0E, 0x04, 0x00, 0x04, 0x50, 0x0E, 0x80, 0x6C, 0x06, 0x40, 0x04, 0x6C, 0x00, 0x04, 0x69, 0x05, 
+	0x12, 0x02, 0xCB, 0x17, 0x07, 0x39, 0x24, 0x01, 0x39, 0x00, 0x50, 0xF1, 0x40, 0x00, 0x00, 0x05, 
+	0x7A, 0x0C, 0x48, 0x80, 0x00, 0x2D, 0x93, 0xDB, 0x1B, 0x02, 0xC0, 0x23, 0x03, 0xB0, 0x00, 0x20, 
+	0x38, 0x34, 0x95, 0x00, 0x21, 0x04, 0x10, 0x00, 0x0B, 0x39, 0x02, 0x80, 0x0A, 0x8D, 0x01, 0x17, 
+	0x08, 0x74, 0x16, 0x73, 0x42, 0x01, 0x69, 0x00, 0x81, 0x00, 0x28, 0x7F, 0x01, 0x21, 0x14, 0x14, 
+	0xC1, 0x00, 0x00, 0x02, 0x01, 0x04, 0xD9, 0x24, 0x03, 0x6F, 0x3F, 0x40, 0x04, 0x04, 0x00, 0x9D, 
+	0x08, 0x00, 0x11, 0x0C, 0x37, 0x04, 0x54, 0x00, 0x10, 0x00, 0x20, 0x91, 0xF7, 0x00, 0x00, 0x3C, 
+	0x00, 0x34, 0x18, 0x21, 0x40, 0x6D, 0x02, 0x70, 0x04, 0x00, 0x0B, 0xC8, 0x00, 0x00, 0xC0, 0xBB, 
+	0x31, 0x00, 0xF1, 0x30, 0x38, 0x82, 0x04, 0x09, 0xC3, 0x00, 0x44, 0x02, 0x08, 0x01, 0x05, 0x1F, 
+	0x1B, 0x50, 0x20, 0x80, 0x00, 0xAF, 0x0F, 0x4D, 0x32, 0x90, 0x08, 0x00, 0x34, 0x70, 0x08, 0x23, 
+	0xCF, 0x60, 0xF0, 0xAA, 0x14, 0x00, 0x9F, 0x05, 0x00, 0x77, 0x02, 0x00, 0xB4, 0x1A, 0x02, 0xBA, 
+	0x14, 0xF7, 0x05, 0x60, 0x00, 0x0A, 0x94, 0x0F, 0x00, 0x90, 0x10, 0x30, 0x60, 0x85, 0x01, 0xE6, 
+	0xC0, 0x00, 0x80, 0x3C, 0xDC, 0x00, 0x1F, 0x52, 0x00, 0x61, 0x02, 0x04, 0x00, 0x80, 0x8F, 0x0C, 
+	0x9F, 0x01, 0x00, 0xDB, 0x09, 0xF0, 0x00, 0x0F, 0x8F, 0x04, 0x48, 0x8C, 0x00, 0x90, 0x14, 0x00, 
+	0x00, 0x20, 0x11, 0x68, 0xE9, 0x31, 0x4B, 0x09, 0x03, 0x01, 0x00, 0x20, 0x30, 0x08, 0x2B, 0x2E, 
+	0x03, 0xE6, 0x1C, 0x01, 0x38, 0x2F, 0x30, 0x48, 0xA0, 0x24, 0x2F, 0x0A, 0x66, 0x03, 0x00, 0x12, 
+	0x97, 0xBF, 0x19, 0x37, 0x04, 0x01, 0x25, 0x02, 0x11, 0x0D, 0x54, 0x15, 0xE1, 0x00, 0x00, 0x02, 
+	0x81, 0x42, 0x07, 0x0E, 0x00, 0x06, 0x04, 0x20, 0x04, 0x00, 0x39, 0x59, 0x08, 0x20, 0x30, 0xB1, 
+	0xFC, 0x1E, 0x02, 0x01, 0x00, 0x40, 0x70, 0x28, 0x00, 0x0C, 0x26, 0x12, 0x01, 0x83, 0x05, 0xC0, 
+	0x08, 0x15, 0x4E, 0x80, 0x10, 0x01, 0xD0, 0x60, 0x00, 0x69, 0x40, 0x28, 0x98, 0x02, 0x27, 0x07, 
+	0x8A, 0xC8, 0x07, 0x00, 0xF9, 0x00, 0x12, 0x0A, 0xA2, 0x01, 0x70, 0x84, 0x00, 0x1D, 0x06, 0x0F, 
+	0x8E, 0xA0, 0x5A, 0x34, 0x10, 0x2C, 0x87, 0x19, 0x30, 0x0E, 0xDA, 0xD9, 0x7E, 0x02, 0x04, 0x01, 
+	0x00, 0x00, 0xF9, 0x00, 0x04, 0x5B, 0x01, 0x50, 0x01, 0xD3, 0x7C, 0x50, 0x14, 0x74, 0x06, 0x11, 
+	0x6A, 0xC1, 0x00, 0x36, 0x1F, 0x9F, 0x1E, 0xCA, 0x01, 0x54, 0x03, 0x00, 0x04, 0x00, 0xE0, 0xA5, 
+	0x06, 0x70, 0x04, 0x28, 0x02, 0xB0, 0x0F, 0x00, 0x01, 0x1D, 0x1E, 0x86, 0x3C, 0x20, 0x00, 0x13, 
+	0xCC, 0x4A, 0x00, 0xA0, 0xC1, 0x02, 0x10, 0x20, 0x99, 0x1A, 0x04, 0x13, 0x03, 0x82, 0x11, 0x41, 
+	0x40, 0x00, 0x00, 0xC0, 0xA0, 0x60, 0x73, 0x03, 0x44, 0xBD, 0xF6, 0xC0, 0x1B, 0x97, 0x08, 0x01, 
+	0x11, 0x00, 0x11, 0x02, 0xF1, 0x34, 0x01, 0x56, 0x24, 0x12, 0x81, 0x18, 0x00, 0x23, 0xFC, 0x33, 
+	0xF0, 0x00, 0x13, 0x08, 0x11, 0x00, 0x01, 0xD7, 0x14, 0x35, 0x08, 0x21, 0x40, 0x4E, 0x15, 0x30, 
+	0x08, 0x15, 0xE8, 0xB6, 0x01, 0x30, 0x05, 0x87, 0xA8, 0x90, 0x2B, 0x31, 0x02, 0x0E, 0x07, 0xED, 
+	0x1C, 0x03, 0xF2, 0x2B, 0x06, 0x01, 0x00, 0x61, 0x04, 0x00, 0x20, 0x02, 0x16, 0x01, 0x8A, 0x36, 
+	0x00, 0xAB, 0x01, 0x45, 0x08, 0x00, 0x31, 0xE0, 0xF7, 0x00, 0x0A, 0xEB, 0x09, 0x52, 0x40, 0x08, 
+	0x10, 0x20, 0x4A, 0x06, 0x17, 0x80, 0x68, 0x06, 0x40, 0x00, 0xA0, 0x03, 0x34, 0x08, 0xB3, 0x02, 
+	0x6F, 0x02, 0x00, 0x00, 0x3F, 0x83, 0xC0, 0x7F, 0x0D, 0x01, 0xD1, 0x03, 0x88, 0x00, 0x08, 0x02, 
+	0x24, 0x05, 0x00, 0x02, 0x9F, 0xCD, 0x71, 0x81, 0x6D, 0x23, 0x2A, 0x03, 0x58, 0xCF, 0x11, 0x03, 
+	0x6A, 0x00, 0xD3, 0x08, 0x00, 0x60, 0x85, 0x80, 0x60, 0x47, 0x20, 0x02, 0xBF, 0xDD, 0x9D, 0x9F, 
+	0x5F, 0x3A, 0x11, 0x83, 0x22, 0x02, 0x05, 0xA9, 0x01, 0x00, 0x05, 0x00, 0x20, 0x05, 0x0A, 0x02, 
+	0x1E, 0x20, 0xB3, 0x2C, 0x1B, 0x2D, 0x30, 0x2C, 0xED, 0x90, 0x20, 0x05, 0x50, 0x30, 0x00, 0x08, 
+	0x38, 0x20, 0xA5, 0x1B, 0x02, 0x88, 0x07, 0x06, 0x01, 0x00, 0xC9, 0x08, 0x01, 0x44, 0x07, 0x76, 
+	0x07, 0x06, 0x00, 0x01, 0xA1, 0x4C, 0xCF, 0xB0, 0x23, 0x45, 0x04, 0x00, 0x8F, 0x0C, 0x60, 0x0A, 
+	0x50, 0x46, 0xDB, 0x8A, 0x00, 0x0F, 0x5C, 0x05, 0x65, 0x20, 0x00, 0x30, 0x00, 0x14, 0x28, 0x52, 
+	0x35, 0x20, 0x00, 0x28, 0x98, 0x02, 0x00, 0x0D, 0x00, 0x02, 0x48, 0x19, 0xA1, 0x02, 0x85, 0x7B, 
+	0xB9, 0xB0, 0x00, 0xC0, 0x60, 0x85, 0x81, 0x50, 0x26, 0x45, 0x17, 0xA7, 0x01, 0x0C, 0xC9, 0x01, 
+	0x00, 0x8A, 0x0A, 0x1A, 0x0F, 0x8B, 0x0C, 0x20, 0xC5, 0x08, 0x06, 0x31, 0x76, 0x80, 0x10, 0x02, 
+	0x94, 0x19, 0x01, 0xA4, 0x26, 0x25, 0x00, 0x09, 0x00, 0x17, 0x80, 0x60, 0x0A, 0x30, 0x70, 0x00, 
+	0x11, 0xF8, 0x0C, 0xA3, 0xE0, 0x10, 0x07, 0x00, 0x97, 0xCD, 0xB5, 0x18, 0x20, 0x14, 0xEF, 0x00, 
+	0x11, 0x07, 0x32, 0x09, 0x11, 0x09, 0xB0, 0x01, 0xF8, 0x05, 0x08, 0x00, 0x02, 0xBD, 0x41, 0x05, 
+	0x0B, 0x00, 0x81, 0x08, 0x20, 0x04, 0x1C, 0x02, 0x80, 0x06, 0x13, 0x3D, 0xE8, 0xF0, 0x81, 0x3B, 
+	0x00, 0xF1, 0x12, 0x02, 0xFA, 0x09, 0x70, 0x00, 0x00, 0x0B, 0xD5, 0xF8, 0x80, 0xE0, 0x35, 0x38, 
+	0x01, 0x0C, 0x01, 0x34, 0x39, 0xE4, 0x9D, 0xF9, 0x00, 0x10, 0x03, 0x8A, 0x08, 0x34, 0x19, 0x84, 
+	0xE0, 0xF7, 0x00, 0x20, 0x41, 0x28, 0x7A, 0x02, 0xC3, 0x0C, 0x00, 0x01, 0xDC, 0x00, 0x02, 0x82, 
+	0x00, 0x02, 0xE3, 0x4D, 0x19, 0x82, 0x16, 0x00, 0xF2, 0x01, 0x45, 0x20, 0x0A, 0x94, 0x1F, 0x9D, 
+	0x0A, 0xF1, 0x03, 0x12, 0x81, 0xEE, 0x00, 0x80, 0x00, 0xB0, 0x00, 0x1B, 0x78, 0x40, 0x10, 0x12, 
+	0x00, 0x1E, 0x8C, 0x81, 0x9E, 0x1D, 0x0F, 0x02, 0x23, 0x01, 0x33, 0x00, 0x17, 0x8E, 0x0C, 0x00, 
+	0x51, 0x17, 0x70, 0x01, 0x29, 0x40, 0x86, 0x27, 0x96, 0x5F, 0x0A, 0xB4, 0x20, 0x50, 0x04, 0x00, 
+	0x03, 0x5A, 0x36, 0x10, 0x00, 0x74, 0x35, 0x13, 0x78, 0x5B, 0x07, 0x60, 0x02, 0x81, 0x08, 0x09, 
+	0x68, 0x01, 0x9C, 0x06, 0x20, 0x20, 0x55, 0x93, 0x1D, 0x42, 0x20, 0x20, 0x41, 0xC5, 0xA4, 0x35, 
+	0x11, 0x0F, 0xF2, 0x01, 0x46, 0x01, 0x29, 0x55, 0x80, 0x43, 0x3A, 0x81, 0x0C, 0x01, 0x00, 0xA0, 
+	0x00, 0x04, 0x00, 0x92, 0xE0, 0x00, 0x23, 0xD2, 0xFA, 0xF5, 0x25, 0x11, 0xF0, 0x26, 0x1D, 0x23, 
+	0x11, 0xF8, 0xF9, 0x00, 0x02, 0xFC, 0x00, 0x10, 0x80, 0xC3, 0x0D, 0x90, 0x81, 0xE9, 0x40, 0x11, 
+	0x00, 0x00, 0x1E, 0x9F, 0xAF, 0xF9, 0x00, 0x08, 0x30, 0x05, 0x12, 0x0E, 0x40, 0x27, 0x43, 0x50, 
+	0x01, 0x4C, 0xEC, 0x90, 0x05, 0x01, 0x69, 0x26, 0x43, 0x14, 0x20, 0x00, 0x90, 0x99, 0x00, 0x03, 
+	0xEB, 0x02, 0x14, 0x18, 0xC7, 0x16, 0x50, 0x1B, 0x33, 0x6C, 0x81, 0x81, 0x36, 0x10, 0x01, 0x76, 
+	0x13, 0x42, 0x81, 0x57, 0xE5, 0x01, 0x27, 0x20, 0x02, 0x01, 0x00, 0x30, 0x08, 0x15, 0xA0, 0xAF, 
+	0x0D, 0x05, 0x0F, 0x00, 0x00, 0x48, 0x03, 0x90, 0x7E, 0x5C, 0x40, 0x00, 0x08, 0x42, 0x07, 0x4E, 
+	0x90, 0xE1, 0x01, 0x05, 0xF8, 0x0C, 0x20, 0x02, 0xEA, 0x81, 0x1C, 0x04, 0x01, 0x00, 0x01, 0x99, 
+	0x0D, 0xB0, 0x01, 0xFE, 0x02, 0x80, 0x00, 0x81, 0x90, 0xA0, 0x17, 0x00, 0x0C, 0xCA, 0x25, 0x01, 
+	0x84, 0x03, 0x01, 0xF6, 0x14, 0x02, 0x6F, 0x19, 0x50, 0x10, 0x00, 0x82, 0x4C, 0xEC, 0x15, 0x23, 
+	0x02, 0x58, 0x0C, 0x81, 0x20, 0x02, 0x06, 0xDC, 0x71, 0x80, 0x00, 0xC2, 0xFD, 0x13, 0x21, 0x1E, 
+	0x38, 0xA9, 0x00, 0x02, 0x60, 0x0A, 0x80, 0x02, 0x00, 0x00, 0x1B, 0x30, 0x4C, 0x01, 0x80, 0xBF, 
+	0x17, 0xB1, 0x02, 0x42, 0x80, 0x02, 0x01, 0x09, 0x7D, 0xF7, 0x0F, 0x01, 0x8C, 0x1A, 0x00, 0x60, 
+	0x42, 0x43, 0x40, 0x05, 0x22, 0x16, 0xDD, 0x08, 0x01, 0xB5, 0x00, 0x30, 0x20, 0xC6, 0x28, 0xD9, 
+	0x00, 0xD2, 0x04, 0x00, 0x04, 0xFC, 0x1E, 0x28, 0x10, 0x18, 0x00, 0x63, 0x4E, 0x00, 0x80, 0x99, 
+	0x3F, 0x00, 0x3D, 0x1E, 0x44, 0x50, 0x03, 0xFC, 0x09, 0x60, 0x0A, 0x41, 0x0A, 0x55, 0x42, 0x0A, 
+	0x9F, 0x0B, 0xC0, 0x47, 0xAA, 0x60, 0x40, 0x07, 0x00, 0x89, 0x20, 0x10, 0x01, 0x18, 0x5C, 0x8A, 
+	0x00, 0x22, 0xB5, 0xB4, 0xC3, 0x00, 0x12, 0x07, 0x9F, 0x01, 0x51, 0x08, 0xA8, 0x10, 0x00, 0x2C, 
+	0x04, 0x01, 0x30, 0x20, 0x04, 0x24, 0x04, 0x03, 0x22, 0x40, 0x6E, 0x3C, 0x03, 0x33, 0x02, 0xC7, 
+	0x78, 0xD2, 0x0E, 0x02, 0x25, 0x31, 0x42, 0x01, 0x05, 0x00, 0x04, 0xD7, 0x02, 0x40, 0x60, 0x00, 
+	0x73, 0x66, 0xC7, 0x04, 0x30, 0x25, 0xC1, 0x81, 0x12, 0x01, 0x70, 0x62, 0x00, 0x3F, 0x72, 0x00, 
+	0x80, 0x11, 0xBC, 0x0A, 0x1F, 0x01, 0xF8, 0x1C, 0x03, 0x0F, 0x01, 0x00, 0xFF, 0xFF, 0xFF, 0xDD, 
+	0x3F, 0x82, 0x00, 0x80, 0x07, 0x04, 0xFF, 0xFF, 0xFF, 0xF4, 0x2F, 0x11, 0x01, 0x10, 0x08, 0xFF, 
+	0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0x04, 0x1F, 0x02, 0x10, 0x08, 0xFF, 0xFF, 0xFF, 0xFF, 
+	0xFF, 0xFF, 0xFF, 0xFF, 0x04, 0x1F, 0x03, 0x10, 0x08, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 
+	0xFF, 0x03, 0x60, 0x22, 0x98, 0xD0, 0x01, 0x06, 0x00, 
 };
 
 #ifdef __cplusplus
 }
 #endif
 
-#endif // __cariboulite_fpga_firmware_h__
+#endif // __cariboulite_fpga_firmware1_h__
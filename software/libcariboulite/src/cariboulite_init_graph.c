@@ -0,0 +1,142 @@
+#ifndef ZF_LOG_LEVEL
+    #define ZF_LOG_LEVEL ZF_LOG_VERBOSE
+#endif
+#define ZF_LOG_DEF_SRCLOC ZF_LOG_SRCLOC_LONG
+#define ZF_LOG_TAG "CARIBOULITE InitGraph"
+#include "zf_log/zf_log.h"
+
+#include <pthread.h>
+#include <time.h>
+
+#include "cariboulite_init_graph.h"
+
+typedef struct
+{
+    sys_st* sys;
+    cariboulite_init_stage_st* stages;
+    uint32_t done;
+    uint32_t failed;
+    double start_ms;
+    pthread_mutex_t mtx;
+    pthread_cond_t cond;
+} init_graph_st;
+
+typedef struct
+{
+    init_graph_st* graph;
+    int index;
+} init_graph_stage_arg_st;
+
+//=======================================================================================
+static double init_graph_time_ms(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e3 + ts.tv_nsec / 1e6;
+}
+
+//=======================================================================================
+static void* init_graph_stage_thread(void* arg)
+{
+    init_graph_stage_arg_st* stage_arg = (init_graph_stage_arg_st*)arg;
+    init_graph_st* graph = stage_arg->graph;
+    cariboulite_init_stage_st* stage = &graph->stages[stage_arg->index];
+
+    pthread_mutex_lock(&graph->mtx);
+    while ((graph->done & stage->deps) != stage->deps) pthread_cond_wait(&graph->cond, &graph->mtx);
+    bool dep_failed = (graph->failed & stage->deps) != 0;
+    pthread_mutex_unlock(&graph->mtx);
+
+    double t0 = init_graph_time_ms();
+    stage->start_ms = t0 - graph->start_ms;
+    if (dep_failed)
+    {
+        stage->ran = false;
+        stage->result = -1;
+    }
+    else
+    {
+        stage->ran = true;
+        stage->result = stage->run(graph->sys);
+    }
+    stage->duration_ms = init_graph_time_ms() - t0;
+
+    pthread_mutex_lock(&graph->mtx);
+    graph->done |= CARIBOULITE_INIT_DEP(stage_arg->index);
+    if (stage->result < 0) graph->failed |= CARIBOULITE_INIT_DEP(stage_arg->index);
+    pthread_cond_broadcast(&graph->cond);
+    pthread_mutex_unlock(&graph->mtx);
+    return NULL;
+}
+
+//=======================================================================================
+int cariboulite_init_graph_run(sys_st* sys, cariboulite_init_stage_st* stages, int num_stages)
+{
+    if (num_stages <= 0 || num_stages > CARIBOULITE_INIT_MAX_STAGES)
+    {
+        ZF_LOGE("invalid number of init stages %d", num_stages);
+        return -1;
+    }
+
+    for (int i = 0; i < num_stages; i++)
+    {
+        // only earlier stages - the graph can't deadlock
+        if (stages[i].deps & ~(CARIBOULITE_INIT_DEP(i) - 1))
+        {
+            ZF_LOGE("init stage '%s' depends on a later stage", stages[i].name);
+            return -1;
+        }
+    }
+
+    init_graph_st graph = {
+        .sys = sys,
+        .stages = stages,
+        .done = 0,
+        .failed = 0,
+        .start_ms = init_graph_time_ms(),
+    };
+    pthread_mutex_init(&graph.mtx, NULL);
+    pthread_cond_init(&graph.cond, NULL);
+
+    init_graph_stage_arg_st args[CARIBOULITE_INIT_MAX_STAGES];
+    pthread_t threads[CARIBOULITE_INIT_MAX_STAGES];
+    bool threaded[CARIBOULITE_INIT_MAX_STAGES] = {0};
+
+    for (int i = 0; i < num_stages; i++)
+    {
+        args[i].graph = &graph;
+        args[i].index = i;
+        threaded[i] = pthread_create(&threads[i], NULL, init_graph_stage_thread, &args[i]) == 0;
+        if (!threaded[i])
+        {
+            // its dependencies are all on running threads or done already
+            ZF_LOGW("no thread for init stage '%s', running it in place", stages[i].name);
+            init_graph_stage_thread(&args[i]);
+        }
+    }
+
+    for (int i = 0; i < num_stages; i++)
+    {
+        if (threaded[i]) pthread_join(threads[i], NULL);
+    }
+
+    pthread_cond_destroy(&graph.cond);
+    pthread_mutex_destroy(&graph.mtx);
+    return graph.failed ? -1 : 0;
+}
+
+//=======================================================================================
+void cariboulite_init_graph_report(const cariboulite_init_stage_st* stages, int num_stages)
+{
+    double total_ms = 0.0;
+    double sequential_ms = 0.0;
+    for (int i = 0; i < num_stages; i++)
+    {
+        const cariboulite_init_stage_st* st = &stages[i];
+        ZF_LOGI("init stage %-12s start %7.1f ms, took %7.1f ms%s", st->name, st->start_ms, st->duration_ms,
+                    st->ran ? (st->result < 0 ? " (failed)" : "") : " (skipped)");
+        sequential_ms += st->duration_ms;
+        if (st->start_ms + st->duration_ms > total_ms) total_ms = st->start_ms + st->duration_ms;
+    }
+    ZF_LOGI("init stages done in %.1f ms (%.1f ms sequential)", total_ms, sequential_ms);
+}
@@ -0,0 +1,43 @@
+#ifndef __CARIBOULITE_INIT_GRAPH_H__
+#define __CARIBOULITE_INIT_GRAPH_H__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "cariboulite_internal.h"
+
+// Initialization as a dependency graph - every stage runs on its own thread
+// as soon as the stages it depends on complete, so the waits of independent
+// chips overlap. SPI transactions and GPIO configuration serialize in io_utils.
+#define CARIBOULITE_INIT_MAX_STAGES     (16)
+#define CARIBOULITE_INIT_DEP(i)         (1u << (i))
+
+typedef int (*cariboulite_init_stage_fn)(sys_st* sys);
+
+typedef struct
+{
+    const char* name;
+    cariboulite_init_stage_fn run;
+    uint32_t deps;                  // CARIBOULITE_INIT_DEP() of earlier stages only
+
+    // the outcome
+    int result;                     // the stage's return value (-1 when a dependency failed)
+    bool ran;
+    double start_ms;                // since the graph started
+    double duration_ms;
+} cariboulite_init_stage_st;
+
+// 0 = all the stages succeeded (result >= 0), -1 = a stage failed
+int cariboulite_init_graph_run(sys_st* sys, cariboulite_init_stage_st* stages, int num_stages);
+
+// log the timing of every stage and the time saved against a sequential run
+void cariboulite_init_graph_report(const cariboulite_init_stage_st* stages, int num_stages);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // __CARIBOULITE_INIT_GRAPH_H__
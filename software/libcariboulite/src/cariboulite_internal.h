@@ -22,6 +22,7 @@ extern "C" {
 #include "caribou_smi/caribou_smi.h"
 
 #include "cariboulite_radio.h"
+#include "cariboulite_attach.h"
 
 // GENERAL SETTINGS
 struct sys_st_t;
@@ -86,6 +87,8 @@ typedef struct sys_st_t
     // Configuration
     int reset_fpga_on_startup;
 	int force_fpga_reprogramming;
+	int force_modem_calibration;			// ignore the cached modem calibration
+	int warm_attach;						// adopt the hardware state of a previous session
 	int fpga_config_resistor_state;
     char firmware_path_operational[PATH_MAX];
     char firmware_path_testing[PATH_MAX];
@@ -103,6 +106,9 @@ typedef struct sys_st_t
     caribou_fpga_versions_st fpga_versions;
     uint8_t fpga_error_status;
 	int fpga_config_res_state;
+	int modem_cal_temp_band;
+	bool warm_attached;
+	cariboulite_attach_state_st attach_state;
 	// Initialization
 	sys_status_en system_status;
 } sys_st;
@@ -12,6 +12,10 @@
 #include <string.h>
 #include <linux/random.h>
 #include <sys/ioctl.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <time.h>
+#include <errno.h>
 
 #include "cariboulite_internal.h"
 #include "cariboulite_radio.h"
@@ -26,6 +30,56 @@ static float sample_rate_middles[] = {3000e3f, 1666e3f, 1166e3f, 900e3f, 733e3f,
 static float rx_bandwidth_middles[] = {180e3f, 225e3f, 285e3f, 360e3f, 450e3f, 565e3f, 715e3f, 900e3f, 1125e3f, 1425e3f, 1800e3f};
 static float tx_bandwidth_middles[] = {90e3f, 112e3f, 142e3f, 180e3f, 225e3f, 282e3f, 357e3f, 450e3f, 562e3f, 712e3f, 900e3f};
 
+// Frequency plans (set_frequency cache)
+#define FREQ_PLAN_CACHE_BITS        ( 6 )
+#define FREQ_PLAN_CACHE_SIZE        ( 1 << FREQ_PLAN_CACHE_BITS )
+
+typedef struct
+{
+    bool                                valid;
+    double                              requested_freq;         // the cache key
+    double                              actual_freq;
+
+    // modem channel registers
+    at86rf215_rf_channel_en             modem_ch;
+    at86rf215_radio_channel_mode_en     modem_mode;
+    int                                 modem_center_freq_25khz_res;
+    int                                 modem_channel_number;
+    double                              modem_freq;
+
+    // mixer (full version, up / down conversion only)
+    cariboulite_conversion_dir_en       conversion_direction;
+    cariboulite_ext_ref_freq_en         ext_ref;
+    bool                                needs_mixer;            // also means that the mixer is (re)calibrated
+                                                                // whenever its reference changes
+    rffc507x_freq_plan_st               mixer;
+    double                              lo_freq;
+
+    // FPGA RF-path per channel direction
+    caribou_fpga_io_ctrl_rfm_en         rf_path_rx;
+    caribou_fpga_io_ctrl_rfm_en         rf_path_tx;
+} cariboulite_freq_plan_st;
+
+struct cariboulite_freq_plan_cache_t
+{
+    cariboulite_freq_plan_st            plans[FREQ_PLAN_CACHE_SIZE];
+    uint32_t                            hits;
+    uint32_t                            misses;
+
+    // what the hardware currently holds
+    bool                                modem_valid;
+    at86rf215_radio_channel_mode_en     modem_mode;
+    int                                 modem_center_freq_25khz_res;
+    int                                 modem_channel_number;
+
+    bool                                ext_ref_valid;
+    cariboulite_ext_ref_freq_en         ext_ref;
+    bool                                mixer_valid;            // calibrated and programmed on the current reference
+
+    bool                                rf_path_valid;
+    caribou_fpga_io_ctrl_rfm_en         rf_path;
+};
+
 
 //=========================================================================
 int cariboulite_radio_init(cariboulite_radio_state_st* radio, sys_st *sys, cariboulite_channel_en type)
@@ -40,6 +94,13 @@ int cariboulite_radio_init(cariboulite_radio_state_st* radio, sys_st *sys, carib
     radio->lo_output = false;
     radio->tx_loopback_anabled = false;
     radio->smi_channel_id = GET_SMI_CH(type);
+    pthread_mutex_init(&radio->sensor_sampler_mtx, NULL);
+    pthread_mutex_init(&radio->hop_scheduler_mtx, NULL);
+    radio->freq_plans = calloc(1, sizeof(struct cariboulite_freq_plan_cache_t));
+    if (radio->freq_plans == NULL)
+    {
+        ZF_LOGW("frequency plan cache allocation failed - every retune will be computed and written in full");
+    }
     
     // activation of the channel
     cariboulite_radio_activate_channel(radio, cariboulite_channel_dir_rx, true);
@@ -52,6 +113,8 @@ int cariboulite_radio_init(cariboulite_radio_state_st* radio, sys_st *sys, carib
 //=========================================================================
 int cariboulite_radio_dispose(cariboulite_radio_state_st* radio)
 {
+    cariboulite_radio_stop_sensor_sampler(radio);
+    cariboulite_radio_stop_hopping(radio);
 	cariboulite_radio_activate_channel(radio, cariboulite_channel_dir_rx, false);
 
     at86rf215_radio_set_state( &radio->sys->modem, 
@@ -64,6 +127,11 @@ int cariboulite_radio_dispose(cariboulite_radio_state_st* radio)
 	{
     	caribou_fpga_set_io_ctrl_mode (&radio->sys->fpga, 0, caribou_fpga_io_ctrl_rfm_low_power);
 	}
+
+    free(radio->freq_plans);
+    radio->freq_plans = NULL;
+    pthread_mutex_destroy(&radio->sensor_sampler_mtx);
+    pthread_mutex_destroy(&radio->hop_scheduler_mtx);
     return 0;
 }
 
@@ -131,7 +199,7 @@ int cariboulite_radio_get_mod_intertupts (cariboulite_radio_state_st* radio, car
 }
 
 //=========================================================================
-int cariboulite_radio_set_rx_gain_control(cariboulite_radio_state_st* radio, 
+static void cariboulite_radio_write_agc(cariboulite_radio_state_st* radio, 
                                     bool rx_agc_on,
                                     int rx_gain_value_db)
 {
@@ -153,6 +221,21 @@ int cariboulite_radio_set_rx_gain_control(cariboulite_radio_state_st* radio,
     at86rf215_radio_setup_agc(&radio->sys->modem, GET_MODEM_CH(radio->type), &rx_gain_control);
     radio->rx_agc_on = rx_agc_on;
     radio->rx_gain_value_db = rx_gain_value_db;
+}
+
+//=========================================================================
+int cariboulite_radio_set_rx_gain_control(cariboulite_radio_state_st* radio, 
+                                    bool rx_agc_on,
+                                    int rx_gain_value_db)
+{
+    if (radio->txn.active)
+    {
+        radio->txn.rx_agc_on = rx_agc_on;
+        radio->txn.rx_gain_value_db = rx_gain_value_db;
+        return 0;
+    }
+
+    cariboulite_radio_write_agc(radio, rx_agc_on, rx_gain_value_db);
     return 0;
 }
 
@@ -183,6 +266,52 @@ int cariboulite_radio_get_rx_gain_limits(cariboulite_radio_state_st* radio,
     return 0;
 }
 
+//=========================================================================
+static void cariboulite_radio_write_rx_bw_samp(cariboulite_radio_state_st* radio, 
+                                    cariboulite_radio_rx_bw_en rx_bw,
+                                    cariboulite_radio_f_cut_en rx_cutoff,
+                                    cariboulite_radio_sample_rate_en rx_sample_rate)
+{
+    at86rf215_radio_set_rx_bw_samp_st cfg = 
+    {
+        .inverter_sign_if = 0,              // A value of one configures the receiver to implement the inverted-sign
+                                            // IF frequency. Use default setting for normal operation
+        .shift_if_freq = 1,                 // A value of one configures the receiver to shift the IF frequency
+                                            // by factor of 1.25. This is useful to place the image frequency according
+                                            // to channel scheme. This increases the IF frequency to max 2.5MHz
+                                            // thus places the internal LO fasr away from the signal => lower noise
+        .bw = (at86rf215_radio_rx_bw_en)rx_bw,
+        .fcut = (at86rf215_radio_f_cut_en)rx_cutoff,
+        .fs = (at86rf215_radio_sample_rate_en)rx_sample_rate,
+    };
+    at86rf215_radio_set_rx_bandwidth_sampling(&radio->sys->modem, GET_MODEM_CH(radio->type), &cfg);
+    radio->rx_bw = rx_bw;
+    radio->rx_fcut = rx_cutoff;
+    radio->rx_fs = rx_sample_rate;
+}
+
+//=========================================================================
+static void cariboulite_radio_update_smi_sample_rate(cariboulite_radio_state_st* radio, 
+                                    cariboulite_radio_sample_rate_en rx_sample_rate)
+{
+    // setup the smi sample rate for timeout
+    uint32_t sample_rate = 4000000;
+    switch(rx_sample_rate)
+    {
+        case cariboulite_radio_rx_sample_rate_4000khz: sample_rate = 4000000; break;
+        case cariboulite_radio_rx_sample_rate_2000khz: sample_rate = 2000000; break;
+        case cariboulite_radio_rx_sample_rate_1333khz: sample_rate = 1333333; break;    // close enough to set timeout
+        case cariboulite_radio_rx_sample_rate_1000khz: sample_rate = 1000000; break;
+        case cariboulite_radio_rx_sample_rate_800khz: sample_rate = 800000; break;
+        case cariboulite_radio_rx_sample_rate_666khz: sample_rate = 666667; break;      // close enough to set timeout
+        case cariboulite_radio_rx_sample_rate_500khz: sample_rate = 500000; break;
+        case cariboulite_radio_rx_sample_rate_400khz: sample_rate = 400000; break;
+        default: sample_rate = 4000000; break;
+    }
+    
+    caribou_smi_set_sample_rate(&radio->sys->smi, sample_rate);
+}
+
 //=========================================================================
 int cariboulite_radio_set_rx_bandwidth(cariboulite_radio_state_st* radio, 
                                  		cariboulite_radio_rx_bw_en rx_bw)
@@ -210,21 +339,14 @@ int cariboulite_radio_set_rx_bandwidth(cariboulite_radio_state_st* radio,
     }*/
    
     
-    radio->rx_fcut = fcut;
-    
-    at86rf215_radio_set_rx_bw_samp_st cfg = 
+    if (radio->txn.active)
     {
-        .inverter_sign_if = 0,
-        .shift_if_freq = 1,                 // A value of one configures the receiver to shift the IF frequency
-                                            // by factor of 1.25. This is useful to place the image frequency according
-                                            // to channel scheme. This increases the IF frequency to max 2.5MHz
-                                            // thus places the internal LO fasr away from the signal => lower noise
-        .bw = (at86rf215_radio_rx_bw_en)rx_bw,
-        .fcut = (at86rf215_radio_f_cut_en)radio->rx_fcut,
-        .fs = (at86rf215_radio_sample_rate_en)radio->rx_fs,
-    };
-    at86rf215_radio_set_rx_bandwidth_sampling(&radio->sys->modem, GET_MODEM_CH(radio->type), &cfg);
-    radio->rx_bw = rx_bw;
+        radio->txn.rx_bw = rx_bw;
+        radio->txn.rx_fcut = fcut;
+        return 0;
+    }
+
+    cariboulite_radio_write_rx_bw_samp(radio, rx_bw, fcut, radio->rx_fs);
     return 0;
 }
 
@@ -294,37 +416,15 @@ int cariboulite_radio_set_rx_samp_cutoff(cariboulite_radio_state_st* radio,
                                    cariboulite_radio_sample_rate_en rx_sample_rate,
                                    cariboulite_radio_f_cut_en rx_cutoff)
 {
-    at86rf215_radio_set_rx_bw_samp_st cfg = 
-    {
-        .inverter_sign_if = 0,              // A value of one configures the receiver to implement the inverted-sign
-                                            // IF frequency. Use default setting for normal operation
-        .shift_if_freq = 1,                 // A value of one configures the receiver to shift the IF frequency
-                                            // by factor of 1.25. This is useful to place the image frequency according
-                                            // to channel scheme.
-        .bw = (at86rf215_radio_rx_bw_en)radio->rx_bw,                 // keep the same
-        .fcut = (at86rf215_radio_f_cut_en)rx_cutoff,
-        .fs = (at86rf215_radio_sample_rate_en)rx_sample_rate,
-    };
-    at86rf215_radio_set_rx_bandwidth_sampling(&radio->sys->modem, GET_MODEM_CH(radio->type), &cfg);
-    radio->rx_fs = rx_sample_rate;
-    radio->rx_fcut = rx_cutoff;
-    
-    // setup the smi sample rate for timeout
-    uint32_t sample_rate = 4000000;
-    switch(rx_sample_rate)
+    if (radio->txn.active)
     {
-        case cariboulite_radio_rx_sample_rate_4000khz: sample_rate = 4000000; break;
-        case cariboulite_radio_rx_sample_rate_2000khz: sample_rate = 2000000; break;
-        case cariboulite_radio_rx_sample_rate_1333khz: sample_rate = 1333333; break;    // close enough to set timeout
-        case cariboulite_radio_rx_sample_rate_1000khz: sample_rate = 1000000; break;
-        case cariboulite_radio_rx_sample_rate_800khz: sample_rate = 800000; break;
-        case cariboulite_radio_rx_sample_rate_666khz: sample_rate = 666667; break;      // close enough to set timeout
-        case cariboulite_radio_rx_sample_rate_500khz: sample_rate = 500000; break;
-        case cariboulite_radio_rx_sample_rate_400khz: sample_rate = 400000; break;
-        default: sample_rate = 4000000; break;
+        radio->txn.rx_fs = rx_sample_rate;
+        radio->txn.rx_fcut = rx_cutoff;
+        return 0;
     }
-    
-    caribou_smi_set_sample_rate(&radio->sys->smi, sample_rate);
+
+    cariboulite_radio_write_rx_bw_samp(radio, radio->rx_bw, rx_cutoff, rx_sample_rate);
+    cariboulite_radio_update_smi_sample_rate(radio, rx_sample_rate);
     return 0;
 }
 
@@ -366,7 +466,7 @@ static float sample_rate_to_flt(cariboulite_radio_sample_rate_en sample_rate)
 int cariboulite_radio_set_rx_sample_rate_flt(cariboulite_radio_state_st* radio, float sample_rate_hz)
 {
     cariboulite_radio_sample_rate_en rx_sample_rate = sample_rate_from_flt(sample_rate_hz);
-    cariboulite_radio_f_cut_en rx_cutoff = radio->rx_fcut;
+    cariboulite_radio_f_cut_en rx_cutoff = radio->txn.active ? radio->txn.rx_fcut : radio->rx_fcut;
     return cariboulite_radio_set_rx_samp_cutoff(radio, rx_sample_rate, rx_cutoff);
 }
 
@@ -394,8 +494,58 @@ int cariboulite_radio_get_rx_sample_rate_flt(cariboulite_radio_state_st* radio,
 }
 
 //=========================================================================
-int cariboulite_radio_set_tx_power(cariboulite_radio_state_st* radio, int tx_power_dbm)
+static void cariboulite_radio_write_tx_ctrl(cariboulite_radio_state_st* radio, 
+                                    int tx_power_ctrl,
+                                    cariboulite_radio_tx_cut_off_en tx_bw,
+                                    cariboulite_radio_f_cut_en tx_cutoff,
+                                    cariboulite_radio_sample_rate_en tx_sample_rate)
+{
+    at86rf215_radio_tx_ctrl_st cfg =
+    {
+        .pa_ramping_time = at86rf215_radio_tx_pa_ramp_16usec,
+        .current_reduction = at86rf215_radio_pa_current_reduction_0ma,  // we can use this to gain some more
+                                                                        // granularity with the tx gain control
+        .tx_power = tx_power_ctrl,
+        .analog_bw = (at86rf215_radio_tx_cut_off_en)tx_bw,
+        .digital_bw = (at86rf215_radio_f_cut_en)tx_cutoff,
+        .fs = (at86rf215_radio_sample_rate_en)tx_sample_rate,
+        .direct_modulation = 0,
+    };
+
+    at86rf215_radio_setup_tx_ctrl(&radio->sys->modem, GET_MODEM_CH(radio->type), &cfg);
+    radio->tx_bw = tx_bw;
+    radio->tx_fcut = tx_cutoff;
+    radio->tx_fs = tx_sample_rate;
+}
+
+//=========================================================================
+static void cariboulite_radio_update_tx_sample_gap(cariboulite_radio_state_st* radio, 
+                                    cariboulite_radio_sample_rate_en tx_sample_rate)
+{
+    uint8_t sample_gap = 0;
+
+    // setup the new sample rate in the FPGA
+    switch (tx_sample_rate)
+    {
+        case cariboulite_radio_rx_sample_rate_4000khz: sample_gap = 0; break;
+        case cariboulite_radio_rx_sample_rate_2000khz: sample_gap = 1; break;
+        case cariboulite_radio_rx_sample_rate_1333khz: sample_gap = 2; break;
+        case cariboulite_radio_rx_sample_rate_1000khz: sample_gap = 3; break;
+        case cariboulite_radio_rx_sample_rate_800khz: sample_gap = 4; break;
+        case cariboulite_radio_rx_sample_rate_666khz: sample_gap = 5; break;
+        case cariboulite_radio_rx_sample_rate_500khz: sample_gap = 7; break;
+        case cariboulite_radio_rx_sample_rate_400khz: sample_gap = 9; break;
+        default: sample_gap = 0; break;
+    }
+    
+    caribou_fpga_set_sys_ctrl_tx_sample_gap (&radio->sys->fpga, sample_gap);
+}
+
+//=========================================================================
+// clips the requested power to the channel's range and returns the PA control word
+static int cariboulite_radio_tx_power_ctrl(cariboulite_radio_state_st* radio, int *tx_power_dbm_io)
 {
+	int tx_power_dbm = *tx_power_dbm_io;
 	float x = tx_power_dbm;
 	float tx_power_ctrl_model;
 	int tx_power_ctrl = 0;
@@ -426,20 +576,23 @@ int cariboulite_radio_set_tx_power(cariboulite_radio_state_st* radio, int tx_pow
     /*tx_power_ctrl = tx_power_dbm + 17;
     if (tx_power_ctrl < 0) tx_power_ctrl = 0;
 	if (tx_power_ctrl > 31) tx_power_ctrl = 31;*/
-	
-    at86rf215_radio_tx_ctrl_st cfg =
+
+	*tx_power_dbm_io = tx_power_dbm;
+	return tx_power_ctrl;
+}
+
+//=========================================================================
+int cariboulite_radio_set_tx_power(cariboulite_radio_state_st* radio, int tx_power_dbm)
+{
+	int tx_power_ctrl = cariboulite_radio_tx_power_ctrl(radio, &tx_power_dbm);
+
+    if (radio->txn.active)
     {
-        .pa_ramping_time = at86rf215_radio_tx_pa_ramp_16usec,
-        .current_reduction = at86rf215_radio_pa_current_reduction_0ma,  // we can use this to gain some more
-                                                                        // granularity with the tx gain control
-        .tx_power = tx_power_ctrl,
-        .analog_bw = (at86rf215_radio_tx_cut_off_en)radio->tx_bw,            // same as before
-        .digital_bw = (at86rf215_radio_f_cut_en)radio->tx_fcut,         // same as before
-        .fs = (at86rf215_radio_sample_rate_en)radio->tx_fs,                   // same as before
-        .direct_modulation = 0,
-    };
+        radio->txn.tx_power = tx_power_dbm;
+        return 0;
+    }
 
-    at86rf215_radio_setup_tx_ctrl(&radio->sys->modem, GET_MODEM_CH(radio->type), &cfg);
+    cariboulite_radio_write_tx_ctrl(radio, tx_power_ctrl, radio->tx_bw, radio->tx_fcut, radio->tx_fs);
     radio->tx_power = tx_power_dbm;
 	
     return 0;
@@ -480,21 +633,13 @@ int cariboulite_radio_get_tx_power(cariboulite_radio_state_st* radio, int *tx_po
 int cariboulite_radio_set_tx_bandwidth(cariboulite_radio_state_st* radio, 
                                  cariboulite_radio_tx_cut_off_en tx_bw)
 {
-    at86rf215_radio_tx_ctrl_st cfg = 
+    if (radio->txn.active)
     {
-        .pa_ramping_time = at86rf215_radio_tx_pa_ramp_16usec,
-        .current_reduction = at86rf215_radio_pa_current_reduction_0ma,  // we can use this to gain some more
-                                                                        // granularity with the tx gain control
-        .tx_power = 18 + radio->tx_power,     // same as before
-        .analog_bw = (at86rf215_radio_tx_cut_off_en)tx_bw,
-        .digital_bw = (at86rf215_radio_f_cut_en)radio->tx_fcut,         // same as before
-        .fs = (at86rf215_radio_sample_rate_en)radio->tx_fs,                   // same as before
-        .direct_modulation = 0,
-    };
-
-    at86rf215_radio_setup_tx_ctrl(&radio->sys->modem, GET_MODEM_CH(radio->type), &cfg);
-    radio->tx_bw = tx_bw;
+        radio->txn.tx_bw = tx_bw;
+        return 0;
+    }
 
+    cariboulite_radio_write_tx_ctrl(radio, 18 + radio->tx_power, tx_bw, radio->tx_fcut, radio->tx_fs);
     return 0;
 }
 
@@ -560,39 +705,15 @@ int cariboulite_radio_set_tx_samp_cutoff(cariboulite_radio_state_st* radio,
                                    cariboulite_radio_sample_rate_en tx_sample_rate,
                                    cariboulite_radio_f_cut_en tx_cutoff)
 {
-    uint8_t sample_gap = 0;
-    at86rf215_radio_tx_ctrl_st cfg = 
-    {
-        .pa_ramping_time = at86rf215_radio_tx_pa_ramp_16usec,
-        .current_reduction = at86rf215_radio_pa_current_reduction_0ma,  // we can use this to gain some more
-                                                                        // granularity with the tx gain control
-        .tx_power = 18 + radio->tx_power,     // same as before
-        .analog_bw = (at86rf215_radio_tx_cut_off_en)radio->tx_bw,            // same as before
-        .digital_bw = (at86rf215_radio_f_cut_en)tx_cutoff,
-        .fs = (at86rf215_radio_sample_rate_en)tx_sample_rate,
-        .direct_modulation = 0,
-    };
-
-    at86rf215_radio_setup_tx_ctrl(&radio->sys->modem, GET_MODEM_CH(radio->type), &cfg);
-    radio->tx_fcut = (cariboulite_radio_f_cut_en)tx_cutoff;
-    radio->tx_fs = tx_sample_rate;
-    
-    
-    // setup the new sample rate in the FPGA
-    switch (tx_sample_rate)
+    if (radio->txn.active)
     {
-        case cariboulite_radio_rx_sample_rate_4000khz: sample_gap = 0; break;
-        case cariboulite_radio_rx_sample_rate_2000khz: sample_gap = 1; break;
-        case cariboulite_radio_rx_sample_rate_1333khz: sample_gap = 2; break;
-        case cariboulite_radio_rx_sample_rate_1000khz: sample_gap = 3; break;
-        case cariboulite_radio_rx_sample_rate_800khz: sample_gap = 4; break;
-        case cariboulite_radio_rx_sample_rate_666khz: sample_gap = 5; break;
-        case cariboulite_radio_rx_sample_rate_500khz: sample_gap = 7; break;
-        case cariboulite_radio_rx_sample_rate_400khz: sample_gap = 9; break;
-        default: sample_gap = 0; break;
+        radio->txn.tx_fs = tx_sample_rate;
+        radio->txn.tx_fcut = tx_cutoff;
+        return 0;
     }
-    
-    caribou_fpga_set_sys_ctrl_tx_sample_gap (&radio->sys->fpga, sample_gap);
+
+    cariboulite_radio_write_tx_ctrl(radio, 18 + radio->tx_power, radio->tx_bw, tx_cutoff, tx_sample_rate);
+    cariboulite_radio_update_tx_sample_gap(radio, tx_sample_rate);
     return 0;
 }
 
@@ -600,7 +721,7 @@ int cariboulite_radio_set_tx_samp_cutoff(cariboulite_radio_state_st* radio,
 int cariboulite_radio_set_tx_samp_cutoff_flt(cariboulite_radio_state_st* radio, float sample_rate_hz)
 {
     cariboulite_radio_sample_rate_en tx_sample_rate = sample_rate_from_flt(sample_rate_hz);
-    cariboulite_radio_f_cut_en tx_cutoff = radio->tx_fcut;
+    cariboulite_radio_f_cut_en tx_cutoff = radio->txn.active ? radio->txn.tx_fcut : radio->tx_fcut;
     return cariboulite_radio_set_tx_samp_cutoff(radio, tx_sample_rate, tx_cutoff);
 }
 
@@ -681,62 +802,293 @@ int cariboulite_radio_get_energy_det(cariboulite_radio_state_st* radio, float *e
     return -1;
 }
 
-//======================================================================
-typedef struct {
-    int bit_count;               /* number of bits of entropy in data */
-    int byte_count;              /* number of bytes of data in array */
-    unsigned char buf[1];
-} entropy_t;
+//=========================================================================
+// Sensor Sampler
+//=========================================================================
+struct cariboulite_sensor_sampler_t
+{
+    cariboulite_radio_state_st* radio;
+    pthread_t thread;
+    pthread_mutex_t mtx;
+    pthread_cond_t cond;                    // CLOCK_MONOTONIC, wakes the thread on stop
+    bool running;
+    uint64_t period_us;
+
+    cariboulite_radio_sensors_st latest;
+    bool has_latest;
+    cariboulite_radio_sensors_st* history;  // ring
+    size_t history_len;
+    size_t history_head;                    // next write
+    size_t history_count;
+
+    // the last valid readings, the thread's own (the radio's are the callers')
+    float rssi_dbm;
+    float energy_dbm;
+};
 
-static int add_entropy(uint8_t byte)
+//=========================================================================
+static uint64_t sensors_time_us(void)
 {
-    int rand_fid = open("/dev/urandom", O_RDWR);
-    if (rand_fid != 0)
-    {
-        // error opening device
-        ZF_LOGE("Opening /dev/urandom device file failed");
-        return -1;
-    }
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000ULL + ts.tv_nsec / 1000;
+}
 
-    entropy_t ent = {
-        .bit_count = 8,
-        .byte_count = 1,
-        .buf = {byte},
-    };
+//=========================================================================
+static void sensors_sample(struct cariboulite_sensor_sampler_t* smp, cariboulite_radio_sensors_st* s)
+{
+    cariboulite_radio_state_st* radio = smp->radio;
 
-    if (ioctl(rand_fid, RNDADDENTROPY, &ent) != 0)
+    // the SPI transactions are all done here, at the sampler's rate - the
+    // modem's status registers are read together in a single batch
+    at86rf215_radio_sensors_st modem = {0};
+    at86rf215_radio_get_sensors(&radio->sys->modem, GET_MODEM_CH(radio->type), &modem);
+
+    // invalid readings keep the previous values - published through the
+    // locked snapshot only
+    if (modem.rssi_dbm >= -127.0 && modem.rssi_dbm <= 4) smp->rssi_dbm = modem.rssi_dbm;
+    if (modem.energy_detection_value >= -127.0 && modem.energy_detection_value <= 4)
     {
-        ZF_LOGE("IOCTL to /dev/urandom device file failed");
+        smp->energy_dbm = modem.energy_detection_value;
     }
+    s->rssi_dbm = smp->rssi_dbm;
+    s->energy_dbm = smp->energy_dbm;
+    s->modem_pll_locked = modem.pll_locked;
 
-    if (close(rand_fid) !=0 )
+    s->lo_pll_locked = false;
+    if (radio->type == cariboulite_channel_hif &&
+        radio->sys->board_info.numeric_product_id == system_type_cariboulite_full)
     {
-        ZF_LOGE("Closing /dev/urandom device file failed");
-        return -1;
+        rffc507x_device_status_st stat = {0};
+        rffc507x_readback_status(&radio->sys->mixer, NULL, &stat);
+        s->lo_pll_locked = stat.pll_lock;
     }
-
-    return 0;
+    s->timestamp_us = sensors_time_us();
 }
 
 //=========================================================================
-int cariboulite_radio_get_rand_val(cariboulite_radio_state_st* radio, uint8_t *rnd)
+static void* sensors_thread_func(void* arg)
 {
-    radio->random_value = at86rf215_radio_get_random_value(&radio->sys->modem, GET_MODEM_CH(radio->type));
-    if (rnd) *rnd = radio->random_value;
+    struct cariboulite_sensor_sampler_t* smp = (struct cariboulite_sensor_sampler_t*)arg;
+    struct timespec next;
+    clock_gettime(CLOCK_MONOTONIC, &next);
 
-	// add the random number to the system entropy. why not :)
-    add_entropy(radio->random_value);
-    return 0;
+    pthread_mutex_lock(&smp->mtx);
+    while (smp->running)
+    {
+        pthread_mutex_unlock(&smp->mtx);
+        cariboulite_radio_sensors_st s = {0};
+        sensors_sample(smp, &s);
+        pthread_mutex_lock(&smp->mtx);
+
+        smp->latest = s;
+        smp->has_latest = true;
+        smp->history[smp->history_head] = s;
+        smp->history_head = (smp->history_head + 1) % smp->history_len;
+        if (smp->history_count < smp->history_len) smp->history_count ++;
+
+        // absolute deadlines - the rate doesn't drift with the SPI time
+        uint64_t ns = (uint64_t)next.tv_nsec + smp->period_us * 1000ULL;
+        next.tv_sec += ns / 1000000000ULL;
+        next.tv_nsec = ns % 1000000000ULL;
+        while (smp->running)
+        {
+            if (pthread_cond_timedwait(&smp->cond, &smp->mtx, &next) == ETIMEDOUT) break;
+        }
+    }
+    pthread_mutex_unlock(&smp->mtx);
+    return NULL;
 }
 
-//=================================================
-// FREQUENCY CONVERSION LOGIC
-//=================================================
+//=========================================================================
+// with the radio's sensor_sampler_mtx held - no reader can be using it
+static void sensors_stop_locked(cariboulite_radio_state_st* radio)
+{
+    struct cariboulite_sensor_sampler_t* smp = radio->sensor_sampler;
+    if (smp == NULL) return;
+
+    pthread_mutex_lock(&smp->mtx);
+    smp->running = false;
+    pthread_cond_signal(&smp->cond);
+    pthread_mutex_unlock(&smp->mtx);
+    pthread_join(smp->thread, NULL);
+
+    radio->sensor_sampler = NULL;
+    pthread_cond_destroy(&smp->cond);
+    pthread_mutex_destroy(&smp->mtx);
+    free(smp->history);
+    free(smp);
+}
 
-//=================================================
-bool cariboulite_radio_wait_mixer_lock(cariboulite_radio_state_st* radio, int retries)
+//=========================================================================
+int cariboulite_radio_start_sensor_sampler(cariboulite_radio_state_st* radio, float rate_hz, size_t history_len)
 {
-	rffc507x_device_status_st stat = {0};
+    if (rate_hz < 0.1f || rate_hz > 1000.0f || history_len == 0)
+    {
+        ZF_LOGE("invalid sensor sampler configuration (rate %.2f Hz, history %lu)", rate_hz, (unsigned long)history_len);
+        return -1;
+    }
+
+    // a running sampler is restarted with the new configuration
+    pthread_mutex_lock(&radio->sensor_sampler_mtx);
+    sensors_stop_locked(radio);
+
+    struct cariboulite_sensor_sampler_t* smp = calloc(1, sizeof(struct cariboulite_sensor_sampler_t));
+    if (smp == NULL)
+    {
+        ZF_LOGE("sensor sampler allocation failed");
+        pthread_mutex_unlock(&radio->sensor_sampler_mtx);
+        return -1;
+    }
+    smp->history = calloc(history_len, sizeof(cariboulite_radio_sensors_st));
+    if (smp->history == NULL)
+    {
+        ZF_LOGE("sensor history allocation failed");
+        free(smp);
+        pthread_mutex_unlock(&radio->sensor_sampler_mtx);
+        return -1;
+    }
+    smp->radio = radio;
+    smp->rssi_dbm = radio->rx_rssi;
+    smp->energy_dbm = radio->rx_energy_detection_value;
+    smp->history_len = history_len;
+    smp->period_us = (uint64_t)(1e6f / rate_hz);
+    smp->running = true;
+
+    pthread_condattr_t cattr;
+    pthread_condattr_init(&cattr);
+    pthread_condattr_setclock(&cattr, CLOCK_MONOTONIC);
+    pthread_cond_init(&smp->cond, &cattr);
+    pthread_condattr_destroy(&cattr);
+    pthread_mutex_init(&smp->mtx, NULL);
+
+    if (pthread_create(&smp->thread, NULL, &sensors_thread_func, smp) != 0)
+    {
+        ZF_LOGE("sensor sampler thread creation failed");
+        pthread_cond_destroy(&smp->cond);
+        pthread_mutex_destroy(&smp->mtx);
+        free(smp->history);
+        free(smp);
+        pthread_mutex_unlock(&radio->sensor_sampler_mtx);
+        return -1;
+    }
+    radio->sensor_sampler = smp;
+    pthread_mutex_unlock(&radio->sensor_sampler_mtx);
+
+    ZF_LOGD("sensor sampler started (%.2f Hz, history %lu)", rate_hz, (unsigned long)history_len);
+    return 0;
+}
+
+//=========================================================================
+int cariboulite_radio_stop_sensor_sampler(cariboulite_radio_state_st* radio)
+{
+    pthread_mutex_lock(&radio->sensor_sampler_mtx);
+    sensors_stop_locked(radio);
+    pthread_mutex_unlock(&radio->sensor_sampler_mtx);
+    return 0;
+}
+
+//=========================================================================
+int cariboulite_radio_get_cached_sensors(cariboulite_radio_state_st* radio, cariboulite_radio_sensors_st* sensors)
+{
+    if (sensors == NULL) return -1;
+
+    bool valid = false;
+    pthread_mutex_lock(&radio->sensor_sampler_mtx);
+    struct cariboulite_sensor_sampler_t* smp = radio->sensor_sampler;
+    if (smp != NULL)
+    {
+        pthread_mutex_lock(&smp->mtx);
+        valid = smp->has_latest;
+        if (valid) *sensors = smp->latest;
+        pthread_mutex_unlock(&smp->mtx);
+    }
+    pthread_mutex_unlock(&radio->sensor_sampler_mtx);
+    return valid ? 0 : -1;
+}
+
+//=========================================================================
+int cariboulite_radio_get_sensors_history(cariboulite_radio_state_st* radio, cariboulite_radio_sensors_st* history, size_t max_len)
+{
+    if (history == NULL) return -1;
+
+    pthread_mutex_lock(&radio->sensor_sampler_mtx);
+    struct cariboulite_sensor_sampler_t* smp = radio->sensor_sampler;
+    if (smp == NULL)
+    {
+        pthread_mutex_unlock(&radio->sensor_sampler_mtx);
+        return -1;
+    }
+
+    pthread_mutex_lock(&smp->mtx);
+    size_t num = (smp->history_count < max_len) ? smp->history_count : max_len;
+    // the newest 'num' readings, oldest first
+    size_t start = (smp->history_head + smp->history_len - num) % smp->history_len;
+    for (size_t i = 0; i < num; i++)
+    {
+        history[i] = smp->history[(start + i) % smp->history_len];
+    }
+    pthread_mutex_unlock(&smp->mtx);
+    pthread_mutex_unlock(&radio->sensor_sampler_mtx);
+    return (int)num;
+}
+
+//======================================================================
+typedef struct {
+    int bit_count;               /* number of bits of entropy in data */
+    int byte_count;              /* number of bytes of data in array */
+    unsigned char buf[1];
+} entropy_t;
+
+static int add_entropy(uint8_t byte)
+{
+    int rand_fid = open("/dev/urandom", O_RDWR);
+    if (rand_fid != 0)
+    {
+        // error opening device
+        ZF_LOGE("Opening /dev/urandom device file failed");
+        return -1;
+    }
+
+    entropy_t ent = {
+        .bit_count = 8,
+        .byte_count = 1,
+        .buf = {byte},
+    };
+
+    if (ioctl(rand_fid, RNDADDENTROPY, &ent) != 0)
+    {
+        ZF_LOGE("IOCTL to /dev/urandom device file failed");
+    }
+
+    if (close(rand_fid) !=0 )
+    {
+        ZF_LOGE("Closing /dev/urandom device file failed");
+        return -1;
+    }
+
+    return 0;
+}
+
+//=========================================================================
+int cariboulite_radio_get_rand_val(cariboulite_radio_state_st* radio, uint8_t *rnd)
+{
+    radio->random_value = at86rf215_radio_get_random_value(&radio->sys->modem, GET_MODEM_CH(radio->type));
+    if (rnd) *rnd = radio->random_value;
+
+	// add the random number to the system entropy. why not :)
+    add_entropy(radio->random_value);
+    return 0;
+}
+
+//=================================================
+// FREQUENCY CONVERSION LOGIC
+//=================================================
+
+//=================================================
+bool cariboulite_radio_wait_mixer_lock(cariboulite_radio_state_st* radio, int timeout_us)
+{
+	rffc507x_device_status_st stat = {0};
 	
 	// applicable only in 6G / FULL version
 	if (radio->sys->board_info.numeric_product_id != system_type_cariboulite_full)
@@ -751,13 +1103,26 @@ bool cariboulite_radio_wait_mixer_lock(cariboulite_radio_state_st* radio, int re
 		return false;
 	}
 
-	int relock_retries = retries;
-	do
+	// the mixer has no lock interrupt - its status is polled, and a relock is
+	// requested only if it didn't lock within a relock period
+	uint64_t start = sensors_time_us();
+	uint64_t deadline = start + timeout_us;
+	uint64_t next_relock = start + CARIBOULITE_MIXER_RELOCK_US;
+	while (1)
 	{
 		rffc507x_readback_status(&radio->sys->mixer, NULL, &stat);
-		rffc507x_print_stat(&stat);
-		if (!stat.pll_lock) rffc507x_relock(&radio->sys->mixer);
-	} while (!stat.pll_lock && relock_retries--);
+		if (stat.pll_lock) break;
+
+		uint64_t now = sensors_time_us();
+		if (now >= deadline) break;
+		if (now >= next_relock)
+		{
+			rffc507x_relock(&radio->sys->mixer);
+			next_relock = now + CARIBOULITE_MIXER_RELOCK_US;
+		}
+		io_utils_usleep(CARIBOULITE_MIXER_LOCK_POLL_US);
+	}
+	rffc507x_print_stat(&stat);
 
 	return stat.pll_lock;
 }
@@ -785,31 +1150,25 @@ int cariboulite_radio_set_modem_state(cariboulite_radio_state_st* radio, caribou
 }
 
 //=================================================
-bool cariboulite_radio_wait_modem_lock(cariboulite_radio_state_st* radio, int retries)
+bool cariboulite_radio_wait_modem_lock(cariboulite_radio_state_st* radio, int timeout_us)
 {
-	at86rf215_radio_pll_ctrl_st cfg = {0};
-	int relock_retries = retries;
-	do
-	{
-		at86rf215_radio_get_pll_ctrl(&radio->sys->modem, GET_MODEM_CH(radio->type), &cfg);
-	} while (!cfg.pll_locked && relock_retries--);
-
-	return cfg.pll_locked;
+	// woken by the modem's TRXRDY interrupt
+	return at86rf215_radio_wait_pll_lock(&radio->sys->modem, GET_MODEM_CH(radio->type), timeout_us);
 }
 
 //=================================================
-bool cariboulite_radio_wait_for_lock( cariboulite_radio_state_st* radio, bool *mod, bool *mix, int retries)
+bool cariboulite_radio_wait_for_lock( cariboulite_radio_state_st* radio, bool *mod, bool *mix, int timeout_us)
 {
 	bool mix_lock = true, mod_lock = true;
 	if (radio->type == cariboulite_channel_hif && mix != NULL)
 	{
-		mix_lock = cariboulite_radio_wait_mixer_lock(radio, retries);
+		mix_lock = cariboulite_radio_wait_mixer_lock(radio, timeout_us);
 		*mix = mix_lock;
 	}
 
 	if (mod != NULL)
 	{
-		mod_lock = cariboulite_radio_wait_modem_lock(radio, retries);
+		mod_lock = cariboulite_radio_wait_modem_lock(radio, timeout_us);
 		if (mod) *mod = mod_lock;
 	}
 
@@ -835,221 +1194,455 @@ cariboulite_ext_ref_freq_en cariboulite_radio_find_best_ref_freq(double f)
 #define FREQ_IN_ISM_24G_RANGE(f)  ((f)>=CARIBOULITE_2G4_MIN&&(f)<=CARIBOULITE_2G4_MAX)
 
 //=========================================================================
-int cariboulite_radio_set_frequency(cariboulite_radio_state_st* radio, 
-									bool break_before_make,
-									double *freq)
+static int cariboulite_radio_calc_frequency_plan(cariboulite_radio_state_st* radio, double f_rf, cariboulite_freq_plan_st* plan)
 {
-    double f_rf = *freq;
-    double modem_act_freq = 0.0;
-    double lo_act_freq = 0.0;
-    double act_freq = 0.0;
-    cariboulite_ext_ref_freq_en ext_ref_choice = cariboulite_radio_find_best_ref_freq(f_rf);
-    cariboulite_conversion_dir_en conversion_direction = conversion_dir_none;
+    uint32_t modem_freq = 0;
+    at86rf215_rf_channel_en req_ch = at86rf215_rf_channel_900mhz;
+
+    memset(plan, 0, sizeof(cariboulite_freq_plan_st));
+    plan->requested_freq = f_rf;
+    plan->conversion_direction = conversion_dir_none;
+    plan->ext_ref = cariboulite_ext_ref_off;
+    plan->rf_path_rx = caribou_fpga_io_ctrl_rfm_bypass;
+    plan->rf_path_tx = caribou_fpga_io_ctrl_rfm_bypass;
 
-    //--------------------------------------------------------------------------------
-    // SUB 1GHZ CONFIGURATION
-    //--------------------------------------------------------------------------------
     if (radio->type == cariboulite_channel_s1g)
     {
-        if (FREQ_IN_ISM_S1G_RANGE(f_rf))
+        if (!FREQ_IN_ISM_S1G_RANGE(f_rf))
         {
-            if (break_before_make) cariboulite_radio_set_modem_state(radio, cariboulite_radio_state_cmd_trx_off);
-
-            modem_act_freq = at86rf215_setup_channel (&radio->sys->modem, 
-                                                    at86rf215_rf_channel_900mhz, 
-                                                    (uint32_t)f_rf);
-
-            radio->if_frequency = 0;
-            radio->lo_pll_locked = 1;
-            radio->if_frequency = modem_act_freq;
-            radio->actual_rf_frequency = radio->if_frequency;
-            radio->requested_rf_frequency = f_rf;
-            radio->rf_frequency_error = radio->actual_rf_frequency - radio->requested_rf_frequency;   
-
-            // return actual frequency
-            *freq = radio->actual_rf_frequency;
+            ZF_LOGE("Unsupported frequency for the ISM S1G channel - %.2f Hz", f_rf);
+            return -1;
         }
-        else
+        plan->modem_ch = at86rf215_rf_channel_900mhz;
+        modem_freq = (uint32_t)f_rf;
+    }
+    else if (radio->type == cariboulite_channel_hif && 
+			 radio->sys->board_info.numeric_product_id == system_type_cariboulite_ism)
+    {
+        if (!FREQ_IN_ISM_24G_RANGE(f_rf))
         {
-            ZF_LOGE("Unsupported frequency for the ISM S1G channel - %.2f Hz, deactivating channel", f_rf);
-            cariboulite_radio_activate_channel(radio, radio->channel_direction, false);
+            ZF_LOGE("Unsupported frequency for the ISM HiF channel - %.2f Hz", f_rf);
             return -1;
         }
+        plan->modem_ch = at86rf215_rf_channel_2400mhz;
+        modem_freq = (uint32_t)f_rf;
     }
-	//--------------------------------------------------------------------------------
-    // ISM 2.4 GHZ CONFIGURATION
-    //--------------------------------------------------------------------------------
-	else if (radio->type == cariboulite_channel_hif && 
-			 radio->sys->board_info.numeric_product_id == system_type_cariboulite_ism)
-	{
-		if (FREQ_IN_ISM_24G_RANGE(f_rf))
+    else if (radio->type == cariboulite_channel_hif && 
+			 radio->sys->board_info.numeric_product_id == system_type_cariboulite_full)
+    {
+        plan->modem_ch = at86rf215_rf_channel_2400mhz;
+        if (f_rf >= CARIBOULITE_6G_MIN && f_rf < CARIBOULITE_2G4_MIN)
         {
-            if (break_before_make) cariboulite_radio_set_modem_state(radio, cariboulite_radio_state_cmd_trx_off);
-            
-            modem_act_freq = at86rf215_setup_channel (&radio->sys->modem, 
-                                                    at86rf215_rf_channel_2400mhz, 
-                                                    (uint32_t)f_rf);
-
-            radio->if_frequency = 0;
-            radio->lo_pll_locked = true;
-            radio->if_frequency = modem_act_freq;
-            radio->actual_rf_frequency = radio->if_frequency;
-            radio->requested_rf_frequency = f_rf;
-            radio->rf_frequency_error = radio->actual_rf_frequency - radio->requested_rf_frequency;   
-
-            // return actual frequency
-            *freq = radio->actual_rf_frequency;
+            // region #1 - UP CONVERSION
+            plan->conversion_direction = conversion_dir_up;
+            modem_freq = CARIBOULITE_2G4_MAX;
+            plan->rf_path_rx = caribou_fpga_io_ctrl_rfm_rx_lowpass;
+            plan->rf_path_tx = caribou_fpga_io_ctrl_rfm_tx_lowpass;
+        }
+        else if (f_rf >= CARIBOULITE_2G4_MIN && f_rf < CARIBOULITE_2G4_MAX)
+        {
+            // region #2 - bypass mode
+            modem_freq = (uint32_t)f_rf;
+        }
+        else if (f_rf >= CARIBOULITE_2G4_MAX && f_rf < CARIBOULITE_6G_MAX)
+        {
+            // region #3 - DOWN-CONVERSION
+            plan->conversion_direction = conversion_dir_down;
+            modem_freq = CARIBOULITE_2G4_MIN;
+            plan->rf_path_rx = caribou_fpga_io_ctrl_rfm_rx_hipass;
+            plan->rf_path_tx = caribou_fpga_io_ctrl_rfm_tx_hipass;
         }
         else
         {
-            ZF_LOGE("Unsupported frequency for the ISM HiF channel - %.2f Hz, deactivating channel", f_rf);
-            cariboulite_radio_activate_channel(radio, radio->channel_direction, false);
+            ZF_LOGE("Unsupported frequency for 6GHz channel - %.2f Hz", f_rf);
             return -1;
         }
-	}
+    }
+    else
+    {
+        ZF_LOGE("Unsupported channel / board combination");
+        return -1;
+    }
+
+    // the modem channel registers
+    if (at86rf215_radio_get_good_channel(modem_freq, &plan->modem_mode, &req_ch) < 0 || req_ch != plan->modem_ch)
+    {
+        ZF_LOGE("the requested modem channel or frequency not supported (%u Hz)", modem_freq);
+        return -1;
+    }
+    plan->modem_freq = (double)(int64_t)at86rf215_radio_get_frequency(plan->modem_mode, 1, modem_freq, 
+                                                                        &plan->modem_center_freq_25khz_res, 
+                                                                        &plan->modem_channel_number);
+
+    // the mixer LO according to the actual modem frequency
+    switch (plan->conversion_direction)
+    {
+        case conversion_dir_up:
+            plan->needs_mixer = true;
+            plan->ext_ref = cariboulite_radio_find_best_ref_freq(f_rf);
+            rffc507x_calc_frequency_plan(plan->ext_ref * 1e6, plan->modem_freq + f_rf, &plan->mixer);
+            plan->lo_freq = plan->mixer.act_freq_hz;
+            plan->actual_freq = plan->lo_freq - plan->modem_freq;
+            break;
+        case conversion_dir_down:
+            plan->needs_mixer = true;
+            plan->ext_ref = cariboulite_radio_find_best_ref_freq(f_rf);
+            rffc507x_calc_frequency_plan(plan->ext_ref * 1e6, f_rf - plan->modem_freq, &plan->mixer);
+            plan->lo_freq = plan->mixer.act_freq_hz;
+            plan->actual_freq = plan->lo_freq + plan->modem_freq;
+            break;
+        case conversion_dir_none:
+        default:
+            plan->lo_freq = 0;
+            plan->actual_freq = plan->modem_freq;
+            break;
+    }
+
+    plan->valid = true;
+    return 0;
+}
+
+//=========================================================================
+static cariboulite_freq_plan_st* cariboulite_radio_get_frequency_plan(cariboulite_radio_state_st* radio, double f_rf,
+                                                                       cariboulite_freq_plan_st* scratch)
+{
+    struct cariboulite_freq_plan_cache_t* cache = radio->freq_plans;
+    if (cache == NULL)
+    {
+        return cariboulite_radio_calc_frequency_plan(radio, f_rf, scratch) == 0 ? scratch : NULL;
+    }
+
+    // fibonacci hashing - the keys are usually round numbers
+    uint64_t key = (uint64_t)llround(f_rf);
+    cariboulite_freq_plan_st* plan = &cache->plans[(key * 11400714819323198485ull) >> (64 - FREQ_PLAN_CACHE_BITS)];
+    if (plan->valid && plan->requested_freq == f_rf)
+    {
+        cache->hits++;
+        return plan;
+    }
+
+    cache->misses++;
+    if (cariboulite_radio_calc_frequency_plan(radio, f_rf, plan) != 0)
+    {
+        plan->valid = false;
+        return NULL;
+    }
+    return plan;
+}
+
+//=========================================================================
+static bool cariboulite_radio_apply_modem_channel(cariboulite_radio_state_st* radio, const cariboulite_freq_plan_st* plan)
+{
+    struct cariboulite_freq_plan_cache_t* cache = radio->freq_plans;
+    if (cache && cache->modem_valid &&
+        cache->modem_mode == plan->modem_mode &&
+        cache->modem_center_freq_25khz_res == plan->modem_center_freq_25khz_res &&
+        cache->modem_channel_number == plan->modem_channel_number)
+    {
+        return false;
+    }
+
+    at86rf215_radio_setup_channel(&radio->sys->modem, plan->modem_ch, 1, 
+                                    plan->modem_center_freq_25khz_res, plan->modem_channel_number, plan->modem_mode);
+    if (cache)
+    {
+        cache->modem_valid = true;
+        cache->modem_mode = plan->modem_mode;
+        cache->modem_center_freq_25khz_res = plan->modem_center_freq_25khz_res;
+        cache->modem_channel_number = plan->modem_channel_number;
+    }
+    return true;
+}
+
+//=========================================================================
+static void cariboulite_radio_apply_rf_path(cariboulite_radio_state_st* radio, caribou_fpga_io_ctrl_rfm_en mode)
+{
+    struct cariboulite_freq_plan_cache_t* cache = radio->freq_plans;
+    if (cache && cache->rf_path_valid && cache->rf_path == mode)
+    {
+        return;
+    }
+
+    caribou_fpga_set_io_ctrl_mode (&radio->sys->fpga, 0, mode);
+    if (cache)
+    {
+        cache->rf_path_valid = true;
+        cache->rf_path = mode;
+    }
+}
+
+//=========================================================================
+// returns true when the mixer was reprogrammed (its PLL has to relock)
+static bool cariboulite_radio_apply_mixer(cariboulite_radio_state_st* radio, const cariboulite_freq_plan_st* plan)
+{
+    struct cariboulite_freq_plan_cache_t* cache = radio->freq_plans;
+    bool ref_changed = !(cache && cache->ext_ref_valid && cache->ext_ref == plan->ext_ref);
+
+    if (ref_changed)
+    {
+        cariboulite_radio_ext_ref (radio->sys, plan->ext_ref);
+        if (cache)
+        {
+            cache->ext_ref_valid = true;
+            cache->ext_ref = plan->ext_ref;
+            cache->mixer_valid = false;
+        }
+    }
+
+    if (!plan->needs_mixer)
+    {
+        return false;
+    }
+
+    // a new (or re-enabled) reference needs the calibration settings and a full reprogramming
+    if (cache == NULL || !cache->mixer_valid)
+    {
+        rffc507x_calibrate(&radio->sys->mixer);
+    }
+    else if (rffc507x_frequency_plan_is_applied(&radio->sys->mixer, &plan->mixer))
+    {
+        return false;
+    }
+
+    rffc507x_apply_frequency_plan(&radio->sys->mixer, &plan->mixer);
+    if (cache) cache->mixer_valid = true;
+    return true;
+}
+
+//=========================================================================
+int cariboulite_radio_prepare_frequency(cariboulite_radio_state_st* radio, double freq)
+{
+    cariboulite_freq_plan_st scratch;
+    return cariboulite_radio_get_frequency_plan(radio, freq, &scratch) == NULL ? -1 : 0;
+}
+
+//=========================================================================
+int cariboulite_radio_invalidate_frequency_plans(cariboulite_radio_state_st* radio, bool hardware_only)
+{
+    struct cariboulite_freq_plan_cache_t* cache = radio->freq_plans;
+    radio->hw_activation_valid = false;
+    if (hardware_only) at86rf215_shadow_invalidate(&radio->sys->modem);
+    if (cache == NULL) return 0;
+
+    cache->modem_valid = false;
+    cache->ext_ref_valid = false;
+    cache->mixer_valid = false;
+    cache->rf_path_valid = false;
+    if (!hardware_only)
+    {
+        memset(cache->plans, 0, sizeof(cache->plans));
+    }
+    return 0;
+}
+
+//=========================================================================
+int cariboulite_radio_get_frequency_plan_stats(cariboulite_radio_state_st* radio, uint32_t *hits, uint32_t *misses)
+{
+    struct cariboulite_freq_plan_cache_t* cache = radio->freq_plans;
+    if (hits) *hits = cache ? cache->hits : 0;
+    if (misses) *misses = cache ? cache->misses : 0;
+    return 0;
+}
+
+//=========================================================================
+// the incremental counterpart of activate_channel for retunes. When the
+// hardware still holds this channel's activation (same direction, outputs
+// and SMI stream) only the modem state is restored - the IQ interface, the
+// FPGA routing and the SMI stream are left running
+static int cariboulite_radio_resume_channel(cariboulite_radio_state_st* radio, bool break_before_make)
+{
+    bool same_activation = radio->hw_activation_valid &&
+                           radio->hw_active == radio->active &&
+                           radio->hw_direction == radio->channel_direction &&
+                           radio->hw_cw_output == radio->cw_output &&
+                           radio->hw_lo_output == radio->lo_output &&
+                           radio->hw_loopback == radio->tx_loopback_anabled;
+
+    // TX is restored in place only if the retune didn't move the modem
+    if (same_activation && radio->active && radio->channel_direction == cariboulite_channel_dir_tx)
+    {
+        same_activation = radio->state == radio->hw_modem_state;
+    }
+
+    if (!same_activation || break_before_make)
+    {
+        radio->retunes_reactivated++;
+        return cariboulite_radio_activate_channel(radio, radio->channel_direction, radio->active);
+    }
+
+    if (!radio->active)
+    {
+        if (radio->state != cariboulite_radio_state_cmd_trx_off)
+        {
+            cariboulite_radio_set_modem_state(radio, cariboulite_radio_state_cmd_trx_off);
+        }
+    }
+    else if (radio->channel_direction == cariboulite_channel_dir_rx && radio->state != cariboulite_radio_state_cmd_rx)
+    {
+        cariboulite_radio_set_modem_state(radio, cariboulite_radio_state_cmd_rx);
+    }
+
+    radio->retunes_in_place++;
+    return 0;
+}
+
+//=========================================================================
+// set_frequency without the hop scheduler check - the scheduler's own retunes
+static int cariboulite_radio_retune(cariboulite_radio_state_st* radio, 
+									bool break_before_make,
+									double *freq)
+{
+    double f_rf = *freq;
+    cariboulite_freq_plan_st scratch;
+    cariboulite_freq_plan_st* plan = NULL;
+
+    if (radio->txn.active)
+    {
+        radio->txn.frequency = f_rf;
+        radio->txn.break_before_make = break_before_make;
+        radio->txn.dirty |= CARIBOULITE_TXN_FREQUENCY;
+        return 0;
+    }
+
+    plan = cariboulite_radio_get_frequency_plan(radio, f_rf, &scratch);
+    if (plan == NULL)
+    {
+        ZF_LOGE("No frequency plan for %.2f Hz, deactivating channel", f_rf);
+        cariboulite_radio_activate_channel(radio, radio->channel_direction, false);
+        return -1;
+    }
+
+    //--------------------------------------------------------------------------------
+    // SUB 1GHZ / ISM 2.4 GHZ CONFIGURATION
+    //--------------------------------------------------------------------------------
+    if (radio->type == cariboulite_channel_s1g ||
+        radio->sys->board_info.numeric_product_id == system_type_cariboulite_ism)
+    {
+        if (break_before_make) cariboulite_radio_set_modem_state(radio, cariboulite_radio_state_cmd_trx_off);
+
+        bool modem_retuned = cariboulite_radio_apply_modem_channel(radio, plan);
+
+        // an active channel relocks in TX_PREP and is then returned to its state
+        if (radio->active && (modem_retuned || break_before_make))
+        {
+            cariboulite_radio_set_modem_state(radio, cariboulite_radio_state_cmd_tx_prep);
+            radio->modem_pll_locked = cariboulite_radio_wait_modem_lock(radio, CARIBOULITE_MODEM_LOCK_TIMEOUT_US);
+            if (!radio->modem_pll_locked)
+            {
+                ZF_LOGE("PLL MODEM failed to lock IF frequency (%.2f Hz), deactivating", plan->modem_freq);
+                cariboulite_radio_invalidate_frequency_plans(radio, true);
+                cariboulite_radio_activate_channel(radio, radio->channel_direction, false);
+                return -1;
+            }
+        }
+
+        radio->lo_pll_locked = true;
+        radio->if_frequency = plan->modem_freq;
+        radio->actual_rf_frequency = radio->if_frequency;
+        radio->requested_rf_frequency = f_rf;
+        radio->rf_frequency_error = radio->actual_rf_frequency - radio->requested_rf_frequency;   
+
+        // return actual frequency
+        *freq = radio->actual_rf_frequency;
+    }
     //--------------------------------------------------------------------------------
     // FULL 30-6GHz CONFIGURATION
     //--------------------------------------------------------------------------------
-    else if (radio->type == cariboulite_channel_hif && 
-			 radio->sys->board_info.numeric_product_id == system_type_cariboulite_full)
-    {		
+    else
+    {
         // Changing the frequency may sometimes need to break RX / TX
         if (break_before_make)
         {
             // make sure that during the transition the modem is not transmitting and then
             // verify that the FE is in low power mode
             cariboulite_radio_set_modem_state(radio, cariboulite_radio_state_cmd_trx_off);
-            caribou_fpga_set_io_ctrl_mode (&radio->sys->fpga, 0, caribou_fpga_io_ctrl_rfm_low_power);
+            cariboulite_radio_apply_rf_path(radio, caribou_fpga_io_ctrl_rfm_low_power);
         }
 
-        // Decide the conversion direction and IF/RF/LO
-        //-------------------------------------
-        if (f_rf >= CARIBOULITE_6G_MIN && 
-            f_rf < (CARIBOULITE_2G4_MIN) )
-        {
-            // Setup the reference frequency as calculated before
-            cariboulite_radio_ext_ref (radio->sys, ext_ref_choice);
-            rffc507x_calibrate(&radio->sys->mixer);
-            
-            // region #1 - UP CONVERSION
-            uint32_t modem_freq = CARIBOULITE_2G4_MAX;
-            modem_act_freq = (double)at86rf215_setup_channel (&radio->sys->modem, 
-																at86rf215_rf_channel_2400mhz, 
-																modem_freq);
-            
-            // setup mixer LO according to the actual modem frequency          
-			//lo_act_freq = rffc507x_set_frequency(&radio->sys->mixer, modem_act_freq - f_rf);
-			//act_freq = modem_act_freq - lo_act_freq;
-            
-            lo_act_freq = rffc507x_set_frequency(&radio->sys->mixer, modem_act_freq + f_rf);
-            act_freq = lo_act_freq - modem_act_freq;
-            
-            // setup fpga RFFE <= upconvert (tx / rx)
-            conversion_direction = conversion_dir_up;
-            caribou_smi_invert_iq(&radio->sys->smi, true);
-        }
-        //-------------------------------------
-        else if ( f_rf >= CARIBOULITE_2G4_MIN && 
-                f_rf < CARIBOULITE_2G4_MAX )
+        // Setup the reference frequency (off in bypass), the modem and the mixer LO.
+        // Only the parts that differ from what the hardware holds are written.
+        // The mixer's (bit-banged) writes are held back and sent in one go after
+        // the modem and FPGA ones, so the SPI lines change function only once
+        io_utils_spi_group_begin(&radio->sys->spi_dev);
+        bool mixer_retuned = cariboulite_radio_apply_mixer(radio, plan);
+        bool modem_retuned = cariboulite_radio_apply_modem_channel(radio, plan);
+        caribou_smi_invert_iq(&radio->sys->smi, true);
+
+        // Setup the frontend
+        // This step takes the current radio direction of communication
+        // and the down/up conversion decision made before to setup the RF front-end
+        if (plan->conversion_direction == conversion_dir_none)
         {
-			cariboulite_radio_ext_ref (radio->sys, cariboulite_ext_ref_off);
-            // region #2 - bypass mode
-            // setup modem frequency <= f_rf
-            modem_act_freq = (double)at86rf215_setup_channel (&radio->sys->modem, 
-                                                        at86rf215_rf_channel_2400mhz, 
-                                                        (uint32_t)f_rf);
-            lo_act_freq = 0;
-            act_freq = modem_act_freq;
-            conversion_direction = conversion_dir_none;
-            caribou_smi_invert_iq(&radio->sys->smi, true);
+            cariboulite_radio_apply_rf_path(radio, caribou_fpga_io_ctrl_rfm_bypass);
         }
-        //-------------------------------------
-        else if ( f_rf >= (CARIBOULITE_2G4_MAX) && 
-                f_rf < CARIBOULITE_6G_MAX )
+        else if (radio->channel_direction == cariboulite_channel_dir_rx)
         {
-            // Setup the reference frequency as calculated before
-            cariboulite_radio_ext_ref (radio->sys, ext_ref_choice);
-            rffc507x_calibrate(&radio->sys->mixer);
-            
-            // region #3 - DOWN-CONVERSION
-            uint32_t modem_freq = CARIBOULITE_2G4_MIN;
-            modem_act_freq = (double)at86rf215_setup_channel (&radio->sys->modem, 
-                                                                at86rf215_rf_channel_2400mhz, 
-                                                                modem_freq);
-
-            // setup mixer LO to according to actual modem frequency
-			lo_act_freq = rffc507x_set_frequency(&radio->sys->mixer, f_rf - modem_act_freq);
-            act_freq = lo_act_freq + modem_act_freq;
-
-            // setup fpga RFFE <= downconvert (tx / rx)
-            conversion_direction = conversion_dir_down;
-            caribou_smi_invert_iq(&radio->sys->smi, true);
+            cariboulite_radio_apply_rf_path(radio, plan->rf_path_rx);
         }
-        //-------------------------------------
-        else
+        else if (radio->channel_direction == cariboulite_channel_dir_tx)
         {
-            ZF_LOGE("Unsupported frequency for 6GHz channel - %.2f Hz, deactivating channel", f_rf);
-            cariboulite_radio_activate_channel(radio, radio->channel_direction, false);
-            return -1;
+            cariboulite_radio_apply_rf_path(radio, plan->rf_path_tx);
         }
 
-        // Setup the frontend
-        // This step takes the current radio direction of communication
-        // and the down/up conversion decision made before to setup the RF front-end
-        switch (conversion_direction)
-        {
-            case conversion_dir_up: 
-                if (radio->channel_direction == cariboulite_channel_dir_rx) 
-                {
-                    caribou_fpga_set_io_ctrl_mode (&radio->sys->fpga, 0, caribou_fpga_io_ctrl_rfm_rx_lowpass);
-                }
-                else if (radio->channel_direction == cariboulite_channel_dir_tx)
-                {
-                    caribou_fpga_set_io_ctrl_mode (&radio->sys->fpga, 0, caribou_fpga_io_ctrl_rfm_tx_lowpass);
-                }
-                break;
-            case conversion_dir_none: 
-                caribou_fpga_set_io_ctrl_mode (&radio->sys->fpga, 0, caribou_fpga_io_ctrl_rfm_bypass);
-                break;
-            case conversion_dir_down:
-                if (radio->channel_direction == cariboulite_channel_dir_rx)
-                {
-                    caribou_fpga_set_io_ctrl_mode (&radio->sys->fpga, 0, caribou_fpga_io_ctrl_rfm_rx_hipass);
-                }
-                else if (radio->channel_direction == cariboulite_channel_dir_tx)
-                {
-                    caribou_fpga_set_io_ctrl_mode (&radio->sys->fpga, 0, caribou_fpga_io_ctrl_rfm_tx_hipass);
-                }
-                break;
-            default: break;
-        }
+        // Make sure the LO and the IF PLLs are locked. The modem leaves its
+        // current state (e.g. RX) only when its own channel was changed
+        bool check_modem = break_before_make || modem_retuned;
+        if (check_modem) cariboulite_radio_set_modem_state(radio, cariboulite_radio_state_cmd_tx_prep);
+        io_utils_spi_group_end(&radio->sys->spi_dev);
 
-        // Make sure the LO and the IF PLLs are locked
-        cariboulite_radio_set_modem_state(radio, cariboulite_radio_state_cmd_tx_prep);
-        if (!cariboulite_radio_wait_for_lock(radio, &radio->modem_pll_locked, 
-                                            lo_act_freq > CARIBOULITE_MIN_LO ? &radio->lo_pll_locked : NULL, 
-                                            100))
+        if (break_before_make || modem_retuned || mixer_retuned)
         {
-            if (!radio->lo_pll_locked) ZF_LOGE("PLL MIXER failed to lock LO frequency (%.2f Hz), deactivating", lo_act_freq);
-            if (!radio->modem_pll_locked) ZF_LOGE("PLL MODEM failed to lock IF frequency (%.2f Hz), deactivating", modem_act_freq);
-            cariboulite_radio_activate_channel(radio, radio->channel_direction, false);
-            return -1;
+            // only the locks waited on here are reported
+            bool check_lo = plan->lo_freq > CARIBOULITE_MIN_LO;
+            if (!cariboulite_radio_wait_for_lock(radio, check_modem ? &radio->modem_pll_locked : NULL, 
+                                                check_lo ? &radio->lo_pll_locked : NULL, 
+                                                CARIBOULITE_PLL_LOCK_TIMEOUT_US))
+            {
+                if (check_lo && !radio->lo_pll_locked) ZF_LOGE("PLL MIXER failed to lock LO frequency (%.2f Hz), deactivating", plan->lo_freq);
+                if (check_modem && !radio->modem_pll_locked) ZF_LOGE("PLL MODEM failed to lock IF frequency (%.2f Hz), deactivating", plan->modem_freq);
+                cariboulite_radio_invalidate_frequency_plans(radio, true);
+                cariboulite_radio_activate_channel(radio, radio->channel_direction, false);
+                return -1;
+            }
         }
 
         // Update the actual frequencies
-        radio->lo_frequency = lo_act_freq;
-        radio->if_frequency = modem_act_freq;
-        radio->actual_rf_frequency = act_freq;
+        radio->lo_frequency = plan->lo_freq;
+        radio->if_frequency = plan->modem_freq;
+        radio->actual_rf_frequency = plan->actual_freq;
         radio->requested_rf_frequency = f_rf;
         radio->rf_frequency_error = radio->actual_rf_frequency - radio->requested_rf_frequency;
-        if (freq) *freq = act_freq;
+        if (freq) *freq = plan->actual_freq;
     }
 
     ZF_LOGD("Frequency setting CH: %d, Wanted: %.2f Hz, Set: %.2f Hz (MOD: %.2f, MIX: %.2f)", 
-                    radio->type, f_rf, act_freq, modem_act_freq, lo_act_freq);
+                    radio->type, f_rf, plan->actual_freq, plan->modem_freq, plan->lo_freq);
     
-    // reactivate the channel if it was active before the frequency change request was issued
-    return cariboulite_radio_activate_channel(radio, radio->channel_direction, radio->active);
+    // bring the channel back to the state it was in before the frequency change request
+    return cariboulite_radio_resume_channel(radio, break_before_make);
+}
+
+//=========================================================================
+static bool cariboulite_radio_is_hopping(cariboulite_radio_state_st* radio)
+{
+    pthread_mutex_lock(&radio->hop_scheduler_mtx);
+    bool hopping = radio->hop_scheduler != NULL;
+    pthread_mutex_unlock(&radio->hop_scheduler_mtx);
+    return hopping;
+}
+
+//=========================================================================
+int cariboulite_radio_set_frequency(cariboulite_radio_state_st* radio, 
+									bool break_before_make,
+									double *freq)
+{
+    // the hop scheduler owns the channel's frequency while it runs
+    if (cariboulite_radio_is_hopping(radio))
+    {
+        ZF_LOGE("channel %d is hopping - stop the hop schedule before setting the frequency", radio->type);
+        return -1;
+    }
+    return cariboulite_radio_retune(radio, break_before_make, freq);
 }
 
 //=========================================================================
@@ -1062,6 +1655,127 @@ int cariboulite_radio_get_frequency(cariboulite_radio_state_st* radio,
     return 0;
 }
 
+//=========================================================================
+int cariboulite_radio_begin(cariboulite_radio_state_st* radio)
+{
+    cariboulite_radio_config_txn_st* txn = &radio->txn;
+    if (txn->active)
+    {
+        ZF_LOGE("a configuration transaction is already open on channel %d", radio->type);
+        return -1;
+    }
+
+    // the scheduler's retunes must reach the hardware, not a transaction
+    if (cariboulite_radio_is_hopping(radio))
+    {
+        ZF_LOGE("channel %d is hopping - stop the hop schedule before configuring it", radio->type);
+        return -1;
+    }
+
+    // start from the current configuration - the setters overwrite what they touch
+    txn->dirty = 0;
+    txn->break_before_make = false;
+    txn->frequency = radio->requested_rf_frequency;
+    txn->rx_agc_on = radio->rx_agc_on;
+    txn->rx_gain_value_db = radio->rx_gain_value_db;
+    txn->rx_bw = radio->rx_bw;
+    txn->rx_fcut = radio->rx_fcut;
+    txn->rx_fs = radio->rx_fs;
+    txn->tx_power = radio->tx_power;
+    txn->tx_bw = radio->tx_bw;
+    txn->tx_fcut = radio->tx_fcut;
+    txn->tx_fs = radio->tx_fs;
+    txn->active = true;
+    return 0;
+}
+
+//=========================================================================
+int cariboulite_radio_commit(cariboulite_radio_state_st* radio)
+{
+    cariboulite_radio_config_txn_st* txn = &radio->txn;
+    if (!txn->active)
+    {
+        ZF_LOGE("no configuration transaction is open on channel %d", radio->type);
+        return -1;
+    }
+    txn->active = false;
+
+    bool agc_changed = txn->rx_agc_on != radio->rx_agc_on ||
+                       txn->rx_gain_value_db != radio->rx_gain_value_db;
+    bool rx_changed = txn->rx_bw != radio->rx_bw ||
+                      txn->rx_fcut != radio->rx_fcut ||
+                      txn->rx_fs != radio->rx_fs;
+    bool rx_fs_changed = txn->rx_fs != radio->rx_fs;
+    bool tx_changed = txn->tx_power != radio->tx_power ||
+                      txn->tx_bw != radio->tx_bw ||
+                      txn->tx_fcut != radio->tx_fcut ||
+                      txn->tx_fs != radio->tx_fs;
+    bool tx_fs_changed = txn->tx_fs != radio->tx_fs;
+    bool retune = (txn->dirty & CARIBOULITE_TXN_FREQUENCY) &&
+                  txn->frequency != radio->requested_rf_frequency;
+
+    ZF_LOGD("commit CH: %d, agc: %d, rx: %d, tx: %d, retune: %d", 
+                    radio->type, agc_changed, rx_changed, tx_changed, retune);
+
+    // each register group is written once with its final value, and the
+    // modem's register writes go out merged into bursts on shadow_end
+    at86rf215_shadow_begin(&radio->sys->modem);
+    if (agc_changed)
+    {
+        cariboulite_radio_write_agc(radio, txn->rx_agc_on, txn->rx_gain_value_db);
+    }
+
+    if (rx_changed)
+    {
+        cariboulite_radio_write_rx_bw_samp(radio, txn->rx_bw, txn->rx_fcut, txn->rx_fs);
+        if (rx_fs_changed) cariboulite_radio_update_smi_sample_rate(radio, txn->rx_fs);
+    }
+
+    if (tx_changed)
+    {
+        int tx_power_dbm = txn->tx_power;
+        int tx_power_ctrl = cariboulite_radio_tx_power_ctrl(radio, &tx_power_dbm);
+        cariboulite_radio_write_tx_ctrl(radio, tx_power_ctrl, txn->tx_bw, txn->tx_fcut, txn->tx_fs);
+        radio->tx_power = tx_power_dbm;
+        if (tx_fs_changed) cariboulite_radio_update_tx_sample_gap(radio, txn->tx_fs);
+    }
+    at86rf215_shadow_end(&radio->sys->modem);
+
+    // the frequency change is the only step that needs a state transition, and
+    // set_frequency reactivates the channel exactly once at its end
+    if (retune)
+    {
+        double freq = txn->frequency;
+        return cariboulite_radio_set_frequency(radio, txn->break_before_make, &freq);
+    }
+    return 0;
+}
+
+//=========================================================================
+int cariboulite_radio_abort(cariboulite_radio_state_st* radio)
+{
+    if (!radio->txn.active)
+    {
+        ZF_LOGE("no configuration transaction is open on channel %d", radio->type);
+        return -1;
+    }
+    radio->txn.active = false;
+    radio->txn.dirty = 0;
+    return 0;
+}
+
+//=========================================================================
+static void cariboulite_radio_store_activation(cariboulite_radio_state_st* radio)
+{
+    radio->hw_activation_valid = true;
+    radio->hw_active = radio->active;
+    radio->hw_direction = radio->channel_direction;
+    radio->hw_cw_output = radio->cw_output;
+    radio->hw_lo_output = radio->lo_output;
+    radio->hw_loopback = radio->tx_loopback_anabled;
+    radio->hw_modem_state = radio->state;
+}
+
 //=========================================================================
 int cariboulite_radio_activate_channel(cariboulite_radio_state_st* radio,
                                         cariboulite_channel_dir_en dir,
@@ -1074,6 +1788,12 @@ int cariboulite_radio_activate_channel(cariboulite_radio_state_st* radio,
 	int cal_i, cal_q;
     ZF_LOGD("Activating channel %d, dir = %s, activate = %d", radio->type, radio->channel_direction==cariboulite_channel_dir_rx?"RX":"TX", activate);
 
+    // the SMI stream and the IQ interface are shared - the other channel's
+    // activation no longer holds once this one touches them
+    radio->hw_activation_valid = false;
+    if (radio != &radio->sys->radio_low) radio->sys->radio_low.hw_activation_valid = false;
+    if (radio != &radio->sys->radio_high) radio->sys->radio_high.hw_activation_valid = false;
+
     // then deactivate the modem's stream
     cariboulite_radio_set_modem_state(radio, cariboulite_radio_state_cmd_trx_off);
     ret = caribou_smi_set_driver_streaming_state(&radio->sys->smi, smi_stream_idle);
@@ -1081,6 +1801,7 @@ int cariboulite_radio_activate_channel(cariboulite_radio_state_st* radio,
     // DEACTIVATION
     if (!activate) 
     {
+        if (ret == 0) cariboulite_radio_store_activation(radio);
         return ret;
     }
     
@@ -1093,7 +1814,7 @@ int cariboulite_radio_activate_channel(cariboulite_radio_state_st* radio,
         at86rf215_radio_get_tx_iq_calibration(&radio->sys->modem, GET_MODEM_CH(radio->type), &cal_i, &cal_q);
 
         ZF_LOGD("Setup Modem state tx_prep");
-        radio->modem_pll_locked = cariboulite_radio_wait_modem_lock(radio, 5);
+        radio->modem_pll_locked = cariboulite_radio_wait_modem_lock(radio, CARIBOULITE_MODEM_LOCK_TIMEOUT_US);
         if (!radio->modem_pll_locked)
         {
             ZF_LOGE("PLL didn't lock");
@@ -1224,6 +1945,7 @@ int cariboulite_radio_activate_channel(cariboulite_radio_state_st* radio,
         }
     }
 
+    cariboulite_radio_store_activation(radio);
     return 0;
 }
 
@@ -1313,3 +2035,409 @@ size_t cariboulite_radio_get_native_mtu_size_samples(cariboulite_radio_state_st*
     //printf("DEBUG: native num samples: %lu\n", num_samples);
     return num_samples;
 }
+
+//=========================================================================
+// Hop Scheduler
+//=========================================================================
+#define HOP_TAGS_MIN_LEN            ( 256 )
+
+struct cariboulite_hop_scheduler_t
+{
+    cariboulite_radio_state_st* radio;
+    pthread_t thread;
+    pthread_mutex_t mtx;
+    pthread_cond_t cond;                        // CLOCK_MONOTONIC, new samples / stop
+    atomic_bool running;                        // polled by the thread without the lock
+    bool finished;                              // a single pass is over
+    int readers;                                // inside read_hop_samples / get_hop_stats
+
+    cariboulite_radio_hop_st* hops;
+    size_t num_hops;
+    bool repeat;
+    size_t settle_samples;
+
+    cariboulite_sample_complex_int16* ring;     // delivered samples
+    size_t ring_len;
+    size_t ring_head;                           // next write
+    size_t ring_count;
+    uint64_t read_index;                        // stream index of the oldest queued sample
+
+    cariboulite_radio_hop_tag_st* tags;         // ring, ordered by sample_index
+    size_t tags_len;
+    size_t tags_head;
+    size_t tags_count;
+
+    cariboulite_radio_hop_stats_st stats;
+    uint64_t start_us;
+};
+
+//=========================================================================
+static void hop_push_samples(struct cariboulite_hop_scheduler_t* h, const cariboulite_sample_complex_int16* samples, size_t num)
+{
+    pthread_mutex_lock(&h->mtx);
+    size_t room = h->ring_len - h->ring_count;
+    if (num > room)
+    {
+        h->stats.samples_overrun += num - room;
+        num = room;
+    }
+
+    size_t first = h->ring_len - h->ring_head;
+    if (first > num) first = num;
+    memcpy(h->ring + h->ring_head, samples, first * sizeof(cariboulite_sample_complex_int16));
+    memcpy(h->ring, samples + first, (num - first) * sizeof(cariboulite_sample_complex_int16));
+    h->ring_head = (h->ring_head + num) % h->ring_len;
+    h->ring_count += num;
+    h->stats.samples_delivered += num;
+
+    if (num) pthread_cond_broadcast(&h->cond);
+    pthread_mutex_unlock(&h->mtx);
+}
+
+//=========================================================================
+static void hop_push_tag(struct cariboulite_hop_scheduler_t* h, cariboulite_radio_hop_tag_st* tag)
+{
+    pthread_mutex_lock(&h->mtx);
+    tag->sample_index = h->read_index + h->ring_count;
+
+    // a reader that lags that far behind has lost samples anyway - the oldest tag goes
+    if (h->tags_count == h->tags_len) h->tags_count--;
+    h->tags[h->tags_head] = *tag;
+    h->tags_head = (h->tags_head + 1) % h->tags_len;
+    h->tags_count++;
+
+    cariboulite_radio_hop_stats_st* st = &h->stats;
+    st->hops++;
+    st->samples_settling += tag->settle_samples;
+    st->retune_us_last = tag->retune_us;
+    if (st->hops == 1 || tag->retune_us < st->retune_us_min) st->retune_us_min = tag->retune_us;
+    if (tag->retune_us > st->retune_us_max) st->retune_us_max = tag->retune_us;
+    st->retune_us_avg += ((float)tag->retune_us - st->retune_us_avg) / (float)st->hops;
+    pthread_mutex_unlock(&h->mtx);
+}
+
+//=========================================================================
+static void* hop_thread_func(void* arg)
+{
+    struct cariboulite_hop_scheduler_t* h = (struct cariboulite_hop_scheduler_t*)arg;
+    cariboulite_radio_state_st* radio = h->radio;
+    size_t mtu = cariboulite_radio_get_native_mtu_size_samples(radio);
+    size_t hop = 0;
+
+    cariboulite_sample_complex_int16* buffer = malloc(mtu * sizeof(cariboulite_sample_complex_int16));
+    if (buffer == NULL)
+    {
+        ZF_LOGE("hop scheduler buffer allocation failed");
+        goto hop_thread_exit;
+    }
+
+    while (atomic_load(&h->running))
+    {
+        cariboulite_radio_hop_st* cur = &h->hops[hop];
+        cariboulite_radio_hop_tag_st tag = {0};
+        double freq = cur->frequency_hz;
+
+        // retune - the plan was staged during the previous dwell
+        uint64_t t0 = sensors_time_us();
+        int res = cariboulite_radio_retune(radio, false, &freq);
+        caribou_smi_flush_fifo(&radio->sys->smi);       // whatever was sampled before / during the retune
+        tag.retune_us = (uint32_t)(sensors_time_us() - t0);
+
+        size_t next = (hop + 1) % h->num_hops;
+        cariboulite_radio_prepare_frequency(radio, h->hops[next].frequency_hz);
+
+        if (res != 0)
+        {
+            ZF_LOGE("hop %lu to %.2f Hz failed", (unsigned long)hop, cur->frequency_hz);
+            pthread_mutex_lock(&h->mtx);
+            h->stats.failed_hops++;
+            pthread_mutex_unlock(&h->mtx);
+
+            // set_frequency deactivates the channel on failure
+            cariboulite_radio_activate_channel(radio, cariboulite_channel_dir_rx, true);
+        }
+        else
+        {
+            // drop the settling samples
+            size_t left = h->settle_samples;
+            while (left && atomic_load(&h->running))
+            {
+                int n = cariboulite_radio_read_samples(radio, buffer, NULL, left > mtu ? mtu : left);
+                if (n < 0) break;
+                left -= n;
+                tag.settle_samples += n;
+            }
+
+            tag.hop_index = (uint32_t)hop;
+            tag.frequency_hz = cur->frequency_hz;
+            tag.actual_frequency_hz = freq;
+            hop_push_tag(h, &tag);
+
+            // dwell
+            left = (size_t)((uint64_t)cur->dwell_us * CARIBOU_SMI_SAMPLE_RATE / 1000000ULL);
+            while (left && atomic_load(&h->running))
+            {
+                int n = cariboulite_radio_read_samples(radio, buffer, NULL, left > mtu ? mtu : left);
+                if (n < 0) break;
+                hop_push_samples(h, buffer, n);
+                left -= n;
+            }
+        }
+
+        pthread_mutex_lock(&h->mtx);
+        h->stats.hop_rate_hz = (float)(1e6 * (double)h->stats.hops / (double)(sensors_time_us() - h->start_us + 1));
+        pthread_mutex_unlock(&h->mtx);
+
+        hop = next;
+        if (hop == 0 && !h->repeat) break;
+    }
+
+hop_thread_exit:
+    free(buffer);
+    pthread_mutex_lock(&h->mtx);
+    h->finished = true;
+    pthread_cond_broadcast(&h->cond);
+    pthread_mutex_unlock(&h->mtx);
+    return NULL;
+}
+
+//=========================================================================
+static void hop_scheduler_free(struct cariboulite_hop_scheduler_t* h)
+{
+    pthread_cond_destroy(&h->cond);
+    pthread_mutex_destroy(&h->mtx);
+    free(h->hops);
+    free(h->ring);
+    free(h->tags);
+    free(h);
+}
+
+//=========================================================================
+int cariboulite_radio_start_hopping(cariboulite_radio_state_st* radio,
+                                    const cariboulite_radio_hop_st* hops,
+                                    size_t num_hops,
+                                    bool repeat,
+                                    uint32_t settle_us,
+                                    size_t buffer_samples)
+{
+    if (hops == NULL || num_hops == 0)
+    {
+        ZF_LOGE("empty hop list");
+        return -1;
+    }
+    if (radio->txn.active)
+    {
+        ZF_LOGE("a configuration transaction is open on channel %d - commit or abort it first", radio->type);
+        return -1;
+    }
+
+    // a running schedule is replaced
+    cariboulite_radio_stop_hopping(radio);
+
+    // stage all the plans - this also validates the list
+    for (size_t i = 0; i < num_hops; i++)
+    {
+        if (cariboulite_radio_prepare_frequency(radio, hops[i].frequency_hz) != 0)
+        {
+            ZF_LOGE("hop %lu: unsupported frequency %.2f Hz", (unsigned long)i, hops[i].frequency_hz);
+            return -1;
+        }
+    }
+
+    if (settle_us == 0) settle_us = CARIBOULITE_HOP_DEFAULT_SETTLE_US;
+    if (buffer_samples == 0) buffer_samples = CARIBOU_SMI_SAMPLE_RATE;
+
+    struct cariboulite_hop_scheduler_t* h = calloc(1, sizeof(struct cariboulite_hop_scheduler_t));
+    if (h == NULL)
+    {
+        ZF_LOGE("hop scheduler allocation failed");
+        return -1;
+    }
+    h->radio = radio;
+    h->num_hops = num_hops;
+    h->repeat = repeat;
+    h->settle_samples = (size_t)((uint64_t)settle_us * CARIBOU_SMI_SAMPLE_RATE / 1000000ULL);
+    h->ring_len = buffer_samples;
+    h->tags_len = num_hops < HOP_TAGS_MIN_LEN ? HOP_TAGS_MIN_LEN : num_hops;
+    h->hops = malloc(num_hops * sizeof(cariboulite_radio_hop_st));
+    h->ring = malloc(buffer_samples * sizeof(cariboulite_sample_complex_int16));
+    h->tags = malloc(h->tags_len * sizeof(cariboulite_radio_hop_tag_st));
+    
+    pthread_condattr_t cattr;
+    pthread_condattr_init(&cattr);
+    pthread_condattr_setclock(&cattr, CLOCK_MONOTONIC);
+    pthread_cond_init(&h->cond, &cattr);
+    pthread_condattr_destroy(&cattr);
+    pthread_mutex_init(&h->mtx, NULL);
+
+    if (h->hops == NULL || h->ring == NULL || h->tags == NULL)
+    {
+        ZF_LOGE("hop scheduler buffers allocation failed");
+        hop_scheduler_free(h);
+        return -1;
+    }
+    memcpy(h->hops, hops, num_hops * sizeof(cariboulite_radio_hop_st));
+
+    // rx on the first hop's frequency, the thread then retunes without leaving rx
+    double freq = hops[0].frequency_hz;
+    radio->channel_direction = cariboulite_channel_dir_rx;
+    radio->active = true;
+    if (cariboulite_radio_set_frequency(radio, true, &freq) != 0)
+    {
+        hop_scheduler_free(h);
+        return -1;
+    }
+
+    atomic_store(&h->running, true);
+    h->start_us = sensors_time_us();
+    if (pthread_create(&h->thread, NULL, &hop_thread_func, h) != 0)
+    {
+        ZF_LOGE("hop scheduler thread creation failed");
+        hop_scheduler_free(h);
+        cariboulite_radio_activate_channel(radio, cariboulite_channel_dir_rx, false);
+        return -1;
+    }
+
+    pthread_mutex_lock(&radio->hop_scheduler_mtx);
+    radio->hop_scheduler = h;
+    pthread_mutex_unlock(&radio->hop_scheduler_mtx);
+    return 0;
+}
+
+//=========================================================================
+// take the running scheduler for a reader - NULL when not hopping. Once the
+// radio's lock is released only stop_hopping's wait keeps "h" alive
+static struct cariboulite_hop_scheduler_t* hop_reader_enter(cariboulite_radio_state_st* radio)
+{
+    pthread_mutex_lock(&radio->hop_scheduler_mtx);
+    struct cariboulite_hop_scheduler_t* h = radio->hop_scheduler;
+    if (h != NULL)
+    {
+        pthread_mutex_lock(&h->mtx);
+        h->readers++;
+    }
+    pthread_mutex_unlock(&radio->hop_scheduler_mtx);
+    return h;
+}
+
+//=========================================================================
+// with h->mtx held (taken by hop_reader_enter)
+static void hop_reader_leave(struct cariboulite_hop_scheduler_t* h)
+{
+    h->readers--;
+    if (h->readers == 0 && !atomic_load(&h->running)) pthread_cond_broadcast(&h->cond);
+    pthread_mutex_unlock(&h->mtx);
+}
+
+//=========================================================================
+int cariboulite_radio_stop_hopping(cariboulite_radio_state_st* radio)
+{
+    // no new reader can find the scheduler after this
+    pthread_mutex_lock(&radio->hop_scheduler_mtx);
+    struct cariboulite_hop_scheduler_t* h = radio->hop_scheduler;
+    radio->hop_scheduler = NULL;
+    pthread_mutex_unlock(&radio->hop_scheduler_mtx);
+    if (h == NULL) return 0;
+
+    // wake the thread and the waiting readers
+    pthread_mutex_lock(&h->mtx);
+    atomic_store(&h->running, false);
+    pthread_cond_broadcast(&h->cond);
+    pthread_mutex_unlock(&h->mtx);
+    pthread_join(h->thread, NULL);
+
+    // the readers still inside leave before the scheduler is freed
+    pthread_mutex_lock(&h->mtx);
+    while (h->readers) pthread_cond_wait(&h->cond, &h->mtx);
+    pthread_mutex_unlock(&h->mtx);
+
+    hop_scheduler_free(h);
+    return cariboulite_radio_activate_channel(radio, cariboulite_channel_dir_rx, false);
+}
+
+//=========================================================================
+int cariboulite_radio_read_hop_samples(cariboulite_radio_state_st* radio,
+                                       cariboulite_sample_complex_int16* buffer,
+                                       size_t length,
+                                       uint64_t* first_index,
+                                       cariboulite_radio_hop_tag_st* tags,
+                                       size_t max_tags,
+                                       size_t* num_tags,
+                                       int timeout_ms)
+{
+    if (num_tags) *num_tags = 0;
+    if (max_tags == 0) tags = NULL;
+
+    struct timespec deadline;
+    clock_gettime(CLOCK_MONOTONIC, &deadline);
+    deadline.tv_sec += timeout_ms / 1000;
+    deadline.tv_nsec += (long)(timeout_ms % 1000) * 1000000L;
+    if (deadline.tv_nsec >= 1000000000L)
+    {
+        deadline.tv_sec++;
+        deadline.tv_nsec -= 1000000000L;
+    }
+
+    struct cariboulite_hop_scheduler_t* h = hop_reader_enter(radio);
+    if (h == NULL) return -1;
+
+    while (h->ring_count == 0 && !h->finished && atomic_load(&h->running))
+    {
+        if (pthread_cond_timedwait(&h->cond, &h->mtx, &deadline) == ETIMEDOUT) break;
+    }
+    if (h->ring_count == 0)
+    {
+        int ret = (h->finished || !atomic_load(&h->running)) ? -1 : 0;
+        hop_reader_leave(h);
+        return ret;
+    }
+
+    size_t n = length < h->ring_count ? length : h->ring_count;
+    uint64_t first = h->read_index;
+
+    // hand over the tags that start within the returned samples
+    size_t t = 0;
+    while (h->tags_count)
+    {
+        size_t oldest = (h->tags_head + h->tags_len - h->tags_count) % h->tags_len;
+        cariboulite_radio_hop_tag_st* tag = &h->tags[oldest];
+        if (tag->sample_index >= first + n) break;
+        if (tags)
+        {
+            if (t == max_tags)
+            {
+                // no room - stop the samples right before this hop
+                n = (size_t)(tag->sample_index - first);
+                break;
+            }
+            tags[t] = *tag;
+        }
+        t++;
+        h->tags_count--;
+    }
+
+    size_t tail = (h->ring_head + h->ring_len - h->ring_count) % h->ring_len;
+    size_t part = h->ring_len - tail;
+    if (part > n) part = n;
+    memcpy(buffer, h->ring + tail, part * sizeof(cariboulite_sample_complex_int16));
+    memcpy(buffer + part, h->ring, (n - part) * sizeof(cariboulite_sample_complex_int16));
+    h->ring_count -= n;
+    h->read_index += n;
+    hop_reader_leave(h);
+
+    if (first_index) *first_index = first;
+    if (num_tags) *num_tags = tags ? t : 0;
+    return (int)n;
+}
+
+//=========================================================================
+int cariboulite_radio_get_hop_stats(cariboulite_radio_state_st* radio, cariboulite_radio_hop_stats_st* stats)
+{
+    if (stats == NULL) return -1;
+    struct cariboulite_hop_scheduler_t* h = hop_reader_enter(radio);
+    if (h == NULL) return -1;
+
+    *stats = h->stats;
+    hop_reader_leave(h);
+    return 0;
+}
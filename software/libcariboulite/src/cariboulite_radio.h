@@ -15,6 +15,7 @@ extern "C" {
 
 #include <stdint.h>
 #include <stdbool.h>
+#include <pthread.h>
 
 /**
  * @brief Radio channel direction
@@ -147,6 +148,82 @@ typedef enum
     conversion_dir_down = 2,
 } cariboulite_conversion_dir_en;
 
+// Cached sensor readings (sensor sampler)
+typedef struct
+{
+    uint64_t                            timestamp_us;       // CLOCK_MONOTONIC
+    float                               rssi_dbm;
+    float                               energy_dbm;
+    bool                                modem_pll_locked;
+    bool                                lo_pll_locked;
+} cariboulite_radio_sensors_st;
+
+struct cariboulite_sensor_sampler_t;
+
+// PLL lock waits [usec] - the modem's are woken by its TRXRDY interrupt, the mixer is polled
+#define CARIBOULITE_MODEM_LOCK_TIMEOUT_US   (1000)
+#define CARIBOULITE_PLL_LOCK_TIMEOUT_US     (10000)
+#define CARIBOULITE_MIXER_LOCK_POLL_US      (20)
+#define CARIBOULITE_MIXER_RELOCK_US         (1000)
+
+// Frequency hopping / sweep scheduler
+#define CARIBOULITE_HOP_DEFAULT_SETTLE_US       (200)
+
+typedef struct
+{
+    double                              frequency_hz;
+    uint32_t                            dwell_us;           // samples delivered per visit (after settling)
+} cariboulite_radio_hop_st;
+
+typedef struct
+{
+    uint64_t                            sample_index;       // the first delivered sample on this frequency
+    uint32_t                            hop_index;          // entry in the hop list
+    double                              frequency_hz;       // requested
+    double                              actual_frequency_hz;
+    uint32_t                            retune_us;          // time spent in set_frequency
+    uint32_t                            settle_samples;     // samples dropped before sample_index
+} cariboulite_radio_hop_tag_st;
+
+typedef struct
+{
+    uint64_t                            hops;               // successful retunes
+    uint64_t                            failed_hops;
+    uint64_t                            samples_delivered;
+    uint64_t                            samples_settling;   // dropped after retunes
+    uint64_t                            samples_overrun;    // dropped because the reader was too slow
+    float                               hop_rate_hz;        // achieved, since the start
+    float                               retune_us_avg;
+    float                               retune_us_min;
+    float                               retune_us_max;
+    float                               retune_us_last;
+} cariboulite_radio_hop_stats_st;
+
+struct cariboulite_hop_scheduler_t;
+struct cariboulite_freq_plan_cache_t;
+
+// Batched configuration (cariboulite_radio_begin / cariboulite_radio_commit)
+#define CARIBOULITE_TXN_FREQUENCY       (1 << 0)
+
+typedef struct
+{
+    bool                                active;
+    uint32_t                            dirty;
+    bool                                break_before_make;
+    double                              frequency;
+
+    bool                                rx_agc_on;
+    int                                 rx_gain_value_db;
+    cariboulite_radio_rx_bw_en          rx_bw;
+    cariboulite_radio_f_cut_en          rx_fcut;
+    cariboulite_radio_sample_rate_en    rx_fs;
+
+    int                                 tx_power;
+    cariboulite_radio_tx_cut_off_en     tx_bw;
+    cariboulite_radio_f_cut_en          tx_fcut;
+    cariboulite_radio_sample_rate_en    tx_fs;
+} cariboulite_radio_config_txn_st;
+
 // Radio Struct
 typedef struct
 {
@@ -188,12 +265,34 @@ typedef struct
     double                              requested_rf_frequency;
     double                              rf_frequency_error;
 
+    struct cariboulite_freq_plan_cache_t* freq_plans;
+
+    // ACTIVATION - as last applied to the hardware by activate_channel
+    bool                                hw_activation_valid;
+    bool                                hw_active;
+    cariboulite_channel_dir_en          hw_direction;
+    bool                                hw_cw_output;
+    bool                                hw_lo_output;
+    bool                                hw_loopback;
+    cariboulite_radio_state_cmd_en      hw_modem_state;
+    uint32_t                            retunes_in_place;       // set_frequency without a reactivation
+    uint32_t                            retunes_reactivated;
+
     // SMI STREAMS
     int                                 smi_channel_id;
 
     // OTHERS
     uint8_t                             random_value;
     float                               rx_thermal_noise_floor;
+
+    // SENSORS
+    struct cariboulite_sensor_sampler_t* sensor_sampler;
+    pthread_mutex_t                     sensor_sampler_mtx;     // the sampler pointer - its start, stop and readers
+    struct cariboulite_hop_scheduler_t* hop_scheduler;
+    pthread_mutex_t                     hop_scheduler_mtx;      // the scheduler pointer - its start, stop and readers
+
+    // BATCHED CONFIGURATION
+    cariboulite_radio_config_txn_st     txn;
 } cariboulite_radio_state_st;
 
 /**
@@ -471,6 +570,50 @@ int cariboulite_radio_get_rssi(cariboulite_radio_state_st* radio, float *rssi_db
  * @return 0 = success, -1 = failure
  */
 int cariboulite_radio_get_energy_det(cariboulite_radio_state_st* radio, float *energy_det_val);
+
+/**
+ * @brief Start the background sensor sampler
+ *
+ * A thread that samples the RSSI, energy detection and PLL lock indications
+ * at a fixed rate and caches them (with timestamps) together with a history
+ * ring, so that sensor polling doesn't issue SPI transactions per read.
+ * Calling it again with a sampler running applies the new rate / history.
+ *
+ * @param radio a pre-allocated radio state structure
+ * @param rate_hz sampling rate (0.1 .. 1000 Hz)
+ * @param history_len the number of readings kept in the history ring (>= 1)
+ * @return 0 = success, -1 = failure
+ */
+int cariboulite_radio_start_sensor_sampler(cariboulite_radio_state_st* radio, float rate_hz, size_t history_len);
+
+/**
+ * @brief Stop the background sensor sampler
+ *
+ * @param radio a pre-allocated radio state structure
+ * @return 0 = success, -1 = failure
+ */
+int cariboulite_radio_stop_sensor_sampler(cariboulite_radio_state_st* radio);
+
+/**
+ * @brief Get the latest cached sensor readings
+ *
+ * @param radio a pre-allocated radio state structure
+ * @param sensors the latest readings
+ * @return 0 = success, -1 = the sampler isn't running or has no reading yet
+ */
+int cariboulite_radio_get_cached_sensors(cariboulite_radio_state_st* radio, cariboulite_radio_sensors_st* sensors);
+
+/**
+ * @brief Get the sensor readings history
+ *
+ * Copies up to max_len readings, oldest first, from the history ring
+ *
+ * @param radio a pre-allocated radio state structure
+ * @param history pre-allocated array of max_len readings
+ * @param max_len the size of history
+ * @return the number of readings copied, -1 = the sampler isn't running
+ */
+int cariboulite_radio_get_sensors_history(cariboulite_radio_state_st* radio, cariboulite_radio_sensors_st* history, size_t max_len);
 /**
  * @brief Modem get a random value
  *
@@ -488,14 +631,15 @@ int cariboulite_radio_get_rand_val(cariboulite_radio_state_st* radio, uint8_t *r
  *
  * In the modem this function waits for a safe completion of frequency switch. Until
  * the modem indicates that the frequency was correctly set, the frequency switch should
- * not be takes as granted.
+ * not be takes as granted. The modem wait returns as soon as its TRXRDY interrupt
+ * reports the lock (polling if the IRQ line isn't available), the mixer is polled.
  *
  * @param radio a pre-allocated radio state structure
- * @param retries number of retries (typically up ot 5)
+ * @param timeout_us the longest wait [usec] (typically CARIBOULITE_MODEM_LOCK_TIMEOUT_US)
  * @return "0" = didn't lock during the period or "1" - locked successfully
  */
-bool cariboulite_radio_wait_modem_lock(cariboulite_radio_state_st* radio, int retries);
-bool cariboulite_radio_wait_mixer_lock(cariboulite_radio_state_st* radio, int retries);
+bool cariboulite_radio_wait_modem_lock(cariboulite_radio_state_st* radio, int timeout_us);
+bool cariboulite_radio_wait_mixer_lock(cariboulite_radio_state_st* radio, int timeout_us);
 
 /**
  * @brief Set modem frequency
@@ -504,7 +648,11 @@ bool cariboulite_radio_wait_mixer_lock(cariboulite_radio_state_st* radio, int re
  * may be slightly different according to the internal PLL granularity
  * and the resulting frequency is written back to the given pointer.
  * The user may set the "break before make" to stich off the activation
- * bit (reset Rx or Tx) and change the frequency in a cold state
+ * bit (reset Rx or Tx) and change the frequency in a cold state.
+ * Without it, an active channel is not reactivated: only the chips whose
+ * settings changed are written and relocked, and an Rx channel keeps its
+ * SMI stream running (the modem returns to Rx after relocking).
+ * It fails while a hopping schedule runs on the channel.
  *
  * @param radio a pre-allocated radio state structure
  * @param break_before_make break the current activity and only then set the frequency
@@ -516,6 +664,46 @@ int cariboulite_radio_set_frequency(cariboulite_radio_state_st* radio,
 									bool break_before_make,
 									double *freq);
 
+/**
+ * @brief Precompute the frequency plan of a frequency
+ *
+ * The plan (modem channel registers, mixer N / fraction / LODIV, reference
+ * choice, FPGA RF-path mode) is computed and stored in the radio's plan cache
+ * without touching the hardware, so that a later set_frequency to the exact
+ * same frequency only writes what differs from the current hardware state.
+ * set_frequency fills the cache by itself, this is for pre-staging hop lists.
+ *
+ * @param radio a pre-allocated radio state structure
+ * @param freq the frequency in Hz
+ * @return 0 = success, -1 = failure (unsupported frequency)
+ */
+int cariboulite_radio_prepare_frequency(cariboulite_radio_state_st* radio, double freq);
+
+/**
+ * @brief Invalidate the frequency plan cache
+ *
+ * Needed when the modem channel, the mixer, the reference or the RF-path were
+ * changed behind the radio API (e.g. by directly using the low level drivers),
+ * so that the next set_frequency writes everything again and fully reactivates
+ * the channel. A hardware_only invalidation also drops the modem's shadow
+ * registers.
+ *
+ * @param radio a pre-allocated radio state structure
+ * @param hardware_only only forget the known hardware state and keep the computed plans
+ * @return 0 = success, -1 = failure
+ */
+int cariboulite_radio_invalidate_frequency_plans(cariboulite_radio_state_st* radio, bool hardware_only);
+
+/**
+ * @brief Frequency plan cache statistics
+ *
+ * @param radio a pre-allocated radio state structure
+ * @param hits number of set_frequency / prepare calls that reused a cached plan (nullable)
+ * @param misses number of plans computed (nullable)
+ * @return 0 = success, -1 = failure
+ */
+int cariboulite_radio_get_frequency_plan_stats(cariboulite_radio_state_st* radio, uint32_t *hits, uint32_t *misses);
+
 /**
  * @brief Get current actual frequency
  *
@@ -531,6 +719,40 @@ int cariboulite_radio_set_frequency(cariboulite_radio_state_st* radio,
 int cariboulite_radio_get_frequency(cariboulite_radio_state_st* radio, 
                                 	double *freq, double *lo, double* i_f);
 
+/**
+ * @brief Open a batched configuration transaction
+ *
+ * Until cariboulite_radio_commit is called, the gain, bandwidth, sample-rate,
+ * tx power and frequency setters only record the requested values (they return
+ * 0 and don't touch the hardware; set_frequency returns the requested frequency).
+ * The commit then applies the resulting configuration at once.
+ *
+ * @param radio a pre-allocated radio state structure
+ * @return 0 = success, -1 = failure (a transaction is already open or the channel is hopping)
+ */
+int cariboulite_radio_begin(cariboulite_radio_state_st* radio);
+
+/**
+ * @brief Apply a batched configuration transaction
+ *
+ * Only the settings that differ from the current state are written: the AGC,
+ * the Rx bandwidth/sampling and the Tx control registers are each written at
+ * most once, and a frequency change performs a single state transition
+ * (the channel is reactivated once, as in cariboulite_radio_set_frequency).
+ *
+ * @param radio a pre-allocated radio state structure
+ * @return 0 = success, -1 = failure
+ */
+int cariboulite_radio_commit(cariboulite_radio_state_st* radio);
+
+/**
+ * @brief Drop a batched configuration transaction without applying it
+ *
+ * @param radio a pre-allocated radio state structure
+ * @return 0 = success, -1 = failure (no open transaction)
+ */
+int cariboulite_radio_abort(cariboulite_radio_state_st* radio);
+
 /**
  * @brief Activate the channel in a certain state
  *
@@ -618,6 +840,82 @@ int cariboulite_radio_write_samples(cariboulite_radio_state_st* radio,
  */
 size_t cariboulite_radio_get_native_mtu_size_samples(cariboulite_radio_state_st* radio);
 
+/**
+ * @brief Start a frequency hopping (or sweep) schedule on an Rx channel
+ *
+ * A dedicated thread retunes the channel through the hop list and reads the
+ * samples itself. The frequency plans are pre-staged (the whole list at start
+ * and the next hop during each dwell). After every retune the SMI FIFO is
+ * flushed and "settle_us" worth of samples is dropped. Then "dwell_us" worth
+ * of samples is queued for cariboulite_radio_read_hop_samples, together with
+ * a tag holding the exact stream index where the new frequency starts.
+ * The channel is activated in Rx and must not be reconfigured while hopping
+ * (cariboulite_radio_set_frequency and cariboulite_radio_begin are rejected
+ * until the schedule is stopped). It fails while a transaction is open.
+ *
+ * @param radio a pre-allocated radio state structure
+ * @param hops the hop list (copied)
+ * @param num_hops number of entries in the hop list
+ * @param repeat loop over the list until stopped (otherwise a single pass)
+ * @param settle_us time dropped after every retune (0 = CARIBOULITE_HOP_DEFAULT_SETTLE_US)
+ * @param buffer_samples capacity of the delivered samples queue (0 = one second)
+ * @return 0 = success, -1 = failure
+ */
+int cariboulite_radio_start_hopping(cariboulite_radio_state_st* radio,
+                                    const cariboulite_radio_hop_st* hops,
+                                    size_t num_hops,
+                                    bool repeat,
+                                    uint32_t settle_us,
+                                    size_t buffer_samples);
+
+/**
+ * @brief Stop the hopping schedule and deactivate the channel
+ *
+ * Readers waiting in cariboulite_radio_read_hop_samples return -1, and the
+ * call returns once they have all left.
+ *
+ * @param radio a pre-allocated radio state structure
+ * @return 0 = success, -1 = failure
+ */
+int cariboulite_radio_stop_hopping(cariboulite_radio_state_st* radio);
+
+/**
+ * @brief Read hopping samples and their frequency tags
+ *
+ * Copies up to "length" samples from the hopping queue (waiting up to
+ * timeout_ms for the first one). Every hop that starts within the returned
+ * samples is reported by a tag, where tag.sample_index - first_index is its
+ * offset in the buffer. When "tags" can't hold all of them, fewer samples are
+ * returned so that no tag is lost.
+ *
+ * @param radio a pre-allocated radio state structure
+ * @param buffer a pre-allocated buffer of native samples
+ * @param length buffer size in samples
+ * @param first_index the stream index of buffer[0] (nullable)
+ * @param tags a pre-allocated tag array (nullable - tags are then discarded)
+ * @param max_tags the size of tags
+ * @param num_tags the number of tags written (nullable)
+ * @param timeout_ms maximal waiting time for samples
+ * @return the number of samples read, 0 = timeout, -1 = not hopping or the single pass is over
+ */
+int cariboulite_radio_read_hop_samples(cariboulite_radio_state_st* radio,
+                                       cariboulite_sample_complex_int16* buffer,
+                                       size_t length,
+                                       uint64_t* first_index,
+                                       cariboulite_radio_hop_tag_st* tags,
+                                       size_t max_tags,
+                                       size_t* num_tags,
+                                       int timeout_ms);
+
+/**
+ * @brief Get the hopping statistics
+ *
+ * @param radio a pre-allocated radio state structure
+ * @param stats the statistics
+ * @return 0 = success, -1 = not hopping
+ */
+int cariboulite_radio_get_hop_stats(cariboulite_radio_state_st* radio, cariboulite_radio_hop_stats_st* stats);
+
 
 #ifdef __cplusplus
 }
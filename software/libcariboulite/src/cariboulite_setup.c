@@ -11,15 +11,48 @@
 #include <errno.h>
 #include <unistd.h>
 #include <dirent.h>
+#include <time.h>
 
 #include "cariboulite_setup.h"
 #include "cariboulite_events.h"
 #include "cariboulite_fpga_firmware.h"
+#include "cariboulite_cal_cache.h"
+#include "cariboulite_init_graph.h"
 
 
 // Global system object for signals
 static sys_st* sigsys = NULL;
 
+// The modem's initial configuration (also a part of the warm attach fingerprint)
+static at86rf215_radio_irq_st modem_int_mask = {
+    .wake_up_por = 1,
+    .trx_ready = 1,
+    .energy_detection_complete = 1,
+    .battery_low = 1,
+    .trx_error = 1,
+    .IQ_if_sync_fail = 1,
+    .res = 0,
+};
+
+static at86rf215_iq_interface_config_st modem_iq_config = {
+    .loopback_enable = 0,
+    .drv_strength = at86rf215_iq_drive_current_4ma,
+    .common_mode_voltage = at86rf215_iq_common_mode_v_ieee1596_1v2,
+    .tx_control_with_iq_if = false,
+    .radio09_mode = at86rf215_iq_if_mode,
+    .radio24_mode = at86rf215_iq_if_mode,
+    .clock_skew = at86rf215_iq_clock_data_skew_4_906ns,
+};
+
+static at86rf215_radio_external_ctrl_st modem_ext_ctrl = {
+    .ext_lna_bypass_available = 0,
+    .agc_backoff = 0,
+    .analog_voltage_external = 0,
+    .analog_voltage_enable_in_off = 1,
+    .int_power_amplifier_voltage = 2,
+    .fe_pad_configuration = 1,
+};
+
 //=================================================================
 static void print_siginfo(siginfo_t *si)
 {
@@ -225,15 +258,18 @@ int cariboulite_setup_io (sys_st* sys)
     // AT86RF215
     io_utils_set_gpio_mode(sys->modem.cs_pin, io_utils_alt_gpio_out);
     io_utils_write_gpio(sys->modem.cs_pin, 1);
+    // a warm attach keeps the chips running - the level is latched before
+    // the pins turn into outputs, so they don't glitch into a reset
+    int chip_reset_level = sys->warm_attached ? 1 : 0;
+    io_utils_write_gpio(sys->modem.reset_pin, chip_reset_level);
     io_utils_set_gpio_mode(sys->modem.reset_pin, io_utils_alt_gpio_out);
-    io_utils_write_gpio(sys->modem.reset_pin, 0);
     io_utils_set_gpio_mode(sys->modem.irq_pin, io_utils_alt_gpio_in);
 
     // RFFC5072
     io_utils_set_gpio_mode(sys->mixer.cs_pin, io_utils_alt_gpio_out);
     io_utils_write_gpio(sys->mixer.cs_pin, 1);
+    io_utils_write_gpio(sys->mixer.reset_pin, chip_reset_level);
     io_utils_set_gpio_mode(sys->mixer.reset_pin, io_utils_alt_gpio_out);
-    io_utils_write_gpio(sys->mixer.reset_pin, 0);
 
     return 0;
 }
@@ -260,7 +296,8 @@ int cariboulite_configure_fpga (sys_st* sys, cariboulite_firmware_source_en src,
 		break;
 
 		case cariboulite_firmware_source_blob:
-			ret = caribou_fpga_program_to_fpga(&sys->fpga, cariboulite_firmware, sizeof(cariboulite_firmware), sys->force_fpga_reprogramming);
+			ret = caribou_fpga_program_to_fpga_compressed(&sys->fpga, cariboulite_firmware, sizeof(cariboulite_firmware),
+												cariboulite_firmware_raw_size, sys->force_fpga_reprogramming);
 		break;
 
 		default:
@@ -274,72 +311,185 @@ int cariboulite_configure_fpga (sys_st* sys, cariboulite_firmware_source_en src,
 }
 
 //=======================================================================================
-int cariboulite_init_submodules (sys_st* sys)
+static uint32_t cariboulite_config_fingerprint(sys_st* sys)
 {
-    int res = 0;
-    ZF_LOGD("initializing submodules");
+    int lib_version[3] = {CARIBOULITE_MAJOR_VERSION, CARIBOULITE_MINOR_VERSION, CARIBOULITE_REVISION};
+    uint32_t h = CARIBOULITE_ATTACH_HASH_SEED;
+    h = cariboulite_attach_hash(h, lib_version, sizeof(lib_version));
+    h = cariboulite_attach_hash(h, &sys->board_info.numeric_serial_number, sizeof(sys->board_info.numeric_serial_number));
+    h = cariboulite_attach_hash(h, &sys->board_info.numeric_product_id, sizeof(sys->board_info.numeric_product_id));
+    h = cariboulite_attach_hash(h, cariboulite_firmware, sizeof(cariboulite_firmware));
+    h = cariboulite_attach_hash(h, &modem_int_mask, sizeof(modem_int_mask));
+    h = cariboulite_attach_hash(h, &modem_iq_config, sizeof(modem_iq_config));
+    h = cariboulite_attach_hash(h, &modem_ext_ctrl, sizeof(modem_ext_ctrl));
+    return h;
+}
 
-    // SMI Init
-    //------------------------------------------------------
+//=======================================================================================
+static void cariboulite_warm_attach_failed(const char* reason)
+{
+    ZF_LOGW("warm attach: %s - initializing the hardware", reason);
+    cariboulite_attach_invalidate();
+}
+
+//=======================================================================================
+// 0 = ready, 1 = ready after falling back from a warm attach, -1 = failed
+static int cariboulite_init_modem(sys_st* sys)
+{
+    int fallback = 0;
+    if (sys->warm_attached)
+    {
+        // the chip kept its configuration and calibration from the previous session
+        sys->modem.cal = sys->attach_state.modem_cal;
+        sys->modem.cal_preset = true;
+        if (at86rf215_init(&sys->modem, &sys->spi_dev) < 0) return -1;
+
+        uint8_t pn = 0, vn = 0;
+        uint8_t sig[AT86RF215_CONFIG_SIG_LEN] = {0};
+        at86rf215_get_versions(&sys->modem, &pn, &vn);
+        at86rf215_get_config_signature(&sys->modem, sig);
+        if (pn == sys->attach_state.modem_pn && vn == sys->attach_state.modem_vn &&
+            memcmp(sig, sys->attach_state.modem_sig, sizeof(sig)) == 0)
+        {
+            return 0;
+        }
+
+        cariboulite_warm_attach_failed("the modem was reset or reconfigured");
+        at86rf215_close(&sys->modem);
+        io_utils_write_gpio(sys->modem.reset_pin, 0);
+        fallback = 1;
+    }
+
+    sys->modem.cal_preset = !sys->force_modem_calibration &&
+            cariboulite_cal_cache_lookup(sys->board_info.numeric_serial_number,
+                                         sys->modem_cal_temp_band,
+                                         &sys->modem.cal) == 0;
+    if (at86rf215_init(&sys->modem, &sys->spi_dev) < 0) return -1;
+    if (!sys->modem.cal_preset)
+    {
+        cariboulite_cal_cache_store(sys->board_info.numeric_serial_number, sys->modem_cal_temp_band, &sys->modem.cal);
+    }
+    return fallback;
+}
+
+//=======================================================================================
+// same return values as cariboulite_init_modem
+static int cariboulite_init_mixer(sys_st* sys)
+{
+    if (sys->warm_attached)
+    {
+        if (rffc507x_attach(&sys->mixer, &sys->spi_dev) < 0) return -1;
+
+        rffc507x_device_id_st dev_id = {0};
+        rffc507x_readback_status(&sys->mixer, &dev_id, NULL);
+        if (dev_id.device_id == sys->attach_state.mixer_id) return 0;
+
+        cariboulite_warm_attach_failed("the mixer doesn't match the previous session");
+        rffc507x_release(&sys->mixer);
+        return rffc507x_init(&sys->mixer, &sys->spi_dev) < 0 ? -1 : 1;
+    }
+    return rffc507x_init(&sys->mixer, &sys->spi_dev);
+}
+
+//=======================================================================================
+static void cariboulite_store_attach_state(sys_st* sys)
+{
+    cariboulite_attach_state_st* st = &sys->attach_state;
+    memset(st, 0, sizeof(cariboulite_attach_state_st));
+
+    st->magic = CARIBOULITE_ATTACH_MAGIC;
+    st->fingerprint = cariboulite_config_fingerprint(sys);
+    st->fpga_versions = sys->fpga.versions;
+    at86rf215_get_versions(&sys->modem, &st->modem_pn, &st->modem_vn);
+    at86rf215_get_config_signature(&sys->modem, st->modem_sig);
+    st->modem_cal = sys->modem.cal;
+    if (sys->board_info.numeric_product_id == system_type_cariboulite_full)
+    {
+        rffc507x_device_id_st dev_id = {0};
+        rffc507x_readback_status(&sys->mixer, &dev_id, NULL);
+        st->mixer_id = dev_id.device_id;
+    }
+    cariboulite_attach_store(st);
+}
+
+//=======================================================================================
+static double cariboulite_time_ms(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e3 + ts.tv_nsec / 1e6;
+}
+
+//=======================================================================================
+static int cariboulite_init_stage_smi(sys_st* sys)
+{
     ZF_LOGD("INIT FPGA SMI communication");
-    res = caribou_smi_init(&sys->smi, &sys);
-    if (res < 0)
+    if (caribou_smi_init(&sys->smi, sys) < 0)
     {
         ZF_LOGE("Error setting up smi submodule");
-        goto cariboulite_init_submodules_fail;
+        return -1;
     }
+    return 0;
+}
 
-    // AT86RF215
-    //------------------------------------------------------
+//=======================================================================================
+static int cariboulite_init_stage_modem(sys_st* sys)
+{
     ZF_LOGD("INIT MODEM - AT86RF215");
-    res = at86rf215_init(&sys->modem, &sys->spi_dev);
+    sys->modem_cal_temp_band = cariboulite_cal_cache_temp_band();
+    int res = cariboulite_init_modem(sys);
     if (res < 0)
     {
         ZF_LOGE("Error initializing modem 'at86rf215'");
-        goto cariboulite_init_submodules_fail;
     }
+    return res;
+}
 
-    // Configure modem
-    //------------------------------------------------------
+//=======================================================================================
+static int cariboulite_init_stage_modem_config(sys_st* sys)
+{
     ZF_LOGD("Configuring modem initial state");
     at86rf215_setup_rf_irq(&sys->modem,  0, 1, at86rf215_drive_current_2ma);
     at86rf215_radio_set_state(&sys->modem, at86rf215_rf_channel_900mhz, at86rf215_radio_state_cmd_trx_off);
     at86rf215_radio_set_state(&sys->modem, at86rf215_rf_channel_2400mhz, at86rf215_radio_state_cmd_trx_off);
 
-    at86rf215_radio_irq_st int_mask = {
-        .wake_up_por = 1,
-        .trx_ready = 1,
-        .energy_detection_complete = 1,
-        .battery_low = 1,
-        .trx_error = 1,
-        .IQ_if_sync_fail = 1,
-        .res = 0,
-    };
-    at86rf215_radio_setup_interrupt_mask(&sys->modem, at86rf215_rf_channel_900mhz, &int_mask);
-    at86rf215_radio_setup_interrupt_mask(&sys->modem, at86rf215_rf_channel_2400mhz, &int_mask);
-
-    at86rf215_iq_interface_config_st modem_iq_config = {
-        .loopback_enable = 0,
-        .drv_strength = at86rf215_iq_drive_current_4ma,
-        .common_mode_voltage = at86rf215_iq_common_mode_v_ieee1596_1v2,
-        .tx_control_with_iq_if = false,
-        .radio09_mode = at86rf215_iq_if_mode,
-        .radio24_mode = at86rf215_iq_if_mode,
-        .clock_skew = at86rf215_iq_clock_data_skew_4_906ns,
-    };
+    at86rf215_radio_setup_interrupt_mask(&sys->modem, at86rf215_rf_channel_900mhz, &modem_int_mask);
+    at86rf215_radio_setup_interrupt_mask(&sys->modem, at86rf215_rf_channel_2400mhz, &modem_int_mask);
     at86rf215_setup_iq_if(&sys->modem, &modem_iq_config);
+    at86rf215_radio_setup_external_settings(&sys->modem, at86rf215_rf_channel_900mhz, &modem_ext_ctrl);
+    at86rf215_radio_setup_external_settings(&sys->modem, at86rf215_rf_channel_2400mhz, &modem_ext_ctrl);
+    return 0;
+}
 
-    at86rf215_radio_external_ctrl_st ext_ctrl = {
-        .ext_lna_bypass_available = 0,
-        .agc_backoff = 0,
-        .analog_voltage_external = 0,
-        .analog_voltage_enable_in_off = 1,
-        .int_power_amplifier_voltage = 2,
-        .fe_pad_configuration = 1,   
-    };
-    at86rf215_radio_setup_external_settings(&sys->modem, at86rf215_rf_channel_900mhz, &ext_ctrl);
-    at86rf215_radio_setup_external_settings(&sys->modem, at86rf215_rf_channel_2400mhz, &ext_ctrl);
+//=======================================================================================
+static int cariboulite_init_stage_mixer(sys_st* sys)
+{
+	// The mixer - only relevant to the full version
+	if (sys->board_info.numeric_product_id != system_type_cariboulite_full)
+	{
+		return 0;
+	}
+
+	// RFFC5072
+	//------------------------------------------------------
+	ZF_LOGD("INIT MIXER - RFFC5072");
+	int res = cariboulite_init_mixer(sys);
+	if (res < 0)
+	{
+		ZF_LOGE("Error initializing mixer 'rffc5072'");
+		return -1;
+	}
+
+	// Configure mixer
+	//------------------------------------------------------
+	//rffc507x_setup_reference_freq(&sys->mixer, 26e6);
+	rffc507x_calibrate(&sys->mixer);
+	return res;
+}
 
+//=======================================================================================
+static int cariboulite_init_stage_ext_ref(sys_st* sys)
+{
 	switch (sys->board_info.numeric_product_id)
 	{
 		//---------------------------------------------------
@@ -364,26 +514,12 @@ int cariboulite_init_submodules (sys_st* sys)
 			ZF_LOGE("Unknown board type - we sheuldn't get here");
 			break;
 	}
+	return 0;
+}
 
-	// The mixer - only relevant to the full version
-	if (sys->board_info.numeric_product_id == system_type_cariboulite_full)
-	{
-		// RFFC5072
-		//------------------------------------------------------
-		ZF_LOGD("INIT MIXER - RFFC5072");
-		res = rffc507x_init(&sys->mixer, &sys->spi_dev);
-		if (res < 0)
-		{
-			ZF_LOGE("Error initializing mixer 'rffc5072'");
-			goto cariboulite_init_submodules_fail;
-		}
-
-		// Configure mixer
-		//------------------------------------------------------
-		//rffc507x_setup_reference_freq(&sys->mixer, 26e6);
-		rffc507x_calibrate(&sys->mixer);
-	}
-
+//=======================================================================================
+static int cariboulite_init_stage_radios(sys_st* sys)
+{
 	// Print the SPI information
 	//io_utils_spi_print_setup(&sys->spi_dev);
 	
@@ -405,6 +541,54 @@ int cariboulite_init_submodules (sys_st* sys)
 	cariboulite_radio_activate_channel(&sys->radio_high, cariboulite_channel_dir_rx, false);
 	cariboulite_radio_sync_information(&sys->radio_low);
 	cariboulite_radio_sync_information(&sys->radio_high);
+	return 0;
+}
+
+// Stage indices - the modem and the mixer don't share anything but the SPI
+// bus, so the mixer's reset wait and programming overlap the modem's TXPREP
+// calibration, and the SMI device is set up meanwhile. The mixer's reference
+// (the modem's clock output) is only set once both are up.
+enum
+{
+    init_stage_smi = 0,
+    init_stage_modem,
+    init_stage_modem_config,
+    init_stage_mixer,
+    init_stage_ext_ref,
+    init_stage_radios,
+    init_stage_count,
+};
+
+//=======================================================================================
+int cariboulite_init_submodules (sys_st* sys)
+{
+    ZF_LOGD("initializing submodules");
+
+    cariboulite_init_stage_st stages[init_stage_count] = {
+        [init_stage_smi] =          { .name = "smi", .run = cariboulite_init_stage_smi, .deps = 0 },
+        [init_stage_modem] =        { .name = "modem", .run = cariboulite_init_stage_modem, .deps = 0 },
+        [init_stage_modem_config] = { .name = "modem_config", .run = cariboulite_init_stage_modem_config,
+                                      .deps = CARIBOULITE_INIT_DEP(init_stage_modem) },
+        [init_stage_mixer] =        { .name = "mixer", .run = cariboulite_init_stage_mixer, .deps = 0 },
+        [init_stage_ext_ref] =      { .name = "ext_ref", .run = cariboulite_init_stage_ext_ref,
+                                      .deps = CARIBOULITE_INIT_DEP(init_stage_modem_config) | CARIBOULITE_INIT_DEP(init_stage_mixer) },
+        [init_stage_radios] =       { .name = "radios", .run = cariboulite_init_stage_radios,
+                                      .deps = CARIBOULITE_INIT_DEP(init_stage_smi) | CARIBOULITE_INIT_DEP(init_stage_ext_ref) },
+    };
+
+    int res = cariboulite_init_graph_run(sys, stages, init_stage_count);
+    cariboulite_init_graph_report(stages, init_stage_count);
+
+    // a chip that didn't match the previous session was initialized from scratch
+    if (stages[init_stage_modem].result > 0 || stages[init_stage_mixer].result > 0)
+    {
+        sys->warm_attached = false;
+    }
+
+    if (res < 0)
+    {
+        goto cariboulite_init_submodules_fail;
+    }
 
     ZF_LOGD("Cariboulite submodules successfully initialized");
     return 0;
@@ -443,6 +627,16 @@ int cariboulite_release_submodules(sys_st* sys)
 		ZF_LOGD("CLOSE MODEM - AT86RF215");
 		at86rf215_stop_iq_radio_receive (&sys->modem, at86rf215_rf_channel_900mhz);
 		at86rf215_stop_iq_radio_receive (&sys->modem, at86rf215_rf_channel_2400mhz);
+		if (sys->modem.cal_updated)
+		{
+			// drifted since it was cached - keep the revalidated values
+			cariboulite_cal_cache_store(sys->board_info.numeric_serial_number, sys->modem_cal_temp_band, &sys->modem.cal);
+			if (sys->attach_state.magic == CARIBOULITE_ATTACH_MAGIC)
+			{
+				sys->attach_state.modem_cal = sys->modem.cal;
+				cariboulite_attach_store(&sys->attach_state);
+			}
+		}
 		at86rf215_close(&sys->modem);
 
 		//------------------------------------------------------
@@ -612,6 +806,23 @@ int cariboulite_init_driver_minimal(sys_st *sys, hat_board_info_st *info, bool p
 	}
 	sys->sys_type = (system_type_en)sys->board_info.numeric_product_id;
 
+    // WARM ATTACH - adopt the hardware state of the previous session if its
+    // record matches this library, board, firmware and configuration
+    // --------------------------------------------------------------------
+    sys->warm_attached = false;
+    memset(&sys->attach_state, 0, sizeof(sys->attach_state));
+    if (sys->warm_attach && !production && !sys->force_fpga_reprogramming && !sys->force_modem_calibration)
+    {
+        sys->warm_attached = cariboulite_attach_load(&sys->attach_state) == 0 &&
+                             sys->attach_state.fingerprint == cariboulite_config_fingerprint(sys);
+        if (!sys->warm_attached) ZF_LOGD("warm attach: no matching record of a previous session");
+    }
+    if (!sys->warm_attached)
+    {
+        // the chips are reset below - the record no longer holds
+        cariboulite_attach_invalidate();
+    }
+
     // CONFIGURE I/O
     // --------------------------------------------------------------------
 	if (cariboulite_setup_io(sys) != 0)
@@ -640,6 +851,13 @@ int cariboulite_init_driver_minimal(sys_st *sys, hat_board_info_st *info, bool p
     {
 		//caribou_fpga_soft_reset(&sys->fpga);
     }
+	if (sys->warm_attached && memcmp(&sys->fpga.versions, &sys->attach_state.fpga_versions, sizeof(caribou_fpga_versions_st)) != 0)
+	{
+		cariboulite_warm_attach_failed("the FPGA versions don't match the previous session");
+		sys->warm_attached = false;
+		io_utils_write_gpio(sys->modem.reset_pin, 0);
+		io_utils_write_gpio(sys->mixer.reset_pin, 0);
+	}
 
 	// Reading the configuration from the FPGA (resistor set)
 	int led0 = 0, led1 = 0, btn = 0, cfg = 0;
@@ -688,6 +906,7 @@ void cariboulite_set_log_level(cariboulite_log_level_en lvl)
 //=================================================
 int cariboulite_init_driver(sys_st *sys, hat_board_info_st *info)
 {
+	double start_ms = cariboulite_time_ms();
 	int ret = cariboulite_init_driver_minimal(sys, info, false);
 	if (ret < 0)
 	{
@@ -719,6 +938,13 @@ int cariboulite_init_driver(sys_st *sys, hat_board_info_st *info)
 
 	sys->system_status = sys_status_full_init;
 
+	// a warm attach keeps the record of the session that configured the hardware
+	if (!sys->warm_attached)
+	{
+		cariboulite_store_attach_state(sys);
+	}
+	ZF_LOGI("driver initialized (%s) in %.1f ms", sys->warm_attached ? "warm attach" : "cold", cariboulite_time_ms() - start_ms);
+
     return cariboulite_ok;
 }
 
@@ -174,6 +174,7 @@ int cariboulite_setup_signal_handler (sys_st *sys,
  *            the binary file is stored inside an array named "cariboulite_fpga_firmware"
  *            which is automatically generated after FPGA binary is created. This
  *            buffer is located inside a file named "cariboulite_fpga_firmware.h"
+ *            and is compressed ('generate_bin_blob -z') - it's decompressed as it's sent
  * @param fpga_bin_path the path of the binary file - only applicable if
  *                      "cariboulite_firmware_source_file" was chosen as the "src". otherwise
  *                      NULL should be passed here.
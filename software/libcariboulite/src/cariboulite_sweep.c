@@ -0,0 +1,403 @@
+#ifndef ZF_LOG_LEVEL
+    #define ZF_LOG_LEVEL ZF_LOG_VERBOSE
+#endif
+#define ZF_LOG_DEF_SRCLOC ZF_LOG_SRCLOC_LONG
+#define ZF_LOG_TAG "CARIBOULITE Sweep"
+#include "zf_log/zf_log.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+
+#include "cariboulite_internal.h"
+#include "cariboulite_radio.h"
+#include "cariboulite_sweep.h"
+
+#define SWEEP_READ_CHUNK            ( 16384 )
+#define SWEEP_READ_TAGS             ( 64 )
+#define SWEEP_READ_TIMEOUT_MS       ( 100 )
+#define SWEEP_SAMPLE_SCALE          ( 1.0f / 4096.0f )      // 13 bit samples => [-1 .. 1)
+
+/*
+ * A radix-2 complex FFT over planar (split re / im) float arrays.
+ * The input is scattered in bit-reversed order while it is windowed, then
+ * every stage runs its butterflies over contiguous runs of "half" samples
+ * with the stage's twiddles stored contiguously as well. The inner loop is
+ * therefore a plain unit-stride float loop that the compiler vectorizes
+ * (NEON on the RPI) without an external FFT library.
+ */
+typedef struct
+{
+    uint32_t n;
+    uint32_t* bitrev;
+    float* tw_re;               // stage with "half" butterflies at [half - 1 .. 2 * half - 2]
+    float* tw_im;
+    float* window;              // Hann
+    float* re;
+    float* im;
+    float* power;               // |X|^2 accumulated over the step's FFTs, natural order
+    float* bins_db;             // the usable bins of the current step
+    float norm;                 // 1 / (sum(window))^2 - a full scale tone reads 0 dBFS
+} sweep_fft_st;
+
+//=========================================================================
+static uint64_t sweep_time_us(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000ULL + (uint64_t)(ts.tv_nsec / 1000);
+}
+
+//=========================================================================
+static void sweep_fft_free(sweep_fft_st* f)
+{
+    free(f->bitrev);
+    free(f->tw_re);
+    free(f->tw_im);
+    free(f->window);
+    free(f->re);
+    free(f->im);
+    free(f->power);
+    free(f->bins_db);
+    memset(f, 0, sizeof(sweep_fft_st));
+}
+
+//=========================================================================
+static int sweep_fft_init(sweep_fft_st* f, uint32_t n)
+{
+    memset(f, 0, sizeof(sweep_fft_st));
+    f->n = n;
+    f->bitrev = malloc(n * sizeof(uint32_t));
+    f->tw_re = malloc(n * sizeof(float));
+    f->tw_im = malloc(n * sizeof(float));
+    f->window = malloc(n * sizeof(float));
+    f->re = malloc(n * sizeof(float));
+    f->im = malloc(n * sizeof(float));
+    f->power = malloc(n * sizeof(float));
+    f->bins_db = malloc(n * sizeof(float));
+    if (!f->bitrev || !f->tw_re || !f->tw_im || !f->window || !f->re || !f->im || !f->power || !f->bins_db)
+    {
+        ZF_LOGE("sweep fft allocation failed");
+        sweep_fft_free(f);
+        return -1;
+    }
+
+    uint32_t log2n = 0;
+    while ((1U << log2n) < n) log2n++;
+    for (uint32_t i = 0; i < n; i++)
+    {
+        uint32_t r = 0;
+        for (uint32_t b = 0; b < log2n; b++) if (i & (1U << b)) r |= 1U << (log2n - 1 - b);
+        f->bitrev[i] = r;
+    }
+
+    for (uint32_t half = 1; half < n; half <<= 1)
+    {
+        for (uint32_t j = 0; j < half; j++)
+        {
+            double a = -M_PI * (double)j / (double)half;
+            f->tw_re[half - 1 + j] = (float)cos(a);
+            f->tw_im[half - 1 + j] = (float)sin(a);
+        }
+    }
+
+    double sum = 0.0;
+    for (uint32_t i = 0; i < n; i++)
+    {
+        f->window[i] = (float)(0.5 - 0.5 * cos(2.0 * M_PI * (double)i / (double)n));
+        sum += f->window[i];
+    }
+    f->norm = (float)(1.0 / (sum * sum));
+    return 0;
+}
+
+//=========================================================================
+static void sweep_fft_power(sweep_fft_st* f, const cariboulite_sample_complex_int16* x)
+{
+    const uint32_t n = f->n;
+    float* restrict re = f->re;
+    float* restrict im = f->im;
+    const float* restrict w = f->window;
+
+    for (uint32_t i = 0; i < n; i++)
+    {
+        uint32_t r = f->bitrev[i];
+        re[r] = (float)x[i].i * w[i];
+        im[r] = (float)x[i].q * w[i];
+    }
+
+    for (uint32_t half = 1; half < n; half <<= 1)
+    {
+        const float* restrict wr = f->tw_re + half - 1;
+        const float* restrict wi = f->tw_im + half - 1;
+        for (uint32_t k = 0; k < n; k += 2 * half)
+        {
+            float* restrict ar = re + k;
+            float* restrict ai = im + k;
+            float* restrict br = re + k + half;
+            float* restrict bi = im + k + half;
+            for (uint32_t j = 0; j < half; j++)
+            {
+                float tr = br[j] * wr[j] - bi[j] * wi[j];
+                float ti = br[j] * wi[j] + bi[j] * wr[j];
+                br[j] = ar[j] - tr;
+                bi[j] = ai[j] - ti;
+                ar[j] += tr;
+                ai[j] += ti;
+            }
+        }
+    }
+
+    float* restrict p = f->power;
+    for (uint32_t i = 0; i < n; i++)
+    {
+        p[i] += re[i] * re[i] + im[i] * im[i];
+    }
+}
+
+//=========================================================================
+// the usable bins around DC, fft-shifted into ascending frequency order
+static void sweep_fft_usable_bins(sweep_fft_st* f, uint32_t usable, uint32_t num_ffts, uint32_t dc_notch)
+{
+    const uint32_t n = f->n;
+    float scale = f->norm * SWEEP_SAMPLE_SCALE * SWEEP_SAMPLE_SCALE / (float)num_ffts;
+    uint32_t first = n - usable / 2;            // the most negative usable bin
+
+    for (uint32_t i = 0; i < usable; i++)
+    {
+        float p = f->power[(first + i) & (n - 1)] * scale;
+        f->bins_db[i] = 10.0f * log10f(p + 1e-20f);
+    }
+
+    // the LO leakage / DC offset spike
+    if (dc_notch && usable > 2 * dc_notch + 2)
+    {
+        uint32_t dc = usable / 2;
+        float lo = f->bins_db[dc - dc_notch - 1];
+        float hi = f->bins_db[dc + dc_notch + 1];
+        for (uint32_t i = dc - dc_notch; i <= dc + dc_notch; i++)
+        {
+            f->bins_db[i] = lo + (hi - lo) * (float)(i - (dc - dc_notch - 1)) / (float)(2 * dc_notch + 2);
+        }
+    }
+}
+
+//=========================================================================
+void cariboulite_sweep_default_config(cariboulite_radio_state_st* radio, cariboulite_sweep_config_st* config)
+{
+    if (config == NULL) return;
+    config->freq_min_hz = CARIBOULITE_6G_MIN;
+    config->freq_max_hz = CARIBOULITE_6G_MAX;
+    if (radio != NULL && radio->type == cariboulite_channel_s1g)
+    {
+        // a sweep covers one contiguous range - the wider of the two sub-GHz bands
+        config->freq_min_hz = CARIBOULITE_S1G_MIN2;
+        config->freq_max_hz = CARIBOULITE_S1G_MAX2;
+    }
+    else if (radio != NULL && radio->sys->board_info.numeric_product_id == system_type_cariboulite_ism)
+    {
+        config->freq_min_hz = CARIBOULITE_2G4_MIN;
+        config->freq_max_hz = CARIBOULITE_2G4_MAX;
+    }
+    config->fft_size = CARIBOULITE_SWEEP_DEFAULT_FFT_SIZE;
+    config->num_averages = 1;
+    config->usable_fraction = CARIBOULITE_SWEEP_DEFAULT_USABLE;
+    config->dc_notch_bins = 1;
+    config->settle_us = 0;
+    config->num_sweeps = 0;
+}
+
+//=========================================================================
+int cariboulite_sweep_get_geometry(const cariboulite_sweep_config_st* config,
+                                   uint32_t* num_steps,
+                                   uint32_t* bins_per_step,
+                                   double* bin_width_hz)
+{
+    if (config == NULL) return -1;
+
+    uint32_t n = config->fft_size;
+    if (n < CARIBOULITE_SWEEP_MIN_FFT_SIZE || n > CARIBOULITE_SWEEP_MAX_FFT_SIZE || (n & (n - 1)))
+    {
+        ZF_LOGE("sweep fft size %u should be a power of 2 in [%d .. %d]", n,
+            CARIBOULITE_SWEEP_MIN_FFT_SIZE, CARIBOULITE_SWEEP_MAX_FFT_SIZE);
+        return -1;
+    }
+    if (config->usable_fraction <= 0.0f || config->usable_fraction > 1.0f)
+    {
+        ZF_LOGE("sweep usable fraction %.2f should be in (0 .. 1]", config->usable_fraction);
+        return -1;
+    }
+    if (config->freq_max_hz <= config->freq_min_hz)
+    {
+        ZF_LOGE("sweep range [%.0f .. %.0f] Hz is empty", config->freq_min_hz, config->freq_max_hz);
+        return -1;
+    }
+
+    // an even number of bins so that the step is centered on DC
+    uint32_t usable = ((uint32_t)(config->usable_fraction * (float)n)) & ~1U;
+    if (usable < 2) usable = 2;
+
+    double bin_width = (double)CARIBOU_SMI_SAMPLE_RATE / (double)n;
+    double step = bin_width * usable;
+
+    if (num_steps) *num_steps = (uint32_t)ceil((config->freq_max_hz - config->freq_min_hz) / step);
+    if (bins_per_step) *bins_per_step = usable;
+    if (bin_width_hz) *bin_width_hz = bin_width;
+    return 0;
+}
+
+//=========================================================================
+int cariboulite_sweep_run(cariboulite_radio_state_st* radio,
+                          const cariboulite_sweep_config_st* config,
+                          cariboulite_sweep_callback callback,
+                          void* context,
+                          volatile int* keep_running,
+                          cariboulite_sweep_stats_st* stats)
+{
+    uint32_t num_steps = 0, usable = 0;
+    double bin_width = 0.0;
+    if (radio == NULL || callback == NULL) return -1;
+    if (cariboulite_sweep_get_geometry(config, &num_steps, &usable, &bin_width) != 0) return -1;
+
+    uint32_t num_ffts = config->num_averages ? config->num_averages : 1;
+    size_t need = (size_t)config->fft_size * num_ffts;
+    double step_hz = bin_width * usable;
+    int ret = 0;
+
+    // the step centers - the last one is pulled back into the range if it overshoots
+    cariboulite_radio_hop_st* hops = malloc(num_steps * sizeof(cariboulite_radio_hop_st));
+    cariboulite_sample_complex_int16* chunk = malloc(SWEEP_READ_CHUNK * sizeof(cariboulite_sample_complex_int16));
+    cariboulite_sample_complex_int16* block = malloc(need * sizeof(cariboulite_sample_complex_int16));
+    cariboulite_radio_hop_tag_st tags[SWEEP_READ_TAGS];
+    sweep_fft_st fft;
+    if (hops == NULL || chunk == NULL || block == NULL || sweep_fft_init(&fft, config->fft_size) != 0)
+    {
+        ZF_LOGE("sweep buffers allocation failed");
+        free(hops);
+        free(chunk);
+        free(block);
+        return -1;
+    }
+
+    for (uint32_t i = 0; i < num_steps; i++)
+    {
+        double center = config->freq_min_hz + step_hz * ((double)i + 0.5);
+        if (num_steps > 1 && center + step_hz / 2 > config->freq_max_hz) center = config->freq_max_hz - step_hz / 2;
+        hops[i].frequency_hz = center;
+        hops[i].dwell_us = (uint32_t)((need * 1000000ULL + CARIBOU_SMI_SAMPLE_RATE - 1) / CARIBOU_SMI_SAMPLE_RATE);
+    }
+
+    // the widest front-end - the usable band is limited by the analog filter
+    if (config->usable_fraction * CARIBOU_SMI_SAMPLE_RATE > CARIBOULITE_SWEEP_RX_BW_HZ)
+    {
+        ZF_LOGW("sweep usable band %.2f MHz is wider than the %.1f MHz Rx filter, every step's edges will dip",
+            config->usable_fraction * CARIBOU_SMI_SAMPLE_RATE / 1e6, CARIBOULITE_SWEEP_RX_BW_HZ / 1e6);
+    }
+    cariboulite_radio_set_rx_bandwidth(radio, cariboulite_radio_rx_bw_2000KHz);
+    cariboulite_radio_set_rx_samp_cutoff(radio, cariboulite_radio_rx_sample_rate_4000khz, cariboulite_radio_rx_f_cut_half_fs);
+
+    if (cariboulite_radio_start_hopping(radio, hops, num_steps, true, config->settle_us, 0) != 0)
+    {
+        ZF_LOGE("sweep couldn't start hopping over %u steps", num_steps);
+        ret = -1;
+        goto sweep_exit;
+    }
+
+    cariboulite_sweep_stats_st st = {0};
+    bool have_step = false;
+    bool step_closed = false;
+    cariboulite_radio_hop_tag_st cur = {0};
+    size_t collected = 0;
+    uint64_t fft_us_total = 0;
+    uint64_t start_us = sweep_time_us();
+    bool done = false;
+
+    while (!done && (keep_running == NULL || *keep_running))
+    {
+        uint64_t first = 0;
+        size_t num_tags = 0;
+        int n = cariboulite_radio_read_hop_samples(radio, chunk, SWEEP_READ_CHUNK, &first,
+                                                   tags, SWEEP_READ_TAGS, &num_tags, SWEEP_READ_TIMEOUT_MS);
+        if (n < 0)
+        {
+            ZF_LOGE("sweep hop reading failed");
+            ret = -1;
+            break;
+        }
+
+        size_t pos = 0;
+        for (size_t t = 0; t <= num_tags && !done; t++)
+        {
+            // the samples up to the next tag (or the end of the chunk) belong to the current step
+            size_t end = (t < num_tags) ? (size_t)(tags[t].sample_index - first) : (size_t)n;
+            if (have_step && !step_closed && end > pos)
+            {
+                size_t take = end - pos;
+                if (take > need - collected) take = need - collected;
+                memcpy(block + collected, chunk + pos, take * sizeof(cariboulite_sample_complex_int16));
+                collected += take;
+
+                if (collected == need)
+                {
+                    uint64_t t0 = sweep_time_us();
+                    memset(fft.power, 0, fft.n * sizeof(float));
+                    for (uint32_t k = 0; k < num_ffts; k++) sweep_fft_power(&fft, block + (size_t)k * fft.n);
+                    sweep_fft_usable_bins(&fft, usable, num_ffts, config->dc_notch_bins);
+                    fft_us_total += sweep_time_us() - t0;
+
+                    cariboulite_sweep_step_st step;
+                    step.sweep_index = st.sweeps;
+                    step.step_index = cur.hop_index;
+                    step.hz_low = cur.actual_frequency_hz - bin_width * (usable / 2);
+                    step.hz_high = step.hz_low + bin_width * usable;
+                    step.bin_width_hz = bin_width;
+                    step.num_samples = (uint32_t)need;
+                    step.num_bins = usable;
+                    step.bins_db = fft.bins_db;
+                    st.steps++;
+                    step_closed = true;
+                    if (callback(context, &step) != 0) done = true;
+                    if (cur.hop_index == num_steps - 1) st.sweeps++;
+                }
+            }
+            pos = end;
+
+            if (t == num_tags) break;
+
+            // a new step begins - the previous one was cut short by an overrun
+            if (have_step && !step_closed)
+            {
+                st.lost_steps++;
+                if (cur.hop_index == num_steps - 1) st.sweeps++;
+            }
+            cur = tags[t];
+            have_step = true;
+            step_closed = false;
+            collected = 0;
+        }
+
+        if (config->num_sweeps && st.sweeps >= config->num_sweeps) done = true;
+    }
+
+    st.elapsed_sec = (double)(sweep_time_us() - start_us) / 1e6;
+    cariboulite_radio_get_hop_stats(radio, &st.hop);
+    cariboulite_radio_stop_hopping(radio);
+
+    if (st.elapsed_sec > 0.0)
+    {
+        st.ghz_per_sec = (double)st.steps * step_hz / st.elapsed_sec / 1e9;
+        st.sweep_rate_hz = (float)((double)st.sweeps / st.elapsed_sec);
+        st.step_rate_hz = (float)((double)st.steps / st.elapsed_sec);
+    }
+    if (st.steps) st.fft_us_avg = (float)((double)fft_us_total / (double)st.steps);
+    if (stats) *stats = st;
+
+sweep_exit:
+    sweep_fft_free(&fft);
+    free(hops);
+    free(chunk);
+    free(block);
+    return ret;
+}
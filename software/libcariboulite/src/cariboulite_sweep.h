@@ -0,0 +1,134 @@
+/**
+ * @file cariboulite_sweep.h
+ * @date October 2023
+ * @brief Wideband spectrum sweep API
+ *
+ * A hackrf_sweep style power spectrum engine. The channel hops through a
+ * list of steps (the hop scheduler with its pre-staged frequency plans),
+ * a short block is captured on every step, transformed by a windowed FFT
+ * and the usable (flat) center of the 4 MSPS band is handed to the caller.
+ * Consecutive steps are spaced by exactly that usable band, so the steps
+ * stitch into a continuous spectrum from freq_min_hz to freq_max_hz.
+ */
+
+#ifndef __CARIBOULITE_SWEEP_H__
+#define __CARIBOULITE_SWEEP_H__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include "cariboulite_radio.h"
+
+#define CARIBOULITE_SWEEP_MIN_FFT_SIZE          (16)
+#define CARIBOULITE_SWEEP_MAX_FFT_SIZE          (8192)
+#define CARIBOULITE_SWEEP_DEFAULT_FFT_SIZE      (256)           // 15.625 KHz bins
+#define CARIBOULITE_SWEEP_RX_BW_HZ              (2.0e6)         // the widest analog Rx filter
+#define CARIBOULITE_SWEEP_DEFAULT_USABLE        (0.5f)          // the 2 MHz filter out of 4 MSPS
+
+typedef struct
+{
+    double                              freq_min_hz;
+    double                              freq_max_hz;
+    uint32_t                            fft_size;           // power of 2, bin width = 4 MSPS / fft_size
+    uint32_t                            num_averages;       // FFTs averaged on every step
+    float                               usable_fraction;    // part of the sampled band kept on every step
+    uint32_t                            dc_notch_bins;      // bins on each side of DC replaced by their neighbors
+    uint32_t                            settle_us;          // dropped after every retune (0 = hop scheduler default)
+    uint32_t                            num_sweeps;         // 0 = until stopped
+} cariboulite_sweep_config_st;
+
+typedef struct
+{
+    uint64_t                            sweep_index;
+    uint32_t                            step_index;
+    double                              hz_low;             // the lower edge of bins_db[0]
+    double                              hz_high;            // the upper edge of the last bin
+    double                              bin_width_hz;
+    uint32_t                            num_samples;        // samples transformed on this step
+    uint32_t                            num_bins;
+    const float*                        bins_db;            // average power [dBFS], valid during the callback
+} cariboulite_sweep_step_st;
+
+typedef struct
+{
+    uint64_t                            sweeps;             // complete passes over the range
+    uint64_t                            steps;              // delivered steps
+    uint64_t                            lost_steps;         // steps that didn't get enough samples (overruns)
+    double                              elapsed_sec;
+    double                              ghz_per_sec;        // delivered spectrum per second
+    float                               sweep_rate_hz;
+    float                               step_rate_hz;
+    float                               fft_us_avg;         // processing time per step
+    cariboulite_radio_hop_stats_st      hop;                // retune / settling statistics
+} cariboulite_sweep_stats_st;
+
+/**
+ * @brief Sweep step handler
+ *
+ * Called on the sweeping thread for every step, in frequency order.
+ *
+ * @param context the user context given to cariboulite_sweep_run
+ * @param step the step's power bins
+ * @return 0 = continue, otherwise the sweep stops
+ */
+typedef int (*cariboulite_sweep_callback)(void* context, const cariboulite_sweep_step_st* step);
+
+/**
+ * @brief Fill a sweep configuration with the defaults
+ *
+ * The whole range the channel can tune to (the upper sub-GHz band on the
+ * S1G channel, 2.4 GHz ISM on the ISM board's HiF channel and 1 MHz - 6 GHz
+ * otherwise), CARIBOULITE_SWEEP_DEFAULT_FFT_SIZE bins, one FFT per step and
+ * the default usable fraction and settling time.
+ *
+ * @param radio the channel to sweep (nullable - the 1 MHz - 6 GHz range)
+ * @param config the configuration to fill
+ */
+void cariboulite_sweep_default_config(cariboulite_radio_state_st* radio, cariboulite_sweep_config_st* config);
+
+/**
+ * @brief Get the sweep geometry for a configuration
+ *
+ * @param config the sweep configuration
+ * @param num_steps the number of retunes per sweep (nullable)
+ * @param bins_per_step the number of bins per step (nullable)
+ * @param bin_width_hz the bin width (nullable)
+ * @return 0 = success, -1 = invalid configuration
+ */
+int cariboulite_sweep_get_geometry(const cariboulite_sweep_config_st* config,
+                                   uint32_t* num_steps,
+                                   uint32_t* bins_per_step,
+                                   double* bin_width_hz);
+
+/**
+ * @brief Run a spectrum sweep (blocking)
+ *
+ * Configures the channel's Rx front-end for the full 4 MSPS band (2 MHz
+ * analog bandwidth, no digital cut-off), starts hopping over the sweep
+ * steps and calls "callback" with every step's bins. The gain is left as
+ * configured by the caller. Returns when num_sweeps are done, the callback
+ * returns non-zero or *keep_running turns 0. The channel is deactivated
+ * on return.
+ *
+ * @param radio a pre-allocated radio state structure
+ * @param config the sweep configuration
+ * @param callback the step handler
+ * @param context passed to the callback
+ * @param keep_running an external stop flag (nullable)
+ * @param stats the sweep statistics on return (nullable)
+ * @return 0 = success, -1 = failure
+ */
+int cariboulite_sweep_run(cariboulite_radio_state_st* radio,
+                          const cariboulite_sweep_config_st* config,
+                          cariboulite_sweep_callback callback,
+                          void* context,
+                          volatile int* keep_running,
+                          cariboulite_sweep_stats_st* stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // __CARIBOULITE_SWEEP_H__
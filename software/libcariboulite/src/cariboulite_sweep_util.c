@@ -0,0 +1,403 @@
+#ifndef ZF_LOG_LEVEL
+    #define ZF_LOG_LEVEL ZF_LOG_VERBOSE
+#endif
+
+#define ZF_LOG_DEF_SRCLOC ZF_LOG_SRCLOC_LONG
+#define ZF_LOG_TAG "CARIBOULITE Sweep Util"
+#include "zf_log/zf_log.h"
+
+#include <sys/types.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#include "cariboulite_setup.h"
+#include "cariboulite_events.h"
+#include "cariboulite.h"
+#include "cariboulite_sweep.h"
+#include "hat/hat.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <signal.h>
+#include <string.h>
+#include <inttypes.h>
+#include <time.h>
+
+//=======================================================================
+// INTERNAL VARIABLES AND DEFINITIONS
+
+static int signal_shown = 0;
+CARIBOULITE_CONFIG_STATIC_DEFAULT(cariboulite_sys);
+
+// Program state structure
+typedef struct
+{
+    // Arguments
+    char *filename;
+    double freq_min;
+    double freq_max;
+    double bin_width;
+    float gain;
+    int binary_output;
+    int force_fpga_prog;
+    cariboulite_sweep_config_st config;
+
+    // State
+    volatile int program_running;
+    int sys_type;
+    cariboulite_radio_state_st *radio;
+    FILE *file;
+    char *line;
+    size_t line_len;
+    uint64_t last_report_us;
+    uint64_t last_report_sweeps;
+    uint64_t sweeps_seen;
+} prog_state_st;
+
+static prog_state_st state = {0};
+
+//=================================================
+static uint64_t time_us(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000ULL + (uint64_t)(ts.tv_nsec / 1000);
+}
+
+//=================================================
+static int stop_program (void)
+{
+    if (state.program_running) ZF_LOGD("program termination requested");
+    state.program_running = 0;
+    return 0;
+}
+
+//=================================================
+static void sighandler(void* context,
+                       int signal_number,
+                       siginfo_t *si)
+{
+    if (signal_shown != signal_number)
+    {
+        ZF_LOGI("Received signal %d", signal_number);
+        signal_shown = signal_number;
+    }
+
+    switch (signal_number)
+    {
+        case SIGINT:
+        case SIGTERM:
+        case SIGABRT:
+        case SIGILL:
+        case SIGSEGV:
+        case SIGFPE: stop_program(); break;
+        default: return; break;
+    }
+}
+
+//=================================================
+static void init_program_state(void)
+{
+    state.filename = NULL;
+    state.freq_min = 0;                         // 0:0 = the channel's whole range
+    state.freq_max = 0;
+    state.bin_width = 0;
+    state.gain = -1;
+    state.binary_output = 0;
+    state.force_fpga_prog = 0;
+    cariboulite_sweep_default_config(NULL, &state.config);
+
+    // state
+    state.program_running = 1;
+    state.sys_type = system_type_cariboulite_full;
+    state.radio = NULL;
+    state.file = NULL;
+    state.line = NULL;
+    state.line_len = 0;
+}
+
+//=======================================================================
+static void usage(void)
+{
+	fprintf(stderr,
+		"CaribouLite spectrum sweeper\n\n"
+		"Usage:\t[-f freq_min:freq_max [MHz] (default: the whole channel range)]\n"
+		"\t[-w bin width [Hz] (default: 15625, rounded up to 4MSPS / 2^n)]\n"
+		"\t[-a number of FFTs averaged per step (default: 1)]\n"
+		"\t[-u usable fraction of every step's band (default: 0.5)]\n"
+		"\t[-s settling time after every retune [us] (default: 200)]\n"
+		"\t[-g gain (default: -1 for agc)]\n"
+		"\t[-N number of sweeps (default: 0, infinite)]\n"
+		"\t[-1 one shot - a single sweep]\n"
+		"\t[-B binary output (default: CSV)]\n"
+		"\t[-F force fpga reprogramming]\n"
+		"\t[filename ('-' or none dumps the sweeps to stdout)]\n\n"
+		"CSV lines (hackrf_sweep format):\n"
+		"\tdate, time, hz_low, hz_high, hz_bin_width, num_samples, dB, dB, ...\n"
+		"Binary records:\n"
+		"\tuint32 record length, uint64 hz_low, uint64 hz_high, float dB[...]\n\n"
+		"Example:\n"
+		"\t1. Sweep 1MHz..6GHz once into sweep.csv\n"
+		"\t\tcariboulite_sweep -1 sweep.csv\n"
+		"\t2. Sweep the 2.4GHz ISM band with 2KHz bins, averaging 4 FFTs\n"
+		"\t\tcariboulite_sweep -f 2400:2500 -w 2000 -a 4 -\n\n");
+	exit(1);
+}
+
+//=======================================================================
+static int check_inputs(void)
+{
+    state.sys_type = cariboulite_sys.board_info.numeric_product_id;
+
+    // the range the sweep channel can tune to on this board
+    cariboulite_sweep_config_st limits;
+    cariboulite_sweep_default_config(state.radio, &limits);
+    double min_freq = limits.freq_min_hz;
+    double max_freq = limits.freq_max_hz;
+    if (state.freq_min == 0 && state.freq_max == 0)
+    {
+        state.freq_min = min_freq;
+        state.freq_max = max_freq;
+    }
+
+    if (state.freq_min < min_freq || state.freq_max > max_freq || state.freq_max <= state.freq_min)
+    {
+        ZF_LOGE("Sweep range [%.2f .. %.2f] MHz is out of the [%.0f .. %.0f] MHz range",
+            state.freq_min / 1e6, state.freq_max / 1e6, min_freq / 1e6, max_freq / 1e6);
+        return -1;
+    }
+
+    if ((state.gain < 0 || state.gain > 23.0*3.0) && state.gain != -1)
+    {
+        ZF_LOGE("Rx channel gain %.0f is incompatible (legal range: [%.0f .. %.0f] dB", state.gain,
+            0.0, 23.0*3.0);
+        return -1;
+    }
+
+    state.config.freq_min_hz = state.freq_min;
+    state.config.freq_max_hz = state.freq_max;
+    if (state.bin_width > 0)
+    {
+        uint32_t n = CARIBOULITE_SWEEP_MIN_FFT_SIZE;
+        while (n < CARIBOULITE_SWEEP_MAX_FFT_SIZE && 4e6 / n > state.bin_width) n <<= 1;
+        state.config.fft_size = n;
+    }
+    return cariboulite_sweep_get_geometry(&state.config, NULL, NULL, NULL);
+}
+
+//=================================================
+int analyze_arguments(int argc, char *argv[])
+{
+    int opt;
+    double fmin, fmax;
+    while ((opt = getopt(argc, argv, "f:w:a:u:s:g:N:1BF")) != -1) {
+		switch (opt) {
+		case 'f':
+			if (sscanf(optarg, "%lf:%lf", &fmin, &fmax) != 2)
+            {
+                usage();
+                return -1;
+            }
+            state.freq_min = fmin * 1e6;
+            state.freq_max = fmax * 1e6;
+			break;
+		case 'w':
+			state.bin_width = atof(optarg);
+			break;
+		case 'a':
+			state.config.num_averages = (uint32_t)atoi(optarg);
+			break;
+		case 'u':
+			state.config.usable_fraction = (float)atof(optarg);
+			break;
+		case 's':
+			state.config.settle_us = (uint32_t)atoi(optarg);
+			break;
+		case 'g':
+			state.gain = (int)(atof(optarg));
+			break;
+		case 'N':
+			state.config.num_sweeps = (uint32_t)atoi(optarg);
+			break;
+		case '1':
+			state.config.num_sweeps = 1;
+			break;
+		case 'B':
+			state.binary_output = 1;
+			break;
+        case 'F':
+			state.force_fpga_prog = 1;
+			break;
+		default:
+			usage();
+            return -1;
+			break;
+		}
+	}
+
+    state.filename = (argc > optind) ? argv[optind] : "-";
+    return 0;
+}
+
+//=================================================
+static int write_csv_step(const cariboulite_sweep_step_st* step)
+{
+    struct timeval tv;
+    struct tm tm;
+    char stamp[64];
+    gettimeofday(&tv, NULL);
+    localtime_r(&tv.tv_sec, &tm);
+    strftime(stamp, sizeof(stamp), "%Y-%m-%d, %H:%M:%S", &tm);
+
+    size_t need = 128 + (size_t)step->num_bins * 12;
+    if (need > state.line_len)
+    {
+        char* line = realloc(state.line, need);
+        if (line == NULL) return -1;
+        state.line = line;
+        state.line_len = need;
+    }
+
+    // formatted into one buffer so that a line is a single write
+    int len = snprintf(state.line, state.line_len, "%s.%06ld, %" PRIu64 ", %" PRIu64 ", %.2f, %u",
+                       stamp, (long)tv.tv_usec, (uint64_t)step->hz_low, (uint64_t)step->hz_high,
+                       step->bin_width_hz, step->num_samples);
+    for (uint32_t i = 0; i < step->num_bins; i++)
+    {
+        len += snprintf(state.line + len, state.line_len - len, ", %.2f", step->bins_db[i]);
+    }
+    state.line[len++] = '\n';
+    return fwrite(state.line, 1, len, state.file) == (size_t)len ? 0 : -1;
+}
+
+//=================================================
+static int write_binary_step(const cariboulite_sweep_step_st* step)
+{
+    uint32_t record_len = sizeof(uint64_t) * 2 + step->num_bins * sizeof(float);
+    uint64_t edges[2] = {(uint64_t)step->hz_low, (uint64_t)step->hz_high};
+    if (fwrite(&record_len, sizeof(record_len), 1, state.file) != 1) return -1;
+    if (fwrite(edges, sizeof(edges), 1, state.file) != 1) return -1;
+    if (fwrite(step->bins_db, sizeof(float), step->num_bins, state.file) != step->num_bins) return -1;
+    return 0;
+}
+
+//=================================================
+static int sweep_step_handler(void* context, const cariboulite_sweep_step_st* step)
+{
+    int res = state.binary_output ? write_binary_step(step) : write_csv_step(step);
+    if (res != 0)
+    {
+        ZF_LOGE("Writing into file failed, exiting!");
+        return -1;
+    }
+
+    // a progress line every second
+    state.sweeps_seen = step->sweep_index;
+    uint64_t now = time_us();
+    if (now - state.last_report_us >= 1000000ULL)
+    {
+        double dt = (double)(now - state.last_report_us) / 1e6;
+        fprintf(stderr, "%" PRIu64 " total sweeps completed, %.2f sweeps/second\n",
+                state.sweeps_seen, (double)(state.sweeps_seen - state.last_report_sweeps) / dt);
+        state.last_report_us = now;
+        state.last_report_sweeps = state.sweeps_seen;
+    }
+    return 0;
+}
+
+//=================================================
+static void print_report(const cariboulite_sweep_stats_st* st)
+{
+    uint32_t num_steps = 0, bins = 0;
+    double bin_width = 0;
+    cariboulite_sweep_get_geometry(&state.config, &num_steps, &bins, &bin_width);
+
+    fprintf(stderr, "\nSweep report:\n");
+    fprintf(stderr, "\trange:          %.3f .. %.3f MHz, %u steps of %u bins x %.2f Hz\n",
+            state.config.freq_min_hz / 1e6, state.config.freq_max_hz / 1e6, num_steps, bins, bin_width);
+    fprintf(stderr, "\tsweeps:         %" PRIu64 " in %.2f sec (%.2f sweeps/sec)\n",
+            st->sweeps, st->elapsed_sec, st->sweep_rate_hz);
+    fprintf(stderr, "\tsteps:          %" PRIu64 " delivered, %" PRIu64 " lost (%.0f steps/sec)\n",
+            st->steps, st->lost_steps, st->step_rate_hz);
+    fprintf(stderr, "\tsweep speed:    %.3f GHz/sec\n", st->ghz_per_sec);
+    fprintf(stderr, "\tretune:         avg %.0f us, min %.0f us, max %.0f us\n",
+            st->hop.retune_us_avg, st->hop.retune_us_min, st->hop.retune_us_max);
+    fprintf(stderr, "\tfft per step:   %.1f us\n", st->fft_us_avg);
+    fprintf(stderr, "\toverrun:        %" PRIu64 " samples\n", st->hop.samples_overrun);
+}
+
+//=================================================
+void release_system(void)
+{
+    if (state.file && state.file != stdout) fclose(state.file);
+    if (state.line) free(state.line);
+    cariboulite_close();
+}
+
+//=================================================
+int main(int argc, char *argv[])
+{
+    // pre-init the program state
+    //-------------------------------------
+    init_program_state();
+
+    // Analyze program opts
+    //-------------------------------------
+    if (analyze_arguments(argc, argv) != 0)
+    {
+        return 0;
+    }
+
+    // Init the program
+    //-------------------------------------
+    if (cariboulite_init(state.force_fpga_prog, cariboulite_log_level_none) != 0)
+    {
+        ZF_LOGE("driver init failed, terminating...");
+        return -1;
+    }
+
+    // setup the signal handler
+    cariboulite_register_signal_handler ( sighandler, &cariboulite_sys);
+
+    // the wide-band sweep always runs on the HiF channel
+    state.radio = cariboulite_get_radio(cariboulite_channel_hif);
+
+    // check the input arguments (done after init to identify system type)
+    if (check_inputs() != 0)
+    {
+        cariboulite_close();
+        return -1;
+    }
+
+    cariboulite_radio_set_rx_gain_control(state.radio, state.gain == -1.0, state.gain);
+
+    // Open the file for writing
+    if(strcmp(state.filename, "-") == 0)
+    {
+		state.file = stdout;
+	}
+    else
+    {
+		state.file = fopen(state.filename, "wb");
+		if (!state.file)
+        {
+            ZF_LOGE("Failed to open %s", state.filename);
+            release_system();
+            return -1;
+        }
+	}
+
+    cariboulite_sweep_stats_st stats = {0};
+    state.last_report_us = time_us();
+    int res = cariboulite_sweep_run(state.radio, &state.config, sweep_step_handler, NULL,
+                                    &state.program_running, &stats);
+    if (res != 0)
+    {
+        ZF_LOGE("Sweep failed");
+    }
+    print_report(&stats);
+
+    // close the driver and release resources
+    release_system();
+    return res;
+}
@@ -37,6 +37,8 @@ typedef struct
     float ppm_error;
     size_t samples_to_read;
     int force_fpga_prog;
+    int force_modem_cal;
+    int warm_attach;
     int write_metadata;
     
     // State
@@ -95,6 +97,8 @@ static void init_program_state(void)
     state.ppm_error = 0;
     state.samples_to_read = 1024*1024/8;
     state.force_fpga_prog = 0;
+    state.force_modem_cal = 0;
+    state.warm_attach = 0;
     state.write_metadata = 0;
     
     // state
@@ -120,6 +124,8 @@ static void usage(void)
 		"\t[-n number of samples to read (default: 0, infinite)]\n"
 		"\t[-S force sync output (default: async)]\n"
         "\t[-F force fpga reprogramming (default: '0')]\n"
+        "\t[-C force modem calibration, ignoring the cached one (default: '0')]\n"
+        "\t[-W warm attach to the state left by a previous run (default: '0')]\n"
         "\t[-M write metadata (default: '0')]\n"
 		"\tfilename ('-' dumps samples to stdout)\n\n"
         "Example (CS16 files readable by 'inspectrum' analyzer):\n"
@@ -182,7 +188,7 @@ static int check_inputs(void)
 int analyze_arguments(int argc, char *argv[])
 {
     int opt;
-    while ((opt = getopt(argc, argv, "c:f:g:n:S:F")) != -1) {
+    while ((opt = getopt(argc, argv, "c:f:g:n:S:FCW")) != -1) {
 		switch (opt) {
 		case 'c':
 			state.rx_channel = (int)atoi(optarg);
@@ -218,6 +224,14 @@ int analyze_arguments(int argc, char *argv[])
 			state.force_fpga_prog = 1;
             printf("DBG: Force FPGA programming = %d\n", state.force_fpga_prog);
 			break;
+        case 'C':
+			state.force_modem_cal = 1;
+            printf("DBG: Force modem calibration = %d\n", state.force_modem_cal);
+			break;
+        case 'W':
+			state.warm_attach = 1;
+            printf("DBG: Warm attach = %d\n", state.warm_attach);
+			break;
         case 'M':
 			state.write_metadata = 1;
             printf("DBG: Write metadata = %d\n", state.write_metadata);
@@ -267,6 +281,8 @@ int main(int argc, char *argv[])
 
     // Init the program
     //-------------------------------------
+    cariboulite_force_modem_calibration(state.force_modem_cal);
+    cariboulite_warm_attach(state.warm_attach);
     if (cariboulite_init(state.force_fpga_prog, cariboulite_log_level_none) != 0)
     {
         ZF_LOGE("driver init failed, terminating...");
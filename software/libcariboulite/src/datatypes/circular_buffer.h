@@ -37,27 +37,32 @@ public:
 	size_t put(const T *data, size_t length)
 	{
 		std::lock_guard<std::mutex> lock(mutex_);
+		return put_locked(data, length);
+	}
 
-		if ((max_size_ - size()) < length && override_write_)
+	// put with back-pressure - without override_write, writes the items as
+	// room frees up (in chunks, so more than the capacity fits too), for up
+	// to timeout_us. Returns the number of items written - the rest are the
+	// caller's to retry and aren't counted as dropped
+	size_t put_wait(const T *data, size_t length, int timeout_us = 100000)
+	{
+		std::unique_lock<std::mutex> lock(mutex_);
+		if (override_write_)
 		{
-			// pop the amount of data the is needed
-			tail_ += length - (max_size_ - size());
+			return put_locked(data, length);
 		}
 
-		size_t len = MIN(length, max_size_ - head_ + tail_);
-		auto l = MIN(len, max_size_ - (head_  & (max_size_ - 1)));
-
-		memcpy(buf_ + (head_ & (max_size_ - 1)), data, l * sizeof(T));
-		memcpy(buf_, data + l, (len - l) * sizeof(T));
-		
-		head_ += len;
-
-		if (block_read_) 
+		auto deadline = std::chrono::steady_clock::now() + std::chrono::microseconds(timeout_us);
+		size_t written = 0;
+		while (written < length)
 		{
-      		cond_var_.notify_one();
-    	}
-
-		return len;
+			if (!space_cond_var_.wait_until(lock, deadline, [&]() { return size() < max_size_; }))
+			{
+				break;
+			}
+			written += copy_in_locked(data + written, length - written);
+		}
+		return written;
 	}
 
 	size_t get(T *data, size_t length, int timeout_us = 100000)
@@ -79,16 +84,28 @@ public:
             }
     	}
 
-		size_t len = MIN(length, head_ - tail_);
-		auto l = MIN(len, max_size_ - (tail_ & (max_size_ - 1)));
+		return get_locked(data, length);
+	}
 
-		if (data != NULL)
+	// get up to length items - waits up to timeout_us only until the first
+	// item is available, and returns whatever is there
+	size_t get_some(T *data, size_t length, int timeout_us = 100000)
+	{
+		std::unique_lock<std::mutex> lock(mutex_);
+		cond_var_.wait_for(lock, std::chrono::microseconds(timeout_us), [&]()
 		{
-			memcpy(data, buf_ + (tail_ & (max_size_ - 1)), l * sizeof(T));
-			memcpy(data + l, buf_, (len - l) * sizeof(T));
-		}
-		tail_ += len;
-		return len;
+			return size() > 0;
+		});
+		return get_locked(data, length);
+	}
+
+	// the number of items dropped (overwritten or not written) so far
+	size_t dropped(bool reset = false)
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		size_t d = dropped_;
+		if (reset) dropped_ = 0;
+		return d;
 	}
 
 	void put(T item)
@@ -107,6 +124,8 @@ public:
 	{
 		std::unique_lock<std::mutex> lock(mutex_);
 		head_ = tail_ = 0;
+		dropped_ = 0;
+		space_cond_var_.notify_all();
 	}
 
 	inline bool empty()
@@ -141,6 +160,55 @@ public:
 	}
 
 private:
+	size_t put_locked(const T *data, size_t length)
+	{
+		if ((max_size_ - size()) < length && override_write_)
+		{
+			// pop the amount of data the is needed
+			size_t overwritten = MIN(length - (max_size_ - size()), size());
+			tail_ += overwritten;
+			dropped_ += overwritten;
+		}
+
+		size_t len = copy_in_locked(data, length);
+		dropped_ += length - len;
+		return len;
+	}
+
+	// as much as fits, nothing is dropped
+	size_t copy_in_locked(const T *data, size_t length)
+	{
+		size_t len = MIN(length, max_size_ - head_ + tail_);
+		auto l = MIN(len, max_size_ - (head_  & (max_size_ - 1)));
+
+		memcpy(buf_ + (head_ & (max_size_ - 1)), data, l * sizeof(T));
+		memcpy(buf_, data + l, (len - l) * sizeof(T));
+		
+		head_ += len;
+
+		if (block_read_) 
+		{
+      		cond_var_.notify_one();
+    	}
+
+		return len;
+	}
+
+	size_t get_locked(T *data, size_t length)
+	{
+		size_t len = MIN(length, head_ - tail_);
+		auto l = MIN(len, max_size_ - (tail_ & (max_size_ - 1)));
+
+		if (data != NULL)
+		{
+			memcpy(data, buf_ + (tail_ & (max_size_ - 1)), l * sizeof(T));
+			memcpy(data + l, buf_, (len - l) * sizeof(T));
+		}
+		tail_ += len;
+		if (len) space_cond_var_.notify_one();
+		return len;
+	}
+
 	uint32_t next_power_of_2 (uint32_t x)
 	{
 		uint32_t power = 1;
@@ -154,10 +222,12 @@ private:
 private:
 	std::mutex mutex_;
 	std::condition_variable cond_var_;
+	std::condition_variable space_cond_var_;
 
 	T* buf_;
 	size_t head_ = 0;
 	size_t tail_ = 0;
+	size_t dropped_ = 0;
 	size_t max_size_;
 	bool override_write_;
 	bool block_read_;
@@ -1,6 +1,7 @@
 #include "circular_buffer.h"
 #include <unistd.h>
 #include <stdio.h>
+#include <string.h>
 
 
 circular_buffer<uint32_t> *buf = NULL;
@@ -33,8 +34,91 @@ void consumer(int times)
 	printf("finished\n");
 }
 
-int main ()
+#define CHECK(c)	do { if (!(c)) { printf("FAILED %s:%d: %s\n", __func__, __LINE__, #c); return -1; } } while (0)
+
+// overflow=block - a full queue times out without dropping anything
+int test_put_wait_timeout()
+{
+	circular_buffer<uint32_t> b(8, false, true);
+	CHECK(b.put(data1, 8) == 8);
+	CHECK(b.put_wait(data1, 4, 20000) == 0);
+	CHECK(b.dropped() == 0);
+
+	// room for part of it - the rest is the caller's to retry
+	CHECK(b.get(data2, 2) == 2);
+	CHECK(b.put_wait(data1, 4, 20000) == 2);
+	CHECK(b.dropped() == 0);
+	return 0;
+}
+
+// overflow=drop - the overwritten items are counted once
+int test_drop_counted_once()
 {
+	circular_buffer<uint32_t> b(8, true, true);
+	CHECK(b.put(data1, 6) == 6);
+	CHECK(b.put(data1, 6) == 6);
+	CHECK(b.dropped(true) == 4);
+	CHECK(b.dropped() == 0);
+
+	// the newest 8 are kept
+	CHECK(b.get(data2, 8) == 8);
+	CHECK(data2[0] == 4 && data2[1] == 5 && data2[2] == 0 && data2[7] == 5);
+	return 0;
+}
+
+// a waiting put_wait is woken by a get, not by its timeout
+int test_put_wait_wakeup()
+{
+	circular_buffer<uint32_t> b(8, false, true);
+	CHECK(b.put(data1, 8) == 8);
+
+	size_t written = 0;
+	auto start = std::chrono::steady_clock::now();
+	std::thread t([&]() { written = b.put_wait(data1, 4, 2000000); });
+	usleep(20000);
+	CHECK(b.get(data2, 4) == 4);
+	t.join();
+	auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+	CHECK(written == 4);
+	CHECK(ms < 1000);
+	return 0;
+}
+
+// more than the capacity goes in as the reader drains it, in order
+int test_put_wait_larger_than_capacity()
+{
+	circular_buffer<uint32_t> b(8, false, true);
+	uint32_t out[100] = {0};
+	std::thread t([&]()
+	{
+		size_t got = 0;
+		while (got < 100) got += b.get_some(out + got, 100 - got, 100000);
+	});
+	CHECK(b.put_wait(data1, 100, 2000000) == 100);
+	t.join();
+	CHECK(memcmp(out, data1, sizeof(out)) == 0);
+	CHECK(b.dropped() == 0);
+	return 0;
+}
+
+int main (int argc, char *argv[])
+{
+	for (int i = 0; i < 100; i++)
+	{
+		data1[i] = i;
+		data2[i] = i*i;
+	}
+
+	int fails = 0;
+	fails += test_put_wait_timeout() != 0;
+	fails += test_drop_counted_once() != 0;
+	fails += test_put_wait_wakeup() != 0;
+	fails += test_put_wait_larger_than_capacity() != 0;
+	printf("circular_buffer: %d failed\n", fails);
+
+	// the endless producer / consumer run on request
+	if (fails || argc < 2 || strcmp(argv[1], "stress")) return fails ? -1 : 0;
+
 	for (int i = 0; i < 100; i++)
 	{
 		data1[i] = i;
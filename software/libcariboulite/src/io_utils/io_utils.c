@@ -6,15 +6,38 @@
 #define ZF_LOG_TAG "IO_UTILS_Main"
 
 #include <time.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/ioctl.h>
+#include <linux/gpio.h>
 //#include "pigpio/pigpio.h"
 #include "zf_log/zf_log.h"
 #include "io_utils.h"
 
 
 // DEFINITIONS
+#define IO_UTILS_GPIO_CHIP          "/dev/gpiochip0"
+#define IO_UTILS_MAX_INTERRUPTS     (4)
+#define IO_UTILS_IRQ_REPEATS        (4)     // a level irq raised again while being served has no new edge
+
+typedef struct
+{
+    int gpio;
+    int fd;                 // the line's edge event file
+    int wake_fd[2];         // releases the thread
+    pthread_t thread;
+    gpioAlertFuncEx_t cb;
+    void* context;
+    bool active;
+} io_utils_irq_st;
 
 // STATIC VARIABLES
 static char *io_utils_gpio_mode_strs[] = {"IN","OUT","ALT5","ALT4","ALT0","ALT1","ALT2","ALT3"};
+static io_utils_irq_st io_utils_irqs[IO_UTILS_MAX_INTERRUPTS] = {0};
+static pthread_mutex_t io_utils_irq_mtx = PTHREAD_MUTEX_INITIALIZER;
 
 // STATIC FUNCTIONS
 #define IO_UTILS_SHORT_WAIT(N)   {for (int i=0; i<(N); i++) { asm volatile("nop"); }}
@@ -69,6 +92,21 @@ inline void io_utils_set_gpio_mode(int gpio, io_utils_alt_en mode)
     gpio_config(gpio, mode);
 }
 
+//=============================================================================================
+void io_utils_set_gpio_modes(const int* gpios, const io_utils_alt_en* modes, int count)
+{
+    uint8_t pins[32];
+    uint8_t fsel[32];
+
+    if (count > 32) count = 32;
+    for (int i = 0; i < count; i++)
+    {
+        pins[i] = (uint8_t)gpios[i];
+        fsel[i] = (uint8_t)modes[i];
+    }
+    gpio_config_multi(pins, fsel, count);
+}
+
 //=============================================================================================
 inline void io_utils_write_gpio(int gpio, int value)
 {
@@ -113,9 +151,132 @@ void io_utils_usleep(int usec)
 }
 
 //=============================================================================================
-inline int io_utils_setup_interrupt(int gpio,
-                                    gpioAlertFuncEx_t cb,
-                                    void* context)
+static void* io_utils_irq_thread(void* arg)
+{
+    io_utils_irq_st* irq = (io_utils_irq_st*)arg;
+    struct pollfd fds[2] =
+    {
+        {.fd = irq->fd, .events = POLLIN | POLLPRI},
+        {.fd = irq->wake_fd[0], .events = POLLIN},
+    };
+
+    while (1)
+    {
+        if (poll(fds, 2, -1) < 0)
+        {
+            if (errno == EINTR) continue;
+            ZF_LOGE("polling irq gpio %d failed (%d)", irq->gpio, errno);
+            break;
+        }
+        if (fds[1].revents) break;
+        if (!(fds[0].revents & (POLLIN | POLLPRI))) continue;
+
+        struct gpioevent_data event;
+        if (read(irq->fd, &event, sizeof(event)) != sizeof(event)) continue;
+        uint32_t tick = (uint32_t)(event.timestamp / 1000);
+
+        irq->cb(irq->gpio, 1, tick, irq->context);
+        for (int i = 0; i < IO_UTILS_IRQ_REPEATS && io_utils_read_gpio(irq->gpio); i++)
+        {
+            irq->cb(irq->gpio, 1, tick, irq->context);
+        }
+    }
+    return NULL;
+}
+
+//=============================================================================================
+int io_utils_setup_interrupt(int gpio,
+                            gpioAlertFuncEx_t cb,
+                            void* context)
+{
+    // rising edges, delivered by the kernel's gpio character device on a
+    // thread of their own (pigpio's gpioSetAlertFuncEx used to do this)
+    io_utils_irq_st* irq = NULL;
+
+    pthread_mutex_lock(&io_utils_irq_mtx);
+    for (int i = 0; i < IO_UTILS_MAX_INTERRUPTS; i++)
+    {
+        if (io_utils_irqs[i].active && io_utils_irqs[i].gpio == gpio)
+        {
+            ZF_LOGE("gpio %d already has an interrupt handler", gpio);
+            pthread_mutex_unlock(&io_utils_irq_mtx);
+            return -1;
+        }
+        if (!io_utils_irqs[i].active && irq == NULL) irq = &io_utils_irqs[i];
+    }
+    if (irq == NULL)
+    {
+        ZF_LOGE("no free interrupt slots (max %d)", IO_UTILS_MAX_INTERRUPTS);
+        pthread_mutex_unlock(&io_utils_irq_mtx);
+        return -1;
+    }
+
+    int chip_fd = open(IO_UTILS_GPIO_CHIP, O_RDONLY | O_CLOEXEC);
+    if (chip_fd < 0)
+    {
+        ZF_LOGE("opening %s failed (%d)", IO_UTILS_GPIO_CHIP, errno);
+        pthread_mutex_unlock(&io_utils_irq_mtx);
+        return -1;
+    }
+
+    struct gpioevent_request req = {0};
+    req.lineoffset = gpio;
+    req.handleflags = GPIOHANDLE_REQUEST_INPUT;
+    req.eventflags = GPIOEVENT_REQUEST_RISING_EDGE;
+    strncpy(req.consumer_label, "cariboulite", sizeof(req.consumer_label) - 1);
+    int ret = ioctl(chip_fd, GPIO_GET_LINEEVENT_IOCTL, &req);
+    close(chip_fd);
+    if (ret < 0)
+    {
+        ZF_LOGE("requesting edge events on gpio %d failed (%d)", gpio, errno);
+        pthread_mutex_unlock(&io_utils_irq_mtx);
+        return -1;
+    }
+
+    irq->gpio = gpio;
+    irq->fd = req.fd;
+    irq->cb = cb;
+    irq->context = context;
+    if (pipe(irq->wake_fd) < 0)
+    {
+        ZF_LOGE("wake pipe creation failed (%d)", errno);
+        close(irq->fd);
+        pthread_mutex_unlock(&io_utils_irq_mtx);
+        return -1;
+    }
+    if (pthread_create(&irq->thread, NULL, io_utils_irq_thread, irq) != 0)
+    {
+        ZF_LOGE("irq thread creation failed");
+        close(irq->fd);
+        close(irq->wake_fd[0]);
+        close(irq->wake_fd[1]);
+        pthread_mutex_unlock(&io_utils_irq_mtx);
+        return -1;
+    }
+    irq->active = true;
+    pthread_mutex_unlock(&io_utils_irq_mtx);
+    return 0;
+}
+
+//=============================================================================================
+int io_utils_release_interrupt(int gpio)
 {
-   return 0; //gpioSetAlertFuncEx(gpio, cb, context);
+    pthread_mutex_lock(&io_utils_irq_mtx);
+    for (int i = 0; i < IO_UTILS_MAX_INTERRUPTS; i++)
+    {
+        io_utils_irq_st* irq = &io_utils_irqs[i];
+        if (!irq->active || irq->gpio != gpio) continue;
+
+        char wake = 1;
+        if (write(irq->wake_fd[1], &wake, 1) != 1) ZF_LOGW("waking the irq thread of gpio %d failed", gpio);
+        pthread_join(irq->thread, NULL);
+        close(irq->fd);
+        close(irq->wake_fd[0]);
+        close(irq->wake_fd[1]);
+        irq->active = false;
+        pthread_mutex_unlock(&io_utils_irq_mtx);
+        return 0;
+    }
+    pthread_mutex_unlock(&io_utils_irq_mtx);
+    return -1;
 }
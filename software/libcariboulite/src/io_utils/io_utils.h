@@ -9,6 +9,7 @@ extern "C" {
 #include <string.h>
 #include <stdint.h>
 #include <stdlib.h>
+#include <stdbool.h>
 #include "rpi/rpi.h"
 //#include "pigpio/pigpio.h"
 
@@ -43,6 +44,7 @@ void io_utils_set_pullupdn(int gpio, io_utils_pull_en pud);
 void io_utils_setup_gpio(int gpio, io_utils_dir_en direction, io_utils_pull_en pud);
 int io_utils_get_gpio_mode(int gpio, int print);
 void io_utils_set_gpio_mode(int gpio, io_utils_alt_en mode);
+void io_utils_set_gpio_modes(const int* gpios, const io_utils_alt_en* modes, int count);
 void io_utils_write_gpio(int gpio, int value);
 void io_utils_write_gpio_with_wait(int gpio, int value, int nopcnt);
 int io_utils_wait_gpio_state(int gpio, int state, int cnt);
@@ -51,9 +53,11 @@ char* io_utils_get_alt_from_mode(io_utils_alt_en mode);
 
 // for compliance
 typedef void (*gpioAlertFuncEx_t)  (int gpio, int level, uint32_t tick, void *userdata);
+// "cb" is called (level = 1) on the gpio's rising edges, on a dedicated thread
 int io_utils_setup_interrupt( int gpio,
                               gpioAlertFuncEx_t cb,
                               void* context);
+int io_utils_release_interrupt(int gpio);
 
 void io_utils_usleep(int usec);
 
@@ -0,0 +1,330 @@
+#ifndef ZF_LOG_LEVEL
+    #define ZF_LOG_LEVEL ZF_LOG_VERBOSE
+#endif
+
+#define ZF_LOG_DEF_SRCLOC ZF_LOG_SRCLOC_LONG
+#define ZF_LOG_TAG "IO_UTILS_BitBang"
+
+#include <time.h>
+#include "zf_log/zf_log.h"
+#include "io_utils.h"
+#include "io_utils_bitbang.h"
+
+// DEFINITIONS
+#define GPIO_REG_GPSET0         (0x1C/4)
+#define GPIO_REG_GPCLR0         (0x28/4)
+#define GPIO_REG_GPLEV0         (0x34/4)
+
+#define CALIB_LOOPS             (1 << 16)
+#define CALIB_WRITES            (4096)
+#define CALIB_ROUNDS            (5)
+#define CALIB_WARMUP_NS         (20000000ULL)   // let the cpu clock settle first
+#define CLOCK_MARGIN            (1.1)           // never faster than the rated clock
+
+// STATIC VARIABLES
+static io_utils_gpio_ops_st bb_ops = {0};
+static bool bb_custom_ops = false;
+static volatile uint32_t* bb_regs = NULL;      // direct register access when not mocked
+static io_utils_bitbang_calib_st bb_calib = {0};
+
+//=============================================================================================
+static void bb_fallback_set(void* context, uint32_t mask)
+{
+    (void)context;
+    for (int pin = 0; pin < 32; pin++) if (mask & (1u << pin)) io_utils_write_gpio(pin, 1);
+}
+
+//=============================================================================================
+static void bb_fallback_clr(void* context, uint32_t mask)
+{
+    (void)context;
+    for (int pin = 0; pin < 32; pin++) if (mask & (1u << pin)) io_utils_write_gpio(pin, 0);
+}
+
+//=============================================================================================
+static uint32_t bb_fallback_read(void* context)
+{
+    (void)context;
+    uint32_t levels = 0;
+    for (int pin = 0; pin < 32; pin++) levels |= (uint32_t)(io_utils_read_gpio(pin) & 0x1) << pin;
+    return levels;
+}
+
+//=============================================================================================
+static void bb_resolve_ops(void)
+{
+    if (bb_custom_ops) return;
+
+    bb_regs = gpio_get_registers();
+    if (bb_regs == NULL)
+    {
+        // rpi not mapped yet - slow, but correct
+        bb_ops.set_mask = bb_fallback_set;
+        bb_ops.clr_mask = bb_fallback_clr;
+        bb_ops.read_levels = bb_fallback_read;
+        bb_ops.context = NULL;
+    }
+}
+
+//=============================================================================================
+static inline void bb_set(uint32_t mask)
+{
+    if (bb_regs) bb_regs[GPIO_REG_GPSET0] = mask;
+    else bb_ops.set_mask(bb_ops.context, mask);
+}
+
+//=============================================================================================
+static inline void bb_clr(uint32_t mask)
+{
+    if (bb_regs) bb_regs[GPIO_REG_GPCLR0] = mask;
+    else bb_ops.clr_mask(bb_ops.context, mask);
+}
+
+//=============================================================================================
+static inline uint32_t bb_read(void)
+{
+    if (bb_regs) return bb_regs[GPIO_REG_GPLEV0];
+    return bb_ops.read_levels(bb_ops.context);
+}
+
+//=============================================================================================
+static inline void bb_wait(uint32_t loops)
+{
+    for (volatile uint32_t i = 0; i < loops; i++) {}
+}
+
+//=============================================================================================
+static uint64_t bb_time_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+//=============================================================================================
+void io_utils_bitbang_set_gpio_ops(const io_utils_gpio_ops_st* ops)
+{
+    if (ops == NULL)
+    {
+        bb_custom_ops = false;
+        memset(&bb_ops, 0, sizeof(bb_ops));
+    }
+    else
+    {
+        bb_custom_ops = true;
+        bb_ops = *ops;
+        bb_regs = NULL;
+    }
+    bb_resolve_ops();
+
+    // the write cost differs between the implementations
+    bb_calib.calibrated = false;
+}
+
+//=============================================================================================
+int io_utils_bitbang_calibrate(void)
+{
+    bb_resolve_ops();
+
+    uint64_t warmup_end = bb_time_ns() + CALIB_WARMUP_NS;
+    while (bb_time_ns() < warmup_end) bb_wait(CALIB_LOOPS / 16);
+
+    // the best of a few rounds - preemption only ever makes a round slower
+    double loop_ns = 1e9;
+    double write_ns = 1e9;
+    for (int r = 0; r < CALIB_ROUNDS; r++)
+    {
+        uint64_t t0 = bb_time_ns();
+        bb_wait(CALIB_LOOPS);
+        uint64_t t1 = bb_time_ns();
+        double ns = (double)(t1 - t0) / CALIB_LOOPS;
+        if (ns < loop_ns) loop_ns = ns;
+
+        // an empty mask doesn't change any pin
+        t0 = bb_time_ns();
+        for (int i = 0; i < CALIB_WRITES; i++) bb_set(0);
+        t1 = bb_time_ns();
+        ns = (double)(t1 - t0) / CALIB_WRITES;
+        if (ns < write_ns) write_ns = ns;
+    }
+
+    bb_calib.loop_ns = loop_ns > 0.01 ? loop_ns : 0.01;
+    bb_calib.gpio_write_ns = write_ns;
+    bb_calib.calibrated = true;
+
+    ZF_LOGD("bit-bang calibration: delay loop %.2f ns, gpio write %.2f ns", bb_calib.loop_ns, bb_calib.gpio_write_ns);
+    return 0;
+}
+
+//=============================================================================================
+void io_utils_bitbang_get_calibration(io_utils_bitbang_calib_st* calib)
+{
+    if (calib) *calib = bb_calib;
+}
+
+//=============================================================================================
+static uint32_t bb_half_period_loops(uint32_t clock_hz)
+{
+    // a clock phase is one register write and the calibrated wait
+    double half_ns = clock_hz ? CLOCK_MARGIN * 1e9 / (2.0 * clock_hz) : 0.0;
+    double wait_ns = half_ns - bb_calib.gpio_write_ns;
+    return wait_ns > 0.0 ? (uint32_t)(wait_ns / bb_calib.loop_ns + 0.999) : 0;
+}
+
+//=============================================================================================
+void io_utils_bitbang_bus_init(io_utils_bitbang_bus_st* bus, int sck, int mosi, int miso, int cs, uint32_t clock_hz)
+{
+    // the registers get mapped by io_utils_setup
+    if (!bb_custom_ops && bb_regs == NULL && gpio_get_registers() != NULL) bb_calib.calibrated = false;
+    if (!bb_calib.calibrated) io_utils_bitbang_calibrate();
+
+    if (sck >= 32 || mosi >= 32 || miso >= 32 || cs >= 32)
+    {
+        ZF_LOGE("bit-bang pins must be in GPIO bank 0 (sck %d, mosi %d, miso %d, cs %d)", sck, mosi, miso, cs);
+    }
+
+    bus->sck_mask = (sck >= 0 && sck < 32) ? (1u << sck) : 0;
+    bus->mosi_mask = (mosi >= 0 && mosi < 32) ? (1u << mosi) : 0;
+    bus->miso_mask = (miso >= 0 && miso < 32) ? (1u << miso) : 0;
+    bus->cs_mask = (cs >= 0 && cs < 32) ? (1u << cs) : 0;
+    bus->clock_hz = clock_hz;
+    bus->half_period_loops = bb_half_period_loops(clock_hz);
+}
+
+//=============================================================================================
+void io_utils_bitbang_cs(io_utils_bitbang_bus_st* bus, int level)
+{
+    __sync_synchronize();
+    if (level) bb_set(bus->cs_mask);
+    else bb_clr(bus->cs_mask);
+    bb_wait(bus->half_period_loops);
+}
+
+//=============================================================================================
+void io_utils_bitbang_mosi(io_utils_bitbang_bus_st* bus, int level)
+{
+    __sync_synchronize();
+    if (level) bb_set(bus->mosi_mask);
+    else bb_clr(bus->mosi_mask);
+}
+
+//=============================================================================================
+void io_utils_bitbang_clock(io_utils_bitbang_bus_st* bus, int cycles)
+{
+    __sync_synchronize();
+    while (cycles--)
+    {
+        bb_set(bus->sck_mask);
+        bb_wait(bus->half_period_loops);
+        bb_clr(bus->sck_mask);
+        bb_wait(bus->half_period_loops);
+    }
+    __sync_synchronize();
+}
+
+//=============================================================================================
+void io_utils_bitbang_shift_out(io_utils_bitbang_bus_st* bus, uint32_t data, int bits)
+{
+    uint32_t msb = 1u << (bits - 1);
+    int level = -1;
+
+    __sync_synchronize();
+    while (bits--)
+    {
+        // MOSI is only written when the bit changes
+        int bit = (data & msb) ? 1 : 0;
+        if (bit != level)
+        {
+            if (bit) bb_set(bus->mosi_mask);
+            else bb_clr(bus->mosi_mask);
+            level = bit;
+        }
+        data <<= 1;
+        bb_wait(bus->half_period_loops);
+        bb_set(bus->sck_mask);
+        bb_wait(bus->half_period_loops);
+        bb_clr(bus->sck_mask);
+    }
+    __sync_synchronize();
+}
+
+//=============================================================================================
+void io_utils_bitbang_write_bytes(io_utils_bitbang_bus_st* bus, const uint8_t* tx, unsigned int len)
+{
+    for (unsigned int i = 0; i < len; i++)
+    {
+        io_utils_bitbang_shift_out(bus, tx[i], 8);
+    }
+}
+
+//=============================================================================================
+uint32_t io_utils_bitbang_shift_in(io_utils_bitbang_bus_st* bus, int bits)
+{
+    uint32_t data = 0;
+
+    __sync_synchronize();
+    while (bits--)
+    {
+        data <<= 1;
+        bb_set(bus->sck_mask);
+        bb_wait(bus->half_period_loops);
+        bb_clr(bus->sck_mask);
+        bb_wait(bus->half_period_loops);
+        data |= (bb_read() & bus->miso_mask) ? 1 : 0;
+    }
+    __sync_synchronize();
+    return data;
+}
+
+//=============================================================================================
+void io_utils_bitbang_exchange(io_utils_bitbang_bus_st* bus, const uint8_t* tx, uint8_t* rx, unsigned int len)
+{
+    __sync_synchronize();
+    for (unsigned int byte_num = 0; byte_num < len; byte_num++)
+    {
+        uint8_t current_tx_byte = tx[byte_num];
+        uint8_t rx_byte = 0;
+
+        for (int bit = 0; bit < 8; bit++)
+        {
+            if (current_tx_byte & 0x80) bb_set(bus->mosi_mask);
+            else bb_clr(bus->mosi_mask);
+            current_tx_byte <<= 1;
+            bb_wait(bus->half_period_loops);
+
+            bb_set(bus->sck_mask);
+            bb_wait(bus->half_period_loops);
+            rx_byte = (rx_byte << 1) | ((bb_read() & bus->miso_mask) ? 1 : 0);
+            bb_clr(bus->sck_mask);
+        }
+        if (rx) rx[byte_num] = rx_byte;
+    }
+    __sync_synchronize();
+}
+
+//=============================================================================================
+float io_utils_bitbang_benchmark(io_utils_bitbang_bus_st* bus, uint32_t bits)
+{
+    uint32_t left = bits;
+    uint64_t t0 = bb_time_ns();
+    while (left)
+    {
+        int chunk = left > 32 ? 32 : left;
+        io_utils_bitbang_shift_out(bus, 0xA5A5A5A5, chunk);
+        left -= chunk;
+    }
+    uint64_t t1 = bb_time_ns();
+
+    float rate = (t1 > t0) ? (float)((double)bits * 1e9 / (double)(t1 - t0)) : 0.0f;
+    ZF_LOGD("bit-bang benchmark: %u bits, %.3f Mbit/s (requested clock %.3f MHz)",
+                bits, rate / 1e6f, bus->clock_hz / 1e6f);
+
+    // calibrated while the cpu was clocked down - redo it
+    if (bus->clock_hz && rate > bus->clock_hz)
+    {
+        ZF_LOGW("bit-bang rate %.3f Mbit/s exceeds the rated clock, recalibrating", rate / 1e6f);
+        io_utils_bitbang_calibrate();
+        bus->half_period_loops = bb_half_period_loops(bus->clock_hz);
+    }
+    return rate;
+}
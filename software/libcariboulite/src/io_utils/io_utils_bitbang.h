@@ -0,0 +1,70 @@
+#ifndef __IO_UTILS_BITBANG_H__
+#define __IO_UTILS_BITBANG_H__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// GPIO access used by the bit-bang engine. The default writes the mmapped
+// GPSET0 / GPCLR0 registers directly and reads GPLEV0 (pins 0..31); a test
+// harness may install its own set to run the engine off-target.
+typedef struct
+{
+    void (*set_mask)(void* context, uint32_t mask);
+    void (*clr_mask)(void* context, uint32_t mask);
+    uint32_t (*read_levels)(void* context);
+    void* context;
+} io_utils_gpio_ops_st;
+
+typedef struct
+{
+    uint32_t sck_mask;
+    uint32_t mosi_mask;
+    uint32_t miso_mask;
+    uint32_t cs_mask;
+    uint32_t clock_hz;
+    uint32_t half_period_loops;     // calibrated wait per clock phase
+} io_utils_bitbang_bus_st;
+
+typedef struct
+{
+    double loop_ns;                 // one iteration of the delay loop
+    double gpio_write_ns;           // one set / clear register write
+    bool calibrated;
+} io_utils_bitbang_calib_st;
+
+// install GPIO operations (NULL = the mmapped rpi registers)
+void io_utils_bitbang_set_gpio_ops(const io_utils_gpio_ops_st* ops);
+
+// measure the delay loop and the GPIO write cost against CLOCK_MONOTONIC
+// (done once, on the first bus setup, unless called explicitly)
+int io_utils_bitbang_calibrate(void);
+void io_utils_bitbang_get_calibration(io_utils_bitbang_calib_st* calib);
+
+// set up a bus for a chip - clock_hz is the chip's rated clock, the actual
+// rate is bounded by the GPIO write speed
+void io_utils_bitbang_bus_init(io_utils_bitbang_bus_st* bus, int sck, int mosi, int miso, int cs, uint32_t clock_hz);
+
+void io_utils_bitbang_cs(io_utils_bitbang_bus_st* bus, int level);
+void io_utils_bitbang_mosi(io_utils_bitbang_bus_st* bus, int level);
+void io_utils_bitbang_clock(io_utils_bitbang_bus_st* bus, int cycles);
+
+// MSB first, data valid on the rising edge, SCK idles low
+void io_utils_bitbang_shift_out(io_utils_bitbang_bus_st* bus, uint32_t data, int bits);
+void io_utils_bitbang_write_bytes(io_utils_bitbang_bus_st* bus, const uint8_t* tx, unsigned int len);
+// MSB first, sampled after the falling edge (RFFC507x readback)
+uint32_t io_utils_bitbang_shift_in(io_utils_bitbang_bus_st* bus, int bits);
+// full duplex, sampled while SCK is high (SPI mode 0)
+void io_utils_bitbang_exchange(io_utils_bitbang_bus_st* bus, const uint8_t* tx, uint8_t* rx, unsigned int len);
+
+// shift out "bits" clock cycles (CS untouched) and report the achieved bit rate
+float io_utils_bitbang_benchmark(io_utils_bitbang_bus_st* bus, uint32_t bits);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // __IO_UTILS_BITBANG_H__
@@ -9,6 +9,7 @@
 #include <pthread.h>
 #include <stdbool.h>
 #include <string.h>
+#include <errno.h>
 #include <sys/wait.h>
 #include <ctype.h>
 #include <endian.h>
@@ -104,6 +105,42 @@ int io_utils_read_string_from_file(char* path, char* filename, char* data, int l
     return retval;
 }
 
+//===========================================================
+// "fname" (in "dir", created if missing) is replaced by "data" - it's written
+// aside and renamed, so a concurrent reader sees either version in full.
+// returns -1 with errno set on failure, the old file is left as it was
+int io_utils_write_file_atomic(const char* dir, const char* fname, const void* data, size_t len)
+{
+	if (mkdir(dir, 0755) != 0 && errno != EEXIST)
+	{
+		return -1;
+	}
+
+	char tmp_path[256];
+	if (snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", fname) >= (int)sizeof(tmp_path))
+	{
+		errno = ENAMETOOLONG;
+		return -1;
+	}
+
+	FILE* fid = fopen(tmp_path, "wb");
+	if (fid == NULL)
+	{
+		return -1;
+	}
+
+	size_t wrote = fwrite(data, 1, len, fid);
+	int err = (wrote != len) ? (errno ? errno : EIO) : 0;
+	if (fclose(fid) != 0 && err == 0) err = errno;
+	if (err == 0 && rename(tmp_path, fname) != 0) err = errno;
+	if (err != 0)
+	{
+		unlink(tmp_path);
+		errno = err;
+		return -1;
+	}
+	return 0;
+}
 
 //===========================================================
 int io_utils_i2cbus_exists(void)
@@ -23,6 +23,7 @@ int io_utils_file_exists(char* fname, int *size, int *dir, int *file, int *dev);
 int io_utils_write_to_file(char* fname, char* data, int size_of_data);
 int io_utils_read_from_file(char* fname, char* data, int len_to_read);
 int io_utils_read_string_from_file(char* path, char* filename, char* data, int len);
+int io_utils_write_file_atomic(const char* dir, const char* fname, const void* data, size_t len);
 
 // i2c
 int io_utils_i2cbus_exists(void);
@@ -5,9 +5,12 @@
 #define ZF_LOG_DEF_SRCLOC ZF_LOG_SRCLOC_LONG
 #define ZF_LOG_TAG "IO_UTILS_SPI"
 
+#include <stdio.h>
 #include <pthread.h>
 #include <time.h>
 #include <errno.h>
+#include <string.h>
+#include <stdint.h>
 
 #include "zf_log/zf_log.h"
 #include "io_utils_spi.h"
@@ -23,6 +26,78 @@ static char *io_utils_chip_types[] =
             "modem - at86rf215 - bitbanged",
         };
 
+//=====================================================================================
+static void io_utils_spi_set_bus_mode(io_utils_spi_st* dev, io_utils_spi_bus_mode_en mode)
+{
+    if (dev->bus_mode == mode)
+    {
+        dev->stats.switches_avoided++;
+        return;
+    }
+
+    int pins[3] = {dev->miso, dev->mosi, dev->sck};
+    io_utils_alt_en modes[3] = {io_utils_alt_4, io_utils_alt_4, io_utils_alt_4};
+
+    if (mode == io_utils_spi_bus_mode_hard)
+    {
+        dev->stats.switches_to_hard++;
+    }
+    else
+    {
+        bool swapped = mode == io_utils_spi_bus_mode_gpio_swapped;
+        modes[0] = swapped ? io_utils_alt_gpio_out : io_utils_alt_gpio_in;
+        modes[1] = swapped ? io_utils_alt_gpio_in : io_utils_alt_gpio_out;
+        modes[2] = io_utils_alt_gpio_out;
+        dev->stats.switches_to_gpio++;
+    }
+
+    // all three lines in one function select write
+    io_utils_set_gpio_modes(pins, modes, 3);
+    if (mode == io_utils_spi_bus_mode_hard && IO_UTILS_SPI_HARD_SETTLE_US > 0)
+    {
+        io_utils_usleep(IO_UTILS_SPI_HARD_SETTLE_US);
+    }
+    dev->bus_mode = mode;
+}
+
+//=====================================================================================
+static bool io_utils_spi_same_hard_dev(io_utils_spi_chip_st* a, io_utils_spi_chip_st* b)
+{
+    return a->hard_dev.spi_dev_id == b->hard_dev.spi_dev_id &&
+           a->hard_dev.spi_dev_channel == b->hard_dev.spi_dev_channel;
+}
+
+//=====================================================================================
+// the mode of a spidev is shared by all of its handles - the ice40 programmer
+// holds CS itself (SPI_NO_CS) on the FPGA's device, so its mode is put in
+// place when it's selected and the FPGA's is restored when that one is
+static void io_utils_spi_apply_hard_mode(io_utils_spi_st* dev, io_utils_spi_chip_st* chip)
+{
+    if (chip->chip_type == io_utils_spi_chip_ice40_prog)
+    {
+        if (dev->no_cs_chip != chip) spi_set_mode(&chip->hard_dev.spidev, chip->mode | SPI_NO_CS);
+        dev->no_cs_chip = chip;
+    }
+    else if (dev->no_cs_chip != NULL && io_utils_spi_same_hard_dev(dev->no_cs_chip, chip))
+    {
+        spi_set_mode(&chip->hard_dev.spidev, chip->mode);
+        dev->no_cs_chip = NULL;
+    }
+}
+
+//=====================================================================================
+static int io_utils_spi_hard_bufsiz(void)
+{
+    static int bufsiz = 0;
+    if (bufsiz == 0)
+    {
+        FILE* f = fopen(IO_UTILS_SPI_HARD_BUFSIZ_PATH, "r");
+        if (f == NULL || fscanf(f, "%d", &bufsiz) != 1 || bufsiz <= 0) bufsiz = IO_UTILS_SPI_HARD_DEFAULT_BUFSIZ;
+        if (f != NULL) fclose(f);
+    }
+    return bufsiz;
+}
+
 //=====================================================================================
 static int io_utils_spi_setup_chip(io_utils_spi_st* dev, int handle)
 {
@@ -44,179 +119,100 @@ static int io_utils_spi_setup_chip(io_utils_spi_st* dev, int handle)
         // nothing to setup => return
         return 0;
     }
-    
-    if (dev->chips[handle].chip_type == io_utils_spi_chip_ice40_prog ||
-        dev->chips[handle].chip_type == io_utils_spi_chip_type_rffc ||
-        dev->chips[handle].chip_type == io_utils_spi_chip_type_modem_bitbang)
-    {
-        //printf("Info @ io_utils_spi_setup_chip: Switching SPI to GPIO mode\n");
-
-        // ICE40 PROG
-        int mosi_pin = chip->miso_mosi_swap?dev->miso:dev->mosi;
-        int miso_pin = chip->miso_mosi_swap?dev->mosi:dev->miso;
-        int cs_pin = chip->cs_pin;
-        int sck_pin = dev->sck;
-        io_utils_set_gpio_mode(cs_pin, io_utils_alt_gpio_out);
-        io_utils_set_gpio_mode(miso_pin, io_utils_alt_gpio_in);
-        io_utils_set_gpio_mode(mosi_pin, io_utils_alt_gpio_out);
-        io_utils_set_gpio_mode(sck_pin, io_utils_alt_gpio_out);
-        dev->current_chip = chip;
-        return 0;
-    }
+    dev->current_chip = chip;
 
-    // here we have a generic SPI_DEV device
-    // -------------------------------------
-    int setup_spi_dev = 0;
-    if (dev->current_chip == NULL )
+    // the bit-banged chips' CS lines were set up when they were added, so
+    // only the shared lines may need a new function - and not between two
+    // chips of the same kind (e.g. the mixer and the ice40 programmer)
+    io_utils_spi_bus_mode_en prev_mode = dev->bus_mode;
+    if (chip->is_hard_spi)
     {
-        setup_spi_dev = 1;
+        io_utils_spi_set_bus_mode(dev, io_utils_spi_bus_mode_hard);
+        io_utils_spi_apply_hard_mode(dev, chip);
     }
-    else if (dev->current_chip->chip_type == io_utils_spi_chip_ice40_prog ||
-             dev->current_chip->chip_type == io_utils_spi_chip_type_rffc ||
-             dev->current_chip->chip_type == io_utils_spi_chip_type_modem_bitbang )
+    else
     {
-        setup_spi_dev = 1;
+        io_utils_spi_set_bus_mode(dev, chip->miso_mosi_swap ? io_utils_spi_bus_mode_gpio_swapped :
+                                                              io_utils_spi_bus_mode_gpio);
     }
 
-    if (setup_spi_dev)
-    {
-        //printf("Info @ io_utils_spi_setup_chip: Switching SPI to hard_spi mode\n");
-        // Setup the configuration of a regular spi_dev
-        //io_utils_set_gpio_mode(chip->cs_pin, io_utils_alt_4);
-        io_utils_set_gpio_mode(dev->miso, io_utils_alt_4);
-        io_utils_set_gpio_mode(dev->mosi, io_utils_alt_4);
-        io_utils_set_gpio_mode(dev->sck, io_utils_alt_4);
-        io_utils_usleep(100);
-    }
-
-    return setup_spi_dev;
+    return chip->is_hard_spi && prev_mode != io_utils_spi_bus_mode_hard;
 }
 
 //=====================================================================================
 static int io_utils_spi_write_rffc507x(io_utils_spi_st* dev, io_utils_spi_chip_st* chip, uint8_t reg, uint16_t val)
 {
-    int bits = 25;
-    int nop_cnt = 200;
-	int msb = 1 << (bits - 1);
+    (void)dev;
+    io_utils_bitbang_bus_st* bus = &chip->bitbang;
     uint32_t data = reg;
 	data = ((data & 0x7f) << 16) | val;
 
-    //printf("==> io_utils_spi_write_rffc507x: %06X\n", data);
-
-    int sdata_pin = chip->miso_mosi_swap?dev->miso:dev->mosi;
-    int sclk_pin = dev->sck;
-    int enx_pin = chip->cs_pin;
-
-    // set SDATA line as output
-    io_utils_setup_gpio(sdata_pin, io_utils_dir_output, io_utils_pull_down);
+    // SDATA is an output whenever the lines are in GPIO mode (the pull-down
+    // was set when the chip was added)
 
     // make sure everything is starting in the correct state
-    io_utils_write_gpio_with_wait(enx_pin, 1, nop_cnt);
-    io_utils_write_gpio_with_wait(sclk_pin, 0, nop_cnt);
-    io_utils_write_gpio_with_wait(sdata_pin, 0, nop_cnt);
+    io_utils_bitbang_cs(bus, 1);
+    io_utils_bitbang_mosi(bus, 0);
 
 	/*
 	 * The device requires two clocks while ENX is high before a serial
 	 * transaction.  This is not clearly documented.
 	 */
-    io_utils_write_gpio_with_wait(sclk_pin, 1, nop_cnt);
-    io_utils_write_gpio_with_wait(sclk_pin, 0, nop_cnt);
-    io_utils_write_gpio_with_wait(sclk_pin, 1, nop_cnt);
-    io_utils_write_gpio_with_wait(sclk_pin, 0, nop_cnt);
+    io_utils_bitbang_clock(bus, 2);
 
 	// start transaction by bringing ENX low
-    io_utils_write_gpio_with_wait(enx_pin, 0, nop_cnt);
-
-    while (bits--)
-	{
-        io_utils_write_gpio_with_wait(sdata_pin, (data & msb)?1:0, nop_cnt);
-		data <<= 1;
-        io_utils_write_gpio_with_wait(sclk_pin, 1, nop_cnt);
-        io_utils_write_gpio_with_wait(sclk_pin, 0, nop_cnt);
-	}
-
-	io_utils_write_gpio_with_wait(enx_pin, 1, nop_cnt);
+    io_utils_bitbang_cs(bus, 0);
+    io_utils_bitbang_shift_out(bus, data, 25);
+	io_utils_bitbang_cs(bus, 1);
 
 	/*
 	 * The device requires a clock while ENX is high after a serial
 	 * transaction.  This is not clearly documented.
 	 */
-	io_utils_write_gpio_with_wait(sclk_pin, 1, nop_cnt);
-    io_utils_write_gpio_with_wait(sclk_pin, 0, nop_cnt);
+	io_utils_bitbang_clock(bus, 1);
     return 0;
 }
 
 //=====================================================================================
 static int io_utils_spi_read_rffc507x(io_utils_spi_st* dev, io_utils_spi_chip_st* chip, uint8_t reg)
 {
-	int bits = 9;
-    int nop_cnt = 200;
-	int msb = 1 << (bits -1);
+    io_utils_bitbang_bus_st* bus = &chip->bitbang;
 	uint32_t data = 0x80 | (reg & 0x7f);
 
     int sdata_pin = chip->miso_mosi_swap?dev->miso:dev->mosi;
-    int sclk_pin = dev->sck;
-    int enx_pin = chip->cs_pin;
-
-    // set SDATA line as output
-    io_utils_setup_gpio(sdata_pin, io_utils_dir_output, io_utils_pull_down);
 
 	// make sure everything is starting in the correct state
-    io_utils_write_gpio_with_wait(enx_pin, 1, nop_cnt);
-    io_utils_write_gpio_with_wait(sclk_pin, 0, nop_cnt);
-    io_utils_write_gpio_with_wait(sdata_pin, 0, nop_cnt);
+    io_utils_bitbang_cs(bus, 1);
+    io_utils_bitbang_mosi(bus, 0);
 
 	/*
 	 * The device requires two clocks while ENX is high before a serial
 	 * transaction.  This is not clearly documented.
 	 */
-    io_utils_write_gpio_with_wait(sclk_pin, 1, nop_cnt);
-    io_utils_write_gpio_with_wait(sclk_pin, 0, nop_cnt);
-    io_utils_write_gpio_with_wait(sclk_pin, 1, nop_cnt);
-    io_utils_write_gpio_with_wait(sclk_pin, 0, nop_cnt);
+    io_utils_bitbang_clock(bus, 2);
 
 	// start transaction by bringing ENX low
-    io_utils_write_gpio_with_wait(enx_pin, 0, nop_cnt);
-
-	while (bits--)
-	{
-        io_utils_write_gpio_with_wait(sdata_pin, (data & msb)?1:0, nop_cnt);
-		data <<= 1;
-        io_utils_write_gpio_with_wait(sclk_pin, 1, nop_cnt);
-        io_utils_write_gpio_with_wait(sclk_pin, 0, nop_cnt);
-	}
+    io_utils_bitbang_cs(bus, 0);
+    io_utils_bitbang_shift_out(bus, data, 9);
 
-    io_utils_write_gpio_with_wait(sclk_pin, 1, nop_cnt);
-    io_utils_write_gpio_with_wait(sclk_pin, 0, nop_cnt);
+    // turnaround clock
+    io_utils_bitbang_clock(bus, 1);
 
-	bits = 16;
-	data = 0;
+	// set SDATA line as input (direction only - the pull-down stays)
+    io_utils_set_gpio_mode(sdata_pin, io_utils_alt_gpio_in);
 
-	// set SDATA line as input - TBD - check if pull is needed
-    io_utils_setup_gpio(sdata_pin, io_utils_dir_input, io_utils_pull_down);
-
-	while (bits--)
-	{
-		data <<= 1;
-
-        io_utils_write_gpio_with_wait(sclk_pin, 1, nop_cnt);
-        io_utils_write_gpio_with_wait(sclk_pin, 0, nop_cnt);
-        data |= io_utils_read_gpio(sdata_pin) & 0x1;
-	}
+    data = io_utils_bitbang_shift_in(bus, 16);
 
 	// set SDATA line as output
-    io_utils_setup_gpio(sdata_pin, io_utils_dir_output, io_utils_pull_down);
+    io_utils_set_gpio_mode(sdata_pin, io_utils_alt_gpio_out);
 
-	io_utils_write_gpio_with_wait(enx_pin, 1, nop_cnt);
+	io_utils_bitbang_cs(bus, 1);
 
 	/*
 	 * The device requires a clock while ENX is high after a serial
 	 * transaction.  This is not clearly documented.
 	 */
-	io_utils_write_gpio_with_wait(sclk_pin, 1, nop_cnt);
-    io_utils_write_gpio_with_wait(sclk_pin, 0, nop_cnt);
-
-    //printf("==>The read data is: %06X\n", data);
+	io_utils_bitbang_clock(bus, 1);
 
 	return data;
 }
@@ -225,29 +221,29 @@ static int io_utils_spi_read_rffc507x(io_utils_spi_st* dev, io_utils_spi_chip_st
 static int io_utils_ice40_transfer_spi(io_utils_spi_st* dev, io_utils_spi_chip_st* chip,
                                         const uint8_t *tx, unsigned int len)
 {
-    int nop_cnt = 400;
-    int data_pin = chip->miso_mosi_swap?dev->miso:dev->mosi;
-    int sck_pin = dev->sck;
-
+    (void)dev;
     // in this case the chipselect is controlled outside due to
     // ice40 FPGA specifics
+    if (!chip->is_hard_spi)
+    {
+        io_utils_bitbang_write_bytes(&chip->bitbang, tx, len);
+        return 0;
+    }
 
-	for (unsigned int byte_num = 0; byte_num < len; byte_num++)
-	{
-		uint8_t current_tx_byte = tx[byte_num];
-
-		for (int bit = 0; bit < 8; bit ++)
-		{
-            io_utils_write_gpio_with_wait(data_pin, (current_tx_byte&0x80)>>7, nop_cnt);
-
-			current_tx_byte <<= 1;
-            io_utils_write_gpio_with_wait(sck_pin, 1, nop_cnt);
-            io_utils_write_gpio_with_wait(sck_pin, 0, nop_cnt);
-		}
-	}
-
-    io_utils_write_gpio_with_wait(sck_pin, 0, nop_cnt / 2);
-
+    // the controller at the chip's clock (the device's own max speed is the FPGA's)
+    unsigned int max_len = (unsigned int)io_utils_spi_hard_bufsiz();
+    while (len)
+    {
+        unsigned int chunk = len < max_len ? len : max_len;
+        struct spi_ioc_transfer xfer = {
+            .tx_buf = (__u64)(uintptr_t)tx,
+            .len = chunk,
+            .speed_hz = chip->clock,
+        };
+        if (spi_exchange_multi(&chip->hard_dev.spidev, &xfer, 1) < 0) return -1;
+        tx += chunk;
+        len -= chunk;
+    }
 	return 0;
 }
 
@@ -255,35 +251,12 @@ static int io_utils_ice40_transfer_spi(io_utils_spi_st* dev, io_utils_spi_chip_s
 static int io_utils_modem_bitbang_transfer_spi(io_utils_spi_st* dev, io_utils_spi_chip_st* chip,
                                                 const uint8_t *tx, uint8_t *rx, unsigned int len)
 {
-    int nop_cnt = 200;
-    int cs_pin = chip->cs_pin;
-    int mosi_pin = chip->miso_mosi_swap?dev->miso:dev->mosi;
-    int miso_pin = chip->miso_mosi_swap?dev->mosi:dev->miso;
-    int sck_pin = dev->sck;
+    (void)dev;
+    io_utils_bitbang_bus_st* bus = &chip->bitbang;
 
-    io_utils_write_gpio_with_wait(cs_pin, 0, nop_cnt);
-
-	for (unsigned int byte_num = 0; byte_num < len; byte_num++)
-	{
-		uint8_t current_tx_byte = tx[byte_num];
-        uint8_t rx_byte = 0;
-        int bit = 8;
-
-		while (bit--)
-		{
-            io_utils_write_gpio_with_wait(mosi_pin, (current_tx_byte&0x80)>>7, nop_cnt);
-
-			current_tx_byte <<= 1;
-            io_utils_write_gpio_with_wait(sck_pin, 1, nop_cnt);
-            rx_byte <<= 1;
-            rx_byte |= io_utils_read_gpio(miso_pin);
-            io_utils_write_gpio_with_wait(sck_pin, 0, nop_cnt/2);
-		}
-        rx[byte_num] = rx_byte;
-	}
-
-    io_utils_write_gpio(sck_pin, 0);
-    io_utils_write_gpio_with_wait(cs_pin, 1, nop_cnt/2);
+    io_utils_bitbang_cs(bus, 0);
+    io_utils_bitbang_exchange(bus, tx, rx, len);
+    io_utils_bitbang_cs(bus, 1);
 
 	return 0;
 }
@@ -305,6 +278,7 @@ int io_utils_spi_init(io_utils_spi_st* dev)
 	memset (dev->chips, 0, sizeof(dev->chips));
 	dev->num_of_chips = 0;
 	dev->current_chip = NULL;
+	dev->no_cs_chip = NULL;
 
     // initialize the hard handles
     for (int i = 0; i < IO_UTILS_MAX_CHIPS; i++)
@@ -325,6 +299,10 @@ int io_utils_spi_init(io_utils_spi_st* dev)
     io_utils_set_gpio_mode(dev->miso, io_utils_alt_4);
     io_utils_set_gpio_mode(dev->mosi, io_utils_alt_4);
     io_utils_set_gpio_mode(dev->sck, io_utils_alt_4);
+    dev->bus_mode = io_utils_spi_bus_mode_hard;
+    dev->group_depth = 0;
+    dev->num_deferred = 0;
+    memset(&dev->stats, 0, sizeof(dev->stats));
 
     pthread_mutex_unlock(&dev->mtx);
 
@@ -373,7 +351,39 @@ int io_utils_spi_close(io_utils_spi_st* dev)
     memset (dev->chips, 0, sizeof(dev->chips));
 	dev->num_of_chips = 0;
 	dev->current_chip = NULL;
+	dev->no_cs_chip = NULL;
+    dev->bus_mode = io_utils_spi_bus_mode_unknown;
+    if (dev->num_deferred) ZF_LOGW("dropping %d held back transfers", dev->num_deferred);
+    dev->num_deferred = 0;
+    dev->group_depth = 0;
+
+    return 0;
+}
+
+//=====================================================================================
+// the ice40 programmer on the SPI controller - it shares the FPGA's spidev and holds
+// CS itself, so the device has to accept SPI_NO_CS. 0 = added, -1 = stay bit-banged
+static int io_utils_spi_add_ice40_hard(io_utils_spi_st* dev, io_utils_spi_chip_st* chip, io_utils_hard_spi_st *hard_dev)
+{
+    char spi_device_file[32];
+    memcpy (&chip->hard_dev, hard_dev, sizeof(io_utils_hard_spi_st));
+    sprintf(spi_device_file, "/dev/spidev%d.%d", hard_dev->spi_dev_id, hard_dev->spi_dev_channel);
 
+    // no max speed - the transfers carry the chip's clock
+    int res = spi_init(&chip->hard_dev.spidev, spi_device_file, chip->mode | SPI_NO_CS, 0, 0);
+    if (res < 0 || !(chip->hard_dev.spidev.mode & SPI_NO_CS))
+    {
+        ZF_LOGW("'%s' doesn't take SPI_NO_CS (%s) - the ice40 programmer stays bit-banged",
+                    spi_device_file, res < 0 ? spi_get_code_desc(res) : "mode not accepted");
+        // a rejected mode leaves the device as it was
+        if (res == 0) spi_set_mode(&chip->hard_dev.spidev, chip->mode);
+        if (chip->hard_dev.spidev.fd >= 0) spi_free(&chip->hard_dev.spidev);
+        return -1;
+    }
+
+    // the device is in the programmer's mode now
+    dev->no_cs_chip = chip;
+    dev->current_chip = NULL;
     return 0;
 }
 
@@ -414,6 +424,8 @@ int io_utils_spi_add_chip(io_utils_spi_st* dev, int cs_pin, int speed, int swap_
     dev->chips[new_chip_index].cs_pin = cs_pin;
     dev->chips[new_chip_index].miso_mosi_swap = swap_mi_mo;
     dev->chips[new_chip_index].chip_type = chip_type;
+    dev->chips[new_chip_index].clock = speed;
+    dev->chips[new_chip_index].mode = mode;
     dev->chips[new_chip_index].is_hard_spi = 0;
 
     // now lets check if we need a hard spi handle (not a bitbanged configuration)
@@ -438,6 +450,28 @@ int io_utils_spi_add_chip(io_utils_spi_st* dev, int cs_pin, int speed, int swap_
         
         dev->chips[new_chip_index].is_hard_spi = 1;
     }
+    else if (chip_type == io_utils_spi_chip_ice40_prog && hard_dev != NULL &&
+             io_utils_spi_add_ice40_hard(dev, &dev->chips[new_chip_index], hard_dev) == 0)
+    {
+        dev->chips[new_chip_index].is_hard_spi = 1;
+    }
+    else
+    {
+        // the GPIO driven chips run at their rated clock
+        int mosi_pin = swap_mi_mo?dev->miso:dev->mosi;
+        int miso_pin = swap_mi_mo?dev->mosi:dev->miso;
+        if (chip_type == io_utils_spi_chip_type_rffc) miso_pin = mosi_pin;     // 3-wire, shared SDATA
+        if (chip_type == io_utils_spi_chip_ice40_prog) cs_pin = -1;           // CS is held by the programmer
+        io_utils_bitbang_bus_init(&dev->chips[new_chip_index].bitbang, dev->sck, mosi_pin, miso_pin, cs_pin, speed);
+
+        // the CS line is the chip's own - released and set up once, not on every chip switch
+        if (cs_pin >= 0)
+        {
+            io_utils_write_gpio(cs_pin, 1);
+            io_utils_set_gpio_mode(cs_pin, io_utils_alt_gpio_out);
+        }
+        if (chip_type == io_utils_spi_chip_type_rffc) io_utils_set_pullupdn(mosi_pin, io_utils_pull_down);
+    }
 
     dev->chips[new_chip_index].initialized = 1;
     
@@ -464,6 +498,7 @@ int io_utils_spi_suspend(io_utils_spi_st* dev, bool suspend)
 		io_utils_setup_gpio(dev->miso, io_utils_dir_input, io_utils_pull_off);
 		io_utils_setup_gpio(dev->mosi, io_utils_dir_input, io_utils_pull_off);
 		io_utils_setup_gpio(dev->sck, io_utils_dir_input, io_utils_pull_off);
+		dev->bus_mode = io_utils_spi_bus_mode_unknown;
 	}
 	else
 	{
@@ -471,6 +506,14 @@ int io_utils_spi_suspend(io_utils_spi_st* dev, bool suspend)
 		io_utils_set_gpio_mode(dev->miso, io_utils_alt_4);
 		io_utils_set_gpio_mode(dev->mosi, io_utils_alt_4);
 		io_utils_set_gpio_mode(dev->sck, io_utils_alt_4);
+		dev->bus_mode = io_utils_spi_bus_mode_hard;
+
+		// the mixer's SDATA pull-down was released with the lines
+		for (int i = 0; i < IO_UTILS_MAX_CHIPS; i++)
+		{
+			if (!dev->chips[i].initialized || dev->chips[i].chip_type != io_utils_spi_chip_type_rffc) continue;
+			io_utils_set_pullupdn(dev->chips[i].miso_mosi_swap?dev->miso:dev->mosi, io_utils_pull_down);
+		}
 	}
 
 	return 0;
@@ -496,11 +539,17 @@ int io_utils_spi_remove_chip(io_utils_spi_st* dev, int chip_handle)
         return -1;
     }
 
-    if (dev->chips[chip_handle].chip_type == io_utils_spi_chip_type_fpga_comm ||
-        dev->chips[chip_handle].chip_type == io_utils_spi_chip_type_modem)
+    if (dev->chips[chip_handle].is_hard_spi)
     {
+        if (dev->no_cs_chip == &dev->chips[chip_handle])
+        {
+            // hand the device back with its regular mode
+            spi_set_mode(&dev->chips[chip_handle].hard_dev.spidev, dev->chips[chip_handle].mode);
+            dev->no_cs_chip = NULL;
+        }
         spi_free(&dev->chips[chip_handle].hard_dev.spidev);
     }
+    if (dev->current_chip == &dev->chips[chip_handle]) dev->current_chip = NULL;
     dev->chips[chip_handle].initialized = 0;
     dev->num_of_chips -= 1;
     pthread_mutex_unlock(&dev->mtx);
@@ -508,36 +557,21 @@ int io_utils_spi_remove_chip(io_utils_spi_st* dev, int chip_handle)
 }
 
 //=====================================================================================
-int io_utils_spi_transmit(io_utils_spi_st* dev, int chip_handle,
+static int io_utils_spi_transmit_locked(io_utils_spi_st* dev, int chip_handle,
 							const unsigned char* tx_buf,
 							unsigned char* rx_buf,
 							size_t length,
                             io_utils_spi_dir_en dir)
 {
     int ret = 0;
-    if (dev == NULL || !dev->initialized)
-    {
-        ZF_LOGE("uninitialized device");
-        return -1;
-    }
-    if (dev->chips[chip_handle].initialized == 0)
-    {
-        ZF_LOGE("uninitialized spi chip handle %d", chip_handle);
-        return -1;
-    }
-
-    // lock the resource
-    pthread_mutex_lock(&dev->mtx);
 
     int set_up_hard = io_utils_spi_setup_chip(dev, chip_handle);
     if (set_up_hard < 0)
     {
         ZF_LOGE("chip setup failed %d", chip_handle);
-        goto io_utils_spi_transmit_error;
+        return -1;
     }
 
-    dev->current_chip = &dev->chips[chip_handle];
-    
     //printf("dev->current_chip->chip_type ====== %d\n", dev->current_chip->chip_type);
 
     switch (dev->current_chip->chip_type)
@@ -553,7 +587,7 @@ int io_utils_spi_transmit(io_utils_spi_st* dev, int chip_handle,
             if (ret < 0)
             {
                 ZF_LOGE("spi transfer failed (%d)", ret);
-                goto io_utils_spi_transmit_error;
+                return -1;
             }
         }
         break;
@@ -568,7 +602,7 @@ int io_utils_spi_transmit(io_utils_spi_st* dev, int chip_handle,
                 if (r < 0)
                 {
                     ZF_LOGE("rffc507x read transfer failed");
-                    goto io_utils_spi_transmit_error;
+                    return -1;
                 }
                 *((uint16_t*)rx_buf) = (uint16_t)(r & 0xFFFF);
             }
@@ -580,7 +614,7 @@ int io_utils_spi_transmit(io_utils_spi_st* dev, int chip_handle,
                 if (r < 0)
                 {
                     ZF_LOGE("rffc507x write transfer failed");
-                    goto io_utils_spi_transmit_error;
+                    return -1;
                 }
             }
         }
@@ -589,7 +623,11 @@ int io_utils_spi_transmit(io_utils_spi_st* dev, int chip_handle,
         // --------------------------------------------------
         case io_utils_spi_chip_ice40_prog:
         {
-            io_utils_ice40_transfer_spi(dev, dev->current_chip, tx_buf, length);
+            if (io_utils_ice40_transfer_spi(dev, dev->current_chip, tx_buf, length) < 0)
+            {
+                ZF_LOGE("ice40 bitstream transfer failed");
+                return -1;
+            }
         }
         break;
 
@@ -608,12 +646,259 @@ int io_utils_spi_transmit(io_utils_spi_st* dev, int chip_handle,
         break;
     }
 
+    return 0;
+}
+
+//=====================================================================================
+static int io_utils_spi_flush_deferred_locked(io_utils_spi_st* dev)
+{
+    int ret = 0;
+    if (dev->num_deferred == 0) return 0;
+
+    // one GPIO session for all of them
+    for (int i = 0; i < dev->num_deferred; i++)
+    {
+        io_utils_spi_deferred_st* x = &dev->deferred[i];
+        if (io_utils_spi_transmit_locked(dev, x->chip_handle, x->tx, NULL, x->length, io_utils_spi_write) < 0)
+        {
+            ZF_LOGE("held back transfer %d to chip %d failed", i, x->chip_handle);
+            ret = -1;
+        }
+    }
+    dev->num_deferred = 0;
+    dev->stats.group_flushes++;
+    return ret;
+}
+
+//=====================================================================================
+int io_utils_spi_transmit(io_utils_spi_st* dev, int chip_handle,
+							const unsigned char* tx_buf,
+							unsigned char* rx_buf,
+							size_t length,
+                            io_utils_spi_dir_en dir)
+{
+    int ret = 0;
+    if (dev == NULL || !dev->initialized)
+    {
+        ZF_LOGE("uninitialized device");
+        return -1;
+    }
+    if (dev->chips[chip_handle].initialized == 0)
+    {
+        ZF_LOGE("uninitialized spi chip handle %d", chip_handle);
+        return -1;
+    }
+
+    // lock the resource
+    pthread_mutex_lock(&dev->mtx);
+
+    io_utils_spi_chip_st* chip = &dev->chips[chip_handle];
+    if (!chip->is_hard_spi)
+    {
+        // the mixer's writes don't return anything - inside a group they wait
+        // for the next GPIO session, keeping their order
+        if (dev->group_depth > 0 &&
+            chip->chip_type == io_utils_spi_chip_type_rffc &&
+            dir == io_utils_spi_write &&
+            length <= IO_UTILS_SPI_DEFER_MAX_LEN)
+        {
+            if (dev->num_deferred >= IO_UTILS_SPI_DEFER_MAX_XFERS)
+            {
+                io_utils_spi_flush_deferred_locked(dev);
+            }
+            io_utils_spi_deferred_st* x = &dev->deferred[dev->num_deferred++];
+            x->chip_handle = chip_handle;
+            x->length = length;
+            memcpy(x->tx, tx_buf, length);
+            dev->stats.deferred_xfers++;
+            pthread_mutex_unlock(&dev->mtx);
+            return 0;
+        }
+
+        // anything else on the GPIO lines goes after the held back writes
+        io_utils_spi_flush_deferred_locked(dev);
+    }
+
+    ret = io_utils_spi_transmit_locked(dev, chip_handle, tx_buf, rx_buf, length, dir);
+    pthread_mutex_unlock(&dev->mtx);
+    return ret;
+}
+
+//=====================================================================================
+int io_utils_spi_group_begin(io_utils_spi_st* dev)
+{
+    if (dev == NULL || !dev->initialized)
+    {
+        ZF_LOGE("uninitialized device");
+        return -1;
+    }
+
+    pthread_mutex_lock(&dev->mtx);
+    dev->group_depth++;
     pthread_mutex_unlock(&dev->mtx);
     return 0;
+}
+
+//=====================================================================================
+int io_utils_spi_group_end(io_utils_spi_st* dev)
+{
+    int ret = 0;
+    if (dev == NULL || !dev->initialized)
+    {
+        ZF_LOGE("uninitialized device");
+        return -1;
+    }
+
+    pthread_mutex_lock(&dev->mtx);
+    if (dev->group_depth > 0) dev->group_depth--;
+    if (dev->group_depth == 0) ret = io_utils_spi_flush_deferred_locked(dev);
+    pthread_mutex_unlock(&dev->mtx);
+    return ret;
+}
+
+//=====================================================================================
+void io_utils_spi_get_stats(io_utils_spi_st* dev, io_utils_spi_stats_st* stats)
+{
+    if (dev == NULL || stats == NULL) return;
+    pthread_mutex_lock(&dev->mtx);
+    *stats = dev->stats;
+    pthread_mutex_unlock(&dev->mtx);
+}
+
+//=====================================================================================
+void io_utils_spi_reset_stats(io_utils_spi_st* dev)
+{
+    if (dev == NULL) return;
+    pthread_mutex_lock(&dev->mtx);
+    memset(&dev->stats, 0, sizeof(dev->stats));
+    pthread_mutex_unlock(&dev->mtx);
+}
+
+//=====================================================================================
+void io_utils_spi_batch_init(io_utils_spi_batch_st* batch, int chip_handle)
+{
+    batch->chip_handle = chip_handle;
+    batch->num_xfers = 0;
+    batch->num_bytes = 0;
+}
+
+//=====================================================================================
+int io_utils_spi_batch_add(io_utils_spi_batch_st* batch, const unsigned char* tx_buf, size_t length)
+{
+    if (batch->num_xfers >= IO_UTILS_SPI_BATCH_MAX_XFERS ||
+        batch->num_bytes + length > IO_UTILS_SPI_BATCH_MAX_BYTES ||
+        length == 0)
+    {
+        // full - the caller submits and starts a new batch
+        return -1;
+    }
+
+    int index = batch->num_xfers++;
+    batch->offset[index] = batch->num_bytes;
+    batch->length[index] = length;
+    if (tx_buf) memcpy(batch->tx + batch->num_bytes, tx_buf, length);
+    else memset(batch->tx + batch->num_bytes, 0, length);
+    memset(batch->rx + batch->num_bytes, 0, length);
+    batch->num_bytes += length;
+    return index;
+}
+
+//=====================================================================================
+unsigned char* io_utils_spi_batch_rx(io_utils_spi_batch_st* batch, int index)
+{
+    if (index < 0 || index >= batch->num_xfers) return NULL;
+    return batch->rx + batch->offset[index];
+}
+
+//=====================================================================================
+int io_utils_spi_transmit_batch(io_utils_spi_st* dev, io_utils_spi_batch_st* batch)
+{
+    int chip_handle = batch->chip_handle;
+    if (batch->num_xfers == 0)
+    {
+        return 0;
+    }
+    if (dev == NULL || !dev->initialized)
+    {
+        ZF_LOGE("uninitialized device");
+        return -1;
+    }
+    if (dev->chips[chip_handle].initialized == 0)
+    {
+        ZF_LOGE("uninitialized spi chip handle %d", chip_handle);
+        return -1;
+    }
+
+    if (!dev->chips[chip_handle].is_hard_spi)
+    {
+        // bit-banged chips - one transaction after the other
+        for (int i = 0; i < batch->num_xfers; i++)
+        {
+            if (io_utils_spi_transmit(dev, chip_handle, batch->tx + batch->offset[i], batch->rx + batch->offset[i],
+                                        batch->length[i], io_utils_spi_read_write) < 0)
+            {
+                return -1;
+            }
+        }
+        return 0;
+    }
+
+    struct spi_ioc_transfer xfer[IO_UTILS_SPI_BATCH_MAX_XFERS];
+    memset(xfer, 0, sizeof(xfer));
+    for (int i = 0; i < batch->num_xfers; i++)
+    {
+        xfer[i].tx_buf = (__u64)(uintptr_t)(batch->tx + batch->offset[i]);
+        xfer[i].rx_buf = (__u64)(uintptr_t)(batch->rx + batch->offset[i]);
+        xfer[i].len = (__u32)batch->length[i];
+
+        // release the chip-select between the transactions (not after the last)
+        xfer[i].cs_change = (i < batch->num_xfers - 1) ? 1 : 0;
+    }
+
+    // lock the resource
+    pthread_mutex_lock(&dev->mtx);
+
+    if (io_utils_spi_setup_chip(dev, chip_handle) < 0)
+    {
+        ZF_LOGE("chip setup failed %d", chip_handle);
+        pthread_mutex_unlock(&dev->mtx);
+        return -1;
+    }
+
+    int ret = spi_exchange_multi(&dev->current_chip->hard_dev.spidev, xfer, batch->num_xfers);
+    pthread_mutex_unlock(&dev->mtx);
+    if (ret < 0)
+    {
+        ZF_LOGE("spi batch of %d transfers failed (%d)", batch->num_xfers, ret);
+        return -1;
+    }
+    return 0;
+}
+
+//=====================================================================================
+float io_utils_spi_benchmark_bitbang(io_utils_spi_st* dev, int chip_handle, uint32_t bits)
+{
+    if (dev == NULL || !dev->initialized || dev->chips[chip_handle].initialized == 0)
+    {
+        ZF_LOGE("uninitialized device or chip handle %d", chip_handle);
+        return -1.0f;
+    }
+    io_utils_spi_chip_st* chip = &dev->chips[chip_handle];
+    if (chip->is_hard_spi)
+    {
+        ZF_LOGE("chip handle %d is not bit-banged", chip_handle);
+        return -1.0f;
+    }
+
+    pthread_mutex_lock(&dev->mtx);
+    io_utils_spi_flush_deferred_locked(dev);
+    io_utils_spi_setup_chip(dev, chip_handle);
 
-io_utils_spi_transmit_error:
+    // the chip ignores the clocks while its CS is released
+    io_utils_bitbang_cs(&chip->bitbang, 1);
+    float rate = io_utils_bitbang_benchmark(&chip->bitbang, bits);
     pthread_mutex_unlock(&dev->mtx);
-    return -1;
+    return rate;
 }
 
 //=====================================================================================
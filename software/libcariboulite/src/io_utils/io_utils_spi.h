@@ -10,11 +10,31 @@ extern "C" {
 #include <stdbool.h>
 #include <pthread.h>
 #include "io_utils.h"
+#include "io_utils_bitbang.h"
 #include "spidev/spi.h"
 
 
 #define IO_UTILS_MAX_CHIPS	10
 
+// a batch of independent chip-select transactions submitted in one syscall
+#define IO_UTILS_SPI_BATCH_MAX_XFERS	16
+#define IO_UTILS_SPI_BATCH_MAX_BYTES	1024
+
+// bit-banged writes held back inside a transaction group (io_utils_spi_group_begin)
+#define IO_UTILS_SPI_DEFER_MAX_XFERS	32
+#define IO_UTILS_SPI_DEFER_MAX_LEN		4
+
+// a bulk write to a hard SPI chip (the ice40 bitstream) is split into transfers of the
+// spidev buffer size (/sys/module/spidev/parameters/bufsiz, 4096 unless raised)
+#define IO_UTILS_SPI_HARD_DEFAULT_BUFSIZ	4096
+#define IO_UTILS_SPI_HARD_BUFSIZ_PATH		"/sys/module/spidev/parameters/bufsiz"
+
+// wait after handing the lines back to the SPI controller. The function select
+// takes effect on the register write, so by default only a barrier is used
+#ifndef IO_UTILS_SPI_HARD_SETTLE_US
+	#define IO_UTILS_SPI_HARD_SETTLE_US	0
+#endif
+
 typedef enum
 {
 	io_utils_spi_chip_type_fpga_comm = 0,
@@ -24,6 +44,14 @@ typedef enum
 	io_utils_spi_chip_type_modem_bitbang = 4,
 } io_utils_spi_chip_type_en;
 
+typedef enum
+{
+	io_utils_spi_bus_mode_unknown = 0,
+	io_utils_spi_bus_mode_hard = 1,				// MISO / MOSI / SCK on ALT4 (spidev)
+	io_utils_spi_bus_mode_gpio = 2,				// GPIO driven (the bit-banged chips)
+	io_utils_spi_bus_mode_gpio_swapped = 3,		// GPIO driven, MISO / MOSI swapped
+} io_utils_spi_bus_mode_en;
+
 typedef enum
 {
 	io_utils_spi_read_write = 0,
@@ -49,8 +77,25 @@ typedef struct
 	int initialized;
 	io_utils_spi_chip_type_en chip_type;
 	int is_hard_spi;
+	io_utils_bitbang_bus_st bitbang;	// the GPIO driven chips, timed to "clock"
 } io_utils_spi_chip_st;
 
+typedef struct
+{
+	uint32_t switches_to_hard;		// lines handed to the SPI controller
+	uint32_t switches_to_gpio;		// lines taken over for the bit-banged chips
+	uint32_t switches_avoided;		// chip changes that kept the lines' mode
+	uint32_t deferred_xfers;		// bit-banged writes held back in a group
+	uint32_t group_flushes;			// GPIO sessions that sent held back writes
+} io_utils_spi_stats_st;
+
+typedef struct
+{
+	int chip_handle;
+	size_t length;
+	uint8_t tx[IO_UTILS_SPI_DEFER_MAX_LEN];
+} io_utils_spi_deferred_st;
+
 typedef struct
 {
 	// pins
@@ -61,10 +106,29 @@ typedef struct
 	io_utils_spi_chip_st chips[IO_UTILS_MAX_CHIPS];
 	int num_of_chips;
 	io_utils_spi_chip_st *current_chip;
+	io_utils_spi_chip_st *no_cs_chip;	// its "no CS" mode is applied to the spidev it shares
 	pthread_mutex_t mtx;
 	int initialized;
+
+	// the lines' current function and the transaction grouping
+	io_utils_spi_bus_mode_en bus_mode;
+	int group_depth;
+	int num_deferred;
+	io_utils_spi_deferred_st deferred[IO_UTILS_SPI_DEFER_MAX_XFERS];
+	io_utils_spi_stats_st stats;
 } io_utils_spi_st;
 
+typedef struct
+{
+	int chip_handle;
+	int num_xfers;
+	size_t num_bytes;
+	size_t offset[IO_UTILS_SPI_BATCH_MAX_XFERS];
+	size_t length[IO_UTILS_SPI_BATCH_MAX_XFERS];
+	uint8_t tx[IO_UTILS_SPI_BATCH_MAX_BYTES];
+	uint8_t rx[IO_UTILS_SPI_BATCH_MAX_BYTES];
+} io_utils_spi_batch_st;
+
 int io_utils_spi_init(io_utils_spi_st* dev);
 int io_utils_spi_close(io_utils_spi_st* dev);
 int io_utils_spi_add_chip(io_utils_spi_st* dev, int cs_pin, int speed, int swap_mi_mo, int mode,
@@ -76,6 +140,34 @@ int io_utils_spi_transmit(io_utils_spi_st* dev, int chip_handle,
 							unsigned char* rx_buf,
 							size_t length,
                             io_utils_spi_dir_en dir);
+
+// SPI BATCHES
+// The transactions of a batch are submitted in order, each one with its own
+// chip-select cycle, in a single SPI_IOC_MESSAGE ioctl on the hard SPI chips
+// (FPGA and modem) and one after the other on the bit-banged ones. The RX data
+// of all of them is available together after io_utils_spi_transmit_batch.
+void io_utils_spi_batch_init(io_utils_spi_batch_st* batch, int chip_handle);
+int io_utils_spi_batch_add(io_utils_spi_batch_st* batch, const unsigned char* tx_buf, size_t length);
+unsigned char* io_utils_spi_batch_rx(io_utils_spi_batch_st* batch, int index);
+int io_utils_spi_transmit_batch(io_utils_spi_st* dev, io_utils_spi_batch_st* batch);
+
+// TRANSACTION GROUPS
+// MISO / MOSI / SCK are shared between the hard SPI chips (ALT4) and the
+// bit-banged ones (GPIO), and the lines only change function when a transfer
+// needs the other mode. Inside a group the writes to the RFFC507x are held
+// back (in order) and sent in a single GPIO session on io_utils_spi_group_end,
+// so the hard SPI transfers in between don't switch the lines back and forth.
+// A read from a bit-banged chip sends the held back writes first. Groups nest.
+int io_utils_spi_group_begin(io_utils_spi_st* dev);
+int io_utils_spi_group_end(io_utils_spi_st* dev);
+
+void io_utils_spi_get_stats(io_utils_spi_st* dev, io_utils_spi_stats_st* stats);
+void io_utils_spi_reset_stats(io_utils_spi_st* dev);
+
+// clock "bits" bits on a bit-banged chip's lines with its CS released and
+// return the achieved bit rate [bit/sec] (-1 = not a bit-banged chip)
+float io_utils_spi_benchmark_bitbang(io_utils_spi_st* dev, int chip_handle, uint32_t bits);
+
 void io_utils_spi_print_setup(io_utils_spi_st* dev);
 
 #ifdef __cplusplus
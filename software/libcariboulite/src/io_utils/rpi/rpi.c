@@ -18,10 +18,15 @@
 #include <stdbool.h>
 #include <unistd.h>
 #include <time.h>
+#include <pthread.h>
 //#include <bcm_host.h>
 
 #include "rpi.h"
 
+// the function select and pull registers are shared by all the pins - their
+// read-modify-write / GPPUD sequences are serialized between threads
+static pthread_mutex_t gpio_cfg_mtx = PTHREAD_MUTEX_INITIALIZER;
+
 // Documentation References
 // https://www.raspberrypi.com/documentation/computers/raspberry-pi.html
 // https://www.raspberrypi.com/documentation/computers/processors.html
@@ -497,6 +502,7 @@ void set_gpio(uint8_t pin, uint8_t fsel){
 	/* get base address (GPFSEL0 to GPFSEL5) using *(GPFSEL0 + (pin/10))
 	 * get mask using (alt << ((pin)%10)*3)
 	 */
+	 pthread_mutex_lock(&gpio_cfg_mtx);
 	 __sync_synchronize();
 	 volatile uint32_t *gpsel = (uint32_t *)(GPIO_GPFSEL0 + (pin/10));  	// get the GPFSEL0 pointer (GPFSEL0 ~ GPFSEL5) based on the pin number selected
 	 uint32_t mask = ~ (7 <<  (pin % 10)*3); 				// mask to reset fsel to 0 first
@@ -505,6 +511,7 @@ void set_gpio(uint8_t pin, uint8_t fsel){
 	 __sync_synchronize();
 	 *gpsel |= mask; 					     		// write new fsel value to gpselect pointer
 	 __sync_synchronize();
+	 pthread_mutex_unlock(&gpio_cfg_mtx);
 }
 
 // get the current GPIO function selection (Added David Michaeli / CaribouLabs)
@@ -623,6 +630,35 @@ void gpio_config(uint8_t pin, uint8_t mode) {
 	}
 }
 
+/* Configure a set of GPIO pins with a single read-modify-write per GPFSEL
+ * register (same mode values as gpio_config). The pins move straight to
+ * their new function, without the intermediate input state of set_gpio.
+ */
+void gpio_config_multi(const uint8_t *pins, const uint8_t *modes, int count)
+{
+	uint32_t clr[6] = {0};
+	uint32_t set[6] = {0};
+
+	for (int i = 0; i < count; i++)
+	{
+		if (pins[i] > 53 || modes[i] > 7) continue;
+		int shift = (pins[i] % 10) * 3;
+		clr[pins[i] / 10] |= 7 << shift;
+		set[pins[i] / 10] |= (uint32_t)modes[i] << shift;
+	}
+
+	pthread_mutex_lock(&gpio_cfg_mtx);
+	__sync_synchronize();
+	for (int reg = 0; reg < 6; reg++)
+	{
+		if (clr[reg] == 0) continue;
+		volatile uint32_t *gpsel = (uint32_t *)(GPIO_GPFSEL0 + reg);
+		*gpsel = (*gpsel & ~clr[reg]) | set[reg];
+	}
+	__sync_synchronize();
+	pthread_mutex_unlock(&gpio_cfg_mtx);
+}
+
 uint8_t get_gpio_config(uint8_t pin)
 {
     return get_gpio(pin);
@@ -677,6 +713,13 @@ void gpio_pulse(uint8_t pin, int td){
 	gpio_off(pin);  
 }
 
+/* The mmapped GPIO register block, for callers that access GPSET / GPCLR / GPLEV
+ * directly (NULL before rpi_init)
+ */
+volatile uint32_t* gpio_get_registers(void){
+	return GPIO_PERI_BASE;
+}
+
 /* Read the current state of a GPIO pin (input/output)
  *
  * return value
@@ -847,6 +890,7 @@ void gpio_reset_event(uint8_t pin) {
  * value = 2, 0x2 or 10b, Enable Pull-Up resistor
  */
 void gpio_enable_pud(uint8_t pin, uint8_t value) {
+	pthread_mutex_lock(&gpio_cfg_mtx);
 	if(value == 0){       
     		*GPIO_GPPUD = 0x0;	// Disable PUD/Pull-UP/Down
    	}
@@ -866,6 +910,7 @@ void gpio_enable_pud(uint8_t pin, uint8_t value) {
 	uswait(150);	/* required wait times based on bcm2835 manual */
 	*GPIO_GPPUD = 0x0;
 	clearBit(GPIO_GPPUDCLK0, pin);
+	pthread_mutex_unlock(&gpio_cfg_mtx);
 }
 
 /*********************************
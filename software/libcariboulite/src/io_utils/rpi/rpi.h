@@ -39,6 +39,8 @@ void mswait(uint32_t ms);  //millisecond time delay
  */
 void gpio_config(uint8_t pin, uint8_t mode);
 
+void gpio_config_multi(const uint8_t *pins, const uint8_t *modes, int count);
+
 uint8_t get_gpio_config(uint8_t pin);
 
 void gpio_input(uint8_t pin);
@@ -75,6 +77,9 @@ void gpio_reset_event(uint8_t pin);
 
 void gpio_enable_pud(uint8_t pin, uint8_t value);
 
+/* The mmapped GPIO register block (NULL before rpi_init) */
+volatile uint32_t* gpio_get_registers(void);
+
 void get_pads(uint8_t group, uint8_t *slew_fast, uint8_t *hyst_enabled, uint8_t *drive_strength);
 void set_pads(uint8_t group, uint8_t slew_fast, uint8_t hyst_enabled, uint8_t drive_strength);
 /**
@@ -74,6 +74,10 @@ int spi_write(spi_t *self, const void* tx_buf, int len);
 // read and write `len` bytes from/to SPIdev
 int spi_exchange(spi_t *self, void* rx_buf, const void* tx_buf, int len);
 //----------------------------------------------------------------------------
+// submit `count` prepared transfers in one SPI_IOC_MESSAGE(count) ioctl
+// (each transfer's cs_change is left as set by the caller)
+int spi_exchange_multi(spi_t *self, struct spi_ioc_transfer* xfer, int count);
+//----------------------------------------------------------------------------
 // read data from SPIdev from specific register address
 int spi_read_reg8(spi_t *self, uint8_t reg_addr, void* rx_buf, int len);
 //----------------------------------------------------------------------------
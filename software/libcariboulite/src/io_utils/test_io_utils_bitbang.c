@@ -0,0 +1,92 @@
+// off-target checks of the bit-bang engine - the GPIO writes go to a recorder
+// instead of the rpi registers. The spi module is built in here so the static
+// RFFC507x frame writer can be called directly.
+#include <stdio.h>
+#include <string.h>
+#include "io_utils_spi.c"
+
+#define PIN_SCK     21
+#define PIN_SDATA   20
+#define PIN_ENX     16
+
+#define MAX_EDGES   64
+
+typedef struct
+{
+    uint32_t levels;
+    int num_edges;
+    uint8_t sdata[MAX_EDGES];       // SDATA on every SCK rising edge
+    uint8_t enx[MAX_EDGES];         // ENX on every SCK rising edge
+} gpio_recorder_st;
+
+static void rec_set(void* context, uint32_t mask)
+{
+    gpio_recorder_st* rec = (gpio_recorder_st*)context;
+    if ((mask & (1u << PIN_SCK)) && !(rec->levels & (1u << PIN_SCK)) && rec->num_edges < MAX_EDGES)
+    {
+        rec->sdata[rec->num_edges] = (rec->levels >> PIN_SDATA) & 1;
+        rec->enx[rec->num_edges] = (rec->levels >> PIN_ENX) & 1;
+        rec->num_edges++;
+    }
+    rec->levels |= mask;
+}
+
+static void rec_clr(void* context, uint32_t mask)
+{
+    gpio_recorder_st* rec = (gpio_recorder_st*)context;
+    rec->levels &= ~mask;
+}
+
+static uint32_t rec_read(void* context)
+{
+    return ((gpio_recorder_st*)context)->levels;
+}
+
+#define CHECK(c)	do { if (!(c)) { printf("FAILED %s:%d: %s\n", __func__, __LINE__, #c); return -1; } } while (0)
+
+static int check_rffc_write(uint8_t reg, uint16_t val)
+{
+    gpio_recorder_st rec = {0};
+    io_utils_gpio_ops_st ops = {rec_set, rec_clr, rec_read, &rec};
+    io_utils_bitbang_set_gpio_ops(&ops);
+
+    io_utils_spi_chip_st chip = {0};
+    io_utils_bitbang_bus_init(&chip.bitbang, PIN_SCK, PIN_SDATA, PIN_SDATA, PIN_ENX, 0);
+    CHECK(io_utils_spi_write_rffc507x(NULL, &chip, reg, val) == 0);
+
+    // two clocks with ENX high, the 25 bit frame (a zero write flag, the 7 bit
+    // address and the 16 bit value - MSB first) with ENX low, one more clock
+    // with ENX high
+    uint32_t frame = ((uint32_t)(reg & 0x7f) << 16) | val;
+    CHECK(rec.num_edges == 2 + 25 + 1);
+    CHECK(rec.enx[0] == 1 && rec.enx[1] == 1);
+    for (int i = 0; i < 25; i++)
+    {
+        CHECK(rec.enx[2 + i] == 0);
+        CHECK(rec.sdata[2 + i] == ((frame >> (24 - i)) & 1));
+    }
+    CHECK(rec.enx[27] == 1);
+
+    // the bus is left idle - ENX released, SCK low
+    CHECK(rec.levels & (1u << PIN_ENX));
+    CHECK(!(rec.levels & (1u << PIN_SCK)));
+
+    io_utils_bitbang_set_gpio_ops(NULL);
+    return 0;
+}
+
+int test_rffc_write_frame()
+{
+    CHECK(check_rffc_write(0x1D, 0x1003) == 0);     // P1 VCO config
+    CHECK(check_rffc_write(0x7F, 0xFFFF) == 0);     // all ones
+    CHECK(check_rffc_write(0x00, 0x0000) == 0);     // all zeros
+    return 0;
+}
+
+int main(int argc, char *argv[])
+{
+    int fails = 0;
+    fails += test_rffc_write_frame() != 0;
+    printf("io_utils_bitbang: %d failed\n", fails);
+    return fails ? -1 : 0;
+}
@@ -104,8 +104,9 @@ int rffc507x_regs_commit(rffc507x_st* dev)
 
 //===========================================================================
 // Set up all registers according to defaults specified in docs.
-int rffc507x_init(  rffc507x_st* dev,
-					io_utils_spi_st* io_spi)
+static int rffc507x_setup(rffc507x_st* dev,
+						io_utils_spi_st* io_spi,
+						bool reset)
 {
 	if (dev == NULL)
 	{
@@ -123,8 +124,8 @@ int rffc507x_init(  rffc507x_st* dev,
 	// Configure GPIO pins
 	io_utils_setup_gpio(dev->reset_pin, io_utils_dir_output, io_utils_pull_up);
 
-	// set to known state
-	rffc507x_reset(dev);
+	// set to known state (unless attaching to a chip that is already running)
+	if (reset) rffc507x_reset(dev);
 
 	dev->io_spi_handle = io_utils_spi_add_chip(dev->io_spi, dev->cs_pin, 5000000, 0, 0,
                         						io_utils_spi_chip_type_rffc, NULL);
@@ -178,6 +179,20 @@ int rffc507x_init(  rffc507x_st* dev,
 	return 0;
 }
 
+//===========================================================================
+int rffc507x_init(  rffc507x_st* dev,
+					io_utils_spi_st* io_spi)
+{
+	return rffc507x_setup(dev, io_spi, true);
+}
+
+//===========================================================================
+int rffc507x_attach(rffc507x_st* dev,
+					io_utils_spi_st* io_spi)
+{
+	return rffc507x_setup(dev, io_spi, false);
+}
+
 //===========================================================================
 void rffc507x_reset(rffc507x_st* dev)
 {
@@ -296,49 +311,54 @@ int rffc507x_setup_reference_freq(rffc507x_st* dev, double ref_freq_hz)
 }
 
 //===========================================================================
-double rffc507x_set_frequency(rffc507x_st* dev, double lo_hz)
+void rffc507x_calc_frequency_plan(double ref_freq_hz, double lo_hz, rffc507x_freq_plan_st* plan)
 {
-	uint8_t lodiv;
 	double fvco;
-	uint8_t fbkdiv;
-	uint16_t n;
-	double tune_freq_hz;
-	uint16_t p1nmsb;
-	uint8_t p1nlsb;
+	uint8_t lodiv;
 
-	rffc507x_disable(dev);
+	plan->ref_freq_hz = ref_freq_hz;
+	plan->lo_hz = lo_hz;
 
 	// Calculate n_lo
-	uint8_t n_lo = (uint8_t)log2(LO_MAX_HZ / lo_hz);
-	lodiv = 1 << n_lo;							// lodiv = 2^(n_lo)
+	plan->n_lo = (uint8_t)log2(LO_MAX_HZ / lo_hz);
+	lodiv = 1 << plan->n_lo;					// lodiv = 2^(n_lo)
 	fvco = lodiv * lo_hz;						// in Hz!
 
 	if (fvco > 3200000000.0f)
 	{
-		fbkdiv = 4;
-		set_RFFC507X_PLLCPL(dev, 3);
+		plan->fbkdiv = 4;
+		plan->pllcpl = 3;
 	}
 	else
 	{
-		fbkdiv = 2;
-		set_RFFC507X_PLLCPL(dev, 2);
+		plan->fbkdiv = 2;
+		plan->pllcpl = 2;
 	}
 
-	rffc507x_calculate_freq_params(dev->ref_freq_hz, lodiv, fvco, fbkdiv, &n, &p1nmsb, &p1nlsb, &tune_freq_hz);
+	rffc507x_calculate_freq_params(ref_freq_hz, lodiv, fvco, plan->fbkdiv, 
+									&plan->n, &plan->nmsb, &plan->nlsb, &plan->act_freq_hz);
 
 	//ZF_LOGD("----------------------------------------------------------");
-	//ZF_LOGD("LO_HZ=%.2f n_lo=%d lodiv=%d", lo_hz, n_lo, lodiv);
-	//ZF_LOGD("fvco=%.2f fbkdiv=%d n=%d", fvco, fbkdiv, n);
-	//ZF_LOGD("frac=%d, p1nmsb=%d, p1nlsb=%d, tune_freq_hz=%.2f", p1nmsb<<8 | p1nlsb, p1nmsb, p1nlsb, tune_freq_hz);
+	//ZF_LOGD("LO_HZ=%.2f n_lo=%d lodiv=%d", lo_hz, plan->n_lo, lodiv);
+	//ZF_LOGD("fvco=%.2f fbkdiv=%d n=%d", fvco, plan->fbkdiv, plan->n);
+	//ZF_LOGD("frac=%d, p1nmsb=%d, p1nlsb=%d, tune_freq_hz=%.2f", plan->nmsb<<8 | plan->nlsb, plan->nmsb, plan->nlsb, plan->act_freq_hz);
+}
+
+//===========================================================================
+double rffc507x_apply_frequency_plan(rffc507x_st* dev, const rffc507x_freq_plan_st* plan)
+{
+	rffc507x_disable(dev);
+
+	set_RFFC507X_PLLCPL(dev, plan->pllcpl);
 
 	// Path 2
-	set_RFFC507X_P2LODIV(dev, n_lo);
-	set_RFFC507X_P2N(dev, n);
-	set_RFFC507X_P2PRESC(dev, fbkdiv >> 1);
+	set_RFFC507X_P2LODIV(dev, plan->n_lo);
+	set_RFFC507X_P2N(dev, plan->n);
+	set_RFFC507X_P2PRESC(dev, plan->fbkdiv >> 1);
 	//set_RFFC507X_P2VCOSEL(dev, 0);
     //set_RFFC507X_AUTO(dev, 1);
-	set_RFFC507X_P2NMSB(dev, p1nmsb);
-	set_RFFC507X_P2NLSB(dev, p1nlsb);
+	set_RFFC507X_P2NMSB(dev, plan->nmsb);
+	set_RFFC507X_P2NLSB(dev, plan->nlsb);
 
 	rffc507x_regs_commit(dev);
 
@@ -347,27 +367,33 @@ double rffc507x_set_frequency(rffc507x_st* dev, double lo_hz)
 		// For optimum VCO phase noise the prescaler divider should be set to divide by 2. If the VCO frequency is 
 		// greater than 3.2GHz, it is necessary to set the ratio to 4 to allow the CT_cal algorithm to work. 
 		// After the device is enabled, the divider values can be reprogrammed with the prescaler divider ratio of 2 
-		// and the new n, nummsb, and numlsb values. Taking the previous example of an LO of 314.159265MHz:
-		fbkdiv = 2;
-		rffc507x_calculate_freq_params(dev->ref_freq_hz, lodiv, fvco, fbkdiv, &n, &p1nmsb, &p1nlsb, &tune_freq_hz);
-
-		//ZF_LOGD("LO_HZ=%.2f n_lo=%d lodiv=%d", lo_hz, n_lo, lodiv);
-		//ZF_LOGD("fvco=%.2f fbkdiv=%d n=%d", fvco, fbkdiv, n);
-		//ZF_LOGD("frac=%d, p1nmsb=%d, p1nlsb=%d, tune_freq_hz=%.2f", p1nmsb<<8 | p1nlsb, p1nmsb, p1nlsb, tune_freq_hz);
-		//ZF_LOGD("----------------------------------------------------------");
-
-		// Path 2
-		set_RFFC507X_P2LODIV(dev, n_lo);
-		set_RFFC507X_P2N(dev, n);
-		set_RFFC507X_P2PRESC(dev, fbkdiv >> 1);
-		set_RFFC507X_P2NMSB(dev, p1nmsb);
-		set_RFFC507X_P2NLSB(dev, p1nlsb);
-		rffc507x_regs_commit(dev);
+		// and the new n, nummsb, and numlsb values.
 	}*/
     
     rffc507x_enable(dev);
 
-	return tune_freq_hz;
+	return plan->act_freq_hz;
+}
+
+//===========================================================================
+int rffc507x_frequency_plan_is_applied(rffc507x_st* dev, const rffc507x_freq_plan_st* plan)
+{
+	return dev->ref_freq_hz == plan->ref_freq_hz &&
+		   get_RFFC507X_ENBL(dev) == 1 &&
+		   get_RFFC507X_PLLCPL(dev) == plan->pllcpl &&
+		   get_RFFC507X_P2LODIV(dev) == plan->n_lo &&
+		   get_RFFC507X_P2N(dev) == plan->n &&
+		   get_RFFC507X_P2PRESC(dev) == (plan->fbkdiv >> 1) &&
+		   get_RFFC507X_P2NMSB(dev) == plan->nmsb &&
+		   get_RFFC507X_P2NLSB(dev) == plan->nlsb;
+}
+
+//===========================================================================
+double rffc507x_set_frequency(rffc507x_st* dev, double lo_hz)
+{
+	rffc507x_freq_plan_st plan;
+	rffc507x_calc_frequency_plan(dev->ref_freq_hz, lo_hz, &plan);
+	return rffc507x_apply_frequency_plan(dev, &plan);
 }
 
 //===========================================================================
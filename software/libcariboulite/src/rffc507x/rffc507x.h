@@ -71,9 +71,26 @@ typedef struct
     uint32_t rffc507x_regs_dirty;
 } rffc507x_st;
 
+// Precomputed path-2 synthesizer settings for a given LO and reference
+typedef struct
+{
+    double ref_freq_hz;
+    double lo_hz;               // requested
+    double act_freq_hz;         // achieved
+    uint8_t n_lo;               // LODIV = 2^n_lo
+    uint8_t fbkdiv;
+    uint8_t pllcpl;
+    uint16_t n;
+    uint16_t nmsb;
+    uint8_t nlsb;
+} rffc507x_freq_plan_st;
+
 // Initialize chip
 int rffc507x_init(  rffc507x_st* dev,
 					io_utils_spi_st* io_spi);
+// Same as init, without the reset pulse - for a chip left running by a previous session
+int rffc507x_attach(rffc507x_st* dev,
+					io_utils_spi_st* io_spi);
 int rffc507x_release(rffc507x_st* dev);
 
 // Read a register via SPI. Save a copy to memory and return
@@ -92,6 +109,16 @@ int rffc507x_regs_commit(rffc507x_st* dev);
 // Set frequency (MHz)
 double rffc507x_set_frequency(rffc507x_st* dev, double lo_hz);
 
+// Calculate the synthesizer settings for an LO frequency without touching the device
+void rffc507x_calc_frequency_plan(double ref_freq_hz, double lo_hz, rffc507x_freq_plan_st* plan);
+
+// Program a precomputed plan (disable, write the path-2 registers, enable)
+// returns the achieved LO frequency
+double rffc507x_apply_frequency_plan(rffc507x_st* dev, const rffc507x_freq_plan_st* plan);
+
+// Check whether the register shadow already holds the plan's settings
+int rffc507x_frequency_plan_is_applied(rffc507x_st* dev, const rffc507x_freq_plan_st* plan);
+
 void rffc507x_reset(rffc507x_st* dev);
 void rffc507x_enable(rffc507x_st* dev);
 void rffc507x_disable(rffc507x_st* dev);
@@ -32,11 +32,23 @@ Cariboulite::Cariboulite(const SoapySDR::Kwargs &args)
     {
         throw std::runtime_error( "Stream allocation failed" );
     }
+    
+    // "sensor_rate=<Hz>" samples the sensors in the background and readSensor
+    // serves the cache. Off (0) by default - readSensor reads them on demand
+    // and an idle device makes no SPI traffic
+    float sensor_rate = SENSOR_SAMPLER_DEFAULT_RATE;
+    if (args.count("sensor_rate")) sensor_rate = std::atof(args.at("sensor_rate").c_str());
+    if (sensor_rate > 0.0f && 
+        cariboulite_radio_start_sensor_sampler(radio, sensor_rate, SENSOR_SAMPLER_HISTORY_LEN) != 0)
+    {
+        SoapySDR_logf(SOAPY_SDR_WARNING, "Sensor sampler failed to start, sensors are read on demand");
+    }
 }
 
 //========================================================
 Cariboulite::~Cariboulite()
 {
+    cariboulite_radio_stop_sensor_sampler(radio);
     if (stream)	delete stream;
 }
 
@@ -241,6 +253,16 @@ void Cariboulite::setSampleRate( const int direction, const size_t channel, cons
     cariboulite_radio_f_cut_en rx_cuttof = radio->rx_fcut;
     cariboulite_radio_f_cut_en tx_cuttof = radio->tx_fcut;
 
+    //printf("setSampleRate dir: %d, channel: %ld, rate: %.2f\n", direction, channel, rate);
+    if (direction == SOAPY_SDR_RX)
+    {
+        // the SMI delivers 4 MSPS whatever the modem's rate is, so the modem
+        // stays at 4 MSPS and the stream decimates / resamples on the host
+        cariboulite_radio_set_rx_samp_cutoff((cariboulite_radio_state_st*)radio, fs, rx_cuttof);
+        setRxStreamSampleRate(rate);
+        return;
+    }
+
     if (std::fabs(rate - (400000.0)) < 1) fs = cariboulite_radio_rx_sample_rate_400khz;
     if (std::fabs(rate - (500000.0)) < 1) fs = cariboulite_radio_rx_sample_rate_500khz;
     if (std::fabs(rate - (666000.0)) < 1)
@@ -252,7 +274,7 @@ void Cariboulite::setSampleRate( const int direction, const size_t channel, cons
     if (std::fabs(rate - (2000000.0/3)) < 1) fs = cariboulite_radio_rx_sample_rate_666khz;
     if (std::fabs(rate - (800000.0)) < 1) fs = cariboulite_radio_rx_sample_rate_800khz;
     if (std::fabs(rate - (1000000.0)) < 1) fs = cariboulite_radio_rx_sample_rate_1000khz;
-    if (std::fabs(rate - (1333000.0)) < 1) fs = cariboulite_radio_rx_sample_rate_1333khz;
+    if (std::fabs(rate - (1333000.0)) < 1)
     {
         fs = cariboulite_radio_rx_sample_rate_1333khz;
         SoapySDR_logf(SOAPY_SDR_WARNING, "setSampleRate: using rounded rate 1333000 is deprecated; use 4e6/3 or 1333333.3.");
@@ -261,14 +283,19 @@ void Cariboulite::setSampleRate( const int direction, const size_t channel, cons
     if (std::fabs(rate - (2000000.0)) < 1) fs = cariboulite_radio_rx_sample_rate_2000khz;
     if (std::fabs(rate - (4000000.0)) < 1) fs = cariboulite_radio_rx_sample_rate_4000khz;
 
-    //printf("setSampleRate dir: %d, channel: %ld, rate: %.2f\n", direction, channel, rate);
-    if (direction == SOAPY_SDR_RX)
+    if (direction == SOAPY_SDR_TX)
     {
-        cariboulite_radio_set_rx_samp_cutoff((cariboulite_radio_state_st*)radio, fs, rx_cuttof);
+        cariboulite_radio_set_tx_samp_cutoff((cariboulite_radio_state_st*)radio, fs, tx_cuttof);
     }
-    else if (direction == SOAPY_SDR_TX)
+}
+
+//========================================================
+void Cariboulite::setRxStreamSampleRate( const double rate )
+{
+    double actual = stream->setSampleRate(rate);
+    if (std::fabs(actual - rate) >= 1)
     {
-        cariboulite_radio_set_tx_samp_cutoff((cariboulite_radio_state_st*)radio, fs, tx_cuttof);
+        SoapySDR_logf(SOAPY_SDR_WARNING, "setSampleRate: %.1f SPS requested, delivering %.3f SPS", rate, actual);
     }
 }
 
@@ -277,9 +304,10 @@ double Cariboulite::getSampleRate( const int direction, const size_t channel ) c
 {
     cariboulite_radio_sample_rate_en fs = cariboulite_radio_rx_sample_rate_4000khz;
     
+    // the rate the stream actually delivers
     if (direction == SOAPY_SDR_RX)
     {
-        cariboulite_radio_get_rx_samp_cutoff((cariboulite_radio_state_st*)radio, &fs, NULL);
+        return stream->getSampleRate();
     }
     else if (direction == SOAPY_SDR_TX)
     {
@@ -313,9 +341,37 @@ std::vector<double> Cariboulite::listSampleRates( const int direction, const siz
     options.push_back( 2000000.0/3 );
     options.push_back( 500000.0 );
     options.push_back( 400000.0 );
+    if (direction == SOAPY_SDR_RX)
+    {
+        options.push_back( 250000.0 );
+        options.push_back( 200000.0 );
+        options.push_back( 125000.0 );
+        options.push_back( 100000.0 );
+        options.push_back( 62500.0 );
+        options.push_back( 48000.0 );
+    }
 	return(options);
 }
 
+//========================================================
+SoapySDR::RangeList Cariboulite::getSampleRateRange( const int direction, const size_t channel ) const
+{
+    SoapySDR::RangeList range;
+    if (direction == SOAPY_SDR_RX)
+    {
+        // any rate - the host side rational stage covers what the halfbands don't
+        range.push_back(SoapySDR::Range(MIN_HOST_SAMPLE_RATE, NATIVE_SAMPLE_RATE));
+        return range;
+    }
+    
+    std::vector<double> rates = listSampleRates(direction, channel);
+    for (size_t i = 0; i < rates.size(); i++)
+    {
+        range.push_back(SoapySDR::Range(rates[i], rates[i]));
+    }
+    return range;
+}
+
 //========================================================
 static cariboulite_radio_rx_bw_en convertRxBandwidth(double bw_numeric)
 {
@@ -392,30 +448,35 @@ static double convertTxBandwidth(cariboulite_radio_tx_cut_off_en bw_en)
 
 
 //========================================================
-void Cariboulite::setBandwidth( const int direction, const size_t channel, const double bw )
+// the modem's narrowest RX filter - below it the stream filters digitally
+static double rxModemBandwidth(double bw)
 {
-	double modem_bw = bw;
+    return bw < 160000.0 ? 160000.0 : bw;
+}
 
+//========================================================
+void Cariboulite::setBandwidth( const int direction, const size_t channel, const double bw )
+{
     if (direction == SOAPY_SDR_RX)
     {
-		if (modem_bw < 160000.0 )
-		{
-			modem_bw = 160000.0;
-			if (bw <= 20000.0) stream->setDigitalFilter(SoapySDR::Stream::DigitalFilter_20KHz);
-			else if (bw <= 50000.0) stream->setDigitalFilter(SoapySDR::Stream::DigitalFilter_50KHz);
-			else if (bw <= 100000.0) stream->setDigitalFilter(SoapySDR::Stream::DigitalFilter_100KHz);
-			else stream->setDigitalFilter(SoapySDR::Stream::DigitalFilter_None);
-		}
-		else stream->setDigitalFilter(SoapySDR::Stream::DigitalFilter_None);
-
-		cariboulite_radio_set_rx_bandwidth(radio, convertRxBandwidth(modem_bw));
+		setRxStreamFilter(bw);
+		cariboulite_radio_set_rx_bandwidth(radio, convertRxBandwidth(rxModemBandwidth(bw)));
     }
     else if (direction == SOAPY_SDR_TX)
     {
-        cariboulite_radio_set_tx_bandwidth(radio, convertTxBandwidth(modem_bw));
+        cariboulite_radio_set_tx_bandwidth(radio, convertTxBandwidth(bw));
     }
 }
 
+//========================================================
+void Cariboulite::setRxStreamFilter( const double bw )
+{
+	if (bw <= 20000.0) stream->setDigitalFilter(SoapySDR::Stream::DigitalFilter_20KHz);
+	else if (bw <= 50000.0) stream->setDigitalFilter(SoapySDR::Stream::DigitalFilter_50KHz);
+	else if (bw <= 100000.0) stream->setDigitalFilter(SoapySDR::Stream::DigitalFilter_100KHz);
+	else stream->setDigitalFilter(SoapySDR::Stream::DigitalFilter_None);
+}
+
 //========================================================
 double Cariboulite::getBandwidth( const int direction, const size_t channel ) const
 {
@@ -429,6 +490,7 @@ double Cariboulite::getBandwidth( const int direction, const size_t channel ) co
         if (filter_type == SoapySDR::Stream::DigitalFilter_20KHz) return 20000.0;
         else if (filter_type == SoapySDR::Stream::DigitalFilter_50KHz) return 50000.0;
         else if (filter_type == SoapySDR::Stream::DigitalFilter_100KHz) return 100000.0;
+        else if (filter_type == SoapySDR::Stream::DigitalFilter_200KHz) return 200000.0;
         return convertRxBandwidth(bw);
     }
     else if (direction == SOAPY_SDR_TX)
@@ -484,6 +546,12 @@ std::vector<double> Cariboulite::listBandwidths( const int direction, const size
 /*******************************************************************
  * Frequency API
  ******************************************************************/
+static bool settingIsTrue(const std::string &value)
+{
+    return value == "true" || value == "1";
+}
+
+//========================================================
 void Cariboulite::setFrequency( const int direction, const size_t channel, const std::string &name, 
                                 const double frequency, const SoapySDR::Kwargs &args )
 {
@@ -493,7 +561,15 @@ void Cariboulite::setFrequency( const int direction, const size_t channel, const
         return;
     }
 
-    err = cariboulite_radio_set_frequency(radio, true, (double *)&frequency);
+    // a running RX stream is retuned in place unless asked otherwise
+    bool rx_streaming = radio->active && radio->channel_direction == cariboulite_channel_dir_rx;
+    bool break_before_make = !rx_streaming;
+    if (args.count("break_before_make") && args.at("break_before_make") != "auto")
+    {
+        break_before_make = settingIsTrue(args.at("break_before_make"));
+    }
+
+    err = cariboulite_radio_set_frequency(radio, break_before_make, (double *)&frequency);
     if (err == 0) SoapySDR_logf(SOAPY_SDR_INFO, "setFrequency dir: %d, channel: %ld, freq: %.2f", direction, channel, frequency);
     else SoapySDR_logf(SOAPY_SDR_ERROR, "setFrequency dir: %d, channel: %ld, freq: %.2f FAILED", direction, channel, frequency);
 }
@@ -517,7 +593,16 @@ SoapySDR::ArgInfoList Cariboulite::getFrequencyArgsInfo(const int direction, con
 {
     //printf("getFrequencyArgsInfo\n");
     SoapySDR::ArgInfoList freqArgs;
-	// TODO: frequency arguments
+
+    SoapySDR::ArgInfo bbmArg;
+    bbmArg.key = "break_before_make";
+    bbmArg.value = "auto";
+    bbmArg.name = "Break Before Make";
+    bbmArg.description = "Stop the channel before retuning (default: only when no RX stream is running)";
+    bbmArg.type = SoapySDR::ArgInfo::STRING;
+    bbmArg.options = {"auto", "true", "false"};
+    freqArgs.push_back(bbmArg);
+
 	return freqArgs;
 }
 
@@ -554,3 +639,122 @@ SoapySDR::RangeList Cariboulite::getFrequencyRange( const int direction, const s
     throw std::runtime_error( "getFrequencyRange - unknown channel" );
 }
 
+
+/*******************************************************************
+ * Settings API
+ ******************************************************************/
+//========================================================
+SoapySDR::ArgInfoList Cariboulite::getSettingInfo(const int direction, const size_t channel) const
+{
+    SoapySDR::ArgInfoList setArgs;
+
+    SoapySDR::ArgInfo configArg;
+    configArg.key = "config";
+    configArg.value = "";
+    configArg.name = "Batched configuration";
+    configArg.description = "Apply several settings at once (frequency, gain, agc, rate, bandwidth), "
+                            "e.g. \"frequency=915e6,gain=30,bandwidth=1e6\". Only the changed registers "
+                            "are written and the channel goes through a single state transition.";
+    configArg.type = SoapySDR::ArgInfo::STRING;
+    setArgs.push_back(configArg);
+
+    return setArgs;
+}
+
+//========================================================
+void Cariboulite::writeSetting(const int direction, const size_t channel, const std::string &key, const std::string &value)
+{
+    if (key == "config")
+    {
+        writeSettings(direction, channel, SoapySDR::KwargsFromString(value));
+        return;
+    }
+    SoapySDR_logf(SOAPY_SDR_WARNING, "writeSetting: unknown setting '%s'", key.c_str());
+}
+
+//========================================================
+/*!
+* Apply a batch of settings as one configuration transaction.
+* The settings are recorded and committed together, in a fixed order
+* (rate, bandwidth, gain / agc, frequency) whatever their order in the batch.
+* The RX stream's resampler and digital filter follow only a successful commit.
+* \param direction the channel direction RX or TX
+* \param channel an available channel on the device
+* \param settings frequency, gain, agc, rate and bandwidth keys
+*/
+void Cariboulite::writeSettings(const int direction, const size_t channel, const SoapySDR::Kwargs &settings)
+{
+    static const char* keys[] = {"frequency", "gain", "agc", "rate", "bandwidth"};
+    for (SoapySDR::Kwargs::const_iterator it = settings.begin(); it != settings.end(); ++it)
+    {
+        bool known = false;
+        for (size_t i = 0; i < sizeof(keys) / sizeof(keys[0]); i++) known |= (it->first == keys[i]);
+        if (!known)
+        {
+            throw std::runtime_error( "writeSettings - unknown setting '" + it->first + "'" );
+        }
+    }
+
+    SoapySDR::Kwargs::const_iterator rate_it = settings.find("rate");
+    SoapySDR::Kwargs::const_iterator bw_it = settings.find("bandwidth");
+    double rate = rate_it != settings.end() ? std::stod(rate_it->second) : 0.0;
+    double bw = bw_it != settings.end() ? std::stod(bw_it->second) : 0.0;
+
+    if (cariboulite_radio_begin(radio) != 0)
+    {
+        throw std::runtime_error( "writeSettings - a configuration transaction is already open" );
+    }
+
+    try
+    {
+        SoapySDR::Kwargs::const_iterator it;
+        if (rate_it != settings.end())
+        {
+            // RX: the modem stays at 4 MSPS, the stream's rate is staged below
+            if (direction == SOAPY_SDR_RX) cariboulite_radio_set_rx_samp_cutoff(radio, cariboulite_radio_rx_sample_rate_4000khz, radio->rx_fcut);
+            else setSampleRate(direction, channel, rate);
+        }
+        if (bw_it != settings.end())
+        {
+            if (direction == SOAPY_SDR_RX) cariboulite_radio_set_rx_bandwidth(radio, convertRxBandwidth(rxModemBandwidth(bw)));
+            else setBandwidth(direction, channel, bw);
+        }
+
+        if (direction == SOAPY_SDR_RX)
+        {
+            // gain and agc share one register - record them together
+            bool agc = radio->txn.rx_agc_on;
+            int gain = radio->txn.rx_gain_value_db;
+            if ((it = settings.find("agc")) != settings.end()) agc = settingIsTrue(it->second);
+            if ((it = settings.find("gain")) != settings.end()) gain = (int)std::stod(it->second);
+            cariboulite_radio_set_rx_gain_control(radio, agc, gain);
+        }
+        else if ((it = settings.find("gain")) != settings.end())
+        {
+            setGain(direction, channel, std::stod(it->second));
+        }
+
+        if ((it = settings.find("frequency")) != settings.end())
+        {
+            setFrequency(direction, channel, "RF", std::stod(it->second), SoapySDR::Kwargs());
+        }
+    }
+    catch (...)
+    {
+        cariboulite_radio_abort(radio);
+        throw;
+    }
+
+    if (cariboulite_radio_commit(radio) != 0)
+    {
+        SoapySDR_logf(SOAPY_SDR_ERROR, "writeSettings dir: %d, channel: %ld FAILED", direction, channel);
+        throw std::runtime_error( "writeSettings - committing the settings failed" );
+    }
+
+    // the stream isn't part of the radio's transaction - it follows the committed settings
+    if (direction == SOAPY_SDR_RX)
+    {
+        if (rate_it != settings.end()) setRxStreamSampleRate(rate);
+        if (bw_it != settings.end()) setRxStreamFilter(bw);
+    }
+}
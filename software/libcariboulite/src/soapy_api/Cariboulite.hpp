@@ -21,6 +21,9 @@
 #include "cariboulite_setup.h"
 #include "cariboulite_radio.h"
 
+#define SENSOR_SAMPLER_DEFAULT_RATE     ( 0.0f )        // Hz, 0 = off (on demand reads)
+#define SENSOR_SAMPLER_HISTORY_LEN      ( 1024 )
+
 
 class SoapyCaribouliteSession
 {
@@ -92,6 +95,34 @@ public:
                         const long long timeNs = 0, // const first, don't pass as reference !
                         const long timeoutUs = 100000); // default value ?
 
+        int readStreamStatus(SoapySDR::Stream *stream,
+                            size_t &chanMask,
+                            int &flags,
+                            long long &timeNs,
+                            const long timeoutUs = 100000);
+
+        /*******************************************************************
+         * Direct buffer access API
+         ******************************************************************/
+        size_t getNumDirectAccessBuffers(SoapySDR::Stream *stream);
+        int getDirectAccessBufferAddrs(SoapySDR::Stream *stream, const size_t handle, void **buffs);
+        int acquireReadBuffer(  SoapySDR::Stream *stream,
+                                size_t &handle,
+                                const void **buffs,
+                                int &flags,
+                                long long &timeNs,
+                                const long timeoutUs = 100000);
+        void releaseReadBuffer(SoapySDR::Stream *stream, const size_t handle);
+        int acquireWriteBuffer( SoapySDR::Stream *stream,
+                                size_t &handle,
+                                void **buffs,
+                                const long timeoutUs = 100000);
+        void releaseWriteBuffer(SoapySDR::Stream *stream,
+                                const size_t handle,
+                                const size_t numElems,
+                                int &flags,
+                                const long long timeNs = 0);
+
         /*******************************************************************
          * Antenna API
          ******************************************************************/
@@ -132,9 +163,20 @@ public:
         void setSampleRate( const int direction, const size_t channel, const double rate );
         double getSampleRate( const int direction, const size_t channel ) const;
         std::vector<double> listSampleRates( const int direction, const size_t channel ) const;
+        SoapySDR::RangeList getSampleRateRange( const int direction, const size_t channel ) const;
         void setBandwidth( const int direction, const size_t channel, const double bw );
         double getBandwidth( const int direction, const size_t channel ) const;
         std::vector<double> listBandwidths( const int direction, const size_t channel ) const;
+        // the host side of the RX rate / bandwidth - the stream's resampler and digital filter
+        void setRxStreamSampleRate( const double rate );
+        void setRxStreamFilter( const double bw );
+
+        /*******************************************************************
+         * Settings API
+         ******************************************************************/
+        SoapySDR::ArgInfoList getSettingInfo(const int direction, const size_t channel) const;
+        void writeSetting(const int direction, const size_t channel, const std::string &key, const std::string &value);
+        void writeSettings(const int direction, const size_t channel, const SoapySDR::Kwargs &settings);
 
         /*******************************************************************
          * Sensors API
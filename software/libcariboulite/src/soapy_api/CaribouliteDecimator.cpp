@@ -0,0 +1,368 @@
+#include "CaribouliteDecimator.hpp"
+#include <string.h>
+#include <math.h>
+
+// Halfband taps (Q15) - only the non-zero odd taps, outermost first, the
+// center tap is always 0.5 (16384). Cheap 7-tap [-1 0 9 16 9 0 -1]/32
+// for the early stages
+static const int16_t halfband_short_taps[] = {-1024, 9216};
+
+// 23-tap Kaiser windowed halfband for the last stage: -0.2 dB at
+// 0.175 fs_in, rejection > 75 dB from 0.4 fs_in
+static const int16_t halfband_long_taps[] = {-14, 122, -434, 1151, -2826, 10193};
+
+#define HALFBAND_CENTER_TAP     ( 16384 )
+#define HALFBAND_SHIFT          ( 15 )
+
+//=================================================================
+CaribouliteDecimator::CaribouliteDecimator()
+{
+    out_i_.resize(DECIM_TILE_SAMPLES);
+    out_q_.resize(DECIM_TILE_SAMPLES);
+    setStages(0);
+}
+
+//=================================================================
+void CaribouliteDecimator::setStages(int num_stages)
+{
+    if (num_stages < 0) num_stages = 0;
+    if (num_stages > DECIM_MAX_HALFBAND_STAGES) num_stages = DECIM_MAX_HALFBAND_STAGES;
+    num_stages_ = num_stages;
+
+    for (int s = 0; s < num_stages_; s++)
+    {
+        Stage& st = stages_[s];
+        bool last = (s == num_stages_ - 1);
+        st.taps = last ? halfband_long_taps : halfband_short_taps;
+        st.num_taps = last ? 23 : 7;
+        st.x_i.resize(st.num_taps + DECIM_TILE_SAMPLES);
+        st.x_q.resize(st.num_taps + DECIM_TILE_SAMPLES);
+    }
+    reset();
+}
+
+//=================================================================
+void CaribouliteDecimator::reset(void)
+{
+    // start with a zeroed history - every output then has a full window
+    for (int s = 0; s < num_stages_; s++)
+    {
+        Stage& st = stages_[s];
+        st.hist = st.num_taps - 1;
+        memset(&st.x_i[0], 0, st.hist * sizeof(int16_t));
+        memset(&st.x_q[0], 0, st.hist * sizeof(int16_t));
+    }
+}
+
+//=================================================================
+size_t CaribouliteDecimator::numOutputs(size_t num_in) const
+{
+    size_t n = num_in;
+    for (int s = 0; s < num_stages_; s++)
+    {
+        size_t len = stages_[s].hist + n;
+        size_t taps = stages_[s].num_taps;
+        n = (len >= taps) ? ((len - taps) / 2 + 1) : 0;
+    }
+    return n;
+}
+
+//=================================================================
+size_t CaribouliteDecimator::halfband(const Stage& st, const int16_t* x, size_t len, int16_t* y)
+{
+    size_t taps = st.num_taps;
+    if (len < taps) return 0;
+    size_t num_out = (len - taps) / 2 + 1;
+    size_t center = (taps - 1) / 2;
+    int num_sym = (int)(center + 1) / 2;
+    int32_t acc[DECIM_TILE_SAMPLES / 2 + 1];
+
+    // center tap (odd phase)
+    for (size_t m = 0; m < num_out; m++)
+    {
+        acc[m] = (int32_t)x[2*m + center] * HALFBAND_CENTER_TAP + (1 << (HALFBAND_SHIFT - 1));
+    }
+
+    // symmetric pairs (even phase) - tap outer, sample inner
+    for (int t = 0; t < num_sym; t++)
+    {
+        const int32_t a = st.taps[t];
+        const int16_t* x0 = x + 2*t;
+        const int16_t* x1 = x + 2*center - 2*t;
+        for (size_t m = 0; m < num_out; m++)
+        {
+            acc[m] += a * ((int32_t)x0[2*m] + (int32_t)x1[2*m]);
+        }
+    }
+
+    for (size_t m = 0; m < num_out; m++)
+    {
+        int32_t v = acc[m] >> HALFBAND_SHIFT;
+        y[m] = (int16_t)((v > 32767) ? 32767 : ((v < -32768) ? -32768 : v));
+    }
+    return num_out;
+}
+
+//=================================================================
+size_t CaribouliteDecimator::processTile(const cariboulite_sample_complex_int16* in, size_t num_in, cariboulite_sample_complex_int16* out)
+{
+    // de-interleave into the first stage (after its history)
+    Stage& first = stages_[0];
+    int16_t* xi = &first.x_i[first.hist];
+    int16_t* xq = &first.x_q[first.hist];
+    for (size_t k = 0; k < num_in; k++)
+    {
+        xi[k] = in[k].i;
+        xq[k] = in[k].q;
+    }
+
+    size_t n = num_in;
+    for (int s = 0; s < num_stages_; s++)
+    {
+        Stage& st = stages_[s];
+        size_t len = st.hist + n;
+        int16_t* yi;
+        int16_t* yq;
+        if (s == num_stages_ - 1)
+        {
+            yi = &out_i_[0];
+            yq = &out_q_[0];
+        }
+        else
+        {
+            yi = &stages_[s + 1].x_i[stages_[s + 1].hist];
+            yq = &stages_[s + 1].x_q[stages_[s + 1].hist];
+        }
+
+        size_t m = halfband(st, &st.x_i[0], len, yi);
+        halfband(st, &st.x_q[0], len, yq);
+
+        // keep the unconsumed tail as the next call's history
+        st.hist = len - 2 * m;
+        memmove(&st.x_i[0], &st.x_i[2 * m], st.hist * sizeof(int16_t));
+        memmove(&st.x_q[0], &st.x_q[2 * m], st.hist * sizeof(int16_t));
+        n = m;
+    }
+
+    for (size_t k = 0; k < n; k++)
+    {
+        out[k].i = out_i_[k];
+        out[k].q = out_q_[k];
+    }
+    return n;
+}
+
+//=================================================================
+size_t CaribouliteDecimator::process(const cariboulite_sample_complex_int16* in, size_t num_in, cariboulite_sample_complex_int16* out)
+{
+    if (num_stages_ == 0)
+    {
+        if (out != in) memmove(out, in, num_in * sizeof(cariboulite_sample_complex_int16));
+        return num_in;
+    }
+
+    // the outputs never run ahead of the inputs, so in-place is safe
+    size_t num_out = 0;
+    size_t done = 0;
+    while (done < num_in)
+    {
+        size_t tile = num_in - done;
+        if (tile > DECIM_TILE_SAMPLES) tile = DECIM_TILE_SAMPLES;
+        num_out += processTile(in + done, tile, out + num_out);
+        done += tile;
+    }
+    return num_out;
+}
+
+//=================================================================
+// Resampler
+//=================================================================
+#define RESAMP_KAISER_BETA      ( 8.0 )         // ~80 dB sidelobes
+
+//=================================================================
+static double besselI0(double x)
+{
+    double sum = 1.0, term = 1.0;
+    for (int k = 1; k < 50; k++)
+    {
+        term *= (x / (2.0 * k)) * (x / (2.0 * k));
+        sum += term;
+        if (term < sum * 1e-12) break;
+    }
+    return sum;
+}
+
+//=================================================================
+// best rational approximation num/den of ratio with den <= max_den
+static void rationalApprox(double ratio, int max_den, int &num, int &den)
+{
+    int h0 = 0, h1 = 1, k0 = 1, k1 = 0;
+    double x = ratio;
+    num = 1; den = 1;
+    for (int i = 0; i < 32; i++)
+    {
+        int a = (int)floor(x);
+        int h2 = a * h1 + h0;
+        int k2 = a * k1 + k0;
+        if (k2 > max_den) break;
+        num = h2; den = k2;
+        h0 = h1; h1 = h2;
+        k0 = k1; k1 = k2;
+        double frac = x - a;
+        if (frac < 1e-9) break;
+        x = 1.0 / frac;
+    }
+}
+
+//=================================================================
+CaribouliteResampler::CaribouliteResampler()
+{
+    x_i_.resize(RESAMP_TAPS_PER_PHASE + DECIM_TILE_SAMPLES);
+    x_q_.resize(RESAMP_TAPS_PER_PHASE + DECIM_TILE_SAMPLES);
+    interp_ = 1;
+    decim_ = 1;
+    reset();
+}
+
+//=================================================================
+double CaribouliteResampler::setRates(double in_rate, double out_rate)
+{
+    interp_ = 1;
+    decim_ = 1;
+    taps_.clear();
+    if (in_rate <= 0.0 || out_rate <= 0.0 || out_rate >= in_rate)
+    {
+        reset();
+        return in_rate;
+    }
+
+    // ratio = L / M (L < M <= RESAMP_MAX_INTERPOLATION)
+    int l = 1, m = 1;
+    rationalApprox(out_rate / in_rate, RESAMP_MAX_INTERPOLATION, l, m);
+    if (l >= m)
+    {
+        reset();
+        return in_rate;
+    }
+    interp_ = l;
+    decim_ = m;
+
+    // prototype at the upsampled rate, cutoff 0.45 of the output rate
+    int k = RESAMP_TAPS_PER_PHASE;
+    int len = k * l;
+    double fc = 0.45 / m;
+    double center = (len - 1) / 2.0;
+    double i0_beta = besselI0(RESAMP_KAISER_BETA);
+    std::vector<double> h(len);
+    for (int j = 0; j < len; j++)
+    {
+        double t = j - center;
+        double sinc = (fabs(t) < 1e-12) ? 1.0 : sin(2.0 * M_PI * fc * t) / (2.0 * M_PI * fc * t);
+        double r = 2.0 * t / (len - 1);
+        double w = besselI0(RESAMP_KAISER_BETA * sqrt(fmax(0.0, 1.0 - r * r))) / i0_beta;
+        h[j] = 2.0 * fc * l * sinc * w;
+    }
+
+    // polyphase split, each phase normalized to a unity DC gain in Q15
+    taps_.resize(len);
+    for (int p = 0; p < l; p++)
+    {
+        double sum = 0.0;
+        for (int n = 0; n < k; n++) sum += h[p + n * l];
+
+        int32_t qsum = 0;
+        int16_t* g = &taps_[p * k];
+        for (int n = 0; n < k; n++)
+        {
+            g[k - 1 - n] = (int16_t)lrint(h[p + n * l] / sum * 32767.0);
+            qsum += g[k - 1 - n];
+        }
+        g[k / 2] += (int16_t)(32767 - qsum);
+    }
+
+    reset();
+    return in_rate * l / m;
+}
+
+//=================================================================
+void CaribouliteResampler::reset(void)
+{
+    hist_ = RESAMP_TAPS_PER_PHASE - 1;
+    memset(&x_i_[0], 0, hist_ * sizeof(int16_t));
+    memset(&x_q_[0], 0, hist_ * sizeof(int16_t));
+    pos_ = (uint64_t)hist_ * interp_;
+}
+
+//=================================================================
+size_t CaribouliteResampler::numOutputs(size_t num_in) const
+{
+    if (isBypass()) return num_in;
+    uint64_t end = (uint64_t)(hist_ + num_in) * interp_;
+    if (end <= pos_) return 0;
+    return (size_t)((end - pos_ + decim_ - 1) / decim_);
+}
+
+//=================================================================
+size_t CaribouliteResampler::processTile(const cariboulite_sample_complex_int16* in, size_t num_in, cariboulite_sample_complex_int16* out)
+{
+    int16_t* xi = &x_i_[hist_];
+    int16_t* xq = &x_q_[hist_];
+    for (size_t k = 0; k < num_in; k++)
+    {
+        xi[k] = in[k].i;
+        xq[k] = in[k].q;
+    }
+
+    size_t len = hist_ + num_in;
+    uint64_t end = (uint64_t)len * interp_;
+    size_t n = 0;
+    while (pos_ < end)
+    {
+        size_t newest = (size_t)(pos_ / interp_);
+        const int16_t* g = &taps_[(pos_ % interp_) * RESAMP_TAPS_PER_PHASE];
+        const int16_t* wi = &x_i_[newest + 1 - RESAMP_TAPS_PER_PHASE];
+        const int16_t* wq = &x_q_[newest + 1 - RESAMP_TAPS_PER_PHASE];
+        int32_t acc_i = 1 << 14, acc_q = 1 << 14;
+        for (int t = 0; t < RESAMP_TAPS_PER_PHASE; t++)
+        {
+            acc_i += (int32_t)g[t] * wi[t];
+            acc_q += (int32_t)g[t] * wq[t];
+        }
+        acc_i >>= 15;
+        acc_q >>= 15;
+        out[n].i = (int16_t)((acc_i > 32767) ? 32767 : ((acc_i < -32768) ? -32768 : acc_i));
+        out[n].q = (int16_t)((acc_q > 32767) ? 32767 : ((acc_q < -32768) ? -32768 : acc_q));
+        n++;
+        pos_ += decim_;
+    }
+
+    // keep the window of the next output (it may start beyond this tile)
+    size_t base = (size_t)(pos_ / interp_) + 1 - RESAMP_TAPS_PER_PHASE;
+    size_t shift = (base < len) ? base : len;
+    hist_ = len - shift;
+    memmove(&x_i_[0], &x_i_[shift], hist_ * sizeof(int16_t));
+    memmove(&x_q_[0], &x_q_[shift], hist_ * sizeof(int16_t));
+    pos_ -= (uint64_t)shift * interp_;
+    return n;
+}
+
+//=================================================================
+size_t CaribouliteResampler::process(const cariboulite_sample_complex_int16* in, size_t num_in, cariboulite_sample_complex_int16* out)
+{
+    if (isBypass())
+    {
+        if (out != in) memmove(out, in, num_in * sizeof(cariboulite_sample_complex_int16));
+        return num_in;
+    }
+
+    size_t num_out = 0;
+    size_t done = 0;
+    while (done < num_in)
+    {
+        size_t tile = num_in - done;
+        if (tile > DECIM_TILE_SAMPLES) tile = DECIM_TILE_SAMPLES;
+        num_out += processTile(in + done, tile, out + num_out);
+        done += tile;
+    }
+    return num_out;
+}
@@ -0,0 +1,112 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include <vector>
+
+#include "cariboulite_radio.h"
+
+#define DECIM_MAX_HALFBAND_STAGES       ( 6 )           // down to 4 MSPS / 64
+#define DECIM_TILE_SAMPLES              ( 2048 )        // per stage working set
+#define RESAMP_TAPS_PER_PHASE           ( 32 )
+#define RESAMP_MAX_INTERPOLATION        ( 256 )
+
+/*
+ * A cascade of int16 halfband decimators (each stage decimates by 2).
+ *
+ * The samples are de-interleaved into planar I/Q tiles and every stage is
+ * a symmetric halfband FIR evaluated "tap-outer / sample-inner" over the
+ * even/odd input phases, so the inner loops are plain int16 * const
+ * multiply-accumulates into int32 that the compiler vectorizes (NEON on
+ * the RPI). The early stages use a short 7-tap halfband (they only need
+ * to protect the final band near their Nyquist), the last stage a sharp
+ * 23-tap halfband: flat to 0.1 fs_in, > 75 dB rejection from 0.4 fs_in.
+ */
+class CaribouliteDecimator
+{
+public:
+	CaribouliteDecimator();
+	~CaribouliteDecimator() {}
+
+	/*
+	 * set the number of halfband stages (0 = bypass) - the decimation
+	 * factor is 2^num_stages. Resets the filters' history.
+	 */
+	void setStages(int num_stages);
+	int getStages(void) const {return num_stages_;}
+	int getFactor(void) const {return 1 << num_stages_;}
+	void reset(void);
+
+	/*
+	 * the exact number of output samples that the next process() call
+	 * will produce for num_in input samples
+	 */
+	size_t numOutputs(size_t num_in) const;
+
+	/*
+	 * decimate num_in samples into out (room for numOutputs(num_in) samples)
+	 * returns the number of output samples. In-place (out == in) is allowed.
+	 */
+	size_t process(const cariboulite_sample_complex_int16* in, size_t num_in, cariboulite_sample_complex_int16* out);
+
+private:
+	struct Stage
+	{
+		const int16_t* taps;            // the non-zero odd taps, outermost first
+		int num_taps;                   // full filter length (4k+3)
+		size_t hist;                    // samples kept from the previous call
+		std::vector<int16_t> x_i;       // [history | new samples]
+		std::vector<int16_t> x_q;
+	};
+
+	static size_t halfband(const Stage& st, const int16_t* x, size_t len, int16_t* y);
+	size_t processTile(const cariboulite_sample_complex_int16* in, size_t num_in, cariboulite_sample_complex_int16* out);
+
+	int num_stages_;
+	Stage stages_[DECIM_MAX_HALFBAND_STAGES];
+	std::vector<int16_t> out_i_;
+	std::vector<int16_t> out_q_;
+};
+
+/*
+ * A rational (L/M, L <= M) polyphase resampler for the rates that the
+ * halfband cascade can't reach on its own (e.g. 4 MSPS -> 1.333 MSPS is a
+ * 2/3 after one halfband). Kaiser windowed sinc prototype, RESAMP_TAPS_PER_PHASE
+ * int16 taps per phase stored reversed so every output is a contiguous
+ * int16 dot product. The anti-alias cutoff is 0.45 of the output rate.
+ */
+class CaribouliteResampler
+{
+public:
+	CaribouliteResampler();
+	~CaribouliteResampler() {}
+
+	/*
+	 * configure for in_rate -> out_rate (out_rate <= in_rate, a ratio
+	 * above 1 bypasses). The ratio is approximated with L <= RESAMP_MAX_INTERPOLATION
+	 * returns the exact output rate achieved. Resets the history.
+	 */
+	double setRates(double in_rate, double out_rate);
+	int getInterpolation(void) const {return interp_;}
+	int getDecimation(void) const {return decim_;}
+	bool isBypass(void) const {return interp_ == decim_;}
+	void reset(void);
+
+	size_t numOutputs(size_t num_in) const;
+
+	/*
+	 * resample num_in samples into out (room for numOutputs(num_in) samples)
+	 * returns the number of output samples. Not in-place.
+	 */
+	size_t process(const cariboulite_sample_complex_int16* in, size_t num_in, cariboulite_sample_complex_int16* out);
+
+private:
+	size_t processTile(const cariboulite_sample_complex_int16* in, size_t num_in, cariboulite_sample_complex_int16* out);
+
+	int interp_;                    // L
+	int decim_;                     // M
+	std::vector<int16_t> taps_;     // [phase][RESAMP_TAPS_PER_PHASE], reversed
+	uint64_t pos_;                  // next output's upsampled time in buffer coordinates
+	size_t hist_;
+	std::vector<int16_t> x_i_;      // [history | new samples]
+	std::vector<int16_t> x_q_;
+};
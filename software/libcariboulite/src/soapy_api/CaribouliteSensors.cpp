@@ -72,16 +72,22 @@ std::string Cariboulite::readSensor(const int direction, const size_t channel, c
 template <typename Type>
 Type Cariboulite::readSensor(const int direction, const size_t channel, const std::string &key) const
 {
+    // served from the sampler's cache - no SPI transaction per read
+    cariboulite_radio_sensors_st cached;
+    bool is_cached = cariboulite_radio_get_cached_sensors((cariboulite_radio_state_st*)radio, &cached) == 0;
+    
     if (direction == SOAPY_SDR_RX)
     {
         if (key == "RSSI")
         {
+            if (is_cached) return cached.rssi_dbm;
             float rssi = 0.0f;
             cariboulite_radio_get_rssi((cariboulite_radio_state_st*)radio, &rssi);
             return rssi;
         }
         if (key == "ENERGY")
         {
+            if (is_cached) return cached.energy_dbm;
             float energy = 0.0f;
             cariboulite_radio_get_energy_det((cariboulite_radio_state_st*)radio, &energy);
             return energy;
@@ -90,12 +96,14 @@ Type Cariboulite::readSensor(const int direction, const size_t channel, const st
 
     if (key == "PLL_LOCK_MODEM")
     {
+        if (is_cached) return cached.modem_pll_locked;
         return radio->modem_pll_locked;
     }
 
     if (channel == cariboulite_channel_hif && key == "PLL_LOCK_MIXER")
     {
+        if (is_cached) return cached.lo_pll_locked;
         return radio->lo_pll_locked;
     }
     return 0;
-}
\ No newline at end of file
+}
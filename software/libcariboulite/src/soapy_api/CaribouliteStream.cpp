@@ -1,122 +1,265 @@
 #include "Cariboulite.hpp"
-#include <Iir.h>
 #include <byteswap.h>
 #include <chrono>
+#include <cmath>
 
 
 #define NUM_BYTES_PER_CPLX_ELEM         ( sizeof(cariboulite_sample_complex_int16) )
-#define NUM_NATIVE_MTUS_PER_QUEUE		( 10 )
+#define NUM_SAMPLES_PER_CONV_TILE       ( 2048 )        // 8 KB native + up to 32 KB converted
+#define NUM_DIRECT_ACCESS_BUFFERS       ( 4 )
+#define DITHER_TABLE_SIZE               ( 4096 )        // power of 2
 
-// Undefine to also use TX
-//#define USE_ASYNC                       ( 1 )
-#define USE_ASYNC_OVERRIDE_WRITES       ( true )
-#define USE_ASYNC_BLOCK_READS           ( true )
+//=================================================================
+static void AsyncRxWork(SoapySDR::Stream* stream)
+{
+    int ret = cariboulite_radio_read_samples(stream->radio, 
+                                                stream->interm_native_buffer1, 
+                                                stream->interm_native_meta, 
+                                                stream->mtu_size);
+    if (ret < 0)
+    {
+        if (ret == -1)
+        {
+            SoapySDR_logf(SOAPY_SDR_ERROR, "async thread failed to read SMI!");
+        }
+        // a special case for debug streams which are not
+        // taken care of in the soapy front-end (ret = -2)
+        ret = 0;
+    }
+    if (ret == 0) return;
+    
+    if (!stream->async_block_on_full)
+    {
+        // overflow=drop: the oldest samples are overwritten (and counted)
+        stream->rx_queue->put(stream->interm_native_buffer1, ret);
+        return;
+    }
+    
+    // overflow=block: wait for the client to make room - while waiting the
+    // SMI itself isn't drained
+    size_t put_so_far = 0;
+    while (put_so_far < (size_t)ret && stream->stream_active)
+    {
+        put_so_far += stream->rx_queue->put_wait(stream->interm_native_buffer1 + put_so_far, ret - put_so_far);
+    }
+}
 
 //=================================================================
-void ReaderThread(SoapySDR::Stream* stream)
+static void AsyncTxWork(SoapySDR::Stream* stream)
 {
-#if USE_ASYNC
-    SoapySDR_logf(SOAPY_SDR_INFO, "Entering Reader Thread");
+    size_t len = stream->tx_queue->get_some(stream->interm_native_buffer1, stream->mtu_size, 10000);
+    if (len == 0)
+    {
+        return;
+    }
     
-    while (stream->readerThreadRunning())
+    int ret = cariboulite_radio_write_samples(stream->radio, stream->interm_native_buffer1, len);
+    if (ret < 0)
     {
-        if (!stream->stream_active)
+        SoapySDR_logf(SOAPY_SDR_ERROR, "async thread failed to write SMI!");
+    }
+    
+    // the client didn't keep up - the queue ran dry while streaming
+    if (stream->tx_queue->size() == 0 && stream->stream_active)
+    {
+        stream->tx_underflows++;
+    }
+}
+
+//=================================================================
+void AsyncStreamThread(SoapySDR::Stream* stream)
+{
+    SoapySDR_logf(SOAPY_SDR_INFO, "Entering Async Stream Thread");
+    
+    while (stream->waitStreamActive())
+    {
+        if (stream->getInnerStreamType() == cariboulite_channel_dir_rx)
         {
-            std::this_thread::sleep_for(std::chrono::milliseconds(10));
-            continue;
+            AsyncRxWork(stream);
         }
-        
-        int ret = cariboulite_radio_read_samples(stream->radio, 
-                                                    stream->interm_native_buffer1, 
-                                                    stream->interm_native_meta, 
-                                                    stream->mtu_size);
-        if (ret < 0)
+        else
         {
-            if (ret == -1)
-            {
-                printf("reader thread failed to read SMI!\n");
-            }
-            // a special case for debug streams which are not
-            // taken care of in the soapy front-end (ret = -2)
-            ret = 0;
+            AsyncTxWork(stream);
         }
-        
-        if (ret) stream->rx_queue->put(stream->interm_native_buffer1, ret);
     }
     
-    SoapySDR_logf(SOAPY_SDR_INFO, "Leaving Reader Thread");
-#endif //USE_ASYNC
+    SoapySDR_logf(SOAPY_SDR_INFO, "Leaving Async Stream Thread");
 }
 
 //=================================================================
 SoapySDR::Stream::Stream(cariboulite_radio_state_st *radio)
 {
     // init pointers
-    reader_thread = NULL;
+    async_thread = NULL;
     rx_queue = NULL;
+    tx_queue = NULL;
     interm_native_buffer1 = NULL;
     interm_native_buffer2 = NULL;
     interm_native_meta = NULL;
-    filter_i = NULL;
-	filter_q = NULL;
+    direct_buffer_elem_size = 0;
+    direct_next = 0;
+    dither_enabled = false;
+    dither_pos = 0x9E3779B9;
+    decim_native_buffer = NULL;
     
     // stream init
+    async_thread_running = 0;
+    stream_active = 0;
+    first_read_pending = false;
     this->radio = radio;
+    native_dir = cariboulite_channel_dir_rx;
     mtu_size = getMTUSizeElements();
     
     SoapySDR_logf(SOAPY_SDR_INFO, "Creating SampleQueue MTU: %d I/Q samples (%d bytes)", 
 				mtu_size, mtu_size * sizeof(cariboulite_sample_complex_int16));
 
-    #if USE_ASYNC
-        rx_queue = new circular_buffer<cariboulite_sample_complex_int16>(mtu_size * NUM_NATIVE_MTUS_PER_QUEUE, 
-                                                                         USE_ASYNC_OVERRIDE_WRITES, 
-                                                                         USE_ASYNC_BLOCK_READS);
-        interm_native_buffer1 = new cariboulite_sample_complex_int16[mtu_size];
-    #endif //USE_ASYNC
+    // sync by default - setupStream args may select the async mode
+    async_mode = false;
+    async_num_buffers = NUM_NATIVE_MTUS_PER_QUEUE;
+    async_block_on_full = false;
+    tx_underflows = 0;
 
 	format = CARIBOULITE_FORMAT_INT16;
 
-	// Init the internal IIR filters
     // a buffer for conversion between native and emulated formats
     interm_native_buffer2 = new cariboulite_sample_complex_int16[mtu_size];
     interm_native_meta = new cariboulite_sample_meta[mtu_size];
     
-	filterType = DigitalFilter_None;
-	filt20_i.setup(4e6, 20e3/2);
-	filt50_i.setup(4e6, 50e3/2);
-	filt100_i.setup(4e6, 100e3/2);
-
-	filt20_q.setup(4e6, 20e3/2);
-	filt50_q.setup(4e6, 50e3/2);
-	filt100_q.setup(4e6, 100e3/2);
+	// the decimator's native input - the filters are off by default
+    decim_native_buffer = new cariboulite_sample_complex_int16[mtu_size];
+    requested_rate = NATIVE_SAMPLE_RATE;
+    delivered_rate = NATIVE_SAMPLE_RATE;
+	setDigitalFilter(DigitalFilter_None);
     
-    #if USE_ASYNC
-        reader_thread_running = 1;
-        stream_active = 0;
-        reader_thread = new std::thread(ReaderThread, this);
-    #endif //USE_ASYNC
+    // the async worker thread is created on the first activation
 }
 
 //=================================================================
 SoapySDR::Stream::~Stream()
 {
-    filterType = DigitalFilter_None;
-	filter_i = NULL;
-	filter_q = NULL;
-    
-    #if USE_ASYNC
-        stream_active = 0;
-        reader_thread_running = 0;
-        reader_thread->join();
-        if (reader_thread) delete reader_thread;
-        if (interm_native_buffer1) delete[] interm_native_buffer1;
-        if (rx_queue) delete rx_queue;
-    #endif //USE_ASYNC
+    setAsyncMode(false, 0, false);
     
+    releaseDirectBuffers();
+    if (decim_native_buffer) delete[] decim_native_buffer;
     if (interm_native_buffer2) delete[] interm_native_buffer2;
     if (interm_native_meta) delete[] interm_native_meta;
 }
 
+//=================================================================
+void SoapySDR::Stream::activateStream(int active)
+{
+    {
+        std::lock_guard<std::mutex> lock(async_mtx);
+        stream_active = active;
+        if (active)
+        {
+            activation_time = std::chrono::steady_clock::now();
+            first_read_pending = true;
+        }
+        
+        // the filters start over on every activation (no stale history)
+        if (active)
+        {
+            decimator.reset();
+            resampler.reset();
+        }
+        
+        // start every activation with empty queues
+        if (active && async_mode)
+        {
+            if (rx_queue) rx_queue->reset();
+            if (tx_queue) tx_queue->reset();
+            tx_underflows = 0;
+        }
+        
+        if (active && async_mode && async_thread == NULL)
+        {
+            async_thread_running = 1;
+            async_thread = new std::thread(AsyncStreamThread, this);
+        }
+    }
+    async_cv.notify_one();
+}
+
+//=================================================================
+int SoapySDR::Stream::setAsyncMode(bool async, size_t num_buffers, bool block_on_full)
+{
+    if (stream_active)
+    {
+        SoapySDR_logf(SOAPY_SDR_ERROR, "the stream mode can't be changed while the stream is active");
+        return -1;
+    }
+    
+    // stop the worker before replacing its queues
+    {
+        std::lock_guard<std::mutex> lock(async_mtx);
+        async_thread_running = 0;
+    }
+    async_cv.notify_one();
+    if (async_thread)
+    {
+        async_thread->join();
+        delete async_thread;
+        async_thread = NULL;
+    }
+    
+    if (rx_queue) delete rx_queue;
+    if (tx_queue) delete tx_queue;
+    if (interm_native_buffer1) delete[] interm_native_buffer1;
+    rx_queue = NULL;
+    tx_queue = NULL;
+    interm_native_buffer1 = NULL;
+    
+    async_mode = async;
+    async_num_buffers = (num_buffers < 2) ? 2 : num_buffers;
+    async_block_on_full = block_on_full;
+    tx_underflows = 0;
+    if (!async_mode)
+    {
+        return 0;
+    }
+    
+    // RX overrides the oldest samples unless blocking was requested,
+    // TX never overrides - writeStream either waits for room or writes what fits
+    if (native_dir == cariboulite_channel_dir_rx)
+    {
+        rx_queue = new circular_buffer<cariboulite_sample_complex_int16>(mtu_size * async_num_buffers, !async_block_on_full, true);
+    }
+    else
+    {
+        tx_queue = new circular_buffer<cariboulite_sample_complex_int16>(mtu_size * async_num_buffers, false, true);
+    }
+    interm_native_buffer1 = new cariboulite_sample_complex_int16[mtu_size];
+    
+    SoapySDR_logf(SOAPY_SDR_INFO, "Async stream mode: %lu buffers of %lu samples, overflow=%s", 
+                async_num_buffers, mtu_size, async_block_on_full ? "block" : "drop");
+    return 0;
+}
+
+//=================================================================
+size_t SoapySDR::Stream::getRxOverflows(bool reset)
+{
+    if (!async_mode || rx_queue == NULL) return 0;
+    return rx_queue->dropped(reset);
+}
+
+//=================================================================
+size_t SoapySDR::Stream::getTxUnderflows(bool reset)
+{
+    size_t underflows = tx_underflows;
+    if (reset) tx_underflows = 0;
+    return underflows;
+}
+
+//=================================================================
+bool SoapySDR::Stream::waitStreamActive(void)
+{
+    // park the reader until the stream is activated - no wakeups while idle
+    std::unique_lock<std::mutex> lock(async_mtx);
+    async_cv.wait(lock, [this]{return !async_thread_running || stream_active;});
+    return async_thread_running;
+}
+
 //=================================================================
 size_t SoapySDR::Stream::getMTUSizeElements(void)
 {
@@ -126,21 +269,59 @@ size_t SoapySDR::Stream::getMTUSizeElements(void)
 //=================================================================
 void SoapySDR::Stream::setDigitalFilter(DigitalFilterType type)
 {
+	// halfband stages: 4 MSPS => 500 / 250 / 125 / 62.5 KSPS
 	switch (type)
 	{
-		case DigitalFilter_20KHz: filter_i = &filt20_i; filter_q = &filt20_q; break;
-		case DigitalFilter_50KHz: filter_i = &filt50_i; filter_q = &filt50_q; break;
-		case DigitalFilter_100KHz: filter_i = &filt100_i; filter_q = &filt100_q; break;
+		case DigitalFilter_20KHz: filter_stages = 6; break;
+		case DigitalFilter_50KHz: filter_stages = 5; break;
+		case DigitalFilter_100KHz: filter_stages = 4; break;
+		case DigitalFilter_200KHz: filter_stages = 3; break;
 		case DigitalFilter_None:
 		default: 
-			filter_i = NULL;
-			filter_q = NULL;
+			filter_stages = 0;
+			type = DigitalFilter_None;
 			break;
 	}
 	filterType = type;
+	updateRatePlan();
 }
 
+//=================================================================
+double SoapySDR::Stream::setSampleRate(double rate)
+{
+    if (rate < MIN_HOST_SAMPLE_RATE) rate = MIN_HOST_SAMPLE_RATE;
+    if (rate > NATIVE_SAMPLE_RATE) rate = NATIVE_SAMPLE_RATE;
+    requested_rate = rate;
+    updateRatePlan();
+    return delivered_rate;
+}
 
+//=================================================================
+void SoapySDR::Stream::updateRatePlan(void)
+{
+    // as many halfbands as the requested rate allows, then the rational
+    // stage covers the rest (its ratio stays within (0.5, 1])
+    int rate_stages = 0;
+    while (rate_stages < DECIM_MAX_HALFBAND_STAGES && 
+           NATIVE_SAMPLE_RATE / (1 << (rate_stages + 1)) >= requested_rate)
+    {
+        rate_stages ++;
+    }
+    
+    decimator.setStages(std::max(rate_stages, filter_stages));
+    double halfband_rate = NATIVE_SAMPLE_RATE / decimator.getFactor();
+    delivered_rate = resampler.setRates(halfband_rate, requested_rate);
+    
+    SoapySDR_logf(SOAPY_SDR_DEBUG, "Stream rate plan: %.1f SPS => 1/%d halfbands, %d/%d rational => %.3f SPS",
+                NATIVE_SAMPLE_RATE, decimator.getFactor(), 
+                resampler.getInterpolation(), resampler.getDecimation(), delivered_rate);
+}
+
+//=================================================================
+size_t SoapySDR::Stream::numOutputs(size_t num_native)
+{
+    return resampler.numOutputs(decimator.numOutputs(num_native));
+}
 
 //=================================================================
 cariboulite_channel_dir_en SoapySDR::Stream::getInnerStreamType(void)
@@ -165,23 +346,57 @@ int SoapySDR::Stream::setFormat(const std::string &fmt)
 		format = CARIBOULITE_FORMAT_FLOAT32;
 	else if (!fmt.compare(SOAPY_SDR_CF64))
 		format = CARIBOULITE_FORMAT_FLOAT64;
+	else if (!fmt.compare(SOAPY_SDR_CS12))
+		format = CARIBOULITE_FORMAT_INT12;
+	else if (!fmt.compare(SOAPY_SDR_CU8))
+		format = CARIBOULITE_FORMAT_UINT8;
 	else
 	{
 		return -1;
 	}
+	
+	// the direct access buffers are sized per element
+	if (direct_buffer_elem_size != getFormatElementSize())
+	{
+		releaseDirectBuffers();
+	}
 	return 0;
 }
 
+//=================================================================
+size_t SoapySDR::Stream::getFormatElementSize(void)
+{
+	switch (format)
+	{
+		case CARIBOULITE_FORMAT_FLOAT32: return sizeof(sample_complex_float);
+		case CARIBOULITE_FORMAT_INT8: return sizeof(sample_complex_int8);
+		case CARIBOULITE_FORMAT_FLOAT64: return sizeof(sample_complex_double);
+		case CARIBOULITE_FORMAT_INT12: return sizeof(sample_complex_int12);
+		case CARIBOULITE_FORMAT_UINT8: return sizeof(sample_complex_uint8);
+		case CARIBOULITE_FORMAT_INT16:
+		default: return sizeof(cariboulite_sample_complex_int16);
+	}
+}
+
 //=================================================================
 int SoapySDR::Stream::Write(cariboulite_sample_complex_int16 *buffer, size_t num_samples, uint8_t* meta, long timeout_us)
 {
+    if (async_mode)
+    {
+        // overflow=block waits for room, overflow=drop writes what fits
+        if (async_block_on_full)
+        {
+            return tx_queue->put_wait(buffer, num_samples, timeout_us);
+        }
+        return tx_queue->put(buffer, num_samples);
+    }
 	return cariboulite_radio_write_samples(radio, buffer, num_samples);
 }
 
 //=================================================================
 int SoapySDR::Stream::WriteSamples(cariboulite_sample_complex_int16* buffer, size_t num_elements, long timeout_us)
 {
-    int ret = cariboulite_radio_write_samples(radio, buffer, num_elements);
+    int ret = Write(buffer, num_elements, NULL, timeout_us);
     if (ret < 0)
     {
         if (ret == -1)
@@ -196,51 +411,230 @@ int SoapySDR::Stream::WriteSamples(cariboulite_sample_complex_int16* buffer, siz
 }
 
 //=================================================================
-int SoapySDR::Stream::WriteSamples(sample_complex_float* buffer, size_t num_elements, long timeout_us)
+// format conversion kernels (native CS16 <=> client formats)
+// plain branch-free loops over the tile - the compiler vectorizes them
+// (NEON on the RPI). The native samples are 13 bit (+-4096).
+// 'dither' is the stream's dither state, NULL = no dither.
+static inline void convertFromNative(const cariboulite_sample_complex_int16* in, sample_complex_float* out, size_t n, uint32_t* dither)
+{
+    const float scale = 1.0f / 4096.0f;
+    for (size_t i = 0; i < n; i++)
+    {
+        out[i].i = (float)(in[i].i) * scale;
+        out[i].q = (float)(in[i].q) * scale;
+    }
+}
+
+static inline void convertFromNative(const cariboulite_sample_complex_int16* in, sample_complex_double* out, size_t n, uint32_t* dither)
 {
-    num_elements = num_elements > mtu_size ? mtu_size : num_elements;
-    float max_val = 4096.0;
+    const double scale = 1.0 / 4096.0;
+    for (size_t i = 0; i < n; i++)
+    {
+        out[i].i = (double)(in[i].i) * scale;
+        out[i].q = (double)(in[i].q) * scale;
+    }
+}
 
-    for (size_t i = 0; i < num_elements; i++)
+//=================================================================
+// TPDF dither (+-1 LSB of the 8 bit output) - a fixed random table that
+// is entered at random offsets so the pattern never repeats periodically
+static std::vector<int16_t> makeDitherTable(void)
+{
+    std::vector<int16_t> table(DITHER_TABLE_SIZE);
+    uint32_t x = 0x2545F491;
+    for (size_t k = 0; k < DITHER_TABLE_SIZE; k++)
     {
-        interm_native_buffer2[i].i = (int16_t)(buffer[i].i * max_val);
-        interm_native_buffer2[i].q = (int16_t)(buffer[i].q * max_val);
+        x ^= x << 13; x ^= x >> 17; x ^= x << 5;
+        table[k] = (int16_t)((int32_t)(x & 0xFFF) + (int32_t)((x >> 12) & 0xFFF) - 4095);
+    }
+    return table;
+}
+
+static const int16_t* getDitherTable(void)
+{
+    static const std::vector<int16_t> table = makeDitherTable();
+    return &table[0];
+}
+
+// +-4096 => +-127 (rounded, saturated) + offset
+static inline int32_t quantize8(int32_t x, int32_t d, int32_t offset)
+{
+    int32_t y = (x * 127 + 2048 + d) >> 12;
+    y = (y > 127) ? 127 : y;
+    y = (y < -127) ? -127 : y;
+    return y + offset;
+}
 
+template <typename T, int OFFSET>
+static inline void convertTo8Bit(const cariboulite_sample_complex_int16* in, T* out, size_t n, uint32_t* dither)
+{
+    if (dither == NULL)
+    {
+        for (size_t i = 0; i < n; i++)
+        {
+            out[i].i = quantize8(in[i].i, 0, OFFSET);
+            out[i].q = quantize8(in[i].q, 0, OFFSET);
+        }
+        return;
     }
+    
+    const int16_t* table = getDitherTable();
+    size_t i = 0;
+    while (i < n)
+    {
+        // I and Q take consecutive table entries
+        uint32_t x = *dither;
+        x ^= x << 13; x ^= x >> 17; x ^= x << 5;
+        *dither = x;
+        size_t pos = (x >> 8) & (DITHER_TABLE_SIZE - 2);
+        size_t m = std::min(n - i, (size_t)(DITHER_TABLE_SIZE - pos) / 2);
+        const int16_t* d = table + pos;
+        const cariboulite_sample_complex_int16* src = in + i;
+        T* dst = out + i;
+        for (size_t k = 0; k < m; k++)
+        {
+            dst[k].i = quantize8(src[k].i, d[2*k], OFFSET);
+            dst[k].q = quantize8(src[k].q, d[2*k + 1], OFFSET);
+        }
+        i += m;
+    }
+}
 
-    return WriteSamples(interm_native_buffer2, num_elements, timeout_us);
+static inline void convertFromNative(const cariboulite_sample_complex_int16* in, sample_complex_int8* out, size_t n, uint32_t* dither)
+{
+    convertTo8Bit<sample_complex_int8, 0>(in, out, n, dither);
 }
 
-//=================================================================
-int SoapySDR::Stream::WriteSamples(sample_complex_double* buffer, size_t num_elements, long timeout_us)
+static inline void convertFromNative(const cariboulite_sample_complex_int16* in, sample_complex_uint8* out, size_t n, uint32_t* dither)
 {
-    num_elements = num_elements > mtu_size ? mtu_size : num_elements;
-    double max_val = 4096.0;
+    convertTo8Bit<sample_complex_uint8, 128>(in, out, n, dither);
+}
 
-    for (size_t i = 0; i < num_elements; i++)
+static inline void convertFromNative(const cariboulite_sample_complex_int16* in, sample_complex_int12* out, size_t n, uint32_t* dither)
+{
+    // +-4096 => +-2048 (rounded, saturated) and packed to 3 bytes
+    for (size_t k = 0; k < n; k++)
     {
-        interm_native_buffer2[i].i = (int16_t)(buffer[i].i * max_val);
-        interm_native_buffer2[i].q = (int16_t)(buffer[i].q * max_val);
+        int32_t si = (in[k].i + 1) >> 1;
+        int32_t sq = (in[k].q + 1) >> 1;
+        si = (si > 2047) ? 2047 : ((si < -2048) ? -2048 : si);
+        sq = (sq > 2047) ? 2047 : ((sq < -2048) ? -2048 : sq);
+        out[k].b[0] = (uint8_t)(si & 0xFF);
+        out[k].b[1] = (uint8_t)(((sq & 0x0F) << 4) | ((si >> 8) & 0x0F));
+        out[k].b[2] = (uint8_t)((sq >> 4) & 0xFF);
+    }
+}
 
+static inline void convertToNative(const sample_complex_float* in, cariboulite_sample_complex_int16* out, size_t n)
+{
+    const float max_val = 4096.0f;
+    for (size_t i = 0; i < n; i++)
+    {
+        out[i].i = (int16_t)(in[i].i * max_val);
+        out[i].q = (int16_t)(in[i].q * max_val);
     }
+}
 
-    return WriteSamples(interm_native_buffer2, num_elements, timeout_us);
+static inline void convertToNative(const sample_complex_double* in, cariboulite_sample_complex_int16* out, size_t n)
+{
+    const double max_val = 4096.0;
+    for (size_t i = 0; i < n; i++)
+    {
+        out[i].i = (int16_t)(in[i].i * max_val);
+        out[i].q = (int16_t)(in[i].q * max_val);
+    }
 }
 
+static inline void convertToNative(const sample_complex_int8* in, cariboulite_sample_complex_int16* out, size_t n)
+{
+    for (size_t i = 0; i < n; i++)
+    {
+        out[i].i = ((int16_t)(in[i].i)) << 5;
+        out[i].q = ((int16_t)(in[i].q)) << 5;
+    }
+}
 
-//=================================================================
-int SoapySDR::Stream::WriteSamples(sample_complex_int8* buffer, size_t num_elements, long timeout_us)
+static inline void convertToNative(const sample_complex_uint8* in, cariboulite_sample_complex_int16* out, size_t n)
 {
-    num_elements = num_elements > mtu_size ? mtu_size : num_elements;
+    for (size_t i = 0; i < n; i++)
+    {
+        out[i].i = ((int16_t)(in[i].i) - 128) << 5;
+        out[i].q = ((int16_t)(in[i].q) - 128) << 5;
+    }
+}
 
-    for (size_t i = 0; i < num_elements; i++)
+static inline void convertToNative(const sample_complex_int12* in, cariboulite_sample_complex_int16* out, size_t n)
+{
+    // sign extend the 12 bit values from the top of an int16, then x2
+    for (size_t k = 0; k < n; k++)
     {
-        interm_native_buffer2[i].i = ((int16_t)(buffer[i].i)) << 5;
-        interm_native_buffer2[i].q = ((int16_t)(buffer[i].q)) << 5;
+        uint16_t b0 = in[k].b[0], b1 = in[k].b[1], b2 = in[k].b[2];
+        out[k].i = (int16_t)((b1 << 12) | (b0 << 4)) >> 3;
+        out[k].q = (int16_t)((b2 << 8) | (b1 & 0xF0)) >> 3;
+    }
+}
 
+//=================================================================
+size_t SoapySDR::Stream::getConversionTileSize(void)
+{
+    return (mtu_size < NUM_SAMPLES_PER_CONV_TILE) ? mtu_size : NUM_SAMPLES_PER_CONV_TILE;
+}
+
+//=================================================================
+template <typename T>
+int SoapySDR::Stream::WriteSamplesTiled(const T* buffer, size_t num_elements, long timeout_us)
+{
+    // convert tile by tile so that the intermediate native samples stay in
+    // cache, and honour the full requested length
+    size_t tile = getConversionTileSize();
+    size_t written_so_far = 0;
+    
+    while (written_so_far < num_elements)
+    {
+        size_t current = num_elements - written_so_far;
+        if (current > tile) current = tile;
+        
+        convertToNative(buffer + written_so_far, interm_native_buffer2, current);
+        int ret = WriteSamples(interm_native_buffer2, current, timeout_us);
+        if (ret <= 0)
+        {
+            if (written_so_far == 0) return ret;
+            break;
+        }
+        written_so_far += ret;
+        if ((size_t)ret < current) break;
     }
+    return written_so_far;
+}
 
-    return WriteSamples(interm_native_buffer2, num_elements, timeout_us);
+//=================================================================
+int SoapySDR::Stream::WriteSamples(sample_complex_float* buffer, size_t num_elements, long timeout_us)
+{
+    return WriteSamplesTiled(buffer, num_elements, timeout_us);
+}
+
+//=================================================================
+int SoapySDR::Stream::WriteSamples(sample_complex_double* buffer, size_t num_elements, long timeout_us)
+{
+    return WriteSamplesTiled(buffer, num_elements, timeout_us);
+}
+
+//=================================================================
+int SoapySDR::Stream::WriteSamples(sample_complex_int8* buffer, size_t num_elements, long timeout_us)
+{
+    return WriteSamplesTiled(buffer, num_elements, timeout_us);
+}
+
+//=================================================================
+int SoapySDR::Stream::WriteSamples(sample_complex_uint8* buffer, size_t num_elements, long timeout_us)
+{
+    return WriteSamplesTiled(buffer, num_elements, timeout_us);
+}
+
+//=================================================================
+int SoapySDR::Stream::WriteSamples(sample_complex_int12* buffer, size_t num_elements, long timeout_us)
+{
+    return WriteSamplesTiled(buffer, num_elements, timeout_us);
 }
 
 //=================================================================
@@ -251,6 +645,8 @@ int SoapySDR::Stream::WriteSamplesGen(void* buffer, size_t num_elements, long ti
 		case CARIBOULITE_FORMAT_FLOAT32: return WriteSamples((sample_complex_float*)buffer, num_elements, timeout_us); break;
 	    case CARIBOULITE_FORMAT_INT16: return WriteSamples((cariboulite_sample_complex_int16*)buffer, num_elements, timeout_us); break;
 	    case CARIBOULITE_FORMAT_INT8: return WriteSamples((sample_complex_int8*)buffer, num_elements, timeout_us); break;
+	    case CARIBOULITE_FORMAT_UINT8: return WriteSamples((sample_complex_uint8*)buffer, num_elements, timeout_us); break;
+	    case CARIBOULITE_FORMAT_INT12: return WriteSamples((sample_complex_int12*)buffer, num_elements, timeout_us); break;
 	    case CARIBOULITE_FORMAT_FLOAT64: return WriteSamples((sample_complex_double*)buffer, num_elements, timeout_us); break;
 		default: return WriteSamples((cariboulite_sample_complex_int16*)buffer, num_elements, timeout_us); break;
 	}
@@ -259,10 +655,14 @@ int SoapySDR::Stream::WriteSamplesGen(void* buffer, size_t num_elements, long ti
 //=================================================================
 int SoapySDR::Stream::Read(cariboulite_sample_complex_int16 *buffer, size_t num_samples, uint8_t *meta, long timeout_us)
 {
-    #if USE_ASYNC
-        return rx_queue->get(buffer, num_samples, timeout_us);
-    #else                                                        // caribou_smi_sample_meta not defined...
-        int ret = cariboulite_radio_read_samples(radio, buffer, (cariboulite_sample_meta*)meta, num_samples);
+    int ret = 0;
+    if (async_mode)
+    {
+        ret = rx_queue->get_some(buffer, num_samples, timeout_us);
+    }
+    else
+    {                                                        // caribou_smi_sample_meta not defined...
+        ret = cariboulite_radio_read_samples(radio, buffer, (cariboulite_sample_meta*)meta, num_samples);
         if (ret < 0)
         {
             if (ret == -1)
@@ -274,109 +674,311 @@ int SoapySDR::Stream::Read(cariboulite_sample_complex_int16 *buffer, size_t num_
             // taken care of in the soapy front-end (ret = -2)
             ret = 0;
         }
-        return ret;
-    #endif //USE_ASYNC
+    }
+    
+    // stream start latency - activation to the first samples delivered
+    if (ret > 0 && first_read_pending.exchange(false))
+    {
+        double lat_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - activation_time).count();
+        SoapySDR_logf(SOAPY_SDR_DEBUG, "Stream start latency: %.2f ms", lat_ms);
+    }
+    return ret;
 }
 
 //=================================================================
 int SoapySDR::Stream::ReadSamples(cariboulite_sample_complex_int16* buffer, size_t num_elements, long timeout_us)
 {
-    int res = Read(buffer, num_elements, NULL, timeout_us);
-    if (res < 0)
+    if (decimator.getFactor() == 1 && resampler.isBypass())
     {
-        //SoapySDR_logf(SOAPY_SDR_ERROR, "Reading %d elements failed from queue", num_elements); 
-        return res;
+        return Read(buffer, num_elements, NULL, timeout_us);
     }
     
-	if (filterType != DigitalFilter_None && filter_i != NULL && filter_q != NULL)
-	{
-		for (int i = 0; i < res; i++)
-		{
-			buffer[i].i = (int16_t)filter_i->filter((float)buffer[i].i);
-			buffer[i].q = (int16_t)filter_q->filter((float)buffer[i].q);
-		}
-	}
+    // num_elements are output samples - read just enough native samples
+    // for them so no filtered sample is ever thrown away
+    double native_per_output = NATIVE_SAMPLE_RATE / delivered_rate;
+    size_t read_so_far = 0;
+    while (read_so_far < num_elements)
+    {
+        size_t remaining = num_elements - read_so_far;
+        size_t chunk = (size_t)ceil(remaining * native_per_output);
+        if (chunk > mtu_size) chunk = mtu_size;
+        
+        // the filters' history may add a few outputs - trim the read
+        size_t outputs = numOutputs(chunk);
+        while (outputs > remaining)
+        {
+            size_t cut = (size_t)ceil((outputs - remaining) * native_per_output);
+            chunk = (cut < chunk) ? (chunk - cut) : 1;
+            outputs = numOutputs(chunk);
+        }
+        
+        int res = Read(decim_native_buffer, chunk, NULL, timeout_us);
+        if (res <= 0)
+        {
+            if (read_so_far == 0) return res;
+            break;
+        }
+        
+        // the halfbands run in-place, the rational stage into the caller's buffer
+        size_t num_decimated = decimator.process(decim_native_buffer, res, decim_native_buffer);
+        read_so_far += resampler.process(decim_native_buffer, num_decimated, buffer + read_so_far);
+        if ((size_t)res < chunk) break;
+    }
+    return read_so_far;
+}
 
-    return res;  
+//=================================================================
+template <typename T>
+int SoapySDR::Stream::ReadSamplesTiled(T* buffer, size_t num_elements, long timeout_us)
+{
+    // read and convert tile by tile straight into the caller's buffer - the
+    // native tile stays in cache and the full requested length is honoured
+    size_t tile = getConversionTileSize();
+    size_t read_so_far = 0;
+    
+    while (read_so_far < num_elements)
+    {
+        size_t current = num_elements - read_so_far;
+        if (current > tile) current = tile;
+        
+        int res = ReadSamples(interm_native_buffer2, current, timeout_us);
+        if (res <= 0)
+        {
+            if (read_so_far == 0) return res;
+            break;
+        }
+        
+        convertFromNative(interm_native_buffer2, buffer + read_so_far, res, dither_enabled ? &dither_pos : NULL);
+        read_so_far += res;
+        if ((size_t)res < current) break;
+    }
+    return read_so_far;
 }
 
 //=================================================================
 int SoapySDR::Stream::ReadSamples(sample_complex_float* buffer, size_t num_elements, long timeout_us)
 {
-    num_elements = num_elements > mtu_size ? mtu_size : num_elements;
+    return ReadSamplesTiled(buffer, num_elements, timeout_us);
+}
 
-    // read out the native data type
-    int res = ReadSamples(interm_native_buffer2, num_elements, timeout_us);
-    if (res < 0)
-    {
-        return res;
-    }
+//=================================================================
+int SoapySDR::Stream::ReadSamples(sample_complex_double* buffer, size_t num_elements, long timeout_us)
+{
+    return ReadSamplesTiled(buffer, num_elements, timeout_us);
+}
 
-    float max_val = 4096.0f;
+//=================================================================
+int SoapySDR::Stream::ReadSamples(sample_complex_int8* buffer, size_t num_elements, long timeout_us)
+{
+    return ReadSamplesTiled(buffer, num_elements, timeout_us);
+}
 
-    for (int i = 0; i < res; i++)
-    {
-        buffer[i].i = (float)(interm_native_buffer2[i].i) / max_val;
-        buffer[i].q = (float)(interm_native_buffer2[i].q) / max_val;
-    }
-    return res;
+//=================================================================
+int SoapySDR::Stream::ReadSamples(sample_complex_uint8* buffer, size_t num_elements, long timeout_us)
+{
+    return ReadSamplesTiled(buffer, num_elements, timeout_us);
 }
 
 //=================================================================
-int SoapySDR::Stream::ReadSamples(sample_complex_double* buffer, size_t num_elements, long timeout_us)
+int SoapySDR::Stream::ReadSamples(sample_complex_int12* buffer, size_t num_elements, long timeout_us)
+{
+    return ReadSamplesTiled(buffer, num_elements, timeout_us);
+}
+
+//=================================================================
+int SoapySDR::Stream::ReadSamplesGen(void* buffer, size_t num_elements, long timeout_us)
 {
-    num_elements = num_elements > mtu_size ? mtu_size : num_elements;
+    //printf("reading ne=%d\n", num_elements);
+	switch (format)
+	{
+		case CARIBOULITE_FORMAT_FLOAT32: return ReadSamples((sample_complex_float*)buffer, num_elements, timeout_us); break;
+	    case CARIBOULITE_FORMAT_INT16: return ReadSamples((cariboulite_sample_complex_int16*)buffer, num_elements, timeout_us); break;
+	    case CARIBOULITE_FORMAT_INT8: return ReadSamples((sample_complex_int8*)buffer, num_elements, timeout_us); break;
+	    case CARIBOULITE_FORMAT_UINT8: return ReadSamples((sample_complex_uint8*)buffer, num_elements, timeout_us); break;
+	    case CARIBOULITE_FORMAT_INT12: return ReadSamples((sample_complex_int12*)buffer, num_elements, timeout_us); break;
+	    case CARIBOULITE_FORMAT_FLOAT64: return ReadSamples((sample_complex_double*)buffer, num_elements, timeout_us); break;
+		default: return ReadSamples((cariboulite_sample_complex_int16*)buffer, num_elements, timeout_us); break;
+	}
+	return 0;
+}
 
-    // read out the native data type
-    int res = ReadSamples(interm_native_buffer2, num_elements, timeout_us);
-    if (res < 0)
+//=================================================================
+int SoapySDR::Stream::setupDirectBuffers(void)
+{
+    // direct_mtx is held by the caller
+    size_t elem_size = getFormatElementSize();
+    if (!direct_buffers.empty() && direct_buffer_elem_size == elem_size)
     {
-        return res;
+        return 0;
     }
+    
+    for (size_t i = 0; i < direct_buffer_busy.size(); i++)
+    {
+        if (direct_buffer_busy[i])
+        {
+            SoapySDR_logf(SOAPY_SDR_ERROR, "direct access buffers are in use, can't re-allocate them");
+            return -1;
+        }
+    }
+    for (size_t i = 0; i < direct_buffers.size(); i++) delete[] direct_buffers[i];
+    direct_buffers.clear();
+    direct_buffer_busy.clear();
+    
+    // room for mtu_size elements of the client format and, for the wider
+    // formats, for the native samples that are converted in place
+    size_t buf_size = mtu_size * std::max(elem_size, sizeof(cariboulite_sample_complex_int16));
+    for (int i = 0; i < NUM_DIRECT_ACCESS_BUFFERS; i++)
+    {
+        direct_buffers.push_back(new uint8_t[buf_size]);
+        direct_buffer_busy.push_back(false);
+    }
+    direct_buffer_elem_size = elem_size;
+    direct_next = 0;
+    
+    SoapySDR_logf(SOAPY_SDR_DEBUG, "Allocated %d direct access buffers, %lu bytes each", NUM_DIRECT_ACCESS_BUFFERS, buf_size);
+    return 0;
+}
 
-    double max_val = 4096.0;
-
-    for (int i = 0; i < res; i++)
+//=================================================================
+void SoapySDR::Stream::releaseDirectBuffers(void)
+{
+    std::lock_guard<std::mutex> lock(direct_mtx);
+    for (size_t i = 0; i < direct_buffer_busy.size(); i++)
     {
-        buffer[i].i = (double)(interm_native_buffer2[i].i) / max_val;
-        buffer[i].q = (double)(interm_native_buffer2[i].q) / max_val;
+        if (direct_buffer_busy[i])
+        {
+            SoapySDR_logf(SOAPY_SDR_WARNING, "releasing direct access buffer %lu while still acquired", i);
+        }
     }
+    for (size_t i = 0; i < direct_buffers.size(); i++) delete[] direct_buffers[i];
+    direct_buffers.clear();
+    direct_buffer_busy.clear();
+    direct_buffer_elem_size = 0;
+}
 
-    return res;
+//=================================================================
+size_t SoapySDR::Stream::getNumDirectBuffers(void)
+{
+    std::lock_guard<std::mutex> lock(direct_mtx);
+    if (setupDirectBuffers() != 0) return 0;
+    return direct_buffers.size();
 }
 
 //=================================================================
-int SoapySDR::Stream::ReadSamples(sample_complex_int8* buffer, size_t num_elements, long timeout_us)
+void* SoapySDR::Stream::getDirectBuffer(size_t handle)
 {
-    num_elements = num_elements > mtu_size ? mtu_size : num_elements;
+    std::lock_guard<std::mutex> lock(direct_mtx);
+    if (setupDirectBuffers() != 0 || handle >= direct_buffers.size()) return NULL;
+    return direct_buffers[handle];
+}
 
-    // read out the native data type
-    int res = ReadSamples(interm_native_buffer2, num_elements, timeout_us);
-    if (res < 0)
+//=================================================================
+int SoapySDR::Stream::readDirect(uint8_t* buffer, size_t num_elements, long timeout_us)
+{
+    // the native samples are read into the tail of the buffer and converted
+    // forward, in place - each converted element only overwrites native
+    // samples that were already consumed
+    size_t elem_size = getFormatElementSize();
+    size_t native_size = sizeof(cariboulite_sample_complex_int16);
+    size_t offset = (elem_size > native_size) ? (elem_size - native_size) * num_elements : 0;
+    cariboulite_sample_complex_int16* native = (cariboulite_sample_complex_int16*)(buffer + offset);
+    
+    int res = ReadSamples(native, num_elements, timeout_us);
+    if (res <= 0)
     {
         return res;
     }
-
-    for (int i = 0; i < res; i++)
+    
+    uint32_t* dither = dither_enabled ? &dither_pos : NULL;
+    switch (format)
     {
-        buffer[i].i = (int8_t)((interm_native_buffer2[i].i >> 5)&0x00FF);
-        buffer[i].q = (int8_t)((interm_native_buffer2[i].q >> 5)&0x00FF);
+        case CARIBOULITE_FORMAT_FLOAT32: convertFromNative(native, (sample_complex_float*)buffer, res, dither); break;
+        case CARIBOULITE_FORMAT_INT8: convertFromNative(native, (sample_complex_int8*)buffer, res, dither); break;
+        case CARIBOULITE_FORMAT_FLOAT64: convertFromNative(native, (sample_complex_double*)buffer, res, dither); break;
+        case CARIBOULITE_FORMAT_INT12: convertFromNative(native, (sample_complex_int12*)buffer, res, dither); break;
+        case CARIBOULITE_FORMAT_UINT8: convertFromNative(native, (sample_complex_uint8*)buffer, res, dither); break;
+        case CARIBOULITE_FORMAT_INT16:
+        default: break;
     }
+    return res;
+}
 
+//=================================================================
+int SoapySDR::Stream::acquireDirectReadBuffer(size_t &handle, const void **buffs, long timeout_us)
+{
+    uint8_t* buffer = NULL;
+    {
+        std::lock_guard<std::mutex> lock(direct_mtx);
+        if (setupDirectBuffers() != 0) return SOAPY_SDR_STREAM_ERROR;
+        
+        // round robin over the free buffers
+        size_t n = direct_buffers.size();
+        for (size_t i = 0; i < n && buffer == NULL; i++)
+        {
+            size_t h = (direct_next + i) % n;
+            if (!direct_buffer_busy[h])
+            {
+                direct_buffer_busy[h] = true;
+                direct_next = (h + 1) % n;
+                handle = h;
+                buffer = direct_buffers[h];
+            }
+        }
+    }
+    
+    // all the buffers are held by the client
+    if (buffer == NULL) return SOAPY_SDR_TIMEOUT;
+    
+    int res = readDirect(buffer, mtu_size, timeout_us);
+    if (res <= 0)
+    {
+        releaseDirectReadBuffer(handle);
+        return (res == 0) ? SOAPY_SDR_TIMEOUT : res;
+    }
+    buffs[0] = buffer;
     return res;
 }
 
 //=================================================================
-int SoapySDR::Stream::ReadSamplesGen(void* buffer, size_t num_elements, long timeout_us)
+void SoapySDR::Stream::releaseDirectReadBuffer(size_t handle)
 {
-    //printf("reading ne=%d\n", num_elements);
-	switch (format)
-	{
-		case CARIBOULITE_FORMAT_FLOAT32: return ReadSamples((sample_complex_float*)buffer, num_elements, timeout_us); break;
-	    case CARIBOULITE_FORMAT_INT16: return ReadSamples((cariboulite_sample_complex_int16*)buffer, num_elements, timeout_us); break;
-	    case CARIBOULITE_FORMAT_INT8: return ReadSamples((sample_complex_int8*)buffer, num_elements, timeout_us); break;
-	    case CARIBOULITE_FORMAT_FLOAT64: return ReadSamples((sample_complex_double*)buffer, num_elements, timeout_us); break;
-		default: return ReadSamples((cariboulite_sample_complex_int16*)buffer, num_elements, timeout_us); break;
-	}
-	return 0;
-}
\ No newline at end of file
+    std::lock_guard<std::mutex> lock(direct_mtx);
+    if (handle < direct_buffer_busy.size()) direct_buffer_busy[handle] = false;
+}
+
+//=================================================================
+int SoapySDR::Stream::acquireDirectWriteBuffer(size_t &handle, void **buffs, long timeout_us)
+{
+    std::lock_guard<std::mutex> lock(direct_mtx);
+    if (setupDirectBuffers() != 0) return SOAPY_SDR_STREAM_ERROR;
+    
+    size_t n = direct_buffers.size();
+    for (size_t i = 0; i < n; i++)
+    {
+        size_t h = (direct_next + i) % n;
+        if (!direct_buffer_busy[h])
+        {
+            direct_buffer_busy[h] = true;
+            direct_next = (h + 1) % n;
+            handle = h;
+            buffs[0] = direct_buffers[h];
+            return mtu_size;
+        }
+    }
+    return SOAPY_SDR_TIMEOUT;
+}
+
+//=================================================================
+int SoapySDR::Stream::releaseDirectWriteBuffer(size_t handle, size_t num_elements, long timeout_us)
+{
+    void* buffer = getDirectBuffer(handle);
+    if (buffer == NULL) return SOAPY_SDR_STREAM_ERROR;
+    
+    // native CS16 goes out as is, other formats through the tiled conversion
+    if (num_elements > mtu_size) num_elements = mtu_size;
+    int res = WriteSamplesGen(buffer, num_elements, timeout_us);
+    
+    std::lock_guard<std::mutex> lock(direct_mtx);
+    direct_buffer_busy[handle] = false;
+    return res;
+}
@@ -8,11 +8,12 @@
 #include <mutex>
 #include <atomic>
 #include <condition_variable>
+#include <chrono>
 #include <string>
+#include <vector>
 #include <cstring>
 #include <algorithm>
 #include <atomic>
-#include <Iir.h>
 
 //#define ZF_LOG_LEVEL ZF_LOG_ERROR
 #define ZF_LOG_LEVEL ZF_LOG_VERBOSE
@@ -20,8 +21,11 @@
 #include "datatypes/circular_buffer.h"
 #include "cariboulite_setup.h"
 #include "cariboulite_radio.h"
+#include "CaribouliteDecimator.hpp"
 
-#define DIG_FILT_ORDER		6
+#define NUM_NATIVE_MTUS_PER_QUEUE		( 10 )
+#define NATIVE_SAMPLE_RATE				( 4000000.0 )	// the SMI always delivers 4 MSPS
+#define MIN_HOST_SAMPLE_RATE			( NATIVE_SAMPLE_RATE / (1 << DECIM_MAX_HALFBAND_STAGES) / 2 )
 
 #pragma pack(1)
 // associated with CS8 - total 2 bytes / element
@@ -31,11 +35,18 @@ typedef struct
 	int8_t q;                       // MSB
 } sample_complex_int8;
 
-// associated with CS12 - total 3 bytes / element
+// associated with CU8 (rtl_sdr style, 128 = zero) - total 2 bytes / element
 typedef struct
 {
-	int16_t i :12;                  // LSB
-	int16_t q :12;                  // MSB
+	uint8_t i;                      // LSB
+	uint8_t q;                      // MSB
+} sample_complex_uint8;
+
+// associated with CS12 - total 3 bytes / element, packed as SoapySDR does:
+// b[0] = I[7:0], b[1] = Q[3:0] | I[11:8], b[2] = Q[11:4]
+typedef struct
+{
+	uint8_t b[3];
 } sample_complex_int12;
 
 // associated with CS32 - total 8 bytes / element
@@ -70,6 +81,8 @@ public:
 		CARIBOULITE_FORMAT_INT16	= 1,
 		CARIBOULITE_FORMAT_INT8	    = 2,
 		CARIBOULITE_FORMAT_FLOAT64  = 3,
+		CARIBOULITE_FORMAT_INT12    = 4,
+		CARIBOULITE_FORMAT_UINT8    = 5,
 	};
 	CaribouliteFormat format;
 	
@@ -92,43 +105,108 @@ public:
 	int ReadSamples(sample_complex_float* buffer, size_t num_elements, long timeout_us);
 	int ReadSamples(sample_complex_double* buffer, size_t num_elements, long timeout_us);
 	int ReadSamples(sample_complex_int8* buffer, size_t num_elements, long timeout_us);
+	int ReadSamples(sample_complex_uint8* buffer, size_t num_elements, long timeout_us);
+	int ReadSamples(sample_complex_int12* buffer, size_t num_elements, long timeout_us);
 	int ReadSamplesGen(void* buffer, size_t num_elements, long timeout_us);
     
     int WriteSamples(cariboulite_sample_complex_int16* buffer, size_t num_elements, long timeout_us);
 	int WriteSamples(sample_complex_float* buffer, size_t num_elements, long timeout_us);
 	int WriteSamples(sample_complex_double* buffer, size_t num_elements, long timeout_us);
 	int WriteSamples(sample_complex_int8* buffer, size_t num_elements, long timeout_us);
+	int WriteSamples(sample_complex_uint8* buffer, size_t num_elements, long timeout_us);
+	int WriteSamples(sample_complex_int12* buffer, size_t num_elements, long timeout_us);
 	int WriteSamplesGen(void* buffer, size_t num_elements, long timeout_us);
 
+	template <typename T> int ReadSamplesTiled(T* buffer, size_t num_elements, long timeout_us);
+	template <typename T> int WriteSamplesTiled(const T* buffer, size_t num_elements, long timeout_us);
+	size_t getConversionTileSize(void);
+
+	// direct buffer access (zero-copy) pool
+	size_t getNumDirectBuffers(void);
+	void* getDirectBuffer(size_t handle);
+	int acquireDirectReadBuffer(size_t &handle, const void **buffs, long timeout_us);
+	void releaseDirectReadBuffer(size_t handle);
+	int acquireDirectWriteBuffer(size_t &handle, void **buffs, long timeout_us);
+	int releaseDirectWriteBuffer(size_t handle, size_t num_elements, long timeout_us);
+
 	cariboulite_channel_dir_en getInnerStreamType(void);
     void setInnerStreamType(cariboulite_channel_dir_en dir);
 	void setDigitalFilter(DigitalFilterType type);
 	DigitalFilterType getDigitalFilter() const { return filterType;};
+	int getDecimation(void) const {return decimator.getFactor();};
+	
+	// host side rate - halfband decimation (at least what the digital
+	// filter needs) followed by a rational stage when required
+	double setSampleRate(double rate);
+	double getSampleRate(void) const {return delivered_rate;};
 	int setFormat(const std::string &fmt);
-	inline int readerThreadRunning() {return reader_thread_running;};
-    void activateStream(int active) {stream_active = active;};
+	size_t getFormatElementSize(void);
+	// TPDF dither before the 8 bit quantization (CS8 / CU8 RX)
+	void setDither(bool enable) {dither_enabled = enable;};
+	bool getDither(void) const {return dither_enabled;};
+	inline int asyncThreadRunning() {return async_thread_running;};
+    void activateStream(int active);
+    bool waitStreamActive(void);
+    
+    // async mode - a worker thread keeps the SMI drained (RX) / fed (TX)
+    // through a sample queue of 'num_buffers' MTUs
+    int setAsyncMode(bool async, size_t num_buffers, bool block_on_full);
+    bool isAsync(void) const {return async_mode;};
+    size_t getRxOverflows(bool reset);
+    size_t getTxUnderflows(bool reset);
     
 public:
     cariboulite_radio_state_st *radio;
     cariboulite_channel_dir_en native_dir;
     size_t mtu_size;
-    std::thread *reader_thread;
-    int stream_active;
-    int reader_thread_running;
+    
+    // the async worker thread is created on the first activation and parks
+    // on async_cv while the stream is inactive
+    bool async_mode;
+    size_t async_num_buffers;
+    bool async_block_on_full;
+    std::thread *async_thread;
+    std::mutex async_mtx;
+    std::condition_variable async_cv;
+    std::atomic<int> stream_active;
+    std::atomic<int> async_thread_running;
+    std::chrono::steady_clock::time_point activation_time;
+    std::atomic<bool> first_read_pending;
 	circular_buffer<cariboulite_sample_complex_int16> *rx_queue;
+	circular_buffer<cariboulite_sample_complex_int16> *tx_queue;
+	std::atomic<size_t> tx_underflows;
     
 	cariboulite_sample_complex_int16 *interm_native_buffer1;
     cariboulite_sample_complex_int16 *interm_native_buffer2;
     cariboulite_sample_meta* interm_native_meta;
+	// direct access buffers - mtu_size elements of the stream format each,
+	// allocated on first use (and re-allocated when the element size changes)
+	std::mutex direct_mtx;
+	std::vector<uint8_t*> direct_buffers;
+	std::vector<bool> direct_buffer_busy;
+	size_t direct_buffer_elem_size;
+	size_t direct_next;
+	bool dither_enabled;
+	uint32_t dither_pos;
+
+private:
+	int setupDirectBuffers(void);
+	void releaseDirectBuffers(void);
+	int readDirect(uint8_t* buffer, size_t num_elements, long timeout_us);
+
+public:
+	// the digital filters decimate - the delivered rate is the modem's / factor
 	DigitalFilterType filterType;
-	Iir::Butterworth::LowPass<DIG_FILT_ORDER>* filter_i;
-	Iir::Butterworth::LowPass<DIG_FILT_ORDER>* filter_q;
-	Iir::Butterworth::LowPass<DIG_FILT_ORDER> filt20_i;
-	Iir::Butterworth::LowPass<DIG_FILT_ORDER> filt20_q;
-	Iir::Butterworth::LowPass<DIG_FILT_ORDER> filt50_i;
-	Iir::Butterworth::LowPass<DIG_FILT_ORDER> filt50_q;
-	Iir::Butterworth::LowPass<DIG_FILT_ORDER> filt100_i;
-	Iir::Butterworth::LowPass<DIG_FILT_ORDER> filt100_q;
+	int filter_stages;
+	double requested_rate;
+	double delivered_rate;
+	CaribouliteDecimator decimator;
+	CaribouliteResampler resampler;
+	cariboulite_sample_complex_int16 *decim_native_buffer;
+
+private:
+	void updateRatePlan(void);
+	size_t numOutputs(size_t num_native);
 
 public:
 	size_t getMTUSizeElements(void);
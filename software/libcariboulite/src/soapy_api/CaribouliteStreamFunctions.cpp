@@ -12,7 +12,9 @@ std::vector<std::string> Cariboulite::getStreamFormats(const int direction, cons
 {
     std::vector<std::string> formats;
     formats.push_back(SOAPY_SDR_CS16);
+    formats.push_back(SOAPY_SDR_CS12);
     formats.push_back(SOAPY_SDR_CS8);
+    formats.push_back(SOAPY_SDR_CU8);
     formats.push_back(SOAPY_SDR_CF32);
     formats.push_back(SOAPY_SDR_CF64);
 	return formats;
@@ -44,6 +46,52 @@ std::string Cariboulite::getNativeStreamFormat(const int direction, const size_t
 SoapySDR::ArgInfoList Cariboulite::getStreamArgsInfo(const int direction, const size_t channel) const
 {
 	SoapySDR::ArgInfoList streamArgs;
+	
+	SoapySDR::ArgInfo modeArg;
+	modeArg.key = "mode";
+	modeArg.value = "sync";
+	modeArg.name = "Stream Mode";
+	modeArg.description = "sync - read/write the SMI from the calling thread, async - a worker thread keeps the SMI drained/fed through a sample queue";
+	modeArg.type = SoapySDR::ArgInfo::STRING;
+	modeArg.options = {"sync", "async"};
+	streamArgs.push_back(modeArg);
+	
+	SoapySDR::ArgInfo buffersArg;
+	buffersArg.key = "buffers";
+	buffersArg.value = std::to_string(NUM_NATIVE_MTUS_PER_QUEUE);
+	buffersArg.name = "Async Buffers";
+	buffersArg.description = "Async queue length in MTUs";
+	buffersArg.units = "MTUs";
+	buffersArg.type = SoapySDR::ArgInfo::INT;
+	buffersArg.range = SoapySDR::Range(2, 256);
+	streamArgs.push_back(buffersArg);
+	
+	SoapySDR::ArgInfo overflowArg;
+	overflowArg.key = "overflow";
+	overflowArg.value = "drop";
+	overflowArg.name = "Async Overflow Policy";
+	overflowArg.description = "drop - RX overwrites the oldest samples (reported as SOAPY_SDR_OVERFLOW) and TX writes what fits, block - RX/TX wait for room in the queue";
+	overflowArg.type = SoapySDR::ArgInfo::STRING;
+	overflowArg.options = {"drop", "block"};
+	streamArgs.push_back(overflowArg);
+	
+	SoapySDR::ArgInfo wireArg;
+	wireArg.key = "WIRE";
+	wireArg.value = "";
+	wireArg.name = "Wire Format";
+	wireArg.description = "The format of the samples on the wire - the driver hands them over in the stream format, so it has to match it (open the stream as CS12 (3 bytes), CS8 / CU8 (2 bytes) for bandwidth limited consumers)";
+	wireArg.type = SoapySDR::ArgInfo::STRING;
+	wireArg.options = {SOAPY_SDR_CS16, SOAPY_SDR_CS12, SOAPY_SDR_CS8, SOAPY_SDR_CU8, SOAPY_SDR_CF32, SOAPY_SDR_CF64};
+	streamArgs.push_back(wireArg);
+	
+	SoapySDR::ArgInfo ditherArg;
+	ditherArg.key = "dither";
+	ditherArg.value = "false";
+	ditherArg.name = "8 Bit Dither";
+	ditherArg.description = "Add TPDF dither before the CS8 / CU8 quantization";
+	ditherArg.type = SoapySDR::ArgInfo::BOOL;
+	streamArgs.push_back(ditherArg);
+	
 	return streamArgs;
 }
 
@@ -89,6 +137,8 @@ SoapySDR::ArgInfoList Cariboulite::getStreamArgsInfo(const int direction, const
 *
 *   Recommended keys to use in the args dictionary:
 *    - "WIRE" - format of the samples between device and host
+*
+*   Cariboulite keys: "mode", "buffers", "overflow", "dither" (see getStreamArgsInfo())
 * \endparblock
 * \return an opaque pointer to a stream handle.
 * \parblock
@@ -107,15 +157,68 @@ SoapySDR::Stream *Cariboulite::setupStream(const int direction,
                                 direction == SOAPY_SDR_TX ? "TX" : "RX", 
 								format.c_str());
 
-	// configure the stream
+    // every device instance is a single modem channel (S1G or HiF). The FPGA
+    // muxes one modem channel at a time onto the SMI and the SMI words carry
+    // no channel tag, so both channels can't be demultiplexed from one
+    // stream - open the S1G and HiF devices separately instead
+    for (size_t i = 0; i < channels.size(); i++)
+    {
+        if (channels[i] >= getNumChannels(direction))
+        {
+            SoapySDR_logf(SOAPY_SDR_ERROR, "setupStream: channel %lu is not available - simultaneous S1G + HiF streaming is not supported by the FPGA's SMI channel mux", 
+                                (unsigned long)channels[i]);
+            throw std::runtime_error( "setupStream invalid channel " + std::to_string(channels[i]) );
+        }
+    }
+
+	// configure the stream - "format" is the host buffers' format, the samples are
+	// converted straight into it, so a "WIRE" format can only be the same one
+	// (the compact CS12 / CS8 / CU8 are selected as the stream format)
+    if (args.count("WIRE") && !args.at("WIRE").empty() && args.at("WIRE").compare(format))
+    {
+        SoapySDR_logf(SOAPY_SDR_ERROR, "setupStream: wire format %s differs from the stream format %s - open the stream as %s instead", 
+                                args.at("WIRE").c_str(), format.c_str(), args.at("WIRE").c_str());
+        throw std::runtime_error( "setupStream wire format " + args.at("WIRE") + " doesn't match the stream format " + format );
+    }
 	if (stream->setFormat(format) != 0)
 	{
 		SoapySDR_logf(SOAPY_SDR_ERROR, "the specified format %s is not supported", format.c_str());
         throw std::runtime_error( "setupStream invalid format " + format );
 	}
+    stream->setDither(args.count("dither") && (!args.at("dither").compare("true") || !args.at("dither").compare("1")));
 
     stream->setInnerStreamType(direction == SOAPY_SDR_TX ? cariboulite_channel_dir_tx : cariboulite_channel_dir_rx);
     
+    // Stream mode: "mode=sync|async", "buffers=<MTUs>", "overflow=drop|block"
+    bool async = false;
+    bool block_on_full = false;
+    size_t num_buffers = NUM_NATIVE_MTUS_PER_QUEUE;
+    if (args.count("mode"))
+    {
+        if (!args.at("mode").compare("async")) async = true;
+        else if (args.at("mode").compare("sync"))
+        {
+            throw std::runtime_error( "setupStream invalid mode " + args.at("mode") );
+        }
+    }
+    if (args.count("buffers"))
+    {
+        num_buffers = (size_t)std::max(2, std::atoi(args.at("buffers").c_str()));
+    }
+    if (args.count("overflow"))
+    {
+        if (!args.at("overflow").compare("block")) block_on_full = true;
+        else if (args.at("overflow").compare("drop"))
+        {
+            throw std::runtime_error( "setupStream invalid overflow policy " + args.at("overflow") );
+        }
+    }
+    
+    if (stream->setAsyncMode(async, num_buffers, block_on_full) != 0)
+    {
+        throw std::runtime_error( "setupStream failed setting the stream mode" );
+    }
+    
     // Default: CW Output -> OFF
 	cariboulite_radio_set_cw_outputs(radio, false, false);
 
@@ -190,7 +293,6 @@ int Cariboulite::activateStream(SoapySDR::Stream *stream,
 {
     stream->activateStream(1);
     int ret = cariboulite_radio_activate_channel(radio, stream->getInnerStreamType(), true);
-    std::this_thread::sleep_for(std::chrono::milliseconds(20));
     return ret;
 }
 
@@ -250,9 +352,74 @@ int Cariboulite::readStream(
         return SOAPY_SDR_NOT_SUPPORTED;
     }
 
+    // report samples dropped by the async queue once, before the next read
+    if (stream->isAsync())
+    {
+        size_t dropped = stream->getRxOverflows(true);
+        if (dropped)
+        {
+            SoapySDR_logf(SOAPY_SDR_DEBUG, "readStream: %lu samples dropped (overflow)", dropped);
+            return SOAPY_SDR_OVERFLOW;
+        }
+    }
+
     return stream->ReadSamplesGen((void*)buffs[0], numElems, timeoutUs);
 }
 
+//========================================================
+/*!
+     * Readback status information about a stream.
+     * This call is typically used on a transmit stream
+     * to report time errors, underflows, and burst completion.
+     *
+     * **Client code compatibility:**
+     * Client code may continually poll readStreamStatus() in a loop.
+     * Implementations of readStreamStatus() should wait in the call
+     * for a status change event or until the timeout expiration.
+     * When stream status is not implemented on a particular stream,
+     * readStreamStatus() should return SOAPY_SDR_NOT_SUPPORTED.
+     * Client code may use this indication to disable a polling loop.
+     *
+     * \param stream the opaque pointer to a stream handle
+     * \param chanMask to which channels this status applies
+     * \param flags optional input flags and output flags
+     * \param timeNs the buffer's timestamp in nanoseconds
+     * \param timeoutUs the timeout in microseconds
+     * \return 0 for success or error code like timeout
+     */
+int Cariboulite::readStreamStatus(SoapySDR::Stream *stream,
+                                size_t &chanMask,
+                                int &flags,
+                                long long &timeNs,
+                                const long timeoutUs)
+{
+    if (!stream->isAsync())
+    {
+        return SOAPY_SDR_NOT_SUPPORTED;
+    }
+    
+    chanMask = (1 << 0);
+    flags = 0;
+    
+    // poll in short steps - the status is rare and cheap to check
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::microseconds(timeoutUs);
+    do
+    {
+        if (stream->getInnerStreamType() == cariboulite_channel_dir_tx && stream->getTxUnderflows(true))
+        {
+            return SOAPY_SDR_UNDERFLOW;
+        }
+        // reported once, as readStream does
+        if (stream->getInnerStreamType() == cariboulite_channel_dir_rx && stream->getRxOverflows(true))
+        {
+            return SOAPY_SDR_OVERFLOW;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    } while (std::chrono::steady_clock::now() < deadline);
+    
+    return SOAPY_SDR_TIMEOUT;
+}
+
 //========================================================
 /*!
      * Write elements to a stream for transmission.
@@ -288,4 +455,152 @@ int Cariboulite::writeStream(
     }
 
     return stream->WriteSamplesGen((void*)buffs[0], numElems, timeoutUs);
-}
\ No newline at end of file
+}
+//========================================================
+/*!
+     * How many direct access buffers can the stream provide?
+     * This is the number of times the user can call acquire()
+     * on a stream without making subsequent calls to release().
+     * A return value of 0 means that direct access is not supported.
+     *
+     * \param stream the opaque pointer to a stream handle
+     * \return the number of direct access buffers or 0
+     */
+size_t Cariboulite::getNumDirectAccessBuffers(SoapySDR::Stream *stream)
+{
+    return stream->getNumDirectBuffers();
+}
+
+//========================================================
+/*!
+     * Get the buffer addresses for a scatter/gather table entry.
+     * When the underlying DMA implementation uses scatter/gather
+     * then this call provides the user addresses for that table.
+     *
+     * Example: The caller may query the DMA memory addresses once
+     * after stream creation to pre-allocate a re-usable ring-buffer.
+     *
+     * \param stream the opaque pointer to a stream handle
+     * \param handle an index value between 0 and num direct buffers - 1
+     * \param buffs an array of void* buffers num chans in size
+     * \return 0 for success or error code when not supported
+     */
+int Cariboulite::getDirectAccessBufferAddrs(SoapySDR::Stream *stream, const size_t handle, void **buffs)
+{
+    void* buffer = stream->getDirectBuffer(handle);
+    if (buffer == NULL)
+    {
+        return SOAPY_SDR_NOT_SUPPORTED;
+    }
+    buffs[0] = buffer;
+    return 0;
+}
+
+//========================================================
+/*!
+     * Acquire direct buffers from a receive stream.
+     * This call is part of the direct buffer access API.
+     *
+     * The buffs array will be filled with a stream pointer for each channel.
+     * Each pointer can be read up to the number of return value elements.
+     *
+     * The handle will be set by the implementation so that the caller
+     * may later release access to the buffers with releaseReadBuffer().
+     * Handle represents an index into the internal scatter/gather table
+     * such that handle is between 0 and num direct buffers - 1.
+     *
+     * \param stream the opaque pointer to a stream handle
+     * \param handle an index value used in the release() call
+     * \param buffs an array of void* buffers num chans in size
+     * \param flags optional flag indicators about the result
+     * \param timeNs the buffer's timestamp in nanoseconds
+     * \param timeoutUs the timeout in microseconds
+     * \return the number of elements read per buffer or error code
+     */
+int Cariboulite::acquireReadBuffer(SoapySDR::Stream *stream,
+                                    size_t &handle,
+                                    const void **buffs,
+                                    int &flags,
+                                    long long &timeNs,
+                                    const long timeoutUs)
+{
+    if (stream->getInnerStreamType() != cariboulite_channel_dir_rx)
+    {
+        return SOAPY_SDR_NOT_SUPPORTED;
+    }
+    flags = 0;
+    return stream->acquireDirectReadBuffer(handle, buffs, timeoutUs);
+}
+
+//========================================================
+/*!
+     * Release an acquired buffer back to the receive stream.
+     * This call is part of the direct buffer access API.
+     *
+     * \param stream the opaque pointer to a stream handle
+     * \param handle the opaque handle from the acquire() call
+     */
+void Cariboulite::releaseReadBuffer(SoapySDR::Stream *stream, const size_t handle)
+{
+    stream->releaseDirectReadBuffer(handle);
+}
+
+//========================================================
+/*!
+     * Acquire direct buffers from a transmit stream.
+     * This call is part of the direct buffer access API.
+     *
+     * The buffs array will be filled with a stream pointer for each channel.
+     * Each pointer can be written up to the number of return value elements.
+     *
+     * The handle will be set by the implementation so that the caller
+     * may later release access to the buffers with releaseWriteBuffer().
+     * Handle represents an index into the internal scatter/gather table
+     * such that handle is between 0 and num direct buffers - 1.
+     *
+     * \param stream the opaque pointer to a stream handle
+     * \param handle an index value used in the release() call
+     * \param buffs an array of void* buffers num chans in size
+     * \param timeoutUs the timeout in microseconds
+     * \return the number of available elements per buffer or error
+     */
+int Cariboulite::acquireWriteBuffer(SoapySDR::Stream *stream,
+                                    size_t &handle,
+                                    void **buffs,
+                                    const long timeoutUs)
+{
+    if (stream->getInnerStreamType() != cariboulite_channel_dir_tx)
+    {
+        return SOAPY_SDR_NOT_SUPPORTED;
+    }
+    return stream->acquireDirectWriteBuffer(handle, buffs, timeoutUs);
+}
+
+//========================================================
+/*!
+     * Release an acquired buffer back to the transmit stream.
+     * This call is part of the direct buffer access API.
+     *
+     * Stream meta-data is provided as part of the release call,
+     * and not the acquire call so that the caller may acquire
+     * buffers without committing to the contents of the meta-data,
+     * which can be determined by the user as the buffers are filled.
+     *
+     * \param stream the opaque pointer to a stream handle
+     * \param handle the opaque handle from the acquire() call
+     * \param numElems the number of elements written to each buffer
+     * \param flags optional input flags and output flags
+     * \param timeNs the buffer's timestamp in nanoseconds
+     */
+void Cariboulite::releaseWriteBuffer(SoapySDR::Stream *stream,
+                                    const size_t handle,
+                                    const size_t numElems,
+                                    int &flags,
+                                    const long long timeNs)
+{
+    int ret = stream->releaseDirectWriteBuffer(handle, numElems, 100000);
+    if (ret < 0)
+    {
+        SoapySDR_logf(SOAPY_SDR_ERROR, "releaseWriteBuffer: writing %lu elements failed (%d)", numElems, ret);
+    }
+}
@@ -0,0 +1,133 @@
+/*
+ * The reader thread's idle and data handlers - replaced by the user (e.g. by
+ * a CaribouLiteRxStream going away) while the reader thread calls them.
+ * No hardware needed.
+ */
+#include <stdio.h>
+#include <unistd.h>
+#include <CaribouLite.hpp>
+
+#define CHECK(c)	do { if (!(c)) { printf("FAILED %s:%d: %s\n", __func__, __LINE__, #c); return -1; } } while (0)
+
+typedef CaribouLiteGuardedHandler<int> IdleHandler;
+
+//=================================================================
+// after Set(nullptr) returns the old handler isn't running and isn't called again
+int test_clear_waits_for_call()
+{
+    IdleHandler h;
+    std::atomic<bool> stop {false};
+    std::atomic<bool> inside {false};
+    std::atomic<int> calls {0};
+
+    std::thread reader([&]()
+    {
+        while (!stop) { if (!h.Call(0)) usleep(100); }
+    });
+
+    h.Set([&](int)
+    {
+        inside = true;
+        usleep(20000);
+        calls++;
+        inside = false;
+    });
+    usleep(50000);
+    h.Set(nullptr);
+    bool was_inside = inside;
+    int n = calls;
+    usleep(50000);
+
+    stop = true;
+    reader.join();
+    CHECK(n > 0);
+    CHECK(!was_inside);
+    CHECK(calls == n);
+    return 0;
+}
+
+//=================================================================
+// a handler that clears itself doesn't wait for its own call
+int test_clear_from_handler()
+{
+    IdleHandler h;
+    int calls = 0;
+    h.Set([&](int) { calls++; h.Set(nullptr); });
+    CHECK(h.Call(0));
+    CHECK(!h.Call(0));
+    CHECK(calls == 1);
+    return 0;
+}
+
+//=================================================================
+// handlers swapped under a running reader - each one's state is gone right
+// after it's replaced, as with a destroyed stream's
+int test_swap_under_reader()
+{
+    IdleHandler h;
+    std::atomic<bool> stop {false};
+    std::atomic<int> bad {0};
+
+    std::thread reader([&]()
+    {
+        while (!stop) h.Call(0);
+    });
+
+    for (int i = 0; i < 2000; i++)
+    {
+        std::atomic<bool>* alive = new std::atomic<bool>(true);
+        h.Set([alive, &bad](int) { if (!*alive) bad++; });
+        if (i & 1) usleep(10);
+        h.Set(nullptr);
+        *alive = false;
+        delete alive;
+    }
+
+    stop = true;
+    reader.join();
+    CHECK(bad == 0);
+    return 0;
+}
+
+//=================================================================
+// the data callbacks are guarded the same way - a stream that clears its
+// callback may go away while the reader thread still has samples for it
+int test_data_handler_clear()
+{
+    CaribouLiteGuardedHandler<CaribouLiteRadio*, const std::complex<float>*, CaribouLiteMeta*, size_t> h;
+    std::complex<float> samples[16];
+    std::atomic<bool> stop {false};
+    std::atomic<int> bad {0};
+
+    std::thread reader([&]()
+    {
+        while (!stop) h.Call(nullptr, samples, nullptr, 16);
+    });
+
+    for (int i = 0; i < 2000; i++)
+    {
+        std::atomic<size_t>* stream = new std::atomic<size_t>(0);
+        h.Set([stream](CaribouLiteRadio*, const std::complex<float>*, CaribouLiteMeta*, size_t n) { *stream += n; });
+        if (i & 1) usleep(10);
+        h.Set(nullptr);
+        if (*stream % 16) bad++;
+        delete stream;
+    }
+
+    stop = true;
+    reader.join();
+    CHECK(bad == 0);
+    return 0;
+}
+
+//=================================================================
+int main()
+{
+    int fails = 0;
+    fails += test_clear_waits_for_call() != 0;
+    fails += test_clear_from_handler() != 0;
+    fails += test_swap_under_reader() != 0;
+    fails += test_data_handler_clear() != 0;
+    printf("rx idle handler: %d failed\n", fails);
+    return fails ? -1 : 0;
+}
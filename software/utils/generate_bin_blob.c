@@ -16,6 +16,7 @@
  */
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <sys/stat.h>
 #include <sys/types.h>
 #include <stdint.h>
@@ -25,6 +26,16 @@
 
 #define LINE_LEN  16
 
+// compressed blobs - LZ4 style sequences: a token (literals count : 4, match
+// length - MIN_MATCH : 4, 15 = more length bytes follow, 255 = keep adding),
+// the literals, a 16 bit LE offset and the extra match length bytes. The last
+// sequence has literals only. Offsets stay below the window - the decoder
+// keeps no more than its last window of output
+#define LZ_WINDOW       (16*1024)
+#define LZ_MIN_MATCH    4
+#define LZ_HASH_BITS    14
+#define LZ_MAX_CHAIN    64
+
 //-------------------------------------------------------------------
 int file_exists(char* fname, int *size, int *dir, int *file, int *dev)
 {
@@ -78,6 +89,100 @@ void get_filename_ext_from_path(char* full_path, char* file_path, char* file_nam
     if (file_ext) strcpy(file_ext, ext);
 }
 
+//-------------------------------------------------------------------
+static uint32_t lz_hash(const uint8_t* p)
+{
+    uint32_t v = p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+    return (v * 2654435761u) >> (32 - LZ_HASH_BITS);
+}
+
+//-------------------------------------------------------------------
+static int lz_put_length(uint8_t* out, int pos, int len)
+{
+    while (len >= 255)
+    {
+        out[pos++] = 255;
+        len -= 255;
+    }
+    out[pos++] = len;
+    return pos;
+}
+
+//-------------------------------------------------------------------
+static int lz_put_sequence(uint8_t* out, int pos, const uint8_t* lit, int lit_len, int match_len, int offset)
+{
+    int ml = match_len ? match_len - LZ_MIN_MATCH : 0;
+    out[pos++] = ((lit_len < 15 ? lit_len : 15) << 4) | (ml < 15 ? ml : 15);
+    if (lit_len >= 15) pos = lz_put_length(out, pos, lit_len - 15);
+    memcpy(out + pos, lit, lit_len);
+    pos += lit_len;
+    if (match_len == 0) return pos;
+
+    out[pos++] = offset & 0xFF;
+    out[pos++] = offset >> 8;
+    if (ml >= 15) pos = lz_put_length(out, pos, ml - 15);
+    return pos;
+}
+
+//-------------------------------------------------------------------
+// greedy, hash chained - returns the compressed size (or -1)
+static int lz_compress(const uint8_t* in, int len, uint8_t* out)
+{
+    int *head = malloc(sizeof(int) * (1 << LZ_HASH_BITS));
+    int *prev = malloc(sizeof(int) * (len + 1));
+    if (head == NULL || prev == NULL)
+    {
+        free(head);
+        free(prev);
+        return -1;
+    }
+    for (int i = 0; i < (1 << LZ_HASH_BITS); i++) head[i] = -1;
+
+    int pos = 0;
+    int anchor = 0;
+    int i = 0;
+    while (i < len)
+    {
+        int best_len = 0;
+        int best_off = 0;
+        if (i + LZ_MIN_MATCH <= len)
+        {
+            uint32_t h = lz_hash(in + i);
+            int chain = 0;
+            for (int c = head[h]; c >= 0 && i - c < LZ_WINDOW && chain < LZ_MAX_CHAIN; c = prev[c], chain++)
+            {
+                int l = 0;
+                while (i + l < len && in[c + l] == in[i + l]) l++;
+                if (l > best_len)
+                {
+                    best_len = l;
+                    best_off = i - c;
+                }
+            }
+        }
+
+        int step = best_len >= LZ_MIN_MATCH ? best_len : 1;
+        if (best_len >= LZ_MIN_MATCH)
+        {
+            pos = lz_put_sequence(out, pos, in + anchor, i - anchor, best_len, best_off);
+            anchor = i + best_len;
+        }
+        for (int j = i; j < i + step; j++)
+        {
+            if (j + LZ_MIN_MATCH > len) continue;
+            uint32_t h = lz_hash(in + j);
+            prev[j] = head[h];
+            head[h] = j;
+        }
+        i += step;
+    }
+    pos = lz_put_sequence(out, pos, in + anchor, len - anchor, 0, 0);
+
+    free(head);
+    free(prev);
+    return pos;
+}
+
 //-------------------------------------------------------------------
 
 int main(int argc, char *argv[])
@@ -88,16 +193,18 @@ int main(int argc, char *argv[])
     if (argc < 4)
     {
         printf("Code (C/C++ Header) generation from binary file, Ver 1.0\n");
-        printf("Usage: generate_code [binary_file] [variable_name] [code filename]\n");
+        printf("Usage: generate_code [binary_file] [variable_name] [code filename] [-z]\n");
         printf("    binary_file - the file to be converted into a code blob\n");
         printf("    variable name - The variable name of type uint8_t[] within the code file\n");
         printf("    code filename - the filename of the generated c/c++ code (typically a header file)\n");
+        printf("    -z - compress the blob (LZ4 style, 16 KB window), its size goes in [variable_name]_raw_size\n");
         return 0;
     }
 
     char *bin_file = argv[1];
     char *var_name = argv[2];
     char *code_file = argv[3];
+    int compress = argc > 4 && strcmp(argv[4], "-z") == 0;
 
     if ( !file_exists(bin_file, &size_of_file, NULL, NULL, NULL) )
     {
@@ -114,10 +221,39 @@ int main(int argc, char *argv[])
         return -1;
     }
 
+    // the whole file in memory - it's compressed as one block
+    uint8_t* data = malloc(size_of_file + 1);
+    if (data == NULL || (int)fread(data, 1, size_of_file, f_bin) != size_of_file)
+    {
+        printf("Couldn't read the binary file %s\n", bin_file);
+        free(data);
+        fclose(f_bin);
+        return -1;
+    }
+    int size_of_blob = size_of_file;
+    uint8_t* blob = data;
+    if (compress)
+    {
+        // worst case - all literals
+        blob = malloc(size_of_file + size_of_file / 255 + 16);
+        size_of_blob = blob ? lz_compress(data, size_of_file, blob) : -1;
+        if (size_of_blob < 0)
+        {
+            printf("Couldn't compress the binary file %s\n", bin_file);
+            free(blob);
+            free(data);
+            fclose(f_bin);
+            return -1;
+        }
+        printf("Compressed %d bytes into %d bytes (%.1f%%)\n", size_of_file, size_of_blob, size_of_blob * 100.0 / size_of_file);
+    }
+
     FILE* f_code = fopen (code_file, "w");
     if (f_code == NULL)
     {
         printf("Couldn't open the code file %s for writing\n", code_file);
+        if (blob != data) free(blob);
+        free(data);
         fclose(f_bin);
         return -1;
     }
@@ -159,26 +295,37 @@ int main(int argc, char *argv[])
     fprintf(f_code, "   .tm_year = %d,  /* +1900 */\n", tm.tm_year);
     fprintf(f_code, "};\n\n");
     
-    fprintf(f_code, "/*\n"
-                    " * Data blob of variable %s:\n"
-                    " *     Size: %d bytes\n"
-                    " *     Original filename: %s\n"
-                    " */\n", var_name, size_of_file, bin_file);
+    if (compress)
+    {
+        fprintf(f_code, "/*\n"
+                        " * Data blob of variable %s (compressed - LZ4 style sequences, 16 KB window):\n"
+                        " *     Size: %d bytes (%d bytes uncompressed)\n"
+                        " *     Original filename: %s\n"
+                        " */\n", var_name, size_of_blob, size_of_file, bin_file);
+        fprintf(f_code, "uint32_t %s_raw_size = %d;\n", var_name, size_of_file);
+    }
+    else
+    {
+        fprintf(f_code, "/*\n"
+                        " * Data blob of variable %s:\n"
+                        " *     Size: %d bytes\n"
+                        " *     Original filename: %s\n"
+                        " */\n", var_name, size_of_file, bin_file);
+    }
     fprintf(f_code, "uint8_t %s[] = {", var_name);
 
-    for (int j = 0; j < size_of_file; j ++)
+    for (int j = 0; j < size_of_blob; j ++)
     {
-        uint8_t b = 0;
-        fread(&b, 1, 1, f_bin);
-
         if ((j % LINE_LEN) == 0) fprintf(f_code, "\n\t");
-        fprintf(f_code, "0x%02X, ", b);
-        if (j == (size_of_file - 1)) fprintf(f_code, "\n};\n\n");
+        fprintf(f_code, "0x%02X, ", blob[j]);
+        if (j == (size_of_blob - 1)) fprintf(f_code, "\n};\n\n");
     }
 
     fprintf(f_code, "#ifdef __cplusplus\n}\n#endif\n\n");
     fprintf(f_code, "#endif // __%s_%s__\n", name, ext);
 
+    if (blob != data) free(blob);
+    free(data);
     fclose(f_bin);
     fclose(f_code);
 